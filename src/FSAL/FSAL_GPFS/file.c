@@ -1132,26 +1132,19 @@ gpfs_lock_op2(struct fsal_obj_handle *obj_hdl, struct state_t *state,
 }
 
 /**
- *  @brief GPFS seek command
+ *  @brief GPFS seek on an open file descriptor
  *
- *  @param obj_hdl FSAL object handle
+ *  @param fd      Open file descriptor
  *  @param io_info I/O information
  *  @return FSAL status
- *
- *  default case not supported
  */
-fsal_status_t gpfs_seek(struct fsal_obj_handle *obj_hdl, struct io_info *info)
+static fsal_status_t gpfs_seek_fd(int fd, struct io_info *info)
 {
-	struct gpfs_fsal_obj_handle *myself =
-		container_of(obj_hdl, struct gpfs_fsal_obj_handle, obj_handle);
 	struct gpfs_io_info io_info = {0};
 	struct fseek_arg arg = {0};
 
-	assert(myself->u.file.fd.fd >= 0 &&
-	       myself->u.file.fd.openflags != FSAL_O_CLOSED);
-
-	arg.mountdirfd = myself->u.file.fd.fd;
-	arg.openfd = myself->u.file.fd.fd;
+	arg.mountdirfd = fd;
+	arg.openfd = fd;
 	arg.info = &io_info;
 
 	io_info.io_offset = info->io_content.hole.di_offset;
@@ -1179,6 +1172,70 @@ fsal_status_t gpfs_seek(struct fsal_obj_handle *obj_hdl, struct io_info *info)
 	return fsalstat(ERR_FSAL_NO_ERROR, 0);
 }
 
+/**
+ *  @brief GPFS seek command
+ *
+ *  @param obj_hdl FSAL object handle
+ *  @param io_info I/O information
+ *  @return FSAL status
+ *
+ *  default case not supported
+ */
+fsal_status_t gpfs_seek(struct fsal_obj_handle *obj_hdl, struct io_info *info)
+{
+	struct gpfs_fsal_obj_handle *myself =
+		container_of(obj_hdl, struct gpfs_fsal_obj_handle, obj_handle);
+
+	assert(myself->u.file.fd.fd >= 0 &&
+	       myself->u.file.fd.openflags != FSAL_O_CLOSED);
+
+	return gpfs_seek_fd(myself->u.file.fd.fd, info);
+}
+
+/**
+ *  @brief GPFS seek command with a state
+ *
+ *  @param obj_hdl FSAL object handle
+ *  @param state   state_t to use for this operation
+ *  @param io_info I/O information
+ *  @return FSAL status
+ */
+fsal_status_t gpfs_seek2(struct fsal_obj_handle *obj_hdl,
+			 struct state_t *state,
+			 struct io_info *info)
+{
+	int my_fd = -1;
+	fsal_status_t status;
+	bool has_lock = false;
+	bool closefd = false;
+
+	if (obj_hdl->fsal != obj_hdl->fs->fsal) {
+		LogDebug(COMPONENT_FSAL,
+			 "FSAL %s operation for handle belonging to FSAL %s, return EXDEV",
+			 obj_hdl->fsal->name, obj_hdl->fs->fsal->name);
+		return fsalstat(posix2fsal_error(EXDEV), EXDEV);
+	}
+
+	/* Get a usable file descriptor */
+	status = find_fd(&my_fd, obj_hdl, false, state, FSAL_O_ANY,
+			 &has_lock, &closefd, false);
+
+	if (FSAL_IS_ERROR(status))
+		goto out;
+
+	status = gpfs_seek_fd(my_fd, info);
+
+ out:
+
+	if (closefd)
+		fsal_internal_close(my_fd, NULL, 0);
+
+	if (has_lock)
+		PTHREAD_RWLOCK_unlock(&obj_hdl->obj_lock);
+
+	return status;
+}
+
 /**
  *  @brief GPFS IO advise
  *
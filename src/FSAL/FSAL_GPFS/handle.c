@@ -1010,6 +1010,7 @@ void gpfs_handle_ops_init(struct fsal_obj_ops *ops)
 	ops->fs_locations = gpfs_fs_locations;
 	ops->status = gpfs_status;
 	ops->seek = gpfs_seek;
+	ops->seek2 = gpfs_seek2;
 	ops->io_advise = gpfs_io_advise;
 	ops->share_op = share_op;
 	ops->close = gpfs_close;
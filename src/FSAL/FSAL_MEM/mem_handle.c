@@ -336,6 +336,239 @@ static void mem_copy_attrs_mask(struct attrlist *attrs_in,
 	attrs_out->change = timespec_to_nsecs(&attrs_out->chgtime);
 }
 
+/**
+ * @brief Record a written range in a file's extent map
+ *
+ * Ranges that overlap or touch the new one are merged into it.
+ *
+ * @param[in] myself	File written
+ * @param[in] offset	Start of the range
+ * @param[in] length	Length of the range
+ */
+static void mem_extent_add(struct mem_fsal_obj_handle *myself,
+			   uint64_t offset, uint64_t length)
+{
+	struct mem_extent *ext;
+	uint64_t end = offset + length;
+	uint32_t first, last, i;
+
+	if (length == 0)
+		return;
+
+	PTHREAD_MUTEX_lock(&myself->mh_file.extent_mutex);
+
+	ext = myself->mh_file.extents;
+
+	/* The extents from first to last - 1 are absorbed */
+	for (first = 0; first < myself->mh_file.num_extents; first++)
+		if (ext[first].offset + ext[first].length >= offset)
+			break;
+	for (last = first; last < myself->mh_file.num_extents; last++)
+		if (ext[last].offset > end)
+			break;
+
+	if (first < last) {
+		offset = MIN(offset, ext[first].offset);
+		end = MAX(end, ext[last - 1].offset + ext[last - 1].length);
+	} else if (myself->mh_file.num_extents ==
+		   myself->mh_file.max_extents) {
+		myself->mh_file.max_extents =
+			MAX(8, myself->mh_file.max_extents * 2);
+		myself->mh_file.extents = gsh_realloc(
+			myself->mh_file.extents,
+			myself->mh_file.max_extents * sizeof(*ext));
+		ext = myself->mh_file.extents;
+	}
+
+	/* Keep one slot at first, and close the gap after it */
+	if (first == last) {
+		for (i = myself->mh_file.num_extents; i > first; i--)
+			ext[i] = ext[i - 1];
+		myself->mh_file.num_extents++;
+	} else {
+		for (i = last; i < myself->mh_file.num_extents; i++)
+			ext[first + 1 + i - last] = ext[i];
+		myself->mh_file.num_extents -= last - first - 1;
+	}
+	ext[first].offset = offset;
+	ext[first].length = end - offset;
+
+	PTHREAD_MUTEX_unlock(&myself->mh_file.extent_mutex);
+}
+
+/**
+ * @brief Drop what lies beyond a new file size from the extent map
+ *
+ * @param[in] myself	File truncated
+ * @param[in] size	New size
+ */
+static void mem_extent_truncate(struct mem_fsal_obj_handle *myself,
+				uint64_t size)
+{
+	struct mem_extent *ext;
+	uint32_t i;
+
+	PTHREAD_MUTEX_lock(&myself->mh_file.extent_mutex);
+
+	ext = myself->mh_file.extents;
+	for (i = 0; i < myself->mh_file.num_extents; i++) {
+		if (ext[i].offset >= size)
+			break;
+		if (ext[i].offset + ext[i].length > size) {
+			ext[i].length = size - ext[i].offset;
+			i++;
+			break;
+		}
+	}
+	myself->mh_file.num_extents = i;
+
+	PTHREAD_MUTEX_unlock(&myself->mh_file.extent_mutex);
+}
+
+/**
+ * @brief Punch a hole in a file's extent map
+ *
+ * @param[in] myself	File deallocated
+ * @param[in] offset	Start of the hole
+ * @param[in] length	Length of the hole
+ */
+static void mem_extent_punch(struct mem_fsal_obj_handle *myself,
+			     uint64_t offset, uint64_t length)
+{
+	struct mem_extent *ext;
+	uint64_t end = offset + length;
+	uint64_t ext_end;
+	uint32_t i, j;
+
+	if (length == 0)
+		return;
+
+	PTHREAD_MUTEX_lock(&myself->mh_file.extent_mutex);
+
+	ext = myself->mh_file.extents;
+	for (i = 0, j = 0; i < myself->mh_file.num_extents; i++) {
+		ext_end = ext[i].offset + ext[i].length;
+
+		if (ext[i].offset < offset && ext_end > end) {
+			/* The hole splits this extent, and touches no other */
+			if (myself->mh_file.num_extents ==
+			    myself->mh_file.max_extents) {
+				myself->mh_file.max_extents *= 2;
+				myself->mh_file.extents = gsh_realloc(
+					myself->mh_file.extents,
+					myself->mh_file.max_extents *
+					sizeof(*ext));
+				ext = myself->mh_file.extents;
+			}
+			memmove(&ext[i + 2], &ext[i + 1],
+				(myself->mh_file.num_extents - i - 1) *
+				sizeof(*ext));
+			ext[i].length = offset - ext[i].offset;
+			ext[i + 1].offset = end;
+			ext[i + 1].length = ext_end - end;
+			myself->mh_file.num_extents++;
+			goto out;
+		}
+
+		if (ext_end <= offset || ext[i].offset >= end) {
+			ext[j++] = ext[i];
+		} else if (ext[i].offset < offset) {
+			ext[j].offset = ext[i].offset;
+			ext[j++].length = offset - ext[i].offset;
+		} else if (ext_end > end) {
+			ext[j].offset = end;
+			ext[j++].length = ext_end - end;
+		}
+		/* else it is all in the hole */
+	}
+	myself->mh_file.num_extents = j;
+
+ out:
+	PTHREAD_MUTEX_unlock(&myself->mh_file.extent_mutex);
+}
+
+/**
+ * @brief Sum the extents of a file
+ *
+ * @param[in] myself	File to look at
+ *
+ * @return Bytes of the file that are not holes.
+ */
+static uint64_t mem_extent_used(struct mem_fsal_obj_handle *myself)
+{
+	uint64_t used = 0;
+	uint32_t i;
+
+	PTHREAD_MUTEX_lock(&myself->mh_file.extent_mutex);
+
+	for (i = 0; i < myself->mh_file.num_extents; i++)
+		used += myself->mh_file.extents[i].length;
+
+	PTHREAD_MUTEX_unlock(&myself->mh_file.extent_mutex);
+
+	return used;
+}
+
+/**
+ * @brief Find the first written range ending after an offset
+ *
+ * @param[in]  myself	File to look in
+ * @param[in]  offset	Offset to look from
+ * @param[out] start	Start of the range, may be before offset
+ * @param[out] end	End of the range
+ *
+ * @return true if there is one, false if only a hole follows offset.
+ */
+static bool mem_extent_next(struct mem_fsal_obj_handle *myself,
+			    uint64_t offset, uint64_t *start, uint64_t *end)
+{
+	struct mem_extent *ext;
+	bool found = false;
+	uint32_t i;
+
+	PTHREAD_MUTEX_lock(&myself->mh_file.extent_mutex);
+
+	ext = myself->mh_file.extents;
+	for (i = 0; i < myself->mh_file.num_extents; i++) {
+		if (ext[i].offset + ext[i].length > offset) {
+			*start = ext[i].offset;
+			*end = ext[i].offset + ext[i].length;
+			found = true;
+			break;
+		}
+	}
+
+	PTHREAD_MUTEX_unlock(&myself->mh_file.extent_mutex);
+
+	return found;
+}
+
+/**
+ * @brief Zero what was read from the holes of a file
+ *
+ * @param[in]  myself	File read
+ * @param[out] buffer	Data read
+ * @param[in]  offset	Where buffer starts in the file
+ * @param[in]  size	Length of buffer
+ */
+static void mem_extent_zero_holes(struct mem_fsal_obj_handle *myself,
+				  char *buffer, uint64_t offset, size_t size)
+{
+	uint64_t pos = offset, end = offset + size;
+	uint64_t ext_start, ext_end;
+
+	while (pos < end) {
+		if (!mem_extent_next(myself, pos, &ext_start, &ext_end)) {
+			ext_start = end;
+			ext_end = end;
+		}
+		if (ext_start > pos)
+			memset(buffer + (pos - offset), 0,
+			       MIN(ext_start, end) - pos);
+		pos = ext_end;
+	}
+}
+
 /**
  * @brief Open an FD
  *
@@ -482,6 +715,7 @@ _mem_alloc_handle(struct mem_fsal_obj_handle *parent,
 
 	switch (type) {
 	case REGULAR_FILE:
+		PTHREAD_MUTEX_init(&hdl->mh_file.extent_mutex, NULL);
 		if ((attrs && attrs->valid_mask & ATTR_SIZE) != 0) {
 			hdl->attrs.filesize = attrs->filesize;
 			hdl->attrs.spaceused = attrs->filesize;
@@ -993,6 +1227,9 @@ fsal_status_t mem_setattr2(struct fsal_obj_handle *obj_hdl,
 
 	mem_copy_attrs_mask(attrs_set, &myself->attrs);
 
+	if (FSAL_TEST_MASK(attrs_set->valid_mask, ATTR_SIZE))
+		mem_extent_truncate(myself, myself->attrs.filesize);
+
 #ifdef USE_LTTNG
 	tracepoint(fsalmem, mem_setattrs, __func__, __LINE__, myself,
 			   myself->m_name, myself->attrs.filesize,
@@ -1321,8 +1558,10 @@ fsal_status_t mem_open2(struct fsal_obj_handle *obj_hdl,
 			openflags |= FSAL_O_READ;
 		mem_open_my_fd(my_fd, openflags);
 
-		if (truncated)
+		if (truncated) {
 			myself->attrs.filesize = myself->attrs.spaceused = 0;
+			mem_extent_truncate(myself, 0);
+		}
 
 		/* Now check verifier for exclusive, but not for
 		 * FSAL_EXCLUSIVE_9P.
@@ -1507,8 +1746,10 @@ fsal_status_t mem_reopen2(struct fsal_obj_handle *obj_hdl,
 	PTHREAD_RWLOCK_unlock(&obj_hdl->obj_lock);
 
 	mem_open_my_fd(my_fd, openflags);
-	if (openflags & FSAL_O_TRUNC)
+	if (openflags & FSAL_O_TRUNC) {
 		myself->attrs.filesize = myself->attrs.spaceused = 0;
+		mem_extent_truncate(myself, 0);
+	}
 
 	return status;
 }
@@ -1549,11 +1790,8 @@ fsal_status_t mem_read2(struct fsal_obj_handle *obj_hdl,
 	struct fsal_fd *fsal_fd;
 	bool has_lock, closefd = false;
 	fsal_status_t status = {ERR_FSAL_NO_ERROR, 0};
-
-	if (info != NULL) {
-		/* Currently we don't support READ_PLUS */
-		return fsalstat(ERR_FSAL_NOTSUPP, 0);
-	}
+	uint64_t ext_start, ext_end;
+	bool hole = false;
 
 	/* Find an FD */
 	status = fsal_find_fd(&fsal_fd, obj_hdl, &myself->mh_file.fd,
@@ -1570,7 +1808,25 @@ fsal_status_t mem_read2(struct fsal_obj_handle *obj_hdl,
 		buffer_size = myself->attrs.filesize - offset;
 	}
 
-	if (offset < myself->datasize) {
+	if (info != NULL && buffer_size != 0) {
+		/* READ_PLUS, report one segment: data up to the end of the
+		 * extent, or the hole up to the next one.
+		 */
+		if (!mem_extent_next(myself, offset, &ext_start, &ext_end)) {
+			hole = true;
+		} else if (ext_start > offset) {
+			hole = true;
+			buffer_size = MIN(buffer_size, ext_start - offset);
+		} else {
+			buffer_size = MIN(buffer_size, ext_end - offset);
+		}
+	}
+
+	if (hole) {
+		info->io_content.what = NFS4_CONTENT_HOLE;
+		info->io_content.hole.di_offset = offset;
+		info->io_content.hole.di_length = buffer_size;
+	} else if (offset < myself->datasize) {
 		size_t readsize;
 
 		/* Data to read */
@@ -1582,14 +1838,25 @@ fsal_status_t mem_read2(struct fsal_obj_handle *obj_hdl,
 		memset(buffer, 'a', buffer_size);
 	}
 
+	if (info == NULL)
+		mem_extent_zero_holes(myself, buffer, offset, buffer_size);
+
 #ifdef USE_LTTNG
 	tracepoint(fsalmem, mem_read, __func__, __LINE__, myself,
 		   myself->m_name, state, myself->attrs.filesize,
 		   myself->attrs.spaceused);
 #endif
 
+	if (info != NULL && !hole) {
+		info->io_content.what = NFS4_CONTENT_DATA;
+		info->io_content.data.d_offset = offset;
+		info->io_content.data.d_data.data_len = buffer_size;
+		info->io_content.data.d_data.data_val = buffer;
+	}
+
 	*read_amount = buffer_size;
-	*end_of_file = (buffer_size == 0);
+	*end_of_file = (buffer_size == 0 ||
+			offset + buffer_size >= myself->attrs.filesize);
 	now(&myself->attrs.atime);
 
 	if (has_lock)
@@ -1599,22 +1866,18 @@ fsal_status_t mem_read2(struct fsal_obj_handle *obj_hdl,
 }
 
 /**
- * @brief Write data to a file
+ * @brief Write data to a file from an array of buffers
  *
- * This function writes data to a file. The FSAL must be able to
- * perform the write whether a state is presented or not. This function also
- * is expected to handle properly bypassing or not share reservations. Even
- * with bypass == true, it will enforce a mandatory (NFSv4) deny_write if
- * an appropriate state is not passed).
- *
- * The FSAL is expected to enforce sync if necessary.
+ * Each buffer is copied straight to its place in the file's data.
  *
  * @param[in]     obj_hdl        File on which to operate
  * @param[in]     bypass         If state doesn't indicate a share reservation,
  *                               bypass any non-mandatory deny write
  * @param[in]     state          state_t to use for this operation
  * @param[in]     offset         Position at which to write
- * @param[in]     buffer         Data to be written
+ * @param[in]     iov            Data to be written
+ * @param[in]     iovcnt         Number of buffers in iov
+ * @param[out]    wrote_amount   Amount of data written
  * @param[in,out] fsal_stable    In, if on, the fsal is requested to write data
  *                               to stable store. Out, the fsal reports what
  *                               it did.
@@ -1623,21 +1886,24 @@ fsal_status_t mem_read2(struct fsal_obj_handle *obj_hdl,
  * @return FSAL status.
  */
 
-fsal_status_t mem_write2(struct fsal_obj_handle *obj_hdl,
-			 bool bypass,
-			 struct state_t *state,
-			 uint64_t offset,
-			 size_t buffer_size,
-			 void *buffer,
-			 size_t *wrote_amount,
-			 bool *fsal_stable,
-			 struct io_info *info)
+fsal_status_t mem_writev2(struct fsal_obj_handle *obj_hdl,
+			  bool bypass,
+			  struct state_t *state,
+			  uint64_t offset,
+			  const struct iovec *iov,
+			  int iovcnt,
+			  size_t *wrote_amount,
+			  bool *fsal_stable,
+			  struct io_info *info)
 {
 	struct mem_fsal_obj_handle *myself = container_of(obj_hdl,
 				  struct mem_fsal_obj_handle, obj_handle);
 	struct fsal_fd *fsal_fd;
 	bool has_lock, closefd = false;
 	fsal_status_t status = {ERR_FSAL_NO_ERROR, 0};
+	size_t buffer_size = 0;
+	uint64_t pos = offset;
+	int i;
 
 	if (info != NULL) {
 		/* Currently we don't support WRITE_PLUS */
@@ -1658,17 +1924,23 @@ fsal_status_t mem_write2(struct fsal_obj_handle *obj_hdl,
 		return status;
 	}
 
+	for (i = 0; i < iovcnt; i++)
+		buffer_size += iov[i].iov_len;
+
 	if (offset + buffer_size > myself->attrs.filesize) {
 		myself->attrs.filesize = myself->attrs.spaceused =
 			offset + buffer_size;
 	}
 
-	if (offset < myself->datasize) {
-		size_t writesize;
+	mem_extent_add(myself, offset, buffer_size);
+
+	/* Scatter into the space there is */
+	for (i = 0; i < iovcnt && pos < myself->datasize; i++) {
+		size_t writesize = MIN(iov[i].iov_len,
+				       myself->datasize - pos);
 
-		/* Space to write */
-		writesize = MIN(buffer_size, myself->datasize - offset);
-		memcpy(myself->data + offset, buffer, writesize);
+		memcpy(myself->data + pos, iov[i].iov_base, writesize);
+		pos += iov[i].iov_len;
 	}
 
 #ifdef USE_LTTNG
@@ -1691,6 +1963,173 @@ fsal_status_t mem_write2(struct fsal_obj_handle *obj_hdl,
 	return fsalstat(ERR_FSAL_NO_ERROR, 0);
 }
 
+/**
+ * @brief Write data to a file
+ *
+ * This function writes data to a file. The FSAL must be able to
+ * perform the write whether a state is presented or not. This function also
+ * is expected to handle properly bypassing or not share reservations. Even
+ * with bypass == true, it will enforce a mandatory (NFSv4) deny_write if
+ * an appropriate state is not passed).
+ *
+ * The FSAL is expected to enforce sync if necessary.
+ *
+ * @param[in]     obj_hdl        File on which to operate
+ * @param[in]     bypass         If state doesn't indicate a share reservation,
+ *                               bypass any non-mandatory deny write
+ * @param[in]     state          state_t to use for this operation
+ * @param[in]     offset         Position at which to write
+ * @param[in]     buffer         Data to be written
+ * @param[in,out] fsal_stable    In, if on, the fsal is requested to write data
+ *                               to stable store. Out, the fsal reports what
+ *                               it did.
+ * @param[in,out] info           more information about the data
+ *
+ * @return FSAL status.
+ */
+
+fsal_status_t mem_write2(struct fsal_obj_handle *obj_hdl,
+			 bool bypass,
+			 struct state_t *state,
+			 uint64_t offset,
+			 size_t buffer_size,
+			 void *buffer,
+			 size_t *wrote_amount,
+			 bool *fsal_stable,
+			 struct io_info *info)
+{
+	struct iovec iov = {
+		.iov_base = buffer,
+		.iov_len = buffer_size
+	};
+
+	return mem_writev2(obj_hdl, bypass, state, offset, &iov, 1,
+			   wrote_amount, fsal_stable, info);
+}
+
+/**
+ * @brief Seek to data or hole
+ *
+ * Data and holes come from the file's extent map.  There is an implied
+ * hole at the end of the file.
+ *
+ * @param[in]     obj_hdl   File on which to operate
+ * @param[in]     state     state_t to use for this operation
+ * @param[in,out] info      Information about the data
+ *
+ * @return FSAL status.
+ */
+
+fsal_status_t mem_seek2(struct fsal_obj_handle *obj_hdl,
+			struct state_t *state,
+			struct io_info *info)
+{
+	struct mem_fsal_obj_handle *myself = container_of(obj_hdl,
+				  struct mem_fsal_obj_handle, obj_handle);
+	uint64_t offset = info->io_content.hole.di_offset;
+	uint64_t filesize = myself->attrs.filesize;
+	uint64_t ext_start, ext_end;
+	bool found;
+
+	if (obj_hdl->type != REGULAR_FILE)
+		return fsalstat(ERR_FSAL_INVAL, 0);
+
+	if (offset >= filesize)
+		return fsalstat(ERR_FSAL_NXIO, 0);
+
+	found = mem_extent_next(myself, offset, &ext_start, &ext_end);
+
+	switch (info->io_content.what) {
+	case NFS4_CONTENT_DATA:
+		if (!found || ext_start >= filesize)
+			return fsalstat(ERR_FSAL_NXIO, 0);
+		offset = MAX(offset, ext_start);
+		break;
+	case NFS4_CONTENT_HOLE:
+		if (found && ext_start <= offset)
+			offset = MIN(ext_end, filesize);
+		break;
+	default:
+		return fsalstat(ERR_FSAL_UNION_NOTSUPP, 0);
+	}
+
+	info->io_eof = offset >= filesize;
+	info->io_content.hole.di_offset = offset;
+
+	return fsalstat(ERR_FSAL_NO_ERROR, 0);
+}
+
+/**
+ * @brief Reserve or free space in a file
+ *
+ * Allocating zeroes the holes in the range and adds it to the file's
+ * extent map, and punching takes it out and zeroes what is kept of it.
+ * Space used is the sum of the extents.
+ *
+ * @param[in] obj_hdl   File on which to operate
+ * @param[in] state     state_t to use for this operation
+ * @param[in] offset    Start of the range
+ * @param[in] length    Length of the range
+ * @param[in] allocate  true to reserve the range, false to punch it out
+ *
+ * @return FSAL status.
+ */
+
+fsal_status_t mem_fallocate(struct fsal_obj_handle *obj_hdl,
+			    struct state_t *state,
+			    uint64_t offset,
+			    uint64_t length,
+			    bool allocate)
+{
+	struct mem_fsal_obj_handle *myself = container_of(obj_hdl,
+				  struct mem_fsal_obj_handle, obj_handle);
+	struct fsal_fd *fsal_fd;
+	bool has_lock, closefd = false;
+	fsal_status_t status;
+	uint64_t end = offset + length;
+	uint64_t kept = MIN(end, myself->datasize);
+
+	if (obj_hdl->type != REGULAR_FILE)
+		return fsalstat(ERR_FSAL_INVAL, 0);
+
+	/* Find an FD */
+	status = fsal_find_fd(&fsal_fd, obj_hdl, &myself->mh_file.fd,
+			      &myself->mh_file.share, false, state,
+			      FSAL_O_WRITE, mem_open_func, mem_close_func,
+			      &has_lock, &closefd, false);
+	if (FSAL_IS_ERROR(status))
+		return status;
+
+	if (allocate) {
+		/* Holes keep whatever was there before, truncated or
+		 * punched, so zero them before they become data.
+		 */
+		if (offset < kept)
+			mem_extent_zero_holes(myself, myself->data + offset,
+					      offset, kept - offset);
+		mem_extent_add(myself, offset, length);
+		if (end > myself->attrs.filesize)
+			myself->attrs.filesize = end;
+	} else {
+		mem_extent_punch(myself, offset, length);
+		if (offset < kept)
+			memset(myself->data + offset, 0, kept - offset);
+	}
+
+	myself->attrs.spaceused = mem_extent_used(myself);
+
+	/* Update change stats */
+	now(&myself->attrs.mtime);
+	myself->attrs.chgtime = myself->attrs.mtime;
+	myself->attrs.change =
+		timespec_to_nsecs(&myself->attrs.chgtime);
+
+	if (has_lock)
+		PTHREAD_RWLOCK_unlock(&obj_hdl->obj_lock);
+
+	return fsalstat(ERR_FSAL_NO_ERROR, 0);
+}
+
 /**
  * @brief Commit written data
  *
@@ -1937,6 +2376,8 @@ static void mem_release(struct fsal_obj_handle *obj_hdl)
 		mem_clean_dir_tree(myself);
 		break;
 	case REGULAR_FILE:
+		gsh_free(myself->mh_file.extents);
+		PTHREAD_MUTEX_destroy(&myself->mh_file.extent_mutex);
 		break;
 	case SYMBOLIC_LINK:
 		gsh_free(myself->mh_symlink.link_contents);
@@ -1973,9 +2414,12 @@ void mem_handle_ops_init(struct fsal_obj_ops *ops)
 	ops->reopen2 = mem_reopen2;
 	ops->read2 = mem_read2;
 	ops->write2 = mem_write2;
+	ops->seek2 = mem_seek2;
 	ops->commit2 = mem_commit2;
 	ops->lock_op2 = mem_lock_op2;
 	ops->close2 = mem_close2;
+	ops->writev2 = mem_writev2;
+	ops->fallocate = mem_fallocate;
 	ops->handle_to_wire = mem_handle_to_wire;
 	ops->handle_to_key = mem_handle_to_key;
 }
@@ -69,6 +69,12 @@ fsal_status_t mem_create_handle(struct fsal_export *exp_hdl,
 
 #define V4_FH_OPAQUE_SIZE 58 /* Size of state_obj digest */
 
+/* A written range of a file, the rest of the file is a hole */
+struct mem_extent {
+	uint64_t offset;
+	uint64_t length;
+};
+
 struct mem_fsal_obj_handle {
 	struct fsal_obj_handle obj_handle;
 	struct attrlist attrs;
@@ -85,6 +91,10 @@ struct mem_fsal_obj_handle {
 		struct {
 			struct fsal_share share;
 			struct fsal_fd fd;
+			pthread_mutex_t extent_mutex;
+			struct mem_extent *extents; /*< Sorted and disjoint */
+			uint32_t num_extents;
+			uint32_t max_extents;
 		} mh_file;
 		struct {
 			object_file_type_t nodetype;
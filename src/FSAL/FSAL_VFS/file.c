@@ -962,6 +962,65 @@ fsal_status_t find_fd(int *fd,
 	return status;
 }
 
+/**
+ * @brief Find what READ_PLUS returns at an offset
+ *
+ * If offset is in a hole, the hole up to the next data, the end of
+ * file or size is reported in info.  Otherwise size is cut to end at
+ * the next hole and info says data, to be read by the caller.  A
+ * filesystem without SEEK_DATA has no holes.
+ *
+ * @param[in]     fd          File descriptor
+ * @param[in]     offset      Position from which to read
+ * @param[in,out] size        Amount of data to read
+ * @param[out]    read_amount Length of the hole
+ * @param[out]    eof         true if the hole ends the file
+ * @param[out]    info        What there is at offset
+ *
+ * @return FSAL status.
+ */
+
+static fsal_status_t vfs_read_plus_extent(int fd, uint64_t offset,
+					  size_t *size, size_t *read_amount,
+					  bool *eof, struct io_info *info)
+{
+	off_t data, hole;
+	struct stat st;
+	int retval;
+
+	info->io_content.what = NFS4_CONTENT_DATA;
+
+	data = lseek(fd, offset, SEEK_DATA);
+	if (data == -1 && errno != ENXIO)
+		return fsalstat(ERR_FSAL_NO_ERROR, 0);
+
+	if (data == (off_t) offset) {
+		hole = lseek(fd, offset, SEEK_HOLE);
+		if (hole > data && (uint64_t) (hole - data) < *size)
+			*size = hole - data;
+		return fsalstat(ERR_FSAL_NO_ERROR, 0);
+	}
+
+	/* A hole up to data, or up to the end of the file */
+	if (fstat(fd, &st) == -1) {
+		retval = errno;
+		return fsalstat(posix2fsal_error(retval), retval);
+	}
+	if (data == -1)
+		data = st.st_size;
+	if ((uint64_t) data <= offset) {
+		/* At or beyond the end of file, pread will say so */
+		return fsalstat(ERR_FSAL_NO_ERROR, 0);
+	}
+
+	info->io_content.what = NFS4_CONTENT_HOLE;
+	info->io_content.hole.di_offset = offset;
+	info->io_content.hole.di_length = MIN(data - offset, *size);
+	*read_amount = info->io_content.hole.di_length;
+	*eof = offset + *read_amount >= (uint64_t) st.st_size;
+	return fsalstat(ERR_FSAL_NO_ERROR, 0);
+}
+
 /**
  * @brief Read data from a file
  *
@@ -1000,11 +1059,6 @@ fsal_status_t vfs_read2(struct fsal_obj_handle *obj_hdl,
 	bool has_lock = false;
 	bool closefd = false;
 
-	if (info != NULL) {
-		/* Currently we don't support READ_PLUS */
-		return fsalstat(ERR_FSAL_NOTSUPP, 0);
-	}
-
 	if (obj_hdl->fsal != obj_hdl->fs->fsal) {
 		LogDebug(COMPONENT_FSAL,
 			 "FSAL %s operation for handle belonging to FSAL %s, return EXDEV",
@@ -1019,6 +1073,15 @@ fsal_status_t vfs_read2(struct fsal_obj_handle *obj_hdl,
 	if (FSAL_IS_ERROR(status))
 		goto out;
 
+	if (info != NULL) {
+		/* READ_PLUS, stop at the next hole or report this one */
+		status = vfs_read_plus_extent(my_fd, offset, &buffer_size,
+					      read_amount, end_of_file, info);
+		if (FSAL_IS_ERROR(status) ||
+		    info->io_content.what == NFS4_CONTENT_HOLE)
+			goto out;
+	}
+
 	nb_read = pread(my_fd, buffer, buffer_size, offset);
 
 	if (offset == -1 || nb_read == -1) {
@@ -1031,21 +1094,12 @@ fsal_status_t vfs_read2(struct fsal_obj_handle *obj_hdl,
 
 	*end_of_file = (nb_read == 0);
 
-#if 0
-	/** @todo
-	 *
-	 * Is this all we really need to do to support READ_PLUS? Will anyone
-	 * ever get upset that we don't return holes, even for blocks of all
-	 * zeroes?
-	 *
-	 */
 	if (info != NULL) {
 		info->io_content.what = NFS4_CONTENT_DATA;
-		info->io_content.data.d_offset = offset + nb_read;
+		info->io_content.data.d_offset = offset;
 		info->io_content.data.d_data.data_len = nb_read;
 		info->io_content.data.d_data.data_val = buffer;
 	}
-#endif
 
  out:
 
@@ -1092,6 +1146,46 @@ fsal_status_t vfs_write2(struct fsal_obj_handle *obj_hdl,
 			 size_t *wrote_amount,
 			 bool *fsal_stable,
 			 struct io_info *info)
+{
+	struct iovec iov = {
+		.iov_base = buffer,
+		.iov_len = buffer_size
+	};
+
+	return vfs_writev2(obj_hdl, bypass, state, offset, &iov, 1,
+			   wrote_amount, fsal_stable, info);
+}
+
+/**
+ * @brief Write data to a file from an array of buffers
+ *
+ * The buffers go to the kernel as they are, with pwritev.
+ *
+ * @param[in]     obj_hdl        File on which to operate
+ * @param[in]     bypass         If state doesn't indicate a share reservation,
+ *                               bypass any non-mandatory deny write
+ * @param[in]     state          state_t to use for this operation
+ * @param[in]     offset         Position at which to write
+ * @param[in]     iov            Data to be written
+ * @param[in]     iovcnt         Number of buffers in iov
+ * @param[out]    wrote_amount   Amount of data written
+ * @param[in,out] fsal_stable    In, if on, the fsal is requested to write data
+ *                               to stable store. Out, the fsal reports what
+ *                               it did.
+ * @param[in,out] info           more information about the data
+ *
+ * @return FSAL status.
+ */
+
+fsal_status_t vfs_writev2(struct fsal_obj_handle *obj_hdl,
+			  bool bypass,
+			  struct state_t *state,
+			  uint64_t offset,
+			  const struct iovec *iov,
+			  int iovcnt,
+			  size_t *wrote_amount,
+			  bool *fsal_stable,
+			  struct io_info *info)
 {
 	ssize_t nb_written;
 	fsal_status_t status;
@@ -1125,7 +1219,7 @@ fsal_status_t vfs_write2(struct fsal_obj_handle *obj_hdl,
 
 	fsal_set_credentials(op_ctx->creds);
 
-	nb_written = pwrite(my_fd, buffer, buffer_size, offset);
+	nb_written = pwritev(my_fd, iov, iovcnt, offset);
 
 	if (nb_written == -1) {
 		retval = errno;
@@ -1155,6 +1249,389 @@ fsal_status_t vfs_write2(struct fsal_obj_handle *obj_hdl,
 	return status;
 }
 
+/**
+ * @brief Seek to data or hole
+ *
+ * A filesystem without SEEK_DATA has one data extent up to the end of
+ * file, as the kernel makes it look for lseek.
+ *
+ * @param[in]     obj_hdl   File on which to operate
+ * @param[in]     state     state_t to use for this operation
+ * @param[in,out] info      Information about the data
+ *
+ * @return FSAL status.
+ */
+
+fsal_status_t vfs_seek2(struct fsal_obj_handle *obj_hdl,
+			struct state_t *state,
+			struct io_info *info)
+{
+	off_t offset = info->io_content.hole.di_offset;
+	int my_fd = -1;
+	fsal_status_t status;
+	bool has_lock = false;
+	bool closefd = false;
+	struct stat st;
+	int whence;
+	off_t pos;
+	int retval;
+
+	switch (info->io_content.what) {
+	case NFS4_CONTENT_DATA:
+		whence = SEEK_DATA;
+		break;
+	case NFS4_CONTENT_HOLE:
+		whence = SEEK_HOLE;
+		break;
+	default:
+		return fsalstat(ERR_FSAL_UNION_NOTSUPP, 0);
+	}
+
+	if (obj_hdl->fsal != obj_hdl->fs->fsal) {
+		LogDebug(COMPONENT_FSAL,
+			 "FSAL %s operation for handle belonging to FSAL %s, return EXDEV",
+			 obj_hdl->fsal->name, obj_hdl->fs->fsal->name);
+		return fsalstat(posix2fsal_error(EXDEV), EXDEV);
+	}
+
+	/* Get a usable file descriptor */
+	status = find_fd(&my_fd, obj_hdl, false, state, FSAL_O_ANY,
+			 &has_lock, &closefd, false);
+
+	if (FSAL_IS_ERROR(status))
+		goto out;
+
+	if (fstat(my_fd, &st) == -1) {
+		retval = errno;
+		status = fsalstat(posix2fsal_error(retval), retval);
+		goto out;
+	}
+
+	pos = lseek(my_fd, offset, whence);
+	if (pos == -1 && errno == EINVAL && offset >= 0) {
+		/* No SEEK_DATA here */
+		pos = whence == SEEK_DATA ? offset : st.st_size;
+		if (offset >= st.st_size)
+			pos = -1;
+		errno = ENXIO;
+	}
+
+	if (pos == -1) {
+		retval = errno;
+		status = fsalstat(posix2fsal_error(retval), retval);
+		goto out;
+	}
+
+	info->io_eof = pos >= st.st_size;
+	info->io_content.hole.di_offset = pos;
+
+ out:
+
+	if (closefd)
+		close(my_fd);
+
+	if (has_lock)
+		PTHREAD_RWLOCK_unlock(&obj_hdl->obj_lock);
+
+	return status;
+}
+
+/**
+ * @brief Find the file descriptors for a copy or clone
+ *
+ * A file copied onto itself with one state gets one read-write
+ * descriptor.  With two states, each may have its own descriptor, but
+ * where the source would use the global one, under the handle's lock,
+ * that lock is dropped again and one read-write descriptor found for
+ * both: the destination's lookup could need the lock for write to
+ * reopen the global descriptor, and would wait on itself.
+ *
+ * @param[in]  src_hdl    File to read
+ * @param[in]  src_state  state_t to read with
+ * @param[in]  dst_hdl    File to write
+ * @param[in]  dst_state  state_t to write with
+ * @param[out] fd         Descriptors for src_hdl and dst_hdl
+ * @param[out] has_lock   Whether each handle's lock is held
+ * @param[out] closefd    Whether each descriptor must be closed
+ *
+ * @return FSAL status.
+ */
+
+static fsal_status_t find_copy_fds(struct fsal_obj_handle *src_hdl,
+				   struct state_t *src_state,
+				   struct fsal_obj_handle *dst_hdl,
+				   struct state_t *dst_state,
+				   int fd[2], bool has_lock[2], bool closefd[2])
+{
+	fsal_status_t status;
+
+	if (src_hdl->fsal != src_hdl->fs->fsal ||
+	    dst_hdl->fsal != dst_hdl->fs->fsal) {
+		LogDebug(COMPONENT_FSAL,
+			 "FSAL %s operation for handle belonging to FSAL %s, return EXDEV",
+			 src_hdl->fsal->name, src_hdl->fs->fsal->name);
+		return fsalstat(posix2fsal_error(EXDEV), EXDEV);
+	}
+
+	if (src_hdl == dst_hdl && src_state == dst_state) {
+		status = find_fd(&fd[0], src_hdl, false, src_state,
+				 FSAL_O_RDWR, &has_lock[0], &closefd[0],
+				 false);
+		fd[1] = fd[0];
+		return status;
+	}
+
+	status = find_fd(&fd[0], src_hdl, false, src_state, FSAL_O_READ,
+			 &has_lock[0], &closefd[0], false);
+	if (FSAL_IS_ERROR(status))
+		return status;
+
+	if (src_hdl == dst_hdl && has_lock[0]) {
+		if (closefd[0])
+			close(fd[0]);
+		PTHREAD_RWLOCK_unlock(&src_hdl->obj_lock);
+		closefd[0] = has_lock[0] = false;
+
+		status = find_fd(&fd[0], dst_hdl, false, dst_state,
+				 FSAL_O_RDWR, &has_lock[0], &closefd[0],
+				 false);
+		fd[1] = fd[0];
+		return status;
+	}
+
+	return find_fd(&fd[1], dst_hdl, false, dst_state, FSAL_O_WRITE,
+		       &has_lock[1], &closefd[1], false);
+}
+
+static void release_copy_fds(struct fsal_obj_handle *src_hdl,
+			     struct fsal_obj_handle *dst_hdl,
+			     int fd[2], bool has_lock[2], bool closefd[2])
+{
+	if (closefd[0])
+		close(fd[0]);
+	if (closefd[1])
+		close(fd[1]);
+	if (has_lock[0])
+		PTHREAD_RWLOCK_unlock(&src_hdl->obj_lock);
+	if (has_lock[1])
+		PTHREAD_RWLOCK_unlock(&dst_hdl->obj_lock);
+}
+
+/* Buffer for copies the kernel can't do between two files */
+#define VFS_COPY_CHUNK (1024 * 1024)
+
+/**
+ * @brief Copy a range of one file to another
+ *
+ * The kernel copies with copy_file_range(), which shares the blocks
+ * on filesystems that can.  Where it can't copy between the two files
+ * the data goes through a buffer here, which still saves the trip to
+ * the client and back.
+ *
+ * @param[in]  src_hdl     File to copy from
+ * @param[in]  src_state   state_t to read src_hdl with
+ * @param[in]  src_offset  Position in src_hdl to copy from
+ * @param[in]  dst_hdl     File to copy to
+ * @param[in]  dst_state   state_t to write dst_hdl with
+ * @param[in]  dst_offset  Position in dst_hdl to copy to
+ * @param[in]  count       Number of bytes to copy
+ * @param[out] copied      Number of bytes copied
+ *
+ * @return FSAL status.
+ */
+
+fsal_status_t vfs_copy2(struct fsal_obj_handle *src_hdl,
+			struct state_t *src_state,
+			uint64_t src_offset,
+			struct fsal_obj_handle *dst_hdl,
+			struct state_t *dst_state,
+			uint64_t dst_offset,
+			uint64_t count,
+			uint64_t *copied)
+{
+	int fd[2] = {-1, -1};
+	bool has_lock[2] = {false, false};
+	bool closefd[2] = {false, false};
+	fsal_status_t status;
+	char *buffer;
+	ssize_t nb = 0;
+	int retval = 0;
+
+	*copied = 0;
+
+	status = find_copy_fds(src_hdl, src_state, dst_hdl, dst_state,
+			       fd, has_lock, closefd);
+	if (FSAL_IS_ERROR(status))
+		goto out;
+
+	fsal_set_credentials(op_ctx->creds);
+
+	while (*copied < count) {
+		nb = vfs_copy_range(fd[0], src_offset + *copied,
+				    fd[1], dst_offset + *copied,
+				    count - *copied);
+		if (nb <= 0)
+			break;
+		*copied += nb;
+	}
+	if (nb < 0)
+		retval = errno;
+
+	if (nb < 0 && *copied == 0 &&
+	    (retval == ENOSYS || retval == EXDEV || retval == EINVAL ||
+	     retval == EOPNOTSUPP)) {
+		/* Not between these files, copy it ourselves */
+		buffer = gsh_malloc(MIN(count, VFS_COPY_CHUNK));
+		nb = 0;
+		while (*copied < count) {
+			nb = pread(fd[0], buffer,
+				   MIN(count - *copied, VFS_COPY_CHUNK),
+				   src_offset + *copied);
+			if (nb <= 0)
+				break;
+			nb = pwrite(fd[1], buffer, nb, dst_offset + *copied);
+			if (nb <= 0)
+				break;
+			*copied += nb;
+		}
+		retval = nb < 0 ? errno : 0;
+		gsh_free(buffer);
+	}
+
+	fsal_restore_ganesha_credentials();
+
+	/* What was copied before an error is reported */
+	if (retval != 0 && *copied == 0)
+		status = fsalstat(posix2fsal_error(retval), retval);
+
+ out:
+
+	release_copy_fds(src_hdl, dst_hdl, fd, has_lock, closefd);
+
+	return status;
+}
+
+/**
+ * @brief Share a range of one file's blocks with another
+ *
+ * This is the FICLONERANGE ioctl, for filesystems such as XFS and
+ * Btrfs that share extents.
+ *
+ * @param[in]  src_hdl     File to clone from
+ * @param[in]  src_state   state_t to read src_hdl with
+ * @param[in]  src_offset  Position in src_hdl to clone from
+ * @param[in]  dst_hdl     File to clone to
+ * @param[in]  dst_state   state_t to write dst_hdl with
+ * @param[in]  dst_offset  Position in dst_hdl to clone to
+ * @param[in]  count       Number of bytes to clone
+ *
+ * @return FSAL status.
+ */
+
+fsal_status_t vfs_clone2(struct fsal_obj_handle *src_hdl,
+			 struct state_t *src_state,
+			 uint64_t src_offset,
+			 struct fsal_obj_handle *dst_hdl,
+			 struct state_t *dst_state,
+			 uint64_t dst_offset,
+			 uint64_t count)
+{
+	int fd[2] = {-1, -1};
+	bool has_lock[2] = {false, false};
+	bool closefd[2] = {false, false};
+	fsal_status_t status;
+	int retval;
+
+	status = find_copy_fds(src_hdl, src_state, dst_hdl, dst_state,
+			       fd, has_lock, closefd);
+	if (FSAL_IS_ERROR(status))
+		goto out;
+
+	fsal_set_credentials(op_ctx->creds);
+
+	if (vfs_clone_range(fd[0], src_offset, fd[1], dst_offset,
+			    count) == -1) {
+		retval = errno;
+		/* ENOTTY and EXDEV say the filesystem can't */
+		if (retval == ENOTTY || retval == EXDEV ||
+		    retval == EOPNOTSUPP)
+			status = fsalstat(ERR_FSAL_NOTSUPP, retval);
+		else
+			status = fsalstat(posix2fsal_error(retval), retval);
+	}
+
+	fsal_restore_ganesha_credentials();
+
+ out:
+
+	release_copy_fds(src_hdl, dst_hdl, fd, has_lock, closefd);
+
+	return status;
+}
+
+/**
+ * @brief Reserve or free space in a file
+ *
+ * This is fallocate, with FALLOC_FL_PUNCH_HOLE to free.
+ *
+ * @param[in] obj_hdl   File on which to operate
+ * @param[in] state     state_t to use for this operation
+ * @param[in] offset    Start of the range
+ * @param[in] length    Length of the range
+ * @param[in] allocate  true to reserve the range, false to punch it out
+ *
+ * @return FSAL status.
+ */
+
+fsal_status_t vfs_fallocate(struct fsal_obj_handle *obj_hdl,
+			    struct state_t *state,
+			    uint64_t offset,
+			    uint64_t length,
+			    bool allocate)
+{
+	fsal_status_t status;
+	int retval = 0;
+	int my_fd = -1;
+	bool has_lock = false;
+	bool closefd = false;
+
+	if (obj_hdl->fsal != obj_hdl->fs->fsal) {
+		LogDebug(COMPONENT_FSAL,
+			 "FSAL %s operation for handle belonging to FSAL %s, return EXDEV",
+			 obj_hdl->fsal->name, obj_hdl->fs->fsal->name);
+		return fsalstat(posix2fsal_error(EXDEV), EXDEV);
+	}
+
+	/* Get a usable file descriptor */
+	status = find_fd(&my_fd, obj_hdl, false, state, FSAL_O_WRITE,
+			 &has_lock, &closefd, false);
+
+	if (FSAL_IS_ERROR(status)) {
+		LogDebug(COMPONENT_FSAL,
+			 "find_fd failed %s", msg_fsal_err(status.major));
+		goto out;
+	}
+
+	fsal_set_credentials(op_ctx->creds);
+
+	if (vfs_alloc_range(my_fd, offset, length, !allocate) == -1) {
+		retval = errno;
+		status = fsalstat(posix2fsal_error(retval), retval);
+	}
+
+	fsal_restore_ganesha_credentials();
+
+ out:
+
+	if (closefd)
+		close(my_fd);
+
+	if (has_lock)
+		PTHREAD_RWLOCK_unlock(&obj_hdl->obj_lock);
+
+	return status;
+}
+
 /**
  * @brief Commit written data
  *
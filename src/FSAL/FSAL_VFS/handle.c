@@ -1727,10 +1727,15 @@ void vfs_handle_ops_init(struct fsal_obj_ops *ops)
 	ops->reopen2 = vfs_reopen2;
 	ops->read2 = vfs_read2;
 	ops->write2 = vfs_write2;
+	ops->seek2 = vfs_seek2;
+	ops->copy2 = vfs_copy2;
+	ops->clone2 = vfs_clone2;
+	ops->fallocate = vfs_fallocate;
 	ops->commit2 = vfs_commit2;
 	ops->lock_op2 = vfs_lock_op2;
 	ops->setattr2 = vfs_setattr2;
 	ops->close2 = vfs_close2;
+	ops->writev2 = vfs_writev2;
 
 	/* xattr related functions */
 	ops->list_ext_attrs = vfs_list_ext_attrs;
@@ -894,6 +894,179 @@ fsal_status_t mdcache_write2(struct fsal_obj_handle *obj_hdl,
 	return status;
 }
 
+/**
+ * @brief Write from an array of buffers
+ *
+ * Delegate to sub-FSAL
+ *
+ * @param[in] obj_hdl	Object owning state
+ * @param[in] bypass	Bypass any non-mandatory deny write
+ * @param[in] state	Open file state to write
+ * @param[in] offset	Offset into file
+ * @param[in] iov	Buffers to write from
+ * @param[in] iovcnt	Number of buffers
+ * @param[out] write_amount	Amount written in bytes
+ * @param[out] fsal_stable	true if write was to stable storage
+ * @param[in] info	io_info for WRITE_PLUS
+ * @return FSAL status
+ */
+fsal_status_t mdcache_writev2(struct fsal_obj_handle *obj_hdl,
+			      bool bypass,
+			      struct state_t *state,
+			      uint64_t offset,
+			      const struct iovec *iov,
+			      int iovcnt,
+			      size_t *write_amount,
+			      bool *fsal_stable,
+			      struct io_info *info)
+{
+	mdcache_entry_t *entry =
+		container_of(obj_hdl, mdcache_entry_t, obj_handle);
+	fsal_status_t status;
+
+	subcall(
+		status = entry->sub_handle->obj_ops.writev2(
+			entry->sub_handle, bypass, state, offset, iov, iovcnt,
+			write_amount, fsal_stable, info)
+	       );
+
+	if (status.major == ERR_FSAL_STALE)
+		mdcache_kill_entry(entry);
+	else
+		atomic_clear_uint32_t_bits(&entry->mde_flags,
+					   MDCACHE_TRUST_ATTRS);
+
+	return status;
+}
+
+/**
+ * @brief Copy a range of one file to another
+ *
+ * Delegate to sub-FSAL
+ *
+ * @param[in] src_hdl	File to copy from
+ * @param[in] src_state	Open file state to read
+ * @param[in] src_offset	Offset into source
+ * @param[in] dst_hdl	File to copy to
+ * @param[in] dst_state	Open file state to write
+ * @param[in] dst_offset	Offset into destination
+ * @param[in] count	Number of bytes to copy
+ * @param[out] copied	Number of bytes copied
+ * @return FSAL status
+ */
+fsal_status_t mdcache_copy2(struct fsal_obj_handle *src_hdl,
+			    struct state_t *src_state,
+			    uint64_t src_offset,
+			    struct fsal_obj_handle *dst_hdl,
+			    struct state_t *dst_state,
+			    uint64_t dst_offset,
+			    uint64_t count,
+			    uint64_t *copied)
+{
+	mdcache_entry_t *src =
+		container_of(src_hdl, mdcache_entry_t, obj_handle);
+	mdcache_entry_t *dst =
+		container_of(dst_hdl, mdcache_entry_t, obj_handle);
+	fsal_status_t status;
+
+	subcall(
+		status = src->sub_handle->obj_ops.copy2(
+			src->sub_handle, src_state, src_offset,
+			dst->sub_handle, dst_state, dst_offset, count, copied)
+	       );
+
+	if (status.major == ERR_FSAL_STALE) {
+		mdcache_kill_entry(src);
+		mdcache_kill_entry(dst);
+	} else {
+		atomic_clear_uint32_t_bits(&dst->mde_flags,
+					   MDCACHE_TRUST_ATTRS);
+	}
+
+	return status;
+}
+
+/**
+ * @brief Clone a range of one file to another
+ *
+ * Delegate to sub-FSAL
+ *
+ * @param[in] src_hdl	File to clone from
+ * @param[in] src_state	Open file state to read
+ * @param[in] src_offset	Offset into source
+ * @param[in] dst_hdl	File to clone to
+ * @param[in] dst_state	Open file state to write
+ * @param[in] dst_offset	Offset into destination
+ * @param[in] count	Number of bytes to clone
+ * @return FSAL status
+ */
+fsal_status_t mdcache_clone2(struct fsal_obj_handle *src_hdl,
+			     struct state_t *src_state,
+			     uint64_t src_offset,
+			     struct fsal_obj_handle *dst_hdl,
+			     struct state_t *dst_state,
+			     uint64_t dst_offset,
+			     uint64_t count)
+{
+	mdcache_entry_t *src =
+		container_of(src_hdl, mdcache_entry_t, obj_handle);
+	mdcache_entry_t *dst =
+		container_of(dst_hdl, mdcache_entry_t, obj_handle);
+	fsal_status_t status;
+
+	subcall(
+		status = src->sub_handle->obj_ops.clone2(
+			src->sub_handle, src_state, src_offset,
+			dst->sub_handle, dst_state, dst_offset, count)
+	       );
+
+	if (status.major == ERR_FSAL_STALE) {
+		mdcache_kill_entry(src);
+		mdcache_kill_entry(dst);
+	} else {
+		atomic_clear_uint32_t_bits(&dst->mde_flags,
+					   MDCACHE_TRUST_ATTRS);
+	}
+
+	return status;
+}
+
+/**
+ * @brief Reserve or free space in a file
+ *
+ * Delegate to sub-FSAL
+ *
+ * @param[in] obj_hdl	File to operate on
+ * @param[in] state	Open file state to write
+ * @param[in] offset	Start of the range
+ * @param[in] length	Length of the range
+ * @param[in] allocate	true to reserve, false to punch a hole
+ * @return FSAL status
+ */
+fsal_status_t mdcache_fallocate(struct fsal_obj_handle *obj_hdl,
+				struct state_t *state,
+				uint64_t offset,
+				uint64_t length,
+				bool allocate)
+{
+	mdcache_entry_t *entry =
+		container_of(obj_hdl, mdcache_entry_t, obj_handle);
+	fsal_status_t status;
+
+	subcall(
+		status = entry->sub_handle->obj_ops.fallocate(
+			entry->sub_handle, state, offset, length, allocate)
+	       );
+
+	if (status.major == ERR_FSAL_STALE)
+		mdcache_kill_entry(entry);
+	else
+		atomic_clear_uint32_t_bits(&entry->mde_flags,
+					   MDCACHE_TRUST_ATTRS);
+
+	return status;
+}
+
 /**
  * @brief Seek within a file (new style)
  *
@@ -1779,6 +1779,10 @@ void mdcache_handle_ops_init(struct fsal_obj_ops *ops)
 	ops->lock_op2 = mdcache_lock_op2;
 	ops->setattr2 = mdcache_setattr2;
 	ops->close2 = mdcache_close2;
+	ops->writev2 = mdcache_writev2;
+	ops->copy2 = mdcache_copy2;
+	ops->clone2 = mdcache_clone2;
+	ops->fallocate = mdcache_fallocate;
 
 	/* xattr related functions */
 	ops->list_ext_attrs = mdcache_list_ext_attrs;
@@ -394,6 +394,123 @@ fsal_status_t nullfs_write2(struct fsal_obj_handle *obj_hdl,
 	return status;
 }
 
+fsal_status_t nullfs_writev2(struct fsal_obj_handle *obj_hdl,
+			     bool bypass,
+			     struct state_t *state,
+			     uint64_t offset,
+			     const struct iovec *iov,
+			     int iovcnt,
+			     size_t *write_amount,
+			     bool *fsal_stable,
+			     struct io_info *info)
+{
+	struct nullfs_fsal_obj_handle *handle =
+		container_of(obj_hdl, struct nullfs_fsal_obj_handle,
+			     obj_handle);
+
+	struct nullfs_fsal_export *export =
+		container_of(op_ctx->fsal_export, struct nullfs_fsal_export,
+			     export);
+
+	/* calling subfsal method */
+	op_ctx->fsal_export = export->export.sub_export;
+	fsal_status_t status =
+		handle->sub_handle->obj_ops.writev2(handle->sub_handle, bypass,
+						    state, offset, iov, iovcnt,
+						    write_amount, fsal_stable,
+						    info);
+	op_ctx->fsal_export = &export->export;
+
+	return status;
+}
+
+fsal_status_t nullfs_copy2(struct fsal_obj_handle *src_hdl,
+			   struct state_t *src_state,
+			   uint64_t src_offset,
+			   struct fsal_obj_handle *dst_hdl,
+			   struct state_t *dst_state,
+			   uint64_t dst_offset,
+			   uint64_t count,
+			   uint64_t *copied)
+{
+	struct nullfs_fsal_obj_handle *src =
+		container_of(src_hdl, struct nullfs_fsal_obj_handle,
+			     obj_handle);
+	struct nullfs_fsal_obj_handle *dst =
+		container_of(dst_hdl, struct nullfs_fsal_obj_handle,
+			     obj_handle);
+
+	struct nullfs_fsal_export *export =
+		container_of(op_ctx->fsal_export, struct nullfs_fsal_export,
+			     export);
+
+	/* calling subfsal method */
+	op_ctx->fsal_export = export->export.sub_export;
+	fsal_status_t status =
+		src->sub_handle->obj_ops.copy2(src->sub_handle, src_state,
+					       src_offset, dst->sub_handle,
+					       dst_state, dst_offset, count,
+					       copied);
+	op_ctx->fsal_export = &export->export;
+
+	return status;
+}
+
+fsal_status_t nullfs_clone2(struct fsal_obj_handle *src_hdl,
+			    struct state_t *src_state,
+			    uint64_t src_offset,
+			    struct fsal_obj_handle *dst_hdl,
+			    struct state_t *dst_state,
+			    uint64_t dst_offset,
+			    uint64_t count)
+{
+	struct nullfs_fsal_obj_handle *src =
+		container_of(src_hdl, struct nullfs_fsal_obj_handle,
+			     obj_handle);
+	struct nullfs_fsal_obj_handle *dst =
+		container_of(dst_hdl, struct nullfs_fsal_obj_handle,
+			     obj_handle);
+
+	struct nullfs_fsal_export *export =
+		container_of(op_ctx->fsal_export, struct nullfs_fsal_export,
+			     export);
+
+	/* calling subfsal method */
+	op_ctx->fsal_export = export->export.sub_export;
+	fsal_status_t status =
+		src->sub_handle->obj_ops.clone2(src->sub_handle, src_state,
+						src_offset, dst->sub_handle,
+						dst_state, dst_offset, count);
+	op_ctx->fsal_export = &export->export;
+
+	return status;
+}
+
+fsal_status_t nullfs_fallocate(struct fsal_obj_handle *obj_hdl,
+			       struct state_t *state,
+			       uint64_t offset,
+			       uint64_t length,
+			       bool allocate)
+{
+	struct nullfs_fsal_obj_handle *handle =
+		container_of(obj_hdl, struct nullfs_fsal_obj_handle,
+			     obj_handle);
+
+	struct nullfs_fsal_export *export =
+		container_of(op_ctx->fsal_export, struct nullfs_fsal_export,
+			     export);
+
+	/* calling subfsal method */
+	op_ctx->fsal_export = export->export.sub_export;
+	fsal_status_t status =
+		handle->sub_handle->obj_ops.fallocate(handle->sub_handle,
+						      state, offset, length,
+						      allocate);
+	op_ctx->fsal_export = &export->export;
+
+	return status;
+}
+
 fsal_status_t nullfs_seek2(struct fsal_obj_handle *obj_hdl,
 			   struct state_t *state,
 			   struct io_info *info)
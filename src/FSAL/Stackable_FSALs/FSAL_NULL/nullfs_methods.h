@@ -143,6 +143,35 @@ fsal_status_t nullfs_write2(struct fsal_obj_handle *obj_hdl,
 			    size_t *write_amount,
 			    bool *fsal_stable,
 			    struct io_info *info);
+fsal_status_t nullfs_writev2(struct fsal_obj_handle *obj_hdl,
+			     bool bypass,
+			     struct state_t *state,
+			     uint64_t offset,
+			     const struct iovec *iov,
+			     int iovcnt,
+			     size_t *write_amount,
+			     bool *fsal_stable,
+			     struct io_info *info);
+fsal_status_t nullfs_copy2(struct fsal_obj_handle *src_hdl,
+			   struct state_t *src_state,
+			   uint64_t src_offset,
+			   struct fsal_obj_handle *dst_hdl,
+			   struct state_t *dst_state,
+			   uint64_t dst_offset,
+			   uint64_t count,
+			   uint64_t *copied);
+fsal_status_t nullfs_clone2(struct fsal_obj_handle *src_hdl,
+			    struct state_t *src_state,
+			    uint64_t src_offset,
+			    struct fsal_obj_handle *dst_hdl,
+			    struct state_t *dst_state,
+			    uint64_t dst_offset,
+			    uint64_t count);
+fsal_status_t nullfs_fallocate(struct fsal_obj_handle *obj_hdl,
+			       struct state_t *state,
+			       uint64_t offset,
+			       uint64_t length,
+			       bool allocate);
 fsal_status_t nullfs_seek2(struct fsal_obj_handle *obj_hdl,
 			   struct state_t *state,
 			   struct io_info *info);
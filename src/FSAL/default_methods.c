@@ -1563,6 +1563,133 @@ static fsal_status_t close2(struct fsal_obj_handle *obj_hdl,
 	return fsalstat(ERR_FSAL_NOTSUPP, ENOTSUP);
 }
 
+/* writev2
+ * default case gathers the buffers and calls write2
+ */
+
+static fsal_status_t writev2(struct fsal_obj_handle *obj_hdl,
+			     bool bypass,
+			     struct state_t *state,
+			     uint64_t offset,
+			     const struct iovec *iov,
+			     int iovcnt,
+			     size_t *wrote_amount,
+			     bool *fsal_stable,
+			     struct io_info *info)
+{
+	fsal_status_t status;
+	size_t size = 0;
+	char *buffer;
+	int i;
+
+	if (iovcnt == 1)
+		return obj_hdl->obj_ops.write2(obj_hdl, bypass, state, offset,
+					       iov[0].iov_len, iov[0].iov_base,
+					       wrote_amount, fsal_stable, info);
+
+	for (i = 0; i < iovcnt; i++)
+		size += iov[i].iov_len;
+
+	buffer = gsh_malloc(size);
+	for (i = 0, size = 0; i < iovcnt; i++) {
+		memcpy(buffer + size, iov[i].iov_base, iov[i].iov_len);
+		size += iov[i].iov_len;
+	}
+
+	status = obj_hdl->obj_ops.write2(obj_hdl, bypass, state, offset,
+					 size, buffer, wrote_amount,
+					 fsal_stable, info);
+	gsh_free(buffer);
+	return status;
+}
+
+/* copy2
+ * default case reads and writes through the server in chunks
+ */
+
+#define DEFAULT_COPY_CHUNK (1024 * 1024)
+
+static fsal_status_t copy2(struct fsal_obj_handle *src_hdl,
+			   struct state_t *src_state,
+			   uint64_t src_offset,
+			   struct fsal_obj_handle *dst_hdl,
+			   struct state_t *dst_state,
+			   uint64_t dst_offset,
+			   uint64_t count,
+			   uint64_t *copied)
+{
+	fsal_status_t status = {ERR_FSAL_NO_ERROR, 0};
+	size_t chunk = MIN(count, DEFAULT_COPY_CHUNK);
+	size_t read_amount, wrote_amount;
+	bool eof = false;
+	bool stable;
+	char *buffer;
+
+	*copied = 0;
+	if (count == 0)
+		return status;
+
+	buffer = gsh_malloc(chunk);
+
+	while (*copied < count && !eof) {
+		size_t size = MIN(chunk, count - *copied);
+
+		status = src_hdl->obj_ops.read2(src_hdl, false, src_state,
+						src_offset + *copied, size,
+						buffer, &read_amount, &eof,
+						NULL);
+		if (FSAL_IS_ERROR(status) || read_amount == 0)
+			break;
+
+		stable = false;
+		status = dst_hdl->obj_ops.write2(dst_hdl, false, dst_state,
+						 dst_offset + *copied,
+						 read_amount, buffer,
+						 &wrote_amount, &stable, NULL);
+		if (FSAL_IS_ERROR(status))
+			break;
+
+		*copied += wrote_amount;
+		if (wrote_amount < read_amount)
+			break;
+	}
+
+	gsh_free(buffer);
+
+	/* What was copied before an error is reported */
+	if (*copied != 0)
+		return fsalstat(ERR_FSAL_NO_ERROR, 0);
+	return status;
+}
+
+/* clone2
+ * default case not supported
+ */
+
+static fsal_status_t clone2(struct fsal_obj_handle *src_hdl,
+			    struct state_t *src_state,
+			    uint64_t src_offset,
+			    struct fsal_obj_handle *dst_hdl,
+			    struct state_t *dst_state,
+			    uint64_t dst_offset,
+			    uint64_t count)
+{
+	return fsalstat(ERR_FSAL_NOTSUPP, ENOTSUP);
+}
+
+/* fallocate
+ * default case not supported
+ */
+
+static fsal_status_t file_fallocate(struct fsal_obj_handle *obj_hdl,
+				    struct state_t *state,
+				    uint64_t offset,
+				    uint64_t length,
+				    bool allocate)
+{
+	return fsalstat(ERR_FSAL_NOTSUPP, ENOTSUP);
+}
+
 /* Default fsal handle object method vector.
  * copied to allocated vector at register time
  */
@@ -1632,6 +1759,10 @@ struct fsal_obj_ops def_handle_ops = {
 	.lock_op2 = lock_op2,
 	.setattr2 = setattr2,
 	.close2 = close2,
+	.writev2 = writev2,
+	.copy2 = copy2,
+	.clone2 = clone2,
+	.fallocate = file_fallocate,
 };
 
 /* fsal_pnfs_ds common methods */
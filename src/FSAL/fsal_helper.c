@@ -1056,49 +1056,54 @@ fsal_status_t fsal_read2(struct fsal_obj_handle *obj,
 }
 
 /**
- * @brief New style writes
+ * @brief New style writes from an array of buffers
  *
  * @param[in]     obj          File to be read or written
  * @param[in]     bypass       If state doesn't indicate a share reservation,
  *                             bypass any non-mandatory deny write
  * @param[in]     state        state_t associated with the operation
  * @param[in]     offset       Absolute file position for I/O
- * @param[in]     io_size      Amount of data to be written
+ * @param[in]     iov          Data to be written
+ * @param[in]     iovcnt       Number of buffers in iov, at least one
  * @param[out]    bytes_moved  The length of data successfuly written
- * @param[in,out] buffer       Where in memory to write data
  * @param[in]     sync         Whether the write is synchronous or not
  * @param[in]     info         io_info for WRITE_PLUS
  *
  * @return FSAL status
  */
 
-fsal_status_t fsal_write2(struct fsal_obj_handle *obj,
-			  bool bypass,
-			  struct state_t *state,
-			  uint64_t offset,
-			  size_t io_size,
-			  size_t *bytes_moved,
-			  void *buffer,
-			  bool *sync,
-			  struct io_info *info)
+fsal_status_t fsal_writev2(struct fsal_obj_handle *obj,
+			   bool bypass,
+			   struct state_t *state,
+			   uint64_t offset,
+			   const struct iovec *iov,
+			   int iovcnt,
+			   size_t *bytes_moved,
+			   bool *sync,
+			   struct io_info *info)
 {
 	/* Error return from FSAL calls */
 	fsal_status_t status = { 0, 0 };
+	size_t io_size = 0;
+	int i;
+
+	for (i = 0; i < iovcnt; i++)
+		io_size += iov[i].iov_len;
 
 	if (op_ctx->export_perms->options & EXPORT_OPTION_COMMIT) {
 		/* Force sync if export requires it */
 		*sync = true;
 	}
 
-	status = obj->obj_ops.write2(obj,
-				     bypass,
-				     state,
-				     offset,
-				     io_size,
-				     buffer,
-				     bytes_moved,
-				     sync,
-				     info);
+	status = obj->obj_ops.writev2(obj,
+				      bypass,
+				      state,
+				      offset,
+				      iov,
+				      iovcnt,
+				      bytes_moved,
+				      sync,
+				      info);
 
 	/* Fixup ERR_FSAL_SHARE_DENIED status */
 	if (status.major == ERR_FSAL_SHARE_DENIED)
@@ -1121,6 +1126,42 @@ fsal_status_t fsal_write2(struct fsal_obj_handle *obj,
 	return fsalstat(ERR_FSAL_NO_ERROR, 0);
 }
 
+/**
+ * @brief New style writes
+ *
+ * @param[in]     obj          File to be read or written
+ * @param[in]     bypass       If state doesn't indicate a share reservation,
+ *                             bypass any non-mandatory deny write
+ * @param[in]     state        state_t associated with the operation
+ * @param[in]     offset       Absolute file position for I/O
+ * @param[in]     io_size      Amount of data to be written
+ * @param[out]    bytes_moved  The length of data successfuly written
+ * @param[in,out] buffer       Where in memory to write data
+ * @param[in]     sync         Whether the write is synchronous or not
+ * @param[in]     info         io_info for WRITE_PLUS
+ *
+ * @return FSAL status
+ */
+
+fsal_status_t fsal_write2(struct fsal_obj_handle *obj,
+			  bool bypass,
+			  struct state_t *state,
+			  uint64_t offset,
+			  size_t io_size,
+			  size_t *bytes_moved,
+			  void *buffer,
+			  bool *sync,
+			  struct io_info *info)
+{
+	struct iovec iov = {
+		.iov_base = buffer,
+		.iov_len = io_size
+	};
+
+	return fsal_writev2(obj, bypass, state, offset, &iov, 1, bytes_moved,
+			    sync, info);
+}
+
 /**
  * @brief Read/Write
  *
@@ -53,8 +53,23 @@ struct delegrecall_context {
 	stateid4 drc_stateid;
 	/* Hold a reference to the export during delegation recall */
 	struct gsh_export *drc_exp;
+	/* Recall fan-out this recall belongs to, until first answered */
+	struct nfs_rpc_cb_batch *drc_batch;
 };
 
+/**
+ * @brief Report the first outcome of a recall to its fan-out batch
+ */
+static inline void delegrecall_batch_done(struct delegrecall_context *ctx,
+					  bool success)
+{
+	if (ctx->drc_batch == NULL)
+		return;
+
+	nfs_rpc_cb_batch_done(ctx->drc_batch, success);
+	ctx->drc_batch = NULL;
+}
+
 enum recall_resp_action {
 	DELEG_RECALL_SCHED,
 	DELEG_RET_WAIT,
@@ -1089,6 +1104,8 @@ static enum recall_resp_action handle_recall_response(
 static inline void
 free_delegrecall_context(struct delegrecall_context *deleg_ctx)
 {
+	delegrecall_batch_done(deleg_ctx, false);
+
 	PTHREAD_MUTEX_lock(&deleg_ctx->drc_clid->cid_mutex);
 	update_lease(deleg_ctx->drc_clid);
 	PTHREAD_MUTEX_unlock(&deleg_ctx->drc_clid->cid_mutex);
@@ -1127,6 +1144,10 @@ static int32_t delegrecall_completion_func(rpc_call_t *call,
 	LogDebug(COMPONENT_NFS_CB, "%p %s", call,
 		 (hook == RPC_CALL_COMPLETE) ? "Success" : "Failed");
 
+	delegrecall_batch_done(deleg_ctx,
+			       hook == RPC_CALL_COMPLETE &&
+			       call->cbt.v_u.v4.res.status == NFS4_OK);
+
 	state = nfs4_State_Get_Pointer(deleg_ctx->drc_stateid.other);
 
 	if (state == NULL) {
@@ -1259,8 +1280,10 @@ void delegrecall_one(struct fsal_obj_handle *obj,
 	}
 
 	/* record the first attempt to recall this delegation */
-	if (clfl_stats->cfd_r_time == 0)
+	if (clfl_stats->cfd_r_time == 0) {
 		clfl_stats->cfd_r_time = time(NULL);
+		deleg_recall_start(obj, state, p_cargs->drc_clid);
+	}
 
 	if (str_valid)
 		LogFullDebug(COMPONENT_FSAL_UP, "Recalling delegation %s", str);
@@ -1322,6 +1345,7 @@ void delegrecall_one(struct fsal_obj_handle *obj,
 out:
 
 	inc_failed_recalls(p_cargs->drc_clid->gsh_client);
+	delegrecall_batch_done(p_cargs, false);
 
 	nfs4_freeFH(&argop->nfs_cb_argop4_u.opcbrecall.fh);
 
@@ -1495,6 +1519,7 @@ state_status_t delegrecall_impl(struct fsal_obj_handle *obj)
 	struct state_t *state;
 	state_owner_t *owner;
 	struct delegrecall_context *drc_ctx;
+	struct nfs_rpc_cb_batch *batch = NULL;
 
 	LogDebug(COMPONENT_FSAL_UP,
 		 "FSAL_UP_DELEG: obj %p type %u",
@@ -1525,6 +1550,7 @@ state_status_t delegrecall_impl(struct fsal_obj_handle *obj)
 		*deleg_state = DELEG_RECALL_WIP;
 
 		drc_ctx = gsh_malloc(sizeof(struct delegrecall_context));
+		drc_ctx->drc_batch = NULL;
 
 		/* Get references on the owner and the the export. The
 		 * export reference we will hold while we perform the recall.
@@ -1563,9 +1589,21 @@ state_status_t delegrecall_impl(struct fsal_obj_handle *obj)
 		}
 		PTHREAD_MUTEX_unlock(&drc_ctx->drc_clid->cid_mutex);
 
+		/* All recalls for this file go out without waiting on
+		 * each other; the batch only tracks the fan-out.
+		 */
+		if (batch == NULL)
+			batch = nfs_rpc_cb_batch_alloc();
+		nfs_rpc_cb_batch_add(batch);
+		drc_ctx->drc_batch = batch;
+
 		delegrecall_one(obj, state, drc_ctx);
 	}
 	PTHREAD_RWLOCK_unlock(&obj->state_hdl->state_lock);
+
+	if (batch != NULL)
+		nfs_rpc_cb_batch_put(batch);
+
 	return rc;
 }
 
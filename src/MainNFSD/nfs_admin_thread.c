@@ -38,10 +38,12 @@
 #include "sal_functions.h"
 #include "sal_data.h"
 #include "idmapper.h"
+#include "uid2grp.h"
 #include "delayed_exec.h"
 #include "export_mgr.h"
 #include "fsal.h"
 #include "netgroup_cache.h"
+#include "nfs_proto_functions.h"
 #ifdef USE_DBUS
 #include "gsh_dbus.h"
 #endif
@@ -110,6 +112,63 @@ static struct gsh_dbus_method method_get_grace = {
 		 END_ARG_LIST}
 };
 
+/**
+ * @brief Dbus method get reclaim progress of the grace period
+ *
+ * @param[in]  args  dbus args
+ * @param[out] reply dbus reply message with grace status, the number
+ *                   of clients expected to reclaim and the number that
+ *                   sent RECLAIM_COMPLETE
+ */
+static bool admin_dbus_get_grace_progress(DBusMessageIter *args,
+					  DBusMessage *reply,
+					  DBusError *error)
+{
+	char *errormsg = "get grace progress success";
+	bool success = true;
+	DBusMessageIter iter;
+	dbus_bool_t ingrace;
+	uint32_t expected, completed;
+
+	dbus_message_iter_init_append(reply, &iter);
+	if (args != NULL) {
+		errormsg = "Get grace progress takes no arguments.";
+		success = false;
+		LogWarn(COMPONENT_DBUS, "%s", errormsg);
+		goto out;
+	}
+
+	ingrace = nfs_in_grace();
+	nfs4_get_reclaim_progress(&expected, &completed);
+	dbus_message_iter_append_basic(&iter, DBUS_TYPE_BOOLEAN, &ingrace);
+	dbus_message_iter_append_basic(&iter, DBUS_TYPE_UINT32, &expected);
+	dbus_message_iter_append_basic(&iter, DBUS_TYPE_UINT32, &completed);
+
+ out:
+	dbus_status_reply(&iter, success, errormsg);
+	return success;
+}
+
+static struct gsh_dbus_method method_get_grace_progress = {
+	.name = "get_grace_progress",
+	.method = admin_dbus_get_grace_progress,
+	.args = {
+		 {.name = "isgrace",
+		  .type = "b",
+		  .direction = "out",
+		 },
+		 {.name = "expected",
+		  .type = "u",
+		  .direction = "out",
+		 },
+		 {.name = "completed",
+		  .type = "u",
+		  .direction = "out",
+		 },
+		 STATUS_REPLY,
+		 END_ARG_LIST}
+};
+
 /**
  * @brief Dbus method start grace period
  *
@@ -289,6 +348,7 @@ static struct gsh_dbus_method *admin_methods[] = {
 	&method_shutdown,
 	&method_grace_period,
 	&method_get_grace,
+	&method_get_grace_progress,
 	&method_purge_gids,
 	&method_purge_netgroups,
 	NULL
@@ -418,6 +478,57 @@ static void do_shutdown(void)
 		LogEvent(COMPONENT_THREAD, "General fridge shut down.");
 	}
 
+	rc = idmapper_shutdown();
+	if (rc != 0) {
+		LogMajor(COMPONENT_THREAD,
+			 "Error shutting down idmapper refresh threads: %d",
+			 rc);
+		disorderly = true;
+	} else {
+		LogEvent(COMPONENT_THREAD, "Idmapper refresh threads shut down.");
+	}
+
+	rc = uid2grp_cache_shutdown();
+	if (rc != 0) {
+		LogMajor(COMPONENT_THREAD,
+			 "Error shutting down uid2grp refresh threads: %d",
+			 rc);
+		disorderly = true;
+	} else {
+		LogEvent(COMPONENT_THREAD, "Uid2grp refresh threads shut down.");
+	}
+
+	rc = nfs_ip_name_shutdown();
+	if (rc != 0) {
+		LogMajor(COMPONENT_THREAD,
+			 "Error shutting down IP/name resolver threads: %d",
+			 rc);
+		disorderly = true;
+	} else {
+		LogEvent(COMPONENT_THREAD,
+			 "IP/name resolver threads shut down.");
+	}
+
+	rc = nfs4_copy_offload_shutdown();
+	if (rc != 0) {
+		LogMajor(COMPONENT_THREAD,
+			 "Error shutting down copy offload threads: %d",
+			 rc);
+		disorderly = true;
+	} else {
+		LogEvent(COMPONENT_THREAD,
+			 "Copy offload threads shut down.");
+	}
+
+	rc = ng_cache_shutdown();
+	if (rc != 0) {
+		LogMajor(COMPONENT_THREAD,
+			 "Error shutting down netgroup expander: %d", rc);
+		disorderly = true;
+	} else {
+		LogEvent(COMPONENT_THREAD, "Netgroup expander shut down.");
+	}
+
 	rc = reaper_shutdown();
 	if (rc != 0) {
 		LogMajor(COMPONENT_THREAD,
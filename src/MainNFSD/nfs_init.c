@@ -114,6 +114,9 @@ pthread_t nfs_rdma_dispatcher_thrid;
 
 char *config_path = GANESHA_CONFIG_PATH;
 
+/* precompiled image of the parsed config, none by default */
+char *config_cache_path;
+
 char *pidfile_path = GANESHA_PIDFILE_PATH;
 
 /**
@@ -154,7 +157,8 @@ void reread_config(void)
 	if (!init_error_type(&err_type))
 		return;
 	/* Attempt to parse the new configuration file */
-	config_struct = config_ParseFile(config_path, &err_type);
+	config_struct = config_ParseFileCached(config_path, config_cache_path,
+					       &err_type);
 	if (!config_error_no_error(&err_type)) {
 		config_Free(config_struct);
 		LogCrit(COMPONENT_CONFIG,
@@ -487,6 +491,8 @@ int init_server_pkgs(void)
 	}
 	LogInfo(COMPONENT_INIT, "IP/name cache successfully initialized");
 
+	nfs4_copy_offload_init();
+
 	LogEvent(COMPONENT_INIT, "Initializing ID Mapper.");
 	if (!idmapper_init()) {
 		LogCrit(COMPONENT_INIT, "Failed initializing ID Mapper.");
@@ -158,8 +158,9 @@ int nfs_libmain(const char *ganesha_conf,
 			"No configuration file named.");
 		config_struct = NULL;
 	} else
-		config_struct = config_ParseFile(config_path,
-						 &err_type);
+		config_struct = config_ParseFileCached(config_path,
+						       config_cache_path,
+						       &err_type);
 
 	if (!config_error_no_error(&err_type)) {
 		char *errstr = err_type_str(&err_type);
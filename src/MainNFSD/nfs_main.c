@@ -86,13 +86,15 @@ bool dump_trace;
 
 /* command line syntax */
 
-char options[] = "v@L:N:f:p:FRTE:Ch";
+char options[] = "v@L:N:f:c:p:FRTE:Ch";
 char usage[] =
 	"Usage: %s [-hd][-L <logfile>][-N <dbg_lvl>][-f <config_file>]\n"
+	"\t[-c <cache_file>]\n"
 	"\t[-v]                display version information\n"
 	"\t[-L <logfile>]      set the default logfile for the daemon\n"
 	"\t[-N <dbg_lvl>]      set the verbosity level\n"
 	"\t[-f <config_file>]  set the config file to be used\n"
+	"\t[-c <cache_file>]   load and save the parsed config file here\n"
 	"\t[-p <pid_file>]     set the pid file\n"
 	"\t[-F]                the program stays in foreground\n"
 	"\t[-R]                daemon will manage RPCSEC_GSS (default is no RPCSEC_GSS)\n"
@@ -204,6 +206,12 @@ int main(int argc, char *argv[])
 			config_path = main_strdup("config_path", optarg);
 			break;
 
+		case 'c':
+			/* precompiled config cache */
+			config_cache_path = main_strdup("config_cache_path",
+							optarg);
+			break;
+
 		case 'p':
 			/* PID file */
 			pidfile_path = main_strdup("pidfile_path", optarg);
@@ -410,7 +418,9 @@ int main(int argc, char *argv[])
 			"No configuration file named.");
 		config_struct = NULL;
 	} else
-		config_struct = config_ParseFile(config_path, &err_type);
+		config_struct = config_ParseFileCached(config_path,
+						       config_cache_path,
+						       &err_type);
 
 	if (!config_error_no_error(&err_type)) {
 		char *errstr = err_type_str(&err_type);
@@ -56,6 +56,9 @@
 #include "gss_credcache.h"
 #endif /* _HAVE_GSSAPI */
 #include "sal_data.h"
+#ifdef _USE_CB_SIMULATOR
+#include "nfs_rpc_callback_simulator.h"
+#endif
 #include <misc/timespec.h>
 
 const struct __netid_nc_table netid_nc_table[9] = {
@@ -104,11 +107,30 @@ static inline void nfs_rpc_cb_init_ccache(const char *ccache)
 #endif /* _HAVE_GSSAPI */
 }
 
+/* Calls waiting behind a busy channel are protected by one of these
+ * locks, picked by channel address, so that channels embedded in
+ * client and session records need no extra setup.
+ */
+#define CB_CHAN_QLOCKS 67
+
+static pthread_mutex_t cb_chan_qlock[CB_CHAN_QLOCKS];
+
+static inline pthread_mutex_t *chan_qlock(rpc_call_channel_t *chan)
+{
+	return &cb_chan_qlock[((uintptr_t) chan / sizeof(*chan)) %
+			      CB_CHAN_QLOCKS];
+}
+
 /**
  * @brief Initialize callback subsystem
  */
 void nfs_rpc_cb_pkginit(void)
 {
+	int i;
+
+	for (i = 0; i < CB_CHAN_QLOCKS; i++)
+		PTHREAD_MUTEX_init(&cb_chan_qlock[i], NULL);
+
 #ifdef _HAVE_GSSAPI
 	/* ccache */
 	nfs_rpc_cb_init_ccache(nfs_param.krb5_param.ccache_dir);
@@ -896,21 +918,73 @@ static inline void RPC_CALL_HOOK(rpc_call_t *call, rpc_call_hook hook,
 		call->call_hook(call, hook, arg, flags);
 }
 
+/**
+ * @brief Whether a channel has a client to send calls to
+ *
+ * This is only a hint, read without the channel lock that a call in
+ * flight holds for as long as the client takes to answer; dispatch
+ * checks again under the lock.
+ *
+ * @param[in] chan The channel
+ *
+ * @return true if calls can be sent on it.
+ */
+static bool nfs_rpc_chan_up(rpc_call_channel_t *chan)
+{
+#ifdef _USE_CB_SIMULATOR
+	if (chan->type == RPC_CHAN_LOCAL)
+		return true;
+#endif
+	return chan->clnt != NULL;
+}
+
+/**
+ * @brief Be done with a channel
+ *
+ * Every call that went through the channel queue ends here, whether
+ * it was dispatched or failed first: the next call waiting on the
+ * channel is handed to the worker pool, or the channel is left idle.
+ *
+ * @param[in] chan The channel whose call just finished
+ */
+static void nfs_rpc_chan_release(rpc_call_channel_t *chan)
+{
+	pthread_mutex_t *qlock = chan_qlock(chan);
+	request_data_t *next;
+
+	PTHREAD_MUTEX_lock(qlock);
+	next = glist_first_entry(&chan->pending, request_data_t, req_q);
+	if (next)
+		glist_del(&next->req_q);
+	else
+		chan->busy = false;
+	PTHREAD_MUTEX_unlock(qlock);
+
+	if (next)
+		nfs_rpc_enqueue_req(next);
+}
+
 /**
  * @brief Fire off an RPC call
  *
+ * A call that has to wait behind another on its channel is accepted,
+ * and fails through its completion hook if the channel is down by the
+ * time it is sent.
+ *
  * @param[in] call           The constructed call
  * @param[in] completion_arg Argument to completion function
  * @param[in] flags          Control flags for call
  *
- * @return 0 or POSIX error codes.
+ * @return 0 or POSIX error codes, ENOTCONN if the channel is down.
  */
 int32_t nfs_rpc_submit_call(rpc_call_t *call, void *completion_arg,
 			    uint32_t flags)
 {
 	request_data_t *reqdata;
+	rpc_call_channel_t *chan = call->chan;
+	pthread_mutex_t *qlock;
 
-	assert(call->chan);
+	assert(chan);
 
 	call->completion_arg = completion_arg;
 	if (flags & NFS_RPC_CALL_INLINE)
@@ -919,9 +993,40 @@ int32_t nfs_rpc_submit_call(rpc_call_t *call, void *completion_arg,
 	reqdata = container_of(call, request_data_t, r_u.call);
 	PTHREAD_MUTEX_lock(&call->we.mtx);
 	call->states = NFS_CB_CALL_QUEUED;
-	nfs_rpc_enqueue_req(reqdata);
+	call->flags |= NFS_RPC_CALL_CHAN_QUEUED;
 	PTHREAD_MUTEX_unlock(&call->we.mtx);
 
+	/* Only one call per channel is handed to the worker pool at a
+	 * time, the others wait on the channel.  A slow client then
+	 * holds at most one worker, and callbacks fanned out to many
+	 * clients proceed in parallel.
+	 */
+	qlock = chan_qlock(chan);
+	PTHREAD_MUTEX_lock(qlock);
+	if (chan->pending.next == NULL)
+		glist_init(&chan->pending);
+	if (chan->busy) {
+		glist_add_tail(&chan->pending, &reqdata->req_q);
+		PTHREAD_MUTEX_unlock(qlock);
+		return 0;
+	}
+	chan->busy = true;
+	PTHREAD_MUTEX_unlock(qlock);
+
+	if (!nfs_rpc_chan_up(chan)) {
+		/* Not sent, the caller frees it; calls that queued up
+		 * behind it meanwhile still go, and fail in turn.
+		 */
+		PTHREAD_MUTEX_lock(&call->we.mtx);
+		call->states = NFS_CB_CALL_NONE;
+		call->flags &= ~NFS_RPC_CALL_CHAN_QUEUED;
+		PTHREAD_MUTEX_unlock(&call->we.mtx);
+		nfs_rpc_chan_release(chan);
+		return ENOTCONN;
+	}
+
+	nfs_rpc_enqueue_req(reqdata);
+
 	return 0;
 }
 
@@ -936,7 +1041,7 @@ int32_t nfs_rpc_submit_call(rpc_call_t *call, void *completion_arg,
 
 int32_t nfs_rpc_dispatch_call(rpc_call_t *call, uint32_t flags)
 {
-	struct timeval CB_TIMEOUT = { 15, 0 };	/* XXX */
+	struct timeval CB_TIMEOUT = { nfs_param.nfsv4_param.cb_timeout, 0 };
 	rpc_call_hook hook_status = RPC_CALL_COMPLETE;
 
 	/* send the call, set states, wake waiters, etc */
@@ -953,8 +1058,18 @@ int32_t nfs_rpc_dispatch_call(rpc_call_t *call, uint32_t flags)
 	/* XXX TI-RPC does the signal masking */
 	PTHREAD_MUTEX_lock(&call->chan->mtx);
 
+#ifdef _USE_CB_SIMULATOR
+	if (call->chan->type == RPC_CHAN_LOCAL) {
+		call->stat = nfs_rpc_cbsim_local_call(call);
+		if (call->stat != RPC_SUCCESS)
+			hook_status = RPC_CALL_ABORT;
+		goto unlock;
+	}
+#endif
+
 	if (!call->chan->clnt) {
 		call->stat = RPC_INTR;
+		hook_status = RPC_CALL_ABORT;
 		goto unlock;
 	}
 
@@ -974,6 +1089,12 @@ int32_t nfs_rpc_dispatch_call(rpc_call_t *call, uint32_t flags)
  unlock:
 	PTHREAD_MUTEX_unlock(&call->chan->mtx);
 
+	/* The completion hook may free the call, and with it our only
+	 * way to the channel, so release the channel first.
+	 */
+	if (call->flags & NFS_RPC_CALL_CHAN_QUEUED)
+		nfs_rpc_chan_release(call->chan);
+
 	/* signal waiter(s) */
 	PTHREAD_MUTEX_lock(&call->we.mtx);
 	call->states |= NFS_CB_CALL_FINISHED;
@@ -990,6 +1111,123 @@ int32_t nfs_rpc_dispatch_call(rpc_call_t *call, uint32_t flags)
 	return 0;
 }
 
+/**
+ * @brief Allocate a callback batch
+ *
+ * @return The batch, with one reference for the caller.
+ */
+struct nfs_rpc_cb_batch *nfs_rpc_cb_batch_alloc(void)
+{
+	struct nfs_rpc_cb_batch *batch = gsh_calloc(1, sizeof(*batch));
+
+	PTHREAD_MUTEX_init(&batch->mtx, NULL);
+	PTHREAD_COND_init(&batch->cv, NULL);
+	batch->refcnt = 1;
+	now(&batch->start);
+
+	return batch;
+}
+
+/**
+ * @brief Account for one more call in a batch
+ *
+ * Must be called before the call is submitted.  The reference taken
+ * here is dropped by nfs_rpc_cb_batch_done().
+ *
+ * @param[in] batch The batch
+ */
+void nfs_rpc_cb_batch_add(struct nfs_rpc_cb_batch *batch)
+{
+	PTHREAD_MUTEX_lock(&batch->mtx);
+	batch->issued++;
+	batch->refcnt++;
+	PTHREAD_MUTEX_unlock(&batch->mtx);
+}
+
+/**
+ * @brief Report the completion of one call in a batch
+ *
+ * @param[in] batch   The batch
+ * @param[in] success Whether the client answered the call
+ */
+void nfs_rpc_cb_batch_done(struct nfs_rpc_cb_batch *batch, bool success)
+{
+	struct timespec ts;
+
+	now(&ts);
+
+	PTHREAD_MUTEX_lock(&batch->mtx);
+	if (success)
+		batch->completed++;
+	else
+		batch->failed++;
+	batch->last = timespec_diff(&batch->start, &ts);
+	if (batch->completed + batch->failed == batch->issued)
+		pthread_cond_broadcast(&batch->cv);
+	PTHREAD_MUTEX_unlock(&batch->mtx);
+
+	nfs_rpc_cb_batch_put(batch);
+}
+
+/**
+ * @brief Wait for every call in a batch to complete
+ *
+ * @param[in] batch      The batch
+ * @param[in] timeout_ms Longest wait, 0 to wait forever
+ *
+ * @retval true if all calls completed.
+ * @retval false if the wait timed out.
+ */
+bool nfs_rpc_cb_batch_wait(struct nfs_rpc_cb_batch *batch,
+			   uint32_t timeout_ms)
+{
+	struct timespec ts;
+	bool done;
+
+	clock_gettime(CLOCK_REALTIME, &ts);
+	timespec_addms(&ts, timeout_ms);
+
+	PTHREAD_MUTEX_lock(&batch->mtx);
+	while (batch->completed + batch->failed < batch->issued) {
+		if (timeout_ms == 0)
+			pthread_cond_wait(&batch->cv, &batch->mtx);
+		else if (pthread_cond_timedwait(&batch->cv, &batch->mtx,
+						&ts) == ETIMEDOUT)
+			break;
+	}
+	done = batch->completed + batch->failed == batch->issued;
+	PTHREAD_MUTEX_unlock(&batch->mtx);
+
+	return done;
+}
+
+/**
+ * @brief Release a reference on a batch
+ *
+ * @param[in] batch The batch
+ */
+void nfs_rpc_cb_batch_put(struct nfs_rpc_cb_batch *batch)
+{
+	int32_t refcnt;
+
+	PTHREAD_MUTEX_lock(&batch->mtx);
+	refcnt = --batch->refcnt;
+	PTHREAD_MUTEX_unlock(&batch->mtx);
+
+	if (refcnt != 0)
+		return;
+
+	LogDebug(COMPONENT_NFS_CB,
+		 "Callback batch of %"PRIu32" calls: %"PRIu32
+		 " completed, %"PRIu32" failed, last after %"PRIu64" ns",
+		 batch->issued, batch->completed, batch->failed,
+		 batch->last);
+
+	PTHREAD_COND_destroy(&batch->cv);
+	PTHREAD_MUTEX_destroy(&batch->mtx);
+	gsh_free(batch);
+}
+
 /**
  * @brief Abort a call
  *
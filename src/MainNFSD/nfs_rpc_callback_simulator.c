@@ -42,6 +42,7 @@
 #include "nfs_rpc_callback_simulator.h"
 #include "sal_functions.h"
 #include "gsh_dbus.h"
+#include "abstract_atomic.h"
 
 /**
  * @file nfs_rpc_callback_simulator.c
@@ -303,7 +304,38 @@ static int32_t cbsim_completion_func(rpc_call_t *call, rpc_call_hook hook,
 	return 0;
 }
 
-static int32_t cbsim_fake_cbrecall(clientid4 clientid)
+/**
+ * @brief Completion hook for calls belonging to a fan-out batch
+ */
+static int32_t cbsim_batch_completion_func(rpc_call_t *call,
+					   rpc_call_hook hook,
+					   void *arg, uint32_t flags)
+{
+	struct nfs_rpc_cb_batch *batch = arg;
+	bool success = hook == RPC_CALL_COMPLETE &&
+		       call->stat == RPC_SUCCESS;
+
+	/* the local stand-in doesn't duplicate its file handle, and its
+	 * channel may be gone once the batch is done
+	 */
+	if (call->chan->type != RPC_CHAN_LOCAL)
+		gsh_free(call->cbt.v_u.v4.args.argarray.argarray_val->
+			 nfs_cb_argop4_u.opcbrecall.fh.nfs_fh4_val);
+	free_rpc_call(call);
+
+	nfs_rpc_cb_batch_done(batch, success);
+
+	return 0;
+}
+
+/**
+ * @brief Send a fake CB_RECALL to a client
+ *
+ * @param[in] clientid The client to recall from
+ * @param[in] batch    Fan-out batch to account the call in, or NULL
+ */
+static int32_t cbsim_fake_cbrecall(clientid4 clientid,
+				   struct nfs_rpc_cb_batch *batch)
 {
 	int32_t code = 0;
 	nfs_client_id_t *pclientid = NULL;
@@ -361,10 +393,17 @@ static int32_t cbsim_fake_cbrecall(clientid4 clientid)
 	cb_compound_add_op(&call->cbt, argop);
 
 	/* set completion hook */
-	call->call_hook = cbsim_completion_func;
+	if (batch) {
+		call->call_hook = cbsim_batch_completion_func;
+		nfs_rpc_cb_batch_add(batch);
+	} else {
+		call->call_hook = cbsim_completion_func;
+	}
 
 	/* call it (here, in current thread context) */
-	code = nfs_rpc_submit_call(call, NULL, NFS_RPC_FLAG_NONE);
+	code = nfs_rpc_submit_call(call, batch, NFS_RPC_FLAG_NONE);
+	if (code != 0 && batch)
+		cbsim_batch_completion_func(call, RPC_CALL_ABORT, batch, 0);
 
  out:
 	return code;
@@ -399,7 +438,7 @@ static bool nfs_rpc_cbsim_fake_recall(DBusMessageIter *args,
 	}
 
 	cbsim_test_bchan(clientid);
-	cbsim_fake_cbrecall(clientid);
+	cbsim_fake_cbrecall(clientid, NULL);
 
 	return true;
 }
@@ -419,6 +458,279 @@ static struct gsh_dbus_method cbsim_fake_recall = {
 		 }
 };
 
+/** Simulated client round trip of the local stand-in, in usecs */
+static uint32_t cbsim_local_delay;
+
+/** File handle recalled from the local stand-in */
+static char cbsim_local_fh[] = "0xabadcafe";
+
+/**
+ * @brief Answer a callback sent on a local stand-in channel
+ *
+ * Called by the dispatcher in place of the RPC for RPC_CHAN_LOCAL
+ * channels, with the channel locked like a real call would be.
+ *
+ * @param[in] call The callback
+ *
+ * @return RPC_SUCCESS, having answered NFS4_OK.
+ */
+enum clnt_stat nfs_rpc_cbsim_local_call(rpc_call_t *call)
+{
+	uint32_t delay = atomic_fetch_uint32_t(&cbsim_local_delay);
+
+	if (delay)
+		usleep(delay);
+
+	call->cbt.v_u.v4.res.status = NFS4_OK;
+	return RPC_SUCCESS;
+}
+
+/**
+ * @brief Append a fan-out batch result to a reply
+ */
+static void cbsim_append_batch(DBusMessageIter *iter,
+			       struct nfs_rpc_cb_batch *batch,
+			       dbus_bool_t timedout)
+{
+	DBusMessageIter struct_iter;
+	uint64_t issued = batch->issued;
+	uint64_t completed = batch->completed;
+	uint64_t failed = batch->failed;
+	uint64_t elapsed = batch->last;
+
+	dbus_message_iter_open_container(iter, DBUS_TYPE_STRUCT, NULL,
+					 &struct_iter);
+	dbus_message_iter_append_basic(&struct_iter, DBUS_TYPE_UINT64,
+				       &issued);
+	dbus_message_iter_append_basic(&struct_iter, DBUS_TYPE_UINT64,
+				       &completed);
+	dbus_message_iter_append_basic(&struct_iter, DBUS_TYPE_UINT64,
+				       &failed);
+	dbus_message_iter_append_basic(&struct_iter, DBUS_TYPE_BOOLEAN,
+				       &timedout);
+	dbus_message_iter_append_basic(&struct_iter, DBUS_TYPE_UINT64,
+				       &elapsed);
+	dbus_message_iter_close_container(iter, &struct_iter);
+}
+
+/**
+ * @brief Read up to @c n uint32 arguments, keeping defaults for the rest
+ */
+static void cbsim_get_u32_args(DBusMessageIter *args, uint32_t *vals, int n)
+{
+	int i;
+
+	if (args == NULL)
+		return;
+
+	for (i = 0; i < n; i++) {
+		if (dbus_message_iter_get_arg_type(args) != DBUS_TYPE_UINT32)
+			return;
+		dbus_message_iter_get_basic(args, &vals[i]);
+		if (!dbus_message_iter_next(args))
+			return;
+	}
+}
+
+/**
+ * @brief Recall from every confirmed client at once
+ *
+ * Sends a fake CB_RECALL to all confirmed clients in parallel and
+ * waits for the whole fan-out to complete.
+ *
+ * @param args    timeout in ms (0 waits forever)
+ * @param reply   (issued, completed, failed, timed out, ns to last reply)
+ */
+static bool nfs_rpc_cbsim_recall_fanout(DBusMessageIter *args,
+					DBusMessage *reply,
+					DBusError *error)
+{
+	uint32_t timeout_ms = 0;
+	hash_table_t *ht = ht_confirmed_client_id;
+	struct rbt_node *pn;
+	struct hash_data *pdata;
+	clientid4 *ids = NULL;
+	uint32_t nids = 0, maxids = 0, i;
+	struct nfs_rpc_cb_batch *batch;
+	dbus_bool_t timedout;
+	DBusMessageIter iter;
+	struct timespec ts;
+
+	cbsim_get_u32_args(args, &timeout_ms, 1);
+
+	/* Collect the client ids first, the partitions must not be
+	 * held while calls are set up.
+	 */
+	for (i = 0; i < ht->parameter.index_size; i++) {
+		PTHREAD_RWLOCK_rdlock(&ht->partitions[i].lock);
+		RBT_LOOP(&ht->partitions[i].rbt, pn) {
+			pdata = RBT_OPAQ(pn);
+			if (nids == maxids) {
+				maxids = maxids ? maxids * 2 : 64;
+				ids = gsh_realloc(ids,
+						  maxids * sizeof(*ids));
+			}
+			ids[nids++] = ((nfs_client_id_t *)
+				       pdata->val.addr)->cid_clientid;
+			RBT_INCREMENT(pn);
+		}
+		PTHREAD_RWLOCK_unlock(&ht->partitions[i].lock);
+	}
+
+	batch = nfs_rpc_cb_batch_alloc();
+	for (i = 0; i < nids; i++)
+		(void) cbsim_fake_cbrecall(ids[i], batch);
+	gsh_free(ids);
+
+	timedout = !nfs_rpc_cb_batch_wait(batch, timeout_ms);
+
+	now(&ts);
+	dbus_message_iter_init_append(reply, &iter);
+	dbus_append_timestamp(&iter, &ts);
+	PTHREAD_MUTEX_lock(&batch->mtx);
+	cbsim_append_batch(&iter, batch, timedout);
+	PTHREAD_MUTEX_unlock(&batch->mtx);
+	nfs_rpc_cb_batch_put(batch);
+
+	return true;
+}
+
+static struct gsh_dbus_method cbsim_recall_fanout = {
+	.name = "recall_fanout",
+	.method = nfs_rpc_cbsim_recall_fanout,
+	.args = {
+		 {
+		  .name = "timeout_ms",
+		  .type = "u",
+		  .direction = "in"},
+		 {
+		  .name = "time",
+		  .type = "(tt)",
+		  .direction = "out"},
+		 {
+		  .name = "fanout",
+		  .type = "(tttbt)",
+		  .direction = "out"},
+		 {NULL, NULL, NULL}
+		 }
+};
+
+/**
+ * @brief Benchmark recall fan-out against local stand-in clients
+ *
+ * Creates in-process stand-in channels that answer every CB_RECALL
+ * after a fixed delay, and pushes recalls to all of them through the
+ * regular submit/dispatch path.  No client or network is involved.
+ *
+ * @param args    clients, calls per client, delay in us, timeout in ms
+ * @param reply   (issued, completed, failed, timed out, ns to last reply)
+ */
+static bool nfs_rpc_cbsim_local_fanout(DBusMessageIter *args,
+				       DBusMessage *reply,
+				       DBusError *error)
+{
+	/* clients, calls per client, delay (us), timeout (ms) */
+	uint32_t params[4] = {500, 1, 1000, 0};
+	rpc_call_channel_t *chans;
+	struct nfs_rpc_cb_batch *batch;
+	nfs_cb_argop4 argop;
+	rpc_call_t *call;
+	dbus_bool_t timedout;
+	DBusMessageIter iter;
+	struct timespec ts;
+	uint32_t i, j;
+
+	cbsim_get_u32_args(args, params, 4);
+	if (params[0] == 0)
+		params[0] = 1;
+	if (params[1] == 0)
+		params[1] = 1;
+
+	atomic_store_uint32_t(&cbsim_local_delay, params[2]);
+
+	chans = gsh_calloc(params[0], sizeof(*chans));
+	for (i = 0; i < params[0]; i++) {
+		chans[i].type = RPC_CHAN_LOCAL;
+		PTHREAD_MUTEX_init(&chans[i].mtx, NULL);
+	}
+
+	memset(&argop, 0, sizeof(argop));
+	argop.argop = NFS4_OP_CB_RECALL;
+	argop.nfs_cb_argop4_u.opcbrecall.fh.nfs_fh4_len =
+		sizeof(cbsim_local_fh);
+	argop.nfs_cb_argop4_u.opcbrecall.fh.nfs_fh4_val = cbsim_local_fh;
+
+	batch = nfs_rpc_cb_batch_alloc();
+	for (j = 0; j < params[1]; j++) {
+		for (i = 0; i < params[0]; i++) {
+			call = alloc_rpc_call();
+			call->chan = &chans[i];
+			cb_compound_init_v4(&call->cbt, 1, 0, 0,
+					    "cbsim", 5);
+			cb_compound_add_op(&call->cbt, &argop);
+			call->call_hook = cbsim_batch_completion_func;
+			nfs_rpc_cb_batch_add(batch);
+			if (nfs_rpc_submit_call(call, batch,
+						NFS_RPC_FLAG_NONE) != 0)
+				cbsim_batch_completion_func(call,
+							    RPC_CALL_ABORT,
+							    batch, 0);
+		}
+	}
+
+	timedout = !nfs_rpc_cb_batch_wait(batch, params[3]);
+
+	/* The stand-in channels can't go away under queued calls */
+	if (timedout)
+		(void) nfs_rpc_cb_batch_wait(batch, 0);
+
+	for (i = 0; i < params[0]; i++)
+		PTHREAD_MUTEX_destroy(&chans[i].mtx);
+	gsh_free(chans);
+
+	now(&ts);
+	dbus_message_iter_init_append(reply, &iter);
+	dbus_append_timestamp(&iter, &ts);
+	PTHREAD_MUTEX_lock(&batch->mtx);
+	cbsim_append_batch(&iter, batch, timedout);
+	PTHREAD_MUTEX_unlock(&batch->mtx);
+	nfs_rpc_cb_batch_put(batch);
+
+	return true;
+}
+
+static struct gsh_dbus_method cbsim_local_fanout = {
+	.name = "local_fanout",
+	.method = nfs_rpc_cbsim_local_fanout,
+	.args = {
+		 {
+		  .name = "clients",
+		  .type = "u",
+		  .direction = "in"},
+		 {
+		  .name = "calls_per_client",
+		  .type = "u",
+		  .direction = "in"},
+		 {
+		  .name = "delay_us",
+		  .type = "u",
+		  .direction = "in"},
+		 {
+		  .name = "timeout_ms",
+		  .type = "u",
+		  .direction = "in"},
+		 {
+		  .name = "time",
+		  .type = "(tt)",
+		  .direction = "out"},
+		 {
+		  .name = "fanout",
+		  .type = "(tttbt)",
+		  .direction = "out"},
+		 {NULL, NULL, NULL}
+		 }
+};
+
 /* DBUS org.ganesha.nfsd.cbsim methods list
  */
 
@@ -426,6 +738,8 @@ static struct gsh_dbus_method *cbsim_methods[] = {
 	&cbsim_get_client_ids,
 	&cbsim_get_session_ids,
 	&cbsim_fake_recall,
+	&cbsim_recall_fanout,
+	&cbsim_local_fanout,
 	NULL
 };
 
@@ -61,6 +61,7 @@
 #include "nfs_req_queue.h"
 #include "nfs_dupreq.h"
 #include "nfs_file_handle.h"
+#include "nfs_creds.h"
 #include "fridgethr.h"
 
 #define NFS_pcp nfs_param.core_param
@@ -1189,10 +1190,14 @@ static u_int nfs_rpc_recv_user_data(SVCXPRT *xprt, SVCXPRT *newxprt,
  */
 static void nfs_rpc_free_user_data(SVCXPRT *xprt)
 {
+	gsh_xprt_private_t *xu = (gsh_xprt_private_t *)xprt->xp_u1;
+
 	if (xprt->xp_u2) {
 		nfs_dupreq_put_drc(xprt, xprt->xp_u2, DRC_FLAG_RELEASE);
 		xprt->xp_u2 = NULL;
 	}
+	if (xu != NULL)
+		nfs_cred_cache_free(xu->cred_cache);
 	free_gsh_xprt_private(xprt);
 }
 
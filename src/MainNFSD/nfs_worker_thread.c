@@ -59,6 +59,7 @@
 #include "export_mgr.h"
 #include "server_stats.h"
 #include "uid2grp.h"
+#include "gsh_arena.h"
 
 #ifdef USE_LTTNG
 #include "gsh_lttng/nfs_rpc.h"
@@ -71,6 +72,9 @@ pool_t *request_pool;
 
 static struct fridgethr *worker_fridge;
 
+/* Request scoped memory of the thread running nfs_rpc_execute */
+static __thread struct gsh_arena req_arena;
+
 const nfs_function_desc_t invalid_funcdesc = {
 	.service_function = nfs_null,
 	.free_function = nfs_null_free,
@@ -93,7 +97,7 @@ const nfs_function_desc_t nfs3_func_desc[] = {
 	 .service_function = nfs3_getattr,
 	 .free_function = nfs3_getattr_free,
 	 .xdr_decode_func = (xdrproc_t) xdr_GETATTR3args,
-	 .xdr_encode_func = (xdrproc_t) xdr_GETATTR3res,
+	 .xdr_encode_func = (xdrproc_t) xdr_GETATTR3res_fast,
 	 .funcname = "nfs3_getattr",
 	 .dispatch_behaviour = NEEDS_CRED | NEEDS_EXPORT | SUPPORTS_GSS},
 	{
@@ -109,14 +113,14 @@ const nfs_function_desc_t nfs3_func_desc[] = {
 	 .service_function = nfs3_lookup,
 	 .free_function = nfs3_lookup_free,
 	 .xdr_decode_func = (xdrproc_t) xdr_LOOKUP3args,
-	 .xdr_encode_func = (xdrproc_t) xdr_LOOKUP3res,
+	 .xdr_encode_func = (xdrproc_t) xdr_LOOKUP3res_fast,
 	 .funcname = "nfs3_lookup",
 	 .dispatch_behaviour = NEEDS_CRED | NEEDS_EXPORT | SUPPORTS_GSS},
 	{
 	 .service_function = nfs3_access,
 	 .free_function = nfs3_access_free,
 	 .xdr_decode_func = (xdrproc_t) xdr_ACCESS3args,
-	 .xdr_encode_func = (xdrproc_t) xdr_ACCESS3res,
+	 .xdr_encode_func = (xdrproc_t) xdr_ACCESS3res_fast,
 	 .funcname = "nfs3_access",
 	 .dispatch_behaviour = NEEDS_CRED | NEEDS_EXPORT | SUPPORTS_GSS},
 	{
@@ -129,16 +133,16 @@ const nfs_function_desc_t nfs3_func_desc[] = {
 	{
 	 .service_function = nfs3_read,
 	 .free_function = nfs3_read_free,
-	 .xdr_decode_func = (xdrproc_t) xdr_READ3args,
-	 .xdr_encode_func = (xdrproc_t) xdr_READ3res,
+	 .xdr_decode_func = (xdrproc_t) xdr_READ3args_fast,
+	 .xdr_encode_func = (xdrproc_t) xdr_READ3res_fast,
 	 .funcname = "nfs3_read",
 	 .dispatch_behaviour =
 	 NEEDS_CRED | NEEDS_EXPORT | SUPPORTS_GSS | MAKES_IO},
 	{
 	 .service_function = nfs3_write,
 	 .free_function = nfs3_write_free,
-	 .xdr_decode_func = (xdrproc_t) xdr_WRITE3args,
-	 .xdr_encode_func = (xdrproc_t) xdr_WRITE3res,
+	 .xdr_decode_func = (xdrproc_t) xdr_WRITE3args_fast,
+	 .xdr_encode_func = (xdrproc_t) xdr_WRITE3res_fast,
 	 .funcname = "nfs3_write",
 	 .dispatch_behaviour =
 	 (MAKES_WRITE | NEEDS_CRED | NEEDS_EXPORT | CAN_BE_DUP | SUPPORTS_GSS |
@@ -719,6 +723,8 @@ void nfs_rpc_execute(request_data_t *reqdata)
 	struct export_perms export_perms;
 	struct user_cred user_credentials;
 	struct req_op_context req_ctx;
+	struct nfs_cred_cache *cred_cache = NULL;
+	bool creds_cached = false;
 	dupreq_status_t dpq_status;
 	struct timespec timer_start;
 	enum auth_stat auth_rc;
@@ -812,6 +818,15 @@ void nfs_rpc_execute(request_data_t *reqdata)
 	 * path is short, lockless, and does no hash/search). */
 	dpq_status = nfs_dupreq_start(&reqdata->r_u.req, &reqdata->r_u.req.svc);
 	res_nfs = reqdata->r_u.req.res_nfs;
+
+	/* A result that the DRC keeps cannot live in the arena */
+	if (dpq_status == DUPREQ_SUCCESS &&
+	    nfs_dupreq_is_nocache(&reqdata->r_u.req.svc)) {
+		if (req_arena.first == NULL)
+			gsh_arena_init(&req_arena, 0);
+		op_ctx->arena = &req_arena;
+	}
+
 	if (dpq_status == DUPREQ_SUCCESS) {
 		/* A new request, continue processing it. */
 		LogFullDebug(COMPONENT_DISPATCH,
@@ -1055,7 +1070,11 @@ void nfs_rpc_execute(request_data_t *reqdata)
 			    "nfs_rpc_execute about to call nfs_export_check_access for client %s",
 			    client_ip);
 
-		export_check_access();
+		cred_cache = nfs_xprt_cred_cache(xprt);
+		creds_cached = nfs_cred_cache_get(cred_cache,
+						  &reqdata->r_u.req.svc);
+		if (!creds_cached)
+			export_check_access();
 
 		if ((export_perms.options & EXPORT_OPTION_ACCESS_MASK) == 0) {
 			LogInfoAlt(COMPONENT_DISPATCH, COMPONENT_EXPORT,
@@ -1233,6 +1252,11 @@ void nfs_rpc_execute(request_data_t *reqdata)
 				auth_rc = AUTH_TOOWEAK;
 				goto auth_failure;
 			}
+
+			if (!creds_cached &&
+			    (reqdesc->dispatch_behaviour & NEEDS_EXPORT))
+				nfs_cred_cache_put(cred_cache,
+						   &reqdata->r_u.req.svc);
 		}
 
 		/* processing
@@ -1419,6 +1443,11 @@ void nfs_rpc_execute(request_data_t *reqdata)
 	if (res_nfs)
 		nfs_dupreq_rele(&reqdata->r_u.req.svc, reqdesc);
 
+	/* The reply is gone, and with it everything in the arena */
+	if (req_arena.first != NULL)
+		gsh_arena_reset(&req_arena);
+	op_ctx->arena = NULL;
+
 	SetClientIP(NULL);
 	if (op_ctx->client != NULL) {
 		put_gsh_client(op_ctx->client);
@@ -1511,6 +1540,7 @@ static void worker_thread_initializer(struct fridgethr_context *ctx)
 static void worker_thread_finalizer(struct fridgethr_context *ctx)
 {
 	ctx->thread_info = NULL;
+	gsh_arena_destroy(&req_arena);
 }
 
 /**
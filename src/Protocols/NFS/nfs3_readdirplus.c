@@ -53,23 +53,31 @@ fsal_errors_t nfs3_readdirplus_callback(void *opaque,
 					       uint64_t cookie,
 					       enum cb_state cb_state);
 
-static void free_entryplus3s(entryplus3 *entryplus3s);
+/**
+ * @brief What a READDIRPLUS3resok takes besides the entries
+ *
+ * The directory's post_op_attr with its fattr3, the cookie verifier,
+ * the word ending the entry list and eof.
+ */
+#define READDIRPLUS3_RESOK_FIXED \
+	(22 * BYTES_PER_XDR_UNIT + NFS3_COOKIEVERFSIZE + 2 * BYTES_PER_XDR_UNIT)
 
 /**
  * @brief Opaque bookkeeping structure for NFSPROC3_READDIRPLUS
  *
  * This structure keeps track of the process of writing out an NFSv3
  * READDIRPLUS response between calls to nfs3_readdirplus_callback.
+ * Entries are encoded into one buffer as they come, in the form they
+ * take in the reply.
  */
 
 struct nfs3_readdirplus_cb_data {
-	entryplus3 *entries;	/*< The array holding individual entries */
+	char *entries;		/*< The encoded entries */
+	size_t used;		/*< Bytes of entries encoded */
 	size_t mem_left;	/*< The amount of memory remaining before we
 				   hit maxcount */
 	size_t count;		/*< The count of complete entries stored in the
 				   buffer */
-	size_t total_entries;	/*< The number of entires we allocated for
-				   the array. */
 	nfsstat3 error;		/*< Set to a value other than NFS_OK if the
 				   callback function finds a fatal error. */
 };
@@ -116,7 +124,7 @@ int nfs3_readdirplus(nfs_arg_t *arg, struct svc_req *req, nfs_res_t *res)
 	uint64_t fsal_cookie = 0;
 	cookieverf3 cookie_verifier;
 	unsigned int num_entries = 0;
-	unsigned long estimated_num_entries = 0;
+	unsigned long maxcount = 0;
 	object_file_type_t dir_filetype = 0;
 	bool eod_met = false;
 	fsal_status_t fsal_status = {0, 0};
@@ -124,6 +132,7 @@ int nfs3_readdirplus(nfs_arg_t *arg, struct svc_req *req, nfs_res_t *res)
 	int rc = NFS_REQ_OK;
 	struct nfs3_readdirplus_cb_data tracker = {
 		.entries = NULL,
+		.used = 0,
 		.mem_left = 0,
 		.count = 0,
 		.error = NFS3_OK,
@@ -164,26 +173,28 @@ int nfs3_readdirplus(nfs_arg_t *arg, struct svc_req *req, nfs_res_t *res)
 		goto out;
 	}
 
-	tracker.mem_left = (arg->arg_readdirplus3.maxcount * 9) / 10;
+	/* Entries are counted as they are encoded, so all of maxcount
+	 * can be used, but no more than a reply can hold.
+	 */
+	maxcount = arg->arg_readdirplus3.maxcount;
+	if (maxcount > nfs_param.core_param.rpc.max_send_buffer_size)
+		maxcount = nfs_param.core_param.rpc.max_send_buffer_size;
 	begin_cookie = arg->arg_readdirplus3.cookie;
 
-	tracker.mem_left -= sizeof(READDIRPLUS3resok);
-
-	/* Estimate assuming that we're going to send no names and no handles.
-	 * Don't count space for pointers for nextentry or
-	 * name_handle.data.data_val in entryplus3
-	 */
-	estimated_num_entries = MIN((tracker.mem_left + sizeof(entryplus3 *))
-				    / (sizeof(entryplus3) - sizeof(char *) * 2),
-				    50);
+	if (maxcount < READDIRPLUS3_RESOK_FIXED) {
+		res->res_readdirplus3.status = NFS3ERR_TOOSMALL;
+		LogFullDebug(COMPONENT_NFS_READDIR,
+			     "Response too small");
+		goto out;
+	}
 
-	tracker.total_entries = estimated_num_entries;
+	tracker.mem_left = maxcount - READDIRPLUS3_RESOK_FIXED;
 
 	LogFullDebug(COMPONENT_NFS_READDIR,
 		     "nfs3_readdirplus: dircount=%u begin_cookie=%" PRIu64
-		     " estimated_num_entries=%lu, mem_left=%zd",
+		     " mem_left=%zd",
 		     arg->arg_readdirplus3.dircount, begin_cookie,
-		     estimated_num_entries, tracker.mem_left);
+		     tracker.mem_left);
 
 	/* Convert file handle into a vnode */
 	dir_obj = nfs3_FhandleToCache(&(arg->arg_readdirplus3.dir),
@@ -259,7 +270,7 @@ int nfs3_readdirplus(nfs_arg_t *arg, struct svc_req *req, nfs_res_t *res)
 		fsal_cookie = 0;
 
 	/* Allocate space for entries */
-	tracker.entries = gsh_calloc(estimated_num_entries, sizeof(entryplus3));
+	tracker.entries = req_alloc(tracker.mem_left);
 
 	if (begin_cookie == 0) {
 		/* Fill in "." */
@@ -332,16 +343,22 @@ int nfs3_readdirplus(nfs_arg_t *arg, struct svc_req *req, nfs_res_t *res)
 
 	if ((num_entries == 0) && (begin_cookie > 1)) {
 		res->res_readdirplus3.status = NFS3_OK;
-		res->res_readdirplus3.READDIRPLUS3res_u.resok.reply.entries =
-		    NULL;
 		res->res_readdirplus3.READDIRPLUS3res_u.resok.reply.eof = TRUE;
 	} else {
-		res->res_readdirplus3.READDIRPLUS3res_u.resok.reply.entries =
-		    tracker.entries;
 		res->res_readdirplus3.READDIRPLUS3res_u.resok.reply.eof =
 		    eod_met;
 	}
 
+	if (tracker.count != 0) {
+		res->res_readdirplus3.READDIRPLUS3res_u.resok.reply.
+			entries_wire = tracker.entries;
+		res->res_readdirplus3.READDIRPLUS3res_u.resok.reply.
+			entries_wire_len = tracker.used;
+	} else {
+		req_free(tracker.entries);
+		tracker.entries = NULL;
+	}
+
 	nfs_SetPostOpAttr(dir_obj,
 			  &res->res_readdirplus3.READDIRPLUS3res_u.resok.
 				dir_attributes,
@@ -376,7 +393,7 @@ int nfs3_readdirplus(nfs_arg_t *arg, struct svc_req *req, nfs_res_t *res)
 
 	if (((res->res_readdir3.status != NFS3_OK) || (rc != NFS_REQ_OK))
 	    && (tracker.entries != NULL))
-		free_entryplus3s(tracker.entries);
+		req_free(tracker.entries);
 
 	return rc;
 }				/* nfs3_readdirplus */
@@ -393,19 +410,20 @@ void nfs3_readdirplus_free(nfs_res_t *resp)
 {
 #define RESREADDIRPLUSREPLY resp->res_readdirplus3.READDIRPLUS3res_u.resok.reply
 	if ((resp->res_readdirplus3.status == NFS3_OK)
-	    && (RESREADDIRPLUSREPLY.entries != NULL))
-		free_entryplus3s(RESREADDIRPLUSREPLY.entries);
+	    && (RESREADDIRPLUSREPLY.entries_wire != NULL))
+		req_free(RESREADDIRPLUSREPLY.entries_wire);
 }
 
 /**
- * @brief Populate entryplus3s when called from fsal_readdir
+ * @brief Encode entryplus3s when called from fsal_readdir
  *
- * This function is a callback passed to fsal_readdir.  It
- * fills in a pre-allocated array of entryplys3 structures and allocates
- * space for the name and attributes.  This space must be freed.
+ * This function is a callback passed to fsal_readdir.  It encodes
+ * each entry, handle and attributes included, straight after the
+ * previous one.  Nothing is allocated per entry, and an entry is only
+ * kept if all of it fits in what is left of maxcount.
  *
  * @param opaque [in] Pointer to a struct nfs3_readdirplus_cb_data that is
- *                    gives the location of the array and other
+ *                    gives the location of the buffer and other
  *                    bookeeping information
  * @param name [in] The filename for the current obj
  * @param handle [in] The current obj's filehandle
@@ -423,94 +441,69 @@ fsal_errors_t nfs3_readdirplus_callback(void *opaque,
 	/* Not-so-opaque pointer to callback data` */
 	struct fsal_readdir_cb_parms *cb_parms = opaque;
 	struct nfs3_readdirplus_cb_data *tracker = cb_parms->opaque;
-	/* Length of the current filename */
-	size_t namelen = strlen(cb_parms->name);
-	entryplus3 *ep3 = tracker->entries + tracker->count;
-
-	if (tracker->count == tracker->total_entries) {
-		cb_parms->in_result = false;
-		return ERR_FSAL_NO_ERROR;
-	}
-	/* This is a pessimistic check, which assumes that we're going
-	 * to send attributes and full size handle - if it fails then
-	 * we're close enough to the buffer size limit and t's time to
-	 * stop anyway */
-	if (tracker->mem_left
-	    < (sizeof(entryplus3) + namelen + NFS3_FHSIZE)) {
-		if (tracker->count == 0)
-			tracker->error = NFS3ERR_TOOSMALL;
-
-		cb_parms->in_result = false;
-		return ERR_FSAL_NO_ERROR;
-	}
+	char fh[NFS3_FHSIZE];
+	entryplus3 ep3;
+	bool_t more = TRUE;
+	XDR xdr;
+	bool ok;
 
-	ep3->fileid = obj->fileid;
-	ep3->name = gsh_strdup(cb_parms->name);
-	ep3->cookie = cookie;
-
-	/* Account for file name + length + cookie */
-	tracker->mem_left -= sizeof(ep3->cookie) + ((namelen + 3) & ~3) + 4;
+	memset(&ep3, 0, sizeof(ep3));
+	ep3.fileid = obj->fileid;
+	ep3.name = (char *)cb_parms->name;
+	ep3.cookie = cookie;
 
 	if (cb_parms->attr_allowed) {
-		ep3->name_handle.handle_follows = TRUE;
+		ep3.name_handle.handle_follows = TRUE;
+		ep3.name_handle.post_op_fh3_u.handle.data.data_val = fh;
 
-		if (!nfs3_FSALToFhandle(true,
-					&ep3->name_handle.post_op_fh3_u.handle,
+		if (!nfs3_FSALToFhandle(false,
+					&ep3.name_handle.post_op_fh3_u.handle,
 					obj,
 					op_ctx->ctx_export)) {
 			tracker->error = NFS3ERR_SERVERFAULT;
-			gsh_free(ep3->name);
 			cb_parms->in_result = false;
 			return ERR_FSAL_NO_ERROR;
 		}
 
-		/* Account for filehande + length + follows + nextentry */
-		tracker->mem_left -=
-		    ep3->name_handle.post_op_fh3_u.handle.data.data_len + 12;
-
-		ep3->name_attributes.attributes_follow = true;
+		ep3.name_attributes.attributes_follow = TRUE;
 
 		nfs3_FSALattr_To_Fattr(
 			obj, attr,
-			&ep3->name_attributes.post_op_attr_u.attributes);
+			&ep3.name_attributes.post_op_attr_u.attributes);
 	} else {
-		ep3->name_handle.handle_follows = false;
-		ep3->name_attributes.attributes_follow = false;
-		tracker->mem_left -= sizeof(ep3->name_handle.handle_follows);
+		ep3.name_handle.handle_follows = FALSE;
+		ep3.name_attributes.attributes_follow = FALSE;
 	}
 
-	if (ep3->name_attributes.attributes_follow)
-		tracker->mem_left -= sizeof(ep3->name_attributes);
-	else
-		tracker->mem_left -=
-		    sizeof(ep3->name_attributes.attributes_follow);
+	/* The value follows word of the previous entry's nextentry (or
+	 * of the list), then the entry itself.
+	 */
+	memset(&xdr, 0, sizeof(xdr));
+	xdrmem_create(&xdr, tracker->entries + tracker->used,
+		      tracker->mem_left, XDR_ENCODE);
+	ok = xdr_bool(&xdr, &more) &&
+	     xdr_fileid3(&xdr, &ep3.fileid) &&
+	     xdr_filename3(&xdr, &ep3.name) &&
+	     xdr_cookie3(&xdr, &ep3.cookie) &&
+	     xdr_post_op_attr(&xdr, &ep3.name_attributes) &&
+	     xdr_post_op_fh3(&xdr, &ep3.name_handle);
+
+	if (!ok) {
+		/* Not even one entry fits */
+		if (tracker->count == 0)
+			tracker->error = NFS3ERR_TOOSMALL;
 
-	if (tracker->count > 0)
-		tracker->entries[tracker->count - 1].nextentry = ep3;
+		xdr_destroy(&xdr);
+		cb_parms->in_result = false;
+		return ERR_FSAL_NO_ERROR;
+	}
+
+	tracker->used += xdr_getpos(&xdr);
+	tracker->mem_left -= xdr_getpos(&xdr);
+	xdr_destroy(&xdr);
 
 	++(tracker->count);
 	cb_parms->in_result = true;
 
 	return ERR_FSAL_NO_ERROR;
 }				/* nfs3_readdirplus_callback */
-
-/**
- * @brief Clean up memory allocated to serve NFSv3 READDIRPLUS
- *
- * This function traverses the list of entries, freeing all names
- * allocated in the callback function, then frees the list itself.
- *
- * @param entryplus3s [in] Pointer to first obj
- */
-
-static void free_entryplus3s(entryplus3 *entryplus3s)
-{
-	entryplus3 *entry = NULL;
-
-	for (entry = entryplus3s; entry != NULL; entry = entry->nextentry) {
-		gsh_free(entry->name);
-		gsh_free(entry->name_handle.post_op_fh3_u.handle.data.data_val);
-	}
-
-	gsh_free(entryplus3s);
-}
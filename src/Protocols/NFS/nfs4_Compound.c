@@ -42,6 +42,13 @@
 #include "server_stats.h"
 #include "export_mgr.h"
 #include "nfs_creds.h"
+#include "nfs_file_handle.h"
+#include "fridgethr.h"
+#include "abstract_atomic.h"
+#ifdef USE_DBUS
+#include "gsh_dbus.h"
+#include "server_stats_private.h"
+#endif
 
 #ifdef USE_LTTNG
 #include "gsh_lttng/nfs_rpc.h"
@@ -364,12 +371,12 @@ static const struct nfs4_op_desc optabv4[] = {
 				.name = "OP_ALLOCATE",
 				.funct = nfs4_op_allocate,
 				.free_res = nfs4_op_write_Free,
-				.exp_perm_flags = 0},
+				.exp_perm_flags = EXPORT_OPTION_WRITE_ACCESS},
 	[NFS4_OP_COPY] = {
 				.name = "OP_COPY",
-				.funct = nfs4_op_notsupp,
-				.free_res = nfs4_op_notsupp_Free,
-				.exp_perm_flags = 0},
+				.funct = nfs4_op_copy,
+				.free_res = nfs4_op_copy_Free,
+				.exp_perm_flags = EXPORT_OPTION_WRITE_ACCESS},
 	[NFS4_OP_COPY_NOTIFY] = {
 				.name = "OP_COPY_NOTIFY",
 				.funct = nfs4_op_notsupp,
@@ -379,7 +386,7 @@ static const struct nfs4_op_desc optabv4[] = {
 				.name = "OP_DEALLOCATE",
 				.funct = nfs4_op_deallocate,
 				.free_res = nfs4_op_write_Free,
-				.exp_perm_flags = 0},
+				.exp_perm_flags = EXPORT_OPTION_WRITE_ACCESS},
 	[NFS4_OP_IO_ADVISE] = {
 				.name = "OP_IO_ADVISE",
 				.funct = nfs4_op_io_advise,
@@ -397,13 +404,13 @@ static const struct nfs4_op_desc optabv4[] = {
 				.exp_perm_flags = 0},
 	[NFS4_OP_OFFLOAD_CANCEL] = {
 				.name = "OP_OFFLOAD_CANCEL",
-				.funct = nfs4_op_notsupp,
-				.free_res = nfs4_op_notsupp_Free,
+				.funct = nfs4_op_offload_cancel,
+				.free_res = nfs4_op_offload_cancel_Free,
 				.exp_perm_flags = 0},
 	[NFS4_OP_OFFLOAD_STATUS] = {
 				.name = "OP_OFFLOAD_STATUS",
-				.funct = nfs4_op_notsupp,
-				.free_res = nfs4_op_notsupp_Free,
+				.funct = nfs4_op_offload_status,
+				.free_res = nfs4_op_offload_status_Free,
 				.exp_perm_flags = 0},
 	[NFS4_OP_READ_PLUS] = {
 				.name = "OP_READ_PLUS",
@@ -422,9 +429,9 @@ static const struct nfs4_op_desc optabv4[] = {
 				.exp_perm_flags = 0},
 	[NFS4_OP_CLONE] = {
 				.name = "OP_CLONE",
-				.funct = nfs4_op_notsupp,
-				.free_res = nfs4_op_notsupp_Free,
-				.exp_perm_flags = 0},
+				.funct = nfs4_op_clone,
+				.free_res = nfs4_op_clone_Free,
+				.exp_perm_flags = EXPORT_OPTION_WRITE_ACCESS},
 
 	/* NFSv4.3 */
 	[NFS4_OP_GETXATTR] = {
@@ -458,6 +465,221 @@ nfs_opnum4 LastOpcode[] = {
 	NFS4_OP_REMOVEXATTR
 };
 
+/**
+ * @brief Check whether a COMPOUND's result may outlive the request
+ *
+ * The NFSv4.1 session slots keep the result of a SEQUENCE with
+ * sa_cachethis and of CREATE_SESSION for replays, so none of it may
+ * come from the request's arena.
+ *
+ * @param[in] arg The COMPOUND arguments
+ *
+ * @return true if the result may be kept in a replay cache.
+ */
+
+static bool nfs4_Compound_result_cached(COMPOUND4args *arg)
+{
+	nfs_argop4 *argarray = arg->argarray.argarray_val;
+	unsigned int i;
+
+	if (arg->minorversion == 0 || arg->argarray.argarray_len == 0)
+		return false;
+
+	if (argarray[0].argop == NFS4_OP_SEQUENCE &&
+	    argarray[0].nfs_argop4_u.opsequence.sa_cachethis)
+		return true;
+
+	for (i = 0; i < arg->argarray.argarray_len; i++) {
+		if (argarray[i].argop == NFS4_OP_CREATE_SESSION)
+			return true;
+	}
+
+	return false;
+}
+
+/**
+ * @brief Number of COMPOUND shapes counted
+ *
+ * Clients send few distinct shapes, a shape seen once the table is
+ * full is only counted in compound_shapes_other.
+ */
+#define COMPOUND_SHAPE_SLOTS 64
+
+/**
+ * @brief Opcodes kept in a shape key
+ *
+ * The key holds one opcode per byte, the last byte is the number of
+ * ops, capped at COMPOUND_SHAPE_OPS + 1 for longer COMPOUNDs.
+ */
+#define COMPOUND_SHAPE_OPS 7
+
+struct compound_shape {
+	uint64_t key;		/*< Opcodes and op count, 0 while free */
+	uint64_t count;		/*< COMPOUNDs of this shape */
+};
+
+static struct compound_shape compound_shapes[COMPOUND_SHAPE_SLOTS];
+static uint64_t compound_shapes_other;
+static pthread_mutex_t compound_shapes_mutex = PTHREAD_MUTEX_INITIALIZER;
+
+static uint64_t compound_shape_key(nfs_argop4 *argarray,
+				   uint32_t argarray_len,
+				   uint32_t minorversion)
+{
+	uint64_t key = MIN(argarray_len, COMPOUND_SHAPE_OPS + 1);
+	uint32_t i;
+
+	key <<= 8 * COMPOUND_SHAPE_OPS;
+	for (i = 0; i < argarray_len && i < COMPOUND_SHAPE_OPS; i++) {
+		uint64_t op = argarray[i].argop;
+
+		if (op > LastOpcode[minorversion])
+			op = 0;
+		key |= op << (8 * i);
+	}
+	return key;
+}
+
+/**
+ * @brief Find or add the counters for a shape
+ *
+ * Lookups take no lock, a slot's key is set once and never changes.
+ *
+ * @param[in] key The shape key
+ *
+ * @return The counters, NULL if the table is full.
+ */
+
+static struct compound_shape *compound_shape_get(uint64_t key)
+{
+	uint32_t hash = (key * 0x9E3779B97F4A7C15ULL) >> 32;
+	struct compound_shape *shape = NULL;
+	uint64_t found = 0;
+	uint32_t i;
+
+	hash %= COMPOUND_SHAPE_SLOTS;
+
+	for (i = 0; i < COMPOUND_SHAPE_SLOTS; i++) {
+		shape = &compound_shapes[(hash + i) % COMPOUND_SHAPE_SLOTS];
+		found = atomic_fetch_uint64_t(&shape->key);
+		if (found == key)
+			return shape;
+		if (found == 0)
+			break;
+	}
+	if (found != 0)
+		return NULL;
+
+	PTHREAD_MUTEX_lock(&compound_shapes_mutex);
+	for (; i < COMPOUND_SHAPE_SLOTS; i++) {
+		shape = &compound_shapes[(hash + i) % COMPOUND_SHAPE_SLOTS];
+		if (shape->key == 0)
+			atomic_store_uint64_t(&shape->key, key);
+		if (shape->key == key)
+			break;
+		shape = NULL;
+	}
+	PTHREAD_MUTEX_unlock(&compound_shapes_mutex);
+
+	return shape;
+}
+
+/**
+ * @brief Count a COMPOUND under its shape
+ *
+ * @param[in] argarray     The ops
+ * @param[in] argarray_len Number of ops
+ * @param[in] minorversion Minor version of the COMPOUND
+ */
+
+static void nfs4_Compound_count_shape(nfs_argop4 *argarray,
+				      uint32_t argarray_len,
+				      uint32_t minorversion)
+{
+	struct compound_shape *shape;
+
+	shape = compound_shape_get(compound_shape_key(argarray,
+						      argarray_len,
+						      minorversion));
+	if (shape == NULL) {
+		atomic_inc_uint64_t(&compound_shapes_other);
+		return;
+	}
+	atomic_inc_uint64_t(&shape->count);
+}
+
+#ifdef USE_DBUS
+static void compound_shape_name(uint64_t key, char *buf, size_t size)
+{
+	uint32_t nops = key >> (8 * COMPOUND_SHAPE_OPS);
+	size_t len = 0;
+	uint32_t i;
+
+	buf[0] = '\0';
+	for (i = 0; i < nops && i < COMPOUND_SHAPE_OPS; i++) {
+		/* "OP_PUTFH" is shown as "PUTFH" */
+		const char *name = optabv4[(key >> (8 * i)) & 0xFF].name + 3;
+
+		len += snprintf(buf + len, size - len, "%s%s",
+				i == 0 ? "" : ",", name);
+		if (len >= size)
+			return;
+	}
+	if (nops > COMPOUND_SHAPE_OPS)
+		snprintf(buf + len, size - len, ",...");
+}
+
+static void compound_shape_dbus(DBusMessageIter *array_iter, char *name,
+				uint64_t count)
+{
+	DBusMessageIter struct_iter;
+
+	dbus_message_iter_open_container(array_iter, DBUS_TYPE_STRUCT, NULL,
+					 &struct_iter);
+	dbus_message_iter_append_basic(&struct_iter, DBUS_TYPE_STRING, &name);
+	dbus_message_iter_append_basic(&struct_iter, DBUS_TYPE_UINT64, &count);
+	dbus_message_iter_close_container(array_iter, &struct_iter);
+}
+
+/**
+ * @brief Report COMPOUND shape counters
+ *
+ * Appends an array of (shape, COMPOUNDs), the shape being the op
+ * names joined by commas.  COMPOUNDs that found
+ * the table full are reported under the shape "*".
+ *
+ * @param[in,out] iter The reply
+ */
+
+void nfs4_compound_dbus_shapes(DBusMessageIter *iter)
+{
+	DBusMessageIter array_iter;
+	char name[256];
+	uint64_t count;
+	uint32_t i;
+
+	dbus_message_iter_open_container(iter, DBUS_TYPE_ARRAY, "(st)",
+					 &array_iter);
+	for (i = 0; i < COMPOUND_SHAPE_SLOTS; i++) {
+		struct compound_shape *shape = &compound_shapes[i];
+		uint64_t key = atomic_fetch_uint64_t(&shape->key);
+
+		if (key == 0)
+			continue;
+
+		compound_shape_name(key, name, sizeof(name));
+		compound_shape_dbus(&array_iter, name,
+				    atomic_fetch_uint64_t(&shape->count));
+	}
+
+	count = atomic_fetch_uint64_t(&compound_shapes_other);
+	if (count != 0)
+		compound_shape_dbus(&array_iter, "*", count);
+
+	dbus_message_iter_close_container(iter, &array_iter);
+}
+#endif				/* USE_DBUS */
+
 /**
  * @brief The NFS PROC4 COMPOUND
  *
@@ -505,13 +727,20 @@ int nfs4_Compound(nfs_arg_t *arg, struct svc_req *req, nfs_res_t *res)
 		return NFS_REQ_OK;
 	}
 
+	/* A result kept for replays must not live in the arena that is
+	 * reset once this reply is sent.
+	 */
+	if (op_ctx->arena != NULL &&
+	    nfs4_Compound_result_cached(&arg->arg_compound4))
+		op_ctx->arena = NULL;
+
 	/* Keeping the same tag as in the arguments */
 	res->res_compound4.tag.utf8string_len =
 	    arg->arg_compound4.tag.utf8string_len;
 	if (res->res_compound4.tag.utf8string_len > 0) {
 
 		res->res_compound4.tag.utf8string_val =
-		    gsh_malloc(res->res_compound4.tag.utf8string_len + 1);
+		    req_alloc(res->res_compound4.tag.utf8string_len + 1);
 
 		memcpy(res->res_compound4.tag.utf8string_val,
 		       arg->arg_compound4.tag.utf8string_val,
@@ -582,7 +811,7 @@ int nfs4_Compound(nfs_arg_t *arg, struct svc_req *req, nfs_res_t *res)
 
 	/* Allocating the reply nfs_resop4 */
 	res->res_compound4.resarray.resarray_val =
-		gsh_calloc(argarray_len, sizeof(struct nfs_resop4));
+		req_calloc(argarray_len, sizeof(struct nfs_resop4));
 
 	res->res_compound4.resarray.resarray_len = argarray_len;
 	resarray = res->res_compound4.resarray.resarray_val;
@@ -650,6 +879,8 @@ int nfs4_Compound(nfs_arg_t *arg, struct svc_req *req, nfs_res_t *res)
 		}
 	}
 
+	nfs4_Compound_count_shape(argarray, argarray_len, compound4_minor);
+
 	for (i = 0; i < argarray_len; i++) {
 		/* Used to check if OP_SEQUENCE is the first operation */
 		data.oppos = i;
@@ -783,7 +1014,7 @@ int nfs4_Compound(nfs_arg_t *arg, struct svc_req *req, nfs_res_t *res)
 			 */
 
 			/* Free the reply allocated above */
-			gsh_free(res->res_compound4.resarray.resarray_val);
+			req_free(res->res_compound4.resarray.resarray_val);
 
 			/* Copy the reply from the cache */
 			res->res_compound4_extended = *data.cached_res;
@@ -805,9 +1036,19 @@ int nfs4_Compound(nfs_arg_t *arg, struct svc_req *req, nfs_res_t *res)
 	/* Manage session's DRC: keep NFS4.1 replay for later use, but don't
 	 * save a replayed result again.
 	 */
-	if (data.cached_res != NULL && !data.use_drc) {
-		/* Pointer has been set by nfs4_op_sequence and points to slot
-		 * to cache result in.
+	if (data.session != NULL && data.cached_res != NULL &&
+	    !data.use_drc) {
+		/* Pointer has been set by nfs4_op_sequence and points to the
+		 * slot to cache result in, the size is checked against
+		 * ca_maxresponsesize_cached.  A reply too big to cache ends
+		 * with NFS4ERR_REP_TOO_BIG_TO_CACHE instead.
+		 */
+		(void) nfs41_Session_Cache_Reply(data.session, data.slot,
+						 &res->res_compound4_extended);
+		status = res->res_compound4.status;
+	} else if (data.cached_res != NULL && !data.use_drc) {
+		/* Pointer has been set by nfs4_op_create_session and points
+		 * to the CREATE_SESSION slot to cache result in.
 		 */
 		LogFullDebug(COMPONENT_SESSIONS,
 			     "Save result in session replay cache %p sizeof nfs_res_t=%d",
@@ -904,10 +1145,8 @@ void nfs4_Compound_Free(nfs_res_t *res)
 		}
 	}
 
-	gsh_free(res->res_compound4.resarray.resarray_val);
-
-	if (res->res_compound4.tag.utf8string_val)
-		gsh_free(res->res_compound4.tag.utf8string_val);
+	req_free(res->res_compound4.resarray.resarray_val);
+	req_free(res->res_compound4.tag.utf8string_val);
 }
 
 /**
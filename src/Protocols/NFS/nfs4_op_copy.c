@@ -0,0 +1,1018 @@
+/*
+ * vim:noexpandtab:shiftwidth=8:tabstop=8:
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public License
+ * as published by the Free Software Foundation; either version 3 of
+ * the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA
+ * 02110-1301 USA
+ *
+ * ---------------------------------------
+ */
+
+/**
+ * @file    nfs4_op_copy.c
+ * @brief   NFSv4.2 server side copy and clone operations
+ *
+ * This file implements NFS4_OP_COPY, NFS4_OP_OFFLOAD_STATUS,
+ * NFS4_OP_OFFLOAD_CANCEL and NFS4_OP_CLONE within an NFSv4 compound
+ * call.  Only copies within an export are done; the source is the
+ * saved filehandle and the destination the current one.
+ */
+#include "config.h"
+#include <stdio.h>
+#include <string.h>
+#include <pthread.h>
+#include "log.h"
+#include "fsal.h"
+#include "nfs_core.h"
+#include "sal_functions.h"
+#include "nfs_proto_functions.h"
+#include "nfs_proto_tools.h"
+#include "nfs_convert.h"
+#include "nfs_file_handle.h"
+#include "nfs_rpc_callback.h"
+#include "export_mgr.h"
+#include "fridgethr.h"
+#include "server_stats.h"
+#include "gsh_list.h"
+
+/* Smaller copies are done synchronously whatever the client asks */
+#define COPY_ASYNC_MIN (16 * 1024 * 1024)
+
+/* Amount copied between two looks at the cancel flag, and the most a
+ * synchronous COPY does; the client asks again for the rest.
+ */
+#define COPY_ASYNC_CHUNK (64 * 1024 * 1024)
+
+/**
+ * @brief A COPY running or done in the background
+ */
+
+struct nfs4_offload {
+	struct glist_head link;		/*< In offload_list */
+	stateid4 stateid;		/*< Given to the client for it */
+	clientid4 clientid;		/*< Client that asked for it */
+	nfs_client_id_t *client;	/*< For CB_OFFLOAD, until it is sent */
+	struct gsh_export *export;
+	struct user_cred creds;		/*< Caller's, to copy as */
+	struct fsal_obj_handle *src_obj;
+	struct fsal_obj_handle *dst_obj;
+	state_t *src_state;
+	state_t *dst_state;
+	nfs_fh4 dst_fh;			/*< Sent back in CB_OFFLOAD */
+	uint64_t src_offset;
+	uint64_t dst_offset;
+	uint64_t count;
+	uint64_t copied;		/*< Progress, read by OFFLOAD_STATUS */
+	verifier4 verifier;		/*< Write verifier once done */
+	nfsstat4 status;		/*< Result once done */
+	bool done;
+	int8_t cancelled;		/*< Set by OFFLOAD_CANCEL */
+	time_t finished;
+};
+
+static struct fridgethr *copy_fridge;
+static pthread_mutex_t offload_mutex = PTHREAD_MUTEX_INITIALIZER;
+static struct glist_head offload_list = GLIST_HEAD_INIT(offload_list);
+static uint32_t offload_counter;
+
+/**
+ * @brief Check that a stateid allows reading or writing a file
+ *
+ * A special stateid starts anonymous I/O on the file, which
+ * copy_io_done finishes.
+ *
+ * @param[in] obj     The file
+ * @param[in] state   State found for the stateid, NULL if special
+ * @param[in] access  OPEN4_SHARE_ACCESS_READ or OPEN4_SHARE_ACCESS_WRITE
+ *
+ * @return NFS4_OK or the error for the stateid.
+ */
+
+static nfsstat4 copy_check_state(struct fsal_obj_handle *obj,
+				 state_t *state, uint32_t access)
+{
+	state_t *state_open;
+
+	/* No open state, check to see if any share conflicts */
+	if (state == NULL)
+		return nfs4_Errno_state(
+			state_share_anonymous_io_start(obj, access,
+						       SHARE_BYPASS_NONE));
+
+	switch (state->state_type) {
+	case STATE_TYPE_SHARE:
+		state_open = state;
+		break;
+	case STATE_TYPE_LOCK:
+		state_open = state->state_data.lock.openstate;
+		break;
+	case STATE_TYPE_DELEG:
+		if (state->state_data.deleg.sd_state != DELEG_GRANTED)
+			return NFS4ERR_BAD_STATEID;
+		if (access == OPEN4_SHARE_ACCESS_WRITE &&
+		    !(state->state_data.deleg.sd_type & OPEN_DELEGATE_WRITE))
+			return NFS4ERR_BAD_STATEID;
+		return NFS4_OK;
+	default:
+		return NFS4ERR_BAD_STATEID;
+	}
+
+	if (state_open != NULL &&
+	    (state_open->state_data.share.share_access & access) == 0)
+		return NFS4ERR_OPENMODE;
+
+	return NFS4_OK;
+}
+
+/**
+ * @brief Be done with the stateid of one side of a COPY or CLONE
+ *
+ * @param[in] obj     The file
+ * @param[in] state   State found for the stateid, NULL if special
+ * @param[in] access  OPEN4_SHARE_ACCESS_READ or OPEN4_SHARE_ACCESS_WRITE
+ */
+
+static void copy_io_done(struct fsal_obj_handle *obj, state_t *state,
+			 uint32_t access)
+{
+	if (state != NULL)
+		dec_state_t_ref(state);
+	else
+		state_share_anonymous_io_done(obj, access);
+}
+
+/**
+ * @brief Check the source and destination of a COPY or CLONE
+ *
+ * The source is the saved filehandle and the destination the current
+ * one, both regular files in the same export.  On success the states
+ * found for the stateids are returned with a reference, or anonymous
+ * I/O is started for a special stateid, and count is resolved when 0.
+ * The caller ends both with copy_io_done.
+ *
+ * @param[in]     data        Compound request's data
+ * @param[in]     src_stateid Stateid to read the source with
+ * @param[in]     dst_stateid Stateid to write the destination with
+ * @param[in]     src_offset  Position in the source
+ * @param[in]     dst_offset  Position in the destination
+ * @param[in,out] count       Bytes to copy, 0 for up to the end of source
+ * @param[out]    src_state   State for src_stateid
+ * @param[out]    dst_state   State for dst_stateid
+ * @param[in]     tag         Operation name, for logging
+ *
+ * @return NFS4_OK or the error for the operation.
+ */
+
+static nfsstat4 copy_check_args(compound_data_t *data,
+				stateid4 *src_stateid, stateid4 *dst_stateid,
+				uint64_t src_offset, uint64_t dst_offset,
+				uint64_t *count, state_t **src_state,
+				state_t **dst_state, const char *tag)
+{
+	struct fsal_obj_handle *src_obj = data->saved_obj;
+	struct fsal_obj_handle *dst_obj = data->current_obj;
+	struct attrlist attrs;
+	fsal_status_t fsal_status;
+	uint64_t filesize;
+	nfsstat4 status;
+
+	*src_state = NULL;
+	*dst_state = NULL;
+
+	status = nfs4_sanity_check_FH(data, REGULAR_FILE, false);
+	if (status != NFS4_OK)
+		return status;
+
+	status = nfs4_sanity_check_saved_FH(data, REGULAR_FILE, false);
+	if (status != NFS4_OK)
+		return status;
+
+	/* Check that both handles are in the same export. */
+	if (op_ctx->ctx_export != NULL && data->saved_export != NULL &&
+	    op_ctx->ctx_export->export_id != data->saved_export->export_id)
+		return NFS4ERR_XDEV;
+
+	status = nfs4_Check_Stateid(src_stateid, src_obj, src_state, data,
+				    STATEID_SPECIAL_ANY, 0, false, tag);
+	if (status != NFS4_OK)
+		return status;
+
+	status = nfs4_Check_Stateid(dst_stateid, dst_obj, dst_state, data,
+				    STATEID_SPECIAL_ANY, 0, false, tag);
+	if (status != NFS4_OK)
+		goto err;
+
+	status = copy_check_state(src_obj, *src_state,
+				  OPEN4_SHARE_ACCESS_READ);
+	if (status != NFS4_OK)
+		goto err;
+
+	status = copy_check_state(dst_obj, *dst_state,
+				  OPEN4_SHARE_ACCESS_WRITE);
+	if (status != NFS4_OK)
+		goto err_src;
+
+	fsal_status = src_obj->obj_ops.test_access(src_obj, FSAL_READ_ACCESS,
+						   NULL, NULL, true);
+	if (!FSAL_IS_ERROR(fsal_status))
+		fsal_status = dst_obj->obj_ops.test_access(dst_obj,
+							   FSAL_WRITE_ACCESS,
+							   NULL, NULL, true);
+	if (FSAL_IS_ERROR(fsal_status)) {
+		status = nfs4_Errno_status(fsal_status);
+		goto err_io;
+	}
+
+	fsal_prepare_attrs(&attrs, ATTR_SIZE);
+	fsal_status = src_obj->obj_ops.getattrs(src_obj, &attrs);
+	filesize = attrs.filesize;
+	fsal_release_attrs(&attrs);
+
+	if (FSAL_IS_ERROR(fsal_status)) {
+		status = nfs4_Errno_status(fsal_status);
+		goto err_io;
+	}
+
+	/* Written so that neither range can wrap */
+	if (src_offset > filesize ||
+	    (*count != 0 && *count > filesize - src_offset)) {
+		status = NFS4ERR_INVAL;
+		goto err_io;
+	}
+
+	if (*count == 0)
+		*count = filesize - src_offset;
+
+	if (*count > UINT64_MAX - dst_offset) {
+		status = NFS4ERR_INVAL;
+		goto err_io;
+	}
+
+	/* Overlapping ranges of one file */
+	if (src_obj == dst_obj &&
+	    src_offset < dst_offset + *count &&
+	    dst_offset < src_offset + *count) {
+		status = NFS4ERR_INVAL;
+		goto err_io;
+	}
+
+	return NFS4_OK;
+
+ err_io:
+	copy_io_done(dst_obj, *dst_state, OPEN4_SHARE_ACCESS_WRITE);
+	*dst_state = NULL;
+ err_src:
+	copy_io_done(src_obj, *src_state, OPEN4_SHARE_ACCESS_READ);
+	*src_state = NULL;
+	/* No anonymous I/O started for a destination that failed */
+	if (*dst_state != NULL)
+		dec_state_t_ref(*dst_state);
+	*dst_state = NULL;
+	return status;
+
+ err:
+	if (*src_state != NULL)
+		dec_state_t_ref(*src_state);
+	if (*dst_state != NULL)
+		dec_state_t_ref(*dst_state);
+	*src_state = NULL;
+	*dst_state = NULL;
+	return status;
+}
+
+/**
+ * @brief Fill in the write_response4 of a COPY or CB_OFFLOAD
+ *
+ * @param[out] resp     The response
+ * @param[in]  copied   Bytes copied
+ * @param[in]  verifier Write verifier, NULL for this export's
+ */
+
+static void copy_response(write_response4 *resp, uint64_t copied,
+			  verifier4 verifier)
+{
+	struct gsh_buffdesc verf_desc;
+
+	memset(resp, 0, sizeof(*resp));
+	resp->wr_count = copied;
+	resp->wr_committed = UNSTABLE4;
+
+	if (verifier != NULL) {
+		memcpy(resp->wr_writeverf, verifier, sizeof(verifier4));
+		return;
+	}
+
+	verf_desc.addr = resp->wr_writeverf;
+	verf_desc.len = sizeof(verifier4);
+	op_ctx->fsal_export->exp_ops.get_write_verifier(op_ctx->fsal_export,
+							&verf_desc);
+}
+
+/**
+ * @brief Free an offload that is done
+ *
+ * @param[in] off The offload, no longer in offload_list
+ */
+
+static void offload_free(struct nfs4_offload *off)
+{
+	gsh_free(off->creds.caller_garray);
+	gsh_free(off->dst_fh.nfs_fh4_val);
+	gsh_free(off);
+}
+
+/**
+ * @brief Drop offloads done long enough ago
+ *
+ * A client that did not get the CB_OFFLOAD polls with OFFLOAD_STATUS,
+ * so the result is kept for a lease period.  Called with offload_mutex
+ * held.
+ */
+
+static void offload_reap(void)
+{
+	struct glist_head *glist, *glistn;
+	time_t limit = time(NULL) - nfs_param.nfsv4_param.lease_lifetime;
+
+	glist_for_each_safe(glist, glistn, &offload_list) {
+		struct nfs4_offload *off =
+			glist_entry(glist, struct nfs4_offload, link);
+
+		if (off->done && off->finished < limit) {
+			glist_del(&off->link);
+			offload_free(off);
+		}
+	}
+}
+
+/**
+ * @brief Find an offload by its stateid
+ *
+ * Called with offload_mutex held.
+ *
+ * @param[in] stateid   Stateid from the client
+ * @param[in] clientid  The client asking
+ *
+ * @return The offload, or NULL if this client has none by that stateid.
+ */
+
+static struct nfs4_offload *offload_lookup(stateid4 *stateid,
+					   clientid4 clientid)
+{
+	struct glist_head *glist;
+
+	glist_for_each(glist, &offload_list) {
+		struct nfs4_offload *off =
+			glist_entry(glist, struct nfs4_offload, link);
+
+		if (memcmp(off->stateid.other, stateid->other,
+			   OTHERSIZE) == 0 &&
+		    off->clientid == clientid)
+			return off;
+	}
+	return NULL;
+}
+
+/**
+ * @brief Handle the CB_OFFLOAD response
+ *
+ * @param[in] call  The RPC call being completed
+ * @param[in] hook  The hook itself
+ * @param[in] arg   The CB_OFFLOAD op
+ * @param[in] flags There are no flags.
+ *
+ * @return 0, constantly.
+ */
+
+static int32_t offload_cb_completion(rpc_call_t *call, rpc_call_hook hook,
+				     void *arg, uint32_t flags)
+{
+	nfs_cb_argop4 *argop = arg;
+
+	LogFullDebug(COMPONENT_NFS_CB, "status %d arg %p",
+		     call->cbt.v_u.v4.res.status, arg);
+
+	nfs41_complete_single(call, hook, arg, flags);
+	gsh_free(argop->nfs_cb_argop4_u.opcboffload.coa_fh.nfs_fh4_val);
+	gsh_free(argop);
+	return 0;
+}
+
+/**
+ * @brief Tell the client that an offload is done
+ *
+ * @param[in] off The offload
+ */
+
+static void offload_send_cb(struct nfs4_offload *off)
+{
+	nfs_cb_argop4 *argop = gsh_calloc(1, sizeof(nfs_cb_argop4));
+	CB_OFFLOAD4args *cb = &argop->nfs_cb_argop4_u.opcboffload;
+	offload_info4 *info = &cb->coa_offload_info;
+	int rc;
+
+	argop->argop = NFS4_OP_CB_OFFLOAD;
+
+	cb->coa_fh.nfs_fh4_len = off->dst_fh.nfs_fh4_len;
+	cb->coa_fh.nfs_fh4_val = gsh_malloc(off->dst_fh.nfs_fh4_len);
+	memcpy(cb->coa_fh.nfs_fh4_val, off->dst_fh.nfs_fh4_val,
+	       off->dst_fh.nfs_fh4_len);
+	cb->coa_stateid = off->stateid;
+
+	info->coa_status = off->status;
+	if (off->status == NFS4_OK)
+		copy_response(&info->offload_info4_u.coa_resok4, off->copied,
+			      off->verifier);
+	else
+		info->offload_info4_u.coa_bytes_copied = off->copied;
+
+	rc = nfs_rpc_v41_single(off->client, argop, NULL,
+				offload_cb_completion, argop, NULL);
+	if (rc != 0) {
+		LogDebug(COMPONENT_NFS_CB,
+			 "CB_OFFLOAD not sent, client will poll: %d", rc);
+		gsh_free(cb->coa_fh.nfs_fh4_val);
+		gsh_free(argop);
+	}
+}
+
+/**
+ * @brief Run an offloaded COPY
+ *
+ * @param[in] ctx Thread context, the argument is the offload
+ */
+
+static void offload_run(struct fridgethr_context *ctx)
+{
+	struct nfs4_offload *off = ctx->arg;
+	struct root_op_context root_op_context;
+	struct gsh_buffdesc verf_desc;
+	fsal_status_t fsal_status;
+	uint64_t copied;
+
+	init_root_op_context(&root_op_context, off->export,
+			     off->export->fsal_export, NFS_V4, 2,
+			     NFS_REQUEST);
+	/* Copy as the client that asked, not as root */
+	op_ctx->creds = &off->creds;
+
+	off->status = NFS4_OK;
+
+	while (off->copied < off->count &&
+	       !atomic_fetch_int8_t(&off->cancelled)) {
+		fsal_status = off->src_obj->obj_ops.copy2(
+			off->src_obj, off->src_state,
+			off->src_offset + off->copied,
+			off->dst_obj, off->dst_state,
+			off->dst_offset + off->copied,
+			MIN(off->count - off->copied, COPY_ASYNC_CHUNK),
+			&copied);
+		if (FSAL_IS_ERROR(fsal_status)) {
+			off->status = nfs4_Errno_status(fsal_status);
+			break;
+		}
+		if (copied == 0)
+			break;
+		atomic_add_uint64_t(&off->copied, copied);
+	}
+
+	verf_desc.addr = off->verifier;
+	verf_desc.len = sizeof(verifier4);
+	op_ctx->fsal_export->exp_ops.get_write_verifier(op_ctx->fsal_export,
+							&verf_desc);
+
+	dec_state_t_ref(off->src_state);
+	dec_state_t_ref(off->dst_state);
+	off->src_obj->obj_ops.put_ref(off->src_obj);
+	off->dst_obj->obj_ops.put_ref(off->dst_obj);
+
+	release_root_op_context();
+	put_gsh_export(off->export);
+
+	LogDebug(COMPONENT_NFS_V4,
+		 "COPY offload done, %" PRIu64 " of %" PRIu64 " bytes, %s",
+		 off->copied, off->count, nfsstat4_to_str(off->status));
+
+	/* A cancelled copy gets no callback */
+	if (!atomic_fetch_int8_t(&off->cancelled))
+		offload_send_cb(off);
+	dec_client_id_ref(off->client);
+	off->client = NULL;
+
+	PTHREAD_MUTEX_lock(&offload_mutex);
+	if (atomic_fetch_int8_t(&off->cancelled)) {
+		/* Nobody will ask about it again */
+		glist_del(&off->link);
+		offload_free(off);
+	} else {
+		off->done = true;
+		off->finished = time(NULL);
+	}
+	PTHREAD_MUTEX_unlock(&offload_mutex);
+}
+
+/**
+ * @brief Hand a COPY to the copy threads
+ *
+ * @param[in]  data       Compound request's data
+ * @param[in]  arg_COPY   The COPY arguments
+ * @param[in]  count      Bytes to copy
+ * @param[in]  src_state  State to read with, its reference is taken
+ * @param[in]  dst_state  State to write with, its reference is taken
+ * @param[out] stateid    Stateid for the offload
+ *
+ * @return true if the copy was started, false to do it synchronously.
+ */
+
+static bool offload_start(compound_data_t *data, COPY4args *arg_COPY,
+			  uint64_t count, state_t *src_state,
+			  state_t *dst_state, stateid4 *stateid)
+{
+	nfs_client_id_t *client = data->session->clientid_record;
+	struct nfs4_offload *off;
+	uint32_t counter;
+
+	off = gsh_calloc(1, sizeof(*off));
+
+	counter = atomic_inc_uint32_t(&offload_counter);
+	off->stateid.seqid = 1;
+	memcpy(off->stateid.other, &client->cid_clientid,
+	       sizeof(clientid4));
+	memcpy(off->stateid.other + sizeof(clientid4), &counter,
+	       sizeof(counter));
+
+	off->clientid = client->cid_clientid;
+	off->client = client;
+	off->export = op_ctx->ctx_export;
+	off->creds = *op_ctx->creds;
+	if (off->creds.caller_glen != 0) {
+		off->creds.caller_garray =
+			gsh_malloc(off->creds.caller_glen * sizeof(gid_t));
+		memcpy(off->creds.caller_garray,
+		       op_ctx->creds->caller_garray,
+		       off->creds.caller_glen * sizeof(gid_t));
+	} else {
+		off->creds.caller_garray = NULL;
+	}
+	off->src_obj = data->saved_obj;
+	off->dst_obj = data->current_obj;
+	off->src_state = src_state;
+	off->dst_state = dst_state;
+	off->src_offset = arg_COPY->ca_src_offset;
+	off->dst_offset = arg_COPY->ca_dst_offset;
+	off->count = count;
+
+	off->dst_fh.nfs_fh4_len = data->currentFH.nfs_fh4_len;
+	off->dst_fh.nfs_fh4_val = gsh_malloc(data->currentFH.nfs_fh4_len);
+	memcpy(off->dst_fh.nfs_fh4_val, data->currentFH.nfs_fh4_val,
+	       data->currentFH.nfs_fh4_len);
+
+	inc_client_id_ref(off->client);
+	get_gsh_export_ref(off->export);
+	off->src_obj->obj_ops.get_ref(off->src_obj);
+	off->dst_obj->obj_ops.get_ref(off->dst_obj);
+
+	PTHREAD_MUTEX_lock(&offload_mutex);
+	offload_reap();
+	glist_add_tail(&offload_list, &off->link);
+	PTHREAD_MUTEX_unlock(&offload_mutex);
+
+	if (fridgethr_submit(copy_fridge, offload_run, off) != 0) {
+		PTHREAD_MUTEX_lock(&offload_mutex);
+		glist_del(&off->link);
+		PTHREAD_MUTEX_unlock(&offload_mutex);
+
+		off->src_obj->obj_ops.put_ref(off->src_obj);
+		off->dst_obj->obj_ops.put_ref(off->dst_obj);
+		put_gsh_export(off->export);
+		dec_client_id_ref(off->client);
+		offload_free(off);
+		return false;
+	}
+
+	*stateid = off->stateid;
+	return true;
+}
+
+/**
+ * @brief The NFS4_OP_COPY operation
+ *
+ * This functions handles the NFS4_OP_COPY operation in NFSv4.2. This
+ * function can be called only from nfs4_Compound.
+ *
+ * Copies between servers are not supported.  A large copy that the
+ * client allows to be asynchronous is offloaded to the copy threads;
+ * the client learns it is done by CB_OFFLOAD or OFFLOAD_STATUS.  A
+ * synchronous copy does at most COPY_ASYNC_CHUNK, so as not to hold
+ * the worker, and returns a short count for more.
+ *
+ * @param[in]     op    Arguments for nfs4_op
+ * @param[in,out] data  Compound request's data
+ * @param[out]    resp  Results for nfs4_op
+ *
+ * @return per RFC7862
+ */
+
+int nfs4_op_copy(struct nfs_argop4 *op, compound_data_t *data,
+		 struct nfs_resop4 *resp)
+{
+	COPY4args * const arg_COPY = &op->nfs_argop4_u.opcopy;
+	COPY4res * const res_COPY = &resp->nfs_resop4_u.opcopy;
+	COPY4resok *resok = &res_COPY->COPY4res_u.cr_resok4;
+	state_t *src_state = NULL;
+	state_t *dst_state = NULL;
+	fsal_status_t fsal_status;
+	uint64_t count = arg_COPY->ca_count;
+	uint64_t copied = 0, chunk;
+	stateid4 callback_id;
+
+	resp->resop = NFS4_OP_COPY;
+
+	if (data->minorversion < 2) {
+		res_COPY->cr_status = NFS4ERR_NOTSUPP;
+		goto out;
+	}
+
+	/* Inter server copy */
+	if (arg_COPY->ca_source_server.ca_source_server_len != 0) {
+		res_COPY->cr_status = NFS4ERR_NOTSUPP;
+		goto out;
+	}
+
+	res_COPY->cr_status = copy_check_args(data, &arg_COPY->ca_src_stateid,
+					      &arg_COPY->ca_dst_stateid,
+					      arg_COPY->ca_src_offset,
+					      arg_COPY->ca_dst_offset,
+					      &count, &src_state, &dst_state,
+					      "COPY");
+	if (res_COPY->cr_status != NFS4_OK)
+		goto out;
+
+	memset(resok, 0, sizeof(*resok));
+	resok->cr_requirements.cr_consecutive = true;
+
+	if (!arg_COPY->ca_synchronous && copy_fridge != NULL &&
+	    count >= COPY_ASYNC_MIN && src_state != NULL &&
+	    dst_state != NULL &&
+	    offload_start(data, arg_COPY, count, src_state, dst_state,
+			  &callback_id)) {
+		/* The offload owns the state references now */
+		src_state = NULL;
+		dst_state = NULL;
+		copy_response(&resok->cr_response, 0, NULL);
+		resok->cr_response.wr_ids = 1;
+		resok->cr_response.wr_callback_id = callback_id;
+		resok->cr_requirements.cr_synchronous = false;
+		goto out;
+	}
+
+	count = MIN(count, COPY_ASYNC_CHUNK);
+
+	while (copied < count) {
+		fsal_status = data->saved_obj->obj_ops.copy2(
+				data->saved_obj, src_state,
+				arg_COPY->ca_src_offset + copied,
+				data->current_obj, dst_state,
+				arg_COPY->ca_dst_offset + copied,
+				count - copied, &chunk);
+		if (FSAL_IS_ERROR(fsal_status)) {
+			/* Report what was copied before the error */
+			if (copied != 0)
+				break;
+			res_COPY->cr_status = nfs4_Errno_status(fsal_status);
+			goto io_done;
+		}
+		if (chunk == 0)
+			break;
+		copied += chunk;
+	}
+
+	copy_response(&resok->cr_response, copied, NULL);
+	resok->cr_requirements.cr_synchronous = true;
+
+	server_stats_io_done(count, copied, true, true);
+
+ io_done:
+
+	copy_io_done(data->saved_obj, src_state, OPEN4_SHARE_ACCESS_READ);
+	copy_io_done(data->current_obj, dst_state, OPEN4_SHARE_ACCESS_WRITE);
+
+ out:
+
+	LogDebug(COMPONENT_NFS_V4,
+		 "COPY %" PRIu64 "@%" PRIu64 " to %" PRIu64 " %s status %s",
+		 count, arg_COPY->ca_src_offset, arg_COPY->ca_dst_offset,
+		 arg_COPY->ca_synchronous ? "sync" : "async",
+		 nfsstat4_to_str(res_COPY->cr_status));
+
+	return res_COPY->cr_status;
+}
+
+/**
+ * @brief Free memory allocated for COPY result
+ *
+ * @param[in,out] resp nfs4_op results
+ */
+
+void nfs4_op_copy_Free(nfs_resop4 *resp)
+{
+	/* Nothing to be done */
+}
+
+/**
+ * @brief The NFS4_OP_OFFLOAD_STATUS operation
+ *
+ * This functions handles the NFS4_OP_OFFLOAD_STATUS operation in
+ * NFSv4.2. This function can be called only from nfs4_Compound.
+ *
+ * @param[in]     op    Arguments for nfs4_op
+ * @param[in,out] data  Compound request's data
+ * @param[out]    resp  Results for nfs4_op
+ *
+ * @return per RFC7862
+ */
+
+int nfs4_op_offload_status(struct nfs_argop4 *op, compound_data_t *data,
+			   struct nfs_resop4 *resp)
+{
+	OFFLOAD_STATUS4args * const arg_STATUS =
+		&op->nfs_argop4_u.opoffload_status;
+	OFFLOAD_STATUS4res * const res_STATUS =
+		&resp->nfs_resop4_u.opoffload_status;
+	OFFLOAD_STATUS4resok *resok =
+		&res_STATUS->OFFLOAD_STATUS4res_u.osr_resok4;
+	struct nfs4_offload *off;
+
+	resp->resop = NFS4_OP_OFFLOAD_STATUS;
+
+	if (data->minorversion < 2) {
+		res_STATUS->osr_status = NFS4ERR_NOTSUPP;
+		return res_STATUS->osr_status;
+	}
+
+	res_STATUS->osr_status = nfs4_sanity_check_FH(data, REGULAR_FILE,
+						      false);
+	if (res_STATUS->osr_status != NFS4_OK)
+		return res_STATUS->osr_status;
+
+	PTHREAD_MUTEX_lock(&offload_mutex);
+
+	off = offload_lookup(&arg_STATUS->osa_stateid,
+			     data->session->clientid_record->cid_clientid);
+	if (off == NULL) {
+		res_STATUS->osr_status = NFS4ERR_BAD_STATEID;
+	} else {
+		memset(resok, 0, sizeof(*resok));
+		resok->osr_bytes_copied = atomic_fetch_uint64_t(&off->copied);
+		if (off->done) {
+			resok->osr_count_complete = 1;
+			resok->osr_complete = off->status;
+		}
+	}
+
+	PTHREAD_MUTEX_unlock(&offload_mutex);
+
+	return res_STATUS->osr_status;
+}
+
+/**
+ * @brief Free memory allocated for OFFLOAD_STATUS result
+ *
+ * @param[in,out] resp nfs4_op results
+ */
+
+void nfs4_op_offload_status_Free(nfs_resop4 *resp)
+{
+	/* Nothing to be done */
+}
+
+/**
+ * @brief The NFS4_OP_OFFLOAD_CANCEL operation
+ *
+ * This functions handles the NFS4_OP_OFFLOAD_CANCEL operation in
+ * NFSv4.2. This function can be called only from nfs4_Compound.
+ *
+ * The copy stops at the next chunk; what was copied stays.
+ *
+ * @param[in]     op    Arguments for nfs4_op
+ * @param[in,out] data  Compound request's data
+ * @param[out]    resp  Results for nfs4_op
+ *
+ * @return per RFC7862
+ */
+
+int nfs4_op_offload_cancel(struct nfs_argop4 *op, compound_data_t *data,
+			   struct nfs_resop4 *resp)
+{
+	OFFLOAD_CANCEL4args * const arg_CANCEL =
+		&op->nfs_argop4_u.opoffload_cancel;
+	OFFLOAD_CANCEL4res * const res_CANCEL =
+		&resp->nfs_resop4_u.opoffload_cancel;
+	struct nfs4_offload *off;
+
+	resp->resop = NFS4_OP_OFFLOAD_CANCEL;
+
+	if (data->minorversion < 2) {
+		res_CANCEL->ocr_status = NFS4ERR_NOTSUPP;
+		return res_CANCEL->ocr_status;
+	}
+
+	res_CANCEL->ocr_status = nfs4_sanity_check_FH(data, REGULAR_FILE,
+						      false);
+	if (res_CANCEL->ocr_status != NFS4_OK)
+		return res_CANCEL->ocr_status;
+
+	PTHREAD_MUTEX_lock(&offload_mutex);
+
+	off = offload_lookup(&arg_CANCEL->oca_stateid,
+			     data->session->clientid_record->cid_clientid);
+	if (off == NULL) {
+		res_CANCEL->ocr_status = NFS4ERR_BAD_STATEID;
+	} else if (off->done) {
+		/* The stateid is gone once cancelled */
+		glist_del(&off->link);
+		offload_free(off);
+	} else {
+		atomic_store_int8_t(&off->cancelled, 1);
+	}
+
+	PTHREAD_MUTEX_unlock(&offload_mutex);
+
+	return res_CANCEL->ocr_status;
+}
+
+/**
+ * @brief Free memory allocated for OFFLOAD_CANCEL result
+ *
+ * @param[in,out] resp nfs4_op results
+ */
+
+void nfs4_op_offload_cancel_Free(nfs_resop4 *resp)
+{
+	/* Nothing to be done */
+}
+
+/**
+ * @brief The NFS4_OP_CLONE operation
+ *
+ * This functions handles the NFS4_OP_CLONE operation in NFSv4.2. This
+ * function can be called only from nfs4_Compound.
+ *
+ * @param[in]     op    Arguments for nfs4_op
+ * @param[in,out] data  Compound request's data
+ * @param[out]    resp  Results for nfs4_op
+ *
+ * @return per RFC7862
+ */
+
+int nfs4_op_clone(struct nfs_argop4 *op, compound_data_t *data,
+		  struct nfs_resop4 *resp)
+{
+	CLONE4args * const arg_CLONE = &op->nfs_argop4_u.opclone;
+	CLONE4res * const res_CLONE = &resp->nfs_resop4_u.opclone;
+	state_t *src_state = NULL;
+	state_t *dst_state = NULL;
+	fsal_status_t fsal_status;
+	uint64_t count = arg_CLONE->cl_count;
+
+	resp->resop = NFS4_OP_CLONE;
+
+	if (data->minorversion < 2) {
+		res_CLONE->cl_status = NFS4ERR_NOTSUPP;
+		goto out;
+	}
+
+	res_CLONE->cl_status = copy_check_args(data,
+					       &arg_CLONE->cl_src_stateid,
+					       &arg_CLONE->cl_dst_stateid,
+					       arg_CLONE->cl_src_offset,
+					       arg_CLONE->cl_dst_offset,
+					       &count, &src_state, &dst_state,
+					       "CLONE");
+	if (res_CLONE->cl_status != NFS4_OK)
+		goto out;
+
+	/* The FSAL gets 0 for up to the end as the client sent it, which
+	 * also covers the end of a file that grew since the check.
+	 */
+	fsal_status = data->saved_obj->obj_ops.clone2(
+				data->saved_obj, src_state,
+				arg_CLONE->cl_src_offset,
+				data->current_obj, dst_state,
+				arg_CLONE->cl_dst_offset,
+				arg_CLONE->cl_count);
+	if (FSAL_IS_ERROR(fsal_status))
+		res_CLONE->cl_status = nfs4_Errno_status(fsal_status);
+
+	copy_io_done(data->saved_obj, src_state, OPEN4_SHARE_ACCESS_READ);
+	copy_io_done(data->current_obj, dst_state, OPEN4_SHARE_ACCESS_WRITE);
+
+ out:
+
+	LogDebug(COMPONENT_NFS_V4,
+		 "CLONE %" PRIu64 "@%" PRIu64 " to %" PRIu64 " status %s",
+		 count, arg_CLONE->cl_src_offset, arg_CLONE->cl_dst_offset,
+		 nfsstat4_to_str(res_CLONE->cl_status));
+
+	return res_CLONE->cl_status;
+}
+
+/**
+ * @brief Free memory allocated for CLONE result
+ *
+ * @param[in,out] resp nfs4_op results
+ */
+
+void nfs4_op_clone_Free(nfs_resop4 *resp)
+{
+	/* Nothing to be done */
+}
+
+/**
+ * @brief Start the copy offload threads
+ *
+ * Without Async_Copy_Threads, every COPY is synchronous.
+ */
+
+void nfs4_copy_offload_init(void)
+{
+	struct fridgethr_params frp;
+	int rc;
+
+	if (nfs_param.nfsv4_param.async_copy_threads == 0)
+		return;
+
+	memset(&frp, 0, sizeof(struct fridgethr_params));
+	frp.thr_max = nfs_param.nfsv4_param.async_copy_threads;
+	frp.thr_min = 0;
+	frp.flavor = fridgethr_flavor_worker;
+	frp.deferment = fridgethr_defer_queue;
+
+	rc = fridgethr_init(&copy_fridge, "Copy_Offload", &frp);
+	if (rc != 0) {
+		LogMajor(COMPONENT_INIT,
+			 "Unable to start copy offload threads: %d", rc);
+		copy_fridge = NULL;
+	}
+}
+
+/**
+ * @brief Stop the copy offload threads
+ *
+ * Running copies are cancelled.
+ *
+ * @return 0 on success, otherwise an error from the fridge.
+ */
+
+int nfs4_copy_offload_shutdown(void)
+{
+	struct glist_head *glist, *glistn;
+	int rc;
+
+	if (copy_fridge == NULL)
+		return 0;
+
+	PTHREAD_MUTEX_lock(&offload_mutex);
+	glist_for_each(glist, &offload_list) {
+		struct nfs4_offload *off =
+			glist_entry(glist, struct nfs4_offload, link);
+
+		atomic_store_int8_t(&off->cancelled, 1);
+	}
+	PTHREAD_MUTEX_unlock(&offload_mutex);
+
+	rc = fridgethr_sync_command(copy_fridge, fridgethr_comm_stop, 120);
+	if (rc == ETIMEDOUT) {
+		LogMajor(COMPONENT_DISPATCH,
+			 "Shutdown timed out, cancelling threads.");
+		fridgethr_cancel(copy_fridge);
+		return rc;
+	} else if (rc != 0) {
+		LogMajor(COMPONENT_DISPATCH,
+			 "Failed shutting down copy offload threads: %d", rc);
+		return rc;
+	}
+
+	PTHREAD_MUTEX_lock(&offload_mutex);
+	glist_for_each_safe(glist, glistn, &offload_list) {
+		struct nfs4_offload *off =
+			glist_entry(glist, struct nfs4_offload, link);
+
+		glist_del(&off->link);
+		offload_free(off);
+	}
+	PTHREAD_MUTEX_unlock(&offload_mutex);
+
+	return 0;
+}
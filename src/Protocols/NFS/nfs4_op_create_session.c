@@ -86,7 +86,7 @@ int nfs4_op_create_session(struct nfs_argop4 *op, compound_data_t *data,
 	struct display_buffer dspbuf_clientid4 = {
 		sizeof(str_clientid4), str_clientid4, str_clientid4};
 	/* Return code from clientid calls */
-	int i, rc = 0;
+	int rc = 0;
 	/* Component for logging */
 	log_components_t component = COMPONENT_CLIENTID;
 	/* Abbreviated alias for arguments */
@@ -324,8 +324,22 @@ int nfs4_op_create_session(struct nfs_argop4 *op, compound_data_t *data,
 	nfs41_session->cb_program = 0;
 	PTHREAD_MUTEX_init(&nfs41_session->cb_mutex, NULL);
 	PTHREAD_COND_init(&nfs41_session->cb_cond, NULL);
-	for (i = 0; i < NFS41_NB_SLOTS; i++)
-		PTHREAD_MUTEX_init(&nfs41_session->slots[i].lock, NULL);
+
+	/* Set ca_maxrequests and the cached reply size from what the
+	 * client asked for, bounded by our configuration.
+	 */
+	if (nfs41_session->fore_channel_attrs.ca_maxrequests >
+	    nfs_param.nfsv4_param.max_slots)
+		nfs41_session->fore_channel_attrs.ca_maxrequests =
+		    nfs_param.nfsv4_param.max_slots;
+	if (nfs41_session->fore_channel_attrs.ca_maxrequests == 0)
+		nfs41_session->fore_channel_attrs.ca_maxrequests = 1;
+	if (nfs41_session->fore_channel_attrs.ca_maxresponsesize_cached >
+	    nfs_param.nfsv4_param.max_cached_reply_size)
+		nfs41_session->fore_channel_attrs.ca_maxresponsesize_cached =
+		    nfs_param.nfsv4_param.max_cached_reply_size;
+
+	nfs41_Session_Init_Slots(nfs41_session);
 
 	/* Take reference to clientid record on behalf the session. */
 	inc_client_id_ref(found);
@@ -336,8 +350,6 @@ int nfs4_op_create_session(struct nfs_argop4 *op, compound_data_t *data,
 		  &nfs41_session->session_link);
 	PTHREAD_MUTEX_unlock(&found->cid_mutex);
 
-	/* Set ca_maxrequests */
-	nfs41_session->fore_channel_attrs.ca_maxrequests = NFS41_NB_SLOTS;
 	nfs41_Build_sessionid(&clientid, nfs41_session->session_id);
 
 	res_CREATE_SESSION4ok->csr_sequence = arg_CREATE_SESSION4->csa_sequence;
@@ -113,7 +113,7 @@ int nfs4_op_delegreturn(struct nfs_argop4 *op, compound_data_t *data,
 		goto out_unlock;
 	}
 
-	deleg_heuristics_recall(data->current_obj, owner, state_found);
+	deleg_heuristics_recall(data->current_obj, owner, state_found, false);
 
 	/* Release reference taken above. */
 	dec_state_owner_ref(owner);
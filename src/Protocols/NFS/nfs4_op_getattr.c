@@ -133,7 +133,7 @@ int nfs4_op_getattr(struct nfs_argop4 *op, compound_data_t *data,
 	res_GETATTR4->status = file_To_Fattr(
 			data, mask, &attrs,
 			&res_GETATTR4->GETATTR4res_u.resok4.obj_attributes,
-			&arg_GETATTR4->attr_request);
+			&arg_GETATTR4->attr_request, true);
 
 	if (data->current_obj->type == DIRECTORY &&
 	    is_sticky_bit_set(data->current_obj, &attrs) &&
@@ -463,6 +463,17 @@ static int nfs4_read(struct nfs_argop4 *op, compound_data_t *data,
 		fsal_status = fsal_read2(obj, bypass, state_found, offset, size,
 					 &read_size, bufferdata, &eof_met,
 					 info);
+
+		if (info != NULL && fsal_status.major == ERR_FSAL_NOTSUPP) {
+			/* No hole detection here, it is all data */
+			fsal_status = fsal_read2(obj, bypass, state_found,
+						 offset, size, &read_size,
+						 bufferdata, &eof_met, NULL);
+			info->io_content.what = NFS4_CONTENT_DATA;
+			info->io_content.data.d_offset = offset;
+			info->io_content.data.d_data.data_len = read_size;
+			info->io_content.data.d_data.data_val = bufferdata;
+		}
 	} else {
 		/* Call legacy fsal_rdwr */
 		fsal_status = fsal_rdwr(obj, io, offset, size, &read_size,
@@ -494,6 +505,12 @@ static int nfs4_read(struct nfs_argop4 *op, compound_data_t *data,
 	if (!anonymous_started && data->minorversion == 0)
 		op_ctx->clientid = NULL;
 
+	if (info != NULL && info->io_content.what == NFS4_CONTENT_HOLE) {
+		/* Nothing was read, the reply only describes the hole */
+		gsh_free(bufferdata);
+		bufferdata = NULL;
+	}
+
 	res_READ4->READ4res_u.resok4.data.data_len = read_size;
 	res_READ4->READ4res_u.resok4.data.data_val = bufferdata;
 
@@ -596,6 +613,10 @@ int nfs4_op_read_plus(struct nfs_argop4 *op, compound_data_t *data,
 
 	resp->resop = NFS4_OP_READ_PLUS;
 
+	/* Data unless the FSAL finds a hole */
+	memset(&info, 0, sizeof(info));
+	info.io_content.what = NFS4_CONTENT_DATA;
+
 	nfs4_read(op, data, &res, FSAL_IO_READ_PLUS, &info);
 
 	res_RPLUS->rpr_status = res_READ4->status;
@@ -762,17 +783,40 @@ int nfs4_op_seek(struct nfs_argop4 *op, compound_data_t *data,
 	if (res_SEEK->sr_status != NFS4_OK)
 		goto done;
 
-	if (state_found != NULL) {
+	memset(&info, 0, sizeof(info));
+	info.io_content.what = arg_SEEK->sa_what;
+
+	if (arg_SEEK->sa_what == NFS4_CONTENT_DATA ||
+	    arg_SEEK->sa_what == NFS4_CONTENT_HOLE)
+		info.io_content.hole.di_offset = arg_SEEK->sa_offset;
+	else
+		info.io_content.adb.adb_offset = arg_SEEK->sa_offset;
+
+	if (state_found != NULL)
 		info.io_advise = state_found->state_data.io_advise;
-		info.io_content.what = arg_SEEK->sa_what;
 
-		if (arg_SEEK->sa_what == NFS4_CONTENT_DATA ||
-				arg_SEEK->sa_what == NFS4_CONTENT_HOLE) {
-			info.io_content.hole.di_offset = arg_SEEK->sa_offset;
-}
-		else
-			info.io_content.adb.adb_offset = arg_SEEK->sa_offset;
+	if (obj->fsal->m_ops.support_ex(obj)) {
+		/* The FSAL finds an fd for any stateid, special or not */
+		fsal_status = obj->obj_ops.seek2(obj, state_found, &info);
+		if (FSAL_IS_ERROR(fsal_status) &&
+		    fsal_status.major != ERR_FSAL_NOTSUPP) {
+			res_SEEK->sr_status =
+				fsal_status.major == ERR_FSAL_NXIO
+				? NFS4ERR_NXIO
+				: nfs4_Errno_status(fsal_status);
+			goto done;
+		}
+	} else {
+		fsal_status = fsalstat(ERR_FSAL_NOTSUPP, 0);
+	}
 
+	if (!FSAL_IS_ERROR(fsal_status)) {
+		res_SEEK->sr_resok4.sr_eof = info.io_eof;
+		res_SEEK->sr_resok4.sr_offset = info.io_content.hole.di_offset;
+	} else if (state_found != NULL) {
+		/* Without seek2, the old seek works on the file opened
+		 * for the state.
+		 */
 		fsal_status = obj->obj_ops.seek(obj, &info);
 		if (FSAL_IS_ERROR(fsal_status)) {
 			res_SEEK->sr_status = NFS4ERR_NXIO;
@@ -780,6 +824,8 @@ int nfs4_op_seek(struct nfs_argop4 *op, compound_data_t *data,
 		}
 		res_SEEK->sr_resok4.sr_eof = info.io_eof;
 		res_SEEK->sr_resok4.sr_offset = info.io_content.hole.di_offset;
+	} else {
+		res_SEEK->sr_status = NFS4ERR_NOTSUPP;
 	}
 done:
 	LogDebug(COMPONENT_NFS_V4,
@@ -35,21 +35,37 @@
 #include "nfs_convert.h"
 #include "export_mgr.h"
 
+/**
+ * @brief What a READDIR4resok takes besides the entries
+ *
+ * The cookie verifier, the word ending the entry list and eof.
+ */
+#define READDIR4_RESOK_FIXED (NFS4_VERIFIER_SIZE + 2 * BYTES_PER_XDR_UNIT)
+
+/**
+ * @brief Attributes of an entry that only has an error to report
+ */
+static struct bitmap4 rdattr_error_bitmap = {
+	.bitmap4_len = 1,
+	.map[0] = WORD0_FATTR4_RDATTR_ERROR,
+};
+
 /**
  * @brief Opaque bookkeeping structure for NFSv4 readdir
  *
  * This structure keeps track of the process of writing out an NFSv4
- * READDIR response between calls to nfs4_readdir_callback.
+ * READDIR response between calls to nfs4_readdir_callback.  Entries
+ * are encoded into one buffer as they come, in the form they take in
+ * the reply.
  */
 
 struct nfs4_readdir_cb_data {
-	entry4 *entries;	/*< The array holding individual entries */
+	char *entries;		/*< The encoded entries */
+	size_t used;		/*< Bytes of entries encoded */
 	size_t mem_left;	/*< The amount of memory remaining before we
 				   hit maxcount */
 	size_t count;		/*< The count of complete entries stored in the
 				   buffer */
-	size_t total_entries;	/*< The total number of entries available
-				   in the array */
 	nfsstat4 error;		/*< Set to a value other than NFS4_OK if the
 				   callback function finds a fatal error. */
 	struct bitmap4 *req_attr;	/*< The requested attributes */
@@ -78,14 +94,15 @@ static void restore_data(struct nfs4_readdir_cb_data *tracker)
 }
 
 /**
- * @brief Populate entry4s when called from fsal_readdir
+ * @brief Encode entry4s when called from fsal_readdir
  *
- * This function is a callback passed to fsal_readdir.  It
- * fills in a pre-allocated array of entry4 structures and allocates
- * space for the name and attributes.  This space must be freed.
+ * This function is a callback passed to fsal_readdir.  It encodes
+ * each entry, name and attributes included, straight after the
+ * previous one.  Nothing is allocated per entry, and an entry is only
+ * kept if all of it fits in what is left of maxcount.
  *
  * @param[in,out] opaque A struct nfs4_readdir_cb_data that stores the
- *                       location of the array and other bookeeping
+ *                       location of the buffer and other bookeeping
  *                       information
  * @param[in]     obj	 Current file
  * @param[in]     attrs  The current file's attributes
@@ -101,7 +118,6 @@ fsal_errors_t nfs4_readdir_callback(void *opaque,
 {
 	struct fsal_readdir_cb_parms *cb_parms = opaque;
 	struct nfs4_readdir_cb_data *tracker = cb_parms->opaque;
-	size_t namelen = 0;
 	char val_fh[NFS4_FHSIZE];
 	nfs_fh4 entryFH = {
 		.nfs_fh4_len = 0,
@@ -110,7 +126,13 @@ fsal_errors_t nfs4_readdir_callback(void *opaque,
 	struct xdr_attrs_args args;
 	compound_data_t *data = tracker->data;
 	nfsstat4 rdattr_error = NFS4_OK;
-	entry4 *tracker_entry = tracker->entries + tracker->count;
+	char *entry = tracker->entries + tracker->used;
+	u_int entry_len, attr_len;
+	component4 name;
+	bool_t more = TRUE;
+	XDR xdr;
+	bool ok;
+	int rc;
 	fsal_status_t fsal_status;
 	fsal_accessflags_t access_mask_attr = 0;
 
@@ -121,9 +143,6 @@ fsal_errors_t nfs4_readdir_callback(void *opaque,
 		return ERR_FSAL_NO_ERROR;
 	}
 
-	if (tracker->total_entries == tracker->count)
-		goto not_inresult;
-
 	/* Test if this is a junction.
 	 *
 	 * NOTE: If there is a junction within a file system (perhaps setting
@@ -276,38 +295,23 @@ not_junction:
 	/* Now process the entry */
 	memset(val_fh, 0, NFS4_FHSIZE);
 
-	/* Bits that don't require allocation */
-	if (tracker->mem_left < sizeof(entry4)) {
-		if (tracker->count == 0)
-			tracker->error = NFS4ERR_TOOSMALL;
-
-		goto failure;
-	}
-
-	tracker->mem_left -= sizeof(entry4);
-	tracker_entry->cookie = cookie;
-	tracker_entry->nextentry = NULL;
-
-	/* The filename.  We don't use str2utf8 because that has an
-	 * additional copy into a buffer before copying into the
-	 * destination.
+	/* The value follows word of the previous entry's nextentry (or
+	 * of the list), the cookie and the filename.  The name is
+	 * encoded from where the FSAL keeps it, with no copy.
 	 */
-	namelen = strlen(cb_parms->name);
-
-	if (tracker->mem_left < (namelen + 1)) {
-		if (tracker->count == 0)
-			tracker->error = NFS4ERR_TOOSMALL;
+	name.utf8string_len = strlen(cb_parms->name);
+	name.utf8string_val = (char *)cb_parms->name;
 
-		goto failure;
-	}
+	memset(&xdr, 0, sizeof(xdr));
+	xdrmem_create(&xdr, entry, tracker->mem_left, XDR_ENCODE);
+	ok = inline_xdr_bool(&xdr, &more) &&
+	     xdr_nfs_cookie4(&xdr, &cookie) &&
+	     xdr_component4(&xdr, &name);
+	entry_len = xdr_getpos(&xdr);
+	xdr_destroy(&xdr);
 
-	tracker->mem_left -= (namelen + 1);
-	tracker_entry->name.utf8string_len = namelen;
-	tracker_entry->name.utf8string_val = gsh_malloc(namelen + 1);
-
-	memcpy(tracker_entry->name.utf8string_val,
-	       cb_parms->name,
-	       namelen);
+	if (!ok)
+		goto full;
 
 	/* If we carried an error from above, now that we have
 	 * the name set up, go ahead and try and put error in
@@ -358,6 +362,14 @@ not_junction:
 		goto skip;
 	}
 
+	if (obj->type == DIRECTORY && is_sticky_bit_set(obj, attr)) {
+		rdattr_error = NFS4ERR_MOVED;
+		LogDebug(COMPONENT_NFS_READDIR,
+			 "Skipping because of %s",
+			 nfsstat4_to_str(rdattr_error));
+		goto skip;
+	}
+
 	memset(&args, 0, sizeof(args));
 	args.attrs = (struct attrlist *)attr;
 	args.data = data;
@@ -366,51 +378,53 @@ not_junction:
 	args.fileid = obj->fileid;
 	args.fsid = obj->fsid;
 
-	if (nfs4_FSALattr_To_Fattr(&args,
-				   tracker->req_attr,
-				   &tracker_entry->attrs) != 0) {
+	rc = nfs4_FSALattr_Encode(&args, tracker->req_attr,
+				  entry + entry_len,
+				  tracker->mem_left - entry_len,
+				  &attr_len);
+	if (rc < 0) {
 		LogCrit(COMPONENT_NFS_READDIR,
-			"nfs4_FSALattr_To_Fattr failed to convert attr");
+			"nfs4_FSALattr_Encode failed to convert attr");
 		goto server_fault;
 	}
-
-	if (obj->type == DIRECTORY && is_sticky_bit_set(obj, attr)) {
-		rdattr_error = NFS4ERR_MOVED;
-		LogDebug(COMPONENT_NFS_READDIR,
-			 "Skipping because of %s",
-			 nfsstat4_to_str(rdattr_error));
+	if (rc > 0) {
+		LogFullDebug(COMPONENT_NFS_READDIR,
+			     "Attributes of %s do not fit",
+			     cb_parms->name);
+		goto full;
 	}
+	goto done;
 
  skip:
 
-	if (rdattr_error != NFS4_OK) {
-		if (!attribute_is_set(tracker->req_attr, FATTR4_RDATTR_ERROR)) {
-			tracker->error = rdattr_error;
-			goto failure;
-		}
-
-		if (nfs4_Fattr_Fill_Error(&tracker_entry->attrs,
-					  rdattr_error) == -1)
-			goto server_fault;
-	}
-
-	if (tracker->mem_left <
-	    ((tracker_entry->attrs.attrmask.bitmap4_len * sizeof(uint32_t))
-	     + (tracker_entry->attrs.attr_vals.attrlist4_len))) {
-		if (tracker->count == 0)
-			tracker->error = NFS4ERR_TOOSMALL;
-
+	if (!attribute_is_set(tracker->req_attr, FATTR4_RDATTR_ERROR)) {
+		tracker->error = rdattr_error;
 		goto failure;
 	}
 
-	tracker->mem_left -= tracker_entry->attrs.attrmask.bitmap4_len *
-			     sizeof(uint32_t);
+	/* Just the error for attributes */
+	memset(&args, 0, sizeof(args));
+	args.attrs = (struct attrlist *)attr;
+	args.data = data;
+	args.rdattr_error = rdattr_error;
 
-	tracker->mem_left -= tracker_entry->attrs.attr_vals.attrlist4_len;
+	rc = nfs4_FSALattr_Encode(&args, &rdattr_error_bitmap,
+				  entry + entry_len,
+				  tracker->mem_left - entry_len,
+				  &attr_len);
+	if (rc < 0) {
+		LogCrit(COMPONENT_NFS_READDIR,
+			"nfs4_FSALattr_Encode failed to convert rdattr_error");
+		goto server_fault;
+	}
+	if (rc > 0)
+		goto full;
 
-	if (tracker->count != 0)
-		tracker->entries[tracker->count - 1].nextentry = tracker_entry;
+ done:
 
+	entry_len += attr_len;
+	tracker->used += entry_len;
+	tracker->mem_left -= entry_len;
 	++(tracker->count);
 	cb_parms->in_result = true;
 	goto out;
@@ -418,20 +432,15 @@ not_junction:
  server_fault:
 
 	tracker->error = NFS4ERR_SERVERFAULT;
+	goto failure;
 
- failure:
-
-	if (tracker_entry->attrs.attr_vals.attrlist4_val != NULL) {
-		gsh_free(tracker_entry->attrs.attr_vals.attrlist4_val);
-		tracker_entry->attrs.attr_vals.attrlist4_val = NULL;
-	}
+ full:
 
-	if (tracker_entry->name.utf8string_val != NULL) {
-		gsh_free(tracker_entry->name.utf8string_val);
-		tracker_entry->name.utf8string_val = NULL;
-	}
+	/* Not even one entry fits */
+	if (tracker->count == 0)
+		tracker->error = NFS4ERR_TOOSMALL;
 
- not_inresult:
+ failure:
 
 	cb_parms->in_result = false;
 
@@ -440,28 +449,6 @@ not_junction:
 	return ERR_FSAL_NO_ERROR;
 }
 
-/**
- * @brief Free a list of entry4s
- *
- * This function frees a list of entry4s and all dependent strctures.
- *
- * @param[in,out] entries The entries to be freed
- */
-
-static void free_entries(entry4 *entries)
-{
-	entry4 *entry = NULL;
-
-	for (entry = entries; entry != NULL; entry = entry->nextentry) {
-		if (entry->attrs.attr_vals.attrlist4_val != NULL)
-			gsh_free(entry->attrs.attr_vals.attrlist4_val);
-
-		if (entry->name.utf8string_val != NULL)
-			gsh_free(entry->name.utf8string_val);
-	}
-	gsh_free(entries);
-}
-
 /**
  * @brief NFS4_OP_READDIR
  *
@@ -484,10 +471,8 @@ int nfs4_op_readdir(struct nfs_argop4 *op, compound_data_t *data,
 	bool eod_met = false;
 	unsigned long dircount = 0;
 	unsigned long maxcount = 0;
-	entry4 *entries = NULL;
 	verifier4 cookie_verifier;
 	uint64_t cookie = 0;
-	unsigned int estimated_num_entries = 0;
 	unsigned int num_entries = 0;
 	struct nfs4_readdir_cb_data tracker;
 	fsal_status_t fsal_status = {0, 0};
@@ -498,33 +483,31 @@ int nfs4_op_readdir(struct nfs_argop4 *op, compound_data_t *data,
 	resp->resop = NFS4_OP_READDIR;
 	res_READDIR4->status = NFS4_OK;
 
+	memset(&tracker, 0, sizeof(tracker));
+
 	res_READDIR4->status = nfs4_sanity_check_FH(data, DIRECTORY, false);
 
 	if (res_READDIR4->status != NFS4_OK)
 		goto out;
 
-	memset(&tracker, 0, sizeof(tracker));
-
 	dir_obj = data->current_obj;
 
 	/* get the characteristic value for readdir operation */
 	dircount = arg_READDIR4->dircount;
-	maxcount = (arg_READDIR4->maxcount * 9) / 10;
+	maxcount = arg_READDIR4->maxcount;
 	cookie = arg_READDIR4->cookie;
 
 	/* Dircount is considered meaningless by many nfsv4 client (like the
-	 * CITI one).  we use maxcount instead.
-	 *
-	 * The Linux 3.0, 3.1.0 clients vs. TCP Ganesha comes out 10x slower
-	 * with 500 max entries
+	 * CITI one).  we use maxcount instead.  Entries are counted as
+	 * they are encoded, so all of maxcount can be used, but no more
+	 * than a reply can hold.
 	 */
-	estimated_num_entries = 50;
-	tracker.total_entries = estimated_num_entries;
+	if (maxcount > nfs_param.core_param.rpc.max_send_buffer_size)
+		maxcount = nfs_param.core_param.rpc.max_send_buffer_size;
 
 	LogFullDebug(COMPONENT_NFS_READDIR,
-		     "dircount=%lu maxcount=%lu cookie=%" PRIu64
-		     " estimated_num_entries=%u",
-		     dircount, maxcount, cookie, estimated_num_entries);
+		     "dircount=%lu maxcount=%lu cookie=%" PRIu64,
+		     dircount, maxcount, cookie);
 
 	/* Since we never send a cookie of 1 or 2, we shouldn't ever get
 	 * them back.
@@ -545,10 +528,10 @@ int nfs4_op_readdir(struct nfs_argop4 *op, compound_data_t *data,
 		goto out;
 	}
 
-	/* If maxcount is too short (14 should be enough for an empty
-	 * directory) return NFS4ERR_TOOSMALL
+	/* If maxcount is too short for even an empty directory return
+	 * NFS4ERR_TOOSMALL
 	 */
-	if (maxcount < 14 || estimated_num_entries == 0) {
+	if (maxcount < READDIR4_RESOK_FIXED) {
 		res_READDIR4->status = NFS4ERR_TOOSMALL;
 		LogFullDebug(COMPONENT_NFS_READDIR,
 			     "Response too small");
@@ -610,9 +593,9 @@ int nfs4_op_readdir(struct nfs_argop4 *op, compound_data_t *data,
 
 	/* Prepare to read the entries */
 
-	entries = gsh_calloc(estimated_num_entries, sizeof(entry4));
-	tracker.entries = entries;
-	tracker.mem_left = maxcount - sizeof(READDIR4resok);
+	tracker.mem_left = maxcount - READDIR4_RESOK_FIXED;
+	tracker.entries = req_alloc(tracker.mem_left);
+	tracker.used = 0;
 	tracker.count = 0;
 	tracker.error = NFS4_OK;
 	tracker.req_attr = &arg_READDIR4->attr_request;
@@ -656,15 +639,18 @@ int nfs4_op_readdir(struct nfs_argop4 *op, compound_data_t *data,
 		goto out;
 	}
 
+	res_READDIR4->READDIR4res_u.resok4.reply.entries = NULL;
 	if (tracker.count != 0) {
-		/* Put the entry's list in the READDIR reply if
+		/* Put the encoded entries in the READDIR reply if
 		 * there were any.
 		 */
-		res_READDIR4->READDIR4res_u.resok4.reply.entries = entries;
+		res_READDIR4->READDIR4res_u.resok4.reply.entries_wire =
+			tracker.entries;
+		res_READDIR4->READDIR4res_u.resok4.reply.entries_wire_len =
+			tracker.used;
 	} else {
-		gsh_free(entries);
-		entries = NULL;
-		res_READDIR4->READDIR4res_u.resok4.reply.entries = NULL;
+		req_free(tracker.entries);
+		tracker.entries = NULL;
 	}
 
 	/* This slight bit of oddness is caused by most booleans
@@ -685,8 +671,8 @@ int nfs4_op_readdir(struct nfs_argop4 *op, compound_data_t *data,
 	res_READDIR4->status = NFS4_OK;
 
  out:
-	if ((res_READDIR4->status != NFS4_OK) && (entries != NULL))
-		free_entries(entries);
+	if ((res_READDIR4->status != NFS4_OK) && (tracker.entries != NULL))
+		req_free(tracker.entries);
 
 	LogFullDebug(COMPONENT_NFS_READDIR,
 		     "Returning %s",
@@ -707,5 +693,6 @@ void nfs4_op_readdir_Free(nfs_resop4 *res)
 {
 	READDIR4res *resp = &res->nfs_resop4_u.opreaddir;
 
-	free_entries(resp->READDIR4res_u.resok4.reply.entries);
+	if (resp->status == NFS4_OK)
+		req_free(resp->READDIR4res_u.resok4.reply.entries_wire);
 }				/* nfs4_op_readdir_Free */
@@ -166,6 +166,10 @@ static int nfs4_write(struct nfs_argop4 *op, compound_data_t *data,
 	bool anonymous_started = false;
 	struct gsh_buffdesc verf_desc;
 	state_owner_t *owner = NULL;
+	/* ALLOCATE or DEALLOCATE, no data is moved */
+	bool space_op = info != NULL &&
+		(info->io_content.what == NFS4_CONTENT_ALLOCATE ||
+		 info->io_content.what == NFS4_CONTENT_DEALLOCATE);
 	uint64_t MaxWrite =
 		atomic_fetch_uint64_t(&op_ctx->ctx_export->MaxWrite);
 	uint64_t MaxOffsetWrite =
@@ -358,8 +362,8 @@ static int nfs4_write(struct nfs_argop4 *op, compound_data_t *data,
 		 * must restrict him
 		 */
 
-		if (info == NULL ||
-		    info->io_content.what != NFS4_CONTENT_HOLE) {
+		if (!space_op && (info == NULL ||
+		    info->io_content.what != NFS4_CONTENT_HOLE)) {
 			LogFullDebug(COMPONENT_NFS_V4,
 				     "write requested size = %" PRIu64
 				     " write allowed size = %" PRIu64,
@@ -402,7 +406,20 @@ static int nfs4_write(struct nfs_argop4 *op, compound_data_t *data,
 		}
 	}
 
-	if (obj->fsal->m_ops.support_ex(obj)) {
+	fsal_status = fsalstat(ERR_FSAL_NOTSUPP, 0);
+
+	/* FSALs without fallocate may still take a space_op as a
+	 * WRITE_PLUS, through write2 with the io_info.
+	 */
+	if (space_op && obj->fsal->m_ops.support_ex(obj))
+		fsal_status = obj->obj_ops.fallocate(
+			obj, state_found, offset, size,
+			info->io_content.what == NFS4_CONTENT_ALLOCATE);
+
+	if (fsal_status.major != ERR_FSAL_NOTSUPP) {
+		if (!FSAL_IS_ERROR(fsal_status))
+			written_size = size;
+	} else if (obj->fsal->m_ops.support_ex(obj)) {
 		/* Call the new fsal_write */
 		fsal_status = fsal_write2(obj, false, state_found, offset, size,
 					  &written_size, bufferdata, &sync,
@@ -413,6 +430,14 @@ static int nfs4_write(struct nfs_argop4 *op, compound_data_t *data,
 					bufferdata, &eof_met, &sync, info);
 	}
 
+	/* Only what the FSAL was asked to do counts, not requests
+	 * turned away before
+	 */
+	if (space_op)
+		server_stats_space_done(size,
+			info->io_content.what == NFS4_CONTENT_ALLOCATE,
+			!FSAL_IS_ERROR(fsal_status));
+
 	if (FSAL_IS_ERROR(fsal_status)) {
 		LogDebug(COMPONENT_NFS_V4, "write returned %s",
 			 fsal_err_txt(fsal_status));
@@ -443,9 +468,9 @@ static int nfs4_write(struct nfs_argop4 *op, compound_data_t *data,
 	if (anonymous_started)
 		state_share_anonymous_io_done(obj, OPEN4_SHARE_ACCESS_WRITE);
 
-	server_stats_io_done(size, written_size,
-			     (res_WRITE4->status == NFS4_OK) ? true : false,
-			     true);
+	if (!space_op)
+		server_stats_io_done(size, written_size,
+				     res_WRITE4->status == NFS4_OK, true);
 
  out:
 
@@ -330,6 +330,159 @@ static inline bool atrib_supported(int attr, attrmask_t fsal_supported)
 		(fsal_supported & fattr4tab[attr].attrmask) != 0);
 }
 
+/**
+ * @brief What an attribute needs to be encoded into the reply
+ *
+ * Attributes with a fixed wire size that depend on nothing but the
+ * object's attributes, handle and ids can be encoded after the
+ * operation has finished.  The others (zero here) need the request:
+ * the export, the compound or a live object.
+ */
+#define FATTR4_WIRE_NOOP 0xfe	/*< Never encodes anything */
+#define FATTR4_WIRE_VAR 0xff	/*< Sized per object */
+
+static const uint8_t fattr4_wire_size[FATTR4_XATTR_SUPPORT + 1] = {
+	[FATTR4_SUPPORTED_ATTRS] = FATTR4_WIRE_VAR,
+	[FATTR4_TYPE] = 4,
+	[FATTR4_FH_EXPIRE_TYPE] = 4,
+	[FATTR4_CHANGE] = 8,
+	[FATTR4_SIZE] = 8,
+	[FATTR4_FSID] = 16,
+	[FATTR4_LEASE_TIME] = 4,
+	[FATTR4_RDATTR_ERROR] = 4,
+	[FATTR4_ARCHIVE] = 4,
+	[FATTR4_FILEHANDLE] = FATTR4_WIRE_VAR,
+	[FATTR4_FILEID] = 8,
+	[FATTR4_HIDDEN] = 4,
+	[FATTR4_MIMETYPE] = 4,
+	[FATTR4_MODE] = 4,
+	[FATTR4_NUMLINKS] = 4,
+	[FATTR4_OWNER] = FATTR4_WIRE_VAR,
+	[FATTR4_OWNER_GROUP] = FATTR4_WIRE_VAR,
+	[FATTR4_QUOTA_AVAIL_HARD] = 8,
+	[FATTR4_QUOTA_AVAIL_SOFT] = 8,
+	[FATTR4_QUOTA_USED] = 8,
+	[FATTR4_RAWDEV] = 8,
+	[FATTR4_SPACE_USED] = 8,
+	[FATTR4_SYSTEM] = 4,
+	[FATTR4_TIME_ACCESS] = 12,
+	[FATTR4_TIME_BACKUP] = 12,
+	[FATTR4_TIME_CREATE] = 12,
+	[FATTR4_TIME_DELTA] = 12,
+	[FATTR4_TIME_METADATA] = 12,
+	[FATTR4_TIME_MODIFY] = 12,
+	[FATTR4_MOUNTED_ON_FILEID] = 8,
+	[FATTR4_DIR_NOTIF_DELAY] = FATTR4_WIRE_NOOP,
+	[FATTR4_DIRENT_NOTIF_DELAY] = FATTR4_WIRE_NOOP,
+	[FATTR4_DACL] = FATTR4_WIRE_NOOP,
+	[FATTR4_SACL] = FATTR4_WIRE_NOOP,
+	[FATTR4_CHANGE_POLICY] = FATTR4_WIRE_NOOP,
+	[FATTR4_FS_STATUS] = FATTR4_WIRE_NOOP,
+	[FATTR4_LAYOUT_HINT] = FATTR4_WIRE_NOOP,
+	[FATTR4_LAYOUT_TYPES] = FATTR4_WIRE_NOOP,
+	[FATTR4_LAYOUT_ALIGNMENT] = FATTR4_WIRE_NOOP,
+	[FATTR4_FS_LOCATIONS_INFO] = FATTR4_WIRE_NOOP,
+	[FATTR4_MDSTHRESHOLD] = FATTR4_WIRE_NOOP,
+	[FATTR4_RETENTION_GET] = FATTR4_WIRE_NOOP,
+	[FATTR4_RETENTION_SET] = FATTR4_WIRE_NOOP,
+	[FATTR4_RETENTEVT_GET] = FATTR4_WIRE_NOOP,
+	[FATTR4_RETENTEVT_SET] = FATTR4_WIRE_NOOP,
+	[FATTR4_RETENTION_HOLD] = FATTR4_WIRE_NOOP,
+	[FATTR4_MODE_SET_MASKED] = FATTR4_WIRE_NOOP,
+	[FATTR4_FS_CHARSET_CAP] = FATTR4_WIRE_NOOP,
+	[FATTR4_XATTR_SUPPORT] = FATTR4_WIRE_NOOP,
+};
+
+typedef fattr_xdr_result (*fattr4_xdr_t)(XDR *, struct xdr_attrs_args *);
+
+/**
+ * @brief The encoders and decoders to run for a requested bitmap
+ *
+ * Attributes beyond the minor version and attributes that never encode
+ * anything are left out of the encoders when the plan is built, so
+ * encoding is a straight walk of the encoder array.  Decoding keeps
+ * every attribute, as an attribute that cannot be set is an error.
+ */
+struct fattr4_plan {
+	struct bitmap4 request;	/*< Requested attributes */
+	int max_attr_idx;	/*< Last attribute of the minor version */
+	attrmask_t fsal_supported;	/*< Attributes the FSAL supports */
+	struct bitmap4 supported;	/*< Attributes of the minor version
+					   supported by Ganesha and the
+					   FSAL, as in supported_attrs */
+	bool cached;		/*< Lives in fattr4_plans, never freed */
+	bool wire;		/*< All of it can be encoded into the reply */
+	bool filehandle;	/*< FATTR4_FILEHANDLE is in the plan */
+	bool owner;		/*< FATTR4_OWNER is in the plan */
+	bool group;		/*< FATTR4_OWNER_GROUP is in the plan */
+	uint32_t fixed_size;	/*< Wire size of the fixed size attributes */
+	struct bitmap4 encoded;	/*< What a wire encoding returns */
+	uint32_t count;		/*< Number of encoders */
+	int attrs[FATTR4_XATTR_SUPPORT + 1];
+	fattr4_xdr_t encode[FATTR4_XATTR_SUPPORT + 1];
+	uint32_t ndecode;	/*< Number of decoders */
+	bool decode_badxdr;	/*< An undefined attribute follows them */
+	int decode_attrs[FATTR4_XATTR_SUPPORT + 1];
+	fattr4_xdr_t decode[FATTR4_XATTR_SUPPORT + 1];
+};
+
+/**
+ * @brief Attribute values kept for encoding into the reply
+ */
+struct fattr4_wire {
+	const struct fattr4_plan *plan;
+	struct attrlist attrs;	/*< Copy, without the ACL */
+	fsal_fsid_t fsid;	/*< Already resolved against the export */
+	uint64_t fileid;
+	uint64_t mounted_on_fileid;
+	uint32_t rdattr_error;
+	nfs_fh4 fh;
+	char fh_val[NFS4_FHSIZE];
+	u_int owner_len;	/*< Encoded owner, length word included */
+	u_int group_len;	/*< Encoded group, length word included */
+	char owner[IDMAPPER_OWNER_WIRE_MAX];
+	char group[IDMAPPER_OWNER_WIRE_MAX];
+};
+
+#define FATTR4_PLAN_SLOTS 64
+
+static struct fattr4_plan *fattr4_plans[FATTR4_PLAN_SLOTS];
+static pthread_mutex_t fattr4_plans_mutex = PTHREAD_MUTEX_INITIALIZER;
+
+/** Times a bitmap must miss before its plan takes a slot */
+#define FATTR4_PLAN_ADMIT 8
+
+#define FATTR4_PLAN_CANDIDATES 256
+
+/** Bitmaps missing the plan table, by the low 8 bits of their hash.
+ *  The other 24 bits tag the bitmap and the low 8 bits of the value
+ *  count its misses.
+ */
+static uint32_t fattr4_plan_misses[FATTR4_PLAN_CANDIDATES];
+
+/**
+ * @brief Attributes supported by Ganesha and an FSAL
+ *
+ * @param[out] bits           The supported attributes
+ * @param[in]  max_attr_idx   Last attribute of the minor version
+ * @param[in]  fsal_supported The FSAL's supported attributes
+ */
+
+static void fattr4_supported_bitmap(struct bitmap4 *bits, int max_attr_idx,
+				    attrmask_t fsal_supported)
+{
+	int attr;
+
+	memset(bits, 0, sizeof(*bits));
+	for (attr = FATTR4_SUPPORTED_ATTRS; attr <= max_attr_idx; attr++) {
+		if (atrib_supported(attr, fsal_supported)) {
+			bool res = set_attribute_in_bitmap(bits, attr);
+
+			assert(res);
+		}
+	}
+}
+
 /* NFSv4.0+ Attribute management
  * XDR encode/decode/compare functions for FSAL <-> Fattr4 translations
  * There is a set of functions for each and every attribute in the tables
@@ -350,22 +503,16 @@ static fattr_xdr_result encode_supported_attrs(XDR *xdr,
 					       struct xdr_attrs_args *args)
 {
 	struct bitmap4 bits;
-	int attr, offset;
-	int max_attr_idx;
-
-	memset(&bits, 0, sizeof(bits));
-	max_attr_idx = nfs4_max_attr_index(args->data);
+	int offset;
 
-	for (attr = FATTR4_SUPPORTED_ATTRS; attr <= max_attr_idx;
-	     attr++) {
-		LogAttrlist(COMPONENT_NFS_V4, NIV_FULL_DEBUG,
-			    "attrs ", args->attrs, false);
-		if (atrib_supported(attr, args->attrs->supported)) {
-			bool res = set_attribute_in_bitmap(&bits, attr);
+	/* the plan being encoded has it for this minor version and FSAL */
+	if (args->plan != NULL)
+		bits = args->plan->supported;
+	else
+		fattr4_supported_bitmap(&bits,
+					nfs4_max_attr_index(args->data),
+					args->attrs->supported);
 
-			assert(res);
-		}
-	}
 	if (!inline_xdr_u_int32_t(xdr, &bits.bitmap4_len))
 		return FATTR_XDR_FAILED;
 	for (offset = 0; offset < bits.bitmap4_len; offset++) {
@@ -1656,6 +1803,10 @@ static fattr_xdr_result decode_numlinks(XDR *xdr, struct xdr_attrs_args *args)
 
 static fattr_xdr_result encode_owner(XDR *xdr, struct xdr_attrs_args *args)
 {
+	if (args->wire != NULL)
+		return xdr_opaque(xdr, args->wire->owner, args->wire->owner_len)
+			? FATTR_XDR_SUCCESS : FATTR_XDR_FAILED;
+
 	return xdr_encode_nfs4_owner(xdr, args->attrs->owner) ?
 		FATTR_XDR_SUCCESS : FATTR_XDR_FAILED;
 }
@@ -1705,6 +1856,10 @@ static fattr_xdr_result decode_owner(XDR *xdr, struct xdr_attrs_args *args)
 
 static fattr_xdr_result encode_group(XDR *xdr, struct xdr_attrs_args *args)
 {
+	if (args->wire != NULL)
+		return xdr_opaque(xdr, args->wire->group, args->wire->group_len)
+			? FATTR_XDR_SUCCESS : FATTR_XDR_FAILED;
+
 	return xdr_encode_nfs4_group(xdr, args->attrs->group) ?
 		FATTR_XDR_SUCCESS : FATTR_XDR_FAILED;
 }
@@ -3414,9 +3569,13 @@ static nfsstat4 path_filter(const char *name, utf8_scantype_t scan)
 void nfs4_Fattr_Free(fattr4 *fattr)
 {
 	if (fattr->attr_vals.attrlist4_val != NULL) {
-		gsh_free(fattr->attr_vals.attrlist4_val);
+		req_free(fattr->attr_vals.attrlist4_val);
 		fattr->attr_vals.attrlist4_val = NULL;
 	}
+	if (fattr->attr_wire != NULL) {
+		req_free(fattr->attr_wire);
+		fattr->attr_wire = NULL;
+	}
 }
 
 /**
@@ -3425,14 +3584,16 @@ void nfs4_Fattr_Free(fattr4 *fattr)
  * This function fills an NFSv4 Fattr from a file represented by
  * data->currentFH and data->current-obj.
  *
- * Memory for bitmap_val and attr_val is dynamically allocated, the caller is
- * responsible for freeing it.
+ * Memory for attr_val comes from req_alloc(), the caller is responsible
+ * for freeing it with nfs4_Fattr_Free().
  *
  * @param[in]     data          NFSv4 compoud request's data
  * @param[in]     request_mask  The original request attribute mask
  * @param[in/out] attr          attrlist to fill in and mask to request
  * @param[out]    Fattr         NFSv4 Fattr buffer
  * @param[in]     Bitmap        Bitmap of attributes being requested
+ * @param[in]     to_wire       Fattr is only going into the reply, and
+ *                              may be encoded straight into it
  *
  * @retval NFSv4 status
  */
@@ -3441,13 +3602,15 @@ nfsstat4 file_To_Fattr(compound_data_t *data,
 		       attrmask_t request_mask,
 		       struct attrlist *attr,
 		       fattr4 *Fattr,
-		       struct bitmap4 *Bitmap)
+		       struct bitmap4 *Bitmap,
+		       bool to_wire)
 {
 	fsal_status_t status;
 	struct xdr_attrs_args args = {
 		.attrs = attr,
 		.data = data,
 		.hdl4 = &data->currentFH,
+		.to_wire = to_wire,
 	};
 
 	/* Permission check only if ACL is asked for.
@@ -3543,8 +3706,9 @@ int nfs4_Fattr_Fill_Error(fattr4 *Fattr, nfsstat4 rdattr_error)
 
 	/* basic init */
 	memset(&Fattr->attrmask, 0, sizeof(Fattr->attrmask));
+	Fattr->attr_wire = NULL;
 	Fattr->attr_vals.attrlist4_val =
-	    gsh_malloc(fattr4tab[FATTR4_RDATTR_ERROR].size_fattr4);
+	    req_alloc(fattr4tab[FATTR4_RDATTR_ERROR].size_fattr4);
 
 	LastOffset = 0;
 	memset(&attr_body, 0, sizeof(attr_body));
@@ -3570,7 +3734,7 @@ int nfs4_Fattr_Fill_Error(fattr4 *Fattr, nfsstat4 rdattr_error)
 
 		if (LastOffset == 0) {	/* no supported attrs so we can free */
 			assert(Fattr->attrmask.bitmap4_len == 0);
-			gsh_free(Fattr->attr_vals.attrlist4_val);
+			req_free(Fattr->attr_vals.attrlist4_val);
 			Fattr->attr_vals.attrlist4_val = NULL;
 		}
 		Fattr->attr_vals.attrlist4_len = LastOffset;
@@ -3582,12 +3746,505 @@ int nfs4_Fattr_Fill_Error(fattr4 *Fattr, nfsstat4 rdattr_error)
 			     fattr4tab[FATTR4_RDATTR_ERROR].name);
 		/* signal fail so if(LastOffset > 0) works right */
 
-		gsh_free(Fattr->attr_vals.attrlist4_val);
+		req_free(Fattr->attr_vals.attrlist4_val);
 		Fattr->attr_vals.attrlist4_val = NULL;
 		return -1;
 	}
 }
 
+/**
+ * @brief Build the plan for a bitmap
+ *
+ * @param[out] plan           The plan
+ * @param[in]  Bitmap         Requested attributes
+ * @param[in]  max_attr_idx   Last attribute of the minor version
+ * @param[in]  fsal_supported The FSAL's supported attributes
+ */
+
+static void fattr4_plan_build(struct fattr4_plan *plan,
+			      struct bitmap4 *Bitmap, int max_attr_idx,
+			      attrmask_t fsal_supported)
+{
+	int attr;
+	uint8_t size;
+
+	memset(plan, 0, sizeof(*plan));
+	plan->request = *Bitmap;
+	plan->max_attr_idx = max_attr_idx;
+	plan->fsal_supported = fsal_supported;
+	plan->wire = true;
+	fattr4_supported_bitmap(&plan->supported, max_attr_idx,
+				fsal_supported);
+
+	for (attr = next_attr_from_bitmap(Bitmap, -1); attr != -1;
+	     attr = next_attr_from_bitmap(Bitmap, attr)) {
+		if (attr > FATTR4_XATTR_SUPPORT) {
+			plan->decode_badxdr = true;
+			break;
+		}
+		plan->decode_attrs[plan->ndecode] = attr;
+		plan->decode[plan->ndecode] = fattr4tab[attr].decode;
+		plan->ndecode++;
+
+		if (attr > max_attr_idx)
+			continue;
+
+		size = fattr4_wire_size[attr];
+
+		if (size == FATTR4_WIRE_NOOP)
+			continue;
+
+		plan->attrs[plan->count] = attr;
+		plan->encode[plan->count] = fattr4tab[attr].encode;
+		plan->count++;
+		set_attribute_in_bitmap(&plan->encoded, attr);
+
+		if (size == 0)
+			plan->wire = false;
+		else if (size != FATTR4_WIRE_VAR)
+			plan->fixed_size += size;
+		else if (attr == FATTR4_SUPPORTED_ATTRS)
+			plan->fixed_size += sizeof(uint32_t) *
+				(1 + plan->supported.bitmap4_len);
+		else if (attr == FATTR4_FILEHANDLE)
+			plan->filehandle = true;
+		else if (attr == FATTR4_OWNER)
+			plan->owner = true;
+		else
+			plan->group = true;
+	}
+}
+
+static inline bool fattr4_plan_match(const struct fattr4_plan *plan,
+				     struct bitmap4 *Bitmap, int max_attr_idx,
+				     attrmask_t fsal_supported)
+{
+	return plan->max_attr_idx == max_attr_idx &&
+	       plan->fsal_supported == fsal_supported &&
+	       plan->request.bitmap4_len == Bitmap->bitmap4_len &&
+	       memcmp(plan->request.map, Bitmap->map,
+		      Bitmap->bitmap4_len * sizeof(uint32_t)) == 0;
+}
+
+/**
+ * @brief Find or build the plan for a bitmap
+ *
+ * Clients ask for a handful of different bitmaps, so plans are built
+ * once and kept.  Lookups take no lock; a plan is published complete
+ * and never changes or goes away, as replies may still point to it.
+ * Since slots are never given back, a bitmap only gets one after it
+ * missed FATTR4_PLAN_ADMIT times, so one-off bitmaps can't fill the
+ * table.  Until then, or when the table is full, the plan is built
+ * into the caller's storage instead.
+ *
+ * @param[in]  Bitmap         Requested attributes
+ * @param[in]  max_attr_idx   Last attribute of the minor version
+ * @param[in]  fsal_supported The FSAL's supported attributes
+ * @param[out] local          Storage for an uncached plan
+ *
+ * @return The plan.
+ */
+
+static const struct fattr4_plan *fattr4_plan_get(struct bitmap4 *Bitmap,
+						 int max_attr_idx,
+						 attrmask_t fsal_supported,
+						 struct fattr4_plan *local)
+{
+	struct fattr4_plan *plan = NULL;
+	uint32_t hash = max_attr_idx;
+	uint32_t i, slot, start, *misses, seen;
+
+	if (Bitmap->bitmap4_len > BITMAP4_MAPLEN)
+		goto uncached;
+
+	hash = hash * 16777619 ^ (uint32_t)fsal_supported;
+	hash = hash * 16777619 ^ (uint32_t)(fsal_supported >> 32);
+	for (i = 0; i < Bitmap->bitmap4_len; i++)
+		hash = hash * 16777619 ^ Bitmap->map[i];
+	start = hash % FATTR4_PLAN_SLOTS;
+
+	for (i = 0; i < FATTR4_PLAN_SLOTS; i++) {
+		slot = (start + i) % FATTR4_PLAN_SLOTS;
+		plan = atomic_fetch_voidptr((void **)&fattr4_plans[slot]);
+		if (plan == NULL)
+			break;
+		if (fattr4_plan_match(plan, Bitmap, max_attr_idx,
+				      fsal_supported))
+			return plan;
+	}
+	if (plan != NULL)
+		goto uncached;
+
+	/* Count the miss, the candidate may be another bitmap's.  Racing
+	 * updates may lose a miss, which only delays the admission.
+	 */
+	misses = &fattr4_plan_misses[hash % FATTR4_PLAN_CANDIDATES];
+	seen = atomic_fetch_uint32_t(misses);
+	if ((seen & ~0xffU) != (hash & ~0xffU))
+		seen = hash & ~0xffU;
+	if ((seen & 0xff) < 0xff)
+		seen++;
+	atomic_store_uint32_t(misses, seen);
+
+	if ((seen & 0xff) < FATTR4_PLAN_ADMIT)
+		goto uncached;
+
+	fattr4_plan_build(local, Bitmap, max_attr_idx, fsal_supported);
+
+	PTHREAD_MUTEX_lock(&fattr4_plans_mutex);
+	for (; i < FATTR4_PLAN_SLOTS; i++) {
+		slot = (start + i) % FATTR4_PLAN_SLOTS;
+		plan = fattr4_plans[slot];
+		if (plan == NULL) {
+			plan = gsh_malloc(sizeof(*plan));
+			*plan = *local;
+			plan->cached = true;
+			atomic_store_voidptr((void **)&fattr4_plans[slot],
+					     plan);
+			break;
+		}
+		if (fattr4_plan_match(plan, Bitmap, max_attr_idx,
+				      fsal_supported))
+			break;
+		plan = NULL;
+	}
+	PTHREAD_MUTEX_unlock(&fattr4_plans_mutex);
+
+	return plan != NULL ? plan : local;
+
+ uncached:
+	fattr4_plan_build(local, Bitmap, max_attr_idx, fsal_supported);
+	return local;
+}
+
+/**
+ * @brief Encode an owner or group into a fattr4_wire
+ *
+ * @return The encoded length, 0 if it does not fit.
+ */
+
+static u_int fattr4_wire_princ(char *buf, uint64_t id, bool group)
+{
+	XDR xdr;
+	bool ok;
+	u_int len;
+
+	memset(&xdr, 0, sizeof(xdr));
+	xdrmem_create(&xdr, buf, IDMAPPER_OWNER_WIRE_MAX, XDR_ENCODE);
+	ok = group ? xdr_encode_nfs4_group(&xdr, id)
+		   : xdr_encode_nfs4_owner(&xdr, id);
+	len = xdr_getpos(&xdr);
+	xdr_destroy(&xdr);
+
+	return ok ? len : 0;
+}
+
+/**
+ * @brief Keep attributes for encoding straight into the reply
+ *
+ * Only values are kept: the ACL, the compound and the export are not
+ * looked at again, so the fattr4 stays valid when the operation is
+ * done and can be replayed from a reply cache.  The owner and group
+ * are encoded now, which gives the exact length of the attributes.
+ *
+ * @param[in]  args   XDR attribute arguments
+ * @param[in]  plan   Cached wire plan for the requested bitmap
+ * @param[out] Fattr  NFSv4 Fattr
+ *
+ * @return true if Fattr is set, false to encode into a buffer.
+ */
+
+static bool fattr4_wire_prepare(struct xdr_attrs_args *args,
+				const struct fattr4_plan *plan,
+				fattr4 *Fattr)
+{
+	struct fattr4_wire *wire;
+	u_int len = plan->fixed_size;
+
+	if (plan->filehandle &&
+	    (args->hdl4 == NULL || args->hdl4->nfs_fh4_val == NULL ||
+	     args->hdl4->nfs_fh4_len > NFS4_FHSIZE))
+		return false;
+
+	wire = req_alloc(sizeof(*wire));
+	wire->plan = plan;
+	wire->attrs = *args->attrs;
+	wire->attrs.acl = NULL;
+	wire->fileid = args->fileid;
+	wire->mounted_on_fileid = args->mounted_on_fileid;
+	wire->rdattr_error = args->rdattr_error;
+
+	/* as encode_fsid would with the compound at hand */
+	if (args->data != NULL &&
+	    op_ctx_export_has_option_set(EXPORT_OPTION_FSID_SET)) {
+		wire->fsid.major = op_ctx->ctx_export->filesystem_id.major;
+		wire->fsid.minor = op_ctx->ctx_export->filesystem_id.minor;
+	} else {
+		wire->fsid = args->fsid;
+	}
+
+	wire->fh.nfs_fh4_len = 0;
+	wire->fh.nfs_fh4_val = wire->fh_val;
+	if (plan->filehandle) {
+		wire->fh.nfs_fh4_len = args->hdl4->nfs_fh4_len;
+		memcpy(wire->fh_val, args->hdl4->nfs_fh4_val,
+		       wire->fh.nfs_fh4_len);
+		len += sizeof(uint32_t) + ((wire->fh.nfs_fh4_len + 3) & ~3);
+	}
+
+	wire->owner_len = 0;
+	if (plan->owner) {
+		wire->owner_len = fattr4_wire_princ(wire->owner,
+						    wire->attrs.owner, false);
+		if (wire->owner_len == 0)
+			goto buffered;
+		len += wire->owner_len;
+	}
+
+	wire->group_len = 0;
+	if (plan->group) {
+		wire->group_len = fattr4_wire_princ(wire->group,
+						    wire->attrs.group, true);
+		if (wire->group_len == 0)
+			goto buffered;
+		len += wire->group_len;
+	}
+
+	Fattr->attrmask = plan->encoded;
+	Fattr->attr_vals.attrlist4_len = len;
+	Fattr->attr_vals.attrlist4_val = NULL;
+	Fattr->attr_wire = wire;
+	return true;
+
+ buffered:
+	req_free(wire);
+	return false;
+}
+
+/**
+ * @brief Encode a fattr4 kept by fattr4_wire_prepare
+ *
+ * Called by xdr_fattr4 while the reply is encoded; the attribute
+ * values go straight into the reply stream.
+ *
+ * @param[in,out] xdrs  The reply stream
+ * @param[in]     objp  The fattr4
+ *
+ * @return true on success.
+ */
+
+bool xdr_fattr4_wire(XDR *xdrs, fattr4 *objp)
+{
+	struct fattr4_wire *wire = objp->attr_wire;
+	const struct fattr4_plan *plan = wire->plan;
+	struct xdr_attrs_args args = {
+		.attrs = &wire->attrs,
+		.hdl4 = &wire->fh,
+		.rdattr_error = wire->rdattr_error,
+		.mounted_on_fileid = wire->mounted_on_fileid,
+		.fsid = wire->fsid,
+		.fileid = wire->fileid,
+		.plan = plan,
+		.wire = wire,
+	};
+	uint32_t i;
+
+	if (!xdr_bitmap4(xdrs, &objp->attrmask))
+		return false;
+	if (!inline_xdr_u_int32_t(xdrs, &objp->attr_vals.attrlist4_len))
+		return false;
+
+	for (i = 0; i < plan->count; i++) {
+		if (plan->encode[i](xdrs, &args) != FATTR_XDR_SUCCESS)
+			return false;
+	}
+	return true;
+}
+
+/**
+ * @brief Run the encoders of a plan
+ *
+ * @param[in,out] xdr      Stream for the attribute values
+ * @param[in]     args     XDR attribute arguments
+ * @param[in]     plan     The plan
+ * @param[out]    attrmask Attributes actually encoded
+ *
+ * @return false if an attribute failed to encode.
+ */
+
+static bool fattr4_encode_plan(XDR *xdr, struct xdr_attrs_args *args,
+			       const struct fattr4_plan *plan,
+			       struct bitmap4 *attrmask)
+{
+	fattr_xdr_result xdr_res;
+	int attribute_to_set;
+	uint32_t i;
+
+	args->plan = plan;
+
+	for (i = 0; i < plan->count; i++) {
+		attribute_to_set = plan->attrs[i];
+		xdr_res = plan->encode[i](xdr, args);
+		if (xdr_res == FATTR_XDR_SUCCESS) {
+			bool res = set_attribute_in_bitmap(attrmask,
+							   attribute_to_set);
+			assert(res);
+			LogFullDebug(COMPONENT_NFS_V4,
+				     "Encoded attr %d, name = %s",
+				     attribute_to_set,
+				     fattr4tab[attribute_to_set].name);
+		} else if (xdr_res == FATTR_XDR_NOOP) {
+			LogFullDebug(COMPONENT_NFS_V4,
+				     "Attr not supported %d name=%s",
+				     attribute_to_set,
+				     fattr4tab[attribute_to_set].name);
+		} else {
+			LogFullDebug(COMPONENT_NFS_V4,
+				     "Encode FAILED for attr %d, name = %s",
+				     attribute_to_set,
+				     fattr4tab[attribute_to_set].name);
+			break;
+		}
+	}
+
+	args->plan = NULL;	/* may be on the caller's stack */
+	return i == plan->count;
+}
+
+/**
+ * @brief Size of the buffer nfs4_FSALattr_To_Fattr encodes into
+ *
+ * @param[in] args   XDR attribute arguments
+ * @param[in] Bitmap Bitmap of attributes being requested
+ *
+ * @return The size.
+ */
+
+static uint32_t fattr4_buflen(struct xdr_attrs_args *args,
+			      struct bitmap4 *Bitmap)
+{
+	uint32_t attrvals_buflen = NFS4_ATTRVALS_BUFFLEN;
+
+	if (attribute_is_set(Bitmap, FATTR4_ACL) && args->attrs->acl) {
+		/* Calculating an exact needed xdr buffer size is laborious
+		 * and time consuming, so making a rough estimate
+		 */
+		attrvals_buflen += (sizeof(fsal_ace_t) + NFS4_MAX_DOMAIN_LEN)
+			* args->attrs->acl->naces;
+	}
+
+	/* Check if the calculated len is less than the max send buffer size */
+	if (attrvals_buflen > nfs_param.core_param.rpc.max_send_buffer_size)
+		attrvals_buflen = nfs_param.core_param.rpc.max_send_buffer_size;
+
+	return attrvals_buflen;
+}
+
+/**
+ * @brief Tell why nfs4_FSALattr_Encode failed
+ *
+ * The encoders don't say whether they ran out of room, so the failed
+ * encode is redone into a buffer as big as nfs4_FSALattr_To_Fattr
+ * would use.  Only the last entry of a reply gets here.
+ *
+ * @param[in] args   XDR attribute arguments
+ * @param[in] Bitmap Bitmap of attributes being requested
+ * @param[in] size   Bytes the failed encode had
+ *
+ * @return 1 if the attributes did not fit, -1 if they can't be encoded.
+ */
+
+static int fattr4_encode_failed(struct xdr_attrs_args *args,
+				struct bitmap4 *Bitmap, u_int size)
+{
+	uint32_t buflen = fattr4_buflen(args, Bitmap);
+	char *scratch;
+	u_int len;
+	int rc;
+
+	/* It already had all the room it could get */
+	if (size >= buflen)
+		return -1;
+
+	scratch = gsh_malloc(buflen);
+	rc = nfs4_FSALattr_Encode(args, Bitmap, scratch, buflen, &len);
+	gsh_free(scratch);
+
+	return rc == 0 ? 1 : -1;
+}
+
+/**
+ * @brief Encode FSAL Attributes as a fattr4 into a buffer
+ *
+ * This is what nfs4_FSALattr_To_Fattr followed by xdr_fattr4 would
+ * produce, without the intermediate attrlist4.  It is meant for
+ * replies that are built already encoded, such as READDIR's.
+ *
+ * @param[in]  args    XDR attribute arguments
+ * @param[in]  Bitmap  Bitmap of attributes being requested
+ * @param[out] buf     Where the fattr4 goes
+ * @param[in]  size    Bytes available at buf
+ * @param[out] len     Bytes used at buf
+ *
+ * @return 0 if successful, 1 if the fattr4 did not fit, -1 if the
+ *         attributes could not be encoded.
+ */
+
+int nfs4_FSALattr_Encode(struct xdr_attrs_args *args, struct bitmap4 *Bitmap,
+			 char *buf, u_int size, u_int *len)
+{
+	struct fattr4_plan local;
+	const struct fattr4_plan *plan;
+	fsal_dynamicfsinfo_t dynamicinfo;
+	struct bitmap4 attrmask;
+	XDR xdr;
+	u_int hdr, vals;
+	bool ok;
+
+	memset(&attrmask, 0, sizeof(attrmask));
+	plan = fattr4_plan_get(Bitmap, nfs4_max_attr_index(args->data),
+			       args->attrs->supported, &local);
+
+	/* Leave room for the longest bitmap the plan can give and the
+	 * length of the values, which are only known after encoding.
+	 */
+	hdr = sizeof(uint32_t) * (2 + plan->encoded.bitmap4_len);
+	if (size < hdr)
+		return 1;
+
+	if (args->dynamicinfo == NULL)
+		args->dynamicinfo = &dynamicinfo;
+
+	memset(&xdr, 0, sizeof(xdr));
+	xdrmem_create(&xdr, buf + hdr, size - hdr, XDR_ENCODE);
+	ok = fattr4_encode_plan(&xdr, args, plan, &attrmask);
+	vals = xdr_getpos(&xdr);
+	xdr_destroy(&xdr);
+
+	if (!ok)
+		return fattr4_encode_failed(args, Bitmap, size);
+
+	/* Some attribute did not encode, the bitmap came out shorter */
+	if (attrmask.bitmap4_len < plan->encoded.bitmap4_len) {
+		u_int shift = hdr - sizeof(uint32_t) *
+					(2 + attrmask.bitmap4_len);
+
+		memmove(buf + hdr - shift, buf + hdr, vals);
+		hdr -= shift;
+	}
+
+	xdrmem_create(&xdr, buf, hdr, XDR_ENCODE);
+	ok = xdr_bitmap4(&xdr, &attrmask) && inline_xdr_u_int32_t(&xdr, &vals);
+	xdr_destroy(&xdr);
+
+	/* The header was sized for the longest bitmap */
+	if (!ok)
+		return -1;
+
+	*len = hdr + vals;
+	return 0;
+}
+
 /**
  * @brief Converts FSAL Attributes to NFSv4 Fattr buffer.
  *
@@ -3596,9 +4253,9 @@ int nfs4_Fattr_Fill_Error(fattr4 *Fattr, nfsstat4 rdattr_error)
  * @param[in]  args    XDR attribute arguments
  * @param[in]  Bitmap  Bitmap of attributes being requested
  * @param[out] Fattr   NFSv4 Fattr buffer
- *		       Memory for bitmap_val and attr_val is
- *                     dynamically allocated,
- *		       caller is responsible for freeing it.
+ *		       Memory for attr_val comes from req_alloc(),
+ *		       caller is responsible for freeing it with
+ *		       nfs4_Fattr_Free().
  *
  * @return -1 if failed, 0 if successful.
  *
@@ -3607,13 +4264,13 @@ int nfs4_Fattr_Fill_Error(fattr4 *Fattr, nfsstat4 rdattr_error)
 int nfs4_FSALattr_To_Fattr(struct xdr_attrs_args *args, struct bitmap4 *Bitmap,
 			   fattr4 *Fattr)
 {
-	int attribute_to_set = 0;
 	int max_attr_idx;
 	u_int LastOffset;
 	fsal_dynamicfsinfo_t dynamicinfo;
 	XDR attr_body;
-	fattr_xdr_result xdr_res;
 	uint32_t attrvals_buflen;
+	struct fattr4_plan local;
+	const struct fattr4_plan *plan;
 
 	/* basic init */
 	memset(Fattr, 0, sizeof(*Fattr));
@@ -3621,22 +4278,18 @@ int nfs4_FSALattr_To_Fattr(struct xdr_attrs_args *args, struct bitmap4 *Bitmap,
 	if (Bitmap->bitmap4_len == 0)
 		return 0;	/* they ask for nothing, they get nothing */
 
-	attrvals_buflen = NFS4_ATTRVALS_BUFFLEN;
-	if (attribute_is_set(Bitmap, FATTR4_ACL) && args->attrs->acl) {
-		/* Calculating an exact needed xdr buffer size is laborious
-		 * and time consuming, so making a rough estimate
-		 */
-		attrvals_buflen += (sizeof(fsal_ace_t) + NFS4_MAX_DOMAIN_LEN)
-			* args->attrs->acl->naces;
-	}
+	max_attr_idx = nfs4_max_attr_index(args->data);
+	plan = fattr4_plan_get(Bitmap, max_attr_idx, args->attrs->supported,
+			       &local);
 
-	/* Check if the calculated len is less than the max send buffer size */
-	if (attrvals_buflen > nfs_param.core_param.rpc.max_send_buffer_size)
-		attrvals_buflen = nfs_param.core_param.rpc.max_send_buffer_size;
+	if (args->to_wire && plan->wire && plan->cached &&
+	    fattr4_wire_prepare(args, plan, Fattr))
+		return 0;
 
-	Fattr->attr_vals.attrlist4_val = gsh_malloc(attrvals_buflen);
+	attrvals_buflen = fattr4_buflen(args, Bitmap);
+
+	Fattr->attr_vals.attrlist4_val = req_alloc(attrvals_buflen);
 
-	max_attr_idx = nfs4_max_attr_index(args->data);
 	LogFullDebug(COMPONENT_NFS_V4, "Maximum allowed attr index = %d",
 		 max_attr_idx);
 
@@ -3648,52 +4301,23 @@ int nfs4_FSALattr_To_Fattr(struct xdr_attrs_args *args, struct bitmap4 *Bitmap,
 	if (args->dynamicinfo == NULL)
 		args->dynamicinfo = &dynamicinfo;
 
-	for (attribute_to_set = next_attr_from_bitmap(Bitmap, -1);
-	     attribute_to_set != -1;
-	     attribute_to_set =
-	     next_attr_from_bitmap(Bitmap, attribute_to_set)) {
-		if (attribute_to_set > max_attr_idx)
-			break;	/* skip out of bounds */
+	if (!fattr4_encode_plan(&attr_body, args, plan, &Fattr->attrmask))
+		goto err;
 
-		xdr_res = fattr4tab[attribute_to_set].encode(&attr_body, args);
-		if (xdr_res == FATTR_XDR_SUCCESS) {
-			bool res = set_attribute_in_bitmap(&Fattr->attrmask,
-							   attribute_to_set);
-			assert(res);
-			LogFullDebug(COMPONENT_NFS_V4,
-				     "Encoded attr %d, name = %s",
-				     attribute_to_set,
-				     fattr4tab[attribute_to_set].name);
-		} else if (xdr_res == FATTR_XDR_NOOP) {
-			LogFullDebug(COMPONENT_NFS_V4,
-				     "Attr not supported %d name=%s",
-				     attribute_to_set,
-				     fattr4tab[attribute_to_set].name);
-			continue;
-		} else {
-			LogFullDebug(COMPONENT_NFS_V4,
-				     "Encode FAILED for attr %d, name = %s",
-				     attribute_to_set,
-				     fattr4tab[attribute_to_set].name);
-
-			/* signal fail so if(LastOffset > 0) works right */
-			goto err;
-		}
-		/* mark the attribute in the bitmap should be new bitmap btw */
-	}
 	LastOffset = xdr_getpos(&attr_body);	/* dumb but for now */
 	xdr_destroy(&attr_body);
 
 	if (LastOffset == 0) {	/* no supported attrs so we can free */
 		assert(Fattr->attrmask.bitmap4_len == 0);
-		gsh_free(Fattr->attr_vals.attrlist4_val);
+		req_free(Fattr->attr_vals.attrlist4_val);
 		Fattr->attr_vals.attrlist4_val = NULL;
 	}
 	Fattr->attr_vals.attrlist4_len = LastOffset;
 	return 0;
 
  err:
-	gsh_free(Fattr->attr_vals.attrlist4_val);
+	xdr_destroy(&attr_body);
+	req_free(Fattr->attr_vals.attrlist4_val);
 	Fattr->attr_vals.attrlist4_val = NULL;
 	return -1;
 }
@@ -4065,27 +4689,25 @@ void nfs4_bitmap4_Remove_Unsupported(struct bitmap4 *bitmap)
 
 bool nfs4_Fattr_Supported(fattr4 *Fattr)
 {
-	int attribute;
+	struct fattr4_plan local;
+	const struct fattr4_plan *plan;
 	attrmask_t fsal_supported;
 
 	/* Get the set of supported attributes from the active export. */
 	fsal_supported = op_ctx->fsal_export->exp_ops.fs_supported_attrs(
 							op_ctx->fsal_export);
 
-	for (attribute = next_attr_from_bitmap(&Fattr->attrmask, -1);
-	     attribute != -1;
-	     attribute = next_attr_from_bitmap(&Fattr->attrmask, attribute)) {
-		bool supported = atrib_supported(attribute, fsal_supported);
+	/* The same plan decodes the attributes next */
+	plan = fattr4_plan_get(&Fattr->attrmask, FATTR4_XATTR_SUPPORT,
+			       fsal_supported, &local);
 
+	if (!bitmap4_is_subset(&Fattr->attrmask, &plan->supported)) {
 		LogFullDebug(COMPONENT_NFS_V4,
-			     "Attribute %s Ganesha %s FSAL %s",
-			     fattr4tab[attribute].name,
-			     fattr4tab[attribute].supported
-					? "supported" : "not supported",
-			     supported ? "supported" : "not supported");
-
-		if (!supported)
-			return false;
+			     "Attributes %08x %08x %08x not all supported by %08x %08x %08x",
+			     Fattr->attrmask.map[0], Fattr->attrmask.map[1],
+			     Fattr->attrmask.map[2], plan->supported.map[0],
+			     plan->supported.map[1], plan->supported.map[2]);
+		return false;
 	}
 
 	return true;
@@ -4298,6 +4920,10 @@ static int Fattr4_To_FSAL_attr(struct attrlist *attrs, fattr4 *Fattr,
 	XDR attr_body;
 	struct xdr_attrs_args args;
 	fattr_xdr_result xdr_res;
+	struct fattr4_plan local;
+	const struct fattr4_plan *plan;
+	attrmask_t fsal_supported = 0;
+	uint32_t i;
 
 	/* Check attributes data */
 	if ((Fattr->attr_vals.attrlist4_val == NULL)
@@ -4317,17 +4943,20 @@ static int Fattr4_To_FSAL_attr(struct attrlist *attrs, fattr4 *Fattr,
 	args.nfs_status = NFS4_OK;
 	args.data = data;
 
-	for (attribute_to_set = next_attr_from_bitmap(&Fattr->attrmask, -1);
-	     attribute_to_set != -1;
-	     attribute_to_set =
-	     next_attr_from_bitmap(&Fattr->attrmask, attribute_to_set)) {
-		const struct fattr4_dent *f4e = fattr4tab + attribute_to_set;
+	/* Keyed as nfs4_Fattr_Supported looked it up */
+	if (op_ctx != NULL && op_ctx->fsal_export != NULL)
+		fsal_supported =
+		    op_ctx->fsal_export->exp_ops.fs_supported_attrs(
+							op_ctx->fsal_export);
+	plan = fattr4_plan_get(&Fattr->attrmask, FATTR4_XATTR_SUPPORT,
+			       fsal_supported, &local);
 
-		if (attribute_to_set > FATTR4_XATTR_SUPPORT) {
-			nfs_status = NFS4ERR_BADXDR;	/* undefined attr */
-			goto decodeerr;
-		}
-		xdr_res = f4e->decode(&attr_body, &args);
+	for (i = 0; i < plan->ndecode; i++) {
+		const struct fattr4_dent *f4e;
+
+		attribute_to_set = plan->decode_attrs[i];
+		f4e = fattr4tab + attribute_to_set;
+		xdr_res = plan->decode[i](&attr_body, &args);
 
 		if (xdr_res == FATTR_XDR_SUCCESS) {
 			if (attrs)
@@ -4365,6 +4994,10 @@ static int Fattr4_To_FSAL_attr(struct attrlist *attrs, fattr4 *Fattr,
 			goto decodeerr;
 		}
 	}
+	if (plan->decode_badxdr) {
+		nfs_status = NFS4ERR_BADXDR;	/* undefined attr */
+		goto decodeerr;
+	}
 	if (xdr_getpos(&attr_body) < Fattr->attr_vals.attrlist4_len)
 		nfs_status = NFS4ERR_BADXDR;	/* underrun on attribute */
 decodeerr:
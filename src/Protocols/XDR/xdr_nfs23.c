@@ -2369,6 +2369,22 @@ dirlistplus3 *objp;
 	register long __attribute__ ((__unused__)) * buf;
 #endif
 
+	if (xdrs->x_op == XDR_ENCODE && objp->entries_wire != NULL) {
+		bool_t more = FALSE;
+
+		if (!xdr_opaque(xdrs, objp->entries_wire,
+				objp->entries_wire_len))
+			return (false);
+		if (!xdr_bool(xdrs, &more))
+			return (false);
+		if (!xdr_bool(xdrs, &objp->eof))
+			return (false);
+		return (true);
+	}
+	if (xdrs->x_op == XDR_DECODE) {
+		objp->entries_wire = NULL;
+		objp->entries_wire_len = 0;
+	}
 	if (!xdr_pointer
 	    (xdrs, (char **)&objp->entries, sizeof(entryplus3),
 	     (xdrproc_t) xdr_entryplus3))
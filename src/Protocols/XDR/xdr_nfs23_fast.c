@@ -0,0 +1,311 @@
+/*
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public License
+ * as published by the Free Software Foundation; either version 3 of
+ * the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA
+ * 02110-1301 USA
+ *
+ * ---------------------------------------
+ */
+
+/**
+ * @file  xdr_nfs23_fast.c
+ * @brief Fast XDR paths for the hottest NFSv3 messages
+ *
+ * These do what the rpcgen routines in xdr_nfs23.c do, for the
+ * arguments the server decodes and the results it encodes.  The fixed
+ * size part of a message is converted in one buffer from XDR_INLINE,
+ * sized once for the whole result, instead of a call through the XDR
+ * ops per field.  When the stream cannot provide the buffer, and for
+ * XDR_FREE, the generic routine does the work.  Results are decoded
+ * with the generic routines, only clients do that.
+ */
+
+#include "config.h"
+#include "gsh_rpc.h"
+#include "nfs23.h"
+
+static struct nfs_request_lookahead dummy_lookahead = {
+	.flags = 0,
+	.read = 0,
+	.write = 0
+};
+
+#define FATTR3_WORDS 21
+#define WCC_ATTR3_WORDS 6
+
+static inline u_int post_op_attr_words(post_op_attr *objp)
+{
+	return objp->attributes_follow ? 1 + FATTR3_WORDS : 1;
+}
+
+static inline u_int wcc_data_words(wcc_data *objp)
+{
+	return (objp->before.attributes_follow ? 1 + WCC_ATTR3_WORDS : 1) +
+		post_op_attr_words(&objp->after);
+}
+
+/* As the generic routines, which only encode TRUE or FALSE */
+static inline bool bool_ok(bool_t val)
+{
+	return val == TRUE || val == FALSE;
+}
+
+static void put_fattr3(int32_t **buf, fattr3 *objp)
+{
+	ixdr_put_u_int32(buf, objp->type);
+	ixdr_put_u_int32(buf, objp->mode);
+	ixdr_put_u_int32(buf, objp->nlink);
+	ixdr_put_u_int32(buf, objp->uid);
+	ixdr_put_u_int32(buf, objp->gid);
+	ixdr_put_u_int64(buf, objp->size);
+	ixdr_put_u_int64(buf, objp->used);
+	ixdr_put_u_int32(buf, objp->rdev.specdata1);
+	ixdr_put_u_int32(buf, objp->rdev.specdata2);
+	ixdr_put_u_int64(buf, objp->fsid);
+	ixdr_put_u_int64(buf, objp->fileid);
+	ixdr_put_u_int32(buf, objp->atime.tv_sec);
+	ixdr_put_u_int32(buf, objp->atime.tv_nsec);
+	ixdr_put_u_int32(buf, objp->mtime.tv_sec);
+	ixdr_put_u_int32(buf, objp->mtime.tv_nsec);
+	ixdr_put_u_int32(buf, objp->ctime.tv_sec);
+	ixdr_put_u_int32(buf, objp->ctime.tv_nsec);
+}
+
+static void put_post_op_attr(int32_t **buf, post_op_attr *objp)
+{
+	ixdr_put_u_int32(buf, objp->attributes_follow);
+	if (objp->attributes_follow)
+		put_fattr3(buf, &objp->post_op_attr_u.attributes);
+}
+
+static void put_wcc_data(int32_t **buf, wcc_data *objp)
+{
+	wcc_attr *before = &objp->before.pre_op_attr_u.attributes;
+
+	ixdr_put_u_int32(buf, objp->before.attributes_follow);
+	if (objp->before.attributes_follow) {
+		ixdr_put_u_int64(buf, before->size);
+		ixdr_put_u_int32(buf, before->mtime.tv_sec);
+		ixdr_put_u_int32(buf, before->mtime.tv_nsec);
+		ixdr_put_u_int32(buf, before->ctime.tv_sec);
+		ixdr_put_u_int32(buf, before->ctime.tv_nsec);
+	}
+	put_post_op_attr(buf, &objp->after);
+}
+
+bool xdr_GETATTR3res_fast(XDR *xdrs, GETATTR3res *objp)
+{
+	int32_t *buf;
+
+	if (xdrs->x_op != XDR_ENCODE)
+		return xdr_GETATTR3res(xdrs, objp);
+
+	buf = xdr_fast_inline(xdrs, objp->status == NFS3_OK
+			      ? 1 + FATTR3_WORDS : 1);
+	if (buf == NULL)
+		return xdr_GETATTR3res(xdrs, objp);
+
+	ixdr_put_u_int32(&buf, objp->status);
+	if (objp->status == NFS3_OK)
+		put_fattr3(&buf, &objp->GETATTR3res_u.resok.obj_attributes);
+	return true;
+}
+
+bool xdr_LOOKUP3res_fast(XDR *xdrs, LOOKUP3res *objp)
+{
+	LOOKUP3resok *resok = &objp->LOOKUP3res_u.resok;
+	LOOKUP3resfail *resfail = &objp->LOOKUP3res_u.resfail;
+	u_int words;
+	int32_t *buf;
+
+	if (xdrs->x_op != XDR_ENCODE)
+		return xdr_LOOKUP3res(xdrs, objp);
+
+	if (objp->status == NFS3_OK) {
+		if (resok->object.data.data_len > NFS3_FHSIZE ||
+		    !bool_ok(resok->obj_attributes.attributes_follow) ||
+		    !bool_ok(resok->dir_attributes.attributes_follow))
+			return xdr_LOOKUP3res(xdrs, objp);
+		words = 2 + XDR_WORDS(resok->object.data.data_len) +
+			post_op_attr_words(&resok->obj_attributes) +
+			post_op_attr_words(&resok->dir_attributes);
+	} else {
+		if (!bool_ok(resfail->dir_attributes.attributes_follow))
+			return xdr_LOOKUP3res(xdrs, objp);
+		words = 1 + post_op_attr_words(&resfail->dir_attributes);
+	}
+
+	buf = xdr_fast_inline(xdrs, words);
+	if (buf == NULL)
+		return xdr_LOOKUP3res(xdrs, objp);
+
+	ixdr_put_u_int32(&buf, objp->status);
+	if (objp->status != NFS3_OK) {
+		put_post_op_attr(&buf, &resfail->dir_attributes);
+		return true;
+	}
+	ixdr_put_u_int32(&buf, resok->object.data.data_len);
+	if (resok->object.data.data_len != 0)
+		ixdr_put_opaque(&buf, resok->object.data.data_val,
+				resok->object.data.data_len);
+	put_post_op_attr(&buf, &resok->obj_attributes);
+	put_post_op_attr(&buf, &resok->dir_attributes);
+	return true;
+}
+
+bool xdr_ACCESS3res_fast(XDR *xdrs, ACCESS3res *objp)
+{
+	/* obj_attributes leads both arms of the union */
+	post_op_attr *attrs = &objp->ACCESS3res_u.resok.obj_attributes;
+	int32_t *buf;
+
+	if (xdrs->x_op != XDR_ENCODE || !bool_ok(attrs->attributes_follow))
+		return xdr_ACCESS3res(xdrs, objp);
+
+	buf = xdr_fast_inline(xdrs, 1 + post_op_attr_words(attrs) +
+			      (objp->status == NFS3_OK ? 1 : 0));
+	if (buf == NULL)
+		return xdr_ACCESS3res(xdrs, objp);
+
+	ixdr_put_u_int32(&buf, objp->status);
+	put_post_op_attr(&buf, attrs);
+	if (objp->status == NFS3_OK)
+		ixdr_put_u_int32(&buf, objp->ACCESS3res_u.resok.access);
+	return true;
+}
+
+bool xdr_READ3args_fast(XDR *xdrs, READ3args *objp)
+{
+	struct nfs_request_lookahead *lkhd =
+	    xdrs->x_public ? (struct nfs_request_lookahead *)xdrs->x_public
+	    : &dummy_lookahead;
+	int32_t *buf;
+
+	if (xdrs->x_op != XDR_ENCODE && xdrs->x_op != XDR_DECODE)
+		return xdr_READ3args(xdrs, objp);
+
+	if (!xdr_fast_bytes(xdrs, &objp->file.data.data_val,
+			    &objp->file.data.data_len, NFS3_FHSIZE))
+		return false;
+
+	buf = xdr_fast_inline(xdrs, 3);
+	if (buf == NULL) {
+		if (!xdr_offset3(xdrs, &objp->offset) ||
+		    !xdr_count3(xdrs, &objp->count))
+			return false;
+	} else if (xdrs->x_op == XDR_ENCODE) {
+		ixdr_put_u_int64(&buf, objp->offset);
+		ixdr_put_u_int32(&buf, objp->count);
+	} else {
+		objp->offset = ixdr_get_u_int64(&buf);
+		objp->count = ixdr_get_u_int32(&buf);
+	}
+	lkhd->flags = NFS_LOOKAHEAD_READ;
+	(lkhd->read)++;
+	return true;
+}
+
+bool xdr_READ3res_fast(XDR *xdrs, READ3res *objp)
+{
+	READ3resok *resok = &objp->READ3res_u.resok;
+	/* file_attributes leads both arms of the union */
+	post_op_attr *attrs = &resok->file_attributes;
+	int32_t *buf;
+
+	if (xdrs->x_op != XDR_ENCODE || !bool_ok(attrs->attributes_follow))
+		return xdr_READ3res(xdrs, objp);
+	if (objp->status == NFS3_OK &&
+	    resok->data.data_len > XDR_BYTES_MAXLEN_IO)
+		return xdr_READ3res(xdrs, objp);
+
+	/* The data is copied by xdr_opaque, only its length is inlined */
+	buf = xdr_fast_inline(xdrs, 1 + post_op_attr_words(attrs) +
+			      (objp->status == NFS3_OK ? 3 : 0));
+	if (buf == NULL)
+		return xdr_READ3res(xdrs, objp);
+
+	ixdr_put_u_int32(&buf, objp->status);
+	put_post_op_attr(&buf, attrs);
+	if (objp->status != NFS3_OK)
+		return true;
+	ixdr_put_u_int32(&buf, resok->count);
+	ixdr_put_u_int32(&buf, resok->eof ? TRUE : FALSE);
+	ixdr_put_u_int32(&buf, resok->data.data_len);
+	return xdr_opaque(xdrs, resok->data.data_val, resok->data.data_len);
+}
+
+bool xdr_WRITE3args_fast(XDR *xdrs, WRITE3args *objp)
+{
+	struct nfs_request_lookahead *lkhd =
+	    xdrs->x_public ? (struct nfs_request_lookahead *)xdrs->x_public
+	    : &dummy_lookahead;
+	int32_t *buf;
+
+	if (xdrs->x_op != XDR_ENCODE && xdrs->x_op != XDR_DECODE)
+		return xdr_WRITE3args(xdrs, objp);
+
+	if (!xdr_fast_bytes(xdrs, &objp->file.data.data_val,
+			    &objp->file.data.data_len, NFS3_FHSIZE))
+		return false;
+
+	buf = xdr_fast_inline(xdrs, 4);
+	if (buf == NULL) {
+		if (!xdr_offset3(xdrs, &objp->offset) ||
+		    !xdr_count3(xdrs, &objp->count) ||
+		    !xdr_stable_how(xdrs, &objp->stable))
+			return false;
+	} else if (xdrs->x_op == XDR_ENCODE) {
+		ixdr_put_u_int64(&buf, objp->offset);
+		ixdr_put_u_int32(&buf, objp->count);
+		ixdr_put_u_int32(&buf, objp->stable);
+	} else {
+		objp->offset = ixdr_get_u_int64(&buf);
+		objp->count = ixdr_get_u_int32(&buf);
+		objp->stable = (stable_how) ixdr_get_u_int32(&buf);
+	}
+
+	if (!xdr_fast_bytes(xdrs, &objp->data.data_val,
+			    &objp->data.data_len, XDR_BYTES_MAXLEN_IO))
+		return false;
+	lkhd->flags |= NFS_LOOKAHEAD_WRITE;
+	(lkhd->write)++;
+	return true;
+}
+
+bool xdr_WRITE3res_fast(XDR *xdrs, WRITE3res *objp)
+{
+	WRITE3resok *resok = &objp->WRITE3res_u.resok;
+	/* file_wcc leads both arms of the union */
+	wcc_data *wcc = &resok->file_wcc;
+	int32_t *buf;
+
+	if (xdrs->x_op != XDR_ENCODE ||
+	    !bool_ok(wcc->before.attributes_follow) ||
+	    !bool_ok(wcc->after.attributes_follow))
+		return xdr_WRITE3res(xdrs, objp);
+
+	buf = xdr_fast_inline(xdrs, 1 + wcc_data_words(wcc) +
+			      (objp->status == NFS3_OK
+			       ? 2 + XDR_WORDS(NFS3_WRITEVERFSIZE) : 0));
+	if (buf == NULL)
+		return xdr_WRITE3res(xdrs, objp);
+
+	ixdr_put_u_int32(&buf, objp->status);
+	put_wcc_data(&buf, wcc);
+	if (objp->status != NFS3_OK)
+		return true;
+	ixdr_put_u_int32(&buf, resok->count);
+	ixdr_put_u_int32(&buf, resok->committed);
+	ixdr_put_opaque(&buf, resok->verf, NFS3_WRITEVERFSIZE);
+	return true;
+}
@@ -1318,6 +1318,21 @@ dupreq_status_t nfs_dupreq_delete(struct svc_req *req)
 	return status;
 }
 
+/**
+ * @brief Check whether a request's result is kept past the request
+ *
+ * Results of no-cache requests are freed by nfs_dupreq_rele, anything
+ * else belongs to the cache entry.
+ *
+ * @param[in] req The svc_req structure.
+ *
+ * @return true if the result is freed by nfs_dupreq_rele.
+ */
+bool nfs_dupreq_is_nocache(struct svc_req *req)
+{
+	return req->rq_u1 == (void *)DUPREQ_NOCACHE;
+}
+
 /**
  * @brief Decrement the call path refcnt on a cache entry.
  *
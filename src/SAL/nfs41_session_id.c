@@ -36,6 +36,8 @@
 
 #include "config.h"
 #include "nfs_core.h"
+#include "nfs4.h"
+#include "nfs_proto_functions.h"
 #include "sal_functions.h"
 
 /**
@@ -55,6 +57,11 @@ hash_table_t *ht_session_id;
 
 uint64_t global_sequence = 0;
 
+/**
+ * @brief Encoded bytes of all cached session replies
+ */
+uint64_t nfs41_session_cache_bytes;
+
 /**
  * @brief Display a session ID
  *
@@ -189,6 +196,7 @@ static hash_parameter_t session_id_param = {
 	.compare_key = compare_session_id,
 	.key_to_str = display_session_id_key,
 	.val_to_str = display_session_id_val,
+	.ht_name = "Session ID",
 	.flags = HT_FLAG_CACHE,
 };
 
@@ -202,6 +210,8 @@ static hash_parameter_t session_id_param = {
 
 int nfs41_Init_session_id(void)
 {
+	client_id_size_table(&session_id_param);
+
 	ht_session_id = hashtable_init(&session_id_param);
 
 	if (ht_session_id == NULL) {
@@ -252,10 +262,16 @@ int32_t dec_session_ref(nfs41_session_t *session)
 
 		/* Decrement our reference to the clientid record */
 		dec_client_id_ref(session->clientid_record);
-		/* Destroy this session's mutexes and condition variable */
+		/* Destroy this session's mutexes and condition variable,
+		 * dropping any replies still cached in the slots.
+		 */
 
-		for (i = 0; i < NFS41_NB_SLOTS; i++)
+		for (i = 0; i < session->fore_channel_attrs.ca_maxrequests;
+		     i++) {
+			nfs41_Session_Release_Slot(session, &session->slots[i]);
 			PTHREAD_MUTEX_destroy(&session->slots[i].lock);
+		}
+		gsh_free(session->slots);
 
 		PTHREAD_COND_destroy(&session->cb_cond);
 		PTHREAD_MUTEX_destroy(&session->cb_mutex);
@@ -397,6 +413,246 @@ int nfs41_Session_Del(char sessionid[NFS4_SESSIONID_SIZE])
 	}
 }
 
+/**
+ * @brief Allocate the forechannel slot table of a new session
+ *
+ * The table has one slot per negotiated ca_maxrequests.  Slots only
+ * pin memory while they hold a cached reply; how many of them the
+ * client is asked to use is steered with sr_target_highest_slotid.
+ *
+ * @param[in,out] session The session, with fore_channel_attrs set
+ */
+
+void nfs41_Session_Init_Slots(nfs41_session_t *session)
+{
+	uint32_t i, nb_slots = session->fore_channel_attrs.ca_maxrequests;
+
+	session->slots = gsh_calloc(nb_slots, sizeof(nfs41_session_slot_t));
+
+	for (i = 0; i < nb_slots; i++)
+		PTHREAD_MUTEX_init(&session->slots[i].lock, NULL);
+
+	session->highest_slotid = 0;
+	session->target_highest_slotid = nb_slots - 1;
+	session->cached_replies = 0;
+	session->cached_bytes = 0;
+}
+
+/**
+ * @brief Drop the cached reply held by a slot
+ *
+ * The caller must hold the slot lock, or the last session reference.
+ *
+ * @param[in] session The session owning the slot
+ * @param[in] slot    The slot
+ */
+
+void nfs41_Session_Release_Slot(nfs41_session_t *session,
+				nfs41_session_slot_t *slot)
+{
+	if (slot->cached_result.res_cached) {
+		slot->cached_result.res_cached = false;
+		nfs4_Compound_Free((nfs_res_t *) &slot->cached_result);
+		memset(&slot->cached_result, 0, sizeof(slot->cached_result));
+
+		(void) atomic_dec_uint32_t(&session->cached_replies);
+		(void) atomic_sub_uint64_t(&session->cached_bytes,
+					   slot->cached_size);
+		(void) atomic_sub_uint64_t(&nfs41_session_cache_bytes,
+					   slot->cached_size);
+		slot->cached_size = 0;
+	}
+
+	slot->cache_used = false;
+}
+
+/**
+ * @brief Drop cached replies of slots the client no longer uses
+ *
+ * The client promises in sa_highest_slotid that it has nothing
+ * outstanding above that slot, so replies cached there will never be
+ * replayed.
+ *
+ * @param[in] session The session
+ * @param[in] highest The client's sa_highest_slotid
+ * @param[in] skip    Slot of the current request, already locked
+ */
+
+void nfs41_Session_Release_Slots_Above(nfs41_session_t *session,
+				       slotid4 highest, slotid4 skip)
+{
+	slotid4 i;
+
+	for (i = highest + 1; i < session->fore_channel_attrs.ca_maxrequests;
+	     i++) {
+		if (atomic_fetch_uint32_t(&session->cached_replies) == 0)
+			break;
+
+		if (i == skip)
+			continue;
+
+		PTHREAD_MUTEX_lock(&session->slots[i].lock);
+		nfs41_Session_Release_Slot(session, &session->slots[i]);
+		PTHREAD_MUTEX_unlock(&session->slots[i].lock);
+	}
+}
+
+/**
+ * @brief Compute the sr_target_highest_slotid to send to the client
+ *
+ * The client is offered twice the slots it currently has in flight,
+ * so a busy client ramps up quickly and an idle one drifts back down.
+ * While more requests wait in the dispatch queue than there are workers
+ * to run them the target does not grow, and under reply cache memory
+ * pressure every session is asked to shrink to NFS41_NB_SLOTS.
+ *
+ * @param[in] session The session
+ *
+ * @return The target highest slotid.
+ */
+
+slotid4 nfs41_Session_Target_Slotid(nfs41_session_t *session)
+{
+	slotid4 max = session->fore_channel_attrs.ca_maxrequests - 1;
+	slotid4 highest = atomic_fetch_uint32_t(&session->highest_slotid);
+	slotid4 target = 2 * highest + 1;
+
+	if (atomic_fetch_uint64_t(&nfs41_session_cache_bytes) >
+	    nfs_param.nfsv4_param.session_cache_memory)
+		target = NFS41_NB_SLOTS - 1;
+	else if (get_enqueue_count() - get_dequeue_count() >
+		 nfs_param.core_param.nb_worker)
+		target = highest;
+
+	if (target < NFS41_NB_SLOTS - 1)
+		target = NFS41_NB_SLOTS - 1;
+
+	if (target > max)
+		target = max;
+
+	atomic_store_uint32_t(&session->target_highest_slotid, target);
+
+	return target;
+}
+
+/**
+ * @brief Save a compound reply in a session slot
+ *
+ * The reply is only kept if its encoded size fits the negotiated
+ * ca_maxresponsesize_cached.  The client asked for it to be cached, so
+ * when it does not fit the last operation's result is replaced with
+ * NFS4ERR_REP_TOO_BIG_TO_CACHE, as RFC 5661 2.10.6.1.3 requires, and
+ * that reply is cached instead.  Only if even that does not fit is the
+ * slot left uncached, for a retry to get NFS4ERR_RETRY_UNCACHED_REP.
+ *
+ * @param[in]     session The session
+ * @param[in]     slotid  The slot the request came in on
+ * @param[in,out] res     The reply, marked cached on success
+ *
+ * @retval true if the reply is now owned by the slot.
+ * @retval false if it was too big to cache.
+ */
+
+bool nfs41_Session_Cache_Reply(nfs41_session_t *session, slotid4 slotid,
+			       struct COMPOUND4res_extended *res)
+{
+	nfs41_session_slot_t *slot = &session->slots[slotid];
+	count4 max = session->fore_channel_attrs.ca_maxresponsesize_cached;
+	COMPOUND4res *compound = &res->res_compound4;
+	nfs_resop4 *last;
+	uint32_t size = 0;
+	bool fits;
+
+	/* Only measures the reply, nothing is encoded */
+	if (max > 0)
+		size = xdr_sizeof((xdrproc_t) xdr_COMPOUND4res, compound);
+
+	fits = size != 0 && size <= max;
+
+	/* SEQUENCE itself always stays */
+	if (!fits && compound->resarray.resarray_len > 1) {
+		LogDebug(COMPONENT_SESSIONS,
+			 "Reply on slot %" PRIu32 " is %" PRIu32
+			 " bytes, over ca_maxresponsesize_cached %" PRIu32,
+			 slotid, size, max);
+
+		last = &compound->resarray.resarray_val[
+					compound->resarray.resarray_len - 1];
+		nfs4_Compound_FreeOne(last);
+		last->nfs_resop4_u.opaccess.status =
+			NFS4ERR_REP_TOO_BIG_TO_CACHE;
+		compound->status = NFS4ERR_REP_TOO_BIG_TO_CACHE;
+
+		if (max > 0)
+			size = xdr_sizeof((xdrproc_t) xdr_COMPOUND4res,
+					  compound);
+		fits = size != 0 && size <= max;
+	}
+
+	PTHREAD_MUTEX_lock(&slot->lock);
+
+	nfs41_Session_Release_Slot(session, slot);
+
+	if (!fits) {
+		LogDebug(COMPONENT_SESSIONS,
+			 "Reply on slot %" PRIu32
+			 " exceeds ca_maxresponsesize_cached %" PRIu32
+			 ", not cached",
+			 slotid, max);
+		PTHREAD_MUTEX_unlock(&slot->lock);
+		return false;
+	}
+
+	res->res_cached = true;
+	slot->cached_result = *res;
+	slot->cached_size = size;
+	slot->cache_used = true;
+
+	(void) atomic_inc_uint32_t(&session->cached_replies);
+	(void) atomic_add_uint64_t(&session->cached_bytes, size);
+	(void) atomic_add_uint64_t(&nfs41_session_cache_bytes, size);
+
+	PTHREAD_MUTEX_unlock(&slot->lock);
+
+	return true;
+}
+
+/**
+ * @brief Call a function on every session in the session table
+ *
+ * The callback runs with the session's hash partition read locked, so
+ * it must not block or touch the session table.
+ *
+ * @param[in] cb    Callback, returns false to stop the walk
+ * @param[in] state Opaque state for the callback
+ */
+
+void nfs41_foreach_session(bool (*cb)(nfs41_session_t *session, void *state),
+			   void *state)
+{
+	uint32_t i;
+	struct rbt_head *head_rbt;
+	struct hash_data *pdata;
+	struct rbt_node *pn;
+	bool more = true;
+
+	for (i = 0; i < ht_session_id->parameter.index_size && more; i++) {
+		head_rbt = &ht_session_id->partitions[i].rbt;
+
+		PTHREAD_RWLOCK_rdlock(&ht_session_id->partitions[i].lock);
+
+		RBT_LOOP(head_rbt, pn) {
+			pdata = RBT_OPAQ(pn);
+			more = cb(pdata->val.addr, state);
+			if (!more)
+				break;
+			RBT_INCREMENT(pn);
+		}
+
+		PTHREAD_RWLOCK_unlock(&ht_session_id->partitions[i].lock);
+	}
+}
+
 /**
  * @brief Display the content of the session hashtable
  */
@@ -70,6 +70,31 @@ hash_table_t *ht_unconfirmed_client_id;
  */
 uint32_t clientid_counter;
 
+/**
+ * @brief Number of clientid counter values a thread reserves at once
+ *
+ * Each worker hands out clientids from its own block, so concurrent
+ * EXCHANGE_ID/SETCLIENTID do not bounce the shared counter between
+ * CPUs on every call.
+ */
+#define CLIENTID_BLOCK 64
+
+/**
+ * @brief Per-thread block of reserved clientid counter values
+ */
+static __thread uint32_t clientid_next;
+static __thread uint32_t clientid_left;
+
+/**
+ * @brief Expected clients per hash table partition
+ */
+#define CLIENTS_PER_PARTITION 64
+
+/**
+ * @brief Upper bound on client table partitions
+ */
+#define MAX_CLIENT_PARTITIONS 4093
+
 /**
  * @brief Verifier to construct clientids
  */
@@ -1272,6 +1297,41 @@ static hash_parameter_t cr_hash_param = {
 	.ht_log_component = COMPONENT_CLIENTID,
 };
 
+/**
+ * @brief Size a client table from the expected number of clients
+ *
+ * Each partition has its own lock, so spreading the tables over more
+ * partitions lets concurrent EXCHANGE_ID/CREATE_SESSION storms from
+ * many clients proceed in parallel.  The per-partition expected entry
+ * cache is shrunk in proportion so total memory stays about the same.
+ *
+ * @param[in,out] hparam Hash table parameters to adjust
+ */
+void client_id_size_table(hash_parameter_t *hparam)
+{
+	uint32_t partitions = nfs_param.nfsv4_param.expected_clients /
+			      CLIENTS_PER_PARTITION;
+
+	if (partitions <= PRIME_STATE)
+		return;
+
+	if (partitions > MAX_CLIENT_PARTITIONS)
+		partitions = MAX_CLIENT_PARTITIONS;
+
+	while (!is_prime(partitions))
+		partitions++;
+
+	hparam->index_size = partitions;
+	hparam->cache_entry_count = (PRIME_STATE * 32767) / partitions;
+	if (hparam->cache_entry_count < 1024)
+		hparam->cache_entry_count = 1024;
+
+	LogInfo(COMPONENT_CLIENTID,
+		"%s table sized for %"PRIu32" clients: %"PRIu32" partitions",
+		hparam->ht_name, nfs_param.nfsv4_param.expected_clients,
+		partitions);
+}
+
 /**
  * @brief Init the hashtable for Client Id cache.
  *
@@ -1281,6 +1341,10 @@ static hash_parameter_t cr_hash_param = {
  */
 int nfs_Init_client_id(void)
 {
+	client_id_size_table(&cid_confirmed_hash_param);
+	client_id_size_table(&cid_unconfirmed_hash_param);
+	client_id_size_table(&cr_hash_param);
+
 	ht_confirmed_client_id =
 		hashtable_init(&cid_confirmed_hash_param);
 
@@ -1331,16 +1395,27 @@ int display_clientid(struct display_buffer *dspbuf, clientid4 clientid)
  *
  * We use the clientid counter and the server epoch, the latter
  * ensures that clientids from old instances of Ganesha are marked as
- * invalid.
+ * invalid.  Counter values are reserved CLIENTID_BLOCK at a time per
+ * thread, so clientids are unique but not allocated in order.
  *
  * @return The new clientid.
  */
 
 clientid4 new_clientid(void)
 {
-	clientid4 newid = atomic_inc_uint32_t(&clientid_counter);
+	clientid4 newid;
 	uint64_t epoch_low = ServerEpoch & UINT32_MAX;
 
+	if (clientid_left == 0) {
+		clientid_next = atomic_add_uint32_t(&clientid_counter,
+						    CLIENTID_BLOCK) -
+				CLIENTID_BLOCK + 1;
+		clientid_left = CLIENTID_BLOCK;
+	}
+
+	newid = clientid_next++;
+	clientid_left--;
+
 	return newid + (epoch_low << (clientid4) 32);
 }
 
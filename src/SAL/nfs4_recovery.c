@@ -51,7 +51,12 @@ time_t current_grace;
 pthread_mutex_t grace_mutex = PTHREAD_MUTEX_INITIALIZER;        /*< Mutex */
 struct glist_head clid_list = GLIST_HEAD_INIT(clid_list);  /*< Clients */
 
+/* Reclaim progress, protected by grace_mutex */
+static uint32_t reclaim_expected;	/*< Entries in clid_list */
+static uint32_t reclaim_completed;	/*< Entries that sent RECLAIM_COMPLETE */
+
 static void nfs4_load_recov_clids_nolock(nfs_grace_start_t *gsp);
+static void nfs4_count_reclaims_nolock(void);
 static void nfs_release_nlm_state(char *release_ip);
 static void nfs_release_v4_client(char *ip);
 
@@ -66,6 +71,9 @@ static void nfs_release_v4_client(char *ip);
  */
 void nfs4_start_grace(nfs_grace_start_t *gsp)
 {
+	struct glist_head *node;
+	clid_entry_t *clid_ent;
+
 	if (nfs_param.nfsv4_param.graceless) {
 		LogEvent(COMPONENT_STATE,
 			 "NFS Server skipping GRACE (Graceless is true)");
@@ -91,6 +99,13 @@ void nfs4_start_grace(nfs_grace_start_t *gsp)
 
 	LogEvent(COMPONENT_STATE, "NFS Server Now IN GRACE, duration %d",
 		 (int)nfs_param.nfsv4_param.grace_period);
+
+	/* Every client must reclaim again in the new grace period */
+	glist_for_each(node, &clid_list) {
+		clid_ent = glist_entry(node, clid_entry_t, cl_list);
+		clid_ent->cl_reclaim_complete = false;
+	}
+
 	/*
 	 * if called from failover code and given a nodeid, then this node
 	 * is doing a take over.  read in the client ids from the failing node
@@ -110,6 +125,96 @@ void nfs4_start_grace(nfs_grace_start_t *gsp)
 				nfs4_load_recov_clids_nolock(gsp);
 		}
 	}
+	nfs4_count_reclaims_nolock();
+	PTHREAD_MUTEX_unlock(&grace_mutex);
+}
+
+/**
+ * @brief Recount the reclaim progress of the recovery client list
+ *
+ * Must be called with grace_mutex held, after clid_list changes.
+ */
+static void nfs4_count_reclaims_nolock(void)
+{
+	struct glist_head *node;
+	clid_entry_t *clid_ent;
+
+	reclaim_expected = 0;
+	reclaim_completed = 0;
+
+	glist_for_each(node, &clid_list) {
+		clid_ent = glist_entry(node, clid_entry_t, cl_list);
+		reclaim_expected++;
+		if (clid_ent->cl_reclaim_complete)
+			reclaim_completed++;
+	}
+
+	LogDebug(COMPONENT_STATE,
+		 "Reclaim progress %"PRIu32"/%"PRIu32" clients complete",
+		 reclaim_completed, reclaim_expected);
+}
+
+/**
+ * @brief Lift the grace period if every known client has reclaimed
+ *
+ * NFSv4.0 clients never send RECLAIM_COMPLETE, so a v4.0 client in
+ * the recovery database keeps the server in grace for the full
+ * period.  NLM clients can't signal completion either, so unless
+ * Lift_Grace_With_NLM is set, an NLM enabled server never lifts
+ * grace early.
+ *
+ * Must be called with grace_mutex held.
+ */
+static void nfs4_try_lift_grace_nolock(void)
+{
+	if (!nfs_param.nfsv4_param.lift_grace)
+		return;
+
+	if (nfs_param.core_param.enable_NLM &&
+	    !nfs_param.nfsv4_param.lift_grace_with_nlm)
+		return;
+
+	if (reclaim_completed < reclaim_expected)
+		return;
+
+	if ((atomic_fetch_time_t(&current_grace) +
+	     nfs_param.nfsv4_param.grace_period) <= time(NULL))
+		return;
+
+	LogEvent(COMPONENT_STATE,
+		 "All %"PRIu32" recovery clients have completed reclaim, lifting grace",
+		 reclaim_expected);
+
+	atomic_store_time_t(&current_grace, 0);
+}
+
+/**
+ * @brief Lift the grace period early if possible
+ *
+ * Called periodically so that a server with no clients to reclaim
+ * does not wait out the whole grace period.
+ */
+void nfs4_try_lift_grace(void)
+{
+	if (nfs_param.nfsv4_param.graceless)
+		return;
+
+	PTHREAD_MUTEX_lock(&grace_mutex);
+	nfs4_try_lift_grace_nolock();
+	PTHREAD_MUTEX_unlock(&grace_mutex);
+}
+
+/**
+ * @brief Get the reclaim progress of the current grace period
+ *
+ * @param[out] expected  Number of clients in the recovery database
+ * @param[out] completed Number of those that sent RECLAIM_COMPLETE
+ */
+void nfs4_get_reclaim_progress(uint32_t *expected, uint32_t *completed)
+{
+	PTHREAD_MUTEX_lock(&grace_mutex);
+	*expected = reclaim_expected;
+	*completed = reclaim_completed;
 	PTHREAD_MUTEX_unlock(&grace_mutex);
 }
 
@@ -453,6 +558,35 @@ void  nfs4_chk_clid(nfs_client_id_t *clientid)
 	PTHREAD_MUTEX_unlock(&grace_mutex);
 }
 
+/**
+ * @brief Record that a client has completed its reclaims
+ *
+ * Called on a global RECLAIM_COMPLETE.  If this was the last client
+ * in the recovery database still reclaiming, grace is lifted.
+ *
+ * @param[in] clientid Client record
+ */
+void nfs4_reclaim_complete(nfs_client_id_t *clientid)
+{
+	clid_entry_t *clid_ent;
+
+	if (!nfs_in_grace())
+		return;
+
+	PTHREAD_MUTEX_lock(&grace_mutex);
+	nfs4_chk_clid_impl(clientid, &clid_ent);
+	if (clid_ent != NULL && !clid_ent->cl_reclaim_complete) {
+		clid_ent->cl_reclaim_complete = true;
+		reclaim_completed++;
+		LogDebug(COMPONENT_CLIENTID,
+			 "%s reclaim complete, %"PRIu32"/%"PRIu32" clients",
+			 clid_ent->cl_name, reclaim_completed,
+			 reclaim_expected);
+		nfs4_try_lift_grace_nolock();
+	}
+	PTHREAD_MUTEX_unlock(&grace_mutex);
+}
+
 static void free_heap(char *path, char *new_path, char *build_clid)
 {
 	if (path)
@@ -742,6 +876,7 @@ static int nfs4_read_recov_clids(DIR *dp,
 							tgtdir,
 							!takeover);
 				strcpy(new_ent->cl_name, build_clid);
+				new_ent->cl_reclaim_complete = false;
 				glist_add(&clid_list,
 					  &new_ent->cl_list);
 				LogDebug(COMPONENT_CLIENTID,
@@ -885,6 +1020,7 @@ void nfs4_load_recov_clids(nfs_grace_start_t *gsp)
 	PTHREAD_MUTEX_lock(&grace_mutex);
 
 	nfs4_load_recov_clids_nolock(gsp);
+	nfs4_count_reclaims_nolock();
 
 	PTHREAD_MUTEX_unlock(&grace_mutex);
 }
@@ -52,6 +52,186 @@
 #include "server_stats.h"
 #include "fsal_up.h"
 #include "nfs_file_handle.h"
+#include "abstract_atomic.h"
+
+/* Most clients retry NFS operations after 5 seconds. The following
+ * should be good enough to avoid starving a client's open
+ */
+#define RECALL2DELEG_TIME 10
+
+/* Number of open/recall events kept in a file's conflict history */
+#define DELEG_HIST_BITS 32
+
+/* Conflict history length below which the adaptive policy does not
+ * trust its prediction enough to override a recent recall.
+ */
+#define DELEG_HIST_MIN 4
+
+/* Predicted conflict probabilities (percent) at or above which the
+ * adaptive policy stops granting read and write delegations.
+ */
+#define DELEG_READ_CONFLICT_PCT 50
+#define DELEG_WRITE_CONFLICT_PCT 12
+
+/* Initial per-client backoff after a recall, in seconds */
+#define DELEG_BACKOFF_MIN 5
+
+/**
+ * @brief Server-wide delegation policy statistics
+ */
+static struct deleg_policy_stats deleg_pstats;
+
+/** Protects the recall latency part of deleg_pstats */
+static pthread_mutex_t deleg_latency_mutex = PTHREAD_MUTEX_INITIALIZER;
+
+/**
+ * @brief Delegation policy operations
+ *
+ * Claims that are always answered the same way (reclaims, callback
+ * path down) are handled before the policy is consulted.
+ */
+struct deleg_policy_ops {
+	const char *name;
+	/** Decide on a new delegation, state_lock held */
+	bool (*grant)(struct file_deleg_stats *file_stats,
+		      nfs_client_id_t *client,
+		      const state_t *open_state);
+	/** A delegation held by client is being recalled */
+	void (*recalled)(nfs_client_id_t *client);
+	/** A delegation was returned, after a recall or not */
+	void (*returned)(nfs_client_id_t *client, bool recalled);
+};
+
+/**
+ * @brief Record an open or recall in a file's conflict history
+ *
+ * @note The state_lock MUST be held for write
+ */
+static void deleg_hist_push(struct file_deleg_stats *file_stats,
+			    bool conflict)
+{
+	file_stats->fds_conflict_hist =
+		(file_stats->fds_conflict_hist << 1) | (conflict ? 1 : 0);
+	if (file_stats->fds_hist_len < DELEG_HIST_BITS)
+		file_stats->fds_hist_len++;
+}
+
+/**
+ * @brief Predicted probability that a delegation on a file conflicts
+ *
+ * @return Percentage of conflicting events in the file's history.
+ */
+static uint32_t deleg_conflict_pct(const struct file_deleg_stats *file_stats)
+{
+	uint32_t len = file_stats->fds_hist_len;
+	uint32_t hist = file_stats->fds_conflict_hist;
+
+	if (len == 0)
+		return 0;
+
+	if (len < DELEG_HIST_BITS)
+		hist &= (1U << len) - 1;
+
+	return __builtin_popcount(hist) * 100 / len;
+}
+
+static bool default_grant(struct file_deleg_stats *file_stats,
+			  nfs_client_id_t *client,
+			  const state_t *open_state)
+{
+	/* If there is a recent recall on this file, the client that made
+	 * the conflicting open may retry the open later. Don't give out
+	 * delegation to avoid starving the client's open that caused
+	 * the recall.
+	 */
+	if (file_stats->fds_last_recall != 0 &&
+	    time(NULL) - file_stats->fds_last_recall < RECALL2DELEG_TIME)
+		return false;
+
+	/* Check if this is a misbehaving or unreliable client */
+	if (client->num_revokes > 2) /* more than 2 revokes */
+		return false;
+
+	return true;
+}
+
+static bool adaptive_grant(struct file_deleg_stats *file_stats,
+			   nfs_client_id_t *client,
+			   const state_t *open_state)
+{
+	time_t curr_time = time(NULL);
+	uint32_t conflict = deleg_conflict_pct(file_stats);
+	bool recent_recall = file_stats->fds_last_recall != 0 &&
+			     curr_time - file_stats->fds_last_recall <
+						RECALL2DELEG_TIME;
+
+	if (client->num_revokes > 2)
+		return false;
+
+	if (curr_time < atomic_fetch_time_t(&client->deleg_backoff_until))
+		return false;
+
+	LogFullDebug(COMPONENT_STATE,
+		     "Predicted conflict %"PRIu32"%% over %"PRIu32" events",
+		     conflict, file_stats->fds_hist_len);
+
+	if (open_state->state_data.share.share_access &
+	    OPEN4_SHARE_ACCESS_WRITE)
+		return !recent_recall && conflict < DELEG_WRITE_CONFLICT_PCT;
+
+	/* A read delegation only conflicts with writers, so a single
+	 * recall on a file that is otherwise private doesn't hold it up.
+	 */
+	if (conflict >= DELEG_READ_CONFLICT_PCT)
+		return false;
+
+	return !recent_recall || file_stats->fds_hist_len >= DELEG_HIST_MIN;
+}
+
+static void adaptive_recalled(nfs_client_id_t *client)
+{
+	uint32_t backoff;
+
+	PTHREAD_MUTEX_lock(&client->cid_mutex);
+	backoff = client->deleg_backoff == 0
+			? DELEG_BACKOFF_MIN : client->deleg_backoff * 2;
+	if (backoff > nfs_param.nfsv4_param.deleg_backoff_max)
+		backoff = nfs_param.nfsv4_param.deleg_backoff_max;
+	client->deleg_backoff = backoff;
+	atomic_store_time_t(&client->deleg_backoff_until, time(NULL) + backoff);
+	PTHREAD_MUTEX_unlock(&client->cid_mutex);
+}
+
+static void adaptive_returned(nfs_client_id_t *client, bool recalled)
+{
+	/* A voluntary return means the client is behaving, decay the
+	 * backoff it earned earlier.
+	 */
+	if (recalled)
+		return;
+
+	PTHREAD_MUTEX_lock(&client->cid_mutex);
+	client->deleg_backoff /= 2;
+	PTHREAD_MUTEX_unlock(&client->cid_mutex);
+}
+
+static const struct deleg_policy_ops deleg_policies[] = {
+	[DELEG_POLICY_DEFAULT] = {
+		.name = "default",
+		.grant = default_grant,
+	},
+	[DELEG_POLICY_ADAPTIVE] = {
+		.name = "adaptive",
+		.grant = adaptive_grant,
+		.recalled = adaptive_recalled,
+		.returned = adaptive_returned,
+	},
+};
+
+static inline const struct deleg_policy_ops *deleg_policy(void)
+{
+	return &deleg_policies[nfs_param.nfsv4_param.deleg_policy];
+}
 
 /**
  * @brief Check if exiting OPENs would conflict granting a delegation.
@@ -131,6 +311,8 @@ void init_new_deleg_state(union state_data *deleg_state,
 
 	clfile_entry->cfd_rs_time = 0;
 	clfile_entry->cfd_r_time = 0;
+	clfile_entry->cfd_r_start.tv_sec = 0;
+	clfile_entry->cfd_r_start.tv_nsec = 0;
 }
 
 /**
@@ -277,6 +459,8 @@ void update_delegation_stats(struct state_hdl *ostate,
 	/* Update delegation stats for client. */
 	inc_grants(client->gsh_client);
 	client->curr_deleg_grants++;
+
+	(void) atomic_inc_uint64_t(&deleg_pstats.grants);
 }
 
 /* Add a new delegation length to the average length stat. */
@@ -292,13 +476,19 @@ static int advance_avg(time_t prev_avg, time_t new_time,
  * Update statistics on successfully recalled delegation.
  * Note: This should be called only when a delegation is successfully recalled.
  *
- * @param[in] deleg Delegation state
+ * @param[in] deleg   Delegation state
+ * @param[in] revoked true if the delegation is being revoked rather than
+ *                    returned by the client
  */
 void deleg_heuristics_recall(struct fsal_obj_handle *obj,
 			     state_owner_t *owner,
-			     struct state_t *deleg)
+			     struct state_t *deleg,
+			     bool revoked)
 {
 	nfs_client_id_t *client = owner->so_owner.so_nfs4_owner.so_clientrec;
+	struct timespec *r_start =
+		&deleg->state_data.deleg.sd_clfile_stats.cfd_r_start;
+	bool recalled = r_start->tv_sec != 0;
 	/* Update delegation stats for file. */
 	struct file_deleg_stats *statistics =
 		&obj->state_hdl->file.fdeleg_stats;
@@ -316,6 +506,101 @@ void deleg_heuristics_recall(struct fsal_obj_handle *obj,
 					   - statistics->fds_last_delegation,
 					   statistics->fds_recall_count - 1,
 					   statistics->fds_recall_count);
+
+	if (revoked) {
+		(void) atomic_inc_uint64_t(&deleg_pstats.revokes);
+	} else if (recalled) {
+		struct timespec ts;
+		nsecs_elapsed_t latency;
+
+		now(&ts);
+		latency = timespec_diff(r_start, &ts);
+
+		PTHREAD_MUTEX_lock(&deleg_latency_mutex);
+		deleg_pstats.recall_count++;
+		deleg_pstats.recall_latency += latency;
+		if (latency > deleg_pstats.recall_max)
+			deleg_pstats.recall_max = latency;
+		PTHREAD_MUTEX_unlock(&deleg_latency_mutex);
+	}
+
+	if (!revoked && deleg_policy()->returned)
+		deleg_policy()->returned(client, recalled);
+}
+
+/**
+ * @brief Record the start of a delegation recall
+ *
+ * Called once per delegation, on the first recall attempt.
+ *
+ * @note The state_lock MUST be held for write
+ *
+ * @param[in] obj    File being recalled
+ * @param[in] deleg  Delegation state
+ * @param[in] client Client holding the delegation
+ */
+void deleg_recall_start(struct fsal_obj_handle *obj, struct state_t *deleg,
+			nfs_client_id_t *client)
+{
+	now(&deleg->state_data.deleg.sd_clfile_stats.cfd_r_start);
+	deleg_hist_push(&obj->state_hdl->file.fdeleg_stats, true);
+	(void) atomic_inc_uint64_t(&deleg_pstats.recalls);
+
+	if (deleg_policy()->recalled)
+		deleg_policy()->recalled(client);
+}
+
+/**
+ * @brief Record an OPEN in the file's conflict history
+ *
+ * An open is counted as a conflict when another client opened the
+ * file within the last lease period.
+ *
+ * @note The state_lock MUST be held for write
+ *
+ * @param[in] ostate File state
+ * @param[in] client Client doing the OPEN
+ */
+void deleg_record_open(struct state_hdl *ostate, nfs_client_id_t *client)
+{
+	struct file_deleg_stats *file_stats = &ostate->file.fdeleg_stats;
+	time_t curr_time = time(NULL);
+
+	deleg_hist_push(file_stats,
+			file_stats->fds_last_clientid != 0 &&
+			file_stats->fds_last_clientid != client->cid_clientid &&
+			curr_time - file_stats->fds_last_open <
+				nfs_param.nfsv4_param.lease_lifetime);
+
+	file_stats->fds_last_clientid = client->cid_clientid;
+	file_stats->fds_last_open = curr_time;
+}
+
+/**
+ * @brief Get the name of the configured delegation policy
+ */
+const char *deleg_policy_name(void)
+{
+	return deleg_policy()->name;
+}
+
+/**
+ * @brief Copy out the delegation policy statistics
+ *
+ * @param[out] stats Snapshot of the counters
+ */
+void deleg_policy_get_stats(struct deleg_policy_stats *stats)
+{
+	stats->grants = atomic_fetch_uint64_t(&deleg_pstats.grants);
+	stats->recalls = atomic_fetch_uint64_t(&deleg_pstats.recalls);
+	stats->revokes = atomic_fetch_uint64_t(&deleg_pstats.revokes);
+	stats->denials = atomic_fetch_uint64_t(&deleg_pstats.denials);
+
+	PTHREAD_MUTEX_lock(&deleg_latency_mutex);
+	stats->recall_count = deleg_pstats.recall_count;
+	stats->recall_latency = deleg_pstats.recall_latency;
+	stats->recall_max = deleg_pstats.recall_max;
+	PTHREAD_MUTEX_unlock(&deleg_latency_mutex);
 }
 
 /**
@@ -346,15 +631,14 @@ bool init_deleg_heuristics(struct fsal_obj_handle *obj)
 	statistics->fds_avg_hold = 0;
 	statistics->fds_num_opens = 0;
 	statistics->fds_first_open = 0;
+	statistics->fds_conflict_hist = 0;
+	statistics->fds_hist_len = 0;
+	statistics->fds_last_clientid = 0;
+	statistics->fds_last_open = 0;
 
 	return true;
 }
 
-/* Most clients retry NFS operations after 5 seconds. The following
- * should be good enough to avoid starving a client's open
- */
-#define RECALL2DELEG_TIME 10
-
 /**
  * @brief Decide if a delegation should be granted based on heuristics.
  *
@@ -418,18 +702,13 @@ bool should_we_grant_deleg(struct state_hdl *ostate, nfs_client_id_t *client,
 		}
 	}
 
-	/* If there is a recent recall on this file, the client that made
-	 * the conflicting open may retry the open later. Don't give out
-	 * delegation to avoid starving the client's open that caused
-	 * the recall.
-	 */
-	if (file_stats->fds_last_recall != 0 &&
-	    time(NULL) - file_stats->fds_last_recall < RECALL2DELEG_TIME)
-		return false;
-
-	/* Check if this is a misbehaving or unreliable client */
-	if (client->num_revokes > 2) /* more than 2 revokes */
+	if (!deleg_policy()->grant(file_stats, client, open_state)) {
+		(void) atomic_inc_uint64_t(&deleg_pstats.denials);
+		LogDebug(COMPONENT_STATE,
+			 "Delegation policy %s declined to delegate",
+			 deleg_policy()->name);
 		return false;
+	}
 
 	LogDebug(COMPONENT_STATE, "Let's delegate!!");
 	return true;
@@ -492,7 +771,7 @@ nfsstat4 deleg_revoke(struct fsal_obj_handle *obj, struct state_t *deleg_state)
 	/* Building a new fh ; Ignore return code, should not fail*/
 	(void) nfs4_FSALToFhandle(true, &fhandle, obj, export);
 
-	deleg_heuristics_recall(obj, owner, deleg_state);
+	deleg_heuristics_recall(obj, owner, deleg_state, true);
 
 	/* Build op_context for state_unlock_locked */
 	init_root_op_context(&root_op_context, NULL, NULL, 0, 0,
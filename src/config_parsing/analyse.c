@@ -30,11 +30,32 @@
 #include <stdlib.h>
 #include <stdio.h>
 #include <stdarg.h>
+#include <ctype.h>
 #if HAVE_STRING_H
 #include <string.h>
 #endif
 #include "abstract_mem.h"
 
+/**
+ * @brief Hash a token or node name ignoring case
+ *
+ * @param name [IN] NUL terminated name
+ *
+ * @return FNV-1a of the lower cased name.
+ */
+
+uint32_t config_name_hash(const char *name)
+{
+	const unsigned char *p = (const unsigned char *)name;
+	uint32_t hash = 2166136261U;
+
+	for (; *p != '\0'; p++) {
+		hash ^= tolower(*p);
+		hash *= 16777619U;
+	}
+	return hash;
+}
+
 /**
  * @brief Insert a scanner token into the token table
  *
@@ -52,11 +73,13 @@
 
 char *save_token(char *token, bool esc, struct parser_state *st)
 {
-	struct token_tab *tokp, *new_tok;
+	struct token_tab *tokp, *new_tok, **bucket;
 
-	for (tokp = st->root_node->tokens;
+	/* Tokens that match ignoring case hash alike */
+	for (tokp = st->root_node->token_hash[config_name_hash(token) &
+					      (CONFIG_TOKEN_HASH - 1)];
 	     tokp != NULL;
-	     tokp = tokp->next) {
+	     tokp = tokp->hash_next) {
 		if (strcasecmp(token, tokp->token) == 0)
 			return tokp->token;
 	}
@@ -105,6 +128,10 @@ char *save_token(char *token, bool esc, struct parser_state *st)
 	}
 	new_tok->next = st->root_node->tokens;
 	st->root_node->tokens = new_tok;
+	bucket = &st->root_node->token_hash[config_name_hash(new_tok->token) &
+					    (CONFIG_TOKEN_HASH - 1)];
+	new_tok->hash_next = *bucket;
+	*bucket = new_tok;
 	return new_tok->token;
 }
 
@@ -231,6 +258,7 @@ static void free_node(struct config_node *node)
 			glist_del(&sub_node->node);
 			free_node(sub_node);
 		}
+		gsh_free(node->u.nterm.index);
 	}
 	gsh_free(node);
 	return;
@@ -248,6 +276,7 @@ void free_parse_tree(struct config_root *tree)
 		glist_del(&node->node);
 		free_node(node);
 	}
+	gsh_free(tree->root.u.nterm.index);
 	gsh_free(tree->root.filename);
 	if(tree->conf_dir != NULL)
 		gsh_free(tree->conf_dir);
@@ -61,6 +61,11 @@ struct config_node {
 			char *name;	/* name */
 			struct config_node *parent;
 			struct glist_head sub_nodes;
+			/* name index of sub_nodes, built on first lookup */
+			struct config_node **index;
+			uint32_t index_mask;
+			/* next sibling of the same name */
+			struct config_node *next_same;
 		} nterm;
 	}u;
 };
@@ -77,17 +82,22 @@ struct file_list {
 
 /*
  * Symbol table
- * Every token the scanner keeps goes here.  It is a linear
- * list but we don't need much more than that.  What we do
- * need is an accounting of all that memory so we can free it
- * when the parser barfs and leaves stuff on its FSM stack.
+ * Every token the scanner keeps goes here.  The linear list is
+ * the accounting of all that memory so we can free it when the
+ * parser barfs and leaves stuff on its FSM stack.  The hash, on
+ * the case folded token, keeps lookups from scanning it, which
+ * gets quadratic with thousands of exports.
  */
 
 struct token_tab {
 	struct token_tab *next;
+	struct token_tab *hash_next;	/* token_hash bucket chain */
+	uint32_t index;			/* position when serialized */
 	char token[];
 };
 
+#define CONFIG_TOKEN_HASH 1024	/* power of 2 */
+
 /*
  * Parse tree root
  * A parse tree consists of several blocks,
@@ -103,6 +113,7 @@ struct config_root {
 	char *conf_dir;
 	struct file_list *files;
 	struct token_tab *tokens;
+	struct token_tab *token_hash[CONFIG_TOKEN_HASH];
 };
 
 /*
@@ -118,6 +129,7 @@ struct parser_state {
 	struct config_error_type *err_type;
 };
 
+uint32_t config_name_hash(const char *name);
 char *save_token(char *token, bool esc, struct parser_state *st);
 int ganesha_yyparse(struct parser_state *st);
 int ganeshun_yy_init_parser(char *srcfile,
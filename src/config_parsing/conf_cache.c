@@ -0,0 +1,572 @@
+/* ----------------------------------------------------------------------------
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public License
+ * as published by the Free Software Foundation; either version 3 of
+ * the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA
+ * 02110-1301 USA
+ *
+ * ---------------------------------------
+ */
+
+/**
+ * @file conf_cache.c
+ * @brief Precompiled parse tree cache
+ *
+ * A parse tree is saved as a flat binary image: the files it came
+ * from with their mtime, size and content hash, the token table,
+ * then the nodes in preorder referring to both by index.  Loading it
+ * back skips the scanner and parser entirely.  The image is only
+ * used while every source file still matches.
+ */
+
+#include "config.h"
+#include <stdio.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <stddef.h>
+#include <string.h>
+#include <sys/types.h>
+#include <sys/stat.h>
+#include "config_parsing.h"
+#include "analyse.h"
+#include "abstract_mem.h"
+#include "log.h"
+
+#define CONF_CACHE_MAGIC "GSHCONF"
+#define CONF_CACHE_VERSION 1
+#define CONF_CACHE_BYTE_ORDER 0x01020304
+#define CONF_CACHE_NONE UINT32_MAX	/* NULL string or index */
+#define CONF_CACHE_MAX_DEPTH 64		/* The parser nests far less */
+
+struct conf_cache_header {
+	char magic[8];
+	uint32_t version;
+	uint32_t byte_order;
+	uint64_t length;	/*< of the body that follows */
+	uint64_t checksum;	/*< of the body */
+};
+
+/**
+ * @brief What a source file looked like when the image was saved
+ */
+struct conf_cache_sig {
+	int64_t mtime_sec;
+	int64_t mtime_nsec;
+	uint64_t size;
+	uint64_t hash;
+};
+
+struct conf_cache_buf {
+	char *data;
+	size_t len;
+	size_t size;
+};
+
+struct conf_cache_reader {
+	const char *pos;
+	const char *end;
+	bool bad;
+};
+
+static uint64_t conf_cache_hash(uint64_t hash, const void *data, size_t len)
+{
+	const unsigned char *p = data;
+	size_t i;
+
+	for (i = 0; i < len; i++) {
+		hash ^= p[i];
+		hash *= 1099511628211ULL;
+	}
+	return hash;
+}
+
+/**
+ * @brief Stat and hash a source file
+ *
+ * @param path [IN]  The file
+ * @param sig  [OUT] Its signature
+ *
+ * @return 0 or an errno.
+ */
+
+static int conf_cache_file_sig(const char *path, struct conf_cache_sig *sig)
+{
+	char buf[65536];
+	struct stat st;
+	ssize_t n;
+	int fd, rc = 0;
+
+	fd = open(path, O_RDONLY);
+	if (fd < 0)
+		return errno;
+	if (fstat(fd, &st) != 0) {
+		rc = errno;
+		goto out;
+	}
+	sig->mtime_sec = st.st_mtim.tv_sec;
+	sig->mtime_nsec = st.st_mtim.tv_nsec;
+	sig->size = st.st_size;
+	sig->hash = 14695981039346656037ULL;
+	while ((n = read(fd, buf, sizeof(buf))) != 0) {
+		if (n < 0) {
+			if (errno == EINTR)
+				continue;
+			rc = errno;
+			goto out;
+		}
+		sig->hash = conf_cache_hash(sig->hash, buf, n);
+	}
+out:
+	close(fd);
+	return rc;
+}
+
+static void put_bytes(struct conf_cache_buf *buf, const void *data,
+		      size_t len)
+{
+	if (buf->len + len > buf->size) {
+		while (buf->len + len > buf->size)
+			buf->size = buf->size ? buf->size * 2 : 65536;
+		buf->data = gsh_realloc(buf->data, buf->size);
+	}
+	memcpy(buf->data + buf->len, data, len);
+	buf->len += len;
+}
+
+static void put_u32(struct conf_cache_buf *buf, uint32_t val)
+{
+	put_bytes(buf, &val, sizeof(val));
+}
+
+static void put_str(struct conf_cache_buf *buf, const char *str)
+{
+	uint32_t len = str != NULL ? strlen(str) : CONF_CACHE_NONE;
+
+	put_u32(buf, len);
+	if (str != NULL)
+		put_bytes(buf, str, len);
+}
+
+static uint32_t token_index(const char *token)
+{
+	if (token == NULL)
+		return CONF_CACHE_NONE;
+	return ((struct token_tab *)(token -
+				     offsetof(struct token_tab, token)))->index;
+}
+
+static uint32_t file_index(struct config_root *root, const char *filename)
+{
+	struct file_list *file;
+	uint32_t i = 0;
+
+	for (file = root->files; file != NULL; file = file->next, i++) {
+		if (file->pathname == filename)
+			return i;
+	}
+	return CONF_CACHE_NONE;
+}
+
+static void put_node(struct conf_cache_buf *buf, struct config_root *root,
+		     struct config_node *node)
+{
+	struct glist_head *ns;
+
+	put_u32(buf, node->type);
+	put_u32(buf, file_index(root, node->filename));
+	put_u32(buf, node->linenumber);
+
+	if (node->type == TYPE_TERM) {
+		put_u32(buf, node->u.term.type);
+		put_u32(buf, token_index(node->u.term.op_code));
+		put_u32(buf, token_index(node->u.term.varvalue));
+		return;
+	}
+
+	put_u32(buf, token_index(node->u.nterm.name));
+	put_u32(buf, glist_length(&node->u.nterm.sub_nodes));
+	glist_for_each(ns, &node->u.nterm.sub_nodes)
+		put_node(buf, root, glist_entry(ns, struct config_node, node));
+}
+
+/**
+ * @brief Save a parse tree image
+ *
+ * The image is written beside the cache file and renamed over it, so
+ * a concurrent load sees either the old or the new one.
+ *
+ * @param root       [IN] A parse tree without errors
+ * @param cache_path [IN] Where to save it
+ *
+ * @return 0 or an errno.
+ */
+
+static int conf_cache_save(struct config_root *root, const char *cache_path)
+{
+	struct conf_cache_buf buf = {NULL, 0, 0};
+	struct conf_cache_header header;
+	struct conf_cache_sig sig;
+	struct file_list *file;
+	struct token_tab *token;
+	struct glist_head *ns;
+	char *tmp_path;
+	uint32_t count;
+	ssize_t n;
+	size_t done;
+	int fd, rc;
+
+	put_str(&buf, root->root.filename);
+	put_str(&buf, root->conf_dir);
+
+	for (count = 0, file = root->files; file != NULL; file = file->next)
+		count++;
+	put_u32(&buf, count);
+	for (file = root->files; file != NULL; file = file->next) {
+		rc = conf_cache_file_sig(file->pathname, &sig);
+		if (rc != 0)
+			goto out;
+		put_str(&buf, file->pathname);
+		put_bytes(&buf, &sig, sizeof(sig));
+	}
+
+	for (count = 0, token = root->tokens; token != NULL;
+	     token = token->next)
+		token->index = count++;
+	put_u32(&buf, count);
+	for (token = root->tokens; token != NULL; token = token->next)
+		put_str(&buf, token->token);
+
+	put_u32(&buf, glist_length(&root->root.u.nterm.sub_nodes));
+	glist_for_each(ns, &root->root.u.nterm.sub_nodes)
+		put_node(&buf, root, glist_entry(ns, struct config_node, node));
+
+	memset(&header, 0, sizeof(header));
+	memcpy(header.magic, CONF_CACHE_MAGIC, sizeof(CONF_CACHE_MAGIC));
+	header.version = CONF_CACHE_VERSION;
+	header.byte_order = CONF_CACHE_BYTE_ORDER;
+	header.length = buf.len;
+	header.checksum = conf_cache_hash(14695981039346656037ULL,
+					  buf.data, buf.len);
+
+	tmp_path = gsh_malloc(strlen(cache_path) + 16);
+	sprintf(tmp_path, "%s.%d", cache_path, (int)getpid());
+	fd = open(tmp_path, O_WRONLY | O_CREAT | O_TRUNC, 0600);
+	if (fd < 0) {
+		rc = errno;
+		gsh_free(tmp_path);
+		goto out;
+	}
+	rc = 0;
+	if (write(fd, &header, sizeof(header)) != (ssize_t)sizeof(header))
+		rc = errno ? errno : EIO;
+	for (done = 0; rc == 0 && done < buf.len; done += n) {
+		n = write(fd, buf.data + done, buf.len - done);
+		if (n < 0 && errno == EINTR) {
+			n = 0;
+		} else if (n <= 0) {
+			rc = n < 0 ? errno : EIO;
+			break;
+		}
+	}
+	if (close(fd) != 0 && rc == 0)
+		rc = errno;
+	if (rc == 0 && rename(tmp_path, cache_path) != 0)
+		rc = errno;
+	if (rc != 0)
+		unlink(tmp_path);
+	gsh_free(tmp_path);
+
+out:
+	gsh_free(buf.data);
+	return rc;
+}
+
+static const void *get_bytes(struct conf_cache_reader *rd, size_t len)
+{
+	const void *data = rd->pos;
+
+	if (rd->bad || (size_t)(rd->end - rd->pos) < len) {
+		rd->bad = true;
+		return NULL;
+	}
+	rd->pos += len;
+	return data;
+}
+
+static uint32_t get_u32(struct conf_cache_reader *rd)
+{
+	const void *data = get_bytes(rd, sizeof(uint32_t));
+	uint32_t val;
+
+	if (data == NULL)
+		return CONF_CACHE_NONE;
+	memcpy(&val, data, sizeof(val));
+	return val;
+}
+
+/**
+ * @brief Read a string into fresh storage
+ *
+ * @return The string, NULL if it was NULL or on a short image.
+ */
+
+static char *get_str(struct conf_cache_reader *rd)
+{
+	uint32_t len = get_u32(rd);
+	const char *data;
+	char *str;
+
+	if (len == CONF_CACHE_NONE)
+		return NULL;
+	data = get_bytes(rd, len);
+	if (data == NULL)
+		return NULL;
+	str = gsh_malloc(len + 1);
+	memcpy(str, data, len);
+	str[len] = '\0';
+	return str;
+}
+
+static char *get_token(struct conf_cache_reader *rd, char **tokens,
+		       uint32_t ntokens)
+{
+	uint32_t idx = get_u32(rd);
+
+	if (idx == CONF_CACHE_NONE)
+		return NULL;
+	if (idx >= ntokens) {
+		rd->bad = true;
+		return NULL;
+	}
+	return tokens[idx];
+}
+
+/**
+ * @brief Read a node and its sub_nodes, linking them to the parent
+ */
+
+static void get_node(struct conf_cache_reader *rd, struct config_node *parent,
+		     char **files, uint32_t nfiles,
+		     char **tokens, uint32_t ntokens, int depth)
+{
+	struct config_node *node;
+	uint32_t type, idx, count;
+
+	type = get_u32(rd);
+	if (rd->bad || depth > CONF_CACHE_MAX_DEPTH ||
+	    (type != TYPE_BLOCK && type != TYPE_STMT && type != TYPE_TERM) ||
+	    (type == TYPE_TERM) != (parent->type == TYPE_STMT)) {
+		rd->bad = true;
+		return;
+	}
+
+	node = gsh_calloc(1, sizeof(struct config_node));
+	glist_init(&node->node);
+	node->type = type;
+	idx = get_u32(rd);
+	if (idx < nfiles)
+		node->filename = files[idx];
+	node->linenumber = get_u32(rd);
+	glist_add_tail(&parent->u.nterm.sub_nodes, &node->node);
+
+	if (type == TYPE_TERM) {
+		node->u.term.type = get_u32(rd);
+		node->u.term.op_code = get_token(rd, tokens, ntokens);
+		node->u.term.varvalue = get_token(rd, tokens, ntokens);
+		return;
+	}
+
+	glist_init(&node->u.nterm.sub_nodes);
+	node->u.nterm.name = get_token(rd, tokens, ntokens);
+	if (node->u.nterm.name == NULL)
+		rd->bad = true;
+	if (type == TYPE_BLOCK)
+		node->u.nterm.parent = parent;
+	for (count = get_u32(rd); !rd->bad && count > 0; count--)
+		get_node(rd, node, files, nfiles, tokens, ntokens, depth + 1);
+}
+
+/**
+ * @brief Load a saved parse tree image
+ *
+ * @param file_path  [IN] The config file the image must be of
+ * @param cache_path [IN] The image
+ *
+ * @return The parse tree or NULL if the image is missing, corrupt or
+ *         stale.
+ */
+
+static struct config_root *conf_cache_load(const char *file_path,
+					   const char *cache_path)
+{
+	struct conf_cache_header header;
+	struct conf_cache_reader rd;
+	struct conf_cache_sig sig, cur_sig;
+	struct config_root *root = NULL;
+	struct file_list *file, **file_tail;
+	struct token_tab *token, **token_tail;
+	char **files = NULL, **tokens = NULL;
+	uint32_t nfiles = 0, ntokens = 0, i, count;
+	char *data = NULL, *str;
+	struct stat st;
+	ssize_t n;
+	size_t done;
+	int fd;
+
+	fd = open(cache_path, O_RDONLY);
+	if (fd < 0)
+		return NULL;
+	if (fstat(fd, &st) != 0 || st.st_size < (off_t)sizeof(header) ||
+	    read(fd, &header, sizeof(header)) != (ssize_t)sizeof(header) ||
+	    memcmp(header.magic, CONF_CACHE_MAGIC,
+		   sizeof(CONF_CACHE_MAGIC)) != 0 ||
+	    header.version != CONF_CACHE_VERSION ||
+	    header.byte_order != CONF_CACHE_BYTE_ORDER ||
+	    header.length != (uint64_t)st.st_size - sizeof(header)) {
+		close(fd);
+		return NULL;
+	}
+	data = gsh_malloc(header.length + 1);
+	for (done = 0; done < header.length; done += n) {
+		n = read(fd, data + done, header.length - done);
+		if (n < 0 && errno == EINTR) {
+			n = 0;
+		} else if (n <= 0) {
+			close(fd);
+			goto bad;
+		}
+	}
+	close(fd);
+	if (conf_cache_hash(14695981039346656037ULL, data, header.length) !=
+	    header.checksum)
+		goto bad;
+
+	rd.pos = data;
+	rd.end = data + header.length;
+	rd.bad = false;
+
+	root = gsh_calloc(1, sizeof(struct config_root));
+	glist_init(&root->root.node);
+	glist_init(&root->root.u.nterm.sub_nodes);
+	root->root.type = TYPE_ROOT;
+	root->root.filename = get_str(&rd);
+	if (root->root.filename == NULL ||
+	    strcmp(root->root.filename, file_path) != 0)
+		goto bad;
+	root->conf_dir = get_str(&rd);
+
+	/* Every file that went into the tree must be unchanged */
+	nfiles = get_u32(&rd);
+	if (rd.bad || nfiles > (rd.end - rd.pos) / sizeof(uint32_t))
+		goto bad;
+	files = gsh_calloc(nfiles ? nfiles : 1, sizeof(char *));
+	file_tail = &root->files;
+	for (i = 0; i < nfiles; i++) {
+		str = get_str(&rd);
+		if (str == NULL)
+			goto bad;
+		file = gsh_calloc(1, sizeof(struct file_list));
+		file->pathname = str;
+		*file_tail = file;
+		file_tail = &file->next;
+		files[i] = str;
+		if (get_bytes(&rd, sizeof(sig)) == NULL)
+			goto bad;
+		memcpy(&sig, rd.pos - sizeof(sig), sizeof(sig));
+		if (conf_cache_file_sig(str, &cur_sig) != 0 ||
+		    memcmp(&sig, &cur_sig, sizeof(sig)) != 0) {
+			LogDebug(COMPONENT_CONFIG,
+				 "Config cache %s is stale, %s changed",
+				 cache_path, str);
+			goto bad;
+		}
+	}
+
+	ntokens = get_u32(&rd);
+	if (rd.bad || ntokens > (rd.end - rd.pos) / sizeof(uint32_t))
+		goto bad;
+	tokens = gsh_calloc(ntokens ? ntokens : 1, sizeof(char *));
+	token_tail = &root->tokens;
+	for (i = 0; i < ntokens; i++) {
+		count = get_u32(&rd);
+		if (count == CONF_CACHE_NONE ||
+		    get_bytes(&rd, count) == NULL)
+			goto bad;
+		token = gsh_calloc(1, sizeof(struct token_tab) + count + 1);
+		memcpy(token->token, rd.pos - count, count);
+		*token_tail = token;
+		token_tail = &token->next;
+		tokens[i] = token->token;
+	}
+
+	for (count = get_u32(&rd); !rd.bad && count > 0; count--)
+		get_node(&rd, &root->root, files, nfiles, tokens, ntokens, 0);
+	if (rd.bad || rd.pos != rd.end)
+		goto bad;
+
+	gsh_free(tokens);
+	gsh_free(files);
+	gsh_free(data);
+	return root;
+
+bad:
+	if (root != NULL)
+		free_parse_tree(root);
+	gsh_free(tokens);
+	gsh_free(files);
+	gsh_free(data);
+	return NULL;
+}
+
+/**
+ * @brief Parse a configuration file, going through a precompiled image
+ *
+ * If the image at cache_path is of this file and none of the files
+ * that went into it changed, the parse tree is loaded from it.
+ * Otherwise the file is parsed and, if it had no errors, the image is
+ * saved for the next time.
+ *
+ * @param file_path  [IN]  local path to the config file
+ * @param cache_path [IN]  the image, NULL or empty to always parse
+ * @param err_type   [OUT] Error type. Check this for success.
+ *
+ * @return pointer to parse tree.  Must be freed if != NULL
+ */
+
+config_file_t config_ParseFileCached(char *file_path, const char *cache_path,
+				     struct config_error_type *err_type)
+{
+	struct config_root *root;
+	int rc;
+
+	if (cache_path == NULL || cache_path[0] == '\0')
+		return config_ParseFile(file_path, err_type);
+
+	root = conf_cache_load(file_path, cache_path);
+	if (root != NULL) {
+		LogDebug(COMPONENT_CONFIG,
+			 "Loaded %s from config cache %s",
+			 file_path, cache_path);
+		return (config_file_t)root;
+	}
+
+	root = (struct config_root *)config_ParseFile(file_path, err_type);
+	if (root != NULL && config_error_no_error(err_type)) {
+		rc = conf_cache_save(root, cache_path);
+		if (rc != 0)
+			LogWarn(COMPONENT_CONFIG,
+				"Could not save config cache %s: %s",
+				cache_path, strerror(rc));
+	}
+	return (config_file_t)root;
+}
@@ -640,60 +640,93 @@ static void do_proc(struct config_node *node,
 }
 
 /**
- * @brief Lookup the first node in the list by this name
+ * @brief Index the sub_nodes of a block by name
  *
- * @param list - head of the glist
- * @param name - node name of interest
+ * Each slot holds the first node of a name, the others hang off it in
+ * order through next_same.  A block is loaded several times, against
+ * tables of dozens of parameters, so this is built once and kept in
+ * the parse tree.
  *
- * @return first matching node or NULL
+ * @param blk - the block
  */
 
-static struct config_node *lookup_node(struct glist_head *list,
-				       const char *name)
+static void index_sub_nodes(struct config_node *blk)
 {
-	struct config_node *node;
+	struct config_node *node, *slot;
 	struct glist_head *ns;
-	
-	glist_for_each(ns, list) {
+	uint32_t size = 8, i;
+
+	while (size < glist_length(&blk->u.nterm.sub_nodes) * 2)
+		size <<= 1;
+	blk->u.nterm.index = gsh_calloc(size, sizeof(struct config_node *));
+	blk->u.nterm.index_mask = size - 1;
+
+	glist_for_each(ns, &blk->u.nterm.sub_nodes) {
 		node = glist_entry(ns, struct config_node, node);
 		assert(node->type == TYPE_BLOCK ||
 		       node->type == TYPE_STMT);
-		if (strcasecmp(name, node->u.nterm.name) == 0) {
-			node->found = true;
-			return node;
+		node->u.nterm.next_same = NULL;
+		for (i = config_name_hash(node->u.nterm.name); ; i++) {
+			slot = blk->u.nterm.index[i & blk->u.nterm.index_mask];
+			if (slot == NULL) {
+				blk->u.nterm.index[i & blk->u.nterm.index_mask]
+					= node;
+				break;
+			}
+			if (strcasecmp(slot->u.nterm.name,
+				       node->u.nterm.name) == 0) {
+				while (slot->u.nterm.next_same != NULL)
+					slot = slot->u.nterm.next_same;
+				slot->u.nterm.next_same = node;
+				break;
+			}
 		}
 	}
-	return NULL;
 }
 
 /**
- * @brief Lookup the next node in list
+ * @brief Lookup the first node in the block by this name
  *
- * @param list - head of the glist
- * @param start - continue the lookup from here
+ * @param blk - the block
  * @param name - node name of interest
  *
  * @return first matching node or NULL
  */
 
-
-static struct config_node *lookup_next_node(struct glist_head *list,
-				     struct glist_head *start,
-				     const char *name)
+static struct config_node *lookup_node(struct config_node *blk,
+				       const char *name)
 {
 	struct config_node *node;
-	struct glist_head *ns;
+	uint32_t i;
 
-	glist_for_each_next(start, ns, list) {
-		node = glist_entry(ns, struct config_node, node);
-		assert(node->type == TYPE_BLOCK ||
-		       node->type == TYPE_STMT);
+	if (blk->u.nterm.index == NULL)
+		index_sub_nodes(blk);
+
+	for (i = config_name_hash(name); ; i++) {
+		node = blk->u.nterm.index[i & blk->u.nterm.index_mask];
+		if (node == NULL)
+			return NULL;
 		if (strcasecmp(name, node->u.nterm.name) == 0) {
 			node->found = true;
 			return node;
 		}
 	}
-	return NULL;
+}
+
+/**
+ * @brief Lookup the next node in the block of the same name
+ *
+ * @param node - continue the lookup from here
+ *
+ * @return next matching node or NULL
+ */
+
+static struct config_node *lookup_next_node(struct config_node *node)
+{
+	node = node->u.nterm.next_same;
+	if (node != NULL)
+		node->found = true;
+	return node;
 }
 
 static const char *config_type_str(enum config_type type)
@@ -956,7 +989,7 @@ static int do_block_load(struct config_node *blk,
 		bool bool_val;
 		uint32_t num32;
 
-		node = lookup_node(&blk->u.nterm.sub_nodes, item->name);
+		node = lookup_node(blk, item->name);
 		if ((item->flags & CONFIG_MANDATORY) && (node == NULL)) {
 			err_type->missing = true;
 			errors = ++err_type->errors;
@@ -966,8 +999,7 @@ static int do_block_load(struct config_node *blk,
 			continue;
 		}
 		while (node != NULL) {
-			next_node = lookup_next_node(&blk->u.nterm.sub_nodes,
-						     &node->node, item->name);
+			next_node = lookup_next_node(node);
 			if (next_node != NULL &&
 			    (item->flags & CONFIG_UNIQUE)) {
 				config_proc_error(next_node, err_type,
@@ -1784,6 +1816,96 @@ out:
 	return rc;
 }
 
+static uint64_t digest_str(uint64_t hash, const char *str, bool fold)
+{
+	const unsigned char *p = (const unsigned char *)str;
+
+	/* FNV-1a, the terminating NUL included to separate strings */
+	if (p != NULL) {
+		for (; *p != '\0'; p++) {
+			hash ^= fold ? tolower(*p) : *p;
+			hash *= 1099511628211ULL;
+		}
+	}
+	return hash * 1099511628211ULL;
+}
+
+static uint64_t digest_node(uint64_t hash, struct config_node *node)
+{
+	struct glist_head *ns;
+
+	hash = digest_str(hash, node->type == TYPE_BLOCK ? "{" :
+			  node->type == TYPE_STMT ? "=" : "", false);
+
+	if (node->type == TYPE_TERM) {
+		hash ^= node->u.term.type;
+		hash *= 1099511628211ULL;
+		hash = digest_str(hash, node->u.term.op_code, false);
+		return digest_str(hash, node->u.term.varvalue, false);
+	}
+
+	/* Block and parameter names are matched ignoring case */
+	hash = digest_str(hash, node->u.nterm.name, true);
+	glist_for_each(ns, &node->u.nterm.sub_nodes)
+		hash = digest_node(hash,
+				   glist_entry(ns, struct config_node, node));
+
+	return digest_str(hash, "}", false);
+}
+
+/**
+ * @brief Fingerprint a block of the parse tree
+ *
+ * Two blocks with the same names, parameters and values, in the same
+ * order, get the same digest wherever they came from.  File names and
+ * line numbers are not part of it.
+ *
+ * @param tree_node [IN] A CONFIG_BLOCK node in the parse tree
+ * @param seed      [IN] Starting value, to fold in other blocks
+ *
+ * @return The digest, never 0.
+ */
+
+uint64_t config_block_digest(void *tree_node, uint64_t seed)
+{
+	uint64_t hash;
+
+	hash = digest_node(seed ^ 14695981039346656037ULL,
+			   (struct config_node *)tree_node);
+
+	return hash != 0 ? hash : 1;
+}
+
+/**
+ * @brief Find the value of a parameter in a block
+ *
+ * @param tree_node [IN] A CONFIG_BLOCK node in the parse tree
+ * @param name      [IN] Parameter name, matched ignoring case
+ *
+ * @return The first value of the first such parameter, or NULL.
+ */
+
+const char *config_block_value(void *tree_node, const char *name)
+{
+	struct config_node *node = tree_node;
+	struct config_node *sub_node, *term;
+	struct glist_head *ns;
+
+	assert(node->type == TYPE_BLOCK);
+	glist_for_each(ns, &node->u.nterm.sub_nodes) {
+		sub_node = glist_entry(ns, struct config_node, node);
+		if (sub_node->type != TYPE_STMT ||
+		    strcasecmp(sub_node->u.nterm.name, name) != 0)
+			continue;
+		term = glist_first_entry(&sub_node->u.nterm.sub_nodes,
+					 struct config_node, node);
+		if (term == NULL || term->type != TYPE_TERM)
+			return NULL;
+		return term->u.term.varvalue;
+	}
+	return NULL;
+}
+
 /**
  * @brief Fill configuration structure from a parse tree node
  *
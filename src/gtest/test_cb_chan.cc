@@ -0,0 +1,227 @@
+// -*- mode:C; tab-width:8; c-basic-offset:2; indent-tabs-mode:t -*-
+// vim: ts=8 sw=2 smarttab
+/*
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 3 of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA
+ * 02110-1301 USA
+ *
+ * -------------
+ */
+
+/*
+ * The per channel callback queue when calls fail: a back channel
+ * without a client refuses a submit, and calls queued behind one in
+ * flight fail through their hooks once it is done.  Either way the
+ * channel must end up idle, not busy forever.  Calls go through the
+ * worker pool of the server started here; no client is needed.
+ */
+
+#include <sys/types.h>
+#include <iostream>
+#include <chrono>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include "gtest/gtest.h"
+#include <boost/program_options.hpp>
+
+extern "C" {
+/* Ganesha headers */
+#include "nfs_lib.h"
+#include "nfs_core.h"
+#include "nfs_rpc_callback.h"
+}
+
+namespace {
+
+  char* ganesha_conf = nullptr;
+  char* lpath = nullptr;
+  int dlevel = -1;
+
+  rpc_call_channel_t chan;
+
+  std::mutex hook_mtx;
+  std::condition_variable hook_cv;
+  uint32_t completed, aborted;
+
+  int ganesha_server() {
+    return nfs_libmain(
+      ganesha_conf,
+      lpath,
+      dlevel
+      );
+  }
+
+  int32_t count_hook(rpc_call_t *call, rpc_call_hook hook, void *arg,
+		     uint32_t flags)
+  {
+    std::lock_guard<std::mutex> guard(hook_mtx);
+
+    if (hook == RPC_CALL_ABORT)
+      aborted++;
+    else
+      completed++;
+    free_rpc_call(call);
+    hook_cv.notify_all();
+    return 0;
+  }
+
+  rpc_call_t *make_call()
+  {
+    rpc_call_t *call = alloc_rpc_call();
+
+    call->chan = &chan;
+    cb_compound_init_v4(&call->cbt, 1, 1, 0, (char *) "gtest", 5);
+    call->call_hook = count_hook;
+    return call;
+  }
+
+  bool wait_hooks(uint32_t n)
+  {
+    std::unique_lock<std::mutex> lock(hook_mtx);
+
+    return hook_cv.wait_for(lock, std::chrono::seconds(10), [n] {
+	return completed + aborted >= n;
+      });
+  }
+
+  bool chan_busy()
+  {
+    /* the queue lock is private, the calls are done by now */
+    return chan.busy || !glist_empty(&chan.pending);
+  }
+
+} /* namespace */
+
+TEST(CB_CHAN, INIT)
+{
+  /* A back channel whose client is gone */
+  memset(&chan, 0, sizeof(chan));
+  chan.type = RPC_CHAN_V41;
+  PTHREAD_MUTEX_init(&chan.mtx, NULL);
+  glist_init(&chan.pending);
+}
+
+TEST(CB_CHAN, SUBMIT_FAILS)
+{
+  rpc_call_t *call = make_call();
+
+  EXPECT_EQ(nfs_rpc_submit_call(call, NULL, NFS_RPC_FLAG_NONE),
+	    ENOTCONN);
+  EXPECT_FALSE(chan_busy());
+
+  /* the caller still owns a call that was not sent */
+  free_rpc_call(call);
+}
+
+TEST(CB_CHAN, QUEUED_CALLS_FAIL)
+{
+  rpc_call_t *inflight = make_call();
+
+  /* As submit leaves it with a call handed to the workers */
+  chan.busy = true;
+  inflight->flags |= NFS_RPC_CALL_CHAN_QUEUED;
+  inflight->states = NFS_CB_CALL_QUEUED;
+
+  /* These wait behind it, and are accepted */
+  EXPECT_EQ(nfs_rpc_submit_call(make_call(), NULL, NFS_RPC_FLAG_NONE), 0);
+  EXPECT_EQ(nfs_rpc_submit_call(make_call(), NULL, NFS_RPC_FLAG_NONE), 0);
+
+  /* The call in flight finds no client, each one after it in turn */
+  nfs_rpc_dispatch_call(inflight, NFS_RPC_CALL_NONE);
+
+  ASSERT_TRUE(wait_hooks(3));
+  EXPECT_EQ(aborted, 3U);
+  EXPECT_EQ(completed, 0U);
+  EXPECT_FALSE(chan_busy());
+}
+
+TEST(CB_CHAN, NOT_STUCK)
+{
+  rpc_call_t *call = make_call();
+
+  /* Still refused at once, not parked behind a busy flag */
+  EXPECT_EQ(nfs_rpc_submit_call(call, NULL, NFS_RPC_FLAG_NONE),
+	    ENOTCONN);
+  EXPECT_FALSE(chan_busy());
+  free_rpc_call(call);
+}
+
+TEST(CB_CHAN, CLEANUP)
+{
+  PTHREAD_MUTEX_destroy(&chan.mtx);
+}
+
+int main(int argc, char *argv[])
+{
+  int code = 0;
+
+  using namespace std;
+  using namespace std::literals;
+  namespace po = boost::program_options;
+
+  po::options_description opts("program options");
+  po::variables_map vm;
+
+  try {
+
+    opts.add_options()
+      ("config", po::value<string>(),
+	"path to Ganesha conf file")
+
+      ("logfile", po::value<string>(),
+	"log to the provided file path")
+
+      ("debug", po::value<string>(),
+	"ganesha debug level")
+      ;
+
+    po::variables_map::iterator vm_iter;
+    po::store(po::parse_command_line(argc, argv, opts), vm);
+    po::notify(vm);
+
+    // use config vars--leaves them on the stack
+    vm_iter = vm.find("config");
+    if (vm_iter != vm.end()) {
+      ganesha_conf = (char*) vm_iter->second.as<std::string>().c_str();
+    }
+    vm_iter = vm.find("logfile");
+    if (vm_iter != vm.end()) {
+      lpath = (char*) vm_iter->second.as<std::string>().c_str();
+    }
+    vm_iter = vm.find("debug");
+    if (vm_iter != vm.end()) {
+      dlevel = ReturnLevelAscii(
+	(char*) vm_iter->second.as<std::string>().c_str());
+    }
+
+    ::testing::InitGoogleTest(&argc, argv);
+
+    std::thread ganesha(ganesha_server);
+    std::this_thread::sleep_for(5s);
+
+    code  = RUN_ALL_TESTS();
+    ganesha.join();
+  }
+
+  catch(po::error& e) {
+    cout << "Error parsing opts " << e.what() << endl;
+  }
+
+  catch(...) {
+    cout << "Unhandled exception in main()" << endl;
+  }
+
+  return code;
+}
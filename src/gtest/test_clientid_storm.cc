@@ -0,0 +1,265 @@
+// -*- mode:C; tab-width:8; c-basic-offset:2; indent-tabs-mode:t -*-
+// vim: ts=8 sw=2 smarttab
+/*
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 3 of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA
+ * 02110-1301 USA
+ *
+ * -------------
+ */
+
+/*
+ * Mass-remount driver: N simulated clients each run the SAL side of
+ * EXCHANGE_ID, CREATE_SESSION and RECLAIM_COMPLETE against the
+ * in-process clientid tables, spread over a number of worker threads.
+ */
+
+#include <sys/types.h>
+#include <arpa/inet.h>
+#include <iostream>
+#include <vector>
+#include <mutex>
+#include <set>
+#include <chrono>
+#include <thread>
+#include "gtest/gtest.h"
+#include <boost/program_options.hpp>
+
+extern "C" {
+/* Ganesha headers */
+#include "nfs_lib.h"
+#include "nfs_core.h"
+#include "sal_data.h"
+#include "sal_functions.h"
+#include "client_mgr.h"
+#include "fsal.h"
+}
+
+namespace {
+
+  char* ganesha_conf = nullptr;
+  char* lpath = nullptr;
+  int dlevel = -1;
+  uint32_t nclients = 10000;
+  uint32_t nthreads = 16;
+
+  std::mutex ids_mtx;
+  std::set<clientid4> ids;
+
+  int ganesha_server() {
+    /* XXX */
+    return nfs_libmain(
+      ganesha_conf,
+      lpath,
+      dlevel
+      );
+  }
+
+  void storm_worker(uint32_t thread, uint32_t first, uint32_t count,
+		    uint32_t *failures)
+  {
+    struct req_op_context req_ctx;
+    struct user_cred user_credentials;
+    sockaddr_t addr;
+    struct sockaddr_in *sin = (struct sockaddr_in *) &addr;
+    nfs_client_cred_t cred;
+    std::vector<clientid4> mine;
+
+    memset(&req_ctx, 0, sizeof(req_ctx));
+    memset(&user_credentials, 0, sizeof(user_credentials));
+    memset(&addr, 0, sizeof(addr));
+    memset(&cred, 0, sizeof(cred));
+
+    sin->sin_family = AF_INET;
+    sin->sin_addr.s_addr = htonl(0x0a000000 | thread);
+    cred.flavor = AUTH_NONE;
+
+    req_ctx.creds = &user_credentials;
+    req_ctx.client = get_gsh_client(&addr, false);
+    op_ctx = &req_ctx;
+
+    for (uint32_t i = first; i < first + count; i++) {
+      char owner[64];
+      int len = snprintf(owner, sizeof(owner), "storm-client-%u", i);
+      nfs_client_record_t *record;
+      nfs_client_id_t *unconf, *conf;
+      clientid4 clientid;
+
+      /* EXCHANGE_ID */
+      record = get_client_record(owner, len, 0, 0);
+      if (record == nullptr) {
+	(*failures)++;
+	continue;
+      }
+      PTHREAD_MUTEX_lock(&record->cr_mutex);
+      unconf = create_client_id(0, record, &cred, 1);
+      clientid = unconf->cid_clientid;
+      if (nfs_client_id_insert(unconf) != CLIENT_ID_SUCCESS) {
+	PTHREAD_MUTEX_unlock(&record->cr_mutex);
+	dec_client_record_ref(record);
+	(*failures)++;
+	continue;
+      }
+      PTHREAD_MUTEX_unlock(&record->cr_mutex);
+      dec_client_record_ref(record);
+
+      /* CREATE_SESSION */
+      if (nfs_client_id_get_unconfirmed(clientid, &unconf) !=
+	  CLIENT_ID_SUCCESS) {
+	(*failures)++;
+	continue;
+      }
+      record = unconf->cid_client_record;
+      PTHREAD_MUTEX_lock(&record->cr_mutex);
+      if (nfs_client_id_confirm(unconf, COMPONENT_CLIENTID) !=
+	  CLIENT_ID_SUCCESS)
+	(*failures)++;
+      else
+	nfs4_chk_clid(unconf);
+      PTHREAD_MUTEX_unlock(&record->cr_mutex);
+      dec_client_id_ref(unconf);
+
+      /* RECLAIM_COMPLETE */
+      if (nfs_client_id_get_confirmed(clientid, &conf) !=
+	  CLIENT_ID_SUCCESS) {
+	(*failures)++;
+	continue;
+      }
+      conf->cid_cb.v41.cid_reclaim_complete = true;
+      nfs4_reclaim_complete(conf);
+      dec_client_id_ref(conf);
+
+      mine.push_back(clientid);
+    }
+
+    std::lock_guard<std::mutex> guard(ids_mtx);
+    ids.insert(mine.begin(), mine.end());
+  }
+
+} /* namespace */
+
+TEST(CLIENTID_STORM, EXCHANGE_ID_CREATE_SESSION_RECLAIM)
+{
+  std::vector<std::thread> workers;
+  std::vector<uint32_t> failures(nthreads, 0);
+  uint32_t per_thread = nclients / nthreads;
+  uint32_t total_failures = 0;
+
+  auto start = std::chrono::steady_clock::now();
+
+  for (uint32_t t = 0; t < nthreads; t++) {
+    uint32_t count = (t == nthreads - 1)
+      ? nclients - per_thread * t : per_thread;
+
+    workers.emplace_back(storm_worker, t, per_thread * t, count,
+			 &failures[t]);
+  }
+
+  for (auto& w : workers)
+    w.join();
+
+  auto elapsed = std::chrono::duration_cast<std::chrono::microseconds>(
+    std::chrono::steady_clock::now() - start).count();
+
+  for (auto f : failures)
+    total_failures += f;
+
+  std::cout << nclients << " clients, " << nthreads << " threads: "
+	    << elapsed << " us, "
+	    << (elapsed ? (uint64_t) nclients * 1000000 / elapsed : 0)
+	    << " clients/s" << std::endl;
+
+  EXPECT_EQ(total_failures, 0U);
+  /* every client must have been handed a distinct clientid */
+  EXPECT_EQ(ids.size(), (size_t) nclients);
+}
+
+int main(int argc, char *argv[])
+{
+  int code = 0;
+
+  using namespace std;
+  using namespace std::literals;
+  namespace po = boost::program_options;
+
+  po::options_description opts("program options");
+  po::variables_map vm;
+
+  try {
+
+    opts.add_options()
+      ("config", po::value<string>(),
+	"path to Ganesha conf file")
+
+      ("logfile", po::value<string>(),
+	"log to the provided file path")
+
+      ("debug", po::value<string>(),
+	"ganesha debug level")
+
+      ("clients", po::value<uint32_t>(),
+	"number of simulated clients")
+
+      ("threads", po::value<uint32_t>(),
+	"number of worker threads")
+      ;
+
+    po::variables_map::iterator vm_iter;
+    po::store(po::parse_command_line(argc, argv, opts), vm);
+    po::notify(vm);
+
+    // use config vars--leaves them on the stack
+    vm_iter = vm.find("config");
+    if (vm_iter != vm.end()) {
+      ganesha_conf = (char*) vm_iter->second.as<std::string>().c_str();
+    }
+    vm_iter = vm.find("logfile");
+    if (vm_iter != vm.end()) {
+      lpath = (char*) vm_iter->second.as<std::string>().c_str();
+    }
+    vm_iter = vm.find("debug");
+    if (vm_iter != vm.end()) {
+      dlevel = ReturnLevelAscii(
+	(char*) vm_iter->second.as<std::string>().c_str());
+    }
+    vm_iter = vm.find("clients");
+    if (vm_iter != vm.end()) {
+      nclients = vm_iter->second.as<uint32_t>();
+    }
+    vm_iter = vm.find("threads");
+    if (vm_iter != vm.end()) {
+      nthreads = vm_iter->second.as<uint32_t>();
+      if (nthreads == 0)
+	nthreads = 1;
+    }
+
+    ::testing::InitGoogleTest(&argc, argv);
+
+    std::thread ganesha(ganesha_server);
+    std::this_thread::sleep_for(5s);
+
+    code  = RUN_ALL_TESTS();
+    ganesha.join();
+  }
+
+  catch(po::error& e) {
+    cout << "Error parsing opts " << e.what() << endl;
+  }
+
+  catch(...) {
+    cout << "Unhandled exception in main()" << endl;
+  }
+
+  return code;
+}
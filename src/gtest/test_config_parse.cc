@@ -0,0 +1,229 @@
+// -*- mode:C; tab-width:8; c-basic-offset:2; indent-tabs-mode:t -*-
+// vim: ts=8 sw=2 smarttab
+/*
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 3 of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA
+ * 02110-1301 USA
+ *
+ * -------------
+ */
+
+/*
+ * Parse time against the number of EXPORT blocks: the flex/bison
+ * parse, the parse that also saves the precompiled image, and the
+ * load of that image.  No server is started.
+ */
+
+#include <sys/types.h>
+#include <cstring>
+#include <unistd.h>
+#include <iostream>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <vector>
+#include <chrono>
+#include "gtest/gtest.h"
+#include <boost/program_options.hpp>
+
+extern "C" {
+/* Ganesha headers */
+#include "abstract_mem.h"
+#include "config_parsing.h"
+#include "log.h"
+}
+
+namespace {
+
+  std::string workdir = "/tmp";
+  std::vector<uint32_t> sizes = {100, 1000, 5000};
+
+  std::string write_config(uint32_t nexports)
+  {
+    std::ostringstream path;
+    path << workdir << "/test_config_parse." << getpid() << "."
+	 << nexports << ".conf";
+    std::ofstream conf(path.str());
+
+    conf << "EXPORT_DEFAULTS\n{\n\tSecType = sys;\n}\n";
+    for (uint32_t i = 1; i <= nexports; i++) {
+      conf << "EXPORT\n{\n"
+	   << "\tExport_Id = " << i << ";\n"
+	   << "\tPath = \"/export/fs" << i << "\";\n"
+	   << "\tPseudo = \"/pseudo/fs" << i << "\";\n"
+	   << "\tAccess_Type = RW;\n"
+	   << "\tSquash = root_squash;\n"
+	   << "\tProtocols = 3, 4;\n"
+	   << "\tCLIENT\n\t{\n"
+	   << "\t\tClients = 10.0." << i / 256 << "." << i % 256
+	   << ", @netgroup" << i << ";\n"
+	   << "\t\tAccess_Type = RO;\n"
+	   << "\t}\n"
+	   << "\tFSAL\n\t{\n\t\tName = VFS;\n\t}\n"
+	   << "}\n";
+    }
+    return path.str();
+  }
+
+  config_file_t parse(const std::string &conf, const char *cache,
+		      uint64_t *ns)
+  {
+    struct config_error_type err_type;
+    config_file_t config;
+
+    EXPECT_TRUE(init_error_type(&err_type));
+    auto start = std::chrono::steady_clock::now();
+    config = config_ParseFileCached((char *) conf.c_str(), cache,
+				    &err_type);
+    *ns = std::chrono::duration_cast<std::chrono::nanoseconds>(
+      std::chrono::steady_clock::now() - start).count();
+    EXPECT_TRUE(config_error_no_error(&err_type));
+    report_config_errors(&err_type, NULL, config_errs_to_log);
+    return config;
+  }
+
+  /* fingerprint of every EXPORT block, in order */
+  uint64_t exports_digest(config_file_t config, uint32_t *count)
+  {
+    struct config_error_type err_type;
+    struct config_node_list *list = NULL, *lp, *next;
+    uint64_t digest = 0;
+
+    memset(&err_type, 0, sizeof(err_type));
+    *count = 0;
+    if (find_config_nodes(config, (char *) "EXPORT", &list,
+			  &err_type) != 0)
+      return 0;
+    for (lp = list; lp != NULL; lp = next) {
+      next = lp->next;
+      digest = config_block_digest(lp->tree_node, digest);
+      (*count)++;
+      gsh_free(lp);
+    }
+    return digest;
+  }
+
+} /* namespace */
+
+TEST(CONFIG_PARSE, PARSE_TIME)
+{
+  for (auto nexports : sizes) {
+    std::string conf = write_config(nexports);
+    std::string cache = conf + ".cache";
+    config_file_t parsed, saved, loaded;
+    uint64_t parse_ns, save_ns, load_ns;
+    uint32_t n_parsed, n_loaded;
+
+    unlink(cache.c_str());
+
+    parsed = parse(conf, nullptr, &parse_ns);
+    ASSERT_NE(parsed, nullptr);
+    saved = parse(conf, cache.c_str(), &save_ns);
+    ASSERT_NE(saved, nullptr);
+    ASSERT_EQ(access(cache.c_str(), R_OK), 0);
+    loaded = parse(conf, cache.c_str(), &load_ns);
+    ASSERT_NE(loaded, nullptr);
+
+    /* the image must give back the same tree */
+    EXPECT_EQ(exports_digest(parsed, &n_parsed),
+	      exports_digest(loaded, &n_loaded));
+    EXPECT_EQ(n_parsed, nexports);
+    EXPECT_EQ(n_loaded, nexports);
+
+    std::cout << nexports << " exports: parse " << parse_ns / 1000
+	      << " us, parse+save " << save_ns / 1000
+	      << " us, load " << load_ns / 1000 << " us" << std::endl;
+
+    config_Free(parsed);
+    config_Free(saved);
+    config_Free(loaded);
+    unlink(cache.c_str());
+    unlink(conf.c_str());
+  }
+}
+
+TEST(CONFIG_PARSE, STALE_CACHE)
+{
+  std::string conf = write_config(10);
+  std::string cache = conf + ".cache";
+  config_file_t config;
+  uint64_t ns;
+  uint32_t count;
+
+  unlink(cache.c_str());
+  config = parse(conf, cache.c_str(), &ns);
+  ASSERT_NE(config, nullptr);
+  config_Free(config);
+
+  /* a changed file must be parsed again, not loaded */
+  std::ofstream(conf, std::ios::app)
+    << "EXPORT\n{\n\tExport_Id = 11;\n\tPath = /x;\n}\n";
+  config = parse(conf, cache.c_str(), &ns);
+  ASSERT_NE(config, nullptr);
+  exports_digest(config, &count);
+  EXPECT_EQ(count, 11U);
+  config_Free(config);
+
+  unlink(cache.c_str());
+  unlink(conf.c_str());
+}
+
+int main(int argc, char *argv[])
+{
+  int code = 0;
+
+  using namespace std;
+  namespace po = boost::program_options;
+
+  po::options_description opts("program options");
+  po::variables_map vm;
+
+  try {
+
+    opts.add_options()
+      ("dir", po::value<string>(),
+	"directory for the generated config files")
+
+      ("exports", po::value<vector<uint32_t>>()->multitoken(),
+	"numbers of exports to time")
+      ;
+
+    po::variables_map::iterator vm_iter;
+    po::store(po::parse_command_line(argc, argv, opts), vm);
+    po::notify(vm);
+
+    vm_iter = vm.find("dir");
+    if (vm_iter != vm.end()) {
+      workdir = vm_iter->second.as<std::string>();
+    }
+    vm_iter = vm.find("exports");
+    if (vm_iter != vm.end()) {
+      sizes = vm_iter->second.as<vector<uint32_t>>();
+    }
+
+    ::testing::InitGoogleTest(&argc, argv);
+
+    code  = RUN_ALL_TESTS();
+  }
+
+  catch(po::error& e) {
+    cout << "Error parsing opts " << e.what() << endl;
+  }
+
+  catch(...) {
+    cout << "Unhandled exception in main()" << endl;
+  }
+
+  return code;
+}
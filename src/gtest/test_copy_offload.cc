@@ -0,0 +1,252 @@
+// -*- mode:C; tab-width:8; c-basic-offset:2; indent-tabs-mode:t -*-
+// vim: ts=8 sw=2 smarttab
+/*
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 3 of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA
+ * 02110-1301 USA
+ *
+ * -------------
+ */
+
+/*
+ * Copy throughput as a client does it, READs then WRITEs of rsize
+ * and wsize through a buffer, against the server side COPY that
+ * FSAL_VFS does with vfs_copy_range.  Both run on the backend file
+ * system of the directory given, so the client figure leaves out the
+ * network it would also cross twice.  No server is started.
+ */
+
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <cerrno>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <chrono>
+#include "gtest/gtest.h"
+#include <boost/program_options.hpp>
+
+extern "C" {
+/* Ganesha headers */
+#include "os/subr.h"
+}
+
+namespace {
+
+  std::string dir = "/tmp";
+  uint32_t size_mb = 256;
+  uint32_t iosize = 1024 * 1024;
+
+  std::string src_path, dst_path;
+  int src_fd = -1;
+
+  int open_dst()
+  {
+    int fd = open(dst_path.c_str(), O_RDWR | O_CREAT | O_TRUNC, 0600);
+
+    EXPECT_GE(fd, 0);
+    return fd;
+  }
+
+  bool same_data(int fd)
+  {
+    char *a = (char *) malloc(iosize);
+    char *b = (char *) malloc(iosize);
+    off_t off, len = (off_t) size_mb << 20;
+    bool same = true;
+
+    for (off = 0; off < len && same; off += iosize) {
+      if (pread(src_fd, a, iosize, off) != (ssize_t) iosize ||
+	  pread(fd, b, iosize, off) != (ssize_t) iosize)
+	same = false;
+      else
+	same = memcmp(a, b, iosize) == 0;
+    }
+    free(a);
+    free(b);
+    return same;
+  }
+
+  void report(const char *what, int64_t ns)
+  {
+    std::cout << what << ": " << size_mb << " MiB in " << ns / 1000000
+	      << " ms, " << (double) size_mb * 1e9 / ns << " MiB/s"
+	      << std::endl;
+  }
+
+} /* namespace */
+
+TEST(COPY_OFFLOAD, INIT)
+{
+  char *buf = (char *) malloc(iosize);
+  off_t off, len = (off_t) size_mb << 20;
+  unsigned int i;
+
+  src_path = dir + "/copy_offload_src";
+  dst_path = dir + "/copy_offload_dst";
+
+  src_fd = open(src_path.c_str(), O_RDWR | O_CREAT | O_TRUNC, 0600);
+  ASSERT_GE(src_fd, 0);
+
+  srandom(1);
+  for (off = 0; off < len; off += iosize) {
+    for (i = 0; i < iosize / sizeof(long); i++)
+      ((long *) buf)[i] = random();
+    ASSERT_EQ(pwrite(src_fd, buf, iosize, off), (ssize_t) iosize);
+  }
+  fsync(src_fd);
+  free(buf);
+}
+
+TEST(COPY_OFFLOAD, CLIENT_COPY)
+{
+  char *buf = (char *) malloc(iosize);
+  off_t off, len = (off_t) size_mb << 20;
+  int fd = open_dst();
+
+  auto start = std::chrono::steady_clock::now();
+
+  for (off = 0; off < len; off += iosize) {
+    ASSERT_EQ(pread(src_fd, buf, iosize, off), (ssize_t) iosize);
+    ASSERT_EQ(pwrite(fd, buf, iosize, off), (ssize_t) iosize);
+  }
+  fsync(fd);
+
+  report("client READ/WRITE", std::chrono::duration_cast<
+	 std::chrono::nanoseconds>(std::chrono::steady_clock::now() -
+				   start).count());
+
+  EXPECT_TRUE(same_data(fd));
+  close(fd);
+  free(buf);
+}
+
+TEST(COPY_OFFLOAD, SERVER_COPY)
+{
+  off_t off = 0, len = (off_t) size_mb << 20;
+  ssize_t n;
+  int fd = open_dst();
+
+  auto start = std::chrono::steady_clock::now();
+
+  while (off < len) {
+    n = vfs_copy_range(src_fd, off, fd, off, len - off);
+    if (n < 0 && (errno == ENOSYS || errno == EXDEV) && off == 0) {
+      std::cout << "no copy_file_range here: " << strerror(errno)
+		<< std::endl;
+      close(fd);
+      return;
+    }
+    ASSERT_GT(n, 0);
+    off += n;
+  }
+  fsync(fd);
+
+  report("server COPY", std::chrono::duration_cast<
+	 std::chrono::nanoseconds>(std::chrono::steady_clock::now() -
+				   start).count());
+
+  EXPECT_TRUE(same_data(fd));
+  close(fd);
+}
+
+TEST(COPY_OFFLOAD, SERVER_CLONE)
+{
+  off_t len = (off_t) size_mb << 20;
+  int fd = open_dst();
+
+  auto start = std::chrono::steady_clock::now();
+
+  if (vfs_clone_range(src_fd, 0, fd, 0, len) != 0) {
+    std::cout << "no reflink here: " << strerror(errno) << std::endl;
+    close(fd);
+    return;
+  }
+
+  report("server CLONE", std::chrono::duration_cast<
+	 std::chrono::nanoseconds>(std::chrono::steady_clock::now() -
+				   start).count());
+
+  EXPECT_TRUE(same_data(fd));
+  close(fd);
+}
+
+TEST(COPY_OFFLOAD, CLEANUP)
+{
+  close(src_fd);
+  unlink(src_path.c_str());
+  unlink(dst_path.c_str());
+}
+
+int main(int argc, char *argv[])
+{
+  int code = 0;
+
+  using namespace std;
+  namespace po = boost::program_options;
+
+  po::options_description opts("program options");
+  po::variables_map vm;
+
+  try {
+
+    opts.add_options()
+      ("dir", po::value<string>(),
+	"directory on the backend file system to copy in")
+
+      ("size", po::value<uint32_t>(),
+	"file size in MiB")
+
+      ("iosize", po::value<uint32_t>(),
+	"client READ and WRITE size in bytes")
+      ;
+
+    po::variables_map::iterator vm_iter;
+    po::store(po::parse_command_line(argc, argv, opts), vm);
+    po::notify(vm);
+
+    vm_iter = vm.find("dir");
+    if (vm_iter != vm.end())
+      dir = vm_iter->second.as<string>();
+    vm_iter = vm.find("size");
+    if (vm_iter != vm.end()) {
+      size_mb = vm_iter->second.as<uint32_t>();
+      if (size_mb == 0)
+	size_mb = 1;
+    }
+    vm_iter = vm.find("iosize");
+    if (vm_iter != vm.end()) {
+      iosize = vm_iter->second.as<uint32_t>();
+      /* whole I/Os per MiB keep the loops simple */
+      if (iosize == 0 || (1048576 % iosize) != 0)
+	iosize = 1048576;
+    }
+
+    ::testing::InitGoogleTest(&argc, argv);
+
+    code  = RUN_ALL_TESTS();
+  }
+
+  catch(po::error& e) {
+    cout << "Error parsing opts " << e.what() << endl;
+  }
+
+  catch(...) {
+    cout << "Unhandled exception in main()" << endl;
+  }
+
+  return code;
+}
@@ -0,0 +1,275 @@
+// -*- mode:C; tab-width:8; c-basic-offset:2; indent-tabs-mode:t -*-
+// vim: ts=8 sw=2 smarttab
+/*
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 3 of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA
+ * 02110-1301 USA
+ *
+ * -------------
+ */
+
+/*
+ * COPY of a range of a file onto itself through the copy2 FSAL method,
+ * with the source read through the file's global descriptor, open read
+ * only, and the destination written through another state.  The
+ * destination lookup has to reopen that descriptor for write; it must
+ * not wait on the lock the source lookup holds.  Meant for an FSAL_VFS
+ * export.
+ */
+
+#include <sys/types.h>
+#include <iostream>
+#include <chrono>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include "gtest/gtest.h"
+#include <boost/program_options.hpp>
+
+extern "C" {
+/* Ganesha headers */
+#include "nfs_lib.h"
+#include "export_mgr.h"
+#include "nfs_exports.h"
+#include "sal_data.h"
+#include "fsal.h"
+}
+
+#define RANGE 65536
+
+namespace {
+
+  char* ganesha_conf = nullptr;
+  char* lpath = nullptr;
+  int dlevel = -1;
+  uint16_t export_id = 77;
+
+  struct req_op_context req_ctx;
+  struct user_cred user_credentials;
+
+  struct gsh_export* a_export = nullptr;
+  struct fsal_obj_handle *root_entry = nullptr;
+  struct fsal_obj_handle *test_file = nullptr;
+  const char *test_name = "copy_same_file_test";
+
+  int ganesha_server() {
+    return nfs_libmain(
+      ganesha_conf,
+      lpath,
+      dlevel
+      );
+  }
+
+  char pattern(uint64_t i)
+  {
+    return 'a' + i % 23;
+  }
+
+} /* namespace */
+
+TEST(COPY_SAME_FILE, INIT)
+{
+  a_export = get_gsh_export(export_id);
+  ASSERT_NE(a_export, nullptr);
+
+  nfs_export_get_root_entry(a_export, &root_entry);
+  ASSERT_NE(root_entry, nullptr);
+
+  /* Ganesha call paths need real or forged context info */
+  memset(&user_credentials, 0, sizeof(struct user_cred));
+  memset(&req_ctx, 0, sizeof(struct req_op_context));
+
+  req_ctx.ctx_export = a_export;
+  req_ctx.fsal_export = a_export->fsal_export;
+  req_ctx.creds = &user_credentials;
+
+  /* stashed in tls */
+  op_ctx = &req_ctx;
+}
+
+TEST(COPY_SAME_FILE, CREATE)
+{
+  struct attrlist attrs;
+  fsal_status_t status;
+  bool caller_perm_check = false;
+  char *buffer = (char *) gsh_malloc(RANGE);
+  size_t wrote = 0;
+  bool stable = false;
+
+  memset(&attrs, 0, sizeof(attrs));
+  FSAL_SET_MASK(attrs.valid_mask, ATTR_MODE);
+  attrs.mode = 0644;
+
+  status = root_entry->obj_ops.open2(root_entry, NULL, FSAL_O_RDWR,
+				     FSAL_UNCHECKED, test_name, &attrs,
+				     NULL, &test_file, NULL,
+				     &caller_perm_check);
+  ASSERT_FALSE(FSAL_IS_ERROR(status));
+  ASSERT_NE(test_file, nullptr);
+
+  for (uint64_t i = 0; i < RANGE; i++)
+    buffer[i] = pattern(i);
+  status = test_file->obj_ops.write2(test_file, true, NULL, 0, RANGE,
+				     buffer, &wrote, &stable, NULL);
+  ASSERT_FALSE(FSAL_IS_ERROR(status));
+  EXPECT_EQ(wrote, (size_t) RANGE);
+  gsh_free(buffer);
+
+  /* Leave the global descriptor open for read only */
+  test_file->obj_ops.close(test_file);
+  memset(&attrs, 0, sizeof(attrs));
+  status = test_file->obj_ops.open2(test_file, NULL, FSAL_O_READ,
+				    FSAL_NO_CREATE, NULL, &attrs, NULL,
+				    NULL, NULL, &caller_perm_check);
+  ASSERT_FALSE(FSAL_IS_ERROR(status));
+}
+
+TEST(COPY_SAME_FILE, TWO_STATES)
+{
+  struct fsal_export *exp = a_export->fsal_export;
+  struct state_t *dst_state;
+  std::mutex mtx;
+  std::condition_variable cv;
+  bool done = false;
+  fsal_status_t status;
+  uint64_t copied = 0;
+  char *buffer = (char *) gsh_malloc(RANGE);
+  size_t read_amount = 0;
+  bool eof = false;
+
+  /* A state with no descriptor of its own, so the global one is used
+   * for both ends
+   */
+  dst_state = exp->exp_ops.alloc_state(exp, STATE_TYPE_SHARE, NULL);
+  ASSERT_NE(dst_state, nullptr);
+
+  std::thread copier([&]() {
+      op_ctx = &req_ctx;
+      status = test_file->obj_ops.copy2(test_file, NULL, 0, test_file,
+					dst_state, RANGE, RANGE, &copied);
+      std::lock_guard<std::mutex> guard(mtx);
+      done = true;
+      cv.notify_all();
+    });
+
+  {
+    std::unique_lock<std::mutex> lock(mtx);
+
+    if (!cv.wait_for(lock, std::chrono::seconds(10),
+		     [&] { return done; })) {
+      /* Stuck on its own lock, it will never return */
+      copier.detach();
+      FAIL() << "copy2 of a file onto itself did not return";
+    }
+  }
+  copier.join();
+
+  ASSERT_FALSE(FSAL_IS_ERROR(status));
+  EXPECT_EQ(copied, (uint64_t) RANGE);
+
+  status = test_file->obj_ops.read2(test_file, true, NULL, RANGE, RANGE,
+				    buffer, &read_amount, &eof, NULL);
+  ASSERT_FALSE(FSAL_IS_ERROR(status));
+  EXPECT_EQ(read_amount, (size_t) RANGE);
+  for (uint64_t i = 0; i < read_amount; i++) {
+    if (buffer[i] != pattern(i)) {
+      ADD_FAILURE() << "copied data differs at " << i;
+      break;
+    }
+  }
+
+  exp->exp_ops.free_state(exp, dst_state);
+  gsh_free(buffer);
+}
+
+TEST(COPY_SAME_FILE, CLEANUP)
+{
+  fsal_status_t status;
+
+  test_file->obj_ops.close(test_file);
+  status = root_entry->obj_ops.unlink(root_entry, test_file, test_name);
+  EXPECT_FALSE(FSAL_IS_ERROR(status));
+  test_file->obj_ops.put_ref(test_file);
+  test_file = nullptr;
+}
+
+int main(int argc, char *argv[])
+{
+  int code = 0;
+
+  using namespace std;
+  using namespace std::literals;
+  namespace po = boost::program_options;
+
+  po::options_description opts("program options");
+  po::variables_map vm;
+
+  try {
+
+    opts.add_options()
+      ("config", po::value<string>(),
+	"path to Ganesha conf file")
+
+      ("logfile", po::value<string>(),
+	"log to the provided file path")
+
+      ("export", po::value<uint16_t>(),
+	"id of export on which to operate (must exist)")
+
+      ("debug", po::value<string>(),
+	"ganesha debug level")
+      ;
+
+    po::variables_map::iterator vm_iter;
+    po::store(po::parse_command_line(argc, argv, opts), vm);
+    po::notify(vm);
+
+    // use config vars--leaves them on the stack
+    vm_iter = vm.find("config");
+    if (vm_iter != vm.end()) {
+      ganesha_conf = (char*) vm_iter->second.as<std::string>().c_str();
+    }
+    vm_iter = vm.find("logfile");
+    if (vm_iter != vm.end()) {
+      lpath = (char*) vm_iter->second.as<std::string>().c_str();
+    }
+    vm_iter = vm.find("debug");
+    if (vm_iter != vm.end()) {
+      dlevel = ReturnLevelAscii(
+	(char*) vm_iter->second.as<std::string>().c_str());
+    }
+    vm_iter = vm.find("export");
+    if (vm_iter != vm.end()) {
+      export_id = vm_iter->second.as<uint16_t>();
+    }
+
+    ::testing::InitGoogleTest(&argc, argv);
+
+    std::thread ganesha(ganesha_server);
+    std::this_thread::sleep_for(5s);
+
+    code  = RUN_ALL_TESTS();
+    ganesha.join();
+  }
+
+  catch(po::error& e) {
+    cout << "Error parsing opts " << e.what() << endl;
+  }
+
+  catch(...) {
+    cout << "Unhandled exception in main()" << endl;
+  }
+
+  return code;
+}
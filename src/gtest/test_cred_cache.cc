@@ -0,0 +1,295 @@
+// -*- mode:C; tab-width:8; c-basic-offset:2; indent-tabs-mode:t -*-
+// vim: ts=8 sw=2 smarttab
+/*
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 3 of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA
+ * 02110-1301 USA
+ *
+ * -------------
+ */
+
+/*
+ * Per-op cost of export access and credential evaluation for an
+ * AUTH_SYS request, with and without the per-connection cred cache,
+ * and the same credential used on two exports in turn, which must hit
+ * for both.
+ */
+
+#include <sys/types.h>
+#include <arpa/inet.h>
+#include <iostream>
+#include <chrono>
+#include <thread>
+#include "gtest/gtest.h"
+#include <boost/program_options.hpp>
+
+extern "C" {
+/* Ganesha headers */
+#include "nfs_lib.h"
+#include "nfs_core.h"
+#include "nfs_creds.h"
+#include "nfs_exports.h"
+#include "export_mgr.h"
+#include "client_mgr.h"
+#include "fsal.h"
+}
+
+namespace {
+
+  char* ganesha_conf = nullptr;
+  char* lpath = nullptr;
+  int dlevel = -1;
+  uint16_t export_id = 77;
+  uint16_t export_id2 = 78;
+  uint32_t nops = 1000000;
+
+  struct req_op_context req_ctx;
+  struct user_cred user_credentials;
+  struct export_perms export_perms;
+  struct svc_req req;
+  sockaddr_t caller;
+  gid_t gids[8] = {100, 101, 102, 103, 104, 105, 106, 107};
+
+  struct gsh_export* a_export = nullptr;
+  struct gsh_export* b_export = nullptr;
+
+  int ganesha_server() {
+    /* XXX */
+    return nfs_libmain(
+      ganesha_conf,
+      lpath,
+      dlevel
+      );
+  }
+
+  uint64_t run_ops(struct nfs_cred_cache *cache, uint32_t *failures)
+  {
+    auto start = std::chrono::steady_clock::now();
+
+    for (uint32_t i = 0; i < nops; i++) {
+      init_credentials();
+      if (!nfs_cred_cache_get(cache, &req))
+	export_check_access();
+      if (nfs_req_creds(&req) != NFS4_OK)
+	(*failures)++;
+      else
+	nfs_cred_cache_put(cache, &req);
+      clean_credentials();
+    }
+
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(
+      std::chrono::steady_clock::now() - start).count();
+  }
+
+  void use_export(struct gsh_export *exp)
+  {
+    req_ctx.ctx_export = exp;
+    req_ctx.fsal_export = exp->fsal_export;
+  }
+
+} /* namespace */
+
+TEST(CRED_CACHE, INIT)
+{
+  struct sockaddr_in *sin = (struct sockaddr_in *) &caller;
+  struct authunix_parms *aup;
+
+  a_export = get_gsh_export(export_id);
+  ASSERT_NE(a_export, nullptr);
+
+  memset(&user_credentials, 0, sizeof(user_credentials));
+  memset(&export_perms, 0, sizeof(export_perms));
+  memset(&req_ctx, 0, sizeof(req_ctx));
+  memset(&req, 0, sizeof(req));
+  memset(&caller, 0, sizeof(caller));
+
+  sin->sin_family = AF_INET;
+  sin->sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+
+  req.rq_msg.cb_prog = nfs_param.core_param.program[P_NFS];
+  req.rq_msg.cb_vers = NFS_V4;
+  req.rq_msg.cb_cred.oa_flavor = AUTH_SYS;
+  aup = (struct authunix_parms *) req.rq_msg.rq_cred_body;
+  aup->aup_uid = 1000;
+  aup->aup_gid = 100;
+  aup->aup_len = sizeof(gids) / sizeof(gids[0]);
+  aup->aup_gids = gids;
+
+  req_ctx.ctx_export = a_export;
+  req_ctx.fsal_export = a_export->fsal_export;
+  req_ctx.creds = &user_credentials;
+  req_ctx.export_perms = &export_perms;
+  req_ctx.caller_addr = &caller;
+  req_ctx.client = get_gsh_client(&caller, false);
+  req_ctx.nfs_vers = NFS_V4;
+
+  /* stashed in tls */
+  op_ctx = &req_ctx;
+}
+
+TEST(CRED_CACHE, PER_OP_COST)
+{
+  struct nfs_cred_cache *cache = nfs_cred_cache_alloc();
+  uint32_t failures = 0;
+  uint64_t uncached, cached;
+  uid_t uid, uid_cached;
+
+  uncached = run_ops(nullptr, &failures);
+  init_credentials();
+  export_check_access();
+  ASSERT_EQ(nfs_req_creds(&req), NFS4_OK);
+  uid = user_credentials.caller_uid;
+  clean_credentials();
+
+  cached = run_ops(cache, &failures);
+  init_credentials();
+  ASSERT_TRUE(nfs_cred_cache_get(cache, &req));
+  ASSERT_EQ(nfs_req_creds(&req), NFS4_OK);
+  uid_cached = user_credentials.caller_uid;
+  clean_credentials();
+
+  nfs_cred_cache_free(cache);
+
+  std::cout << nops << " ops: uncached " << uncached / nops
+	    << " ns/op, cached " << cached / nops << " ns/op" << std::endl;
+
+  EXPECT_EQ(failures, 0U);
+  /* the cache must not change the mapped credentials */
+  EXPECT_EQ(uid, uid_cached);
+}
+
+TEST(CRED_CACHE, TWO_EXPORTS)
+{
+  struct nfs_cred_cache *cache = nfs_cred_cache_alloc();
+  struct gsh_export *exports[2];
+  uint32_t i, hits = 0;
+
+  b_export = get_gsh_export(export_id2);
+  ASSERT_NE(b_export, nullptr);
+  exports[0] = a_export;
+  exports[1] = b_export;
+
+  /* The same credential fills an entry for each export */
+  for (i = 0; i < 2; i++) {
+    use_export(exports[i]);
+    init_credentials();
+    ASSERT_FALSE(nfs_cred_cache_get(cache, &req));
+    export_check_access();
+    ASSERT_EQ(nfs_req_creds(&req), NFS4_OK);
+    nfs_cred_cache_put(cache, &req);
+    clean_credentials();
+  }
+
+  /* and alternating between them, neither evicts the other */
+  for (i = 0; i < 1000; i++) {
+    use_export(exports[i % 2]);
+    init_credentials();
+    if (nfs_cred_cache_get(cache, &req))
+      hits++;
+    EXPECT_EQ(nfs_req_creds(&req), NFS4_OK);
+    clean_credentials();
+  }
+
+  EXPECT_EQ(hits, 1000U);
+
+  use_export(a_export);
+  put_gsh_export(b_export);
+  nfs_cred_cache_free(cache);
+}
+
+int main(int argc, char *argv[])
+{
+  int code = 0;
+
+  using namespace std;
+  using namespace std::literals;
+  namespace po = boost::program_options;
+
+  po::options_description opts("program options");
+  po::variables_map vm;
+
+  try {
+
+    opts.add_options()
+      ("config", po::value<string>(),
+	"path to Ganesha conf file")
+
+      ("logfile", po::value<string>(),
+	"log to the provided file path")
+
+      ("export", po::value<uint16_t>(),
+	"id of export on which to operate (must exist)")
+
+      ("export2", po::value<uint16_t>(),
+	"id of a second export the client may access (must exist)")
+
+      ("debug", po::value<string>(),
+	"ganesha debug level")
+
+      ("ops", po::value<uint32_t>(),
+	"number of operations per run")
+      ;
+
+    po::variables_map::iterator vm_iter;
+    po::store(po::parse_command_line(argc, argv, opts), vm);
+    po::notify(vm);
+
+    // use config vars--leaves them on the stack
+    vm_iter = vm.find("config");
+    if (vm_iter != vm.end()) {
+      ganesha_conf = (char*) vm_iter->second.as<std::string>().c_str();
+    }
+    vm_iter = vm.find("logfile");
+    if (vm_iter != vm.end()) {
+      lpath = (char*) vm_iter->second.as<std::string>().c_str();
+    }
+    vm_iter = vm.find("debug");
+    if (vm_iter != vm.end()) {
+      dlevel = ReturnLevelAscii(
+	(char*) vm_iter->second.as<std::string>().c_str());
+    }
+    vm_iter = vm.find("export");
+    if (vm_iter != vm.end()) {
+      export_id = vm_iter->second.as<uint16_t>();
+    }
+    vm_iter = vm.find("export2");
+    if (vm_iter != vm.end()) {
+      export_id2 = vm_iter->second.as<uint16_t>();
+    }
+    vm_iter = vm.find("ops");
+    if (vm_iter != vm.end()) {
+      nops = vm_iter->second.as<uint32_t>();
+      if (nops == 0)
+	nops = 1;
+    }
+
+    ::testing::InitGoogleTest(&argc, argv);
+
+    std::thread ganesha(ganesha_server);
+    std::this_thread::sleep_for(5s);
+
+    code  = RUN_ALL_TESTS();
+    ganesha.join();
+  }
+
+  catch(po::error& e) {
+    cout << "Error parsing opts " << e.what() << endl;
+  }
+
+  catch(...) {
+    cout << "Unhandled exception in main()" << endl;
+  }
+
+  return code;
+}
@@ -0,0 +1,328 @@
+// -*- mode:C; tab-width:8; c-basic-offset:2; indent-tabs-mode:t -*-
+// vim: ts=8 sw=2 smarttab
+/*
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 3 of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA
+ * 02110-1301 USA
+ *
+ * -------------
+ */
+
+/*
+ * Export reload by EXPORT block digest: unchanged blocks are skipped,
+ * changed ones applied, exports whose block is gone removed, and an
+ * export updated over DBus in between is reapplied by the next reload
+ * and still removed once its block goes.  The server is started on a
+ * config of FSAL_MEM exports written here, and reloads call
+ * reread_exports as SIGHUP does.
+ */
+
+#include <sys/types.h>
+#include <unistd.h>
+#include <cstring>
+#include <iostream>
+#include <fstream>
+#include <sstream>
+#include <set>
+#include <string>
+#include <chrono>
+#include <thread>
+#include "gtest/gtest.h"
+#include <boost/program_options.hpp>
+
+extern "C" {
+/* Ganesha headers */
+#include "nfs_lib.h"
+#include "nfs_exports.h"
+#include "export_mgr.h"
+#include "config_parsing.h"
+}
+
+namespace {
+
+  char* lpath = nullptr;
+  int dlevel = -1;
+  std::string workdir = "/tmp";
+  std::string conf_path;
+  uint16_t base_id = 100;
+  uint32_t nexports = 5;
+
+  int ganesha_server() {
+    return nfs_libmain(
+      (char *) conf_path.c_str(),
+      lpath,
+      dlevel
+      );
+  }
+
+  /* base_id onwards, but for those in removed; ro is read only */
+  std::string write_config(const std::string &name,
+			   const std::set<uint16_t> &removed,
+			   uint16_t ro)
+  {
+    std::string path = workdir + "/test_export_reload." +
+      std::to_string(getpid()) + "." + name + ".conf";
+    std::ofstream conf(path);
+
+    conf << "EXPORT_DEFAULTS\n{\n\tSecType = sys;\n}\n";
+    for (uint16_t id = base_id; id < base_id + nexports; id++) {
+      if (removed.count(id) != 0)
+	continue;
+      conf << "EXPORT\n{\n"
+	   << "\tExport_Id = " << id << ";\n"
+	   << "\tPath = \"/reload" << id << "\";\n"
+	   << "\tPseudo = \"/reload" << id << "\";\n"
+	   << "\tAccess_Type = " << (id == ro ? "RO" : "RW") << ";\n"
+	   << "\tProtocols = 4;\n"
+	   << "\tFSAL\n\t{\n\t\tName = MEM;\n\t}\n"
+	   << "}\n";
+    }
+    return path;
+  }
+
+  /* what a SIGHUP does, returning the stats of that reload */
+  struct export_reload_stats reload(const std::string &path)
+  {
+    struct config_error_type err_type;
+    struct export_reload_stats st;
+    config_file_t config;
+
+    memset(&st, 0, sizeof(st));
+    EXPECT_TRUE(init_error_type(&err_type));
+    config = config_ParseFile((char *) path.c_str(), &err_type);
+    EXPECT_NE(config, nullptr);
+    if (config == nullptr)
+      return st;
+    EXPECT_GE(reread_exports(config, &err_type), 0);
+    config_Free(config);
+    export_reload_get_stats(&st);
+    return st;
+  }
+
+  /* what the UpdateExport DBus method does */
+  void dbus_update(const std::string &path, uint16_t id)
+  {
+    struct config_error_type err_type;
+    struct config_node_list *list = nullptr, *lp, *next;
+    std::string expr = "EXPORT(Export_Id=" + std::to_string(id) + ")";
+    config_file_t config;
+
+    ASSERT_TRUE(init_error_type(&err_type));
+    config = config_ParseFile((char *) path.c_str(), &err_type);
+    ASSERT_NE(config, nullptr);
+    ASSERT_EQ(find_config_nodes(config, (char *) expr.c_str(), &list,
+				&err_type), 0);
+    for (lp = list; lp != nullptr; lp = next) {
+      next = lp->next;
+      EXPECT_GE(load_config_from_node(lp->tree_node, &update_export_param,
+				      NULL, false, &err_type), 0);
+      gsh_free(lp);
+    }
+    config_Free(config);
+  }
+
+  uint64_t digest_of(uint16_t id)
+  {
+    struct gsh_export *exp = get_gsh_export(id);
+    uint64_t digest;
+
+    EXPECT_NE(exp, nullptr);
+    if (exp == nullptr)
+      return 0;
+    digest = atomic_fetch_uint64_t(&exp->config_digest);
+    put_gsh_export(exp);
+    return digest;
+  }
+
+  bool exists(uint16_t id)
+  {
+    struct gsh_export *exp = get_gsh_export(id);
+
+    if (exp == nullptr)
+      return false;
+    put_gsh_export(exp);
+    return true;
+  }
+
+} /* namespace */
+
+TEST(EXPORT_RELOAD, INIT)
+{
+  for (uint16_t id = base_id; id < base_id + nexports; id++) {
+    EXPECT_TRUE(exists(id));
+    EXPECT_NE(digest_of(id), 0U);
+  }
+}
+
+TEST(EXPORT_RELOAD, UNCHANGED)
+{
+  struct export_reload_stats st = reload(conf_path);
+
+  EXPECT_EQ(st.unchanged, nexports);
+  EXPECT_EQ(st.updated, 0U);
+  EXPECT_EQ(st.added, 0U);
+  EXPECT_EQ(st.removed, 0U);
+  EXPECT_EQ(st.failed, 0U);
+}
+
+TEST(EXPORT_RELOAD, CHANGED)
+{
+  uint16_t id = base_id + 1;
+  uint64_t before = digest_of(id);
+  std::string path = write_config("changed", {}, id);
+  struct export_reload_stats st = reload(path);
+  struct gsh_export *exp;
+
+  EXPECT_EQ(st.updated, 1U);
+  EXPECT_EQ(st.unchanged, nexports - 1);
+  EXPECT_EQ(st.removed, 0U);
+  EXPECT_NE(digest_of(id), before);
+
+  exp = get_gsh_export(id);
+  ASSERT_NE(exp, nullptr);
+  EXPECT_EQ(exp->export_perms.options & EXPORT_OPTION_WRITE_ACCESS, 0U);
+  put_gsh_export(exp);
+
+  /* and back */
+  st = reload(conf_path);
+  EXPECT_EQ(st.updated, 1U);
+  EXPECT_EQ(digest_of(id), before);
+  unlink(path.c_str());
+}
+
+TEST(EXPORT_RELOAD, DBUS_TOUCHED)
+{
+  uint16_t id = base_id + 2;
+  uint64_t before = digest_of(id);
+  struct export_reload_stats st;
+
+  /* The same block, but the reload can't know what DBus applied */
+  dbus_update(conf_path, id);
+  EXPECT_EQ(digest_of(id), 0U);
+
+  st = reload(conf_path);
+  EXPECT_EQ(st.updated, 1U);
+  EXPECT_EQ(st.unchanged, nexports - 1);
+  EXPECT_EQ(st.removed, 0U);
+  EXPECT_EQ(digest_of(id), before);
+}
+
+TEST(EXPORT_RELOAD, REMOVED)
+{
+  uint16_t touched = base_id + 3, gone = base_id + 4;
+  std::string path = write_config("removed", {touched, gone}, 0);
+  struct export_reload_stats st;
+
+  /* Updated over DBus, it still came from the config file */
+  dbus_update(conf_path, touched);
+
+  st = reload(path);
+  EXPECT_EQ(st.removed, 2U);
+  EXPECT_EQ(st.unchanged, nexports - 2);
+  EXPECT_FALSE(exists(touched));
+  EXPECT_FALSE(exists(gone));
+  EXPECT_TRUE(exists(base_id));
+
+  /* and they come back as new exports */
+  st = reload(conf_path);
+  EXPECT_EQ(st.added, 2U);
+  EXPECT_EQ(st.unchanged, nexports - 2);
+  EXPECT_TRUE(exists(touched));
+  EXPECT_TRUE(exists(gone));
+  unlink(path.c_str());
+}
+
+int main(int argc, char *argv[])
+{
+  int code = 0;
+
+  using namespace std;
+  using namespace std::literals;
+  namespace po = boost::program_options;
+
+  po::options_description opts("program options");
+  po::variables_map vm;
+
+  try {
+
+    opts.add_options()
+      ("dir", po::value<string>(),
+	"directory for the config files")
+
+      ("logfile", po::value<string>(),
+	"log to the provided file path")
+
+      ("debug", po::value<string>(),
+	"ganesha debug level")
+
+      ("base_id", po::value<uint16_t>(),
+	"Export_Id of the first export")
+
+      ("exports", po::value<uint32_t>(),
+	"number of exports, at least 5")
+      ;
+
+    po::variables_map::iterator vm_iter;
+    po::store(po::parse_command_line(argc, argv, opts), vm);
+    po::notify(vm);
+
+    // use config vars--leaves them on the stack
+    vm_iter = vm.find("dir");
+    if (vm_iter != vm.end()) {
+      workdir = vm_iter->second.as<std::string>();
+    }
+    vm_iter = vm.find("logfile");
+    if (vm_iter != vm.end()) {
+      lpath = (char*) vm_iter->second.as<std::string>().c_str();
+    }
+    vm_iter = vm.find("debug");
+    if (vm_iter != vm.end()) {
+      dlevel = ReturnLevelAscii(
+	(char*) vm_iter->second.as<std::string>().c_str());
+    }
+    vm_iter = vm.find("base_id");
+    if (vm_iter != vm.end()) {
+      base_id = vm_iter->second.as<uint16_t>();
+      if (base_id == 0)
+	base_id = 1;
+    }
+    vm_iter = vm.find("exports");
+    if (vm_iter != vm.end()) {
+      nexports = vm_iter->second.as<uint32_t>();
+      if (nexports < 5)
+	nexports = 5;
+    }
+
+    conf_path = write_config("base", {}, 0);
+
+    ::testing::InitGoogleTest(&argc, argv);
+
+    std::thread ganesha(ganesha_server);
+    std::this_thread::sleep_for(5s);
+
+    code  = RUN_ALL_TESTS();
+    ganesha.join();
+    unlink(conf_path.c_str());
+  }
+
+  catch(po::error& e) {
+    cout << "Error parsing opts " << e.what() << endl;
+  }
+
+  catch(...) {
+    cout << "Unhandled exception in main()" << endl;
+  }
+
+  return code;
+}
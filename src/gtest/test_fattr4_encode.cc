@@ -0,0 +1,410 @@
+// -*- mode:C; tab-width:8; c-basic-offset:2; indent-tabs-mode:t -*-
+// vim: ts=8 sw=2 smarttab
+/*
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 3 of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA
+ * 02110-1301 USA
+ *
+ * -------------
+ */
+
+/*
+ * fattr4 encoding: a fattr4 encoded straight into the reply must give
+ * the same bytes as one built into an attrlist4 buffer, and both must
+ * match the old attribute by attribute walk of fattr4tab.  The time of
+ * each is reported for a typical GETATTR bitmap.  No server is
+ * started, so owner and group, which need the idmapper, are left out.
+ */
+
+#include <sys/types.h>
+#include <cstring>
+#include <iostream>
+#include <chrono>
+#include "gtest/gtest.h"
+#include <boost/program_options.hpp>
+
+extern "C" {
+/* Ganesha headers */
+#include "nfs_core.h"
+#include "nfs_proto_tools.h"
+#include "export_mgr.h"
+}
+
+namespace {
+
+  uint32_t nops = 1000000;
+
+  struct req_op_context req_ctx;
+  struct gsh_export export_;
+  compound_data_t data;
+  struct attrlist attrs;
+  char fh_val[] = "a file handle of 27 bytes!";
+  nfs_fh4 fh = { sizeof(fh_val) - 1, fh_val };
+
+  /* encode a fattr4 as the reply would, return the encoded length */
+  u_int encode(fattr4 *fattr, char *buf, u_int size)
+  {
+    XDR xdr;
+    u_int len;
+
+    memset(&xdr, 0, sizeof(xdr));
+    xdrmem_create(&xdr, buf, size, XDR_ENCODE);
+    EXPECT_TRUE(xdr_fattr4(&xdr, fattr));
+    len = xdr_getpos(&xdr);
+    xdr_destroy(&xdr);
+    return len;
+  }
+
+  void fill(struct xdr_attrs_args *args, bool to_wire)
+  {
+    memset(args, 0, sizeof(*args));
+    args->attrs = &attrs;
+    args->data = &data;
+    args->hdl4 = &fh;
+    args->fileid = 1234567;
+    args->mounted_on_fileid = 7654321;
+    args->fsid.major = 11;
+    args->fsid.minor = 12;
+    args->to_wire = to_wire;
+  }
+
+  /* both encodings of request must be byte for byte the same */
+  void compare(struct bitmap4 *request, bool expect_wire)
+  {
+    struct xdr_attrs_args args;
+    fattr4 buffered, wire;
+    char buf1[1024], buf2[1024];
+    u_int len1, len2;
+
+    fill(&args, false);
+    ASSERT_EQ(nfs4_FSALattr_To_Fattr(&args, request, &buffered), 0);
+    EXPECT_EQ(buffered.attr_wire, nullptr);
+
+    fill(&args, true);
+    ASSERT_EQ(nfs4_FSALattr_To_Fattr(&args, request, &wire), 0);
+    EXPECT_EQ(wire.attr_wire != NULL, expect_wire);
+
+    EXPECT_EQ(wire.attr_vals.attrlist4_len,
+	      buffered.attr_vals.attrlist4_len);
+    len1 = encode(&buffered, buf1, sizeof(buf1));
+    len2 = encode(&wire, buf2, sizeof(buf2));
+    EXPECT_EQ(len1, len2);
+    EXPECT_EQ(memcmp(buf1, buf2, len1), 0);
+
+    nfs4_Fattr_Free(&buffered);
+    nfs4_Fattr_Free(&wire);
+  }
+
+  /* a plan is only kept once its bitmap has missed a few times */
+  void warm(struct bitmap4 *request)
+  {
+    struct xdr_attrs_args args;
+    fattr4 fattr;
+    int i;
+
+    for (i = 0; i < 16; i++) {
+      fill(&args, true);
+      ASSERT_EQ(nfs4_FSALattr_To_Fattr(&args, request, &fattr), 0);
+      nfs4_Fattr_Free(&fattr);
+    }
+  }
+
+  /* a Linux client's GETATTR, less owner and group */
+  void getattr_bitmap(struct bitmap4 *request)
+  {
+    memset(request, 0, sizeof(*request));
+    set_attribute_in_bitmap(request, FATTR4_TYPE);
+    set_attribute_in_bitmap(request, FATTR4_CHANGE);
+    set_attribute_in_bitmap(request, FATTR4_SIZE);
+    set_attribute_in_bitmap(request, FATTR4_FSID);
+    set_attribute_in_bitmap(request, FATTR4_FILEID);
+    set_attribute_in_bitmap(request, FATTR4_MODE);
+    set_attribute_in_bitmap(request, FATTR4_NUMLINKS);
+    set_attribute_in_bitmap(request, FATTR4_RAWDEV);
+    set_attribute_in_bitmap(request, FATTR4_SPACE_USED);
+    set_attribute_in_bitmap(request, FATTR4_TIME_ACCESS);
+    set_attribute_in_bitmap(request, FATTR4_TIME_METADATA);
+    set_attribute_in_bitmap(request, FATTR4_TIME_MODIFY);
+    set_attribute_in_bitmap(request, FATTR4_MOUNTED_ON_FILEID);
+  }
+
+  /* nfs4_FSALattr_To_Fattr before encoder plans: a bit at a time */
+  void encode_by_bit(struct xdr_attrs_args *args, struct bitmap4 *request,
+		     fattr4 *fattr)
+  {
+    int max_attr_idx = nfs4_max_attr_index(args->data);
+    XDR xdr;
+    int attr;
+
+    memset(fattr, 0, sizeof(*fattr));
+    fattr->attr_vals.attrlist4_val = (char *) gsh_malloc(
+      NFS4_ATTRVALS_BUFFLEN);
+    memset(&xdr, 0, sizeof(xdr));
+    xdrmem_create(&xdr, fattr->attr_vals.attrlist4_val,
+		  NFS4_ATTRVALS_BUFFLEN, XDR_ENCODE);
+
+    for (attr = next_attr_from_bitmap(request, -1); attr != -1;
+	 attr = next_attr_from_bitmap(request, attr)) {
+      if (attr > max_attr_idx)
+	break;
+      if (fattr4tab[attr].encode(&xdr, args) == FATTR_XDR_SUCCESS)
+	set_attribute_in_bitmap(&fattr->attrmask, attr);
+    }
+    fattr->attr_vals.attrlist4_len = xdr_getpos(&xdr);
+    xdr_destroy(&xdr);
+  }
+
+  /* time nops encodings of request into the reply, ns per op */
+  uint64_t time_encode(struct bitmap4 *request, int how)
+  {
+    struct xdr_attrs_args args;
+    fattr4 fattr;
+    char buf[1024];
+
+    auto start = std::chrono::steady_clock::now();
+
+    for (uint32_t i = 0; i < nops; i++) {
+      fill(&args, how == 2);
+      if (how == 0)
+	encode_by_bit(&args, request, &fattr);
+      else
+	EXPECT_EQ(nfs4_FSALattr_To_Fattr(&args, request, &fattr), 0);
+      encode(&fattr, buf, sizeof(buf));
+      nfs4_Fattr_Free(&fattr);
+    }
+
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(
+      std::chrono::steady_clock::now() - start).count() / nops;
+  }
+
+} /* namespace */
+
+TEST(FATTR4_ENCODE, INIT)
+{
+  memset(&req_ctx, 0, sizeof(req_ctx));
+  memset(&export_, 0, sizeof(export_));
+  memset(&data, 0, sizeof(data));
+  memset(&attrs, 0, sizeof(attrs));
+
+  nfs_param.core_param.rpc.max_send_buffer_size = 1048576;
+  data.minorversion = 1;
+  attrs.type = REGULAR_FILE;
+  attrs.change = 0x1122334455667788ULL;
+  attrs.filesize = 4096;
+  attrs.spaceused = 8192;
+  attrs.numlinks = 3;
+  attrs.mode = 0644;
+  attrs.rawdev.major = 8;
+  attrs.rawdev.minor = 1;
+  attrs.atime.tv_sec = 1000;
+  attrs.atime.tv_nsec = 1;
+  attrs.ctime.tv_sec = 2000;
+  attrs.ctime.tv_nsec = 2;
+  attrs.mtime.tv_sec = 3000;
+  attrs.mtime.tv_nsec = 3;
+  attrs.supported = ATTRS_POSIX;
+
+  req_ctx.ctx_export = &export_;
+
+  /* stashed in tls */
+  op_ctx = &req_ctx;
+}
+
+TEST(FATTR4_ENCODE, WIRE_MATCHES_BUFFER)
+{
+  struct bitmap4 request;
+
+  memset(&request, 0, sizeof(request));
+  set_attribute_in_bitmap(&request, FATTR4_SUPPORTED_ATTRS);
+  set_attribute_in_bitmap(&request, FATTR4_TYPE);
+  set_attribute_in_bitmap(&request, FATTR4_FH_EXPIRE_TYPE);
+  set_attribute_in_bitmap(&request, FATTR4_CHANGE);
+  set_attribute_in_bitmap(&request, FATTR4_SIZE);
+  set_attribute_in_bitmap(&request, FATTR4_FSID);
+  set_attribute_in_bitmap(&request, FATTR4_FILEHANDLE);
+  set_attribute_in_bitmap(&request, FATTR4_FILEID);
+  set_attribute_in_bitmap(&request, FATTR4_MODE);
+  set_attribute_in_bitmap(&request, FATTR4_NUMLINKS);
+  set_attribute_in_bitmap(&request, FATTR4_RAWDEV);
+  set_attribute_in_bitmap(&request, FATTR4_SPACE_USED);
+  set_attribute_in_bitmap(&request, FATTR4_TIME_ACCESS);
+  set_attribute_in_bitmap(&request, FATTR4_TIME_METADATA);
+  set_attribute_in_bitmap(&request, FATTR4_TIME_MODIFY);
+  set_attribute_in_bitmap(&request, FATTR4_MOUNTED_ON_FILEID);
+  /* encodes nothing, and must not show up in either bitmap */
+  set_attribute_in_bitmap(&request, FATTR4_DACL);
+
+  /* not kept yet, so encoded to the buffer */
+  compare(&request, false);
+
+  warm(&request);
+  compare(&request, true);
+
+  /* the export's fsid wins when it is set */
+  export_.options_set |= EXPORT_OPTION_FSID_SET;
+  export_.filesystem_id.major = 21;
+  export_.filesystem_id.minor = 22;
+  compare(&request, true);
+  export_.options_set = 0;
+
+  /* supported_attrs differs per minor version */
+  data.minorversion = 0;
+  warm(&request);
+  compare(&request, true);
+  data.minorversion = 1;
+}
+
+TEST(FATTR4_ENCODE, LIVE_ATTRS_BUFFERED)
+{
+  struct bitmap4 request;
+
+  /* the ACL is not kept for the reply, so no wire encoding */
+  memset(&request, 0, sizeof(request));
+  set_attribute_in_bitmap(&request, FATTR4_ACL);
+  set_attribute_in_bitmap(&request, FATTR4_TYPE);
+  set_attribute_in_bitmap(&request, FATTR4_SIZE);
+
+  compare(&request, false);
+}
+
+TEST(FATTR4_ENCODE, ENCODE_TO_BUFFER)
+{
+  struct xdr_attrs_args args;
+  struct bitmap4 request;
+  fattr4 fattr;
+  char buf1[1024], buf2[1024];
+  u_int len1, len2;
+
+  /* what READDIR encodes per entry */
+  getattr_bitmap(&request);
+  set_attribute_in_bitmap(&request, FATTR4_RDATTR_ERROR);
+  set_attribute_in_bitmap(&request, FATTR4_FILEHANDLE);
+
+  fill(&args, false);
+  ASSERT_EQ(nfs4_FSALattr_To_Fattr(&args, &request, &fattr), 0);
+  len1 = encode(&fattr, buf1, sizeof(buf1));
+  nfs4_Fattr_Free(&fattr);
+
+  fill(&args, false);
+  ASSERT_EQ(nfs4_FSALattr_Encode(&args, &request, buf2, sizeof(buf2),
+				 &len2), 0);
+  EXPECT_EQ(len1, len2);
+  EXPECT_EQ(memcmp(buf1, buf2, len1), 0);
+
+  /* one byte short of the whole fattr4 does not fit */
+  fill(&args, false);
+  EXPECT_EQ(nfs4_FSALattr_Encode(&args, &request, buf2, len1 - 1,
+				 &len2), 1);
+}
+
+TEST(FATTR4_ENCODE, DECODE)
+{
+  struct xdr_attrs_args args;
+  struct bitmap4 request;
+  struct attrlist decoded;
+  fattr4 fattr;
+
+  memset(&request, 0, sizeof(request));
+  set_attribute_in_bitmap(&request, FATTR4_SIZE);
+  set_attribute_in_bitmap(&request, FATTR4_MODE);
+
+  fill(&args, false);
+  ASSERT_EQ(nfs4_FSALattr_To_Fattr(&args, &request, &fattr), 0);
+  EXPECT_EQ(nfs4_Fattr_To_FSAL_attr(&decoded, &fattr, &data), NFS4_OK);
+  EXPECT_EQ(decoded.valid_mask, ATTR_SIZE | ATTR_MODE);
+  EXPECT_EQ(decoded.filesize, attrs.filesize);
+  EXPECT_EQ(decoded.mode, attrs.mode);
+
+  /* an attribute past the table after the ones we know */
+  set_attribute_in_bitmap(&fattr.attrmask, 90);
+  EXPECT_EQ(nfs4_Fattr_To_FSAL_attr(&decoded, &fattr, &data),
+	    NFS4ERR_BADXDR);
+  nfs4_Fattr_Free(&fattr);
+}
+
+TEST(FATTR4_ENCODE, GETATTR_TIME)
+{
+  struct xdr_attrs_args args;
+  struct bitmap4 request;
+  fattr4 by_bit, planned;
+  char buf1[1024], buf2[1024];
+  u_int len1, len2;
+  uint64_t bit_ns, plan_ns, wire_ns;
+
+  getattr_bitmap(&request);
+
+  /* the plans give what the bit by bit walk gave */
+  fill(&args, false);
+  encode_by_bit(&args, &request, &by_bit);
+  fill(&args, false);
+  ASSERT_EQ(nfs4_FSALattr_To_Fattr(&args, &request, &planned), 0);
+  len1 = encode(&by_bit, buf1, sizeof(buf1));
+  len2 = encode(&planned, buf2, sizeof(buf2));
+  EXPECT_EQ(len1, len2);
+  EXPECT_EQ(memcmp(buf1, buf2, len1), 0);
+  gsh_free(by_bit.attr_vals.attrlist4_val);
+  nfs4_Fattr_Free(&planned);
+
+  bit_ns = time_encode(&request, 0);
+  plan_ns = time_encode(&request, 1);
+  wire_ns = time_encode(&request, 2);
+
+  std::cout << nops << " GETATTR encodes: bit by bit " << bit_ns
+	    << " ns/op, plan " << plan_ns << " ns/op, plan to the wire "
+	    << wire_ns << " ns/op" << std::endl;
+}
+
+int main(int argc, char *argv[])
+{
+  int code = 0;
+
+  using namespace std;
+  namespace po = boost::program_options;
+
+  po::options_description opts("program options");
+  po::variables_map vm;
+
+  try {
+
+    opts.add_options()
+      ("ops", po::value<uint32_t>(),
+	"number of encodes per run")
+      ;
+
+    po::variables_map::iterator vm_iter;
+    po::store(po::parse_command_line(argc, argv, opts), vm);
+    po::notify(vm);
+
+    vm_iter = vm.find("ops");
+    if (vm_iter != vm.end()) {
+      nops = vm_iter->second.as<uint32_t>();
+      if (nops == 0)
+	nops = 1;
+    }
+
+    ::testing::InitGoogleTest(&argc, argv);
+
+    code  = RUN_ALL_TESTS();
+  }
+
+  catch(po::error& e) {
+    cout << "Error parsing opts " << e.what() << endl;
+  }
+
+  catch(...) {
+    cout << "Unhandled exception in main()" << endl;
+  }
+
+  return code;
+}
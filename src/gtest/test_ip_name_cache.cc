@@ -0,0 +1,303 @@
+// -*- mode:C; tab-width:8; c-basic-offset:2; indent-tabs-mode:t -*-
+// vim: ts=8 sw=2 smarttab
+/*
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 3 of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA
+ * 02110-1301 USA
+ *
+ * -------------
+ */
+
+/*
+ * IP/name cache and resolver pool, with a stub in place of getnameinfo
+ * so neither the hosts file nor DNS is involved.  The NFS_IP_Name
+ * block comes from a config written here, with a short negative TTL
+ * and wait timeout.  No server is started.
+ */
+
+#include <sys/types.h>
+#include <arpa/inet.h>
+#include <unistd.h>
+#include <cstring>
+#include <iostream>
+#include <fstream>
+#include <sstream>
+#include <vector>
+#include <string>
+#include <atomic>
+#include <chrono>
+#include <thread>
+#include "gtest/gtest.h"
+#include <boost/program_options.hpp>
+
+extern "C" {
+/* Ganesha headers */
+#include "nfs_core.h"
+#include "nfs_ip_stats.h"
+#include "config_parsing.h"
+}
+
+namespace {
+
+  std::string workdir = "/tmp";
+  const std::string named_addr = "192.0.2.1";
+  const std::string named_name = "client1.example.com";
+  const std::string slow_addr = "192.0.2.2";
+  const std::string slow_name = "slow.example.com";
+  const std::string unnamed_addr = "192.0.2.3";
+  uint32_t negative_ttl = 1;
+  uint32_t wait_timeout = 100;
+  uint32_t slow_ms = 500;
+  uint32_t nthreads = 16;
+
+  std::atomic<uint32_t> resolver_calls;
+
+  /* getnameinfo for the addresses above */
+  int stub_resolver(const struct sockaddr *sa, socklen_t salen,
+		    char *host, socklen_t hostlen,
+		    char *serv, socklen_t servlen, int flags)
+  {
+    const struct sockaddr_in *sin = (const struct sockaddr_in *) sa;
+    char str[INET_ADDRSTRLEN];
+    std::string name;
+
+    resolver_calls++;
+    inet_ntop(AF_INET, &sin->sin_addr, str, sizeof(str));
+
+    if (named_addr == str) {
+      name = named_name;
+    } else if (slow_addr == str) {
+      std::this_thread::sleep_for(std::chrono::milliseconds(slow_ms));
+      name = slow_name;
+    } else {
+      return EAI_NONAME;
+    }
+
+    strncpy(host, name.c_str(), hostlen);
+    return 0;
+  }
+
+  std::string write_config()
+  {
+    std::ostringstream path;
+    path << workdir << "/test_ip_name_cache." << getpid() << ".conf";
+    std::ofstream conf(path.str());
+
+    conf << "NFS_IP_Name\n{\n"
+	 << "\tNegative_Expiration_Time = " << negative_ttl << ";\n"
+	 << "\tResolver_Threads = 4;\n"
+	 << "\tResolver_Wait_Timeout = " << wait_timeout << ";\n"
+	 << "}\n";
+    return path.str();
+  }
+
+  void make_addr(const std::string& str, sockaddr_t *addr)
+  {
+    struct sockaddr_in *sin = (struct sockaddr_in *) addr;
+
+    memset(addr, 0, sizeof(*addr));
+    sin->sin_family = AF_INET;
+    ASSERT_EQ(inet_pton(AF_INET, str.c_str(), &sin->sin_addr), 1);
+  }
+
+  /* what client_match_hostname() does */
+  int lookup(sockaddr_t *addr, char *hostname, size_t size)
+  {
+    int rc = nfs_ip_name_get(addr, hostname, size);
+
+    if (rc == IP_NAME_NOT_FOUND)
+      rc = nfs_ip_name_add(addr, hostname, size);
+    return rc;
+  }
+
+} /* namespace */
+
+TEST(IP_NAME_CACHE, INIT)
+{
+  struct config_error_type err_type;
+  std::string conf = write_config();
+  config_file_t config;
+
+  ASSERT_TRUE(init_error_type(&err_type));
+  config = config_ParseFile((char *) conf.c_str(), &err_type);
+  ASSERT_NE(config, nullptr);
+  (void) load_config_from_parse(config, &nfs_ip_name, NULL, true,
+				&err_type);
+  ASSERT_TRUE(config_error_is_harmless(&err_type));
+  config_Free(config);
+  unlink(conf.c_str());
+
+  nfs_ip_name_set_resolver(stub_resolver);
+  ASSERT_EQ(nfs_Init_ip_name(), IP_NAME_SUCCESS);
+}
+
+TEST(IP_NAME_CACHE, RESOLVE)
+{
+  sockaddr_t addr;
+  char hostname[MAXHOSTNAMELEN + 1];
+
+  make_addr(named_addr, &addr);
+  resolver_calls = 0;
+
+  ASSERT_EQ(lookup(&addr, hostname, sizeof(hostname)), IP_NAME_SUCCESS);
+  EXPECT_EQ(std::string(hostname), named_name);
+
+  /* now a cache hit */
+  hostname[0] = '\0';
+  ASSERT_EQ(lookup(&addr, hostname, sizeof(hostname)), IP_NAME_SUCCESS);
+  EXPECT_EQ(std::string(hostname), named_name);
+  EXPECT_EQ(resolver_calls, 1U);
+}
+
+TEST(IP_NAME_CACHE, SHARED_RESOLUTION)
+{
+  sockaddr_t addr;
+  std::vector<std::thread> workers;
+  std::vector<std::string> names(nthreads);
+  std::vector<int> rcs(nthreads, -1);
+
+  make_addr(slow_addr, &addr);
+  (void) nfs_ip_name_remove(&addr);
+  resolver_calls = 0;
+
+  /* every worker misses at once and waits on the same lookup, which
+   * takes longer than Resolver_Wait_Timeout; none of them may give up
+   * and report the client as unnamed
+   */
+  for (uint32_t t = 0; t < nthreads; t++) {
+    workers.emplace_back([&, t]() {
+	char hostname[MAXHOSTNAMELEN + 1];
+
+	rcs[t] = nfs_ip_name_add(&addr, hostname, sizeof(hostname));
+	if (rcs[t] == IP_NAME_SUCCESS)
+	  names[t] = hostname;
+      });
+  }
+
+  for (auto& w : workers)
+    w.join();
+
+  for (uint32_t t = 0; t < nthreads; t++) {
+    EXPECT_EQ(rcs[t], IP_NAME_SUCCESS);
+    EXPECT_EQ(names[t], slow_name);
+  }
+  EXPECT_EQ(resolver_calls, 1U);
+}
+
+TEST(IP_NAME_CACHE, NEGATIVE)
+{
+  sockaddr_t addr;
+  char hostname[MAXHOSTNAMELEN + 1];
+
+  make_addr(unnamed_addr, &addr);
+  resolver_calls = 0;
+
+  /* the failure is cached, as the address itself */
+  ASSERT_EQ(lookup(&addr, hostname, sizeof(hostname)), IP_NAME_SUCCESS);
+  EXPECT_EQ(std::string(hostname), unnamed_addr);
+  ASSERT_EQ(nfs_ip_name_get(&addr, hostname, sizeof(hostname)),
+	    IP_NAME_SUCCESS);
+  EXPECT_EQ(std::string(hostname), unnamed_addr);
+  EXPECT_EQ(resolver_calls, 1U);
+
+  /* until Negative_Expiration_Time, timestamps are in seconds */
+  std::this_thread::sleep_for(std::chrono::seconds(negative_ttl + 1));
+  EXPECT_EQ(nfs_ip_name_get(&addr, hostname, sizeof(hostname)),
+	    IP_NAME_NOT_FOUND);
+
+  /* while the positive entry is still good */
+  make_addr(named_addr, &addr);
+  EXPECT_EQ(nfs_ip_name_get(&addr, hostname, sizeof(hostname)),
+	    IP_NAME_SUCCESS);
+}
+
+TEST(IP_NAME_CACHE, CLEANUP)
+{
+  EXPECT_EQ(nfs_ip_name_shutdown(), 0);
+  nfs_ip_name_set_resolver(NULL);
+}
+
+int main(int argc, char *argv[])
+{
+  int code = 0;
+
+  using namespace std;
+  namespace po = boost::program_options;
+
+  po::options_description opts("program options");
+  po::variables_map vm;
+
+  try {
+
+    opts.add_options()
+      ("dir", po::value<string>(),
+	"directory for the config file")
+
+      ("negative_ttl", po::value<uint32_t>(),
+	"Negative_Expiration_Time in seconds")
+
+      ("wait", po::value<uint32_t>(),
+	"Resolver_Wait_Timeout in milliseconds")
+
+      ("slow", po::value<uint32_t>(),
+	"milliseconds the slow address takes to resolve")
+
+      ("threads", po::value<uint32_t>(),
+	"number of concurrent lookups")
+      ;
+
+    po::variables_map::iterator vm_iter;
+    po::store(po::parse_command_line(argc, argv, opts), vm);
+    po::notify(vm);
+
+    vm_iter = vm.find("dir");
+    if (vm_iter != vm.end()) {
+      workdir = vm_iter->second.as<std::string>();
+    }
+    vm_iter = vm.find("negative_ttl");
+    if (vm_iter != vm.end()) {
+      negative_ttl = vm_iter->second.as<uint32_t>();
+      if (negative_ttl == 0)
+	negative_ttl = 1;
+    }
+    vm_iter = vm.find("wait");
+    if (vm_iter != vm.end()) {
+      wait_timeout = vm_iter->second.as<uint32_t>();
+    }
+    vm_iter = vm.find("slow");
+    if (vm_iter != vm.end()) {
+      slow_ms = vm_iter->second.as<uint32_t>();
+    }
+    vm_iter = vm.find("threads");
+    if (vm_iter != vm.end()) {
+      nthreads = vm_iter->second.as<uint32_t>();
+      if (nthreads == 0)
+	nthreads = 1;
+    }
+
+    ::testing::InitGoogleTest(&argc, argv);
+
+    code  = RUN_ALL_TESTS();
+  }
+
+  catch(po::error& e) {
+    cout << "Error parsing opts " << e.what() << endl;
+  }
+
+  catch(...) {
+    cout << "Unhandled exception in main()" << endl;
+  }
+
+  return code;
+}
@@ -0,0 +1,354 @@
+// -*- mode:C; tab-width:8; c-basic-offset:2; indent-tabs-mode:t -*-
+// vim: ts=8 sw=2 smarttab
+/*
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 3 of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA
+ * 02110-1301 USA
+ *
+ * -------------
+ */
+
+/*
+ * The FSAL_MEM extent map as SEEK and READ_PLUS see it: a file
+ * written in two pieces with holes between and after them, then
+ * truncated into the second piece and grown again.  Meant for an
+ * FSAL_MEM export with an Inode_Size of at least 8192, so all of the
+ * data written is kept.
+ */
+
+#include <sys/types.h>
+#include <iostream>
+#include <chrono>
+#include <thread>
+#include "gtest/gtest.h"
+#include <boost/program_options.hpp>
+
+extern "C" {
+/* Ganesha headers */
+#include "nfs_lib.h"
+#include "export_mgr.h"
+#include "nfs_exports.h"
+#include "sal_data.h"
+#include "fsal.h"
+}
+
+/* data [0, PIECE), hole, data [SECOND, SECOND + PIECE), hole to SIZE */
+#define PIECE 1024
+#define SECOND 4096
+#define SIZE 8192
+
+namespace {
+
+  char* ganesha_conf = nullptr;
+  char* lpath = nullptr;
+  int dlevel = -1;
+  uint16_t export_id = 77;
+
+  struct req_op_context req_ctx;
+  struct user_cred user_credentials;
+
+  struct gsh_export* a_export = nullptr;
+  struct fsal_obj_handle *root_entry = nullptr;
+  struct fsal_obj_handle *test_file = nullptr;
+  const char *test_name = "mem_extents_test";
+
+  int ganesha_server() {
+    return nfs_libmain(
+      ganesha_conf,
+      lpath,
+      dlevel
+      );
+  }
+
+  /* SEEK from offset to what, -1 for NXIO */
+  int64_t seek(uint64_t offset, data_content4 what)
+  {
+    struct io_info info;
+    fsal_status_t status;
+
+    memset(&info, 0, sizeof(info));
+    info.io_content.what = what;
+    info.io_content.hole.di_offset = offset;
+
+    status = test_file->obj_ops.seek2(test_file, NULL, &info);
+    if (status.major == ERR_FSAL_NXIO)
+      return -1;
+    EXPECT_FALSE(FSAL_IS_ERROR(status));
+    return info.io_content.hole.di_offset;
+  }
+
+  /* READ_PLUS at offset, the one segment it reports */
+  void read_plus(uint64_t offset, size_t count, struct io_info *info,
+		 char *buffer, bool *eof)
+  {
+    fsal_status_t status;
+    size_t read_amount = 0;
+
+    memset(info, 0, sizeof(*info));
+    status = test_file->obj_ops.read2(test_file, true, NULL, offset,
+				      count, buffer, &read_amount, eof,
+				      info);
+    ASSERT_FALSE(FSAL_IS_ERROR(status));
+  }
+
+  void write_piece(uint64_t offset, char fill)
+  {
+    char buffer[PIECE];
+    size_t wrote = 0;
+    bool stable = false;
+    fsal_status_t status;
+
+    memset(buffer, fill, sizeof(buffer));
+    status = test_file->obj_ops.write2(test_file, true, NULL, offset,
+				       sizeof(buffer), buffer, &wrote,
+				       &stable, NULL);
+    ASSERT_FALSE(FSAL_IS_ERROR(status));
+    EXPECT_EQ(wrote, (size_t) PIECE);
+  }
+
+  void set_size(uint64_t size)
+  {
+    struct attrlist attrs;
+    fsal_status_t status;
+
+    memset(&attrs, 0, sizeof(attrs));
+    FSAL_SET_MASK(attrs.valid_mask, ATTR_SIZE);
+    attrs.filesize = size;
+    status = test_file->obj_ops.setattr2(test_file, true, NULL, &attrs);
+    ASSERT_FALSE(FSAL_IS_ERROR(status));
+  }
+
+  /* Every one of the first count bytes of buffer is c */
+  bool all(const char *buffer, size_t count, char c)
+  {
+    for (size_t i = 0; i < count; i++)
+      if (buffer[i] != c)
+	return false;
+    return true;
+  }
+
+} /* namespace */
+
+TEST(MEM_EXTENTS, INIT)
+{
+  a_export = get_gsh_export(export_id);
+  ASSERT_NE(a_export, nullptr);
+
+  nfs_export_get_root_entry(a_export, &root_entry);
+  ASSERT_NE(root_entry, nullptr);
+
+  /* Ganesha call paths need real or forged context info */
+  memset(&user_credentials, 0, sizeof(struct user_cred));
+  memset(&req_ctx, 0, sizeof(struct req_op_context));
+
+  req_ctx.ctx_export = a_export;
+  req_ctx.fsal_export = a_export->fsal_export;
+  req_ctx.creds = &user_credentials;
+
+  /* stashed in tls */
+  op_ctx = &req_ctx;
+}
+
+TEST(MEM_EXTENTS, CREATE)
+{
+  struct attrlist attrs;
+  fsal_status_t status;
+  bool caller_perm_check = false;
+
+  memset(&attrs, 0, sizeof(attrs));
+  FSAL_SET_MASK(attrs.valid_mask, ATTR_MODE);
+  attrs.mode = 0644;
+
+  status = root_entry->obj_ops.open2(root_entry, NULL, FSAL_O_RDWR,
+				     FSAL_UNCHECKED, test_name, &attrs,
+				     NULL, &test_file, NULL,
+				     &caller_perm_check);
+  ASSERT_FALSE(FSAL_IS_ERROR(status));
+  ASSERT_NE(test_file, nullptr);
+
+  write_piece(0, 'x');
+  write_piece(SECOND, 'y');
+  set_size(SIZE);
+}
+
+TEST(MEM_EXTENTS, SEEK)
+{
+  EXPECT_EQ(seek(0, NFS4_CONTENT_DATA), 0);
+  EXPECT_EQ(seek(0, NFS4_CONTENT_HOLE), PIECE);
+  EXPECT_EQ(seek(PIECE / 2, NFS4_CONTENT_HOLE), PIECE);
+  EXPECT_EQ(seek(PIECE, NFS4_CONTENT_DATA), SECOND);
+  EXPECT_EQ(seek(PIECE, NFS4_CONTENT_HOLE), PIECE);
+  EXPECT_EQ(seek(SECOND, NFS4_CONTENT_HOLE), SECOND + PIECE);
+
+  /* the hole after the last piece runs to the end of the file */
+  EXPECT_EQ(seek(SECOND + PIECE, NFS4_CONTENT_DATA), -1);
+  EXPECT_EQ(seek(SECOND + PIECE, NFS4_CONTENT_HOLE), SECOND + PIECE);
+
+  /* nothing at or past the end */
+  EXPECT_EQ(seek(SIZE, NFS4_CONTENT_DATA), -1);
+  EXPECT_EQ(seek(SIZE, NFS4_CONTENT_HOLE), -1);
+}
+
+TEST(MEM_EXTENTS, READ_PLUS)
+{
+  char buffer[SIZE];
+  struct io_info info;
+  bool eof = false;
+
+  /* data stops at the end of its extent */
+  read_plus(0, SIZE, &info, buffer, &eof);
+  EXPECT_EQ(info.io_content.what, NFS4_CONTENT_DATA);
+  EXPECT_EQ(info.io_content.data.d_offset, 0U);
+  EXPECT_EQ(info.io_content.data.d_data.data_len, (uint32_t) PIECE);
+  EXPECT_TRUE(all(buffer, PIECE, 'x'));
+  EXPECT_FALSE(eof);
+
+  /* a hole up to the next extent */
+  read_plus(PIECE, SIZE, &info, buffer, &eof);
+  EXPECT_EQ(info.io_content.what, NFS4_CONTENT_HOLE);
+  EXPECT_EQ(info.io_content.hole.di_offset, (uint64_t) PIECE);
+  EXPECT_EQ(info.io_content.hole.di_length, (uint64_t) SECOND - PIECE);
+  EXPECT_FALSE(eof);
+
+  read_plus(SECOND, SIZE, &info, buffer, &eof);
+  EXPECT_EQ(info.io_content.what, NFS4_CONTENT_DATA);
+  EXPECT_EQ(info.io_content.data.d_data.data_len, (uint32_t) PIECE);
+  EXPECT_TRUE(all(buffer, PIECE, 'y'));
+
+  /* and the trailing hole ends the file */
+  read_plus(SECOND + PIECE, SIZE, &info, buffer, &eof);
+  EXPECT_EQ(info.io_content.what, NFS4_CONTENT_HOLE);
+  EXPECT_EQ(info.io_content.hole.di_length,
+	    (uint64_t) SIZE - SECOND - PIECE);
+  EXPECT_TRUE(eof);
+}
+
+TEST(MEM_EXTENTS, TRUNCATE)
+{
+  char buffer[SIZE];
+  struct io_info info;
+  size_t read_amount = 0;
+  bool eof = false;
+  fsal_status_t status;
+
+  /* Into the second piece, which is cut short */
+  set_size(SECOND + PIECE / 2);
+  EXPECT_EQ(seek(SECOND, NFS4_CONTENT_HOLE), SECOND + PIECE / 2);
+  EXPECT_EQ(seek(SECOND + PIECE / 4, NFS4_CONTENT_DATA),
+	    SECOND + PIECE / 4);
+
+  /* Growing again adds a hole, not the old data */
+  set_size(SIZE);
+  EXPECT_EQ(seek(SECOND, NFS4_CONTENT_HOLE), SECOND + PIECE / 2);
+  EXPECT_EQ(seek(SECOND + PIECE / 2, NFS4_CONTENT_DATA), -1);
+
+  read_plus(SECOND + PIECE / 2, SIZE, &info, buffer, &eof);
+  EXPECT_EQ(info.io_content.what, NFS4_CONTENT_HOLE);
+  EXPECT_EQ(info.io_content.hole.di_length,
+	    (uint64_t) SIZE - SECOND - PIECE / 2);
+
+  status = test_file->obj_ops.read2(test_file, true, NULL,
+				    SECOND + PIECE / 2, PIECE / 2, buffer,
+				    &read_amount, &eof, NULL);
+  ASSERT_FALSE(FSAL_IS_ERROR(status));
+  EXPECT_EQ(read_amount, (size_t) PIECE / 2);
+  EXPECT_TRUE(all(buffer, PIECE / 2, '\0'));
+
+  /* Down to nothing */
+  set_size(0);
+  set_size(SIZE);
+  EXPECT_EQ(seek(0, NFS4_CONTENT_DATA), -1);
+  EXPECT_EQ(seek(0, NFS4_CONTENT_HOLE), 0);
+}
+
+TEST(MEM_EXTENTS, CLEANUP)
+{
+  fsal_status_t status;
+
+  test_file->obj_ops.close(test_file);
+  status = root_entry->obj_ops.unlink(root_entry, test_file, test_name);
+  EXPECT_FALSE(FSAL_IS_ERROR(status));
+  test_file->obj_ops.put_ref(test_file);
+  test_file = nullptr;
+}
+
+int main(int argc, char *argv[])
+{
+  int code = 0;
+
+  using namespace std;
+  using namespace std::literals;
+  namespace po = boost::program_options;
+
+  po::options_description opts("program options");
+  po::variables_map vm;
+
+  try {
+
+    opts.add_options()
+      ("config", po::value<string>(),
+	"path to Ganesha conf file")
+
+      ("logfile", po::value<string>(),
+	"log to the provided file path")
+
+      ("export", po::value<uint16_t>(),
+	"id of export on which to operate (must exist)")
+
+      ("debug", po::value<string>(),
+	"ganesha debug level")
+      ;
+
+    po::variables_map::iterator vm_iter;
+    po::store(po::parse_command_line(argc, argv, opts), vm);
+    po::notify(vm);
+
+    // use config vars--leaves them on the stack
+    vm_iter = vm.find("config");
+    if (vm_iter != vm.end()) {
+      ganesha_conf = (char*) vm_iter->second.as<std::string>().c_str();
+    }
+    vm_iter = vm.find("logfile");
+    if (vm_iter != vm.end()) {
+      lpath = (char*) vm_iter->second.as<std::string>().c_str();
+    }
+    vm_iter = vm.find("debug");
+    if (vm_iter != vm.end()) {
+      dlevel = ReturnLevelAscii(
+	(char*) vm_iter->second.as<std::string>().c_str());
+    }
+    vm_iter = vm.find("export");
+    if (vm_iter != vm.end()) {
+      export_id = vm_iter->second.as<uint16_t>();
+    }
+
+    ::testing::InitGoogleTest(&argc, argv);
+
+    std::thread ganesha(ganesha_server);
+    std::this_thread::sleep_for(5s);
+
+    code  = RUN_ALL_TESTS();
+    ganesha.join();
+  }
+
+  catch(po::error& e) {
+    cout << "Error parsing opts " << e.what() << endl;
+  }
+
+  catch(...) {
+    cout << "Unhandled exception in main()" << endl;
+  }
+
+  return code;
+}
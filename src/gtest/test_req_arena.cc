@@ -0,0 +1,287 @@
+// -*- mode:C; tab-width:8; c-basic-offset:2; indent-tabs-mode:t -*-
+// vim: ts=8 sw=2 smarttab
+/*
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 3 of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA
+ * 02110-1301 USA
+ *
+ * -------------
+ */
+
+/*
+ * malloc calls and time per COMPOUND result, with and without the
+ * request arena.  Each op builds and frees what a SEQUENCE, PUTFH,
+ * READDIR compound allocates: the tag, the result array, the READDIR
+ * entries with their names and encoded fattr4s.  No server is started.
+ */
+
+#include <sys/types.h>
+#include <cstring>
+#include <iostream>
+#include <chrono>
+#include "gtest/gtest.h"
+#include <boost/program_options.hpp>
+
+extern "C" {
+/* Ganesha headers */
+#include "nfs_core.h"
+#include "nfs_proto_tools.h"
+#include "gsh_arena.h"
+
+/* glibc's allocator, under the interposed entry points below */
+extern void *__libc_malloc(size_t);
+extern void *__libc_calloc(size_t, size_t);
+extern void *__libc_realloc(void *, size_t);
+}
+
+namespace {
+
+  uint32_t nops = 100000;
+  uint32_t nentries = 32;
+
+  thread_local bool counting;
+  thread_local uint64_t mallocs;
+
+  struct req_op_context req_ctx;
+  compound_data_t data;
+  struct attrlist attrs;
+  struct bitmap4 request;
+
+  void one_compound()
+  {
+    COMPOUND4res res;
+    entry4 *entries;
+    char name[32];
+    uint32_t i;
+
+    memset(&res, 0, sizeof(res));
+    res.tag.utf8string_len = 7;
+    res.tag.utf8string_val = (char *) req_alloc(8);
+    memcpy(res.tag.utf8string_val, "readdir", 8);
+    res.resarray.resarray_len = 3;
+    res.resarray.resarray_val =
+      (nfs_resop4 *) req_calloc(3, sizeof(nfs_resop4));
+
+    entries = (entry4 *) req_calloc(nentries, sizeof(entry4));
+    for (i = 0; i < nentries; i++) {
+      struct xdr_attrs_args args;
+      int len = snprintf(name, sizeof(name), "file%u", i);
+
+      entries[i].name.utf8string_len = len;
+      entries[i].name.utf8string_val = (char *) req_alloc(len + 1);
+      memcpy(entries[i].name.utf8string_val, name, len + 1);
+
+      memset(&args, 0, sizeof(args));
+      args.attrs = &attrs;
+      args.data = &data;
+      args.fileid = i + 2;
+      EXPECT_EQ(nfs4_FSALattr_To_Fattr(&args, &request,
+				       &entries[i].attrs), 0);
+      if (i != 0)
+	entries[i - 1].nextentry = &entries[i];
+    }
+
+    /* what nfs4_Compound_Free does with the result */
+    for (i = 0; i < nentries; i++) {
+      nfs4_Fattr_Free(&entries[i].attrs);
+      req_free(entries[i].name.utf8string_val);
+    }
+    req_free(entries);
+    req_free(res.resarray.resarray_val);
+    req_free(res.tag.utf8string_val);
+
+    /* the reply is sent */
+    if (req_ctx.arena != NULL)
+      gsh_arena_reset(req_ctx.arena);
+  }
+
+  uint64_t run_ops(struct gsh_arena *arena, uint64_t *count)
+  {
+    req_ctx.arena = arena;
+    mallocs = 0;
+    counting = true;
+    auto start = std::chrono::steady_clock::now();
+
+    for (uint32_t i = 0; i < nops; i++)
+      one_compound();
+
+    auto ns = std::chrono::duration_cast<std::chrono::nanoseconds>(
+      std::chrono::steady_clock::now() - start).count();
+    counting = false;
+    *count = mallocs;
+    req_ctx.arena = nullptr;
+    return ns;
+  }
+
+} /* namespace */
+
+extern "C" {
+  void *malloc(size_t size)
+  {
+    if (counting)
+      mallocs++;
+    return __libc_malloc(size);
+  }
+
+  void *calloc(size_t n, size_t size)
+  {
+    if (counting)
+      mallocs++;
+    return __libc_calloc(n, size);
+  }
+
+  void *realloc(void *ptr, size_t size)
+  {
+    if (counting)
+      mallocs++;
+    return __libc_realloc(ptr, size);
+  }
+}
+
+TEST(REQ_ARENA, INIT)
+{
+  memset(&req_ctx, 0, sizeof(req_ctx));
+  memset(&data, 0, sizeof(data));
+  memset(&attrs, 0, sizeof(attrs));
+  memset(&request, 0, sizeof(request));
+
+  nfs_param.core_param.rpc.max_send_buffer_size = 1048576;
+  data.minorversion = 1;
+  attrs.type = REGULAR_FILE;
+  attrs.filesize = 4096;
+  attrs.numlinks = 1;
+  attrs.mode = 0644;
+
+  set_attribute_in_bitmap(&request, FATTR4_TYPE);
+  set_attribute_in_bitmap(&request, FATTR4_CHANGE);
+  set_attribute_in_bitmap(&request, FATTR4_SIZE);
+  set_attribute_in_bitmap(&request, FATTR4_FILEID);
+  set_attribute_in_bitmap(&request, FATTR4_MODE);
+  set_attribute_in_bitmap(&request, FATTR4_NUMLINKS);
+  set_attribute_in_bitmap(&request, FATTR4_TIME_ACCESS);
+  set_attribute_in_bitmap(&request, FATTR4_TIME_MODIFY);
+
+  /* stashed in tls */
+  op_ctx = &req_ctx;
+}
+
+TEST(REQ_ARENA, MALLOCS_PER_OP)
+{
+  struct gsh_arena arena;
+  uint64_t heap_mallocs, arena_mallocs;
+  uint64_t heap_ns, arena_ns;
+
+  gsh_arena_init(&arena, 0);
+
+  heap_ns = run_ops(nullptr, &heap_mallocs);
+  arena_ns = run_ops(&arena, &arena_mallocs);
+
+  std::cout << nops << " ops of " << nentries << " entries: heap "
+	    << (double) heap_mallocs / nops << " mallocs/op "
+	    << heap_ns / nops << " ns/op, arena "
+	    << (double) arena_mallocs / nops << " mallocs/op "
+	    << arena_ns / nops << " ns/op" << std::endl;
+
+  /* tag, result array, entry array, a name and a fattr4 per entry */
+  EXPECT_GE(heap_mallocs, (uint64_t) nops * (3 + 2 * nentries));
+  /* a default sized compound fits the chunk kept across resets */
+  if (nentries <= 32)
+    EXPECT_EQ(arena.heap_allocs, 1U);
+  EXPECT_LT(arena_mallocs, heap_mallocs);
+
+  gsh_arena_destroy(&arena);
+}
+
+TEST(REQ_ARENA, RESET)
+{
+  struct gsh_arena arena;
+  void *small, *big, *heap;
+
+  gsh_arena_init(&arena, 4096);
+
+  /* a large request gets its own chunk and is freed by the reset */
+  small = gsh_arena_alloc(&arena, 24);
+  big = gsh_arena_alloc(&arena, 65536);
+  heap = gsh_malloc(24);
+  EXPECT_EQ((uintptr_t) small % 16, 0U);
+  EXPECT_EQ((uintptr_t) big % 16, 0U);
+  EXPECT_TRUE(gsh_arena_owns(&arena, small));
+  EXPECT_TRUE(gsh_arena_owns(&arena, big));
+  EXPECT_FALSE(gsh_arena_owns(&arena, heap));
+  EXPECT_EQ(arena.heap_allocs, 2U);
+
+  gsh_arena_reset(&arena);
+  EXPECT_FALSE(gsh_arena_owns(&arena, big));
+  EXPECT_EQ(gsh_arena_alloc(&arena, 24), small);
+
+  /* heap memory passed to req_free is still freed */
+  req_ctx.arena = &arena;
+  req_free(heap);
+  req_ctx.arena = nullptr;
+
+  gsh_arena_destroy(&arena);
+}
+
+int main(int argc, char *argv[])
+{
+  int code = 0;
+
+  using namespace std;
+  namespace po = boost::program_options;
+
+  po::options_description opts("program options");
+  po::variables_map vm;
+
+  try {
+
+    opts.add_options()
+      ("ops", po::value<uint32_t>(),
+	"number of compounds per run")
+
+      ("entries", po::value<uint32_t>(),
+	"READDIR entries per compound")
+      ;
+
+    po::variables_map::iterator vm_iter;
+    po::store(po::parse_command_line(argc, argv, opts), vm);
+    po::notify(vm);
+
+    vm_iter = vm.find("ops");
+    if (vm_iter != vm.end()) {
+      nops = vm_iter->second.as<uint32_t>();
+      if (nops == 0)
+	nops = 1;
+    }
+    vm_iter = vm.find("entries");
+    if (vm_iter != vm.end()) {
+      nentries = vm_iter->second.as<uint32_t>();
+      if (nentries == 0)
+	nentries = 1;
+    }
+
+    ::testing::InitGoogleTest(&argc, argv);
+
+    code  = RUN_ALL_TESTS();
+  }
+
+  catch(po::error& e) {
+    cout << "Error parsing opts " << e.what() << endl;
+  }
+
+  catch(...) {
+    cout << "Unhandled exception in main()" << endl;
+  }
+
+  return code;
+}
@@ -0,0 +1,215 @@
+// -*- mode:C; tab-width:8; c-basic-offset:2; indent-tabs-mode:t -*-
+// vim: ts=8 sw=2 smarttab
+/*
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 3 of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA
+ * 02110-1301 USA
+ *
+ * -------------
+ */
+
+/*
+ * Session reply caching against ca_maxresponsesize_cached: SEQUENCE,
+ * PUTFH, READ replies of a size around the limit are handed to
+ * nfs41_Session_Cache_Reply as nfs4_Compound does for sa_cachethis.
+ * No server is started.
+ */
+
+#include <sys/types.h>
+#include <cstring>
+#include <iostream>
+#include "gtest/gtest.h"
+#include <boost/program_options.hpp>
+
+extern "C" {
+/* Ganesha headers */
+#include "nfs_core.h"
+#include "nfs_proto_functions.h"
+#include "nfs_proto_tools.h"
+#include "sal_data.h"
+#include "sal_functions.h"
+}
+
+namespace {
+
+  uint32_t max_cached = 1024;
+
+  struct req_op_context req_ctx;
+  nfs41_session_t session;
+
+  /* SEQUENCE, PUTFH, READ of read_len bytes, all NFS4_OK */
+  void build_reply(struct COMPOUND4res_extended *res, uint32_t read_len)
+  {
+    COMPOUND4res *compound = &res->res_compound4;
+    READ4res *read;
+
+    memset(res, 0, sizeof(*res));
+    compound->status = NFS4_OK;
+    compound->resarray.resarray_len = 3;
+    compound->resarray.resarray_val =
+      (nfs_resop4 *) req_calloc(3, sizeof(nfs_resop4));
+
+    compound->resarray.resarray_val[0].resop = NFS4_OP_SEQUENCE;
+    compound->resarray.resarray_val[1].resop = NFS4_OP_PUTFH;
+    compound->resarray.resarray_val[2].resop = NFS4_OP_READ;
+
+    read = &compound->resarray.resarray_val[2].nfs_resop4_u.opread;
+    read->status = NFS4_OK;
+    read->READ4res_u.resok4.data.data_len = read_len;
+    read->READ4res_u.resok4.data.data_val = (char *) gsh_malloc(read_len);
+    memset(read->READ4res_u.resok4.data.data_val, 'r', read_len);
+  }
+
+  nfs41_session_slot_t *release(slotid4 slotid)
+  {
+    nfs41_session_slot_t *slot = &session.slots[slotid];
+
+    PTHREAD_MUTEX_lock(&slot->lock);
+    nfs41_Session_Release_Slot(&session, slot);
+    PTHREAD_MUTEX_unlock(&slot->lock);
+    return slot;
+  }
+
+} /* namespace */
+
+TEST(SESSION_CACHE, INIT)
+{
+  memset(&req_ctx, 0, sizeof(req_ctx));
+  memset(&session, 0, sizeof(session));
+
+  session.fore_channel_attrs.ca_maxrequests = 4;
+  session.fore_channel_attrs.ca_maxresponsesize_cached = max_cached;
+  nfs41_Session_Init_Slots(&session);
+
+  /* stashed in tls */
+  op_ctx = &req_ctx;
+}
+
+TEST(SESSION_CACHE, FITS)
+{
+  struct COMPOUND4res_extended res;
+  nfs41_session_slot_t *slot = &session.slots[0];
+
+  build_reply(&res, max_cached / 4);
+
+  EXPECT_TRUE(nfs41_Session_Cache_Reply(&session, 0, &res));
+  EXPECT_EQ(res.res_compound4.status, NFS4_OK);
+  EXPECT_TRUE(slot->cache_used);
+  EXPECT_EQ(slot->cached_result.res_compound4.resarray.resarray_val[2]
+	    .nfs_resop4_u.opread.status, NFS4_OK);
+  EXPECT_LE(slot->cached_size, max_cached);
+  EXPECT_EQ(session.cached_replies, 1U);
+
+  EXPECT_FALSE(release(0)->cache_used);
+  EXPECT_EQ(session.cached_replies, 0U);
+}
+
+TEST(SESSION_CACHE, TOO_BIG)
+{
+  struct COMPOUND4res_extended res;
+  nfs41_session_slot_t *slot = &session.slots[1];
+
+  build_reply(&res, max_cached * 2);
+
+  /* The READ is replaced, and a retry replays that */
+  EXPECT_TRUE(nfs41_Session_Cache_Reply(&session, 1, &res));
+  EXPECT_EQ(res.res_compound4.status, NFS4ERR_REP_TOO_BIG_TO_CACHE);
+  EXPECT_EQ(res.res_compound4.resarray.resarray_len, 3U);
+  EXPECT_EQ(res.res_compound4.resarray.resarray_val[0]
+	    .nfs_resop4_u.opsequence.sr_status, NFS4_OK);
+  EXPECT_EQ(res.res_compound4.resarray.resarray_val[2]
+	    .nfs_resop4_u.opread.status, NFS4ERR_REP_TOO_BIG_TO_CACHE);
+  EXPECT_TRUE(slot->cache_used);
+  EXPECT_EQ(slot->cached_result.res_compound4.status,
+	    NFS4ERR_REP_TOO_BIG_TO_CACHE);
+  EXPECT_LE(slot->cached_size, max_cached);
+
+  release(1);
+}
+
+TEST(SESSION_CACHE, NOTHING_FITS)
+{
+  struct COMPOUND4res_extended res;
+  nfs41_session_slot_t *slot = &session.slots[2];
+
+  /* Not even SEQUENCE alone fits, the slot stays uncached */
+  session.fore_channel_attrs.ca_maxresponsesize_cached = 8;
+  build_reply(&res, 16);
+  res.res_compound4.resarray.resarray_len = 1;
+
+  EXPECT_FALSE(nfs41_Session_Cache_Reply(&session, 2, &res));
+  EXPECT_EQ(res.res_compound4.status, NFS4_OK);
+  EXPECT_FALSE(slot->cache_used);
+
+  res.res_compound4.resarray.resarray_len = 3;
+  nfs4_Compound_Free((nfs_res_t *) &res);
+  session.fore_channel_attrs.ca_maxresponsesize_cached = max_cached;
+}
+
+TEST(SESSION_CACHE, CLEANUP)
+{
+  uint32_t i;
+
+  for (i = 0; i < session.fore_channel_attrs.ca_maxrequests; i++) {
+    release(i);
+    PTHREAD_MUTEX_destroy(&session.slots[i].lock);
+  }
+  gsh_free(session.slots);
+  op_ctx = nullptr;
+}
+
+int main(int argc, char *argv[])
+{
+  int code = 0;
+
+  using namespace std;
+  namespace po = boost::program_options;
+
+  po::options_description opts("program options");
+  po::variables_map vm;
+
+  try {
+
+    opts.add_options()
+      ("max_cached", po::value<uint32_t>(),
+	"ca_maxresponsesize_cached of the session")
+      ;
+
+    po::variables_map::iterator vm_iter;
+    po::store(po::parse_command_line(argc, argv, opts), vm);
+    po::notify(vm);
+
+    vm_iter = vm.find("max_cached");
+    if (vm_iter != vm.end()) {
+      max_cached = vm_iter->second.as<uint32_t>();
+      /* room for SEQUENCE, PUTFH and a READ error */
+      if (max_cached < 256)
+	max_cached = 256;
+    }
+
+    ::testing::InitGoogleTest(&argc, argv);
+
+    code  = RUN_ALL_TESTS();
+  }
+
+  catch(po::error& e) {
+    cout << "Error parsing opts " << e.what() << endl;
+  }
+
+  catch(...) {
+    cout << "Unhandled exception in main()" << endl;
+  }
+
+  return code;
+}
@@ -0,0 +1,286 @@
+// -*- mode:C; tab-width:8; c-basic-offset:2; indent-tabs-mode:t -*-
+// vim: ts=8 sw=2 smarttab
+/*
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 3 of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA
+ * 02110-1301 USA
+ *
+ * -------------
+ */
+
+/*
+ * The writev2 FSAL method with several iovecs, read back with read2.
+ * Meant for an FSAL_MEM export whose Inode_Size is given with
+ * --inode_size: FSAL_MEM keeps that much of a file's data and reads
+ * 'a' past it, so one of the writes crosses that boundary mid iovec.
+ */
+
+#include <sys/types.h>
+#include <sys/uio.h>
+#include <algorithm>
+#include <iostream>
+#include <chrono>
+#include <thread>
+#include "gtest/gtest.h"
+#include <boost/program_options.hpp>
+
+extern "C" {
+/* Ganesha headers */
+#include "nfs_lib.h"
+#include "export_mgr.h"
+#include "nfs_exports.h"
+#include "sal_data.h"
+#include "fsal.h"
+}
+
+#define IOV_COUNT 4
+
+namespace {
+
+  char* ganesha_conf = nullptr;
+  char* lpath = nullptr;
+  int dlevel = -1;
+  uint16_t export_id = 77;
+  uint32_t inode_size = 8192;
+
+  struct req_op_context req_ctx;
+  struct user_cred user_credentials;
+
+  struct gsh_export* a_export = nullptr;
+  struct fsal_obj_handle *root_entry = nullptr;
+  struct fsal_obj_handle *test_file = nullptr;
+  const char *test_name = "writev2_test";
+
+  /* uneven lengths, so the iovecs don't line up with anything */
+  const size_t iov_len[IOV_COUNT] = { 1000, 1500, 2000, 700 };
+
+  int ganesha_server() {
+    return nfs_libmain(
+      ganesha_conf,
+      lpath,
+      dlevel
+      );
+  }
+
+  uint64_t file_size()
+  {
+    struct attrlist attrs;
+    uint64_t size;
+
+    fsal_prepare_attrs(&attrs, ATTR_SIZE);
+    EXPECT_FALSE(FSAL_IS_ERROR(test_file->obj_ops.getattrs(test_file,
+							    &attrs)));
+    size = attrs.filesize;
+    fsal_release_attrs(&attrs);
+    return size;
+  }
+
+  /* writev2 IOV_COUNT iovecs at offset, each filled with its own byte,
+   * and check read2 gives them back as FSAL_MEM keeps them
+   */
+  void write_and_check(uint64_t offset, char fill)
+  {
+    struct iovec iov[IOV_COUNT];
+    size_t total = 0, wrote = 0, read_amount = 0;
+    bool stable = false, eof = false;
+    fsal_status_t status;
+    char *expect, *buffer;
+    int i;
+
+    for (i = 0; i < IOV_COUNT; i++) {
+      iov[i].iov_base = gsh_malloc(iov_len[i]);
+      iov[i].iov_len = iov_len[i];
+      memset(iov[i].iov_base, fill + i, iov_len[i]);
+      total += iov_len[i];
+    }
+
+    status = test_file->obj_ops.writev2(test_file, true, NULL, offset,
+					iov, IOV_COUNT, &wrote, &stable,
+					NULL);
+    ASSERT_FALSE(FSAL_IS_ERROR(status));
+    EXPECT_EQ(wrote, total);
+    EXPECT_GE(file_size(), offset + total);
+
+    /* The iovecs in order, then 'a' from inode_size on */
+    expect = (char *) gsh_malloc(total);
+    buffer = (char *) gsh_malloc(total);
+    for (i = 0, total = 0; i < IOV_COUNT; i++) {
+      memcpy(expect + total, iov[i].iov_base, iov_len[i]);
+      total += iov_len[i];
+    }
+    if (offset + total > inode_size)
+      memset(expect + (offset > inode_size ? 0 : inode_size - offset),
+	     'a', offset + total - std::max(offset, (uint64_t) inode_size));
+
+    status = test_file->obj_ops.read2(test_file, true, NULL, offset,
+				      total, buffer, &read_amount, &eof,
+				      NULL);
+    ASSERT_FALSE(FSAL_IS_ERROR(status));
+    EXPECT_EQ(read_amount, total);
+    EXPECT_EQ(memcmp(buffer, expect, total), 0);
+
+    for (i = 0; i < IOV_COUNT; i++)
+      gsh_free(iov[i].iov_base);
+    gsh_free(expect);
+    gsh_free(buffer);
+  }
+
+} /* namespace */
+
+TEST(WRITEV2, INIT)
+{
+  a_export = get_gsh_export(export_id);
+  ASSERT_NE(a_export, nullptr);
+
+  nfs_export_get_root_entry(a_export, &root_entry);
+  ASSERT_NE(root_entry, nullptr);
+
+  /* Ganesha call paths need real or forged context info */
+  memset(&user_credentials, 0, sizeof(struct user_cred));
+  memset(&req_ctx, 0, sizeof(struct req_op_context));
+
+  req_ctx.ctx_export = a_export;
+  req_ctx.fsal_export = a_export->fsal_export;
+  req_ctx.creds = &user_credentials;
+
+  /* stashed in tls */
+  op_ctx = &req_ctx;
+}
+
+TEST(WRITEV2, CREATE)
+{
+  struct attrlist attrs;
+  fsal_status_t status;
+  bool caller_perm_check = false;
+
+  memset(&attrs, 0, sizeof(attrs));
+  FSAL_SET_MASK(attrs.valid_mask, ATTR_MODE);
+  attrs.mode = 0644;
+
+  status = root_entry->obj_ops.open2(root_entry, NULL, FSAL_O_RDWR,
+				     FSAL_UNCHECKED, test_name, &attrs,
+				     NULL, &test_file, NULL,
+				     &caller_perm_check);
+  ASSERT_FALSE(FSAL_IS_ERROR(status));
+  ASSERT_NE(test_file, nullptr);
+}
+
+TEST(WRITEV2, INSIDE)
+{
+  /* All of it within the data FSAL_MEM keeps, if there is enough */
+  write_and_check(0, 'A');
+}
+
+TEST(WRITEV2, ACROSS_DATASIZE)
+{
+  /* inode_size falls in the third iovec */
+  write_and_check(inode_size > 3000 ? inode_size - 3000 : 0, 'K');
+  EXPECT_EQ(file_size(), (inode_size > 3000 ? inode_size - 3000 : 0) +
+	    5200);
+}
+
+TEST(WRITEV2, PAST_DATASIZE)
+{
+  /* Only the size changes */
+  write_and_check(inode_size + 4096, 'U');
+  EXPECT_EQ(file_size(), (uint64_t) inode_size + 4096 + 5200);
+}
+
+TEST(WRITEV2, CLEANUP)
+{
+  fsal_status_t status;
+
+  test_file->obj_ops.close(test_file);
+  status = root_entry->obj_ops.unlink(root_entry, test_file, test_name);
+  EXPECT_FALSE(FSAL_IS_ERROR(status));
+  test_file->obj_ops.put_ref(test_file);
+  test_file = nullptr;
+}
+
+int main(int argc, char *argv[])
+{
+  int code = 0;
+
+  using namespace std;
+  using namespace std::literals;
+  namespace po = boost::program_options;
+
+  po::options_description opts("program options");
+  po::variables_map vm;
+
+  try {
+
+    opts.add_options()
+      ("config", po::value<string>(),
+	"path to Ganesha conf file")
+
+      ("logfile", po::value<string>(),
+	"log to the provided file path")
+
+      ("export", po::value<uint16_t>(),
+	"id of export on which to operate (must exist)")
+
+      ("inode_size", po::value<uint32_t>(),
+	"Inode_Size of the FSAL_MEM export")
+
+      ("debug", po::value<string>(),
+	"ganesha debug level")
+      ;
+
+    po::variables_map::iterator vm_iter;
+    po::store(po::parse_command_line(argc, argv, opts), vm);
+    po::notify(vm);
+
+    // use config vars--leaves them on the stack
+    vm_iter = vm.find("config");
+    if (vm_iter != vm.end()) {
+      ganesha_conf = (char*) vm_iter->second.as<std::string>().c_str();
+    }
+    vm_iter = vm.find("logfile");
+    if (vm_iter != vm.end()) {
+      lpath = (char*) vm_iter->second.as<std::string>().c_str();
+    }
+    vm_iter = vm.find("debug");
+    if (vm_iter != vm.end()) {
+      dlevel = ReturnLevelAscii(
+	(char*) vm_iter->second.as<std::string>().c_str());
+    }
+    vm_iter = vm.find("export");
+    if (vm_iter != vm.end()) {
+      export_id = vm_iter->second.as<uint16_t>();
+    }
+    vm_iter = vm.find("inode_size");
+    if (vm_iter != vm.end()) {
+      inode_size = vm_iter->second.as<uint32_t>();
+    }
+
+    ::testing::InitGoogleTest(&argc, argv);
+
+    std::thread ganesha(ganesha_server);
+    std::this_thread::sleep_for(5s);
+
+    code  = RUN_ALL_TESTS();
+    ganesha.join();
+  }
+
+  catch(po::error& e) {
+    cout << "Error parsing opts " << e.what() << endl;
+  }
+
+  catch(...) {
+    cout << "Unhandled exception in main()" << endl;
+  }
+
+  return code;
+}
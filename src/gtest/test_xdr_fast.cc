@@ -0,0 +1,399 @@
+// -*- mode:C; tab-width:8; c-basic-offset:2; indent-tabs-mode:t -*-
+// vim: ts=8 sw=2 smarttab
+/*
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 3 of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA
+ * 02110-1301 USA
+ *
+ * -------------
+ */
+
+/*
+ * Fuzz the XDR fast paths against the generic routines.  Random
+ * messages are encoded by both into buffers of random size, which must
+ * succeed or fail together and give the same bytes.  Their encodings,
+ * with random bytes changed and cut short, are decoded by both, which
+ * must again agree, and the results must encode the same.
+ */
+
+#include <sys/types.h>
+#include <cstring>
+#include <iostream>
+#include <random>
+#include "gtest/gtest.h"
+#include <boost/program_options.hpp>
+
+extern "C" {
+/* Ganesha headers */
+#include "gsh_rpc.h"
+#include "nfs23.h"
+#include "nfsv41.h"
+}
+
+namespace {
+
+  uint32_t iterations = 20000;
+  uint32_t seed = 1;
+
+  std::mt19937 rng;
+  char data[4096];
+
+  const u_int BUFSZ = 8192;
+
+  uint32_t rnd(uint32_t max)
+  {
+    return std::uniform_int_distribution<uint32_t>(0, max)(rng);
+  }
+
+  uint64_t rnd64()
+  {
+    return ((uint64_t) rng() << 32) | rng();
+  }
+
+  /* mostly within max, sometimes just over it */
+  u_int rnd_len(u_int max, u_int limit)
+  {
+    return rnd(15) == 0 ? max + 1 + rnd(3) : rnd(limit < max ? limit : max);
+  }
+
+  template <typename T>
+  using xdr_fn = bool (*)(XDR *, T *);
+
+  bool run(xdr_fn<void> fn, void *obj, char *buf, u_int size,
+	   enum xdr_op op, u_int *pos)
+  {
+    XDR xdr;
+    bool ret;
+
+    memset(&xdr, 0, sizeof(xdr));
+    xdrmem_create(&xdr, buf, size, op);
+    ret = fn(&xdr, obj);
+    *pos = XDR_GETPOS(&xdr);
+    xdr_destroy(&xdr);
+    return ret;
+  }
+
+  template <typename T>
+  void check(xdr_fn<T> generic, xdr_fn<T> fast, T *obj)
+  {
+    static char gbuf[BUFSZ], fbuf[BUFSZ], wire[BUFSZ];
+    xdr_fn<void> gfn = (xdr_fn<void>) generic;
+    xdr_fn<void> ffn = (xdr_fn<void>) fast;
+    u_int size, gpos, fpos, len;
+    bool gret, fret;
+    T gobj, fobj;
+
+    /* encode into a full and a random sized buffer */
+    for (int pass = 0; pass < 2; pass++) {
+      size = pass == 0 ? BUFSZ : rnd(BUFSZ / BYTES_PER_XDR_UNIT / 4)
+	* BYTES_PER_XDR_UNIT;
+      memset(gbuf, 0x5a, size);
+      memset(fbuf, 0x5a, size);
+      gret = run(gfn, obj, gbuf, size, XDR_ENCODE, &gpos);
+      fret = run(ffn, obj, fbuf, size, XDR_ENCODE, &fpos);
+      ASSERT_EQ(gret, fret);
+      if (gret) {
+	ASSERT_EQ(gpos, fpos);
+	ASSERT_EQ(memcmp(gbuf, fbuf, gpos), 0);
+      }
+      if (pass == 0 && !gret)
+	return;
+    }
+
+    /* decode the full encoding, changed and cut short */
+    run(gfn, obj, wire, BUFSZ, XDR_ENCODE, &len);
+    if (rnd(1) != 0)
+      for (u_int i = rnd(3); i > 0; i--)
+	wire[rnd(len - 1)] = rnd(255);
+    size = rnd(3) == 0 ? rnd(len / BYTES_PER_XDR_UNIT) * BYTES_PER_XDR_UNIT
+      : len;
+
+    memset(&gobj, 0, sizeof(gobj));
+    memset(&fobj, 0, sizeof(fobj));
+    gret = run(gfn, &gobj, wire, size, XDR_DECODE, &gpos);
+    fret = run(ffn, &fobj, wire, size, XDR_DECODE, &fpos);
+    EXPECT_EQ(gret, fret);
+    if (gret && fret) {
+      EXPECT_EQ(gpos, fpos);
+      EXPECT_TRUE(run(gfn, &gobj, gbuf, BUFSZ, XDR_ENCODE, &gpos));
+      EXPECT_TRUE(run(gfn, &fobj, fbuf, BUFSZ, XDR_ENCODE, &fpos));
+      EXPECT_EQ(gpos, fpos);
+      EXPECT_EQ(memcmp(gbuf, fbuf, gpos), 0);
+    }
+    xdr_free((xdrproc_t) generic, &gobj);
+    xdr_free((xdrproc_t) fast, &fobj);
+  }
+
+  nfsstat4 status4()
+  {
+    return rnd(3) == 0 ? NFS4ERR_NOENT : NFS4_OK;
+  }
+
+  nfsstat3 status3()
+  {
+    return rnd(3) == 0 ? NFS3ERR_NOENT : NFS3_OK;
+  }
+
+  void fill_fattr3(fattr3 *attr)
+  {
+    attr->type = (ftype3) (1 + rnd(6));
+    attr->mode = rng();
+    attr->nlink = rng();
+    attr->uid = rng();
+    attr->gid = rng();
+    attr->size = rnd64();
+    attr->used = rnd64();
+    attr->rdev.specdata1 = rng();
+    attr->rdev.specdata2 = rng();
+    attr->fsid = rnd64();
+    attr->fileid = rnd64();
+    attr->atime.tv_sec = rng();
+    attr->atime.tv_nsec = rng();
+    attr->mtime.tv_sec = rng();
+    attr->mtime.tv_nsec = rng();
+    attr->ctime.tv_sec = rng();
+    attr->ctime.tv_nsec = rng();
+  }
+
+  void fill_post_op_attr(post_op_attr *attr)
+  {
+    attr->attributes_follow = rnd(1);
+    if (attr->attributes_follow)
+      fill_fattr3(&attr->post_op_attr_u.attributes);
+  }
+
+  void fill_wcc_data(wcc_data *wcc)
+  {
+    wcc_attr *before = &wcc->before.pre_op_attr_u.attributes;
+
+    wcc->before.attributes_follow = rnd(1);
+    before->size = rnd64();
+    before->mtime.tv_sec = rng();
+    before->mtime.tv_nsec = rng();
+    before->ctime.tv_sec = rng();
+    before->ctime.tv_nsec = rng();
+    fill_post_op_attr(&wcc->after);
+  }
+
+  void fill_stateid4(stateid4 *stateid)
+  {
+    stateid->seqid = rng();
+    memcpy(stateid->other, data + rnd(64), sizeof(stateid->other));
+  }
+
+} /* namespace */
+
+TEST(XDR_FAST, INIT)
+{
+  rng.seed(seed);
+  for (size_t i = 0; i < sizeof(data); i++)
+    data[i] = rng();
+}
+
+TEST(XDR_FAST, NFSV4_ARGS)
+{
+  for (uint32_t i = 0; i < iterations; i++) {
+    SEQUENCE4args sequence;
+    PUTFH4args putfh;
+    GETATTR4args getattr;
+    LOOKUP4args lookup;
+    ACCESS4args access;
+    READ4args read;
+    WRITE4args write;
+
+    memcpy(sequence.sa_sessionid, data + rnd(64), NFS4_SESSIONID_SIZE);
+    sequence.sa_sequenceid = rng();
+    sequence.sa_slotid = rng();
+    sequence.sa_highest_slotid = rng();
+    sequence.sa_cachethis = rnd(1);
+    check(xdr_SEQUENCE4args, xdr_SEQUENCE4args_fast, &sequence);
+
+    putfh.object.nfs_fh4_len = rnd_len(NFS4_FHSIZE, NFS4_FHSIZE);
+    putfh.object.nfs_fh4_val = data + rnd(64);
+    check(xdr_PUTFH4args, xdr_PUTFH4args_fast, &putfh);
+
+    getattr.attr_request.bitmap4_len = rnd_len(BITMAP4_MAPLEN,
+					       BITMAP4_MAPLEN);
+    for (int j = 0; j < BITMAP4_MAPLEN; j++)
+      getattr.attr_request.map[j] = rng();
+    check(xdr_GETATTR4args, xdr_GETATTR4args_fast, &getattr);
+
+    lookup.objname.utf8string_len = rnd_len(XDR_STRING_MAXLEN, 255);
+    lookup.objname.utf8string_val = data + rnd(64);
+    check(xdr_LOOKUP4args, xdr_LOOKUP4args_fast, &lookup);
+
+    access.access = rng();
+    check(xdr_ACCESS4args, xdr_ACCESS4args_fast, &access);
+
+    fill_stateid4(&read.stateid);
+    read.offset = rnd64();
+    read.count = rng();
+    check(xdr_READ4args, xdr_READ4args_fast, &read);
+
+    fill_stateid4(&write.stateid);
+    write.offset = rnd64();
+    write.stable = (stable_how4) rnd(2);
+    write.data.data_len = rnd(sizeof(data) - 64);
+    write.data.data_val = data + rnd(64);
+    check(xdr_WRITE4args, xdr_WRITE4args_fast, &write);
+  }
+}
+
+TEST(XDR_FAST, NFSV4_RES)
+{
+  for (uint32_t i = 0; i < iterations; i++) {
+    SEQUENCE4res sequence;
+    SEQUENCE4resok *sok = &sequence.SEQUENCE4res_u.sr_resok4;
+    ACCESS4res access;
+    READ4res read;
+    WRITE4res write;
+    WRITE4resok *wok = &write.WRITE4res_u.resok4;
+
+    sequence.sr_status = status4();
+    memcpy(sok->sr_sessionid, data + rnd(64), NFS4_SESSIONID_SIZE);
+    sok->sr_sequenceid = rng();
+    sok->sr_slotid = rng();
+    sok->sr_highest_slotid = rng();
+    sok->sr_target_highest_slotid = rng();
+    sok->sr_status_flags = rng();
+    check(xdr_SEQUENCE4res, xdr_SEQUENCE4res_fast, &sequence);
+
+    access.status = status4();
+    access.ACCESS4res_u.resok4.supported = rng();
+    access.ACCESS4res_u.resok4.access = rng();
+    check(xdr_ACCESS4res, xdr_ACCESS4res_fast, &access);
+
+    read.status = status4();
+    read.READ4res_u.resok4.eof = rnd(1);
+    read.READ4res_u.resok4.data.data_len = rnd(sizeof(data) - 64);
+    read.READ4res_u.resok4.data.data_val = data + rnd(64);
+    check(xdr_READ4res, xdr_READ4res_fast, &read);
+
+    write.status = status4();
+    wok->count = rng();
+    wok->committed = (stable_how4) rnd(2);
+    memcpy(wok->writeverf, data + rnd(64), NFS4_VERIFIER_SIZE);
+    check(xdr_WRITE4res, xdr_WRITE4res_fast, &write);
+  }
+}
+
+TEST(XDR_FAST, NFSV3)
+{
+  for (uint32_t i = 0; i < iterations; i++) {
+    GETATTR3res getattr;
+    LOOKUP3res lookup;
+    LOOKUP3resok *lok = &lookup.LOOKUP3res_u.resok;
+    ACCESS3res access;
+    READ3args read;
+    READ3res readres;
+    WRITE3args write;
+    WRITE3res writeres;
+    WRITE3resok *wok = &writeres.WRITE3res_u.resok;
+
+    getattr.status = status3();
+    fill_fattr3(&getattr.GETATTR3res_u.resok.obj_attributes);
+    check(xdr_GETATTR3res, xdr_GETATTR3res_fast, &getattr);
+
+    lookup.status = status3();
+    lok->object.data.data_len = rnd_len(NFS3_FHSIZE, NFS3_FHSIZE);
+    lok->object.data.data_val = data + rnd(64);
+    fill_post_op_attr(&lok->obj_attributes);
+    fill_post_op_attr(&lok->dir_attributes);
+    if (lookup.status != NFS3_OK)
+      fill_post_op_attr(&lookup.LOOKUP3res_u.resfail.dir_attributes);
+    check(xdr_LOOKUP3res, xdr_LOOKUP3res_fast, &lookup);
+
+    access.status = status3();
+    fill_post_op_attr(&access.ACCESS3res_u.resok.obj_attributes);
+    access.ACCESS3res_u.resok.access = rng();
+    check(xdr_ACCESS3res, xdr_ACCESS3res_fast, &access);
+
+    read.file.data.data_len = rnd_len(NFS3_FHSIZE, NFS3_FHSIZE);
+    read.file.data.data_val = data + rnd(64);
+    read.offset = rnd64();
+    read.count = rng();
+    check(xdr_READ3args, xdr_READ3args_fast, &read);
+
+    readres.status = status3();
+    fill_post_op_attr(&readres.READ3res_u.resok.file_attributes);
+    readres.READ3res_u.resok.count = rng();
+    readres.READ3res_u.resok.eof = rnd(1);
+    readres.READ3res_u.resok.data.data_len = rnd(sizeof(data) - 64);
+    readres.READ3res_u.resok.data.data_val = data + rnd(64);
+    check(xdr_READ3res, xdr_READ3res_fast, &readres);
+
+    write.file.data.data_len = rnd_len(NFS3_FHSIZE, NFS3_FHSIZE);
+    write.file.data.data_val = data + rnd(64);
+    write.offset = rnd64();
+    write.count = rng();
+    write.stable = (stable_how) rnd(2);
+    write.data.data_len = rnd(sizeof(data) - 64);
+    write.data.data_val = data + rnd(64);
+    check(xdr_WRITE3args, xdr_WRITE3args_fast, &write);
+
+    writeres.status = status3();
+    fill_wcc_data(&wok->file_wcc);
+    wok->count = rng();
+    wok->committed = (stable_how) rnd(2);
+    memcpy(wok->verf, data + rnd(64), NFS3_WRITEVERFSIZE);
+    check(xdr_WRITE3res, xdr_WRITE3res_fast, &writeres);
+  }
+}
+
+int main(int argc, char *argv[])
+{
+  int code = 0;
+
+  using namespace std;
+  namespace po = boost::program_options;
+
+  po::options_description opts("program options");
+  po::variables_map vm;
+
+  try {
+
+    opts.add_options()
+      ("iterations", po::value<uint32_t>(),
+	"random messages of each type")
+
+      ("seed", po::value<uint32_t>(),
+	"random seed")
+      ;
+
+    po::variables_map::iterator vm_iter;
+    po::store(po::parse_command_line(argc, argv, opts), vm);
+    po::notify(vm);
+
+    vm_iter = vm.find("iterations");
+    if (vm_iter != vm.end())
+      iterations = vm_iter->second.as<uint32_t>();
+    vm_iter = vm.find("seed");
+    if (vm_iter != vm.end())
+      seed = vm_iter->second.as<uint32_t>();
+
+    ::testing::InitGoogleTest(&argc, argv);
+
+    code  = RUN_ALL_TESTS();
+  }
+
+  catch(po::error& e) {
+    cout << "Error parsing opts " << e.what() << endl;
+  }
+
+  catch(...) {
+    cout << "Unhandled exception in main()" << endl;
+  }
+
+  return code;
+}
@@ -52,10 +52,25 @@
 #include "common_utils.h"
 #include "gsh_rpc.h"
 #include "nfs_core.h"
+#include "fridgethr.h"
 #include "idmapper.h"
 
 static struct gsh_buffdesc owner_domain;
 
+/**
+ * @brief Threads refreshing aging cache entries
+ */
+
+#define IDMAPPER_REFRESH_THREADS 4
+
+/**
+ * @brief Fridge refreshing aging cache entries
+ */
+
+static struct fridgethr *idmapper_fridge;
+
+static void idmapper_refresh(bool, uint32_t, const struct gsh_buffdesc *);
+
 /**
  * @brief Initialize the ID Mapper
  *
@@ -64,6 +79,9 @@ static struct gsh_buffdesc owner_domain;
 
 bool idmapper_init(void)
 {
+	struct fridgethr_params frp;
+	int rc;
+
 #ifdef USE_NFSIDMAP
 	if (!nfs_param.nfsv4_param.use_getpwnam) {
 		if (nfs4_init_name_mapping(nfs_param.nfsv4_param.idmapconf)
@@ -87,9 +105,157 @@ bool idmapper_init(void)
 	}
 
 	idmapper_cache_init();
+
+	memset(&frp, 0, sizeof(struct fridgethr_params));
+	frp.thr_max = IDMAPPER_REFRESH_THREADS;
+	frp.thr_min = 0;
+	frp.flavor = fridgethr_flavor_worker;
+	frp.deferment = fridgethr_defer_queue;
+
+	rc = fridgethr_init(&idmapper_fridge, "Idmap_Refresh", &frp);
+	if (rc != 0) {
+		LogMajor(COMPONENT_IDMAPPER,
+			 "Unable to initialize idmapper refresh fridge, error code %d.",
+			 rc);
+		return false;
+	}
+
+	if (nfs_param.nfsv4_param.idmap_prefetch_file != NULL)
+		(void)idmapper_prefetch(
+			nfs_param.nfsv4_param.idmap_prefetch_file);
+
 	return true;
 }
 
+/**
+ * @brief Stop the cache refresh threads
+ *
+ * @return 0 on success, error code otherwise.
+ */
+
+int idmapper_shutdown(void)
+{
+	int rc;
+
+	if (idmapper_fridge == NULL)
+		return 0;
+
+	rc = fridgethr_sync_command(idmapper_fridge, fridgethr_comm_stop, 120);
+	if (rc == ETIMEDOUT) {
+		LogMajor(COMPONENT_IDMAPPER,
+			 "Shutdown timed out, cancelling threads.");
+		fridgethr_cancel(idmapper_fridge);
+	} else if (rc != 0) {
+		LogMajor(COMPONENT_IDMAPPER,
+			 "Failed shutting down idmapper refresh fridge: %d",
+			 rc);
+	}
+
+	return rc;
+}
+
+/**
+ * @brief Scratch space needed to resolve an ID
+ *
+ * @param[in] group True if this is a GID, false for a UID
+ *
+ * @return Size of the buffer to pass to resolve_id.
+ */
+
+static size_t resolve_id_size(bool group)
+{
+	long size;
+
+	if (!nfs_param.nfsv4_param.use_getpwnam)
+		return NFS4_MAX_DOMAIN_LEN + 2;
+
+	if (group)
+		size = sysconf(_SC_GETGR_R_SIZE_MAX);
+	else
+		size = sysconf(_SC_GETPW_R_SIZE_MAX);
+	if (size == -1)
+		size = PWENT_BEST_GUESS_LEN;
+
+	return size + owner_domain.len + 2;
+}
+
+/**
+ * @brief Ask the password database or nfsidmap for the name of an ID
+ *
+ * @param[in]  id       UID or GID
+ * @param[in]  group    True if this is a GID, false for a UID
+ * @param[in]  namebuff Scratch space of resolve_id_size(group) bytes
+ * @param[in]  size     Size of namebuff
+ * @param[out] name     The name found, within namebuff
+ *
+ * @retval true if the ID was found.
+ * @retval false if it wasn't.
+ */
+
+static bool resolve_id(uint32_t id, bool group, char *namebuff, size_t size,
+		       struct gsh_buffdesc *name)
+{
+	name->addr = namebuff;
+
+	if (nfs_param.nfsv4_param.use_getpwnam) {
+		size_t buflen = size - owner_domain.len - 2;
+		char *cursor;
+		bool nulled;
+		int rc;
+
+		if (group) {
+			struct group g;
+			struct group *gres;
+
+			rc = getgrgid_r(id, &g, namebuff, buflen, &gres);
+			nulled = (gres == NULL);
+		} else {
+			struct passwd p;
+			struct passwd *pres;
+
+			rc = getpwuid_r(id, &p, namebuff, buflen, &pres);
+			nulled = (pres == NULL);
+		}
+
+		if ((rc == 0) && !nulled) {
+			name->len = strlen(namebuff);
+			cursor = namebuff + name->len;
+			*(cursor++) = '@';
+			++name->len;
+			memcpy(cursor, owner_domain.addr, owner_domain.len);
+			name->len += owner_domain.len;
+			return true;
+		}
+
+		LogInfo(COMPONENT_IDMAPPER, "%s failed with code %d.",
+			(group ? "getgrgid_r" : "getpwuid_r"), rc);
+		return false;
+	}
+
+#ifdef USE_NFSIDMAP
+	{
+		int rc;
+
+		if (group) {
+			rc = nfs4_gid_to_name(id, owner_domain.addr, namebuff,
+					      NFS4_MAX_DOMAIN_LEN + 1);
+		} else {
+			rc = nfs4_uid_to_name(id, owner_domain.addr, namebuff,
+					      NFS4_MAX_DOMAIN_LEN + 1);
+		}
+		if (rc == 0) {
+			name->len = strlen(namebuff);
+			return true;
+		}
+
+		LogInfo(COMPONENT_IDMAPPER, "%s failed with code %d.",
+			(group ? "nfs4_gid_to_name" : "nfs4_uid_to_name"), rc);
+	}
+#endif				/* USE_NFSIDMAP */
+
+	return false;
+}
+
 /**
  * @brief Encode a UID or GID as a string
  *
@@ -103,13 +269,21 @@ bool idmapper_init(void)
 
 static bool xdr_encode_nfs4_princ(XDR *xdrs, uint32_t id, bool group)
 {
-	const struct gsh_buffdesc *found;
+	char cached[IDMAPPER_NAME_MAX];
+	struct gsh_buffdesc name = {
+		.addr = cached
+	};
+	enum idmapper_cache_status status;
+	uint32_t flags = IDMAPPER_BY_NAME | IDMAPPER_BY_ID;
 	uint32_t not_a_size_t;
-	bool success = false;
+	char wire[IDMAPPER_OWNER_WIRE_MAX];
+	uint32_t wire_len;
+	char *namebuff;
+	void *buf;
+	size_t size;
 
 	if (nfs_param.nfsv4_param.only_numeric_owners) {
 		/* 2**32 is 10 digits long in decimal */
-		struct gsh_buffdesc name;
 		char namebuf[11];
 
 		name.addr = namebuf;
@@ -120,146 +294,65 @@ static bool xdr_encode_nfs4_princ(XDR *xdrs, uint32_t id, bool group)
 					&not_a_size_t, UINT32_MAX);
 	}
 
-	PTHREAD_RWLOCK_rdlock(group ? &idmapper_group_lock :
-			      &idmapper_user_lock);
+	/* Common case, copy in the string encoded last time */
+	wire_len = idmapper_lookup_owner(id, group, wire);
+	if (likely(wire_len != 0)) {
+		buf = xdr_inline(xdrs, wire_len);
+		if (likely(buf != NULL)) {
+			memcpy(buf, wire, wire_len);
+			return true;
+		}
+	}
+
 	if (group)
-		success = idmapper_lookup_by_gid(id, &found);
+		status = idmapper_lookup_by_gid(id, &name);
 	else
-		success = idmapper_lookup_by_uid(id, &found, NULL);
+		status = idmapper_lookup_by_uid(id, &name);
 
-	if (likely(success)) {
-		not_a_size_t = found->len;
+	if (status == IDMAPPER_CACHE_REFRESH)
+		idmapper_refresh(group, id, NULL);
+
+	if (likely(status != IDMAPPER_CACHE_MISS)) {
+		not_a_size_t = name.len;
 
 		/* Fully qualified owners are always stored in the
 		   hash table, no matter what our lookup method. */
-		success =
-		    inline_xdr_bytes(xdrs, (char **)&found->addr, &not_a_size_t,
-				     UINT32_MAX);
-		PTHREAD_RWLOCK_unlock(group ? &idmapper_group_lock :
-				      &idmapper_user_lock);
-		return success;
-	} else {
-		PTHREAD_RWLOCK_unlock(group ? &idmapper_group_lock :
-				      &idmapper_user_lock);
-		int rc;
-		int size;
-		bool looked_up = false;
-		char *namebuff = NULL;
-		struct gsh_buffdesc new_name;
-
-		if (nfs_param.nfsv4_param.use_getpwnam) {
-			if (group)
-				size = sysconf(_SC_GETGR_R_SIZE_MAX);
-			else
-				size = sysconf(_SC_GETPW_R_SIZE_MAX);
-			if (size == -1)
-				size = PWENT_BEST_GUESS_LEN;
-			new_name.len = size;
-			size += owner_domain.len + 2;
-		} else {
-			size = NFS4_MAX_DOMAIN_LEN + 2;
-		}
-
-		namebuff = alloca(size);
-
-		new_name.addr = namebuff;
-
-		if (nfs_param.nfsv4_param.use_getpwnam) {
-			char *cursor;
-			bool nulled;
-
-			if (group) {
-				struct group g;
-				struct group *gres;
-
-				rc = getgrgid_r(id, &g, namebuff, new_name.len,
-						&gres);
-				nulled = (gres == NULL);
-			} else {
-				struct passwd p;
-				struct passwd *pres;
+		return inline_xdr_bytes(xdrs, (char **)&name.addr,
+					&not_a_size_t, UINT32_MAX);
+	}
 
-				rc = getpwuid_r(id, &p, namebuff, new_name.len,
-						&pres);
-				nulled = (pres == NULL);
-			}
+	size = resolve_id_size(group);
+	namebuff = alloca(size);
 
-			if ((rc == 0) && !nulled) {
-				new_name.len = strlen(namebuff);
-				cursor = namebuff + new_name.len;
-				*(cursor++) = '@';
-				++new_name.len;
-				memcpy(cursor, owner_domain.addr,
-				       owner_domain.len);
-				new_name.len += owner_domain.len;
-				looked_up = true;
-			} else {
-				LogInfo(COMPONENT_IDMAPPER,
-					"%s failed with code %d.",
-					(group ? "getgrgid_r" : "getpwuid_r"),
-					rc);
-			}
+	if (!resolve_id(id, group, namebuff, size, &name)) {
+		if (nfs_param.nfsv4_param.allow_numeric_owners) {
+			LogInfo(COMPONENT_IDMAPPER,
+				"Lookup for %d failed, using numeric %s",
+				id, (group ? "group" : "owner"));
+			/* 2**32 is 10 digits long in decimal */
+			sprintf(namebuff, "%"PRIu32, id);
+			name.len = strlen(namebuff);
 		} else {
-#ifdef USE_NFSIDMAP
-			if (group) {
-				rc = nfs4_gid_to_name(id, owner_domain.addr,
-						      namebuff,
-						      NFS4_MAX_DOMAIN_LEN + 1);
-			} else {
-				rc = nfs4_uid_to_name(id, owner_domain.addr,
-						      namebuff,
-						      NFS4_MAX_DOMAIN_LEN + 1);
-			}
-			if (rc == 0) {
-				new_name.len = strlen(namebuff);
-				looked_up = true;
-			} else {
-				LogInfo(COMPONENT_IDMAPPER,
-					"%s failed with code %d.",
-					(group ? "nfs4_gid_to_name" :
-					"nfs4_uid_to_name"), rc);
-			}
-#else				/* USE_NFSIDMAP */
-			looked_up = false;
-#endif				/* !USE_NFSIDMAP */
+			LogInfo(COMPONENT_IDMAPPER,
+				"Lookup for %d failed, using nobody.",
+				id);
+			memcpy(name.addr, "nobody", 6);
+			name.len = 6;
 		}
+		/* Only remember that this ID has no name, the
+		   fallback name doesn't map back to it. */
+		flags = IDMAPPER_BY_ID | IDMAPPER_NEGATIVE;
+	}
 
-		if (!looked_up) {
-			if (nfs_param.nfsv4_param.allow_numeric_owners) {
-				LogInfo(COMPONENT_IDMAPPER,
-					"Lookup for %d failed, using numeric %s",
-					id, (group ? "group" : "owner"));
-				/* 2**32 is 10 digits long in decimal */
-				sprintf(namebuff, "%"PRIu32, id);
-				new_name.len = strlen(namebuff);
-			} else {
-				LogInfo(COMPONENT_IDMAPPER,
-					"Lookup for %d failed, using nobody.",
-					id);
-				memcpy(new_name.addr, "nobody", 6);
-				new_name.len = 6;
-			}
-		}
+	/* Add to the cache and encode the result. */
+	if (group)
+		(void)idmapper_add_group(&name, id, flags);
+	else
+		(void)idmapper_add_user(&name, id, NULL, flags);
 
-		/* Add to the cache and encode the result. */
-		PTHREAD_RWLOCK_wrlock(group ? &idmapper_group_lock :
-				      &idmapper_user_lock);
-		if (group)
-			success = idmapper_add_group(&new_name, id);
-		else
-			success = idmapper_add_user(&new_name, id, NULL, false);
-
-		PTHREAD_RWLOCK_unlock(group ? &idmapper_group_lock :
-				      &idmapper_user_lock);
-		if (unlikely(!success)) {
-			LogMajor(COMPONENT_IDMAPPER, "%s failed.",
-				 group ? "idmapper_add_group" :
-				 "idmaper_add_user");
-		}
-		not_a_size_t = new_name.len;
-		return inline_xdr_bytes(xdrs, (char **)&new_name.addr,
-					&not_a_size_t, UINT32_MAX);
-	}
+	not_a_size_t = name.len;
+	return inline_xdr_bytes(xdrs, (char **)&name.addr,
+				&not_a_size_t, UINT32_MAX);
 }
 
 /**
@@ -506,6 +599,154 @@ static bool idmapname2id(char *name, size_t len, uint32_t *id,
 #endif				/* USE_NFSIDMAP */
 }
 
+/**
+ * @brief Resolve a name to an ID
+ *
+ * @param[in]  name    The name of the user or group
+ * @param[out] id      The resulting id
+ * @param[in]  anon    ID to use in case of nobody
+ * @param[in]  group   True if this is a group name
+ * @param[out] gid     GID found for a user
+ * @param[out] got_gid Whether a GID was found
+ * @param[out] valid   Set false if the name can't be mapped at all
+ *
+ * @return true if the name was found, false otherwise
+ */
+
+static bool resolve_name(const struct gsh_buffdesc *name, uint32_t *id,
+			 const uint32_t anon, bool group, gid_t *gid,
+			 bool *got_gid, bool *valid)
+{
+	/* Something we can mutate and count on as terminated */
+	char *namebuff = alloca(name->len + 1);
+	char *at;
+
+	memcpy(namebuff, name->addr, name->len);
+	*(namebuff + name->len) = '\0';
+	at = memchr(namebuff, '@', name->len);
+	*valid = true;
+
+	if (at == NULL) {
+		if (pwentname2id(namebuff, name->len, id, anon, group, gid,
+				 got_gid, NULL))
+			return true;
+		if (atless2id(namebuff, name->len, id, anon))
+			return true;
+		*valid = false;
+		return false;
+	} else if (nfs_param.nfsv4_param.use_getpwnam) {
+		return pwentname2id(namebuff, name->len, id, anon, group, gid,
+				    got_gid, at);
+	} else {
+		return idmapname2id(namebuff, name->len, id, anon, group, gid,
+				    got_gid, at);
+	}
+}
+
+/**
+ * @brief A cache entry to resolve again in the background
+ */
+
+struct idmapper_refresh_req {
+	uint32_t id;		/*< ID to resolve, or the ID the name had */
+	bool group;		/*< Group rather than user */
+	bool by_name;		/*< Resolve name rather than id */
+	size_t len;		/*< Length of name */
+	char name[];		/*< Name to resolve */
+};
+
+/**
+ * @brief Resolve an aging cache entry and replace it
+ *
+ * If the lookup fails the old entry is left alone, it keeps being
+ * served until it is twice Idmap_Cache_Timeout old and is then
+ * looked up again inline.
+ *
+ * @param[in] ctx Thread context, arg is the idmapper_refresh_req
+ */
+
+static void idmapper_refresh_run(struct fridgethr_context *ctx)
+{
+	struct idmapper_refresh_req *req = ctx->arg;
+	const uint32_t flags = IDMAPPER_BY_NAME | IDMAPPER_BY_ID;
+
+	if (req->by_name) {
+		struct gsh_buffdesc name = {
+			.addr = req->name,
+			.len = req->len
+		};
+		uint32_t id;
+		gid_t gid;
+		bool got_gid = false;
+		bool valid;
+
+		if (resolve_name(&name, &id, req->id, req->group, &gid,
+				 &got_gid, &valid)) {
+			if (req->group)
+				(void)idmapper_add_group(&name, id, flags);
+			else
+				(void)idmapper_add_user(&name, id,
+							got_gid ? &gid : NULL,
+							flags);
+		} else {
+			LogDebug(COMPONENT_IDMAPPER,
+				 "Refresh of %.*s failed, keeping old mapping",
+				 (int)req->len, req->name);
+		}
+	} else {
+		size_t size = resolve_id_size(req->group);
+		char *namebuff = gsh_malloc(size);
+		struct gsh_buffdesc name;
+
+		if (resolve_id(req->id, req->group, namebuff, size, &name)) {
+			if (req->group)
+				(void)idmapper_add_group(&name, req->id, flags);
+			else
+				(void)idmapper_add_user(&name, req->id, NULL,
+							flags);
+		} else {
+			LogDebug(COMPONENT_IDMAPPER,
+				 "Refresh of %"PRIu32" failed, keeping old mapping",
+				 req->id);
+		}
+
+		gsh_free(namebuff);
+	}
+
+	gsh_free(req);
+}
+
+/**
+ * @brief Queue a background refresh of a cache entry
+ *
+ * @param[in] group True for a group, false for a user
+ * @param[in] id    The ID to resolve, or the ID name maps to now
+ * @param[in] name  The name to resolve, NULL to resolve id
+ */
+
+static void idmapper_refresh(bool group, uint32_t id,
+			     const struct gsh_buffdesc *name)
+{
+	struct idmapper_refresh_req *req;
+	size_t len = name != NULL ? name->len : 0;
+	int rc;
+
+	req = gsh_malloc(sizeof(struct idmapper_refresh_req) + len);
+	req->id = id;
+	req->group = group;
+	req->by_name = name != NULL;
+	req->len = len;
+	if (name != NULL)
+		memcpy(req->name, name->addr, len);
+
+	rc = fridgethr_submit(idmapper_fridge, idmapper_refresh_run, req);
+	if (rc != 0) {
+		LogDebug(COMPONENT_IDMAPPER,
+			 "Unable to queue idmapper refresh: %d", rc);
+		gsh_free(req);
+	}
+}
+
 /**
  * @brief Convert a name to an ID
  *
@@ -520,75 +761,50 @@ static bool idmapname2id(char *name, size_t len, uint32_t *id,
 static bool name2id(const struct gsh_buffdesc *name, uint32_t *id, bool group,
 		    const uint32_t anon)
 {
-	bool success;
+	enum idmapper_cache_status status;
+	uint32_t flags = IDMAPPER_BY_NAME | IDMAPPER_BY_ID;
+	gid_t gid;
+	bool got_gid = false;
+	bool valid;
 
-	PTHREAD_RWLOCK_rdlock(group ? &idmapper_group_lock :
-			      &idmapper_user_lock);
 	if (group)
-		success = idmapper_lookup_by_gname(name, id);
+		status = idmapper_lookup_by_gname(name, id);
 	else
-		success = idmapper_lookup_by_uname(name, id, NULL, false);
-	PTHREAD_RWLOCK_unlock(group ? &idmapper_group_lock :
-			      &idmapper_user_lock);
+		status = idmapper_lookup_by_uname(name, id, NULL, NULL);
 
-	if (success)
+	switch (status) {
+	case IDMAPPER_CACHE_REFRESH:
+		idmapper_refresh(group, *id, name);
+		/* fall through */
+	case IDMAPPER_CACHE_HIT:
 		return true;
-	else {
-		gid_t gid;
-		bool got_gid = false;
-		/* Something we can mutate and count on as terminated */
-		char *namebuff = alloca(name->len + 1);
-		char *at;
-		bool looked_up = false;
-
-		memcpy(namebuff, name->addr, name->len);
-		*(namebuff + name->len) = '\0';
-		at = memchr(namebuff, '@', name->len);
-
-		if (at == NULL) {
-			if (pwentname2id
-			    (namebuff, name->len, id, anon, group, &gid,
-			     &got_gid, NULL))
-				looked_up = true;
-			else if (atless2id(namebuff, name->len, id, anon))
-				looked_up = true;
-			else
-				return false;
-		} else if (nfs_param.nfsv4_param.use_getpwnam) {
-			looked_up =
-			    pwentname2id(namebuff, name->len, id, anon, group,
-					 &gid, &got_gid, at);
-		} else {
-			looked_up =
-			    idmapname2id(namebuff, name->len, id, anon, group,
-					 &gid, &got_gid, at);
-		}
+	case IDMAPPER_CACHE_NEGATIVE:
+		*id = anon;
+		return true;
+	case IDMAPPER_CACHE_MISS:
+		break;
+	}
 
-		if (!looked_up) {
-			LogInfo(COMPONENT_IDMAPPER,
-				"All lookups failed for %s, using anonymous.",
-				namebuff);
-			*id = anon;
-		}
+	if (!resolve_name(name, id, anon, group, &gid, &got_gid, &valid)) {
+		if (!valid)
+			return false;
 
-		PTHREAD_RWLOCK_wrlock(group ? &idmapper_group_lock :
-				      &idmapper_user_lock);
-		if (group)
-			success = idmapper_add_group(name, *id);
-		else
-			success =
-			    idmapper_add_user(name, *id, got_gid ? &gid : NULL,
-					      false);
+		LogInfo(COMPONENT_IDMAPPER,
+			"All lookups failed for %.*s, using anonymous.",
+			(int)name->len, (char *)name->addr);
+		*id = anon;
+		/* Anonymous differs between exports, only remember
+		   that the name has no ID. */
+		flags = IDMAPPER_BY_NAME | IDMAPPER_NEGATIVE;
+	}
 
-		PTHREAD_RWLOCK_unlock(group ? &idmapper_group_lock :
-				      &idmapper_user_lock);
+	if (group)
+		(void)idmapper_add_group(name, *id, flags);
+	else
+		(void)idmapper_add_user(name, *id, got_gid ? &gid : NULL,
+					flags);
 
-		if (!success)
-			LogMajor(COMPONENT_IDMAPPER, "%s(%s %u) failed",
-				 (group ? "gidmap_add" : "uidmap_add"),
-				 namebuff, *id);
-		return true;
-	}
+	return true;
 }
 
 /**
@@ -648,7 +864,8 @@ bool principal2uid(char *principal, uid_t *uid, gid_t *gid)
 #ifdef USE_NFSIDMAP
 	uid_t gss_uid = -1;
 	gid_t gss_gid = -1;
-	const gid_t *gss_gidres = NULL;
+	enum idmapper_cache_status status;
+	bool gid_set = false;
 	int rc;
 	bool success;
 	struct gsh_buffdesc princbuff = {
@@ -661,18 +878,20 @@ bool principal2uid(char *principal, uid_t *uid, gid_t *gid)
 		return false;
 
 #ifdef USE_NFSIDMAP
-	PTHREAD_RWLOCK_rdlock(&idmapper_user_lock);
-	success =
-	    idmapper_lookup_by_uname(&princbuff, &gss_uid, &gss_gidres, true);
+	status = idmapper_lookup_by_uname(&princbuff, &gss_uid, &gss_gid,
+					  &gid_set);
+
+	/* A plain owner mapping for the same name ages like any
+	 * other, principals themselves are never refreshed.
+	 */
+	if (status == IDMAPPER_CACHE_REFRESH)
+		idmapper_refresh(false, gss_uid, &princbuff);
 
 	/* We do need uid and gid. If gid is not in the cache, treat it as a
 	 * failure.
 	 */
-	if (success && gss_gidres != NULL)
-		gss_gid = *gss_gidres;
-	else
-		success = false;
-	PTHREAD_RWLOCK_unlock(&idmapper_user_lock);
+	success = (status == IDMAPPER_CACHE_HIT ||
+		   status == IDMAPPER_CACHE_REFRESH) && gid_set;
 	if (unlikely(!success)) {
 		if ((princbuff.len >= 4)
 		    && (!memcmp(princbuff.addr, "nfs/", 4)
@@ -770,16 +989,8 @@ bool principal2uid(char *principal, uid_t *uid, gid_t *gid)
  principal_found:
 #endif
 
-		PTHREAD_RWLOCK_wrlock(&idmapper_user_lock);
-		success =
-		    idmapper_add_user(&princbuff, gss_uid, &gss_gid, true);
-		PTHREAD_RWLOCK_unlock(&idmapper_user_lock);
-
-		if (!success) {
-			LogMajor(COMPONENT_IDMAPPER,
-				 "idmapper_add_user(%s, %d, %d) failed",
-				 principal, gss_uid, gss_gid);
-		}
+		(void)idmapper_add_user(&princbuff, gss_uid, &gss_gid,
+					IDMAPPER_BY_NAME | IDMAPPER_PRINCIPAL);
 	}
 
 	*uid = gss_uid;
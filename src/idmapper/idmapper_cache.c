@@ -34,99 +34,143 @@
 #include "config.h"
 #include "log.h"
 #include "config_parsing.h"
+#include <stdio.h>
+#include <stdlib.h>
 #include <string.h>
+#include <errno.h>
+#include <arpa/inet.h>
 #include <pwd.h>
 #include <grp.h>
 #include "gsh_intrinsic.h"
 #include "gsh_types.h"
 #include "common_utils.h"
 #include "avltree.h"
+#include "gsh_list.h"
 #include "idmapper.h"
 #include "abstract_atomic.h"
+#include "nfs_core.h"
+#include "city.h"
 
 /**
- * @brief User entry in the IDMapper cache
+ * @brief Entry in one of the IDMapper cache tables
+ *
+ * The same structure serves the name to ID and the ID to name
+ * tables, each mapping is cached separately in each direction.
  */
 
-struct cache_user {
-	struct gsh_buffdesc uname;	/*< Username */
-	uid_t uid;		/*< Corresponding UID */
-	gid_t gid;		/*< Corresponding GID */
+struct cache_entry {
+	struct avltree_node node;	/*< Node in the shard tree */
+	struct glist_head age;	/*< Place in the shard's age list */
+	struct gsh_buffdesc name;	/*< User or group name */
+	uint32_t id;		/*< Corresponding UID or GID */
+	gid_t gid;		/*< Primary GID of a user, by name only */
 	bool gid_set;		/*< if the GID has been set */
-	struct avltree_node uname_node;	/*< Node in the name tree */
-	struct avltree_node uid_node;	/*< Node in the UID tree */
-	bool in_uidtree;		/* true iff this is in uid_tree */
+	uint32_t flags;		/*< IDMAPPER_NEGATIVE, IDMAPPER_PRINCIPAL */
+	uint32_t refreshing;	/*< Set once a refresh has been handed out */
+	time_t epoch;		/*< When the mapping was resolved */
 };
 
 /**
- * @brief Group entry in the IDMapper cache
+ * @brief Number of shards per table, must be a power of 2.
  */
 
-struct cache_group {
-	struct gsh_buffdesc gname;	/*< Group name */
-	gid_t gid;		/*< Group ID */
-	struct avltree_node gname_node;	/*< Node in the name tree */
-	struct avltree_node gid_node;	/*< Node in the GID tree */
-};
+#define IDMAPPER_SHARDS 16
+
+/**
+ * @brief A shard of a cache table
+ *
+ * Each shard has its own lock, so lookups of unrelated names and IDs
+ * never contend, and a writer only blocks readers of its own shard.
+ *
+ * Entries are also kept on one of two lists in the order they were
+ * inserted, which is the order of their epochs.  Negative and positive
+ * entries age at different rates, so each has its own list, and the
+ * expired ones of either kind are found at the head of its list.
+ */
+
+struct cache_shard {
+	pthread_rwlock_t lock;	/*< Protects all below and the entries */
+	struct avltree tree;	/*< Entries, by name or by ID */
+	struct glist_head positive;	/*< Mappings, oldest first */
+	struct glist_head negative;	/*< Failed lookups, oldest first */
+	uint32_t count;		/*< Entries in tree */
+} __attribute__ ((__aligned__(GSH_CACHE_LINE_SIZE)));
 
 /**
- * @brief Number of entires in the UID cache, should be prime.
+ * @brief Number of owner string slots per table, must be a power of 2.
  */
 
-#define id_cache_size 1009
+#define IDMAPPER_OWNER_SLOTS 2048
 
 /**
- * @brief UID cache, may only be accessed with idmapper_user_lock
- * held.  If idmapper_user_lock is held for read, it must be accessed
- * atomically.  (For a write, normal fetch/store is sufficient since
- * others are kept out.)
+ * @brief A preformatted owner or group string
+ *
+ * Encoding an owner is a lookup in a direct-mapped array of these
+ * and a copy, without taking any lock.  Slots are written under a
+ * sequence count, which is odd while a writer is in the slot; a
+ * reader that sees it odd or changed falls back to the cache tables.
+ */
+
+struct owner_slot {
+	uint32_t seq;		/*< Odd while the slot is being written */
+	uint32_t id;		/*< UID or GID */
+	uint32_t generation;	/*< owner_generation when written */
+	uint32_t len;		/*< Bytes of wire in use */
+	time_t expire;		/*< When to look the ID up again, 0 never */
+	char wire[IDMAPPER_OWNER_WIRE_MAX];	/*< Length word, name and
+						    padding, as encoded */
+};
+
+/**
+ * @brief Owner strings, by UID
  */
 
-static struct avltree_node *uid_cache[id_cache_size];
+static struct owner_slot owner_slots[IDMAPPER_OWNER_SLOTS];
 
 /**
- * @brief GID cache, may only be accessed with idmapper_group_lock
- * held.  If idmapper_group_lock is held for read, it must be accessed
- * atomically.  (For a write, normal fetch/store is sufficient since
- * others are kept out.)
+ * @brief Group strings, by GID
  */
 
-static struct avltree_node *gid_cache[id_cache_size];
+static struct owner_slot group_slots[IDMAPPER_OWNER_SLOTS];
 
 /**
- * @brief Lock that protects the idmapper user cache
+ * @brief Bumped whenever the cache is cleared, invalidating all slots
  */
 
-pthread_rwlock_t idmapper_user_lock = PTHREAD_RWLOCK_INITIALIZER;
+static uint32_t owner_generation = 1;
 
 /**
- * @brief Lock that protects the idmapper group cache
+ * @brief A sharded cache table
  */
 
-pthread_rwlock_t idmapper_group_lock = PTHREAD_RWLOCK_INITIALIZER;
+struct cache_table {
+	struct cache_shard shards[IDMAPPER_SHARDS];
+	struct owner_slot *slots;	/*< Owner strings, for ID tables */
+};
 
 /**
- * @brief Tree of users, by name
+ * @brief Users by name
  */
 
-static struct avltree uname_tree;
+static struct cache_table uname_table;
 
 /**
- * @brief Tree of users, by ID
+ * @brief Users by ID
  */
 
-static struct avltree uid_tree;
+static struct cache_table uid_table;
 
 /**
- * @brief Tree of groups, by name
+ * @brief Groups by name
  */
-static struct avltree gname_tree;
+
+static struct cache_table gname_table;
 
 /**
- * @brief Tree of groups, by ID
+ * @brief Groups by ID
  */
 
-static struct avltree gid_tree;
+static struct cache_table gid_table;
 
 /**
  * @brief Compare two buffers
@@ -160,7 +204,7 @@ static inline int buffdesc_comparator(const struct gsh_buffdesc *buffa,
 }
 
 /**
- * @brief Comparison for user names
+ * @brief Comparison for names
  *
  * @param[in] node1 A node
  * @param[in] nodea Another node
@@ -170,21 +214,19 @@ static inline int buffdesc_comparator(const struct gsh_buffdesc *buffa,
  * @retval 1 if node1 is greater than nodea
  */
 
-static int uname_comparator(const struct avltree_node *node1,
-			    const struct avltree_node *nodea)
+static int name_comparator(const struct avltree_node *node1,
+			   const struct avltree_node *nodea)
 {
-	struct cache_user *user1 =
-	    avltree_container_of(node1, struct cache_user,
-				 uname_node);
-	struct cache_user *usera =
-	    avltree_container_of(nodea, struct cache_user,
-				 uname_node);
-
-	return buffdesc_comparator(&user1->uname, &usera->uname);
+	struct cache_entry *entry1 =
+	    avltree_container_of(node1, struct cache_entry, node);
+	struct cache_entry *entrya =
+	    avltree_container_of(nodea, struct cache_entry, node);
+
+	return buffdesc_comparator(&entry1->name, &entrya->name);
 }
 
 /**
- * @brief Comparison for UIDs
+ * @brief Comparison for UIDs and GIDs
  *
  * @param[in] node1 A node
  * @param[in] nodea Another node
@@ -194,75 +236,71 @@ static int uname_comparator(const struct avltree_node *node1,
  * @retval 1 if node1 is greater than nodea
  */
 
-static int uid_comparator(const struct avltree_node *node1,
-			  const struct avltree_node *nodea)
+static int id_comparator(const struct avltree_node *node1,
+			 const struct avltree_node *nodea)
 {
-	struct cache_user *user1 =
-	    avltree_container_of(node1, struct cache_user,
-				 uid_node);
-	struct cache_user *usera =
-	    avltree_container_of(nodea, struct cache_user,
-				 uid_node);
-
-	if (user1->uid < usera->uid)
+	struct cache_entry *entry1 =
+	    avltree_container_of(node1, struct cache_entry, node);
+	struct cache_entry *entrya =
+	    avltree_container_of(nodea, struct cache_entry, node);
+
+	if (entry1->id < entrya->id)
 		return -1;
-	else if (user1->uid > usera->uid)
+	else if (entry1->id > entrya->id)
 		return 1;
 	else
 		return 0;
 }
 
 /**
- * @brief Comparison for group names
+ * @brief Find the shard holding a name
  *
- * @param[in] node1 A node
- * @param[in] nodea Another node
+ * @param[in] table The table
+ * @param[in] name  The name
  *
- * @retval -1 if node1 is less than nodea
- * @retval 0 if node1 and nodea are equal
- * @retval 1 if node1 is greater than nodea
+ * @return The shard.
  */
 
-static inline int gname_comparator(const struct avltree_node *node1,
-				   const struct avltree_node *nodea)
+static inline struct cache_shard *name_shard(struct cache_table *table,
+					     const struct gsh_buffdesc *name)
 {
-	struct cache_group *group1 =
-	    avltree_container_of(node1, struct cache_group,
-				 gname_node);
-	struct cache_group *groupa =
-	    avltree_container_of(nodea, struct cache_group,
-				 gname_node);
-
-	return buffdesc_comparator(&group1->gname, &groupa->gname);
+	return &table->shards[CityHash64(name->addr, name->len) &
+			      (IDMAPPER_SHARDS - 1)];
 }
 
 /**
- * @brief Comparison for GIDs
+ * @brief Find the shard holding an ID
  *
- * @param[in] node1 A node
- * @param[in] nodea Another node
+ * @param[in] table The table
+ * @param[in] id    The UID or GID
  *
- * @retval -1 if node1 is less than nodea
- * @retval 0 if node1 and nodea are equal
- * @retval 1 if node1 is greater than nodea
+ * @return The shard.
  */
 
-static int gid_comparator(const struct avltree_node *node1,
-			  const struct avltree_node *nodea)
+static inline struct cache_shard *id_shard(struct cache_table *table,
+					   uint32_t id)
 {
-	struct cache_group *group1 =
-	    avltree_container_of(node1, struct cache_group,
-				 gid_node);
-	struct cache_group *groupa =
-	    avltree_container_of(nodea, struct cache_group,
-				 gid_node);
-
-	if (group1->gid < groupa->gid)
-		return -1;
-	else if (group1->gid > groupa->gid)
-		return 1;
-	else
-		return 0;
+	return &table->shards[id & (IDMAPPER_SHARDS - 1)];
+}
+
+/**
+ * @brief Initialize a cache table
+ *
+ * @param[in] table      The table
+ * @param[in] comparator Name or ID comparator
+ */
+
+static void table_init(struct cache_table *table, avltree_cmp_fn_t comparator)
+{
+	int i;
+
+	for (i = 0; i < IDMAPPER_SHARDS; i++) {
+		PTHREAD_RWLOCK_init(&table->shards[i].lock, NULL);
+		avltree_init(&table->shards[i].tree, comparator, 0);
+		glist_init(&table->shards[i].positive);
+		glist_init(&table->shards[i].negative);
+		table->shards[i].count = 0;
+	}
 }
 
 /**
@@ -271,398 +309,598 @@ static int gid_comparator(const struct avltree_node *node1,
 
 void idmapper_cache_init(void)
 {
-	avltree_init(&uname_tree, uname_comparator, 0);
-	avltree_init(&uid_tree, uid_comparator, 0);
-	memset(uid_cache, 0, id_cache_size * sizeof(struct avltree_node *));
+	table_init(&uname_table, name_comparator);
+	table_init(&uid_table, id_comparator);
+	table_init(&gname_table, name_comparator);
+	table_init(&gid_table, id_comparator);
 
-	avltree_init(&gname_tree, gname_comparator, 0);
-	avltree_init(&gid_tree, gid_comparator, 0);
-	memset(gid_cache, 0, id_cache_size * sizeof(struct avltree_node *));
+	uid_table.slots = owner_slots;
+	gid_table.slots = group_slots;
 }
 
 /**
- * @brief Add a user entry to the cache
+ * @brief When a cached mapping stops being fresh
+ *
+ * @param[in] entry The cached entry
  *
- * @note The caller must hold idmapper_user_lock for write.
+ * @return The time, or 0 if it never expires.
+ */
+
+static time_t entry_fresh_until(struct cache_entry *entry)
+{
+	time_t ttl;
+
+	if (entry->flags & IDMAPPER_NEGATIVE)
+		return entry->epoch +
+			nfs_param.nfsv4_param.idmap_negative_cache_timeout;
+
+	ttl = nfs_param.nfsv4_param.idmap_cache_timeout;
+	if (ttl == 0)
+		return 0;
+
+	return entry->epoch + ttl - ttl / 4;
+}
+
+/**
+ * @brief Publish the encoded name of an ID entry
  *
- * @param[in] name The user name
- * @param[in] uid  The user ID
- * @param[in] gid  Optional.  Set to NULL if no gid is known.
- * @param[in] gss_princ true when name is gss principal.
- *                      The uid to name map is not added for gss principals.
+ * The slot is only good while the entry is fresh, after that encoding
+ * goes through the cache tables, which take care of refreshing it.
  *
- * @retval true on success.
- * @retval false if our reach exceeds our grasp.
+ * @param[in] slots The owner or group slots
+ * @param[in] entry The entry, by ID
  */
 
-bool idmapper_add_user(const struct gsh_buffdesc *name, uid_t uid,
-		       const gid_t *gid, bool gss_princ)
+static void owner_publish(struct owner_slot *slots, struct cache_entry *entry)
 {
-	struct avltree_node *found_name;
-	struct avltree_node *found_id;
-	struct cache_user *old;
-	struct cache_user *new;
-
-	new = gsh_malloc(sizeof(struct cache_user) + name->len);
-
-	new->uname.addr = (char *)new + sizeof(struct cache_user);
-	new->uname.len = name->len;
-	new->uid = uid;
-	memcpy(new->uname.addr, name->addr, name->len);
-	if (gid) {
-		new->gid = *gid;
-		new->gid_set = true;
-	} else {
-		new->gid = -1;
-		new->gid_set = false;
-	}
-	new->in_uidtree = (gss_princ) ? false : true;
-
-	/*
-	 * There are 3 cases why we find an existing cache entry.
-	 *
-	 * Case 1:
-	 * The threads that lookup by-name or by-id use the read lock.
-	 * If they don't find an entry, then they release the read lock,
-	 * acquire the write lock and then add the entry. So it is
-	 * possible that multiple threads may fail to find an entry at
-	 * one point and they all try to add. In this case, we will be
-	 * trying to insert same name,id mapping.
-	 *
-	 * Case 2:
-	 * It is also possible that name got a different id or an id got
-	 * a different name causing us to find an existing entry when we
-	 * are trying to add an entry. This case calls for removing the
-	 * stale entry and update with this new entry.
-	 *
-	 * Case 3:
-	 * The username to id mapping could be from plain nfs idmapping
-	 * in which case we will not have a valid gid. If this is for a
-	 * kerberos principal mapping, we will have uid and gid but we
-	 * will not have "uid to name" cache entry (the reverse
-	 * mapping). This case requires us to combine the old entry and
-	 * the new entry!
-	 *
-	 * Note that the 3rd case happens if and only if IDMAPD_DOMAIN
-	 * and LOCAL_REALMS are set to the same value!
-	 */
-	found_name = avltree_insert(&new->uname_node, &uname_tree);
-	if (unlikely(found_name)) {
-		old = avltree_container_of(found_name, struct cache_user,
-					   uname_node);
-		/* Combine old into new if uid's match */
-		if (old->uid == new->uid) {
-			if (!new->gid_set && old->gid_set) {
-				new->gid = old->gid;
-				new->gid_set = true;
-			}
-			if (!new->in_uidtree && old->in_uidtree)
-				new->in_uidtree = true;
-		}
+	struct owner_slot *slot;
+	uint32_t len = entry->name.len;
+	uint32_t wire_len = sizeof(uint32_t) + ((len + 3) & ~3);
+	uint32_t word = htonl(len);
+
+	if (wire_len > IDMAPPER_OWNER_WIRE_MAX)
+		return;
+
+	/* Slots map onto shards, so the caller's shard lock keeps
+	   older entries from overwriting newer ones. */
+	slot = &slots[entry->id & (IDMAPPER_OWNER_SLOTS - 1)];
+
+	/* Someone else is writing this slot, leave it to them */
+	if (atomic_postset_uint32_t_bits(&slot->seq, 1) & 1)
+		return;
+
+	slot->id = entry->id;
+	slot->generation = atomic_fetch_uint32_t(&owner_generation);
+	slot->len = wire_len;
+	slot->expire = entry_fresh_until(entry);
+	memcpy(slot->wire, &word, sizeof(word));
+	memcpy(slot->wire + sizeof(word), entry->name.addr, len);
+	memset(slot->wire + sizeof(word) + len, 0,
+	       wire_len - sizeof(word) - len);
+
+	atomic_inc_uint32_t(&slot->seq);
+}
 
-		/* Remove the old and insert the new */
-		avltree_remove(found_name, &uname_tree);
-		if (old->in_uidtree) {
-			uid_cache[old->uid % id_cache_size] = NULL;
-			avltree_remove(&old->uid_node, &uid_tree);
-		}
-		gsh_free(old);
-		found_name = avltree_insert(&new->uname_node, &uname_tree);
-		assert(found_name == NULL);
-	}
+/**
+ * @brief Copy out the encoded owner or group string for an ID
+ *
+ * @param[in]  id    UID or GID
+ * @param[in]  group True if this is a GID, false for a UID
+ * @param[out] wire  Buffer of IDMAPPER_OWNER_WIRE_MAX bytes
+ *
+ * @return Bytes copied to wire, 0 if the ID has to be looked up.
+ */
 
-	if (!new->in_uidtree) /* all done */
-		return true;
-
-	found_id = avltree_insert(&new->uid_node, &uid_tree);
-	if (unlikely(found_id)) {
-		old = avltree_container_of(found_id, struct cache_user,
-					   uid_node);
-		uid_cache[old->uid % id_cache_size] = NULL;
-		avltree_remove(found_id, &uid_tree);
-		avltree_remove(&old->uname_node, &uname_tree);
-		gsh_free(old);
-		found_id = avltree_insert(&new->uid_node, &uid_tree);
-		assert(found_id == NULL);
-	}
-	uid_cache[uid % id_cache_size] = &new->uid_node;
+uint32_t idmapper_lookup_owner(uint32_t id, bool group, char *wire)
+{
+	struct owner_slot *slot = &(group ? group_slots : owner_slots)
+					[id & (IDMAPPER_OWNER_SLOTS - 1)];
+	uint32_t seq = atomic_fetch_uint32_t(&slot->seq);
+	uint32_t len;
 
-	return true;
+	if (seq & 1)
+		return 0;
+
+	len = slot->len;
+	if (slot->id != id || len == 0 || len > IDMAPPER_OWNER_WIRE_MAX ||
+	    slot->generation != atomic_fetch_uint32_t(&owner_generation) ||
+	    (slot->expire != 0 && slot->expire <= time(NULL)))
+		return 0;
+
+	memcpy(wire, slot->wire, len);
+
+	/* The copy must be complete before the count is checked */
+	__sync_synchronize();
+	if (atomic_fetch_uint32_t(&slot->seq) != seq)
+		return 0;
+
+	return len;
 }
 
 /**
- * @brief Add a group entry to the cache
+ * @brief Decide whether a cached mapping may be used
  *
- * @note The caller must hold idmapper_group_lock for write.
+ * Positive mappings are fresh for the first three quarters of
+ * Idmap_Cache_Timeout.  After that the first reader is told to
+ * refresh the entry in the background while everyone keeps using it,
+ * up to twice the timeout, after which the lookup is done again
+ * inline.  Negative mappings and GSS principals are never refreshed,
+ * they simply expire.
  *
- * @param[in] name The user name
- * @param[in] gid  The group id
+ * @note The caller must hold the shard lock for read.
  *
- * @retval true on success.
- * @retval false if our reach exceeds our grasp.
+ * @param[in] entry The cached entry
+ *
+ * @return How the caller should treat the entry.
  */
 
-bool idmapper_add_group(const struct gsh_buffdesc *name, const gid_t gid)
+static enum idmapper_cache_status entry_status(struct cache_entry *entry)
 {
-	struct avltree_node *found_name;
-	struct avltree_node *found_id;
-	struct cache_group *tmp;
-	struct cache_group *new;
-
-	new = gsh_malloc(sizeof(struct cache_group) + name->len);
-
-	new->gname.addr = (char *)new + sizeof(struct cache_group);
-	new->gname.len = name->len;
-	new->gid = gid;
-	memcpy(new->gname.addr, name->addr, name->len);
-
-	/*
-	 * The threads that lookup by-name or by-id use the read lock. If
-	 * they don't find an entry, then they release the read lock,
-	 * acquire the write lock and then add the entry. So it is
-	 * possible that multiple threads may fail to find an entry at
-	 * one point and they all try to add. In this case, we will be
-	 * trying to insert same name,id mapping. It is also possible
-	 * that name got a different id or an id got a different name
-	 * causing us to find an existing entry when we are trying to
-	 * add an entry!
-	 *
-	 * If we find an existing entry, we remove it from both the name
-	 * and the id AVL trees, and then add the new entry.
-	 */
-	found_name = avltree_insert(&new->gname_node, &gname_tree);
-	if (unlikely(found_name)) {
-		tmp = avltree_container_of(found_name, struct cache_group,
-					   gname_node);
-		avltree_remove(found_name, &gname_tree);
-		avltree_remove(&tmp->gid_node, &gid_tree);
-		gid_cache[tmp->gid % id_cache_size] = NULL;
-		gsh_free(tmp);
-		found_name = avltree_insert(&new->gname_node, &gname_tree);
-		assert(found_name == NULL);
-	}
+	time_t age = time(NULL) - entry->epoch;
+	time_t ttl;
 
-	found_id = avltree_insert(&new->gid_node, &gid_tree);
-	if (unlikely(found_id)) {
-		tmp = avltree_container_of(found_id, struct cache_group,
-					   gid_node);
-
-		gid_cache[tmp->gid % id_cache_size] = NULL;
-		avltree_remove(found_id, &gid_tree);
-		avltree_remove(&tmp->gname_node, &gname_tree);
-		gsh_free(tmp);
-		found_id = avltree_insert(&new->gid_node, &gid_tree);
-		assert(found_id == NULL);
+	if (entry->flags & IDMAPPER_NEGATIVE) {
+		ttl = nfs_param.nfsv4_param.idmap_negative_cache_timeout;
+		return age < ttl ? IDMAPPER_CACHE_NEGATIVE
+				 : IDMAPPER_CACHE_MISS;
 	}
-	gid_cache[gid % id_cache_size] = &new->gid_node;
 
-	return true;
+	ttl = nfs_param.nfsv4_param.idmap_cache_timeout;
+	if (ttl == 0 || age < ttl - ttl / 4)
+		return IDMAPPER_CACHE_HIT;
+
+	if (entry->flags & IDMAPPER_PRINCIPAL)
+		return age < ttl ? IDMAPPER_CACHE_HIT : IDMAPPER_CACHE_MISS;
+
+	if (age >= 2 * ttl)
+		return IDMAPPER_CACHE_MISS;
+
+	if (atomic_postset_uint32_t_bits(&entry->refreshing, 1) == 0)
+		return IDMAPPER_CACHE_REFRESH;
+
+	return IDMAPPER_CACHE_HIT;
 }
 
 /**
- * @brief Look up a user by name
+ * @brief Check whether a cached mapping can no longer be used at all
  *
- * @note The caller must hold idmapper_user_lock for read.
+ * Matches the IDMAPPER_CACHE_MISS cases of entry_status.
  *
- * @param[in]  name The user name to look up.
- * @param[out] uid  The user ID found.  May be NULL if the caller
- *                  isn't interested in the UID.  (This seems
- *                  unlikely.)
- * @param[out] gid  The GID for the user, or NULL if there is
- *                  none. The caller may specify NULL if it isn't
- *                  interested.
+ * @param[in] entry The cached entry
+ * @param[in] now   The current time
  *
- * @retval true on success.
- * @retval false if we need to try, try again.
+ * @retval true if the entry may be dropped.
  */
 
-bool idmapper_lookup_by_uname(const struct gsh_buffdesc *name, uid_t *uid,
-			      const gid_t **gid, bool gss_princ)
+static bool entry_expired(struct cache_entry *entry, time_t now)
 {
-	struct cache_user prototype = {
-		.uname = *name
-	};
-	struct avltree_node *found_node = avltree_lookup(&prototype.uname_node,
-							 &uname_tree);
-	struct cache_user *found_user;
-	void **cache_slot;
+	time_t age = now - entry->epoch;
+	time_t ttl;
 
-	if (unlikely(!found_node))
+	if (entry->flags & IDMAPPER_NEGATIVE)
+		return age >=
+			nfs_param.nfsv4_param.idmap_negative_cache_timeout;
+
+	ttl = nfs_param.nfsv4_param.idmap_cache_timeout;
+	if (ttl == 0)
 		return false;
 
-	found_user =
-	    avltree_container_of(found_node, struct cache_user, uname_node);
-	if (!gss_princ) {
-		/* I assume that if someone likes this user enough to look it
-		   up by name, they'll like it enough to look it up by ID
-		   later.
+	return age >= (entry->flags & IDMAPPER_PRINCIPAL ? ttl : 2 * ttl);
+}
 
-		   If the name is gss principal it does not have entry
-		   in uid tree */
+/**
+ * @brief Allocate a cache entry
+ *
+ * @param[in] name  The user or group name
+ * @param[in] id    The UID or GID
+ * @param[in] flags IDMAPPER_NEGATIVE and IDMAPPER_PRINCIPAL are kept
+ *
+ * @return The new entry.
+ */
 
-		cache_slot = (void **)
-			&uid_cache[found_user->uid % id_cache_size];
-		atomic_store_voidptr(cache_slot, &found_user->uid_node);
-	}
+static struct cache_entry *entry_alloc(const struct gsh_buffdesc *name,
+				       uint32_t id, uint32_t flags)
+{
+	struct cache_entry *new;
 
-	if (likely(uid))
-		*uid = found_user->uid;
+	new = gsh_malloc(sizeof(struct cache_entry) + name->len);
 
-	if (unlikely(gid))
-		*gid = (found_user->gid_set ? &found_user->gid : NULL);
+	new->name.addr = (char *)new + sizeof(struct cache_entry);
+	new->name.len = name->len;
+	memcpy(new->name.addr, name->addr, name->len);
+	new->id = id;
+	new->gid = -1;
+	new->gid_set = false;
+	new->flags = flags & (IDMAPPER_NEGATIVE | IDMAPPER_PRINCIPAL);
+	new->refreshing = 0;
+	new->epoch = time(NULL);
 
-	return true;
+	return new;
 }
 
 /**
- * @brief Look up a user by ID
+ * @brief Remove an entry from its shard and free it
  *
- * @note The caller must hold idmapper_user_lock for read.
+ * @note The caller must hold the shard lock for write.
  *
- * @param[in]  uid  The user ID to look up.
- * @param[out] name The user name to look up. (May be NULL if the user
- *                  doesn't care about the name.)
- * @param[out] gid  The GID for the user, or NULL if there is
- *                  none. The caller may specify NULL if it isn't
- *                  interested.
- *
- * @retval true on success.
- * @retval false if we weren't so successful.
+ * @param[in] shard The shard
+ * @param[in] entry The entry
  */
 
-bool idmapper_lookup_by_uid(const uid_t uid, const struct gsh_buffdesc **name,
-			    const gid_t **gid)
+static void shard_remove(struct cache_shard *shard, struct cache_entry *entry)
 {
-	struct cache_user prototype = {
-		.uid = uid
-	};
-	void **cache_slot = (void **)&uid_cache[uid % id_cache_size];
-	struct avltree_node *found_node = atomic_fetch_voidptr(cache_slot);
-	struct cache_user *found_user;
-	bool found = false;
+	avltree_remove(&entry->node, &shard->tree);
+	glist_del(&entry->age);
+	shard->count--;
+	gsh_free(entry);
+}
 
-	if (likely(found_node)) {
-		found_user = avltree_container_of(found_node,
-						  struct cache_user,
-						  uid_node);
-		if (found_user->uid == uid)
-			found = true;
+/**
+ * @brief Make room in a shard for one more entry
+ *
+ * Drops the expired entries at the head of both age lists.  A GSS
+ * principal expires before the mappings inserted just ahead of it,
+ * so it may wait behind them, or for a lookup to replace it.  If the
+ * shard is still at its share of Idmap_Cache_Size, the oldest entries
+ * are evicted.
+ *
+ * @note The caller must hold the shard lock for write.
+ *
+ * @param[in] shard The shard
+ */
+
+static void shard_reap(struct cache_shard *shard)
+{
+	uint32_t max = nfs_param.nfsv4_param.idmap_cache_size /
+							IDMAPPER_SHARDS;
+	time_t now = time(NULL);
+	struct cache_entry *pos, *neg;
+
+	while ((neg = glist_first_entry(&shard->negative, struct cache_entry,
+					age)) != NULL &&
+	       entry_expired(neg, now))
+		shard_remove(shard, neg);
+
+	while ((pos = glist_first_entry(&shard->positive, struct cache_entry,
+					age)) != NULL &&
+	       entry_expired(pos, now))
+		shard_remove(shard, pos);
+
+	while (shard->count >= max) {
+		pos = glist_first_entry(&shard->positive, struct cache_entry,
+					age);
+		neg = glist_first_entry(&shard->negative, struct cache_entry,
+					age);
+		if (pos == NULL || (neg != NULL && neg->epoch <= pos->epoch))
+			pos = neg;
+		shard_remove(shard, pos);
 	}
+}
 
-	if (unlikely(!found)) {
-		found_node = avltree_lookup(&prototype.uid_node, &uid_tree);
-		if (unlikely(!found_node))
-			return false;
+/**
+ * @brief Insert an entry, replacing any entry with the same key
+ *
+ * Several threads may miss on the same key and all resolve it, and a
+ * refresh may find that a name got a different ID or an ID a
+ * different name.  Either way the newest result wins.
+ *
+ * A user looked up by owner string has no GID, while the same name
+ * mapped as a Kerberos principal does (this happens if and only if
+ * IDMAPD_DOMAIN and LOCAL_REALMS are set to the same value), so keep
+ * the GID when both agree on the UID.
+ *
+ * @param[in] shard The shard
+ * @param[in] new   The entry to insert
+ * @param[in] slots Owner strings to update, NULL for name tables
+ */
 
-		atomic_store_voidptr(cache_slot, found_node);
-		found_user = avltree_container_of(found_node,
-						  struct cache_user,
-						  uid_node);
+static void shard_insert(struct cache_shard *shard, struct cache_entry *new,
+			 struct owner_slot *slots)
+{
+	struct avltree_node *found;
+	struct cache_entry *old;
+
+	PTHREAD_RWLOCK_wrlock(&shard->lock);
+
+	found = avltree_lookup(&new->node, &shard->tree);
+	if (unlikely(found)) {
+		old = avltree_container_of(found, struct cache_entry, node);
+		if (!new->gid_set && old->gid_set && old->id == new->id &&
+		    !(new->flags & IDMAPPER_NEGATIVE)) {
+			new->gid = old->gid;
+			new->gid_set = true;
+		}
+		shard_remove(shard, old);
 	}
 
-	if (likely(name))
-		*name = &found_user->uname;
+	shard_reap(shard);
 
-	if (gid)
-		*gid = (found_user->gid_set ? &found_user->gid : NULL);
+	found = avltree_insert(&new->node, &shard->tree);
+	assert(found == NULL);
+	glist_add_tail(new->flags & IDMAPPER_NEGATIVE ? &shard->negative
+						      : &shard->positive,
+		       &new->age);
+	shard->count++;
 
-	return true;
+	if (slots != NULL)
+		owner_publish(slots, new);
+
+	PTHREAD_RWLOCK_unlock(&shard->lock);
 }
 
 /**
- * @brief Lookup a group by name
+ * @brief Check whether a mapping may be cached at all
+ *
+ * @param[in] name  The user or group name
+ * @param[in] flags IDMAPPER_* flags
  *
- * @note The caller must hold idmapper_group_lock for read.
+ * @retval true if it may be cached.
+ * @retval false if it is too long or negative caching is off.
+ */
+
+static bool cacheable(const struct gsh_buffdesc *name, uint32_t flags)
+{
+	if (unlikely(name->len > IDMAPPER_NAME_MAX)) {
+		LogDebug(COMPONENT_IDMAPPER,
+			 "Not caching %zu byte name", name->len);
+		return false;
+	}
+
+	return !(flags & IDMAPPER_NEGATIVE) ||
+		nfs_param.nfsv4_param.idmap_negative_cache_timeout != 0;
+}
+
+/**
+ * @brief Add a user entry to the cache
  *
- * @param[in]  name The user name to look up.
- * @param[out] gid  The group ID found.  May be NULL if the caller
- *                  isn't interested in the GID.  (This seems
- *                  unlikely, since you can't get anything else from
- *                  this function.)
+ * @param[in] name  The user name
+ * @param[in] uid   The user ID
+ * @param[in] gid   Optional.  Set to NULL if no gid is known.
+ * @param[in] flags IDMAPPER_BY_NAME and/or IDMAPPER_BY_ID select the
+ *                  directions cached.  IDMAPPER_PRINCIPAL marks a gss
+ *                  principal, for which the uid to name map is never
+ *                  added.  IDMAPPER_NEGATIVE marks a fallback mapping.
  *
  * @retval true on success.
- * @retval false if we need to try, try again.
+ * @retval false if the mapping was not cached.
  */
 
-bool idmapper_lookup_by_gname(const struct gsh_buffdesc *name, uid_t *gid)
+bool idmapper_add_user(const struct gsh_buffdesc *name, uid_t uid,
+		       const gid_t *gid, uint32_t flags)
 {
-	struct cache_group prototype = {
-		.gname = *name
-	};
-	struct avltree_node *found_node = avltree_lookup(&prototype.gname_node,
-							 &gname_tree);
-	struct cache_group *found_group;
-	void **cache_slot;
+	struct cache_entry *new;
 
-	if (unlikely(!found_node))
+	if (!cacheable(name, flags))
 		return false;
 
-	found_group =
-	    avltree_container_of(found_node, struct cache_group, gname_node);
+	if (flags & IDMAPPER_BY_NAME) {
+		new = entry_alloc(name, uid, flags);
+		if (gid) {
+			new->gid = *gid;
+			new->gid_set = true;
+		}
+		shard_insert(name_shard(&uname_table, name), new, NULL);
+	}
 
-	/* I assume that if someone likes this group enough to look it
-	   up by name, they'll like it enough to look it up by ID
-	   later. */
+	if ((flags & IDMAPPER_BY_ID) && !(flags & IDMAPPER_PRINCIPAL)) {
+		new = entry_alloc(name, uid, flags);
+		shard_insert(id_shard(&uid_table, uid), new,
+			     uid_table.slots);
+	}
 
-	cache_slot = (void **)&gid_cache[found_group->gid % id_cache_size];
-	atomic_store_voidptr(cache_slot, &found_group->gid_node);
+	return true;
+}
 
-	if (likely(gid))
-		*gid = found_group->gid;
-	else
-		LogDebug(COMPONENT_IDMAPPER, "Caller is being weird.");
+/**
+ * @brief Add a group entry to the cache
+ *
+ * @param[in] name  The group name
+ * @param[in] gid   The group id
+ * @param[in] flags IDMAPPER_BY_NAME and/or IDMAPPER_BY_ID select the
+ *                  directions cached.  IDMAPPER_NEGATIVE marks a
+ *                  fallback mapping.
+ *
+ * @retval true on success.
+ * @retval false if the mapping was not cached.
+ */
+
+bool idmapper_add_group(const struct gsh_buffdesc *name, const gid_t gid,
+			uint32_t flags)
+{
+	if (!cacheable(name, flags))
+		return false;
+
+	if (flags & IDMAPPER_BY_NAME)
+		shard_insert(name_shard(&gname_table, name),
+			     entry_alloc(name, gid, flags), NULL);
+
+	if (flags & IDMAPPER_BY_ID)
+		shard_insert(id_shard(&gid_table, gid),
+			     entry_alloc(name, gid, flags), gid_table.slots);
 
 	return true;
 }
 
 /**
- * @brief Look up a group by ID
+ * @brief Look up a name in a table
  *
- * @note The caller must hold idmapper_group_lock for read.
+ * @param[in]  table   The table
+ * @param[in]  name    The name to look up
+ * @param[out] id      The ID found
+ * @param[out] gid     The GID for a user, may be NULL
+ * @param[out] gid_set Whether *gid was found, may be NULL
  *
- * @param[in]  gid  The group ID to look up.
- * @param[out] name The user name to look up. (May be NULL if the user
- *                  doesn't care about the name, which would be weird.)
- *
- * @retval true on success.
- * @retval false if we're most unfortunate.
+ * @return How the caller should treat the result.
  */
 
-bool idmapper_lookup_by_gid(const gid_t gid, const struct gsh_buffdesc **name)
+static enum idmapper_cache_status lookup_by_name(struct cache_table *table,
+						 const struct gsh_buffdesc *name,
+						 uint32_t *id, gid_t *gid,
+						 bool *gid_set)
 {
-	struct cache_group prototype = {
-		.gid = gid
+	struct cache_shard *shard = name_shard(table, name);
+	struct cache_entry prototype = {
+		.name = *name
 	};
-	void **cache_slot = (void **)&gid_cache[gid % id_cache_size];
-	struct avltree_node *found_node = atomic_fetch_voidptr(cache_slot);
-	struct cache_group *found_group;
-	bool found = false;
+	struct avltree_node *found_node;
+	struct cache_entry *found;
+	enum idmapper_cache_status status = IDMAPPER_CACHE_MISS;
 
+	PTHREAD_RWLOCK_rdlock(&shard->lock);
+
+	found_node = avltree_lookup(&prototype.node, &shard->tree);
 	if (likely(found_node)) {
-		found_group = avltree_container_of(found_node,
-						   struct cache_group,
-						   gid_node);
-		if (found_group->gid == gid)
-			found = true;
+		found = avltree_container_of(found_node, struct cache_entry,
+					     node);
+		status = entry_status(found);
+		*id = found->id;
+		if (gid)
+			*gid = found->gid;
+		if (gid_set)
+			*gid_set = found->gid_set;
 	}
 
-	if (unlikely(!found)) {
-		found_node = avltree_lookup(&prototype.gid_node, &gid_tree);
-		if (unlikely(!found_node))
-			return false;
+	PTHREAD_RWLOCK_unlock(&shard->lock);
+
+	return status;
+}
+
+/**
+ * @brief Look up an ID in a table
+ *
+ * @param[in]     table The table
+ * @param[in]     id    The ID to look up
+ * @param[in,out] name  Buffer of IDMAPPER_NAME_MAX bytes at addr,
+ *                      len is set to the length of the name found
+ *
+ * @return How the caller should treat the result.
+ */
+
+static enum idmapper_cache_status lookup_by_id(struct cache_table *table,
+					       uint32_t id,
+					       struct gsh_buffdesc *name)
+{
+	struct cache_shard *shard = id_shard(table, id);
+	struct cache_entry prototype = {
+		.id = id
+	};
+	struct avltree_node *found_node;
+	struct cache_entry *found;
+	enum idmapper_cache_status status = IDMAPPER_CACHE_MISS;
+
+	PTHREAD_RWLOCK_rdlock(&shard->lock);
 
-		atomic_store_voidptr(cache_slot, found_node);
-		found_group = avltree_container_of(found_node,
-						   struct cache_group,
-						   gid_node);
+	found_node = avltree_lookup(&prototype.node, &shard->tree);
+	if (likely(found_node)) {
+		found = avltree_container_of(found_node, struct cache_entry,
+					     node);
+		status = entry_status(found);
+		memcpy(name->addr, found->name.addr, found->name.len);
+		name->len = found->name.len;
+		/* The slot was taken by another ID or went stale while
+		   the entry is still good, put it back. */
+		if (status == IDMAPPER_CACHE_HIT ||
+		    status == IDMAPPER_CACHE_NEGATIVE)
+			owner_publish(table->slots, found);
 	}
 
-	if (likely(name))
-		*name = &found_group->gname;
-	else
-		LogDebug(COMPONENT_IDMAPPER, "Caller is being weird.");
+	PTHREAD_RWLOCK_unlock(&shard->lock);
 
-	return true;
+	return status;
+}
+
+/**
+ * @brief Look up a user by name
+ *
+ * @param[in]  name    The user name to look up.
+ * @param[out] uid     The user ID found.
+ * @param[out] gid     The GID for the user.  May be NULL if the caller
+ *                     isn't interested.
+ * @param[out] gid_set Whether the GID is known.  May be NULL if the
+ *                     caller isn't interested.
+ *
+ * @return How the caller should treat the result.
+ */
+
+enum idmapper_cache_status idmapper_lookup_by_uname(
+	const struct gsh_buffdesc *name, uid_t *uid, gid_t *gid,
+	bool *gid_set)
+{
+	return lookup_by_name(&uname_table, name, uid, gid, gid_set);
+}
+
+/**
+ * @brief Look up a user by ID
+ *
+ * @param[in]     uid  The user ID to look up.
+ * @param[in,out] name Buffer of IDMAPPER_NAME_MAX bytes the name is
+ *                     copied to.
+ *
+ * @return How the caller should treat the result.
+ */
+
+enum idmapper_cache_status idmapper_lookup_by_uid(const uid_t uid,
+						  struct gsh_buffdesc *name)
+{
+	return lookup_by_id(&uid_table, uid, name);
+}
+
+/**
+ * @brief Lookup a group by name
+ *
+ * @param[in]  name The group name to look up.
+ * @param[out] gid  The group ID found.
+ *
+ * @return How the caller should treat the result.
+ */
+
+enum idmapper_cache_status idmapper_lookup_by_gname(
+	const struct gsh_buffdesc *name, gid_t *gid)
+{
+	return lookup_by_name(&gname_table, name, gid, NULL, NULL);
+}
+
+/**
+ * @brief Look up a group by ID
+ *
+ * @param[in]     gid  The group ID to look up.
+ * @param[in,out] name Buffer of IDMAPPER_NAME_MAX bytes the name is
+ *                     copied to.
+ *
+ * @return How the caller should treat the result.
+ */
+
+enum idmapper_cache_status idmapper_lookup_by_gid(const gid_t gid,
+						  struct gsh_buffdesc *name)
+{
+	return lookup_by_id(&gid_table, gid, name);
+}
+
+/**
+ * @brief Empty a cache table
+ *
+ * @param[in] table The table
+ */
+
+static void table_clear(struct cache_table *table)
+{
+	struct avltree_node *node;
+	int i;
+
+	for (i = 0; i < IDMAPPER_SHARDS; i++) {
+		struct cache_shard *shard = &table->shards[i];
+
+		PTHREAD_RWLOCK_wrlock(&shard->lock);
+
+		for (node = avltree_first(&shard->tree);
+		     node != NULL;
+		     node = avltree_first(&shard->tree))
+			shard_remove(shard, avltree_container_of(node,
+							struct cache_entry,
+							node));
+
+		PTHREAD_RWLOCK_unlock(&shard->lock);
+	}
 }
 
 /**
@@ -671,44 +909,136 @@ bool idmapper_lookup_by_gid(const gid_t gid, const struct gsh_buffdesc **name)
 
 void idmapper_clear_cache(void)
 {
-	struct avltree_node *node;
+	table_clear(&uname_table);
+	table_clear(&uid_table);
+	table_clear(&gname_table);
+	table_clear(&gid_table);
+
+	/* After the tables are empty, so no slot written from an old
+	   entry can carry the new generation. */
+	atomic_inc_uint32_t(&owner_generation);
+}
+
+/**
+ * @brief Parse a UID or GID from a prefetch file
+ *
+ * @param[in]  str The token, may be NULL
+ * @param[out] id  The ID
+ *
+ * @retval true if str is a valid ID.
+ */
+
+static bool prefetch_id(const char *str, uint32_t *id)
+{
+	char *end = NULL;
+	unsigned long long val;
+
+	if (str == NULL)
+		return false;
+
+	errno = 0;
+	val = strtoull(str, &end, 10);
+	if (errno != 0 || *end != '\0' || val > UINT32_MAX)
+		return false;
+
+	*id = val;
+	return true;
+}
+
+/**
+ * @brief Load one line of a prefetch file
+ *
+ * @param[in] line The line, modified by tokenizing
+ *
+ * @retval 1 if a mapping was loaded.
+ * @retval 0 for a blank line or a comment.
+ * @retval -1 if the line is malformed.
+ */
+
+static int prefetch_line(char *line)
+{
+	char *save = NULL;
+	char *kind = strtok_r(line, " \t\r\n", &save);
+	char *name, *id, *gid;
+	struct gsh_buffdesc buf;
+	uint32_t nid = 0, ngid = 0;
+
+	if (kind == NULL || kind[0] == '#')
+		return 0;
 
-	PTHREAD_RWLOCK_wrlock(&idmapper_user_lock);
-	PTHREAD_RWLOCK_wrlock(&idmapper_group_lock);
+	name = strtok_r(NULL, " \t\r\n", &save);
+	id = strtok_r(NULL, " \t\r\n", &save);
+	gid = strtok_r(NULL, " \t\r\n", &save);
 
-	memset(uid_cache, 0, id_cache_size * sizeof(struct avltree_node *));
-	memset(gid_cache, 0, id_cache_size * sizeof(struct avltree_node *));
+	if (name == NULL || !prefetch_id(id, &nid) ||
+	    strtok_r(NULL, " \t\r\n", &save) != NULL)
+		return -1;
 
-	for (node = avltree_first(&uname_tree);
-	     node != NULL;
-	     node = avltree_first(&uname_tree)) {
-		struct cache_user *user;
+	buf.addr = name;
+	buf.len = strlen(name);
 
-		user = avltree_container_of(node,
-					    struct cache_user, uname_node);
-		avltree_remove(&user->uname_node, &uname_tree);
-		avltree_remove(&user->uid_node, &uid_tree);
-		gsh_free(user);
+	if (strcmp(kind, "user") == 0) {
+		if (gid != NULL && !prefetch_id(gid, &ngid))
+			return -1;
+		idmapper_add_user(&buf, nid, gid != NULL ? &ngid : NULL,
+				  IDMAPPER_BY_NAME | IDMAPPER_BY_ID);
+	} else if (strcmp(kind, "group") == 0 && gid == NULL) {
+		idmapper_add_group(&buf, nid,
+				   IDMAPPER_BY_NAME | IDMAPPER_BY_ID);
+	} else {
+		return -1;
 	}
 
-	assert(avltree_first(&uid_tree) == NULL);
+	return 1;
+}
+
+/**
+ * @brief Load mappings from a file into the cache
+ *
+ * Each line is "user <name> <uid> [<gid>]" or "group <name> <gid>",
+ * names are cached exactly as written.  This stands in for a
+ * directory service in testing, and lets a server start warm.
+ *
+ * @param[in] path The file
+ *
+ * @return Number of mappings loaded, or -errno if the file can't be read.
+ */
+
+int idmapper_prefetch(const char *path)
+{
+	char line[IDMAPPER_NAME_MAX + 64];
+	int lineno = 0;
+	int loaded = 0;
+	FILE *fp;
+
+	fp = fopen(path, "r");
+	if (fp == NULL) {
+		int err = errno;
+
+		LogCrit(COMPONENT_IDMAPPER,
+			"Could not open idmap prefetch file %s: %s",
+			path, strerror(err));
+		return -err;
+	}
 
-	for (node = avltree_first(&gname_tree);
-	     node != NULL;
-	     node = avltree_first(&gname_tree)) {
-		struct cache_group *group;
+	while (fgets(line, sizeof(line), fp) != NULL) {
+		int rc = prefetch_line(line);
 
-		group = avltree_container_of(node,
-					     struct cache_group, gname_node);
-		avltree_remove(&group->gname_node, &gname_tree);
-		avltree_remove(&group->gid_node, &gid_tree);
-		gsh_free(group);
+		lineno++;
+		if (rc > 0)
+			loaded++;
+		else if (rc < 0)
+			LogWarn(COMPONENT_IDMAPPER,
+				"%s:%d: malformed mapping ignored",
+				path, lineno);
 	}
 
-	assert(avltree_first(&gid_tree) == NULL);
+	fclose(fp);
+
+	LogEvent(COMPONENT_IDMAPPER, "Prefetched %d mappings from %s",
+		 loaded, path);
 
-	PTHREAD_RWLOCK_unlock(&idmapper_group_lock);
-	PTHREAD_RWLOCK_unlock(&idmapper_user_lock);
+	return loaded;
 }
 
 /** @} */
@@ -45,6 +45,23 @@
 #include "avltree.h"
 #include "gsh_types.h"
 
+/** Number of export access decisions remembered per client */
+#define CLIENT_EXPORT_DECISIONS 8
+
+struct exportlist_client_entry__;
+
+/**
+ * @brief A remembered export access decision
+ *
+ * Keyed by the generation of the export's client index, so any update
+ * of the export's client list implicitly invalidates it.
+ */
+struct gsh_client_export_decision {
+	uint64_t generation;	/*< Client index generation, 0 if unused */
+	struct exportlist_client_entry__ *entry;	/*< Matching entry */
+	time_t expire;		/*< When to re-evaluate, 0 for never */
+};
+
 struct gsh_client {
 	struct avltree_node node_k;
 	pthread_rwlock_t lock;
@@ -52,6 +69,9 @@ struct gsh_client {
 	int64_t refcnt;
 	nsecs_elapsed_t last_update;
 	char *hostaddr_str;
+	/** Recent export access decisions, protected by lock */
+	struct gsh_client_export_decision
+		export_decisions[CLIENT_EXPORT_DECISIONS];
 	unsigned char addrbuf[];
 };
 
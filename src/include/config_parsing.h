@@ -817,6 +817,18 @@ static inline bool is_prime(int v)
 config_file_t config_ParseFile(char *file_path,
 			       struct config_error_type *err_type);
 
+/**
+ * @brief Parse a config file, loading and saving a precompiled image
+ *
+ * @param file_path  [IN]  local path to the config file
+ * @param cache_path [IN]  image of the parse tree, NULL to always parse
+ * @param err_type   [OUT] Error type. Check this for success.
+ *
+ * @return pointer to parse tree.  Must be freed if != NULL
+ */
+config_file_t config_ParseFileCached(char *file_path, const char *cache_path,
+				     struct config_error_type *err_type);
+
 /**
  * config_Print:
  * Print the content of the syntax tree
@@ -840,6 +852,12 @@ int find_config_nodes(config_file_t config, char *expr,
 		     struct config_node_list **node_list,
 		      struct config_error_type *err_type);
 
+/* fingerprint a block and everything in it */
+uint64_t config_block_digest(void *tree_node, uint64_t seed);
+
+/* value of the first occurrence of a parameter in a block */
+const char *config_block_value(void *tree_node, const char *name);
+
 /* fill configuration structure from parse tree */
 int load_config_from_node(void *tree_node,
 			  struct config_block *conf_blk,
@@ -56,6 +56,8 @@ enum export_status {
  *
  */
 
+struct client_match_index;
+
 struct gsh_export {
 	/** List of all exports */
 	struct glist_head exp_list;
@@ -79,6 +81,9 @@ struct gsh_export {
 	struct fsal_obj_handle *exp_root_obj;
 	/** CFG Allowed clients - update protected by lock */
 	struct glist_head clients;
+	/** Compiled lookup index over clients, swapped with it - protected
+	    by lock */
+	struct client_match_index *client_index;
 	/** Entry for the junction of this export.  Protected by lock */
 	struct fsal_obj_handle *exp_junction_obj;
 	/** The export this export sits on. Protected by lock */
@@ -124,10 +129,16 @@ struct gsh_export {
 	/** CFG: Expiration time interval in seconds for attributes.  Settable
 	    with Attr_Expiration_Time. - atomic changeable option */
 	int32_t expire_time_attr;
+	/** Digest of the EXPORT block a config reload last applied, 0 if
+	    the export did not come from the config file or has been
+	    updated by other means since */
+	uint64_t config_digest;
 	/** CFG: Export_Id for this export - static option */
 	uint16_t export_id;
 
 	uint8_t export_status;		/*< current condition */
+	uint8_t from_config;		/*< loaded from the config file, so
+					    a reload without it removes it */
 	bool has_pnfs_ds;		/*< id_servers matches export_id */
 };
 
@@ -366,6 +366,15 @@ fsal_status_t fsal_write2(struct fsal_obj_handle *obj,
 			  void *buffer,
 			  bool *sync,
 			  struct io_info *info);
+fsal_status_t fsal_writev2(struct fsal_obj_handle *obj,
+			   bool bypass,
+			   struct state_t *state,
+			   uint64_t offset,
+			   const struct iovec *iov,
+			   int iovcnt,
+			   size_t *bytes_moved,
+			   bool *sync,
+			   struct io_info *info);
 fsal_status_t fsal_rdwr(struct fsal_obj_handle *obj,
 		      fsal_io_direction_t io_direction,
 		      uint64_t offset, size_t io_size,
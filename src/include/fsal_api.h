@@ -40,6 +40,7 @@
 #ifndef FSAL_API
 #define FSAL_API
 
+#include <sys/uio.h>
 #include "fsal_types.h"
 #include "fsal_pnfs.h"
 #include "sal_shared.h"
@@ -324,7 +325,7 @@ struct state_t;
  * rules), increment the minor version
  */
 
-#define FSAL_MINOR_VERSION 0
+#define FSAL_MINOR_VERSION 3
 
 /* Forward references for object methods */
 
@@ -420,6 +421,7 @@ struct req_op_context {
 	void *fsal_private;		/*< private for FSAL use */
 	struct fsal_module *fsal_module;	/*< current fsal module */
 	struct fsal_pnfs_ds *fsal_pnfs_ds;	/*< current pNFS DS */
+	struct gsh_arena *arena;	/*< request scoped memory, or NULL */
 	/* add new context members here */
 };
 
@@ -2723,6 +2725,115 @@ struct fsal_obj_ops {
 	 fsal_status_t (*close2)(struct fsal_obj_handle *obj_hdl,
 				 struct state_t *state);
 
+/**
+ * @brief Write data to a file from an array of buffers
+ *
+ * As write2, with the data gathered from iov, so that a payload that
+ * arrived in pieces need not be copied into one buffer first.  The
+ * default method does that copy and calls write2.
+ *
+ * @param[in]     obj_hdl        File on which to operate
+ * @param[in]     bypass         If state doesn't indicate a share reservation,
+ *                               bypass any non-mandatory deny write
+ * @param[in]     state          state_t to use for this operation
+ * @param[in]     offset         Position at which to write
+ * @param[in]     iov            Data to be written
+ * @param[in]     iovcnt         Number of buffers in iov
+ * @param[out]    wrote_amount   Amount of data written
+ * @param[in,out] fsal_stable    In, if on, the fsal is requested to write data
+ *                               to stable store. Out, the fsal reports what
+ *                               it did.
+ * @param[in,out] info           more information about the data
+ *
+ * @return FSAL status.
+ */
+	 fsal_status_t (*writev2)(struct fsal_obj_handle *obj_hdl,
+				  bool bypass,
+				  struct state_t *state,
+				  uint64_t offset,
+				  const struct iovec *iov,
+				  int iovcnt,
+				  size_t *wrote_amount,
+				  bool *fsal_stable,
+				  struct io_info *info);
+
+/**
+ * @brief Copy a range of one file to another
+ *
+ * The data does not pass through the caller.  Both handles belong to
+ * this FSAL and export.  The default method reads and writes it in
+ * chunks with read2 and write2.  Less than count may be copied if the
+ * source ends first; the caller calls again to copy the rest.
+ *
+ * @param[in]  src_hdl     File to copy from
+ * @param[in]  src_state   state_t to read src_hdl with, may be NULL
+ * @param[in]  src_offset  Position in src_hdl to copy from
+ * @param[in]  dst_hdl     File to copy to
+ * @param[in]  dst_state   state_t to write dst_hdl with, may be NULL
+ * @param[in]  dst_offset  Position in dst_hdl to copy to
+ * @param[in]  count       Number of bytes to copy
+ * @param[out] copied      Number of bytes copied
+ *
+ * @return FSAL status.
+ */
+	 fsal_status_t (*copy2)(struct fsal_obj_handle *src_hdl,
+				struct state_t *src_state,
+				uint64_t src_offset,
+				struct fsal_obj_handle *dst_hdl,
+				struct state_t *dst_state,
+				uint64_t dst_offset,
+				uint64_t count,
+				uint64_t *copied);
+
+/**
+ * @brief Share a range of one file's blocks with another
+ *
+ * As copy2, but the destination refers to the source's blocks rather
+ * than getting a copy of the data, and the whole range is cloned or
+ * nothing is.  The default method returns ERR_FSAL_NOTSUPP.
+ *
+ * @param[in]  src_hdl     File to clone from
+ * @param[in]  src_state   state_t to read src_hdl with, may be NULL
+ * @param[in]  src_offset  Position in src_hdl to clone from
+ * @param[in]  dst_hdl     File to clone to
+ * @param[in]  dst_state   state_t to write dst_hdl with, may be NULL
+ * @param[in]  dst_offset  Position in dst_hdl to clone to
+ * @param[in]  count       Number of bytes to clone, 0 for up to the end
+ *                         of src_hdl
+ *
+ * @return FSAL status.
+ */
+	 fsal_status_t (*clone2)(struct fsal_obj_handle *src_hdl,
+				 struct state_t *src_state,
+				 uint64_t src_offset,
+				 struct fsal_obj_handle *dst_hdl,
+				 struct state_t *dst_state,
+				 uint64_t dst_offset,
+				 uint64_t count);
+
+/**
+ * @brief Reserve or free space in a file
+ *
+ * With allocate, the blocks of the range are reserved so that later
+ * writes to it cannot fail for lack of space; a range past the end of
+ * file extends it.  Without, the range becomes a hole that reads back
+ * as zeros and the file size does not change.  No data is written in
+ * either case.  The default method returns ERR_FSAL_NOTSUPP.
+ *
+ * @param[in] obj_hdl   File on which to operate
+ * @param[in] state     state_t to write obj_hdl with, may be NULL
+ * @param[in] offset    Start of the range
+ * @param[in] length    Length of the range
+ * @param[in] allocate  true to reserve the range, false to punch it out
+ *
+ * @return FSAL status.
+ */
+	 fsal_status_t (*fallocate)(struct fsal_obj_handle *obj_hdl,
+				    struct state_t *state,
+				    uint64_t offset,
+				    uint64_t length,
+				    bool allocate);
+
 /**@}*/
 };
 
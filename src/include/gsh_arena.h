@@ -0,0 +1,60 @@
+/*
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public License
+ * as published by the Free Software Foundation; either version 3 of
+ * the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA
+ * 02110-1301 USA
+ *
+ * ---------------------------------------
+ */
+
+/**
+ * @file  gsh_arena.h
+ * @brief Bump allocator for request scoped memory
+ *
+ * An arena hands out memory from large chunks and never frees single
+ * allocations; everything goes at once when the arena is reset.  The
+ * worker threads keep one arena each and reset it after the reply to
+ * a request has been sent.
+ */
+
+#ifndef GSH_ARENA_H
+#define GSH_ARENA_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+/**
+ * @brief Default size of an arena chunk
+ */
+#define GSH_ARENA_CHUNK_SIZE (64 * 1024)
+
+struct gsh_arena_chunk;
+
+struct gsh_arena {
+	struct gsh_arena_chunk *chunks;	/*< Current chunk first */
+	struct gsh_arena_chunk *first;	/*< Chunk kept across resets */
+	size_t chunk_size;		/*< Size of a regular chunk */
+	uint64_t allocs;		/*< Allocations served */
+	uint64_t bytes;			/*< Bytes served */
+	uint64_t heap_allocs;		/*< Chunks taken from the heap */
+};
+
+void gsh_arena_init(struct gsh_arena *arena, size_t chunk_size);
+void *gsh_arena_alloc(struct gsh_arena *arena, size_t size);
+void *gsh_arena_calloc(struct gsh_arena *arena, size_t n, size_t size);
+bool gsh_arena_owns(struct gsh_arena *arena, const void *ptr);
+void gsh_arena_reset(struct gsh_arena *arena);
+void gsh_arena_destroy(struct gsh_arena *arena);
+
+#endif				/* GSH_ARENA_H */
@@ -192,6 +192,11 @@ typedef enum protos {
 				CORE_OPTION_NFS_VSOCK |			\
 				CORE_OPTION_9P)
 
+/**
+ * @brief Default value of manage_gids_cache_memory
+ */
+#define MANAGE_GIDS_CACHE_MEMORY_DEFAULT (32 * 1024 * 1024)
+
 typedef struct nfs_core_param {
 	/** An array of port numbers, one for each protocol.  Set by
 	    the NFS_Port, MNT_Port, NLM_Port, and Rquota_Port options. */
@@ -385,6 +390,17 @@ typedef struct nfs_core_param {
 	    calling getgroups() when "Manage_Gids = TRUE" is
 	    used in a export entry. */
 	time_t manage_gids_expiration;
+	/** Memory the managed gids cache may use before least recently
+	    used users are evicted, 0 for no limit.  Defaults to
+	    MANAGE_GIDS_CACHE_MEMORY_DEFAULT and settable with
+	    Manage_Gids_Cache_Memory. */
+	uint64_t manage_gids_cache_memory;
+	/** How often, in seconds, netgroups named in export client
+	    lists are expanded into host sets in the background.  0,
+	    the default, disables expansion and netgroups are checked
+	    one host at a time.  Settable with
+	    Netgroup_Expand_Interval. */
+	uint32_t netgroup_expand_interval;
 	/** Path to the directory containing server specific
 	    modules.  In particular, this is where FSALs live. */
 	char *ganesha_modules_loc;
@@ -415,6 +431,26 @@ typedef struct nfs_core_param {
  */
 #define GRACE_PERIOD_DEFAULT 90
 
+/**
+ * @brief Default value for expected_clients
+ */
+#define EXPECTED_CLIENTS_DEFAULT 1024
+
+/**
+ * @brief Default value for max_slots
+ */
+#define MAX_SLOTS_DEFAULT 64
+
+/**
+ * @brief Default value for max_cached_reply_size
+ */
+#define MAX_CACHED_REPLY_SIZE_DEFAULT 8192
+
+/**
+ * @brief Default value for session_cache_memory
+ */
+#define SESSION_CACHE_MEMORY_DEFAULT (64 * 1024 * 1024)
+
 /**
  * @brief Default value of domainname.
  */
@@ -425,11 +461,50 @@ typedef struct nfs_core_param {
  */
 #define IDMAPCONF_DEFAULT "/etc/idmapd.conf"
 
+/**
+ * @brief Default value of idmap_cache_timeout.
+ */
+#define IDMAP_CACHE_TIMEOUT_DEFAULT 900
+
+/**
+ * @brief Default value of idmap_negative_cache_timeout.
+ */
+#define IDMAP_NEGATIVE_CACHE_TIMEOUT_DEFAULT 60
+
+/**
+ * @brief Default value of idmap_cache_size.
+ */
+#define IDMAP_CACHE_SIZE_DEFAULT 65536
+
 /**
  * @brief Default value of deleg_recall_retry_delay.
  */
 #define DELEG_RECALL_RETRY_DELAY_DEFAULT 1
 
+/**
+ * @brief Delegation grant policies
+ */
+enum deleg_policy_type {
+	DELEG_POLICY_DEFAULT,	/*< Fixed recall/revoke heuristics */
+	DELEG_POLICY_ADAPTIVE,	/*< Per-file conflict history and
+				    per-client backoff */
+};
+
+/**
+ * @brief Default value of cb_timeout.
+ */
+#define CB_TIMEOUT_DEFAULT 15
+
+/**
+ * @brief Default value of deleg_backoff_max.
+ */
+#define DELEG_BACKOFF_MAX_DEFAULT 300
+
+/**
+ * @brief Default value of async_copy_threads.
+ */
+#define ASYNC_COPY_THREADS_DEFAULT 2
+
 typedef struct nfs_version4_parameter {
 	/** Whether to disable the NFSv4 grace period.  Defaults to
 	    false and settable with Graceless. */
@@ -441,6 +516,32 @@ typedef struct nfs_version4_parameter {
 	/** The NFS grace period.  Defaults to
 	    GRACE_PERIOD_DEFAULT and is settable with Grace_Period. */
 	uint32_t grace_period;
+	/** Whether to end the grace period as soon as every client in
+	    the recovery database has sent RECLAIM_COMPLETE.  Defaults
+	    to true and settable with Lift_Grace. */
+	bool lift_grace;
+	/** Whether to lift grace early even though NLM is enabled and
+	    NLM clients can't report reclaim completion.  Defaults to
+	    false and settable with Lift_Grace_With_NLM. */
+	bool lift_grace_with_nlm;
+	/** Number of NFSv4 clients the server expects, used to size
+	    the clientid, client record and session tables.  Defaults
+	    to EXPECTED_CLIENTS_DEFAULT and settable with
+	    Expected_Clients. */
+	uint32_t expected_clients;
+	/** Largest forechannel slot table granted to a session.
+	    Defaults to MAX_SLOTS_DEFAULT and settable with
+	    Max_Slots. */
+	uint32_t max_slots;
+	/** Largest encoded reply cached in a session slot.  Defaults
+	    to MAX_CACHED_REPLY_SIZE_DEFAULT and settable with
+	    Max_Cached_Reply_Size. */
+	uint32_t max_cached_reply_size;
+	/** Reply cache memory for all sessions above which clients are
+	    asked to shrink their slot usage.  Defaults to
+	    SESSION_CACHE_MEMORY_DEFAULT and settable with
+	    Session_Cache_Memory. */
+	uint64_t session_cache_memory;
 	/** Domain to use if we aren't using the nfsidmap.  Defaults
 	    to DOMAINNAME_DEFAULT and is set with DomainName. */
 	char *domainname;
@@ -461,11 +562,42 @@ typedef struct nfs_version4_parameter {
 	    Only_Numeric_Owners. NB., this is permissible for a server
 	    implementation (RFC 5661). */
 	bool only_numeric_owners;
+	/** Seconds an owner or group mapping is served from the
+	    idmapper cache before it is refreshed, 0 to never expire.
+	    Defaults to IDMAP_CACHE_TIMEOUT_DEFAULT and settable with
+	    Idmap_Cache_Timeout. */
+	uint32_t idmap_cache_timeout;
+	/** Seconds a failed mapping is remembered, 0 to not remember
+	    failures.  Defaults to IDMAP_NEGATIVE_CACHE_TIMEOUT_DEFAULT
+	    and settable with Idmap_Negative_Cache_Timeout. */
+	uint32_t idmap_negative_cache_timeout;
+	/** Most mappings kept in each direction of the idmapper cache,
+	    the oldest are evicted first.  Defaults to
+	    IDMAP_CACHE_SIZE_DEFAULT and settable with Idmap_Cache_Size. */
+	uint32_t idmap_cache_size;
+	/** File of mappings loaded into the idmapper cache at startup.
+	    Defaults to none and settable with Idmap_Prefetch_File. */
+	char *idmap_prefetch_file;
 	/** Whether to allow delegations. Defaults to false and settable
 	    with Delegations */
 	bool allow_delegations;
 	/** Delay after which server will retry a recall in case of failures */
 	uint32_t deleg_recall_retry_delay;
+	/** Policy deciding whether to grant a delegation.  Defaults to
+	    DELEG_POLICY_DEFAULT and settable with Delegation_Policy. */
+	enum deleg_policy_type deleg_policy;
+	/** Longest per-client delegation backoff, in seconds, used by
+	    the adaptive policy.  Defaults to DELEG_BACKOFF_MAX_DEFAULT
+	    and settable with Deleg_Backoff_Max. */
+	uint32_t deleg_backoff_max;
+	/** Seconds to wait for a client to answer a callback.  Defaults
+	    to CB_TIMEOUT_DEFAULT and settable with Callback_Timeout. */
+	uint32_t cb_timeout;
+	/** Threads running the COPYs a client lets finish after the
+	    reply, 0 to do every COPY in the request.  Defaults to
+	    ASYNC_COPY_THREADS_DEFAULT and settable with
+	    Async_Copy_Threads. */
+	uint32_t async_copy_threads;
 	/** Whether this a pNFS MDS server. Defaults to false */
 	bool pnfs_mds;
 	/** Whether this a pNFS DS server. Defaults to false */
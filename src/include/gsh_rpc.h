@@ -71,6 +71,98 @@ struct nfs_request_lookahead {
 #define XDR_BYTES_MAXLEN_IO (64*1024*1024)
 #define XDR_STRING_MAXLEN (8*1024)
 
+/*
+ * Access to a buffer from XDR_INLINE, for the fast paths that convert
+ * the fixed size part of a message in one go.  The buffer is advanced
+ * past what is read or written.
+ */
+
+#define XDR_WORDS(bytes) \
+	(((bytes) + BYTES_PER_XDR_UNIT - 1) / BYTES_PER_XDR_UNIT)
+
+static inline uint32_t ixdr_get_u_int32(int32_t **buf)
+{
+	return ntohl((uint32_t) *(*buf)++);
+}
+
+static inline void ixdr_put_u_int32(int32_t **buf, uint32_t val)
+{
+	*(*buf)++ = (int32_t) htonl(val);
+}
+
+static inline uint64_t ixdr_get_u_int64(int32_t **buf)
+{
+	uint64_t val = (uint64_t) ixdr_get_u_int32(buf) << 32;
+
+	return val | ixdr_get_u_int32(buf);
+}
+
+static inline void ixdr_put_u_int64(int32_t **buf, uint64_t val)
+{
+	ixdr_put_u_int32(buf, (uint32_t) (val >> 32));
+	ixdr_put_u_int32(buf, (uint32_t) val);
+}
+
+static inline void ixdr_get_opaque(int32_t **buf, void *val, u_int len)
+{
+	memcpy(val, *buf, len);
+	*buf += XDR_WORDS(len);
+}
+
+/* Padding is zeroed, as xdr_opaque does */
+static inline void ixdr_put_opaque(int32_t **buf, const void *val,
+				   u_int len)
+{
+	if (len % BYTES_PER_XDR_UNIT != 0)
+		(*buf)[len / BYTES_PER_XDR_UNIT] = 0;
+	memcpy(*buf, val, len);
+	*buf += XDR_WORDS(len);
+}
+
+/* NULL for XDR_FREE, or when the stream has no contiguous room */
+static inline int32_t *xdr_fast_inline(XDR *xdrs, u_int words)
+{
+	if (xdrs->x_op != XDR_ENCODE && xdrs->x_op != XDR_DECODE)
+		return NULL;
+	return XDR_INLINE(xdrs, words * BYTES_PER_XDR_UNIT);
+}
+
+/* xdr_bytes with the length and, if it fits, the data inlined */
+static inline bool xdr_fast_bytes(XDR *xdrs, char **cpp, u_int *sizep,
+				  u_int maxsize)
+{
+	int32_t *buf;
+	u_int size = *sizep;
+
+	if (xdrs->x_op == XDR_ENCODE) {
+		if (size > maxsize)
+			return inline_xdr_bytes(xdrs, cpp, sizep, maxsize);
+		buf = xdr_fast_inline(xdrs, 1 + XDR_WORDS(size));
+		if (buf == NULL)
+			return inline_xdr_bytes(xdrs, cpp, sizep, maxsize);
+		ixdr_put_u_int32(&buf, size);
+		if (size != 0)
+			ixdr_put_opaque(&buf, *cpp, size);
+		return true;
+	}
+
+	buf = xdr_fast_inline(xdrs, 1);
+	if (buf == NULL)
+		return inline_xdr_bytes(xdrs, cpp, sizep, maxsize);
+	size = *sizep = ixdr_get_u_int32(&buf);
+	if (size > maxsize)
+		return false;
+	if (size == 0)
+		return true;
+	if (*cpp == NULL)
+		*cpp = (char *)mem_alloc(size);
+	buf = xdr_fast_inline(xdrs, XDR_WORDS(size));
+	if (buf == NULL)
+		return xdr_opaque(xdrs, *cpp, size);
+	ixdr_get_opaque(&buf, *cpp, size);
+	return true;
+}
+
 typedef struct sockaddr_storage sockaddr_t;
 
 #define SOCK_NAME_MAX 128
@@ -152,9 +244,12 @@ const char *str_gc_proc(rpc_gss_proc_t);
 #define XPRT_PRIVATE_FLAG_INCREQ	0x00040000
 #define XPRT_PRIVATE_FLAG_DECREQ	0x00080000
 
+struct nfs_cred_cache;
+
 typedef struct gsh_xprt_private {
 	SVCXPRT *xprt;
 	struct glist_head stallq;
+	struct nfs_cred_cache *cred_cache;	/*< TCP only, see nfs_creds.c */
 	uint16_t flags;
 } gsh_xprt_private_t;
 
@@ -165,6 +260,7 @@ static inline gsh_xprt_private_t *alloc_gsh_xprt_private(SVCXPRT *xprt,
 		gsh_malloc(sizeof(gsh_xprt_private_t));
 
 	xu->xprt = xprt;
+	xu->cred_cache = NULL;
 	xu->flags = flags;
 
 	return xu;
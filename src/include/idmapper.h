@@ -54,23 +54,54 @@
  * @{
  */
 
-extern pthread_rwlock_t idmapper_user_lock;
-extern pthread_rwlock_t idmapper_group_lock;
+/**
+ * @brief Longest owner or group string kept in the cache
+ */
+#define IDMAPPER_NAME_MAX 1024
+
+/**
+ * @brief Longest preformatted owner or group string, length word and
+ *        padding included
+ */
+#define IDMAPPER_OWNER_WIRE_MAX 104
+
+/**
+ * @brief Which directions of a mapping to add, and how
+ */
+#define IDMAPPER_BY_NAME 0x01	/*< Cache name to ID */
+#define IDMAPPER_BY_ID 0x02	/*< Cache ID to name */
+#define IDMAPPER_NEGATIVE 0x04	/*< The lookup failed, this is a fallback */
+#define IDMAPPER_PRINCIPAL 0x08	/*< Name is a GSS principal, never refreshed */
+
+/**
+ * @brief Result of a cache lookup
+ */
+enum idmapper_cache_status {
+	IDMAPPER_CACHE_MISS,	/*< Absent or expired, resolve it now */
+	IDMAPPER_CACHE_HIT,	/*< Use the cached mapping */
+	IDMAPPER_CACHE_REFRESH,	/*< Use it, and the caller must refresh it */
+	IDMAPPER_CACHE_NEGATIVE	/*< A remembered failure */
+};
 
 void idmapper_cache_init(void);
 bool idmapper_add_user(const struct gsh_buffdesc *, uid_t, const gid_t *,
-		       bool);
-bool idmapper_add_group(const struct gsh_buffdesc *, gid_t);
-bool idmapper_lookup_by_uname(const struct gsh_buffdesc *, uid_t *,
-			      const gid_t **, bool);
-bool idmapper_lookup_by_uid(const uid_t, const struct gsh_buffdesc **,
-			    const gid_t **);
-bool idmapper_lookup_by_gname(const struct gsh_buffdesc *, uid_t *);
-bool idmapper_lookup_by_gid(const gid_t, const struct gsh_buffdesc **);
+		       uint32_t);
+bool idmapper_add_group(const struct gsh_buffdesc *, gid_t, uint32_t);
+enum idmapper_cache_status idmapper_lookup_by_uname(
+	const struct gsh_buffdesc *, uid_t *, gid_t *, bool *);
+enum idmapper_cache_status idmapper_lookup_by_uid(const uid_t,
+						  struct gsh_buffdesc *);
+enum idmapper_cache_status idmapper_lookup_by_gname(
+	const struct gsh_buffdesc *, gid_t *);
+enum idmapper_cache_status idmapper_lookup_by_gid(const gid_t,
+						  struct gsh_buffdesc *);
+uint32_t idmapper_lookup_owner(uint32_t, bool, char *);
 /** @} */
 
 bool idmapper_init(void);
+int idmapper_shutdown(void);
 void idmapper_clear_cache(void);
+int idmapper_prefetch(const char *);
 
 bool xdr_encode_nfs4_owner(XDR *, uid_t);
 bool xdr_encode_nfs4_group(XDR *, gid_t);
@@ -25,5 +25,8 @@
 #define NETGROUP_CACHE_H
 void ng_cache_init(void);
 void ng_clear_cache(void);
+int ng_cache_shutdown(void);
 bool ng_innetgr(const char *group, const char *host);
+void ng_expand_register(const char *group);
+void ng_expand_unregister(const char *group);
 #endif
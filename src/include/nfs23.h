@@ -816,6 +816,11 @@ typedef struct entryplus3 entryplus3;
 struct dirlistplus3 {
 	entryplus3 *entries;
 	bool_t eof;
+	/* Not on the wire: when set, the entries already encoded, each
+	 * behind its value follows word, instead of entries.
+	 */
+	char *entries_wire;
+	u_int entries_wire_len;
 };
 typedef struct dirlistplus3 dirlistplus3;
 
@@ -1149,4 +1154,13 @@ extern bool xdr_COMMIT3res(XDR *, COMMIT3res *);
 extern bool xdr_fhandle2(XDR *, fhandle2);
 extern bool xdr_fhstatus2(XDR *, fhstatus2 *);
 
+/* Fast paths, in xdr_nfs23_fast.c */
+extern bool xdr_GETATTR3res_fast(XDR *, GETATTR3res *);
+extern bool xdr_LOOKUP3res_fast(XDR *, LOOKUP3res *);
+extern bool xdr_ACCESS3res_fast(XDR *, ACCESS3res *);
+extern bool xdr_READ3args_fast(XDR *, READ3args *);
+extern bool xdr_READ3res_fast(XDR *, READ3res *);
+extern bool xdr_WRITE3args_fast(XDR *, WRITE3args *);
+extern bool xdr_WRITE3res_fast(XDR *, WRITE3res *);
+
 #endif				/* !_NFS23_H_RPCGEN */
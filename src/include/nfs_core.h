@@ -133,6 +133,7 @@ extern verifier4 NFS4_write_verifier;	/*< NFS V4 write verifier */
 extern writeverf3 NFS3_write_verifier;	/*< NFS V3 write verifier */
 
 extern char *config_path;
+extern char *config_cache_path;
 extern char *pidfile_path;
 
 /*
@@ -201,6 +202,7 @@ int b64_pton(char const *src, u_char *target, size_t targsize);
 unsigned int nfs_core_select_worker_queue(unsigned int avoid_index);
 
 int nfs_Init_ip_name(void);
+int nfs_ip_name_shutdown(void);
 
 void nfs_rpc_destroy_chan(rpc_call_channel_t *chan);
 int32_t nfs_rpc_dispatch_call(rpc_call_t *call, uint32_t flags);
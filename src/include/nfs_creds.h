@@ -51,6 +51,14 @@ nfsstat4 nfs_req_creds(struct svc_req *req);
 
 nfsstat4 nfs4_export_check_access(struct svc_req *req);
 
+struct nfs_cred_cache;
+
+struct nfs_cred_cache *nfs_cred_cache_alloc(void);
+void nfs_cred_cache_free(struct nfs_cred_cache *cache);
+struct nfs_cred_cache *nfs_xprt_cred_cache(SVCXPRT *xprt);
+bool nfs_cred_cache_get(struct nfs_cred_cache *cache, struct svc_req *req);
+void nfs_cred_cache_put(struct nfs_cred_cache *cache, struct svc_req *req);
+
 fsal_errors_t nfs_access_op(struct fsal_obj_handle *hdl,
 				   uint32_t requested_access,
 				   uint32_t *granted_access,
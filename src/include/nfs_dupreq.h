@@ -145,5 +145,6 @@ dupreq_status_t nfs_dupreq_start(nfs_request_t *,
 dupreq_status_t nfs_dupreq_finish(struct svc_req *, nfs_res_t *);
 dupreq_status_t nfs_dupreq_delete(struct svc_req *);
 void nfs_dupreq_rele(struct svc_req *, const nfs_function_desc_t *);
+bool nfs_dupreq_is_nocache(struct svc_req *);
 
 #endif /* NFS_DUPREQ_H */
@@ -220,6 +220,8 @@ typedef struct exportlist_client_entry__ {
 uid_t get_anonymous_uid(void);
 gid_t get_anonymous_gid(void);
 void export_check_access(void);
+uint64_t export_access_generation(struct gsh_export *export);
+bool export_access_expire(struct gsh_export *export, time_t *expire);
 
 bool export_check_security(struct svc_req *req);
 
@@ -236,6 +238,26 @@ int ReadExports(config_file_t in_config,
 		struct config_error_type *err_type);
 int reread_exports(config_file_t in_config,
 		struct config_error_type *err_type);
+
+/**
+ * @brief Export reload statistics
+ *
+ * Latencies are in nanoseconds, the block counts are for the last
+ * reload.
+ */
+struct export_reload_stats {
+	uint64_t reloads;	/*< Reloads done */
+	uint64_t last_latency;	/*< Time the last reload took */
+	uint64_t max_latency;	/*< Longest reload */
+	uint64_t total_latency;	/*< Time taken by all reloads */
+	uint64_t added;		/*< EXPORT blocks for new exports */
+	uint64_t updated;	/*< Changed EXPORT blocks applied */
+	uint64_t unchanged;	/*< EXPORT blocks skipped */
+	uint64_t removed;	/*< Exports no longer in the config */
+	uint64_t failed;	/*< EXPORT blocks that did not apply */
+};
+
+void export_reload_get_stats(struct export_reload_stats *stats);
 void free_export_resources(struct gsh_export *exp);
 
 void exports_pkginit(void);
@@ -19,6 +19,7 @@
 /* NFS IPaddr cache entry structure */
 typedef struct nfs_ip_name__ {
 	time_t timestamp;
+	bool negative;		/* hostname is the address, it did not resolve */
 	char hostname[MAXHOSTNAMELEN + 1];
 } nfs_ip_name_t;
 
@@ -26,6 +27,13 @@ int nfs_ip_name_get(sockaddr_t *ipaddr, char *hostname, size_t size);
 int nfs_ip_name_add(sockaddr_t *ipaddr, char *hostname, size_t size);
 int nfs_ip_name_remove(sockaddr_t *ipaddr);
 
+/* Same as getnameinfo */
+typedef int (*ip_name_resolver_t)(const struct sockaddr *sa, socklen_t salen,
+				  char *host, socklen_t hostlen,
+				  char *serv, socklen_t servlen, int flags);
+
+void nfs_ip_name_set_resolver(ip_name_resolver_t resolver);
+
 int display_ip_name_key(struct gsh_buffdesc *pbuff, char *str);
 int display_ip_name_val(struct gsh_buffdesc *pbuff, char *str);
 int compare_ip_name(struct gsh_buffdesc *buff1, struct gsh_buffdesc *buff2);
@@ -199,7 +199,9 @@ typedef struct nfs_request {
 
 enum rpc_chan_type {
 	RPC_CHAN_V40,
-	RPC_CHAN_V41
+	RPC_CHAN_V41,
+	RPC_CHAN_LOCAL		/*< in-process stand-in for a client,
+				    used by the callback simulator */
 };
 
 typedef struct rpc_call_channel {
@@ -216,6 +218,10 @@ typedef struct rpc_call_channel {
 #ifdef _HAVE_GSSAPI
 	struct rpc_gss_sec gss_sec;
 #endif /* _HAVE_GSSAPI */
+	/** Calls waiting for the call in flight on this channel.
+	    Protected by the channel queue lock in nfs_rpc_callback.c */
+	struct glist_head pending;
+	bool busy;		/*< A call is queued or being dispatched */
 } rpc_call_channel_t;
 
 /**
@@ -333,6 +333,26 @@ int nfs4_op_seek(struct nfs_argop4 *, compound_data_t *,
 
 void nfs4_op_seek_Free(nfs_resop4 *resp);
 
+int nfs4_op_copy(struct nfs_argop4 *, compound_data_t *,
+		 struct nfs_resop4 *);
+
+void nfs4_op_copy_Free(nfs_resop4 *resp);
+
+int nfs4_op_offload_status(struct nfs_argop4 *, compound_data_t *,
+			   struct nfs_resop4 *);
+
+void nfs4_op_offload_status_Free(nfs_resop4 *resp);
+
+int nfs4_op_offload_cancel(struct nfs_argop4 *, compound_data_t *,
+			   struct nfs_resop4 *);
+
+void nfs4_op_offload_cancel_Free(nfs_resop4 *resp);
+
+int nfs4_op_clone(struct nfs_argop4 *, compound_data_t *,
+		  struct nfs_resop4 *);
+
+void nfs4_op_clone_Free(nfs_resop4 *resp);
+
 int nfs4_op_io_advise(struct nfs_argop4 *, compound_data_t *,
 		      struct nfs_resop4 *);
 
@@ -432,6 +452,8 @@ void nfs4_Compound_FreeOne(nfs_resop4 *);
 void nfs4_Compound_Free(nfs_res_t *);
 void nfs4_Compound_CopyResOne(nfs_resop4 *, nfs_resop4 *);
 void nfs4_Compound_CopyRes(nfs_res_t *, nfs_res_t *);
+void nfs4_copy_offload_init(void);
+int nfs4_copy_offload_shutdown(void);
 
 void nfs4_op_access_Free(nfs_resop4 *);
 void nfs4_op_close_Free(nfs_resop4 *);
@@ -43,6 +43,7 @@
 #include "nfs_file_handle.h"
 #include "sal_data.h"
 #include "fsal.h"
+#include "gsh_arena.h"
 
 /* Hard and soft limit for nfsv4 quotas */
 #define NFS_V4_MAX_QUOTA_SOFT 4294967296LL	/*  4 GB */
@@ -67,6 +68,8 @@ typedef enum {
 	FATTR_BADOWNER
 } fattr_xdr_result;
 
+struct fattr4_plan;
+
 struct xdr_attrs_args {
 	struct attrlist *attrs;
 	nfs_fh4 *hdl4;
@@ -85,6 +88,11 @@ struct xdr_attrs_args {
 	compound_data_t *data;
 	bool statfscalled;
 	fsal_dynamicfsinfo_t *dynamicinfo;
+	bool to_wire;		/*< Encode into the reply rather than a
+				   buffer when the attributes allow it */
+	const struct fattr4_plan *plan;	/*< Set while encoding */
+	struct fattr4_wire *wire;	/*< Set while encoding from a
+					   fattr4_wire */
 };
 
 typedef struct fattr4_dent {
@@ -224,6 +232,30 @@ static inline bool clear_attribute_in_bitmap(struct bitmap4 *bits, int attr)
 	return true;
 }
 
+/**
+ * @brief Check that every attribute of a bitmap is in another
+ *
+ * Works a word, 32 attributes, at a time.
+ *
+ * @param[in] bits The attributes to check
+ * @param[in] of   The attributes allowed
+ *
+ * @return true if bits is a subset of of.
+ */
+
+static inline bool bitmap4_is_subset(const struct bitmap4 *bits,
+				     const struct bitmap4 *of)
+{
+	uint32_t extra = 0;
+	u_int i;
+
+	for (i = 0; i < bits->bitmap4_len && i < BITMAP4_MAPLEN; i++)
+		extra |= bits->map[i] & ~(i < of->bitmap4_len ? of->map[i] : 0);
+
+	/* a longer bitmap than we can hold has attributes nobody knows */
+	return extra == 0 && bits->bitmap4_len <= BITMAP4_MAPLEN;
+}
+
 #ifdef _USE_NFS3
 void nfs_SetWccData(const struct pre_op_attr *before_attr,
 		    struct fsal_obj_handle *entry,
@@ -243,6 +275,46 @@ int nfs3_Sattr_To_FSAL_attr(struct attrlist *pFSALattr, sattr3 *psattr);
 
 void nfs4_Fattr_Free(fattr4 *fattr);
 
+/**
+ * @brief Allocate memory that lives until the reply is sent
+ *
+ * The memory comes from the request's arena when it has one, and from
+ * the heap otherwise, in which case it must outlive the request (the
+ * result is kept in a reply cache).  Either way release it with
+ * req_free().
+ */
+static inline void *req_alloc(size_t size)
+{
+	if (op_ctx != NULL && op_ctx->arena != NULL)
+		return gsh_arena_alloc(op_ctx->arena, size);
+	return gsh_malloc(size);
+}
+
+static inline void *req_calloc(size_t n, size_t size)
+{
+	if (op_ctx != NULL && op_ctx->arena != NULL)
+		return gsh_arena_calloc(op_ctx->arena, n, size);
+	return gsh_calloc(n, size);
+}
+
+/**
+ * @brief Release memory from req_alloc()
+ *
+ * Arena memory goes when the arena is reset, so only heap memory is
+ * freed.  Cached results are freed long after their request, from
+ * whatever request evicts them, so ownership is checked rather than
+ * assumed.
+ */
+static inline void req_free(void *ptr)
+{
+	if (ptr == NULL)
+		return;
+	if (op_ctx != NULL && op_ctx->arena != NULL &&
+	    gsh_arena_owns(op_ctx->arena, ptr))
+		return;
+	gsh_free(ptr);
+}
+
 nfsstat4 nfs4_return_one_state(struct fsal_obj_handle *obj,
 			       layoutreturn_type4 return_type,
 			       enum fsal_layoutreturn_circumstance circumstance,
@@ -270,7 +342,8 @@ nfsstat4 file_To_Fattr(compound_data_t *data,
 		       attrmask_t mask,
 		       struct attrlist *attr,
 		       fattr4 *Fattr,
-		       struct bitmap4 *Bitmap);
+		       struct bitmap4 *Bitmap,
+		       bool to_wire);
 
 bool nfs4_Fattr_Check_Access(fattr4 *, int);
 bool nfs4_Fattr_Check_Access_Bitmap(struct bitmap4 *, int);
@@ -295,6 +368,9 @@ int nfs4_Fattr_Fill_Error(fattr4 *, nfsstat4);
 int nfs4_FSALattr_To_Fattr(struct xdr_attrs_args *, struct bitmap4 *,
 			   fattr4 *);
 
+int nfs4_FSALattr_Encode(struct xdr_attrs_args *, struct bitmap4 *,
+			 char *, u_int, u_int *);
+
 void nfs4_bitmap4_Remove_Unsupported(struct bitmap4 *);
 
 enum nfs4_minor_vers {
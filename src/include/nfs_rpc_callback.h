@@ -140,6 +140,7 @@ int nfs_rpc_call_init(rpc_call_t call, uint32_t flags);
 #define NFS_RPC_CALL_NONE 0x0000
 #define NFS_RPC_CALL_INLINE 0x0001	/*< execute in current thread ctxt */
 #define NFS_RPC_CALL_BROADCAST 0x0002
+#define NFS_RPC_CALL_CHAN_QUEUED 0x0004	/*< went through the channel queue */
 
 /* Submit rpc to be called on chan, optionally waiting for completion. */
 int32_t nfs_rpc_submit_call(rpc_call_t *call, void *completion_arg,
@@ -158,4 +159,34 @@ void nfs41_complete_single(rpc_call_t *call, rpc_call_hook hook, void *arg,
 			   uint32_t flags);
 enum clnt_stat nfs_test_cb_chan(nfs_client_id_t *);
 
+/**
+ * @brief A set of callbacks sent in parallel
+ *
+ * Callers issuing the same callback to many clients (e.g. recalling
+ * every read delegation on a file) count each submitted call with
+ * nfs_rpc_cb_batch_add() and report each completion with
+ * nfs_rpc_cb_batch_done().  nfs_rpc_cb_batch_wait() is a completion
+ * barrier for the whole set.
+ *
+ * The batch is reference counted: the allocator holds one reference
+ * and every outstanding call holds one.
+ */
+struct nfs_rpc_cb_batch {
+	pthread_mutex_t mtx;
+	pthread_cond_t cv;
+	int32_t refcnt;
+	uint32_t issued;	/*< calls added to the batch */
+	uint32_t completed;	/*< calls answered successfully */
+	uint32_t failed;	/*< calls that failed or were never sent */
+	struct timespec start;	/*< batch creation time */
+	nsecs_elapsed_t last;	/*< time from start to latest completion */
+};
+
+struct nfs_rpc_cb_batch *nfs_rpc_cb_batch_alloc(void);
+void nfs_rpc_cb_batch_add(struct nfs_rpc_cb_batch *batch);
+void nfs_rpc_cb_batch_done(struct nfs_rpc_cb_batch *batch, bool success);
+bool nfs_rpc_cb_batch_wait(struct nfs_rpc_cb_batch *batch,
+			   uint32_t timeout_ms);
+void nfs_rpc_cb_batch_put(struct nfs_rpc_cb_batch *batch);
+
 #endif /* !NFS_RPC_CALLBACK_H */
@@ -32,6 +32,7 @@
 
 #include "config.h"
 #include "log.h"
+#include "nfs_core.h"
 
 /**
  *
@@ -52,5 +53,6 @@
 
 void nfs_rpc_cbsim_pkginit(void);
 void nfs_rpc_cbsim_pkgshutdown(void);
+enum clnt_stat nfs_rpc_cbsim_local_call(rpc_call_t *call);
 
 #endif				/* _NFS_RPC_CALLBACK_SIMULATOR_H */
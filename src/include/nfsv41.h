@@ -836,12 +836,19 @@ extern "C" {
 /* NFSv4.3 */
 #define FATTR4_XATTR_SUPPORT 81
 
+	struct fattr4_wire;
+
 	struct fattr4 {
 		struct bitmap4 attrmask;
 		attrlist4 attr_vals;
+		/* Not on the wire: when set, attr_vals is generated from
+		 * this at encode time, attrlist4_len bytes of it */
+		struct fattr4_wire *attr_wire;
 	};
 	typedef struct fattr4 fattr4;
 
+	bool xdr_fattr4_wire(XDR * xdrs, fattr4 *objp);
+
 	struct change_info4 {
 		bool_t atomic;
 		changeid4 before;
@@ -1676,6 +1683,11 @@ extern "C" {
 	struct dirlist4 {
 		entry4 *entries;
 		bool_t eof;
+		/* Not on the wire: when set, the entries already encoded,
+		 * each behind its value follows word, instead of entries.
+		 */
+		char *entries_wire;
+		u_int entries_wire_len;
 	};
 	typedef struct dirlist4 dirlist4;
 
@@ -2511,6 +2523,16 @@ extern "C" {
 	};
 	typedef enum netloc_type4 netloc_type4;
 
+	struct netloc4 {
+		netloc_type4        nl_type;
+		union {
+			utf8str_cis nl_name;
+			utf8str_cis nl_url;
+			netaddr4    nl_addr;
+		};
+	};
+	typedef struct netloc4 netloc4;
+
 	enum data_content4 {
 		NFS4_CONTENT_DATA       = 0,
 		NFS4_CONTENT_HOLE       = 1,
@@ -2622,33 +2644,59 @@ extern "C" {
 		offset4         ca_src_offset;
 		offset4         ca_dst_offset;
 		length4         ca_count;
-		netloc_type4        ca_type;
-		union {
-			utf8str_cis ca_name;
-			utf8str_cis ca_url;
-			netaddr4    ca_addr;
-		};
+		bool_t          ca_consecutive;
+		bool_t          ca_synchronous;
+		struct {
+			u_int ca_source_server_len;
+			netloc4 *ca_source_server_val;
+		} ca_source_server;
 	};
 	typedef struct COPY4args COPY4args;
 
+	struct copy_requirements4 {
+		bool_t          cr_consecutive;
+		bool_t          cr_synchronous;
+	};
+	typedef struct copy_requirements4 copy_requirements4;
+
+	struct COPY4resok {
+		write_response4    cr_response;
+		copy_requirements4 cr_requirements;
+	};
+	typedef struct COPY4resok COPY4resok;
+
 	struct COPY4res {
 		nfsstat4 cr_status;
 		union {
-			write_response4 cr_resok4;
-			length4         cr_bytes_copied;
+			COPY4resok         cr_resok4;
+			copy_requirements4 cr_requirements;
 		} COPY4res_u;
 	};
 	typedef struct COPY4res COPY4res;
 
-	struct OFFLOAD_ABORT4args {
-		stateid4        oaa_stateid;
+	struct OFFLOAD_CANCEL4args {
+		stateid4        oca_stateid;
+	};
+	typedef struct OFFLOAD_CANCEL4args OFFLOAD_CANCEL4args;
+
+	struct OFFLOAD_CANCEL4res {
+		nfsstat4        ocr_status;
+	};
+	typedef struct OFFLOAD_CANCEL4res OFFLOAD_CANCEL4res;
+
+	struct CLONE4args {
+		stateid4        cl_src_stateid;
+		stateid4        cl_dst_stateid;
+		offset4         cl_src_offset;
+		offset4         cl_dst_offset;
+		length4         cl_count;
 	};
-	typedef struct OFFLOAD_ABORT4args OFFLOAD_ABORT4args;
+	typedef struct CLONE4args CLONE4args;
 
-	struct OFFLOAD_ABORT4res {
-		stateid4        oar_stateid;
+	struct CLONE4res {
+		nfsstat4        cl_status;
 	};
-	typedef struct OFFLOAD_ABORT4res OFFLOAD_ABORT4res;
+	typedef struct CLONE4res CLONE4res;
 
 	struct OFFLOAD_STATUS4args {
 		stateid4        osa_stateid;
@@ -3167,8 +3215,9 @@ extern "C" {
 			COPY_NOTIFY4args opoffload_notify;
 			OFFLOAD_REVOKE4args opcopy_revoke;
 			COPY4args opcopy;
-			OFFLOAD_ABORT4args opoffload_abort;
+			OFFLOAD_CANCEL4args opoffload_cancel;
 			OFFLOAD_STATUS4args opoffload_status;
+			CLONE4args opclone;
 			WRITE_SAME4args opwrite_plus;
 			ALLOCATE4args opallocate;
 			DEALLOCATE4args opdeallocate;
@@ -3252,8 +3301,9 @@ extern "C" {
 			COPY_NOTIFY4res opoffload_notify;
 			OFFLOAD_REVOKE4res opcopy_revoke;
 			COPY4res opcopy;
-			OFFLOAD_ABORT4res opoffload_abort;
+			OFFLOAD_CANCEL4res opoffload_cancel;
 			OFFLOAD_STATUS4res opoffload_status;
+			CLONE4res opclone;
 			WRITE_SAME4res opwrite_plus;
 			ALLOCATE4res opallocate;
 			DEALLOCATE4res opdeallocate;
@@ -3606,6 +3656,28 @@ extern "C" {
 	};
 	typedef struct CB_NOTIFY_DEVICEID4res CB_NOTIFY_DEVICEID4res;
 
+	/* NFSv4.2 */
+	struct offload_info4 {
+		nfsstat4 coa_status;
+		union {
+			write_response4 coa_resok4;
+			length4 coa_bytes_copied;
+		} offload_info4_u;
+	};
+	typedef struct offload_info4 offload_info4;
+
+	struct CB_OFFLOAD4args {
+		nfs_fh4 coa_fh;
+		stateid4 coa_stateid;
+		offload_info4 coa_offload_info;
+	};
+	typedef struct CB_OFFLOAD4args CB_OFFLOAD4args;
+
+	struct CB_OFFLOAD4res {
+		nfsstat4 cor_status;
+	};
+	typedef struct CB_OFFLOAD4res CB_OFFLOAD4res;
+
 /* Callback operations new to NFSv4.1 */
 
 	enum nfs_cb_opnum4 {
@@ -3621,6 +3693,8 @@ extern "C" {
 		NFS4_OP_CB_WANTS_CANCELLED = 12,
 		NFS4_OP_CB_NOTIFY_LOCK = 13,
 		NFS4_OP_CB_NOTIFY_DEVICEID = 14,
+		/* NFSv4.2 */
+		NFS4_OP_CB_OFFLOAD = 15,
 		NFS4_OP_CB_ILLEGAL = 10044,
 	};
 	typedef enum nfs_cb_opnum4 nfs_cb_opnum4;
@@ -3640,6 +3714,7 @@ extern "C" {
 			CB_WANTS_CANCELLED4args opcbwants_cancelled;
 			CB_NOTIFY_LOCK4args opcbnotify_lock;
 			CB_NOTIFY_DEVICEID4args opcbnotify_deviceid;
+			CB_OFFLOAD4args opcboffload;
 		} nfs_cb_argop4_u;
 	};
 	typedef struct nfs_cb_argop4 nfs_cb_argop4;
@@ -3659,6 +3734,7 @@ extern "C" {
 			CB_WANTS_CANCELLED4res opcbwants_cancelled;
 			CB_NOTIFY_LOCK4res opcbnotify_lock;
 			CB_NOTIFY_DEVICEID4res opcbnotify_deviceid;
+			CB_OFFLOAD4res opcboffload;
 			CB_ILLEGAL4res opcbillegal;
 		} nfs_cb_resop4_u;
 	};
@@ -5027,6 +5103,10 @@ extern "C" {
 
 	static inline bool xdr_fattr4(XDR * xdrs, fattr4 *objp)
 	{
+		if (xdrs->x_op == XDR_ENCODE && objp->attr_wire != NULL)
+			return xdr_fattr4_wire(xdrs, objp);
+		if (xdrs->x_op == XDR_DECODE)
+			objp->attr_wire = NULL;
 		if (!xdr_bitmap4(xdrs, &objp->attrmask))
 			return false;
 		if (!xdr_attrlist4(xdrs, &objp->attr_vals))
@@ -6440,6 +6520,22 @@ extern "C" {
 
 	static inline bool xdr_dirlist4(XDR * xdrs, dirlist4 *objp)
 	{
+		if (xdrs->x_op == XDR_ENCODE && objp->entries_wire != NULL) {
+			bool_t more = FALSE;
+
+			if (!xdr_opaque(xdrs, objp->entries_wire,
+					objp->entries_wire_len))
+				return false;
+			if (!inline_xdr_bool(xdrs, &more))
+				return false;
+			if (!inline_xdr_bool(xdrs, &objp->eof))
+				return false;
+			return true;
+		}
+		if (xdrs->x_op == XDR_DECODE) {
+			objp->entries_wire = NULL;
+			objp->entries_wire_len = 0;
+		}
 		if (!xdr_pointer
 		    (xdrs, (char **)&objp->entries, sizeof(entry4),
 		     (xdrproc_t) xdr_entry4))
@@ -8063,6 +8159,158 @@ extern "C" {
 		return true;
 	}
 
+	static inline bool xdr_netloc4(XDR * xdrs, netloc4 *objp)
+	{
+		if (!inline_xdr_enum(xdrs, (enum_t *)&objp->nl_type))
+			return false;
+		switch (objp->nl_type) {
+		case NL4_NAME:
+			if (!xdr_utf8str_cis(xdrs, &objp->nl_name))
+				return false;
+			break;
+		case NL4_URL:
+			if (!xdr_utf8str_cis(xdrs, &objp->nl_url))
+				return false;
+			break;
+		case NL4_NETADDR:
+			if (!xdr_netaddr4(xdrs, &objp->nl_addr))
+				return false;
+			break;
+		default:
+			return false;
+		}
+		return true;
+	}
+
+	static inline bool xdr_COPY4args(XDR * xdrs, COPY4args *objp)
+	{
+		if (!xdr_stateid4(xdrs, &objp->ca_src_stateid))
+			return false;
+		if (!xdr_stateid4(xdrs, &objp->ca_dst_stateid))
+			return false;
+		if (!xdr_offset4(xdrs, &objp->ca_src_offset))
+			return false;
+		if (!xdr_offset4(xdrs, &objp->ca_dst_offset))
+			return false;
+		if (!xdr_length4(xdrs, &objp->ca_count))
+			return false;
+		if (!inline_xdr_bool(xdrs, &objp->ca_consecutive))
+			return false;
+		if (!inline_xdr_bool(xdrs, &objp->ca_synchronous))
+			return false;
+		if (!xdr_array
+		    (xdrs,
+		     (char **)&objp->ca_source_server.ca_source_server_val,
+		     &objp->ca_source_server.ca_source_server_len,
+		     XDR_ARRAY_MAXLEN,
+		     sizeof(netloc4), (xdrproc_t) xdr_netloc4))
+			return false;
+		return true;
+	}
+
+	static inline bool xdr_copy_requirements4(XDR * xdrs,
+						  copy_requirements4 *objp)
+	{
+		if (!inline_xdr_bool(xdrs, &objp->cr_consecutive))
+			return false;
+		if (!inline_xdr_bool(xdrs, &objp->cr_synchronous))
+			return false;
+		return true;
+	}
+
+	static inline bool xdr_COPY4res(XDR * xdrs, COPY4res *objp)
+	{
+		if (!xdr_nfsstat4(xdrs, &objp->cr_status))
+			return false;
+		switch (objp->cr_status) {
+		case NFS4_OK:
+			if (!xdr_WRITE_SAME4resok
+			    (xdrs, &objp->COPY4res_u.cr_resok4.cr_response))
+				return false;
+			if (!xdr_copy_requirements4
+			    (xdrs, &objp->COPY4res_u.cr_resok4.cr_requirements))
+				return false;
+			break;
+		case NFS4ERR_OFFLOAD_NO_REQS:
+			if (!xdr_copy_requirements4
+			    (xdrs, &objp->COPY4res_u.cr_requirements))
+				return false;
+			break;
+		default:
+			break;
+		}
+		return true;
+	}
+
+	static inline bool xdr_OFFLOAD_CANCEL4args(XDR * xdrs,
+						   OFFLOAD_CANCEL4args *objp)
+	{
+		if (!xdr_stateid4(xdrs, &objp->oca_stateid))
+			return false;
+		return true;
+	}
+
+	static inline bool xdr_OFFLOAD_CANCEL4res(XDR * xdrs,
+						  OFFLOAD_CANCEL4res *objp)
+	{
+		if (!xdr_nfsstat4(xdrs, &objp->ocr_status))
+			return false;
+		return true;
+	}
+
+	static inline bool xdr_OFFLOAD_STATUS4args(XDR * xdrs,
+						   OFFLOAD_STATUS4args *objp)
+	{
+		if (!xdr_stateid4(xdrs, &objp->osa_stateid))
+			return false;
+		return true;
+	}
+
+	static inline bool xdr_OFFLOAD_STATUS4res(XDR * xdrs,
+						  OFFLOAD_STATUS4res *objp)
+	{
+		OFFLOAD_STATUS4resok *resok =
+			&objp->OFFLOAD_STATUS4res_u.osr_resok4;
+
+		if (!xdr_nfsstat4(xdrs, &objp->osr_status))
+			return false;
+		if (objp->osr_status != NFS4_OK)
+			return true;
+		if (!xdr_length4(xdrs, &resok->osr_bytes_copied))
+			return false;
+		/* osr_complete is an array of at most one status */
+		if (!xdr_count4(xdrs, &resok->osr_count_complete))
+			return false;
+		if (resok->osr_count_complete > 1)
+			return false;
+		if (resok->osr_count_complete == 1)
+			if (!xdr_nfsstat4(xdrs, &resok->osr_complete))
+				return false;
+		return true;
+	}
+
+	static inline bool xdr_CLONE4args(XDR * xdrs, CLONE4args *objp)
+	{
+		if (!xdr_stateid4(xdrs, &objp->cl_src_stateid))
+			return false;
+		if (!xdr_stateid4(xdrs, &objp->cl_dst_stateid))
+			return false;
+		if (!xdr_offset4(xdrs, &objp->cl_src_offset))
+			return false;
+		if (!xdr_offset4(xdrs, &objp->cl_dst_offset))
+			return false;
+		if (!xdr_length4(xdrs, &objp->cl_count))
+			return false;
+		return true;
+	}
+
+	static inline bool xdr_CLONE4res(XDR * xdrs, CLONE4res *objp)
+	{
+		if (!xdr_nfsstat4(xdrs, &objp->cl_status))
+			return false;
+		return true;
+	}
+
 	static inline bool xdr_data_contents(XDR * xdrs, contents *objp)
 	{
 		if (!inline_xdr_enum(xdrs, (enum_t *)&objp->what))
@@ -8213,6 +8461,318 @@ extern "C" {
 		return true;
 	}
 
+/*
+ * Fast paths for the hottest ops.
+ *
+ * The fixed size part of each message is converted in one buffer from
+ * XDR_INLINE, instead of with a call through the XDR ops per field.
+ * Whenever the stream cannot hand out a contiguous buffer, and for
+ * XDR_FREE, the generic routine does the work, so both give the same
+ * result.  PUTFH4res and LOOKUP4res are a bare status, and fattr4 has
+ * its own encoder, so those ops only have fast arguments.
+ */
+
+	static inline bool xdr_fast_bitmap4(XDR * xdrs, struct bitmap4 *objp)
+	{
+		u_int i, mapsize;
+		int32_t *buf;
+
+		if (objp->bitmap4_len > BITMAP4_MAPLEN &&
+		    xdrs->x_op == XDR_ENCODE)
+			return xdr_bitmap4(xdrs, objp);
+
+		buf = xdr_fast_inline(xdrs, 1 + (xdrs->x_op == XDR_ENCODE
+						 ? objp->bitmap4_len : 0));
+		if (buf == NULL)
+			return xdr_bitmap4(xdrs, objp);
+
+		if (xdrs->x_op == XDR_ENCODE) {
+			ixdr_put_u_int32(&buf, objp->bitmap4_len);
+			for (i = 0; i < objp->bitmap4_len; i++)
+				ixdr_put_u_int32(&buf, objp->map[i]);
+			return true;
+		}
+
+		/* as xdr_bitmap4, keep what fits and skip the rest */
+		objp->bitmap4_len = ixdr_get_u_int32(&buf);
+		mapsize = MIN(objp->bitmap4_len, BITMAP4_MAPLEN);
+		buf = objp->bitmap4_len > BITMAP4_MAPLEN ? NULL
+			: xdr_fast_inline(xdrs, objp->bitmap4_len);
+		for (i = 0; i < objp->bitmap4_len; i++) {
+			u_int32_t crud = 0;
+			u_int32_t *val = i < mapsize ? &objp->map[i] : &crud;
+
+			if (buf != NULL)
+				*val = ixdr_get_u_int32(&buf);
+			else if (!inline_xdr_u_int32_t(xdrs, val))
+				return false;
+		}
+		objp->bitmap4_len = mapsize;
+		return true;
+	}
+
+	static inline void xdr_fast_put_stateid4(int32_t **buf,
+						 stateid4 *objp)
+	{
+		ixdr_put_u_int32(buf, objp->seqid);
+		ixdr_put_opaque(buf, objp->other, sizeof(objp->other));
+	}
+
+	static inline void xdr_fast_get_stateid4(int32_t **buf,
+						 stateid4 *objp)
+	{
+		objp->seqid = ixdr_get_u_int32(buf);
+		ixdr_get_opaque(buf, objp->other, sizeof(objp->other));
+	}
+
+#define STATEID4_WORDS (1 + XDR_WORDS(12))
+
+	static inline bool xdr_SEQUENCE4args_fast(XDR * xdrs,
+						  SEQUENCE4args *objp)
+	{
+		int32_t *buf = xdr_fast_inline(xdrs,
+					XDR_WORDS(NFS4_SESSIONID_SIZE) + 4);
+
+		if (buf == NULL)
+			return xdr_SEQUENCE4args(xdrs, objp);
+
+		if (xdrs->x_op == XDR_ENCODE) {
+			ixdr_put_opaque(&buf, objp->sa_sessionid,
+					NFS4_SESSIONID_SIZE);
+			ixdr_put_u_int32(&buf, objp->sa_sequenceid);
+			ixdr_put_u_int32(&buf, objp->sa_slotid);
+			ixdr_put_u_int32(&buf, objp->sa_highest_slotid);
+			ixdr_put_u_int32(&buf, objp->sa_cachethis ? 1 : 0);
+		} else {
+			ixdr_get_opaque(&buf, objp->sa_sessionid,
+					NFS4_SESSIONID_SIZE);
+			objp->sa_sequenceid = ixdr_get_u_int32(&buf);
+			objp->sa_slotid = ixdr_get_u_int32(&buf);
+			objp->sa_highest_slotid = ixdr_get_u_int32(&buf);
+			objp->sa_cachethis = ixdr_get_u_int32(&buf) != 0;
+		}
+		return true;
+	}
+
+	static inline bool xdr_SEQUENCE4res_fast(XDR * xdrs,
+						 SEQUENCE4res *objp)
+	{
+		SEQUENCE4resok *resok = &objp->SEQUENCE4res_u.sr_resok4;
+		const u_int resok_words = XDR_WORDS(NFS4_SESSIONID_SIZE) + 5;
+		int32_t *buf;
+
+		if (xdrs->x_op == XDR_ENCODE) {
+			buf = xdr_fast_inline(xdrs, objp->sr_status == NFS4_OK
+					      ? 1 + resok_words : 1);
+			if (buf == NULL)
+				return xdr_SEQUENCE4res(xdrs, objp);
+			ixdr_put_u_int32(&buf, objp->sr_status);
+			if (objp->sr_status != NFS4_OK)
+				return true;
+			ixdr_put_opaque(&buf, resok->sr_sessionid,
+					NFS4_SESSIONID_SIZE);
+			ixdr_put_u_int32(&buf, resok->sr_sequenceid);
+			ixdr_put_u_int32(&buf, resok->sr_slotid);
+			ixdr_put_u_int32(&buf, resok->sr_highest_slotid);
+			ixdr_put_u_int32(&buf,
+					 resok->sr_target_highest_slotid);
+			ixdr_put_u_int32(&buf, resok->sr_status_flags);
+			return true;
+		}
+
+		buf = xdr_fast_inline(xdrs, 1);
+		if (buf == NULL)
+			return xdr_SEQUENCE4res(xdrs, objp);
+		objp->sr_status = (nfsstat4) ixdr_get_u_int32(&buf);
+		if (objp->sr_status != NFS4_OK)
+			return true;
+		buf = xdr_fast_inline(xdrs, resok_words);
+		if (buf == NULL)
+			return xdr_SEQUENCE4resok(xdrs, resok);
+		ixdr_get_opaque(&buf, resok->sr_sessionid,
+				NFS4_SESSIONID_SIZE);
+		resok->sr_sequenceid = ixdr_get_u_int32(&buf);
+		resok->sr_slotid = ixdr_get_u_int32(&buf);
+		resok->sr_highest_slotid = ixdr_get_u_int32(&buf);
+		resok->sr_target_highest_slotid = ixdr_get_u_int32(&buf);
+		resok->sr_status_flags = ixdr_get_u_int32(&buf);
+		return true;
+	}
+
+	static inline bool xdr_PUTFH4args_fast(XDR * xdrs, PUTFH4args *objp)
+	{
+		if (xdrs->x_op != XDR_ENCODE && xdrs->x_op != XDR_DECODE)
+			return xdr_PUTFH4args(xdrs, objp);
+		return xdr_fast_bytes(xdrs, &objp->object.nfs_fh4_val,
+				      &objp->object.nfs_fh4_len, NFS4_FHSIZE);
+	}
+
+	static inline bool xdr_GETATTR4args_fast(XDR * xdrs,
+						 GETATTR4args *objp)
+	{
+		return xdr_fast_bitmap4(xdrs, &objp->attr_request);
+	}
+
+	static inline bool xdr_LOOKUP4args_fast(XDR * xdrs, LOOKUP4args *objp)
+	{
+		if (xdrs->x_op != XDR_ENCODE && xdrs->x_op != XDR_DECODE)
+			return xdr_LOOKUP4args(xdrs, objp);
+		return xdr_fast_bytes(xdrs, &objp->objname.utf8string_val,
+				      &objp->objname.utf8string_len,
+				      XDR_STRING_MAXLEN);
+	}
+
+	static inline bool xdr_ACCESS4args_fast(XDR * xdrs, ACCESS4args *objp)
+	{
+		int32_t *buf = xdr_fast_inline(xdrs, 1);
+
+		if (buf == NULL)
+			return xdr_ACCESS4args(xdrs, objp);
+
+		if (xdrs->x_op == XDR_ENCODE)
+			ixdr_put_u_int32(&buf, objp->access);
+		else
+			objp->access = ixdr_get_u_int32(&buf);
+		return true;
+	}
+
+	static inline bool xdr_ACCESS4res_fast(XDR * xdrs, ACCESS4res *objp)
+	{
+		ACCESS4resok *resok = &objp->ACCESS4res_u.resok4;
+		int32_t *buf;
+
+		if (xdrs->x_op == XDR_ENCODE) {
+			buf = xdr_fast_inline(xdrs,
+					      objp->status == NFS4_OK ? 3 : 1);
+			if (buf == NULL)
+				return xdr_ACCESS4res(xdrs, objp);
+			ixdr_put_u_int32(&buf, objp->status);
+			if (objp->status != NFS4_OK)
+				return true;
+			ixdr_put_u_int32(&buf, resok->supported);
+			ixdr_put_u_int32(&buf, resok->access);
+			return true;
+		}
+
+		buf = xdr_fast_inline(xdrs, 1);
+		if (buf == NULL)
+			return xdr_ACCESS4res(xdrs, objp);
+		objp->status = (nfsstat4) ixdr_get_u_int32(&buf);
+		if (objp->status != NFS4_OK)
+			return true;
+		buf = xdr_fast_inline(xdrs, 2);
+		if (buf == NULL)
+			return xdr_ACCESS4resok(xdrs, resok);
+		resok->supported = ixdr_get_u_int32(&buf);
+		resok->access = ixdr_get_u_int32(&buf);
+		return true;
+	}
+
+	static inline bool xdr_READ4args_fast(XDR * xdrs, READ4args *objp)
+	{
+		int32_t *buf = xdr_fast_inline(xdrs, STATEID4_WORDS + 3);
+
+		if (buf == NULL)
+			return xdr_READ4args(xdrs, objp);
+
+		if (xdrs->x_op == XDR_ENCODE) {
+			xdr_fast_put_stateid4(&buf, &objp->stateid);
+			ixdr_put_u_int64(&buf, objp->offset);
+			ixdr_put_u_int32(&buf, objp->count);
+		} else {
+			xdr_fast_get_stateid4(&buf, &objp->stateid);
+			objp->offset = ixdr_get_u_int64(&buf);
+			objp->count = ixdr_get_u_int32(&buf);
+		}
+		return true;
+	}
+
+	static inline bool xdr_READ4res_fast(XDR * xdrs, READ4res *objp)
+	{
+		READ4resok *resok = &objp->READ4res_u.resok4;
+		int32_t *buf;
+
+		if (xdrs->x_op == XDR_ENCODE) {
+			buf = xdr_fast_inline(xdrs,
+					      objp->status == NFS4_OK ? 2 : 1);
+			if (buf == NULL)
+				return xdr_READ4res(xdrs, objp);
+			ixdr_put_u_int32(&buf, objp->status);
+			if (objp->status != NFS4_OK)
+				return true;
+			ixdr_put_u_int32(&buf, resok->eof ? 1 : 0);
+		} else {
+			buf = xdr_fast_inline(xdrs, 1);
+			if (buf == NULL)
+				return xdr_READ4res(xdrs, objp);
+			objp->status = (nfsstat4) ixdr_get_u_int32(&buf);
+			if (objp->status != NFS4_OK)
+				return true;
+			if (!inline_xdr_bool(xdrs, &resok->eof))
+				return false;
+		}
+		return xdr_fast_bytes(xdrs, &resok->data.data_val,
+				      &resok->data.data_len,
+				      XDR_BYTES_MAXLEN_IO);
+	}
+
+	static inline bool xdr_WRITE4args_fast(XDR * xdrs, WRITE4args *objp)
+	{
+		int32_t *buf = xdr_fast_inline(xdrs, STATEID4_WORDS + 3);
+
+		if (buf == NULL)
+			return xdr_WRITE4args(xdrs, objp);
+
+		if (xdrs->x_op == XDR_ENCODE) {
+			xdr_fast_put_stateid4(&buf, &objp->stateid);
+			ixdr_put_u_int64(&buf, objp->offset);
+			ixdr_put_u_int32(&buf, objp->stable);
+		} else {
+			xdr_fast_get_stateid4(&buf, &objp->stateid);
+			objp->offset = ixdr_get_u_int64(&buf);
+			objp->stable = (stable_how4) ixdr_get_u_int32(&buf);
+		}
+		return xdr_fast_bytes(xdrs, &objp->data.data_val,
+				      &objp->data.data_len,
+				      XDR_BYTES_MAXLEN_IO);
+	}
+
+	static inline bool xdr_WRITE4res_fast(XDR * xdrs, WRITE4res *objp)
+	{
+		WRITE4resok *resok = &objp->WRITE4res_u.resok4;
+		const u_int resok_words = 2 + XDR_WORDS(NFS4_VERIFIER_SIZE);
+		int32_t *buf;
+
+		if (xdrs->x_op == XDR_ENCODE) {
+			buf = xdr_fast_inline(xdrs, objp->status == NFS4_OK
+					      ? 1 + resok_words : 1);
+			if (buf == NULL)
+				return xdr_WRITE4res(xdrs, objp);
+			ixdr_put_u_int32(&buf, objp->status);
+			if (objp->status != NFS4_OK)
+				return true;
+			ixdr_put_u_int32(&buf, resok->count);
+			ixdr_put_u_int32(&buf, resok->committed);
+			ixdr_put_opaque(&buf, resok->writeverf,
+					NFS4_VERIFIER_SIZE);
+			return true;
+		}
+
+		buf = xdr_fast_inline(xdrs, 1);
+		if (buf == NULL)
+			return xdr_WRITE4res(xdrs, objp);
+		objp->status = (nfsstat4) ixdr_get_u_int32(&buf);
+		if (objp->status != NFS4_OK)
+			return true;
+		buf = xdr_fast_inline(xdrs, resok_words);
+		if (buf == NULL)
+			return xdr_WRITE4resok(xdrs, resok);
+		resok->count = ixdr_get_u_int32(&buf);
+		resok->committed = (stable_how4) ixdr_get_u_int32(&buf);
+		ixdr_get_opaque(&buf, resok->writeverf, NFS4_VERIFIER_SIZE);
+		return true;
+	}
+
 /* new operations for NFSv4.1 */
 
 	static inline bool xdr_nfs_opnum4(XDR * xdrs, nfs_opnum4 *objp)
@@ -8237,7 +8797,7 @@ extern "C" {
 			return false;
 		switch (objp->argop) {
 		case NFS4_OP_ACCESS:
-			if (!xdr_ACCESS4args
+			if (!xdr_ACCESS4args_fast
 			    (xdrs, &objp->nfs_argop4_u.opaccess))
 				return false;
 			break;
@@ -8269,7 +8829,7 @@ extern "C" {
 				return false;
 			break;
 		case NFS4_OP_GETATTR:
-			if (!xdr_GETATTR4args
+			if (!xdr_GETATTR4args_fast
 			    (xdrs, &objp->nfs_argop4_u.opgetattr))
 				return false;
 			break;
@@ -8294,7 +8854,7 @@ extern "C" {
 			lkhd->flags |= NFS_LOOKAHEAD_LOCK;
 			break;
 		case NFS4_OP_LOOKUP:
-			if (!xdr_LOOKUP4args
+			if (!xdr_LOOKUP4args_fast
 			    (xdrs, &objp->nfs_argop4_u.oplookup))
 				return false;
 			lkhd->flags |= NFS_LOOKAHEAD_LOOKUP;
@@ -8333,7 +8893,8 @@ extern "C" {
 			lkhd->flags |= NFS_LOOKAHEAD_OPEN;
 			break;
 		case NFS4_OP_PUTFH:
-			if (!xdr_PUTFH4args(xdrs, &objp->nfs_argop4_u.opputfh))
+			if (!xdr_PUTFH4args_fast
+			    (xdrs, &objp->nfs_argop4_u.opputfh))
 				return false;
 			break;
 		case NFS4_OP_PUTPUBFH:
@@ -8341,7 +8902,8 @@ extern "C" {
 		case NFS4_OP_PUTROOTFH:
 			break;
 		case NFS4_OP_READ:
-			if (!xdr_READ4args(xdrs, &objp->nfs_argop4_u.opread))
+			if (!xdr_READ4args_fast
+			    (xdrs, &objp->nfs_argop4_u.opread))
 				return false;
 			lkhd->flags |= NFS_LOOKAHEAD_READ;
 			(lkhd->read)++;
@@ -8404,7 +8966,8 @@ extern "C" {
 				return false;
 			break;
 		case NFS4_OP_WRITE:
-			if (!xdr_WRITE4args(xdrs, &objp->nfs_argop4_u.opwrite))
+			if (!xdr_WRITE4args_fast
+			    (xdrs, &objp->nfs_argop4_u.opwrite))
 				return false;
 			lkhd->flags |= NFS_LOOKAHEAD_WRITE;
 			(lkhd->write)++;
@@ -8481,7 +9044,7 @@ extern "C" {
 				return false;
 			break;
 		case NFS4_OP_SEQUENCE:
-			if (!xdr_SEQUENCE4args
+			if (!xdr_SEQUENCE4args_fast
 			    (xdrs, &objp->nfs_argop4_u.opsequence))
 				return false;
 			break;
@@ -8558,10 +9121,27 @@ extern "C" {
 			break;
 
 		case NFS4_OP_COPY:
-		case NFS4_OP_COPY_NOTIFY:
+			if (!xdr_COPY4args(xdrs,
+					&objp->nfs_argop4_u.opcopy))
+				return false;
+			break;
 		case NFS4_OP_OFFLOAD_CANCEL:
+			if (!xdr_OFFLOAD_CANCEL4args(xdrs,
+					&objp->nfs_argop4_u.opoffload_cancel))
+				return false;
+			break;
 		case NFS4_OP_OFFLOAD_STATUS:
+			if (!xdr_OFFLOAD_STATUS4args(xdrs,
+					&objp->nfs_argop4_u.opoffload_status))
+				return false;
+			break;
 		case NFS4_OP_CLONE:
+			if (!xdr_CLONE4args(xdrs,
+					&objp->nfs_argop4_u.opclone))
+				return false;
+			break;
+
+		case NFS4_OP_COPY_NOTIFY:
 			break;
 
 		/* NFSv4.3 */
@@ -8604,7 +9184,8 @@ extern "C" {
 			return false;
 		switch (objp->resop) {
 		case NFS4_OP_ACCESS:
-			if (!xdr_ACCESS4res(xdrs, &objp->nfs_resop4_u.opaccess))
+			if (!xdr_ACCESS4res_fast
+			    (xdrs, &objp->nfs_resop4_u.opaccess))
 				return false;
 			break;
 		case NFS4_OP_CLOSE:
@@ -8702,7 +9283,8 @@ extern "C" {
 				return false;
 			break;
 		case NFS4_OP_READ:
-			if (!xdr_READ4res(xdrs, &objp->nfs_resop4_u.opread))
+			if (!xdr_READ4res_fast
+			    (xdrs, &objp->nfs_resop4_u.opread))
 				return false;
 			break;
 		case NFS4_OP_READDIR:
@@ -8761,7 +9343,8 @@ extern "C" {
 				return false;
 			break;
 		case NFS4_OP_WRITE:
-			if (!xdr_WRITE4res(xdrs, &objp->nfs_resop4_u.opwrite))
+			if (!xdr_WRITE4res_fast
+			    (xdrs, &objp->nfs_resop4_u.opwrite))
 				return false;
 			break;
 		case NFS4_OP_RELEASE_LOCKOWNER:
@@ -8835,7 +9418,7 @@ extern "C" {
 				return false;
 			break;
 		case NFS4_OP_SEQUENCE:
-			if (!xdr_SEQUENCE4res
+			if (!xdr_SEQUENCE4res_fast
 			    (xdrs, &objp->nfs_resop4_u.opsequence))
 				return false;
 			break;
@@ -8908,10 +9491,27 @@ extern "C" {
 			break;
 
 		case NFS4_OP_COPY:
-		case NFS4_OP_COPY_NOTIFY:
+			if (!xdr_COPY4res(xdrs,
+					&objp->nfs_resop4_u.opcopy))
+				return false;
+			break;
 		case NFS4_OP_OFFLOAD_CANCEL:
+			if (!xdr_OFFLOAD_CANCEL4res(xdrs,
+					&objp->nfs_resop4_u.opoffload_cancel))
+				return false;
+			break;
 		case NFS4_OP_OFFLOAD_STATUS:
+			if (!xdr_OFFLOAD_STATUS4res(xdrs,
+					&objp->nfs_resop4_u.opoffload_status))
+				return false;
+			break;
 		case NFS4_OP_CLONE:
+			if (!xdr_CLONE4res(xdrs,
+					&objp->nfs_resop4_u.opclone))
+				return false;
+			break;
+
+		case NFS4_OP_COPY_NOTIFY:
 
 		/* NFSv4.3 */
 		case NFS4_OP_GETXATTR:
@@ -9720,6 +10320,39 @@ extern "C" {
 		return true;
 	}
 
+	static inline bool xdr_CB_OFFLOAD4args(XDR * xdrs,
+					       CB_OFFLOAD4args *objp)
+	{
+		offload_info4 *info = &objp->coa_offload_info;
+
+		if (!xdr_nfs_fh4(xdrs, &objp->coa_fh))
+			return false;
+		if (!xdr_stateid4(xdrs, &objp->coa_stateid))
+			return false;
+		if (!xdr_nfsstat4(xdrs, &info->coa_status))
+			return false;
+		switch (info->coa_status) {
+		case NFS4_OK:
+			if (!xdr_WRITE_SAME4resok
+			    (xdrs, &info->offload_info4_u.coa_resok4))
+				return false;
+			break;
+		default:
+			if (!xdr_length4
+			    (xdrs, &info->offload_info4_u.coa_bytes_copied))
+				return false;
+			break;
+		}
+		return true;
+	}
+
+	static inline bool xdr_CB_OFFLOAD4res(XDR * xdrs, CB_OFFLOAD4res *objp)
+	{
+		if (!xdr_nfsstat4(xdrs, &objp->cor_status))
+			return false;
+		return true;
+	}
+
 /* Callback operations new to NFSv4.1 */
 
 	static inline bool xdr_nfs_cb_opnum4(XDR * xdrs, nfs_cb_opnum4 *objp)
@@ -9795,6 +10428,11 @@ extern "C" {
 			    (xdrs, &objp->nfs_cb_argop4_u.opcbnotify_deviceid))
 				return false;
 			break;
+		case NFS4_OP_CB_OFFLOAD:
+			if (!xdr_CB_OFFLOAD4args
+			    (xdrs, &objp->nfs_cb_argop4_u.opcboffload))
+				return false;
+			break;
 		case NFS4_OP_CB_ILLEGAL:
 			break;
 		default:
@@ -9869,6 +10507,11 @@ extern "C" {
 			    (xdrs, &objp->nfs_cb_resop4_u.opcbnotify_deviceid))
 				return false;
 			break;
+		case NFS4_OP_CB_OFFLOAD:
+			if (!xdr_CB_OFFLOAD4res
+			    (xdrs, &objp->nfs_cb_resop4_u.opcboffload))
+				return false;
+			break;
 		case NFS4_OP_CB_ILLEGAL:
 			if (!xdr_CB_ILLEGAL4res
 			    (xdrs, &objp->nfs_cb_resop4_u.opcbillegal))
@@ -54,5 +54,10 @@ bool to_vfs_dirent(char *buf, int bpos, struct vfs_dirent *vd, off_t base);
 uid_t setuser(uid_t uid);
 gid_t setgroup(gid_t gid);
 int set_threadgroups(size_t size, const gid_t *list);
+ssize_t vfs_copy_range(int fd_in, off_t off_in, int fd_out, off_t off_out,
+		       size_t len);
+int vfs_clone_range(int fd_in, off_t off_in, int fd_out, off_t off_out,
+		    size_t len);
+int vfs_alloc_range(int fd, off_t offset, off_t len, bool punch);
 
 #endif/* SUBR_OS_H */
@@ -116,13 +116,19 @@ extern pool_t *nfs41_session_pool;
 extern hash_table_t *ht_session_id;
 
 /**
- * @brief Number of forechannel slots in a session
+ * @brief Number of backchannel slots in a session
  *
- * This is also the maximum number of backchannel slots we'll use,
- * even if the client offers more.
+ * This is the maximum number of backchannel slots we'll use, even if
+ * the client offers more.  It is also the smallest forechannel target
+ * we ever ask a client to shrink to.
  */
 #define NFS41_NB_SLOTS 3
 
+/**
+ * @brief Encoded bytes of all cached session replies
+ */
+extern uint64_t nfs41_session_cache_bytes;
+
 /**
  * @brief Members in the slot table
  */
@@ -134,6 +140,7 @@ typedef struct nfs41_session_slot__ {
 							   cached RPC result in
 							   a session's slot */
 	unsigned int cache_used;	/*< If we cached the result */
+	uint32_t cached_size;	/*< Encoded size of the cached result */
 } nfs41_session_slot_t;
 
 /**
@@ -170,7 +177,11 @@ struct nfs41_session {
 	SVCXPRT *xprt;		/*< Referenced pointer to transport */
 
 	channel_attrs4 fore_channel_attrs;	/*< Fore-channel attributes */
-	nfs41_session_slot_t slots[NFS41_NB_SLOTS];	/*< Slot table */
+	nfs41_session_slot_t *slots;	/*< Slot table, ca_maxrequests long */
+	slotid4 highest_slotid;	/*< Last sa_highest_slotid from the client */
+	slotid4 target_highest_slotid;	/*< Last target sent to the client */
+	uint32_t cached_replies;	/*< Slots holding a cached reply */
+	uint64_t cached_bytes;	/*< Encoded bytes of cached replies */
 
 	channel_attrs4 back_channel_attrs;	/*< Back-channel attributes */
 	nfs41_cb_session_slot_t cb_slots[NFS41_NB_SLOTS];	/*< Callback
@@ -216,6 +227,7 @@ typedef struct rdel_fh {
 typedef struct clid_entry {
 	struct glist_head cl_list;	/*< Link in the list */
 	struct glist_head cl_rfh_list;
+	bool cl_reclaim_complete;	/*< Client sent RECLAIM_COMPLETE */
 	char cl_name[PATH_MAX];	/*< Client name */
 } clid_entry_t;
 
@@ -294,6 +306,8 @@ struct cf_deleg_stats {
 	time_t cfd_rs_time;                   /* time when the client responsed
 						 NFS4_OK for a recall. */
 	time_t cfd_r_time;               /* time of the recall attempt */
+	struct timespec cfd_r_start;     /* precise start of the first recall,
+					    for recall latency */
 };
 
 /**
@@ -703,6 +717,9 @@ struct nfs_client_id_t {
 	uint32_t curr_deleg_grants; /* current num of delegations owned by
 				       this client */
 	uint32_t num_revokes;       /* Num revokes for the client */
+	uint32_t deleg_backoff;     /* Current delegation backoff in seconds,
+				       grown on each recall of this client */
+	time_t deleg_backoff_until; /* No new delegations before this time */
 	struct gsh_client *gsh_client; /* for client specific statistics. */
 };
 
@@ -872,6 +889,11 @@ struct file_deleg_stats {
 	uint32_t fds_num_opens;         /* total num of opens so far. */
 	time_t fds_first_open;          /* time that we started recording
 					   num_opens */
+	uint32_t fds_conflict_hist;     /* one bit per recent open or recall,
+					   1 for a conflicting event */
+	uint32_t fds_hist_len;          /* valid bits in fds_conflict_hist */
+	clientid4 fds_last_clientid;    /* client of the most recent open */
+	time_t fds_last_open;           /* time of the most recent open */
 };
 
 /**
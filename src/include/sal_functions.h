@@ -259,6 +259,7 @@ nfsstat4 clientid_error_to_nfsstat_no_expire(clientid_status_t err)
 const char *clientid_error_to_str(clientid_status_t err);
 
 int nfs_Init_client_id(void);
+void client_id_size_table(hash_parameter_t *hparam);
 
 clientid_status_t nfs_client_id_get_unconfirmed(clientid4 clientid,
 						nfs_client_id_t **pclient_rec);
@@ -374,6 +375,16 @@ int nfs41_Session_Get_Pointer(char sessionid[NFS4_SESSIONID_SIZE],
 int nfs41_Session_Del(char sessionid[NFS4_SESSIONID_SIZE]);
 void nfs41_Build_sessionid(clientid4 *clientid, char *sessionid);
 void nfs41_Session_PrintAll(void);
+void nfs41_Session_Init_Slots(nfs41_session_t *session);
+void nfs41_Session_Release_Slot(nfs41_session_t *session,
+				nfs41_session_slot_t *slot);
+void nfs41_Session_Release_Slots_Above(nfs41_session_t *session,
+				       slotid4 highest, slotid4 skip);
+slotid4 nfs41_Session_Target_Slotid(nfs41_session_t *session);
+bool nfs41_Session_Cache_Reply(nfs41_session_t *session, slotid4 slotid,
+			       struct COMPOUND4res_extended *res);
+void nfs41_foreach_session(bool (*cb)(nfs41_session_t *session, void *state),
+			   void *state);
 
 /******************************************************************************
  *
@@ -862,7 +873,11 @@ void init_new_deleg_state(union state_data *deleg_state,
 
 void deleg_heuristics_recall(struct fsal_obj_handle *obj,
 			     state_owner_t *owner,
-			     struct state_t *deleg);
+			     struct state_t *deleg,
+			     bool revoked);
+void deleg_recall_start(struct fsal_obj_handle *obj, struct state_t *deleg,
+			nfs_client_id_t *client);
+void deleg_record_open(struct state_hdl *ostate, nfs_client_id_t *client);
 void get_deleg_perm(nfsace4 *permissions, open_delegation_type4 type);
 void update_delegation_stats(struct state_hdl *ostate,
 			     state_owner_t *owner,
@@ -872,6 +887,22 @@ nfsstat4 deleg_revoke(struct fsal_obj_handle *obj, struct state_t *deleg_state);
 void state_deleg_revoke(struct fsal_obj_handle *obj, state_t *state);
 bool state_deleg_conflict(struct fsal_obj_handle *obj, bool write);
 
+/**
+ * @brief Server-wide delegation policy counters
+ */
+struct deleg_policy_stats {
+	uint64_t grants;	/*< Delegations granted */
+	uint64_t recalls;	/*< Recalls started */
+	uint64_t revokes;	/*< Delegations revoked */
+	uint64_t denials;	/*< OPENs the policy refused to delegate */
+	uint64_t recall_count;	/*< Recalls answered by DELEGRETURN */
+	uint64_t recall_latency; /*< Total recall to DELEGRETURN time (ns) */
+	uint64_t recall_max;	/*< Longest recall to DELEGRETURN time (ns) */
+};
+
+const char *deleg_policy_name(void);
+void deleg_policy_get_stats(struct deleg_policy_stats *stats);
+
 /******************************************************************************
  *
  * Layout functions
@@ -999,6 +1030,9 @@ int nfs_in_grace(void);
 void nfs4_add_clid(nfs_client_id_t *);
 void nfs4_rm_clid(const char *, char *, int);
 void nfs4_chk_clid(nfs_client_id_t *);
+void nfs4_reclaim_complete(nfs_client_id_t *);
+void nfs4_try_lift_grace(void);
+void nfs4_get_reclaim_progress(uint32_t *expected, uint32_t *completed);
 void nfs4_load_recov_clids(nfs_grace_start_t *gsp);
 void nfs4_clean_old_recov_dir(char *);
 void nfs4_create_recov_dir(void);
@@ -49,6 +49,7 @@ void server_stats_9p_done(u8 msgtype, struct _9p_request_data *req9p);
 
 void server_stats_io_done(size_t requested,
 			  size_t transferred, bool success, bool is_write);
+void server_stats_space_done(uint64_t length, bool allocate, bool success);
 void server_stats_compound_done(int num_ops, int status);
 void server_stats_nfsv4_op_done(int proto_op,
 				nsecs_elapsed_t start_time, int status);
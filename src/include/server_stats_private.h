@@ -251,6 +251,8 @@ void server_dbus_total_ops(struct export_stats *export_st,
 void global_dbus_total_ops(DBusMessageIter *iter);
 void server_dbus_fast_ops(DBusMessageIter *iter);
 void mdcache_dbus_show(DBusMessageIter *iter);
+void nfs4_compound_dbus_shapes(DBusMessageIter *iter);
+void server_dbus_space_stats(DBusMessageIter *iter);
 void server_reset_stats(DBusMessageIter *iter);
 void reset_export_stats(void);
 void reset_client_stats(void);
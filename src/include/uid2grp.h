@@ -50,6 +50,8 @@
  *
  * @{
  */
+struct uid2grp_glist;
+
 typedef struct group_data {
 	uid_t uid;
 	struct gsh_buffdesc uname;
@@ -58,12 +60,35 @@ typedef struct group_data {
 	int nbgroups;
 	unsigned int refcount;
 	pthread_mutex_t lock;
-	gid_t *groups;
+	gid_t *groups;		/*< Points into glist */
+	struct uid2grp_glist *glist;	/*< Group list, shared by users
+					    with the same groups */
+	uint32_t refreshing;	/*< A background refresh was queued */
 } group_data_t;
 
+/**
+ * @brief Managed gids cache statistics
+ */
+
+struct uid2grp_stats {
+	uint64_t hits;		/*< Lookups served from the cache */
+	uint64_t misses;	/*< Lookups that went to getgrouplist */
+	uint64_t miss_latency;	/*< Total time spent on misses (ns) */
+	uint64_t miss_max;	/*< Longest miss (ns) */
+	uint64_t refreshes;	/*< Background refreshes done */
+	uint64_t refresh_failures;	/*< Background refreshes that failed */
+	uint64_t refresh_latency;	/*< Total background refresh time (ns) */
+	uint64_t refresh_max;	/*< Longest background refresh (ns) */
+	uint64_t evictions;	/*< Users evicted to stay within memory */
+	uint64_t users;		/*< Users cached */
+	uint64_t lists;		/*< Distinct group lists */
+	uint64_t bytes;		/*< Memory used by the cache */
+};
+
 extern pthread_rwlock_t uid2grp_user_lock;
 
 void uid2grp_cache_init(void);
+int uid2grp_cache_shutdown(void);
 
 void uid2grp_add_user(struct group_data *);
 bool uid2grp_lookup_by_uname(const struct gsh_buffdesc *, uid_t *,
@@ -74,6 +99,17 @@ void uid2grp_remove_by_uname(const struct gsh_buffdesc *);
 void uid2grp_remove_by_uid(const uid_t);
 
 void uid2grp_clear_cache(void);
+uint64_t uid2grp_generation(void);
+
+struct uid2grp_glist *uid2grp_glist_get(const gid_t *, int);
+void uid2grp_glist_put(struct uid2grp_glist *);
+gid_t *uid2grp_glist_groups(struct uid2grp_glist *);
+
+void uid2grp_cache_hit(struct group_data *);
+void uid2grp_cache_miss(const struct timespec *);
+void uid2grp_get_stats(struct uid2grp_stats *);
+
+struct group_data *uid2grp_allocate_by_uid(uid_t);
 
 bool uid2grp(uid_t uid, struct group_data **);
 bool name2grp(const struct gsh_buffdesc *name, struct group_data **gdata);
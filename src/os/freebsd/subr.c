@@ -30,6 +30,8 @@
 
 #include <unistd.h>
 #include <string.h>
+#include <errno.h>
+#include <fcntl.h>
 #include <os/subr.h>
 #include <dirent.h>
 #include <sys/syscall.h>
@@ -151,3 +153,34 @@ int set_threadgroups(size_t size, const gid_t *list)
 {
 	return syscall(SYS_setgroups, size, list);
 }
+
+ssize_t vfs_copy_range(int fd_in, off_t off_in, int fd_out, off_t off_out,
+		       size_t len)
+{
+	errno = ENOSYS;
+	return -1;
+}
+
+int vfs_clone_range(int fd_in, off_t off_in, int fd_out, off_t off_out,
+		    size_t len)
+{
+	errno = EOPNOTSUPP;
+	return -1;
+}
+
+int vfs_alloc_range(int fd, off_t offset, off_t len, bool punch)
+{
+	int rc;
+
+	if (punch) {
+		errno = EOPNOTSUPP;
+		return -1;
+	}
+
+	rc = posix_fallocate(fd, offset, len);
+	if (rc != 0) {
+		errno = rc;
+		return -1;
+	}
+	return 0;
+}
@@ -29,9 +29,12 @@
 #include "fsal.h"
 #include <stddef.h>
 #include <string.h>
+#include <errno.h>
 #include <unistd.h>
 #include <sys/fsuid.h>
 #include <sys/syscall.h>
+#include <sys/ioctl.h>
+#include <fcntl.h>
 #include "os/subr.h"
 
 /**
@@ -130,3 +133,86 @@ int set_threadgroups(size_t size, const gid_t *list)
 {
 	return syscall(__NR_setgroups, size, list);
 }
+
+/**
+ * @brief Copy a range of one file to another in the kernel
+ *
+ * @param[in] fd_in   File to copy from
+ * @param[in] off_in  Offset to copy from
+ * @param[in] fd_out  File to copy to
+ * @param[in] off_out Offset to copy to
+ * @param[in] len     Number of bytes to copy
+ *
+ * @return Bytes copied, 0 at the end of fd_in, -1 on error (errno set,
+ *         ENOSYS if the kernel can't do it).
+ */
+ssize_t vfs_copy_range(int fd_in, off_t off_in, int fd_out, off_t off_out,
+		       size_t len)
+{
+#ifdef __NR_copy_file_range
+	loff_t in = off_in, out = off_out;
+
+	return syscall(__NR_copy_file_range, fd_in, &in, fd_out, &out, len,
+		       0);
+#else
+	errno = ENOSYS;
+	return -1;
+#endif
+}
+
+#ifndef FICLONERANGE
+struct file_clone_range {
+	int64_t src_fd;
+	uint64_t src_offset;
+	uint64_t src_length;
+	uint64_t dest_offset;
+};
+#define FICLONERANGE _IOW(0x94, 13, struct file_clone_range)
+#endif
+
+/**
+ * @brief Share a range of one file's blocks with another
+ *
+ * @param[in] fd_in   File to clone from
+ * @param[in] off_in  Offset to clone from
+ * @param[in] fd_out  File to clone to
+ * @param[in] off_out Offset to clone to
+ * @param[in] len     Number of bytes to clone, 0 for up to the end of fd_in
+ *
+ * @return 0 on success, -1 on error (errno set).
+ */
+int vfs_clone_range(int fd_in, off_t off_in, int fd_out, off_t off_out,
+		    size_t len)
+{
+	struct file_clone_range range = {
+		.src_fd = fd_in,
+		.src_offset = off_in,
+		.src_length = len,
+		.dest_offset = off_out
+	};
+
+	return ioctl(fd_out, FICLONERANGE, &range);
+}
+
+#ifndef FALLOC_FL_PUNCH_HOLE
+#define FALLOC_FL_KEEP_SIZE 0x01
+#define FALLOC_FL_PUNCH_HOLE 0x02
+#endif
+
+/**
+ * @brief Reserve a range of a file, or punch a hole in it
+ *
+ * @param[in] fd     File to operate on
+ * @param[in] offset Start of the range
+ * @param[in] len    Length of the range
+ * @param[in] punch  Deallocate the range rather than reserve it
+ *
+ * @return 0 on success, -1 on error (errno set, EOPNOTSUPP if the
+ *         filesystem can't).
+ */
+int vfs_alloc_range(int fd, off_t offset, off_t len, bool punch)
+{
+	int mode = punch ? FALLOC_FL_PUNCH_HOLE | FALLOC_FL_KEEP_SIZE : 0;
+
+	return fallocate(fd, mode, offset, len);
+}
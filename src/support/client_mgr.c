@@ -848,6 +848,105 @@ static struct gsh_dbus_method cltmgr_show_delegations = {
 		 END_ARG_LIST}
 };
 
+/**
+ * @brief State for walking the sessions of one client
+ */
+struct session_slots_state {
+	struct gsh_client *client;
+	DBusMessageIter session_iter;
+};
+
+static bool session_slots_to_dbus(nfs41_session_t *session, void *state)
+{
+	struct session_slots_state *iter_state = state;
+	DBusMessageIter struct_iter;
+	uint64_t clientid = session->clientid;
+	uint32_t nb_slots = session->fore_channel_attrs.ca_maxrequests;
+	uint32_t highest = atomic_fetch_uint32_t(&session->highest_slotid);
+	uint32_t target =
+		atomic_fetch_uint32_t(&session->target_highest_slotid);
+	uint32_t cached = atomic_fetch_uint32_t(&session->cached_replies);
+	uint64_t bytes = atomic_fetch_uint64_t(&session->cached_bytes);
+
+	if (session->clientid_record->gsh_client != iter_state->client)
+		return true;
+
+	dbus_message_iter_open_container(&iter_state->session_iter,
+					 DBUS_TYPE_STRUCT, NULL, &struct_iter);
+	dbus_message_iter_append_basic(&struct_iter, DBUS_TYPE_UINT64,
+				       &clientid);
+	dbus_message_iter_append_basic(&struct_iter, DBUS_TYPE_UINT32,
+				       &nb_slots);
+	dbus_message_iter_append_basic(&struct_iter, DBUS_TYPE_UINT32,
+				       &highest);
+	dbus_message_iter_append_basic(&struct_iter, DBUS_TYPE_UINT32,
+				       &target);
+	dbus_message_iter_append_basic(&struct_iter, DBUS_TYPE_UINT32,
+				       &cached);
+	dbus_message_iter_append_basic(&struct_iter, DBUS_TYPE_UINT64,
+				       &bytes);
+	dbus_message_iter_close_container(&iter_state->session_iter,
+					  &struct_iter);
+	return true;
+}
+
+/**
+ * DBUS method to report NFSv4.1 session slot utilization
+ *
+ * For each session of the client: clientid, slot table size, the
+ * client's highest slot in use, the target highest slot we sent,
+ * the number of cached replies and their encoded size.
+ */
+
+static bool get_session_slots(DBusMessageIter *args,
+			      DBusMessage *reply,
+			      DBusError *error)
+{
+	struct gsh_client *client = NULL;
+	struct session_slots_state iter_state;
+	struct timespec timestamp;
+	bool success = true;
+	char *errormsg = "OK";
+	DBusMessageIter iter;
+
+	dbus_message_iter_init_append(reply, &iter);
+	client = lookup_client(args, &errormsg);
+	if (client == NULL) {
+		success = false;
+		if (errormsg == NULL)
+			errormsg = "Client IP address not found";
+	}
+	dbus_status_reply(&iter, success, errormsg);
+	if (success) {
+		now(&timestamp);
+		dbus_append_timestamp(&iter, &timestamp);
+		iter_state.client = client;
+		dbus_message_iter_open_container(&iter, DBUS_TYPE_ARRAY,
+						 "(tuuuut)",
+						 &iter_state.session_iter);
+		nfs41_foreach_session(session_slots_to_dbus, &iter_state);
+		dbus_message_iter_close_container(&iter,
+						  &iter_state.session_iter);
+	}
+
+	if (client != NULL)
+		put_gsh_client(client);
+	return true;
+}
+
+static struct gsh_dbus_method cltmgr_show_session_slots = {
+	.name = "GetSessionSlots",
+	.method = get_session_slots,
+	.args = {IPADDR_ARG,
+		 STATUS_REPLY,
+		 TIMESTAMP_REPLY,
+		 {
+		  .name = "sessions",
+		  .type = "a(tuuuut)",
+		  .direction = "out"},
+		 END_ARG_LIST}
+};
+
 #ifdef _USE_9P
 /**
  * DBUS method to report 9p I/O statistics
@@ -1001,6 +1100,7 @@ static struct gsh_dbus_method *cltmgr_stats_methods[] = {
 	&cltmgr_show_v41_io,
 	&cltmgr_show_v41_layouts,
 	&cltmgr_show_delegations,
+	&cltmgr_show_session_slots,
 #ifdef _USE_9P
 	&cltmgr_show_9p_io,
 	&cltmgr_show_9p_trans,
@@ -45,6 +45,7 @@
 #include <sys/types.h>
 #include <sys/param.h>
 #include <pthread.h>
+#include <sched.h>
 #include <assert.h>
 #include <arpa/inet.h>
 #include "fsal.h"
@@ -64,22 +65,422 @@
 #include "nfs_exports.h"
 #include "nfs_proto_functions.h"
 #include "pnfs_utils.h"
+#include "sal_functions.h"
+#include "uid2grp.h"
 
 /**
- * @brief Exports are stored in an AVL tree with front-end cache.
+ * @brief Exports are stored in an AVL tree.
  *
- * @note  number of cache slots should be prime.
+ * Lookups by id, path and pseudo path do not use the tree, they go
+ * through export_snapshot without taking the lock.
  */
-#define EXPORT_BY_ID_CACHE_SIZE 769
-
 struct export_by_id {
 	pthread_rwlock_t lock;
 	struct avltree t;
-	struct avltree_node *cache[EXPORT_BY_ID_CACHE_SIZE];
 };
 
 static struct export_by_id export_by_id;
 
+/**
+ * @brief Exports in a lookup snapshot are indexed by id in pages
+ */
+#define EXPORT_ID_PAGE_SIZE 256
+
+/**
+ * @brief One path component in an export path trie
+ */
+struct export_trie_node {
+	uint32_t parent;		/*< Index of the parent node */
+	uint32_t hash;			/*< Hash of parent and component */
+	const char *name;		/*< Component, not NUL terminated */
+	uint32_t len;			/*< Length of name */
+	struct gsh_export *export;	/*< Export at this path, if any */
+};
+
+/**
+ * @brief Path trie, children found by hashing (parent, component)
+ */
+struct export_trie {
+	struct export_trie_node *nodes;	/*< nodes[0] is "/" */
+	uint32_t nnodes;		/*< Nodes in use */
+	uint32_t capacity;		/*< Nodes allocated */
+	uint32_t mask;			/*< Number of slots less one */
+	uint32_t *slots;		/*< Node indexes, 0 is empty */
+};
+
+/**
+ * @brief Index of the active exports
+ *
+ * Written under export_by_id.lock only.  An inserted export is added in
+ * place, readers see its node or by_id entry once the store that links
+ * it in lands.  A removal, or an insert that does not fit the nodes
+ * allocated, rebuilds the index from exportlist with room to spare and
+ * publishes it with a single pointer store.  The trie node names point
+ * into the exports' own path strings.
+ */
+struct export_snapshot {
+	struct gsh_export **by_id[(UINT16_MAX + 1) / EXPORT_ID_PAGE_SIZE];
+	struct export_trie by_path;	/*< By fullpath */
+	struct export_trie by_pseudo;	/*< By pseudopath */
+};
+
+/**
+ * @brief Reader counts, spread over cache lines
+ *
+ * A reader counts itself in its slot under the current phase for as
+ * long as it uses the snapshot.  A writer that replaced the snapshot
+ * flips the phase twice, waiting each time for the count of the old
+ * phase to drain, after which no reader can still see the old one.
+ */
+#define EXPORT_READER_SLOTS 32
+
+struct export_reader_slot {
+	uint32_t count[2];
+} __attribute__ ((__aligned__(GSH_CACHE_LINE_SIZE)));
+
+static struct export_snapshot *export_snapshot;
+static struct export_reader_slot export_readers[EXPORT_READER_SLOTS];
+static uint32_t export_reader_phase;
+static uint32_t export_reader_next;
+static __thread uint32_t export_reader_slot; /* slot + 1, 0 unassigned */
+
+/** Serializes writers waiting for readers */
+static pthread_mutex_t export_sync_mutex = PTHREAD_MUTEX_INITIALIZER;
+
+struct export_read {
+	uint32_t slot;
+	uint32_t phase;
+};
+
+static inline struct export_snapshot *export_read_begin(struct export_read *rd)
+{
+	if (export_reader_slot == 0)
+		export_reader_slot =
+		    atomic_inc_uint32_t(&export_reader_next) %
+		    EXPORT_READER_SLOTS + 1;
+
+	rd->slot = export_reader_slot - 1;
+	rd->phase = atomic_fetch_uint32_t(&export_reader_phase) & 1;
+	(void) atomic_inc_uint32_t(&export_readers[rd->slot].count[rd->phase]);
+
+	return atomic_fetch_voidptr((void **)&export_snapshot);
+}
+
+static inline void export_read_end(struct export_read *rd)
+{
+	(void) atomic_dec_uint32_t(&export_readers[rd->slot].count[rd->phase]);
+}
+
+/**
+ * @brief Wait until no reader can see a snapshot replaced before the call
+ */
+static void export_synchronize(void)
+{
+	uint32_t phase, busy, i;
+	int pass;
+
+	PTHREAD_MUTEX_lock(&export_sync_mutex);
+
+	for (pass = 0; pass < 2; pass++) {
+		phase = (atomic_inc_uint32_t(&export_reader_phase) - 1) & 1;
+
+		do {
+			busy = 0;
+			for (i = 0; i < EXPORT_READER_SLOTS; i++)
+				busy += atomic_fetch_uint32_t(
+					&export_readers[i].count[phase]);
+			if (busy != 0)
+				sched_yield();
+		} while (busy != 0);
+	}
+
+	PTHREAD_MUTEX_unlock(&export_sync_mutex);
+}
+
+/**
+ * @brief Return the next component of a path
+ *
+ * @param[in,out] pos  Where to start, moved past the component
+ * @param[out]    name Start of the component
+ *
+ * @return Length of the component, 0 at the end of the path.
+ */
+static inline uint32_t export_path_next(const char **pos, const char **name)
+{
+	const char *p = *pos;
+
+	while (*p == '/')
+		p++;
+	*name = p;
+	while (*p != '/' && *p != '\0')
+		p++;
+	*pos = p;
+
+	return p - *name;
+}
+
+static inline uint32_t export_path_hash(uint32_t parent, const char *name,
+					uint32_t len)
+{
+	/* FNV-1a over the parent index and the component */
+	uint32_t hash = 2166136261U ^ parent;
+	uint32_t i;
+
+	for (i = 0; i < len; i++) {
+		hash ^= (unsigned char)name[i];
+		hash *= 16777619;
+	}
+	return hash;
+}
+
+static uint32_t export_trie_child(const struct export_trie *trie,
+				  uint32_t parent, const char *name,
+				  uint32_t len, uint32_t hash)
+{
+	const struct export_trie_node *node;
+	uint32_t i, idx;
+
+	for (i = hash & trie->mask;
+	     (idx = atomic_fetch_uint32_t(&trie->slots[i])) != 0;
+	     i = (i + 1) & trie->mask) {
+		node = &trie->nodes[idx];
+		if (node->hash == hash && node->parent == parent &&
+		    node->len == len && memcmp(node->name, name, len) == 0)
+			return idx;
+	}
+	return 0;
+}
+
+static void export_trie_init(struct export_trie *trie, uint32_t nnodes)
+{
+	uint32_t nslots = 16;
+
+	while (nslots < 2 * nnodes)
+		nslots <<= 1;
+
+	trie->nodes = gsh_calloc(nnodes, sizeof(struct export_trie_node));
+	trie->nnodes = 1;
+	trie->capacity = nnodes;
+	trie->mask = nslots - 1;
+	trie->slots = gsh_calloc(nslots, sizeof(uint32_t));
+}
+
+static void export_trie_add(struct export_trie *trie, const char *path,
+			    struct gsh_export *export)
+{
+	struct export_trie_node *child;
+	const char *name;
+	uint32_t node = 0, idx, len, hash, i;
+
+	if (path == NULL)
+		return;
+
+	while ((len = export_path_next(&path, &name)) != 0) {
+		hash = export_path_hash(node, name, len);
+		idx = export_trie_child(trie, node, name, len, hash);
+		if (idx == 0) {
+			idx = trie->nnodes++;
+			child = &trie->nodes[idx];
+			child->parent = node;
+			child->hash = hash;
+			child->name = name;
+			child->len = len;
+			for (i = hash & trie->mask; trie->slots[i] != 0;
+			     i = (i + 1) & trie->mask)
+				;
+			/* The node is complete before readers can find it */
+			atomic_store_uint32_t(&trie->slots[i], idx);
+		}
+		node = idx;
+	}
+
+	/* Like the list walk this replaces, the first export wins */
+	if (trie->nodes[node].export == NULL)
+		atomic_store_voidptr((void **)&trie->nodes[node].export,
+				     export);
+}
+
+/**
+ * @brief Find the export with the longest path prefix of a path
+ *
+ * A trailing '/' is ignored and an empty path matches the root export.
+ *
+ * @param[in] trie        Trie to search
+ * @param[in] path        Path to look up
+ * @param[in] exact_match The export path must be the whole path
+ *
+ * @return The export, not referenced, or NULL.
+ */
+static struct gsh_export *export_trie_lookup(const struct export_trie *trie,
+					     const char *path,
+					     bool exact_match)
+{
+	struct gsh_export *found, *export;
+	const char *name;
+	uint32_t node = 0, len;
+
+	if (path[0] == '\0')
+		return atomic_fetch_voidptr((void **)&trie->nodes[0].export);
+
+	/* The root export only covers absolute paths */
+	found = path[0] == '/'
+		? atomic_fetch_voidptr((void **)&trie->nodes[0].export)
+		: NULL;
+	while ((len = export_path_next(&path, &name)) != 0) {
+		node = export_trie_child(trie, node, name, len,
+					 export_path_hash(node, name, len));
+		if (node == 0)
+			return exact_match ? NULL : found;
+		export = atomic_fetch_voidptr(
+				(void **)&trie->nodes[node].export);
+		if (export != NULL)
+			found = export;
+	}
+
+	return exact_match
+		? atomic_fetch_voidptr((void **)&trie->nodes[node].export)
+		: found;
+}
+
+static uint32_t export_path_nodes(const char *path)
+{
+	const char *name;
+	uint32_t n = 0;
+
+	if (path == NULL)
+		return 0;
+
+	while (export_path_next(&path, &name) != 0)
+		n++;
+
+	return n;
+}
+
+static void export_snapshot_free(struct export_snapshot *snap)
+{
+	int i;
+
+	if (snap == NULL)
+		return;
+
+	for (i = 0; i < (UINT16_MAX + 1) / EXPORT_ID_PAGE_SIZE; i++)
+		gsh_free(snap->by_id[i]);
+	gsh_free(snap->by_path.nodes);
+	gsh_free(snap->by_path.slots);
+	gsh_free(snap->by_pseudo.nodes);
+	gsh_free(snap->by_pseudo.slots);
+	gsh_free(snap);
+}
+
+/**
+ * @brief Add an export to a snapshot
+ *
+ * The tries must have room for the export's paths.
+ *
+ * @param[in] snap   The snapshot
+ * @param[in] export The export
+ */
+static void export_snapshot_add(struct export_snapshot *snap,
+				struct gsh_export *export)
+{
+	uint32_t page = export->export_id / EXPORT_ID_PAGE_SIZE;
+	uint32_t slot = export->export_id % EXPORT_ID_PAGE_SIZE;
+
+	if (snap->by_id[page] == NULL)
+		atomic_store_voidptr((void **)&snap->by_id[page],
+				     gsh_calloc(EXPORT_ID_PAGE_SIZE,
+						sizeof(struct gsh_export *)));
+	if (snap->by_id[page][slot] == NULL)
+		atomic_store_voidptr((void **)&snap->by_id[page][slot],
+				     export);
+	export_trie_add(&snap->by_path, export->fullpath, export);
+	export_trie_add(&snap->by_pseudo, export->pseudopath, export);
+}
+
+/**
+ * @brief Build and publish a snapshot of exportlist
+ *
+ * The tries get twice the nodes exportlist needs, so inserts can be
+ * added in place until the number of exports has about doubled.
+ *
+ * The caller must hold export_by_id.lock for write, and must pass the
+ * returned snapshot to export_snapshot_retire() once it has dropped
+ * the lock.
+ *
+ * @return The snapshot replaced.
+ */
+static struct export_snapshot *export_snapshot_publish(void)
+{
+	struct export_snapshot *snap, *old;
+	struct gsh_export *export;
+	struct glist_head *glist;
+	uint32_t path_nodes = 1, pseudo_nodes = 1;
+
+	glist_for_each(glist, &exportlist) {
+		export = glist_entry(glist, struct gsh_export, exp_list);
+		path_nodes += export_path_nodes(export->fullpath);
+		pseudo_nodes += export_path_nodes(export->pseudopath);
+	}
+
+	snap = gsh_calloc(1, sizeof(struct export_snapshot));
+	export_trie_init(&snap->by_path, 2 * path_nodes);
+	export_trie_init(&snap->by_pseudo, 2 * pseudo_nodes);
+
+	glist_for_each(glist, &exportlist) {
+		export = glist_entry(glist, struct gsh_export, exp_list);
+		export_snapshot_add(snap, export);
+	}
+
+	old = atomic_fetch_voidptr((void **)&export_snapshot);
+	atomic_store_voidptr((void **)&export_snapshot, snap);
+
+	return old;
+}
+
+/**
+ * @brief Add a newly inserted export to the published snapshot
+ *
+ * Rebuilds the snapshot only if the export's paths might not fit, so
+ * loading N exports costs O(N) rather than a rebuild per export.
+ *
+ * The caller must hold export_by_id.lock for write, and must pass the
+ * returned snapshot to export_snapshot_retire() once it has dropped
+ * the lock.
+ *
+ * @param[in] export The export, already on exportlist
+ *
+ * @return The snapshot replaced, NULL if it was added to in place.
+ */
+static struct export_snapshot *export_snapshot_insert(struct gsh_export *export)
+{
+	struct export_snapshot *snap = export_snapshot;
+
+	if (snap == NULL ||
+	    snap->by_path.nnodes + export_path_nodes(export->fullpath) >
+						snap->by_path.capacity ||
+	    snap->by_pseudo.nnodes + export_path_nodes(export->pseudopath) >
+						snap->by_pseudo.capacity)
+		return export_snapshot_publish();
+
+	export_snapshot_add(snap, export);
+
+	return NULL;
+}
+
+/**
+ * @brief Free a replaced snapshot once no reader can be using it
+ *
+ * Exports that were only reachable from it may be released after this.
+ */
+static void export_snapshot_retire(struct export_snapshot *old)
+{
+	if (old == NULL)
+		return;
+
+	export_synchronize();
+	export_snapshot_free(old);
+}
+
 /** List of all active exports,
   * protected by export_by_id.lock
   */
@@ -148,21 +549,6 @@ struct gsh_export *export_take_unexport_work(void)
 	return export;
 }
 
-/**
- * @brief Compute cache slot for an entry
- *
- * This function computes a hash slot, taking an address modulo the
- * number of cache slotes (which should be prime).
- *
- * @param k [in] Entry index value
- *
- * @return The computed offset.
- */
-static inline uint16_t eid_cache_offsetof(uint16_t k)
-{
-	return k % EXPORT_BY_ID_CACHE_SIZE;
-}
-
 /**
  * @brief Revert export_commit()
  *
@@ -170,20 +556,17 @@ static inline uint16_t eid_cache_offsetof(uint16_t k)
  */
 void export_revert(struct gsh_export *export)
 {
-	struct avltree_node *cnode;
-	void **cache_slot = (void **)
-	     &(export_by_id.cache[eid_cache_offsetof(export->export_id)]);
+	struct export_snapshot *old;
 
 	PTHREAD_RWLOCK_wrlock(&export_by_id.lock);
 
-	cnode = (struct avltree_node *)atomic_fetch_voidptr(cache_slot);
-	if (&export->node_k == cnode)
-		atomic_store_voidptr(cache_slot, NULL);
 	avltree_remove(&export->node_k, &export_by_id.t);
 	glist_del(&export->exp_list);
 	glist_del(&export->exp_work);
+	old = export_snapshot_publish();
 
 	PTHREAD_RWLOCK_unlock(&export_by_id.lock);
+	export_snapshot_retire(old);
 	put_gsh_export(export); /* Release sentinel ref */
 }
 
@@ -272,8 +655,7 @@ void free_export(struct gsh_export *export)
 bool insert_gsh_export(struct gsh_export *export)
 {
 	struct avltree_node *node;
-	void **cache_slot = (void **)
-	    &(export_by_id.cache[eid_cache_offsetof(export->export_id)]);
+	struct export_snapshot *old;
 
 	PTHREAD_RWLOCK_wrlock(&export_by_id.lock);
 	node = avltree_insert(&export->node_k, &export_by_id.t);
@@ -286,12 +668,12 @@ bool insert_gsh_export(struct gsh_export *export)
 	/* we will hold a ref starting out... */
 	get_gsh_export_ref(export);
 
-	/* update cache */
-	atomic_store_voidptr(cache_slot, &export->node_k);
 	glist_add_tail(&exportlist, &export->exp_list);
 	get_gsh_export_ref(export);		/* == 2 */
+	old = export_snapshot_insert(export);
 
 	PTHREAD_RWLOCK_unlock(&export_by_id.lock);
+	export_snapshot_retire(old);
 	return true;
 }
 
@@ -308,51 +690,69 @@ bool insert_gsh_export(struct gsh_export *export)
  */
 struct gsh_export *get_gsh_export(uint16_t export_id)
 {
-	struct gsh_export v;
-	struct avltree_node *node;
-	struct gsh_export *exp;
-	void **cache_slot = (void **)
-	    &(export_by_id.cache[eid_cache_offsetof(export_id)]);
+	struct export_read rd;
+	struct export_snapshot *snap;
+	struct gsh_export **page;
+	struct gsh_export *exp = NULL;
+
+	snap = export_read_begin(&rd);
+
+	if (snap != NULL) {
+		page = atomic_fetch_voidptr((void **)&snap->by_id[
+					export_id / EXPORT_ID_PAGE_SIZE]);
+		if (page != NULL)
+			exp = atomic_fetch_voidptr((void **)&page[
+					export_id % EXPORT_ID_PAGE_SIZE]);
+	}
 
-	v.export_id = export_id;
-	PTHREAD_RWLOCK_rdlock(&export_by_id.lock);
+	if (exp != NULL)
+		get_gsh_export_ref(exp);
 
-	/* check cache */
-	node = (struct avltree_node *)atomic_fetch_voidptr(cache_slot);
-	if (node) {
-		exp = avltree_container_of(node, struct gsh_export, node_k);
-		if (exp->export_id == export_id) {
-			/* got it in 1 */
-			LogDebug(COMPONENT_HASHTABLE_CACHE,
-				 "export_mgr cache hit slot %d",
-				 eid_cache_offsetof(export_id));
-			goto out;
-		}
-	}
+	export_read_end(&rd);
+	return exp;
+}
 
-	/* fall back to AVL */
-	node = avltree_lookup(&v.node_k, &export_by_id.t);
-	if (node) {
-		exp = avltree_container_of(node, struct gsh_export, node_k);
-		/* update cache */
-		atomic_store_voidptr(cache_slot, node);
-	} else {
-		PTHREAD_RWLOCK_unlock(&export_by_id.lock);
-		return NULL;
-	}
+/**
+ * @brief Look up an export in the current snapshot by path
+ *
+ * @param[in] pseudo      Look up by pseudo path rather than fullpath
+ * @param[in] path        Path for the entry to be found
+ * @param[in] exact_match The path must match exactly
+ *
+ * @return pointer to ref counted export
+ */
+static struct gsh_export *export_lookup_path(bool pseudo, const char *path,
+					     bool exact_match)
+{
+	struct export_read rd;
+	struct export_snapshot *snap;
+	struct gsh_export *exp = NULL;
 
- out:
-	get_gsh_export_ref(exp);
-	PTHREAD_RWLOCK_unlock(&export_by_id.lock);
+	LogFullDebug(COMPONENT_EXPORT,
+		     "Searching for export matching %s%s",
+		     pseudo ? "pseudo path " : "path ", path);
+
+	snap = export_read_begin(&rd);
+
+	if (snap != NULL)
+		exp = export_trie_lookup(pseudo ? &snap->by_pseudo
+						: &snap->by_path,
+					 path, exact_match);
+
+	if (exp != NULL)
+		get_gsh_export_ref(exp);
+
+	export_read_end(&rd);
 	return exp;
 }
 
 /**
  * @brief Lookup the export manager struct by export path
  *
- * Gets an export entry from its path using a substring match and
- * linear search of the export list, assumes being called with
- * export manager lock held (such as from within foreach_gsh_export.
+ * Gets an export entry from its path, the export with the longest
+ * path that is a prefix of path, from the export snapshot.  Kept for
+ * callers holding the export manager lock (such as from within
+ * foreach_gsh_export), the lookup itself takes no lock.
  * If path has a trailing '/', ignore it.
  *
  * @param path        [IN] the path for the entry to be found.
@@ -364,75 +764,15 @@ struct gsh_export *get_gsh_export(uint16_t export_id)
 struct gsh_export *get_gsh_export_by_path_locked(char *path,
 						 bool exact_match)
 {
-	struct gsh_export *export;
-	struct glist_head *glist;
-	int len_path = strlen(path);
-	int len_export;
-	struct gsh_export *ret_exp = NULL;
-	int len_ret = 0;
-
-	if (len_path > 1 && path[len_path - 1] == '/')
-		len_path--;
-
-	LogFullDebug(COMPONENT_EXPORT,
-		     "Searching for export matching path %s",
-		     path);
-
-	glist_for_each(glist, &exportlist) {
-		export = glist_entry(glist, struct gsh_export, exp_list);
-
-		len_export = strlen(export->fullpath);
-
-		if (len_path == 0 && len_export == 1) {
-			/* Special case for root match */
-			ret_exp = export;
-			len_ret = len_export;
-			break;
-		}
-
-		/* A path shorter than the full path cannot match.
-		 * Also skip if this export has a shorter path than
-		 * the previous match.
-		 */
-		if (len_path < len_export ||
-		    len_export < len_ret)
-			continue;
-
-		/* If partial match is not allowed, lengths must be the same */
-		if (exact_match && len_path != len_export)
-			continue;
-
-		/* if the char in fullpath just after the end of path is not '/'
-		 * it is a name token longer, i.e. /mnt/foo != /mnt/foob/
-		 */
-		if (len_export > 1 &&
-		    path[len_export] != '/' &&
-		    path[len_export] != '\0')
-			continue;
-
-		/* we agree on size, now compare the leading substring
-		 */
-		if (strncmp(export->fullpath, path, len_export) == 0) {
-			ret_exp = export;
-			len_ret = len_export;
-
-			/* If we have found an exact match, exit loop. */
-			if (len_export == len_path)
-				break;
-		}
-	}
-
-	if (ret_exp != NULL)
-		get_gsh_export_ref(ret_exp);
-
-	return ret_exp;
+	return export_lookup_path(false, path, exact_match);
 }
 
 /**
  * @brief Lookup the export manager struct by export path
  *
- * Gets an export entry from its path using a substring match and
- * linear search of the export list.
+ * Gets an export entry from its path, the export with the longest
+ * path that is a prefix of path, from the export snapshot without
+ * taking the export manager lock.
  * If path has a trailing '/', ignore it.
  *
  * @param path        [IN] the path for the entry to be found.
@@ -443,23 +783,15 @@ struct gsh_export *get_gsh_export_by_path_locked(char *path,
 
 struct gsh_export *get_gsh_export_by_path(char *path, bool exact_match)
 {
-	struct gsh_export *exp;
-
-	PTHREAD_RWLOCK_rdlock(&export_by_id.lock);
-
-	exp = get_gsh_export_by_path_locked(path, exact_match);
-
-	PTHREAD_RWLOCK_unlock(&export_by_id.lock);
-
-	return exp;
+	return export_lookup_path(false, path, exact_match);
 }
 
 /**
  * @brief Lookup the export manager struct by export pseudo path
  *
- * Gets an export entry from its pseudo (if it exists), assumes
- * being called with export manager lock held (such as from within
- * foreach_gsh_export.
+ * Gets an export entry from its pseudo (if it exists).  Kept for
+ * callers holding the export manager lock (such as from within
+ * foreach_gsh_export), the lookup itself takes no lock.
  *
  * @param path        [IN] the path for the entry to be found.
  * @param exact_match [IN] the path must match exactly
@@ -470,78 +802,7 @@ struct gsh_export *get_gsh_export_by_path(char *path, bool exact_match)
 struct gsh_export *get_gsh_export_by_pseudo_locked(char *path,
 						   bool exact_match)
 {
-	struct gsh_export *export;
-	struct glist_head *glist;
-	int len_path = strlen(path);
-	int len_export;
-	struct gsh_export *ret_exp = NULL;
-	int len_ret = 0;
-
-	/* Ignore trailing slash in path */
-	if (len_path > 1 && path[len_path - 1] == '/')
-		len_path--;
-
-	LogFullDebug(COMPONENT_EXPORT,
-		     "Searching for export matching pseudo path %s",
-		     path);
-
-	glist_for_each(glist, &exportlist) {
-		export = glist_entry(glist, struct gsh_export, exp_list);
-
-		if (export->pseudopath == NULL)
-			continue;
-
-		len_export = strlen(export->pseudopath);
-
-		LogFullDebug(COMPONENT_EXPORT,
-			     "Comparing %s %d to %s %d",
-			     path, len_path,
-			     export->pseudopath, len_export);
-
-		if (len_path == 0 && len_export == 1) {
-			/* Special case for Pseudo root match */
-			ret_exp = export;
-			len_ret = len_export;
-			break;
-		}
-
-		/* A path shorter than the full path cannot match.
-		 * Also skip if this export has a shorter path than
-		 * the previous match.
-		 */
-		if (len_path < len_export ||
-		    len_export < len_ret)
-			continue;
-
-		/* If partial match is not allowed, lengths must be the same */
-		if (exact_match && len_path != len_export)
-			continue;
-
-		/* if the char in pseudopath just after the end of path is not
-		 * '/' it is a name token longer, i.e. /mnt/foo != /mnt/foob/
-		 */
-		if (len_export > 1 &&
-		    path[len_export] != '/' &&
-		    path[len_export] != '\0')
-			continue;
-
-		/* we agree on size, now compare the leading substring
-		 */
-		if (strncmp(export->pseudopath, path, len_export)
-		    == 0) {
-			ret_exp = export;
-			len_ret = len_export;
-
-			/* If we have found an exact match, exit loop. */
-			if (len_export == len_path)
-				break;
-		}
-	}
-
-	if (ret_exp != NULL)
-		get_gsh_export_ref(ret_exp);
-
-	return ret_exp;
+	return export_lookup_path(true, path, exact_match);
 }
 
 /**
@@ -557,15 +818,7 @@ struct gsh_export *get_gsh_export_by_pseudo_locked(char *path,
 
 struct gsh_export *get_gsh_export_by_pseudo(char *path, bool exact_match)
 {
-	struct gsh_export *exp;
-
-	PTHREAD_RWLOCK_rdlock(&export_by_id.lock);
-
-	exp = get_gsh_export_by_pseudo_locked(path, exact_match);
-
-	PTHREAD_RWLOCK_unlock(&export_by_id.lock);
-
-	return exp;
+	return export_lookup_path(true, path, exact_match);
 }
 
 /**
@@ -651,20 +904,14 @@ void remove_gsh_export(uint16_t export_id)
 	struct gsh_export v;
 	struct avltree_node *node;
 	struct gsh_export *export = NULL;
-	void **cache_slot = (void **)
-	    &(export_by_id.cache[eid_cache_offsetof(export_id)]);
+	struct export_snapshot *old = NULL;
 
 	v.export_id = export_id;
 	PTHREAD_RWLOCK_wrlock(&export_by_id.lock);
 
 	node = avltree_lookup(&v.node_k, &export_by_id.t);
 	if (node) {
-		struct avltree_node *cnode = (struct avltree_node *)
-			atomic_fetch_voidptr(cache_slot);
-
-		/* Remove from the AVL cache and tree */
-		if (node == cnode)
-			atomic_store_voidptr(cache_slot, NULL);
+		/* Remove from the AVL tree */
 		avltree_remove(node, &export_by_id.t);
 
 		export = avltree_container_of(node, struct gsh_export, node_k);
@@ -674,12 +921,16 @@ void remove_gsh_export(uint16_t export_id)
 
 		/* No new references will be granted. Idempotent. */
 		export->export_status = EXPORT_STALE;
+		old = export_snapshot_publish();
 	}
 
 	PTHREAD_RWLOCK_unlock(&export_by_id.lock);
 
 	/* removal has a once-only semantic */
 	if (export != NULL) {
+		/* Readers of the old snapshot may still take references */
+		export_snapshot_retire(old);
+
 		if (export->has_pnfs_ds) {
 			/* once-only, so no need for lock here */
 			export->has_pnfs_ds = false;
@@ -1709,6 +1960,250 @@ static bool get_nfsv_global_fast_ops(DBusMessageIter *args,
 	return true;
 }
 
+/**
+ * @brief Report delegation policy statistics
+ *
+ * @return
+ *	status
+ *	error message
+ *	time
+ *	struct of (
+ *		policy name
+ *		seconds since server start
+ *		grants, recalls, revokes, policy denials
+ *		grant, recall and revoke rates per second
+ *		recalls answered, average and max recall latency (ns)
+ *	)
+ */
+static bool get_deleg_policy_stats(DBusMessageIter *args,
+				   DBusMessage *reply,
+				   DBusError *error)
+{
+	bool success = true;
+	char *errormsg = "OK";
+	DBusMessageIter iter, struct_iter;
+	struct timespec timestamp;
+	struct deleg_policy_stats st;
+	const char *name = deleg_policy_name();
+	uint64_t uptime, avg;
+	double rate;
+
+	dbus_message_iter_init_append(reply, &iter);
+	dbus_status_reply(&iter, success, errormsg);
+	now(&timestamp);
+	dbus_append_timestamp(&iter, &timestamp);
+
+	deleg_policy_get_stats(&st);
+	uptime = timestamp.tv_sec - ServerBootTime.tv_sec;
+	avg = st.recall_count ? st.recall_latency / st.recall_count : 0;
+
+	dbus_message_iter_open_container(&iter, DBUS_TYPE_STRUCT, NULL,
+					 &struct_iter);
+	dbus_message_iter_append_basic(&struct_iter, DBUS_TYPE_STRING, &name);
+	dbus_message_iter_append_basic(&struct_iter, DBUS_TYPE_UINT64,
+				       &uptime);
+	dbus_message_iter_append_basic(&struct_iter, DBUS_TYPE_UINT64,
+				       &st.grants);
+	dbus_message_iter_append_basic(&struct_iter, DBUS_TYPE_UINT64,
+				       &st.recalls);
+	dbus_message_iter_append_basic(&struct_iter, DBUS_TYPE_UINT64,
+				       &st.revokes);
+	dbus_message_iter_append_basic(&struct_iter, DBUS_TYPE_UINT64,
+				       &st.denials);
+	rate = uptime ? (double) st.grants / uptime : 0;
+	dbus_message_iter_append_basic(&struct_iter, DBUS_TYPE_DOUBLE, &rate);
+	rate = uptime ? (double) st.recalls / uptime : 0;
+	dbus_message_iter_append_basic(&struct_iter, DBUS_TYPE_DOUBLE, &rate);
+	rate = uptime ? (double) st.revokes / uptime : 0;
+	dbus_message_iter_append_basic(&struct_iter, DBUS_TYPE_DOUBLE, &rate);
+	dbus_message_iter_append_basic(&struct_iter, DBUS_TYPE_UINT64,
+				       &st.recall_count);
+	dbus_message_iter_append_basic(&struct_iter, DBUS_TYPE_UINT64, &avg);
+	dbus_message_iter_append_basic(&struct_iter, DBUS_TYPE_UINT64,
+				       &st.recall_max);
+	dbus_message_iter_close_container(&iter, &struct_iter);
+
+	return true;
+}
+
+/**
+ * @brief Report managed gids cache statistics
+ *
+ * @return
+ *	status
+ *	error message
+ *	time
+ *	struct of (
+ *		hits, misses, average and max miss latency (ns)
+ *		refreshes, failed refreshes, average and max refresh
+ *		latency (ns)
+ *		evictions, users cached, distinct group lists, bytes used
+ *	)
+ */
+static bool get_uid2grp_stats(DBusMessageIter *args,
+			      DBusMessage *reply,
+			      DBusError *error)
+{
+	bool success = true;
+	char *errormsg = "OK";
+	DBusMessageIter iter, struct_iter;
+	struct timespec timestamp;
+	struct uid2grp_stats st;
+	uint64_t avg;
+
+	dbus_message_iter_init_append(reply, &iter);
+	dbus_status_reply(&iter, success, errormsg);
+	now(&timestamp);
+	dbus_append_timestamp(&iter, &timestamp);
+
+	uid2grp_get_stats(&st);
+
+	dbus_message_iter_open_container(&iter, DBUS_TYPE_STRUCT, NULL,
+					 &struct_iter);
+	dbus_message_iter_append_basic(&struct_iter, DBUS_TYPE_UINT64,
+				       &st.hits);
+	dbus_message_iter_append_basic(&struct_iter, DBUS_TYPE_UINT64,
+				       &st.misses);
+	avg = st.misses ? st.miss_latency / st.misses : 0;
+	dbus_message_iter_append_basic(&struct_iter, DBUS_TYPE_UINT64, &avg);
+	dbus_message_iter_append_basic(&struct_iter, DBUS_TYPE_UINT64,
+				       &st.miss_max);
+	dbus_message_iter_append_basic(&struct_iter, DBUS_TYPE_UINT64,
+				       &st.refreshes);
+	dbus_message_iter_append_basic(&struct_iter, DBUS_TYPE_UINT64,
+				       &st.refresh_failures);
+	avg = st.refreshes ? st.refresh_latency / st.refreshes : 0;
+	dbus_message_iter_append_basic(&struct_iter, DBUS_TYPE_UINT64, &avg);
+	dbus_message_iter_append_basic(&struct_iter, DBUS_TYPE_UINT64,
+				       &st.refresh_max);
+	dbus_message_iter_append_basic(&struct_iter, DBUS_TYPE_UINT64,
+				       &st.evictions);
+	dbus_message_iter_append_basic(&struct_iter, DBUS_TYPE_UINT64,
+				       &st.users);
+	dbus_message_iter_append_basic(&struct_iter, DBUS_TYPE_UINT64,
+				       &st.lists);
+	dbus_message_iter_append_basic(&struct_iter, DBUS_TYPE_UINT64,
+				       &st.bytes);
+	dbus_message_iter_close_container(&iter, &struct_iter);
+
+	return true;
+}
+
+/**
+ * @brief Report export reload statistics
+ *
+ * @return
+ *	status
+ *	error message
+ *	time
+ *	struct of (
+ *		reloads, last, average and max reload latency (ns)
+ *		EXPORT blocks added, updated, unchanged, removed and
+ *		failed by the last reload
+ *	)
+ */
+static bool get_export_reload_stats(DBusMessageIter *args,
+				    DBusMessage *reply,
+				    DBusError *error)
+{
+	bool success = true;
+	char *errormsg = "OK";
+	DBusMessageIter iter, struct_iter;
+	struct timespec timestamp;
+	struct export_reload_stats st;
+	uint64_t avg;
+
+	dbus_message_iter_init_append(reply, &iter);
+	dbus_status_reply(&iter, success, errormsg);
+	now(&timestamp);
+	dbus_append_timestamp(&iter, &timestamp);
+
+	export_reload_get_stats(&st);
+
+	dbus_message_iter_open_container(&iter, DBUS_TYPE_STRUCT, NULL,
+					 &struct_iter);
+	dbus_message_iter_append_basic(&struct_iter, DBUS_TYPE_UINT64,
+				       &st.reloads);
+	dbus_message_iter_append_basic(&struct_iter, DBUS_TYPE_UINT64,
+				       &st.last_latency);
+	avg = st.reloads ? st.total_latency / st.reloads : 0;
+	dbus_message_iter_append_basic(&struct_iter, DBUS_TYPE_UINT64, &avg);
+	dbus_message_iter_append_basic(&struct_iter, DBUS_TYPE_UINT64,
+				       &st.max_latency);
+	dbus_message_iter_append_basic(&struct_iter, DBUS_TYPE_UINT64,
+				       &st.added);
+	dbus_message_iter_append_basic(&struct_iter, DBUS_TYPE_UINT64,
+				       &st.updated);
+	dbus_message_iter_append_basic(&struct_iter, DBUS_TYPE_UINT64,
+				       &st.unchanged);
+	dbus_message_iter_append_basic(&struct_iter, DBUS_TYPE_UINT64,
+				       &st.removed);
+	dbus_message_iter_append_basic(&struct_iter, DBUS_TYPE_UINT64,
+				       &st.failed);
+	dbus_message_iter_close_container(&iter, &struct_iter);
+
+	return true;
+}
+
+/**
+ * @brief Report COMPOUND shapes
+ *
+ * @return
+ *	status
+ *	error message
+ *	time
+ *	array of (
+ *		shape, the op names joined by commas
+ *		COMPOUNDs of that shape
+ *	)
+ */
+static bool get_compound_shapes(DBusMessageIter *args,
+				DBusMessage *reply,
+				DBusError *error)
+{
+	bool success = true;
+	char *errormsg = "OK";
+	DBusMessageIter iter;
+	struct timespec timestamp;
+
+	dbus_message_iter_init_append(reply, &iter);
+	dbus_status_reply(&iter, success, errormsg);
+	now(&timestamp);
+	dbus_append_timestamp(&iter, &timestamp);
+
+	nfs4_compound_dbus_shapes(&iter);
+
+	return true;
+}
+
+/**
+ * @brief Report ALLOCATE and DEALLOCATE counts
+ *
+ * @return
+ *	status
+ *	error message
+ *	time
+ *	ALLOCATEs, bytes allocated, DEALLOCATEs, bytes punched, errors
+ */
+static bool get_space_stats(DBusMessageIter *args,
+			    DBusMessage *reply,
+			    DBusError *error)
+{
+	bool success = true;
+	char *errormsg = "OK";
+	DBusMessageIter iter;
+	struct timespec timestamp;
+
+	dbus_message_iter_init_append(reply, &iter);
+	dbus_status_reply(&iter, success, errormsg);
+	now(&timestamp);
+	dbus_append_timestamp(&iter, &timestamp);
+
+	server_dbus_space_stats(&iter);
+
+	return true;
+}
+
 static bool show_cache_inode_stats(DBusMessageIter *args,
 				   DBusMessage *reply,
 				   DBusError *error)
@@ -1886,6 +2381,45 @@ static struct gsh_dbus_method global_show_fast_ops = {
 		 END_ARG_LIST}
 };
 
+static struct gsh_dbus_method global_show_deleg_policy = {
+	.name = "GetDelegationPolicy",
+	.method = get_deleg_policy_stats,
+	.args = {STATUS_REPLY,
+		 TIMESTAMP_REPLY,
+		 {
+		  .name = "deleg_policy",
+		  .type = "(stttttdddttt)",
+		  .direction = "out"
+		 },
+		 END_ARG_LIST}
+};
+
+static struct gsh_dbus_method global_show_uid2grp = {
+	.name = "GetManageGidsCache",
+	.method = get_uid2grp_stats,
+	.args = {STATUS_REPLY,
+		 TIMESTAMP_REPLY,
+		 {
+		  .name = "manage_gids_cache",
+		  .type = "(tttttttttttt)",
+		  .direction = "out"
+		 },
+		 END_ARG_LIST}
+};
+
+static struct gsh_dbus_method global_show_export_reload = {
+	.name = "GetExportReloadStats",
+	.method = get_export_reload_stats,
+	.args = {STATUS_REPLY,
+		 TIMESTAMP_REPLY,
+		 {
+		  .name = "export_reload",
+		  .type = "(ttttttttt)",
+		  .direction = "out"
+		 },
+		 END_ARG_LIST}
+};
+
 static struct gsh_dbus_method cache_inode_show = {
 	.name = "ShowCacheInode",
 	.method = show_cache_inode_stats,
@@ -1949,6 +2483,32 @@ static struct gsh_dbus_method export_show_all_io = {
 		 END_ARG_LIST}
 };
 
+static struct gsh_dbus_method global_show_compound_shapes = {
+	.name = "GetCompoundShapes",
+	.method = get_compound_shapes,
+	.args = {STATUS_REPLY,
+		 TIMESTAMP_REPLY,
+		 {
+		  .name = "shapes",
+		  .type = "a(st)",
+		  .direction = "out"
+		 },
+		 END_ARG_LIST}
+};
+
+static struct gsh_dbus_method global_show_space = {
+	.name = "GetSpaceStats",
+	.method = get_space_stats,
+	.args = {STATUS_REPLY,
+		 TIMESTAMP_REPLY,
+		 {
+		  .name = "space",
+		  .type = "(ttttt)",
+		  .direction = "out"
+		 },
+		 END_ARG_LIST}
+};
+
 static struct gsh_dbus_method *export_stats_methods[] = {
 	&export_show_v3_io,
 	&export_show_v40_io,
@@ -1961,6 +2521,11 @@ static struct gsh_dbus_method *export_stats_methods[] = {
 #endif
 	&global_show_total_ops,
 	&global_show_fast_ops,
+	&global_show_deleg_policy,
+	&global_show_uid2grp,
+	&global_show_export_reload,
+	&global_show_compound_shapes,
+	&global_show_space,
 	&cache_inode_show,
 	&export_show_all_io,
 	&reset_statistics,
@@ -2003,7 +2568,6 @@ void export_pkginit(void)
 #endif
 	PTHREAD_RWLOCK_init(&export_by_id.lock, &rwlock_attr);
 	avltree_init(&export_by_id.t, export_id_cmpf, 0);
-	memset(&export_by_id.cache, 0, sizeof(export_by_id.cache));
 
 	glist_init(&exportlist);
 	glist_init(&mount_work);
@@ -38,6 +38,7 @@
 #include "nfs_dupreq.h"
 #include "config_parsing.h"
 #include "common_utils.h"
+#include "city.h"
 #include <stdlib.h>
 #include <fnmatch.h>
 #include <sys/socket.h>
@@ -46,7 +47,9 @@
 #include <string.h>
 #include <strings.h>
 #include <ctype.h>
+#include <errno.h>
 #include "export_mgr.h"
+#include "client_mgr.h"
 #include "fsal_up.h"
 #include "sal_functions.h"
 #include "pnfs_utils.h"
@@ -86,7 +89,16 @@ struct global_export_perms export_opt_cfg = {
 	GLOBAL_EXPORT_PERMS_INITIALIZER
 };
 
+/* Generations of client indexes and of the committed export_opt, both
+ * taken from client_index_generation.
+ */
+static uint64_t client_index_generation;
+static uint64_t export_opt_generation;
+
 static void FreeClientList(struct glist_head *clients);
+static struct client_match_index *client_index_build(
+						struct glist_head *clients);
+static void client_index_free(struct client_match_index *idx);
 
 static int StrExportOptions(struct display_buffer *dspbuf,
 			    struct export_perms *p_perms)
@@ -455,6 +467,7 @@ static int add_client(struct glist_head *client_list,
 		}
 		cli->client.netgroup.netgroupname = gsh_strdup(client_tok + 1);
 		cli->type = NETGROUP_CLIENT;
+		ng_expand_register(cli->client.netgroup.netgroupname);
 		break;
 	case TERM_V4CIDR:  /* this needs to be migrated to libcidr! (no v6) */
 		cidr = cidr_from_str(client_tok);
@@ -1004,6 +1017,7 @@ static int export_commit_common(void *node, void *link_mem, void *self_struct,
 				enum export_commit_type commit_type)
 {
 	struct gsh_export *export = self_struct, *probe_exp;
+	struct client_match_index *client_index;
 	int errcnt = 0;
 	char perms[1024] = "\0";
 	struct display_buffer dspbuf = {sizeof(perms), perms, perms};
@@ -1070,6 +1084,9 @@ static int export_commit_common(void *node, void *link_mem, void *self_struct,
 	if (errcnt)
 		return errcnt;  /* have basic errors. don't even try more... */
 
+	/* Compile the client list, an update swaps it in with the list */
+	export->client_index = client_index_build(&export->clients);
+
 	/* Note: need to check export->fsal_export AFTER we have checked for
 	 * duplicate export_id. That is because an update export WILL NOT
 	 * have fsal_export attached.
@@ -1170,9 +1187,17 @@ static int export_commit_common(void *node, void *link_mem, void *self_struct,
 			     export->clients.next, export->clients.prev);
 
 		glist_swap_lists(&probe_exp->clients, &export->clients);
+		client_index = probe_exp->client_index;
+		probe_exp->client_index = export->client_index;
+		export->client_index = client_index;
 
 		PTHREAD_RWLOCK_unlock(&probe_exp->lock);
 
+		/* Whatever made this update, a reload must not assume the
+		 * export still matches its EXPORT block.
+		 */
+		atomic_store_uint64_t(&probe_exp->config_digest, 0);
+
 		/* We will need to dispose of the config export since we
 		 * updated the existing export.
 		 */
@@ -1436,6 +1461,8 @@ static int export_defaults_commit(void *node, void *link_mem,
 	/* Update under lock. */
 	PTHREAD_RWLOCK_wrlock(&export_opt_lock);
 	export_opt = export_opt_cfg;
+	atomic_store_uint64_t(&export_opt_generation,
+			      atomic_inc_uint64_t(&client_index_generation));
 	PTHREAD_RWLOCK_unlock(&export_opt_lock);
 
 	return 0;
@@ -1978,6 +2005,96 @@ err_out:
 	return -1;
 }
 
+/**
+ * @brief Statistics for reread_exports(), protected by export_reload_mutex
+ */
+static struct export_reload_stats export_reload_stats;
+static pthread_mutex_t export_reload_mutex = PTHREAD_MUTEX_INITIALIZER;
+
+/**
+ * @brief Fingerprint the EXPORT_DEFAULTS blocks
+ *
+ * Every export depends on them, so they seed the digest of each
+ * EXPORT block.
+ */
+static uint64_t export_defaults_digest(config_file_t in_config,
+				       struct config_error_type *err_type)
+{
+	struct config_node_list *config_list = NULL, *lp, *lp_next;
+	uint64_t digest = 0;
+
+	if (find_config_nodes(in_config, "EXPORT_DEFAULTS", &config_list,
+			      err_type) != 0)
+		return 0;
+
+	for (lp = config_list; lp != NULL; lp = lp_next) {
+		lp_next = lp->next;
+		digest = config_block_digest(lp->tree_node, digest);
+		gsh_free(lp);
+	}
+	return digest;
+}
+
+/**
+ * @brief Get the Export_Id of an EXPORT block without loading it
+ *
+ * @param[in]  node      The EXPORT block
+ * @param[out] export_id The id
+ *
+ * @return true if the block has a valid Export_Id.
+ */
+static bool export_block_id(void *node, uint16_t *export_id)
+{
+	const char *value = config_block_value(node, "Export_id");
+	unsigned long long id;
+	char *end;
+
+	if (value == NULL)
+		return false;
+
+	errno = 0;
+	id = strtoull(value, &end, 0);
+	if (errno != 0 || end == value || *end != '\0' || id > UINT16_MAX)
+		return false;
+
+	*export_id = id;
+	return true;
+}
+
+/**
+ * @brief Record the digests of the EXPORT blocks of a loaded config
+ */
+static void export_record_digests(config_file_t in_config,
+				  struct config_error_type *err_type)
+{
+	struct config_node_list *config_list = NULL, *lp, *lp_next;
+	uint64_t defaults = export_defaults_digest(in_config, err_type);
+	struct gsh_export *export;
+	uint16_t export_id;
+
+	if (find_config_nodes(in_config, "EXPORT", &config_list,
+			      err_type) != 0)
+		return;
+
+	for (lp = config_list; lp != NULL; lp = lp_next) {
+		lp_next = lp->next;
+		export = NULL;
+		if (export_block_id(lp->tree_node, &export_id))
+			export = get_gsh_export(export_id);
+		if (export != NULL) {
+			/* With duplicate ids, the first block was loaded */
+			if (atomic_fetch_uint64_t(&export->config_digest) == 0)
+				atomic_store_uint64_t(
+					&export->config_digest,
+					config_block_digest(lp->tree_node,
+							    defaults));
+			atomic_store_uint8_t(&export->from_config, true);
+			put_gsh_export(export);
+		}
+		gsh_free(lp);
+	}
+}
+
 /**
  * @brief Read the export entries from the parsed configuration file.
  *
@@ -2018,12 +2135,55 @@ int ReadExports(config_file_t in_config,
 		return -1;
 	}
 
+	export_record_digests(in_config, err_type);
+
 	return num_exp;
 }
 
+/**
+ * @brief Exports a reload found missing from the config
+ */
+struct export_prune_state {
+	const uint8_t *seen;		/*< Bitmap of the configured ids */
+	struct gsh_export **exports;	/*< Exports to remove, referenced */
+	uint32_t count;
+	uint32_t size;
+};
+
+static bool export_prune_collect(struct gsh_export *export, void *state)
+{
+	struct export_prune_state *prune = state;
+	uint16_t id = export->export_id;
+
+	/* Only exports that came from the config file are removed, not
+	 * the default pseudo root nor those added over DBus.  One that
+	 * was updated over DBus since still came from the config file.
+	 */
+	if (id == 0 || !atomic_fetch_uint8_t(&export->from_config) ||
+	    (prune->seen[id / 8] & (1 << (id % 8))) != 0)
+		return true;
+
+	if (prune->count == prune->size) {
+		prune->size = prune->size ? prune->size * 2 : 16;
+		prune->exports = gsh_realloc(prune->exports,
+					     prune->size *
+					     sizeof(struct gsh_export *));
+	}
+	get_gsh_export_ref(export);
+	prune->exports[prune->count++] = export;
+	return true;
+}
+
 /**
  * @brief Reread the export entries from the parsed configuration file.
  *
+ * Only the differences are applied.  An EXPORT block whose digest,
+ * EXPORT_DEFAULTS included, matches the one its export was loaded
+ * from is skipped without touching the export.  Every other block is
+ * loaded on its own, so a bad block only fails itself, and exports
+ * that came from the config file but are no longer in it are
+ * unexported.  Clients of unchanged exports never wait on a reload.
+ *
  * @param[in]  in_config    The file that contains the export list
  *
  * @return A negative value on error,
@@ -2033,10 +2193,23 @@ int ReadExports(config_file_t in_config,
 int reread_exports(config_file_t in_config,
 		   struct config_error_type *err_type)
 {
-	int rc, num_exp;
+	struct config_node_list *config_list = NULL, *lp, *lp_next;
+	struct export_prune_state prune = {NULL, NULL, 0, 0};
+	struct export_reload_stats st;
+	struct gsh_export *export;
+	struct timespec start, done;
+	uint64_t defaults, digest, latency;
+	uint8_t *seen;
+	uint16_t export_id;
+	uint32_t i;
+	bool known;
+	int rc, num_exp = 0;
 
 	LogInfo(COMPONENT_CONFIG, "Reread exports");
 
+	memset(&st, 0, sizeof(st));
+	now(&start);
+
 	rc = load_config_from_parse(in_config,
 				    &export_defaults_param,
 				    NULL,
@@ -2048,18 +2221,110 @@ int reread_exports(config_file_t in_config,
 		return -1;
 	}
 
-	num_exp = load_config_from_parse(in_config,
-					 &update_export_param,
-					 NULL,
-					 false,
-					 err_type);
+	defaults = export_defaults_digest(in_config, err_type);
 
-	if (num_exp < 0) {
+	rc = find_config_nodes(in_config, "EXPORT", &config_list, err_type);
+	if (rc != 0 && rc != ENOENT) {
 		LogCrit(COMPONENT_CONFIG, "Export block error");
 		return -1;
 	}
 
-	return num_exp;
+	seen = gsh_calloc(1, (UINT16_MAX + 1) / 8);
+
+	for (lp = config_list; lp != NULL; lp = lp_next) {
+		lp_next = lp->next;
+		digest = config_block_digest(lp->tree_node, defaults);
+		known = export_block_id(lp->tree_node, &export_id);
+		export = NULL;
+
+		if (known) {
+			seen[export_id / 8] |= 1 << (export_id % 8);
+			export = get_gsh_export(export_id);
+		}
+
+		if (export != NULL &&
+		    atomic_fetch_uint64_t(&export->config_digest) == digest) {
+			st.unchanged++;
+			num_exp++;
+		} else if (load_config_from_node(lp->tree_node,
+						 &update_export_param,
+						 NULL,
+						 false,
+						 err_type) < 0) {
+			st.failed++;
+		} else {
+			if (export != NULL)
+				st.updated++;
+			else
+				st.added++;
+			num_exp++;
+
+			/* The commit cleared the digest of an updated
+			 * export, look it up again for a new one.
+			 */
+			if (export == NULL && known)
+				export = get_gsh_export(export_id);
+			if (export != NULL) {
+				atomic_store_uint64_t(&export->config_digest,
+						      digest);
+				atomic_store_uint8_t(&export->from_config,
+						     true);
+			}
+		}
+
+		if (export != NULL)
+			put_gsh_export(export);
+		gsh_free(lp);
+	}
+
+	/* Exports can't be removed within foreach_gsh_export */
+	prune.seen = seen;
+	(void) foreach_gsh_export(export_prune_collect, &prune);
+	for (i = 0; i < prune.count; i++) {
+		export = prune.exports[i];
+		LogInfo(COMPONENT_CONFIG,
+			"Export %d is no longer in the config, removing it",
+			export->export_id);
+		unexport(export);
+		put_gsh_export(export);
+	}
+	st.removed = prune.count;
+	gsh_free(prune.exports);
+	gsh_free(seen);
+
+	now(&done);
+	latency = timespec_diff(&start, &done);
+
+	LogEvent(COMPONENT_CONFIG,
+		 "Reread exports in %"PRIu64" us: %"PRIu64" added, %"PRIu64
+		 " updated, %"PRIu64" unchanged, %"PRIu64" removed, %"PRIu64
+		 " failed",
+		 latency / NS_PER_USEC, st.added, st.updated, st.unchanged,
+		 st.removed, st.failed);
+
+	PTHREAD_MUTEX_lock(&export_reload_mutex);
+	st.reloads = export_reload_stats.reloads + 1;
+	st.last_latency = latency;
+	st.max_latency = export_reload_stats.max_latency;
+	if (latency > st.max_latency)
+		st.max_latency = latency;
+	st.total_latency = export_reload_stats.total_latency + latency;
+	export_reload_stats = st;
+	PTHREAD_MUTEX_unlock(&export_reload_mutex);
+
+	return st.failed != 0 ? -1 : num_exp;
+}
+
+/**
+ * @brief Get a copy of the export reload statistics
+ *
+ * @param[out] stats Where to copy them
+ */
+void export_reload_get_stats(struct export_reload_stats *stats)
+{
+	PTHREAD_MUTEX_lock(&export_reload_mutex);
+	*stats = export_reload_stats;
+	PTHREAD_MUTEX_unlock(&export_reload_mutex);
 }
 
 static void FreeClientList(struct glist_head *clients)
@@ -2074,8 +2339,11 @@ static void FreeClientList(struct glist_head *clients)
 		    glist_entry(glist, exportlist_client_entry_t, cle_list);
 		glist_del(&client->cle_list);
 		if (client->type == NETGROUP_CLIENT &&
-		    client->client.netgroup.netgroupname != NULL)
+		    client->client.netgroup.netgroupname != NULL) {
+			ng_expand_unregister(
+				client->client.netgroup.netgroupname);
 			gsh_free(client->client.netgroup.netgroupname);
+		}
 		if (client->type == WILDCARDHOST_CLIENT &&
 		    client->client.wildcard.wildcard != NULL)
 			gsh_free(client->client.wildcard.wildcard);
@@ -2097,6 +2365,8 @@ static void FreeClientList(struct glist_head *clients)
 void free_export_resources(struct gsh_export *export)
 {
 	FreeClientList(&export->clients);
+	client_index_free(export->client_index);
+	export->client_index = NULL;
 	if (export->fsal_export != NULL) {
 		struct fsal_module *fsal = export->fsal_export->fsal;
 
@@ -2391,6 +2661,133 @@ void unexport(struct gsh_export *export)
 		release_root_op_context();
 }
 
+/**
+ * @brief Name lookups shared by the entries checked for one host
+ */
+struct client_match_state {
+	int ipvalid;	/* -1 need to print, 0 - invalid, 1 - ok */
+	int namevalid;	/* -1 need to look up, 0 - invalid, 1 - ok */
+	bool named;	/* the result depended on the IP/name cache */
+	char hostname[MAXHOSTNAMELEN + 1];
+	char ipstring[SOCK_NAME_MAX + 1];
+};
+
+static inline void client_match_state_init(struct client_match_state *state)
+{
+	state->ipvalid = -1;
+	state->namevalid = -1;
+	state->named = false;
+}
+
+/**
+ * @brief Get the hostname of a client, looking it up only once
+ *
+ * @param[in]     hostaddr Host to look up
+ * @param[in,out] state    Lookups done so far for this host
+ *
+ * @return true if state->hostname is valid.
+ */
+static bool client_match_hostname(sockaddr_t *hostaddr,
+				  struct client_match_state *state)
+{
+	int rc;
+
+	state->named = true;
+
+	if (state->namevalid >= 0)
+		return state->namevalid;
+
+	/* Try to get the entry from th IP/name cache */
+	rc = nfs_ip_name_get(hostaddr, state->hostname,
+			     sizeof(state->hostname));
+
+	if (rc == IP_NAME_NOT_FOUND) {
+		/* IPaddr was not cached, add it to the cache */
+
+		/** @todo this change from 1.5 is not IPv6
+		 * useful.  come back to this and use the
+		 * string from client mgr inside req_ctx...
+		 */
+		rc = nfs_ip_name_add(hostaddr, state->hostname,
+				     sizeof(state->hostname));
+	}
+
+	state->namevalid = rc == IP_NAME_SUCCESS;
+
+	return state->namevalid;
+}
+
+/**
+ * @brief Check one client list entry against an IPv4 host
+ *
+ * @param[in]     client   Entry to check
+ * @param[in]     hostaddr Host to check for
+ * @param[in,out] state    Lookups done so far for this host
+ *
+ * @return true if the entry matches the host.
+ */
+static bool client_match_entry(exportlist_client_entry_t *client,
+			       sockaddr_t *hostaddr,
+			       struct client_match_state *state)
+{
+	in_addr_t addr = get_in_addr(hostaddr);
+
+	switch (client->type) {
+	case HOSTIF_CLIENT:
+		return client->client.hostif.clientaddr == addr;
+
+	case NETWORK_CLIENT:
+		return (client->client.network.netmask & ntohl(addr)) ==
+			client->client.network.netaddr;
+
+	case NETGROUP_CLIENT:
+		if (!client_match_hostname(hostaddr, state))
+			return false; /* Fatal failure */
+
+		/* At this point 'hostname' should contain the
+		 * name that was found
+		 */
+		return ng_innetgr(client->client.netgroup.netgroupname,
+				  state->hostname);
+
+	case WILDCARDHOST_CLIENT:
+		/* Now checking for IP wildcards */
+		if (state->ipvalid < 0)
+			state->ipvalid = sprint_sockip(hostaddr,
+						       state->ipstring,
+						       sizeof(state->ipstring));
+
+		if (state->ipvalid &&
+		    (fnmatch(client->client.wildcard.wildcard,
+			     state->ipstring,
+			     FNM_PATHNAME) == 0))
+			return true;
+
+		if (!client_match_hostname(hostaddr, state))
+			return false;
+
+		/* At this point 'hostname' should contain the
+		 * name that was found
+		 */
+		return fnmatch(client->client.wildcard.wildcard,
+			       state->hostname, FNM_PATHNAME) == 0;
+
+	case GSSPRINCIPAL_CLIENT:
+	  /** @todo BUGAZOMEU a completer lors de l'integration de RPCSEC_GSS */
+		LogCrit(COMPONENT_EXPORT,
+			"Unsupported type GSS_PRINCIPAL_CLIENT");
+		return false;
+
+	case MATCH_ANY_CLIENT:
+		return true;
+
+	case HOSTIF_CLIENT_V6:
+	case BAD_CLIENT:
+	default:
+		return false;
+	}
+}
+
 /**
  * @brief Match a specific option in the client export list
  *
@@ -2405,11 +2802,9 @@ static exportlist_client_entry_t *client_match(sockaddr_t *hostaddr,
 					       struct gsh_export *export)
 {
 	struct glist_head *glist;
-	in_addr_t addr = get_in_addr(hostaddr);
-	int rc;
-	int ipvalid = -1;	/* -1 need to print, 0 - invalid, 1 - ok */
-	char hostname[MAXHOSTNAMELEN + 1];
-	char ipstring[SOCK_NAME_MAX + 1];
+	struct client_match_state state;
+
+	client_match_state_init(&state);
 
 	glist_for_each(glist, &export->clients) {
 		exportlist_client_entry_t *client;
@@ -2423,101 +2818,8 @@ static exportlist_client_entry_t *client_match(sockaddr_t *hostaddr,
 				   "Match V4: ",
 				   client);
 
-		switch (client->type) {
-		case HOSTIF_CLIENT:
-			if (client->client.hostif.clientaddr == addr)
-				return client;
-			break;
-
-		case NETWORK_CLIENT:
-			if ((client->client.network.netmask & ntohl(addr)) ==
-			    client->client.network.netaddr)
-				return client;
-			break;
-
-		case NETGROUP_CLIENT:
-			/* Try to get the entry from th IP/name cache */
-			rc = nfs_ip_name_get(hostaddr, hostname,
-					     sizeof(hostname));
-
-			if (rc == IP_NAME_NOT_FOUND) {
-				/* IPaddr was not cached, add it to the cache */
-				rc = nfs_ip_name_add(hostaddr,
-						     hostname,
-						     sizeof(hostname));
-			}
-
-			if (rc != IP_NAME_SUCCESS)
-				break; /* Fatal failure */
-
-			/* At this point 'hostname' should contain the
-			 * name that was found
-			 */
-			if (ng_innetgr(client->client.netgroup.netgroupname,
-				    hostname)) {
-				return client;
-			}
-			break;
-
-		case WILDCARDHOST_CLIENT:
-			/* Now checking for IP wildcards */
-			if (ipvalid < 0)
-				ipvalid = sprint_sockip(hostaddr,
-							ipstring,
-							sizeof(ipstring));
-
-			if (ipvalid &&
-			    (fnmatch(client->client.wildcard.wildcard,
-				     ipstring,
-				     FNM_PATHNAME) == 0)) {
-				return client;
-			}
-
-			/* Try to get the entry from th IP/name cache */
-			rc = nfs_ip_name_get(hostaddr, hostname,
-					     sizeof(hostname));
-
-			if (rc == IP_NAME_NOT_FOUND) {
-				/* IPaddr was not cached, add it to the cache */
-
-				/** @todo this change from 1.5 is not IPv6
-				 * useful.  come back to this and use the
-				 * string from client mgr inside req_ctx...
-				 */
-				rc = nfs_ip_name_add(hostaddr,
-						     hostname,
-						     sizeof(hostname));
-			}
-
-			if (rc != IP_NAME_SUCCESS)
-					break;
-
-			/* At this point 'hostname' should contain the
-			 * name that was found
-			 */
-			if (fnmatch
-			    (client->client.wildcard.wildcard, hostname,
-			     FNM_PATHNAME) == 0) {
-				return client;
-			}
-			break;
-
-		case GSSPRINCIPAL_CLIENT:
-	  /** @todo BUGAZOMEU a completer lors de l'integration de RPCSEC_GSS */
-			LogCrit(COMPONENT_EXPORT,
-				"Unsupported type GSS_PRINCIPAL_CLIENT");
-			break;
-
-		case HOSTIF_CLIENT_V6:
-			break;
-
-		case MATCH_ANY_CLIENT:
+		if (client_match_entry(client, hostaddr, &state))
 			return client;
-
-		case BAD_CLIENT:
-		default:
-			continue;
-		}
 	}
 
 	/* no export found for this option */
@@ -2595,6 +2897,487 @@ static exportlist_client_entry_t *client_match_any(sockaddr_t *hostaddr,
 	}
 }
 
+/**
+ * @brief Compiled client list of an export
+ *
+ * Built from export->clients when an export is committed and swapped
+ * along with the list on update, so it is protected by export->lock in
+ * the same way.  Every entry remembers its position in the list and a
+ * lookup takes the lowest position over all the entries that match,
+ * which keeps the first-match semantics of walking the list.
+ *
+ * Exact hosts are kept in open addressed hash tables and IPv4 networks
+ * in a binary trie on their prefix bits.  Entries that can only be
+ * checked by name are kept in list order and only tried while they
+ * precede the best address match found.  Each index gets a unique
+ * generation, which keys the decisions cached in struct gsh_client.
+ */
+
+#define CLIENT_INDEX_NOPOS UINT32_MAX
+
+/** Seconds to remember a decision that depended on a name lookup */
+#define CLIENT_DECISION_NAME_TTL 60
+
+struct client_index_ref {
+	exportlist_client_entry_t *client;
+	uint32_t pos;
+};
+
+struct client_index_node {
+	struct client_index_node *child[2];
+	struct client_index_ref ref;
+};
+
+struct client_match_index {
+	uint64_t generation;
+	uint32_t hash_mask;	/*< Both host tables have hash_mask + 1 slots */
+	struct client_index_ref *hosts;
+	struct client_index_ref *hosts6;
+	struct client_index_node *networks;
+	struct client_index_ref *ordered;
+	uint32_t ordered_count;
+	struct client_index_ref any;
+};
+
+/**
+ * @brief Find the slot of a host address in a host table
+ *
+ * The IPv4 and IPv6 host addresses share the start of the hostif union
+ * so the entry's address can be compared the same way for both.
+ *
+ * @return The slot holding addr, or the free slot where it belongs.
+ */
+static uint32_t client_index_slot(struct client_match_index *idx,
+				  struct client_index_ref *table,
+				  const void *addr, size_t len)
+{
+	uint32_t slot = CityHash64((const char *)addr, len) & idx->hash_mask;
+
+	while (table[slot].client != NULL &&
+	       memcmp(&table[slot].client->client.hostif, addr, len) != 0)
+		slot = (slot + 1) & idx->hash_mask;
+
+	return slot;
+}
+
+static void client_index_add_host(struct client_match_index *idx,
+				  struct client_index_ref *table,
+				  exportlist_client_entry_t *client,
+				  size_t len, uint32_t pos)
+{
+	uint32_t slot = client_index_slot(idx, table,
+					  &client->client.hostif, len);
+
+	/* A duplicate host keeps the earlier entry */
+	if (table[slot].client == NULL) {
+		table[slot].client = client;
+		table[slot].pos = pos;
+	}
+}
+
+static struct client_index_node *client_index_node_alloc(void)
+{
+	struct client_index_node *node = gsh_calloc(1, sizeof(*node));
+
+	node->ref.pos = CLIENT_INDEX_NOPOS;
+	return node;
+}
+
+/**
+ * @brief Add a network with a contiguous netmask to the trie
+ */
+static void client_index_add_network(struct client_match_index *idx,
+				     exportlist_client_entry_t *client,
+				     uint32_t pos)
+{
+	uint32_t netaddr = client->client.network.netaddr;
+	uint32_t netmask = client->client.network.netmask;
+	struct client_index_node **node = &idx->networks;
+	uint32_t bit;
+
+	for (bit = 0x80000000; ; bit >>= 1) {
+		if (*node == NULL)
+			*node = client_index_node_alloc();
+		if (bit == 0 || (netmask & bit) == 0)
+			break;
+		node = &(*node)->child[(netaddr & bit) != 0];
+	}
+
+	if ((*node)->ref.client == NULL) {
+		(*node)->ref.client = client;
+		(*node)->ref.pos = pos;
+	}
+}
+
+/**
+ * @brief Compile a client list
+ *
+ * @param[in] clients The client list
+ *
+ * @return The new index.
+ */
+static struct client_match_index *client_index_build(
+						struct glist_head *clients)
+{
+	struct client_match_index *idx;
+	struct glist_head *glist;
+	exportlist_client_entry_t *client;
+	uint32_t total = 0, hosts = 0, pos = 0, size = 16;
+	uint32_t hostmask;
+
+	glist_for_each(glist, clients) {
+		client = glist_entry(glist, exportlist_client_entry_t,
+				     cle_list);
+		total++;
+		if (client->type == HOSTIF_CLIENT ||
+		    client->type == HOSTIF_CLIENT_V6)
+			hosts++;
+	}
+
+	idx = gsh_calloc(1, sizeof(*idx));
+	idx->generation = atomic_inc_uint64_t(&client_index_generation);
+	idx->any.pos = CLIENT_INDEX_NOPOS;
+
+	/* Keep the host tables at most half full */
+	while (size < 2 * hosts)
+		size <<= 1;
+	idx->hash_mask = size - 1;
+
+	if (hosts != 0) {
+		idx->hosts = gsh_calloc(size, sizeof(*idx->hosts));
+		idx->hosts6 = gsh_calloc(size, sizeof(*idx->hosts6));
+	}
+
+	if (total > hosts)
+		idx->ordered = gsh_calloc(total - hosts,
+					  sizeof(*idx->ordered));
+
+	glist_for_each(glist, clients) {
+		client = glist_entry(glist, exportlist_client_entry_t,
+				     cle_list);
+
+		switch (client->type) {
+		case HOSTIF_CLIENT:
+			client_index_add_host(idx, idx->hosts, client,
+					      sizeof(struct in_addr), pos);
+			break;
+
+		case HOSTIF_CLIENT_V6:
+			client_index_add_host(idx, idx->hosts6, client,
+					      sizeof(struct in6_addr), pos);
+			break;
+
+		case NETWORK_CLIENT:
+			hostmask = ~client->client.network.netmask;
+			if ((hostmask & (hostmask + 1)) != 0) {
+				/* Not a prefix, check it the slow way */
+				idx->ordered[idx->ordered_count].client =
+								client;
+				idx->ordered[idx->ordered_count++].pos = pos;
+			} else if ((client->client.network.netaddr &
+				    hostmask) == 0) {
+				client_index_add_network(idx, client, pos);
+			}
+			/* else host bits are set and it never matches */
+			break;
+
+		case NETGROUP_CLIENT:
+		case WILDCARDHOST_CLIENT:
+		case GSSPRINCIPAL_CLIENT:
+			idx->ordered[idx->ordered_count].client = client;
+			idx->ordered[idx->ordered_count++].pos = pos;
+			break;
+
+		case MATCH_ANY_CLIENT:
+			if (idx->any.client == NULL) {
+				idx->any.client = client;
+				idx->any.pos = pos;
+			}
+			break;
+
+		case BAD_CLIENT:
+		default:
+			break;
+		}
+
+		pos++;
+	}
+
+	LogFullDebug(COMPONENT_EXPORT,
+		     "Client index generation %" PRIu64
+		     " has %" PRIu32 " clients, %" PRIu32
+		     " hosts and %" PRIu32 " checked in order",
+		     idx->generation, total, hosts, idx->ordered_count);
+
+	return idx;
+}
+
+static void client_index_free_nodes(struct client_index_node *node)
+{
+	if (node == NULL)
+		return;
+
+	client_index_free_nodes(node->child[0]);
+	client_index_free_nodes(node->child[1]);
+	gsh_free(node);
+}
+
+/**
+ * @brief Free a compiled client list
+ *
+ * @param[in] idx The index, may be NULL
+ */
+static void client_index_free(struct client_match_index *idx)
+{
+	if (idx == NULL)
+		return;
+
+	client_index_free_nodes(idx->networks);
+	gsh_free(idx->hosts);
+	gsh_free(idx->hosts6);
+	gsh_free(idx->ordered);
+	gsh_free(idx);
+}
+
+static void client_index_host(struct client_match_index *idx,
+			      struct client_index_ref *table,
+			      const void *addr, size_t len,
+			      struct client_index_ref *best)
+{
+	uint32_t slot;
+
+	if (table == NULL)
+		return;
+
+	slot = client_index_slot(idx, table, addr, len);
+
+	if (table[slot].client != NULL && table[slot].pos < best->pos)
+		*best = table[slot];
+}
+
+/**
+ * @brief Find the first client list entry matching a host
+ *
+ * @param[in]  idx      Compiled client list
+ * @param[in]  hostaddr Host to search for
+ * @param[out] named    Whether the result depended on a name lookup
+ *
+ * @return The matching entry or NULL.
+ */
+static exportlist_client_entry_t *client_index_match(
+					struct client_match_index *idx,
+					sockaddr_t *hostaddr,
+					bool *named)
+{
+	struct client_index_ref best = idx->any;
+	struct client_match_state state;
+	struct client_index_node *node;
+	in_addr_t addr;
+	uint32_t haddr, bit, i;
+
+	*named = false;
+
+	if (hostaddr->ss_family == AF_INET6) {
+		struct sockaddr_in6 *psockaddr_in6 =
+		    (struct sockaddr_in6 *)hostaddr;
+
+		client_index_host(idx, idx->hosts6,
+				  &psockaddr_in6->sin6_addr,
+				  sizeof(struct in6_addr), &best);
+		return best.client;
+	}
+
+	addr = get_in_addr(hostaddr);
+	client_index_host(idx, idx->hosts, &addr, sizeof(addr), &best);
+
+	/* Walk the trie, every node on the path is a matching prefix */
+	haddr = ntohl(addr);
+	for (node = idx->networks, bit = 0x80000000; node != NULL;
+	     bit >>= 1) {
+		if (node->ref.pos < best.pos)
+			best = node->ref;
+		if (bit == 0)
+			break;
+		node = node->child[(haddr & bit) != 0];
+	}
+
+	client_match_state_init(&state);
+
+	for (i = 0;
+	     i < idx->ordered_count && idx->ordered[i].pos < best.pos;
+	     i++) {
+		if (client_match_entry(idx->ordered[i].client, hostaddr,
+				       &state)) {
+			best = idx->ordered[i];
+			break;
+		}
+	}
+
+	*named = state.named;
+
+	if (best.client != NULL)
+		LogClientListEntry(NIV_MID_DEBUG,
+				   COMPONENT_EXPORT,
+				   __LINE__,
+				   (char *) __func__,
+				   "Indexed match: ",
+				   best.client);
+
+	return best.client;
+}
+
+/**
+ * @brief Get the generation of an export's access configuration
+ *
+ * Changes whenever the export's client list or the EXPORT_DEFAULTS are
+ * committed, so together with the export_id it can key cached results
+ * of export_check_access.
+ *
+ * @param[in] export The export
+ *
+ * @return The generation, 0 if the export has no client index.
+ */
+uint64_t export_access_generation(struct gsh_export *export)
+{
+	uint64_t generation = 0;
+	uint64_t defaults;
+
+	PTHREAD_RWLOCK_rdlock(&export->lock);
+	if (export->client_index != NULL)
+		generation = export->client_index->generation;
+	PTHREAD_RWLOCK_unlock(&export->lock);
+
+	if (generation == 0)
+		return 0;
+
+	/* Both come from one counter, so the larger one changes with
+	 * either of them.
+	 */
+	defaults = atomic_fetch_uint64_t(&export_opt_generation);
+
+	return defaults > generation ? defaults : generation;
+}
+
+/**
+ * @brief Check whether a client manager entry is the caller's
+ */
+static bool client_is_caller(struct gsh_client *gclient, sockaddr_t *caller)
+{
+	switch (caller->ss_family) {
+	case AF_INET:
+		return gclient->addr.len == sizeof(struct in_addr) &&
+			memcmp(gclient->addr.addr,
+			       &((struct sockaddr_in *)caller)->sin_addr,
+			       sizeof(struct in_addr)) == 0;
+	case AF_INET6:
+		return gclient->addr.len == sizeof(struct in6_addr) &&
+			memcmp(gclient->addr.addr,
+			       &((struct sockaddr_in6 *)caller)->sin6_addr,
+			       sizeof(struct in6_addr)) == 0;
+	default:
+		return false;
+	}
+}
+
+/**
+ * @brief Find the client list entry for the caller of the op context
+ *
+ * Uses the export's client index and remembers the decision in the
+ * caller's struct gsh_client.  A new client list comes with a new
+ * index generation, so decisions never outlive an export update.
+ * Decisions that depended on the IP/name cache are re-evaluated after
+ * CLIENT_DECISION_NAME_TTL seconds.
+ *
+ * Must be called with the export->lock held.
+ *
+ * @param[in] hostaddr Caller address, IPv4 mapped addresses converted
+ * @param[in] export   Export to check
+ *
+ * @return The matching entry or NULL.
+ */
+static exportlist_client_entry_t *client_match_cached(sockaddr_t *hostaddr,
+						      struct gsh_export *export)
+{
+	struct client_match_index *idx = export->client_index;
+	struct gsh_client *gclient = op_ctx->client;
+	struct gsh_client_export_decision *decision;
+	exportlist_client_entry_t *client;
+	time_t curr_time;
+	bool named;
+
+	if (idx == NULL)
+		return client_match_any(hostaddr, export);
+
+	if (gclient == NULL || !client_is_caller(gclient, op_ctx->caller_addr))
+		return client_index_match(idx, hostaddr, &named);
+
+	decision = &gclient->export_decisions[idx->generation %
+					      CLIENT_EXPORT_DECISIONS];
+	curr_time = time(NULL);
+
+	PTHREAD_RWLOCK_rdlock(&gclient->lock);
+
+	if (decision->generation == idx->generation &&
+	    (decision->expire == 0 || decision->expire > curr_time)) {
+		client = decision->entry;
+		PTHREAD_RWLOCK_unlock(&gclient->lock);
+		return client;
+	}
+
+	PTHREAD_RWLOCK_unlock(&gclient->lock);
+
+	client = client_index_match(idx, hostaddr, &named);
+
+	PTHREAD_RWLOCK_wrlock(&gclient->lock);
+	decision->generation = idx->generation;
+	decision->entry = client;
+	decision->expire = named ? curr_time + CLIENT_DECISION_NAME_TTL : 0;
+	PTHREAD_RWLOCK_unlock(&gclient->lock);
+
+	return client;
+}
+
+/**
+ * @brief Get when the caller's client list decision on an export expires
+ *
+ * An export_check_access result that depended on the IP/name cache is
+ * only good for as long as the decision it came from.
+ *
+ * @param[in]  export The export
+ * @param[out] expire When the decision expires, 0 if it does not
+ *
+ * @return false if no decision is remembered for the caller.
+ */
+bool export_access_expire(struct gsh_export *export, time_t *expire)
+{
+	struct gsh_client *gclient = op_ctx->client;
+	struct gsh_client_export_decision *decision;
+	struct client_match_index *idx;
+	bool found = false;
+
+	if (gclient == NULL || !client_is_caller(gclient, op_ctx->caller_addr))
+		return false;
+
+	PTHREAD_RWLOCK_rdlock(&export->lock);
+
+	idx = export->client_index;
+	if (idx != NULL) {
+		decision = &gclient->export_decisions[idx->generation %
+						      CLIENT_EXPORT_DECISIONS];
+
+		PTHREAD_RWLOCK_rdlock(&gclient->lock);
+		if (decision->generation == idx->generation) {
+			*expire = decision->expire;
+			found = true;
+		}
+		PTHREAD_RWLOCK_unlock(&gclient->lock);
+	}
+
+	PTHREAD_RWLOCK_unlock(&export->lock);
+
+	return found;
+}
+
 /**
  * @brief Checks if request security flavor is suffcient for the requested
  *        export
@@ -2856,7 +3639,7 @@ void export_check_access(void)
 	}
 
 	/* Does the client match anyone on the client list? */
-	client = client_match_any(hostaddr, op_ctx->ctx_export);
+	client = client_match_cached(hostaddr, op_ctx->ctx_export);
 	if (client != NULL) {
 		/* Take client options */
 		op_ctx->export_perms->options = client->client_perms.options &
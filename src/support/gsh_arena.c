@@ -0,0 +1,199 @@
+/*
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public License
+ * as published by the Free Software Foundation; either version 3 of
+ * the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA
+ * 02110-1301 USA
+ *
+ * ---------------------------------------
+ */
+
+/**
+ * @file  gsh_arena.c
+ * @brief Bump allocator for request scoped memory
+ */
+
+#include "config.h"
+#include <string.h>
+#include "abstract_mem.h"
+#include "gsh_arena.h"
+
+/* Every allocation is aligned for any scalar type */
+#define ARENA_ALIGN 16
+#define ARENA_ROUND(n) (((n) + ARENA_ALIGN - 1) & ~((size_t)ARENA_ALIGN - 1))
+
+struct gsh_arena_chunk {
+	struct gsh_arena_chunk *next;
+	size_t size;		/*< Usable bytes after the header */
+	size_t used;		/*< Bytes handed out */
+};
+
+#define ARENA_HDR ARENA_ROUND(sizeof(struct gsh_arena_chunk))
+
+static inline char *chunk_data(struct gsh_arena_chunk *chunk)
+{
+	return (char *)chunk + ARENA_HDR;
+}
+
+static struct gsh_arena_chunk *chunk_new(struct gsh_arena *arena,
+					 size_t size)
+{
+	struct gsh_arena_chunk *chunk = gsh_malloc(ARENA_HDR + size);
+
+	chunk->next = NULL;
+	chunk->size = size;
+	chunk->used = 0;
+	arena->heap_allocs++;
+	return chunk;
+}
+
+/**
+ * @brief Set up an arena
+ *
+ * The first chunk is allocated now and kept until the arena is
+ * destroyed.
+ *
+ * @param[out] arena      The arena
+ * @param[in]  chunk_size Size of a chunk, 0 for the default
+ */
+
+void gsh_arena_init(struct gsh_arena *arena, size_t chunk_size)
+{
+	memset(arena, 0, sizeof(*arena));
+	arena->chunk_size = ARENA_ROUND(chunk_size != 0
+					? chunk_size : GSH_ARENA_CHUNK_SIZE);
+	arena->first = chunk_new(arena, arena->chunk_size);
+	arena->chunks = arena->first;
+}
+
+/**
+ * @brief Allocate from an arena
+ *
+ * Requests larger than a quarter of a chunk get a chunk of their own,
+ * so that one big buffer does not waste the rest of the current one.
+ *
+ * @param[in] arena The arena
+ * @param[in] size  Bytes wanted
+ *
+ * @return The memory, 16 byte aligned.  Never NULL.
+ */
+
+void *gsh_arena_alloc(struct gsh_arena *arena, size_t size)
+{
+	struct gsh_arena_chunk *chunk = arena->chunks;
+	void *ptr;
+
+	size = ARENA_ROUND(size != 0 ? size : 1);
+	arena->allocs++;
+	arena->bytes += size;
+
+	if (size > arena->chunk_size / 4) {
+		/* Behind the current chunk, which keeps serving */
+		struct gsh_arena_chunk *big = chunk_new(arena, size);
+
+		big->used = size;
+		big->next = chunk->next;
+		chunk->next = big;
+		return chunk_data(big);
+	}
+
+	if (chunk->used + size > chunk->size) {
+		chunk = chunk_new(arena, arena->chunk_size);
+		chunk->next = arena->chunks;
+		arena->chunks = chunk;
+	}
+
+	ptr = chunk_data(chunk) + chunk->used;
+	chunk->used += size;
+	return ptr;
+}
+
+/**
+ * @brief Allocate zeroed memory from an arena
+ *
+ * @param[in] arena The arena
+ * @param[in] n     Number of elements
+ * @param[in] size  Size of an element
+ *
+ * @return The memory.  Never NULL.
+ */
+
+void *gsh_arena_calloc(struct gsh_arena *arena, size_t n, size_t size)
+{
+	void *ptr = gsh_arena_alloc(arena, n * size);
+
+	memset(ptr, 0, n * size);
+	return ptr;
+}
+
+/**
+ * @brief Check whether memory came from an arena
+ *
+ * @param[in] arena The arena
+ * @param[in] ptr   The memory
+ *
+ * @return true if ptr lies in one of the arena's chunks.
+ */
+
+bool gsh_arena_owns(struct gsh_arena *arena, const void *ptr)
+{
+	struct gsh_arena_chunk *chunk;
+	const char *p = ptr;
+
+	for (chunk = arena->chunks; chunk != NULL; chunk = chunk->next) {
+		const char *data = chunk_data(chunk);
+
+		if (p >= data && p < data + chunk->size)
+			return true;
+	}
+	return false;
+}
+
+/**
+ * @brief Release everything allocated from an arena
+ *
+ * Only the first chunk is kept, so a request that needed a lot of
+ * memory does not pin it for the life of the thread.
+ *
+ * @param[in] arena The arena
+ */
+
+void gsh_arena_reset(struct gsh_arena *arena)
+{
+	struct gsh_arena_chunk *chunk, *next;
+
+	for (chunk = arena->chunks; chunk != NULL; chunk = next) {
+		next = chunk->next;
+		if (chunk != arena->first)
+			gsh_free(chunk);
+	}
+	arena->first->next = NULL;
+	arena->first->used = 0;
+	arena->chunks = arena->first;
+}
+
+/**
+ * @brief Free an arena's memory
+ *
+ * @param[in] arena The arena
+ */
+
+void gsh_arena_destroy(struct gsh_arena *arena)
+{
+	if (arena->first == NULL)
+		return;
+
+	gsh_arena_reset(arena);
+	gsh_free(arena->first);
+	arena->first = NULL;
+	arena->chunks = NULL;
+}
@@ -21,6 +21,9 @@
 #include "log.h"
 #include "config_parsing.h"
 #include <string.h>
+#include <strings.h>
+#include <ctype.h>
+#include <errno.h>
 #include <unistd.h>
 #include "gsh_intrinsic.h"
 #include "gsh_types.h"
@@ -30,6 +33,8 @@
 #include "netdb.h"
 #include "abstract_mem.h"
 #include "netgroup_cache.h"
+#include "nfs_core.h"
+#include "fridgethr.h"
 
 /* Netgroup cache information */
 struct ng_cache_info {
@@ -44,6 +49,18 @@ struct ng_cache_info {
 /* Uses FNV hash */
 #define FNV_PRIME32 16777619
 #define FNV_OFFSET32 2166136261U
+static uint32_t ng_str_hash(const char *str, bool fold)
+{
+	uint32_t hash = FNV_OFFSET32;
+	const unsigned char *bp;
+
+	for (bp = (const unsigned char *)str; *bp != '\0'; bp++) {
+		hash ^= fold ? tolower(*bp) : *bp;
+		hash *= FNV_PRIME32;
+	}
+	return hash;
+}
+
 static int ng_hash_key(struct ng_cache_info *info)
 {
 	uint32_t hash = FNV_OFFSET32;
@@ -72,6 +89,45 @@ pthread_rwlock_t ng_lock = PTHREAD_RWLOCK_INITIALIZER;
 static struct avltree pos_ng_tree;
 static struct avltree neg_ng_tree;
 
+/**
+ * @brief A host in an expanded netgroup
+ */
+struct ng_host {
+	struct ng_host *next;	/*< Next host in the bucket */
+	uint32_t hash;		/*< Case folded hash of the name */
+	char name[];		/*< Host name */
+};
+
+/**
+ * @brief Every host of one netgroup, indexed by name
+ */
+struct ng_hostset {
+	uint32_t mask;		/*< Number of buckets less one */
+	uint32_t count;		/*< Number of distinct hosts */
+	bool any_host;		/*< A triple left the host empty */
+	struct ng_host *buckets[];
+};
+
+/**
+ * @brief A netgroup named by an export client list
+ *
+ * Kept in ng_expand_table, protected by ng_lock.  hosts is NULL until
+ * the first expansion of the netgroup succeeds; lookups then fall back
+ * to the per host cache above.
+ */
+struct ng_expanded {
+	struct ng_expanded *next;	/*< Next netgroup in the bucket */
+	char *group;			/*< Netgroup name */
+	uint32_t hash;			/*< Hash of the name */
+	uint32_t refcount;		/*< Client list entries naming it */
+	struct ng_hostset *hosts;	/*< Last successful expansion */
+};
+
+#define NG_EXPAND_BUCKETS 64
+
+static struct ng_expanded *ng_expand_table[NG_EXPAND_BUCKETS];
+static struct fridgethr *ng_expand_fridge;
+
 static inline int buffdesc_comparator(const struct gsh_buffdesc *buff1,
 				      const struct gsh_buffdesc *buff2)
 {
@@ -115,6 +171,38 @@ static bool ng_expired(struct avltree_node *node)
 
 
 
+static void ng_expand_run(struct fridgethr_context *ctx);
+
+static void ng_expand_init(void)
+{
+	struct fridgethr_params frp;
+	int rc;
+
+	memset(&frp, 0, sizeof(struct fridgethr_params));
+	frp.thr_max = 1;
+	frp.thr_min = 1;
+	frp.thread_delay = nfs_param.core_param.netgroup_expand_interval;
+	frp.flavor = fridgethr_flavor_looper;
+
+	rc = fridgethr_init(&ng_expand_fridge, "ng_expand", &frp);
+	if (rc != 0) {
+		LogMajor(COMPONENT_EXPORT,
+			 "Unable to initialize netgroup expander fridge, error code %d.",
+			 rc);
+		ng_expand_fridge = NULL;
+		return;
+	}
+
+	rc = fridgethr_submit(ng_expand_fridge, ng_expand_run, NULL);
+	if (rc != 0) {
+		LogMajor(COMPONENT_EXPORT,
+			 "Unable to start netgroup expander, error code %d.",
+			 rc);
+		fridgethr_destroy(ng_expand_fridge);
+		ng_expand_fridge = NULL;
+	}
+}
+
 /**
  * @brief Initialize the netgroups cache
  */
@@ -123,6 +211,9 @@ void ng_cache_init(void)
 	avltree_init(&pos_ng_tree, ng_comparator, 0);
 	avltree_init(&neg_ng_tree, ng_comparator, 0);
 	memset(ng_cache, 0, NG_CACHE_SIZE * sizeof(struct avltree_node *));
+
+	if (nfs_param.core_param.netgroup_expand_interval != 0)
+		ng_expand_init();
 }
 
 static void ng_free(struct ng_cache_info *info)
@@ -261,17 +352,298 @@ expired:
 	return false;
 }
 
+static void ng_hostset_free(struct ng_hostset *set)
+{
+	struct ng_host *host;
+	uint32_t i;
+
+	if (set == NULL)
+		return;
+
+	for (i = 0; i <= set->mask; i++) {
+		while ((host = set->buckets[i]) != NULL) {
+			set->buckets[i] = host->next;
+			gsh_free(host);
+		}
+	}
+	gsh_free(set);
+}
+
+/* The caller must hold ng_lock */
+static bool ng_hostset_member(const struct ng_hostset *set, const char *host)
+{
+	uint32_t hash;
+	const struct ng_host *h;
+
+	if (set->any_host)
+		return true;
+
+	hash = ng_str_hash(host, true);
+	for (h = set->buckets[hash & set->mask]; h != NULL; h = h->next) {
+		/* innetgr() compares host names ignoring case */
+		if (h->hash == hash && strcasecmp(h->name, host) == 0)
+			return true;
+	}
+	return false;
+}
+
+/* The caller must hold ng_lock */
+static struct ng_expanded *ng_expanded_lookup(const char *group,
+					      uint32_t hash)
+{
+	struct ng_expanded *ng;
+
+	for (ng = ng_expand_table[hash % NG_EXPAND_BUCKETS]; ng != NULL;
+	     ng = ng->next) {
+		if (ng->hash == hash && strcmp(ng->group, group) == 0)
+			return ng;
+	}
+	return NULL;
+}
+
+/**
+ * @brief Read every host of a netgroup into a new host set
+ *
+ * Only the expander thread calls this, so the non reentrant
+ * setnetgrent() iteration is safe.  innetgr() keeps its own state.
+ *
+ * @param[in] group Netgroup to expand
+ *
+ * @return The host set, NULL if the netgroup yielded nothing.
+ */
+static struct ng_hostset *ng_expand_group(const char *group)
+{
+	char *host, *user, *domain;
+	struct ng_host *hosts = NULL, *h, *dup;
+	struct ng_hostset *set;
+	uint32_t count = 0, nbuckets = 16;
+	bool any_host = false;
+	size_t len;
+
+	setnetgrent(group);
+	while (getnetgrent(&host, &user, &domain)) {
+		if (host == NULL) {
+			any_host = true;
+			continue;
+		}
+		len = strlen(host) + 1;
+		h = gsh_malloc(sizeof(*h) + len);
+		memcpy(h->name, host, len);
+		h->hash = ng_str_hash(host, true);
+		h->next = hosts;
+		hosts = h;
+		count++;
+	}
+	endnetgrent();
+
+	/* An empty result is what a backend outage looks like too, so
+	 * never let it replace a good expansion.
+	 */
+	if (count == 0 && !any_host)
+		return NULL;
+
+	while (nbuckets < count && nbuckets < (1U << 24))
+		nbuckets <<= 1;
+
+	set = gsh_calloc(1, sizeof(*set) +
+			    nbuckets * sizeof(struct ng_host *));
+	set->mask = nbuckets - 1;
+	set->any_host = any_host;
+
+	while ((h = hosts) != NULL) {
+		hosts = h->next;
+		for (dup = set->buckets[h->hash & set->mask]; dup != NULL;
+		     dup = dup->next) {
+			if (dup->hash == h->hash &&
+			    strcasecmp(dup->name, h->name) == 0)
+				break;
+		}
+		if (dup != NULL) {
+			gsh_free(h);
+			continue;
+		}
+		h->next = set->buckets[h->hash & set->mask];
+		set->buckets[h->hash & set->mask] = h;
+		set->count++;
+	}
+
+	return set;
+}
+
+/**
+ * @brief Expand every registered netgroup and publish the host sets
+ *
+ * Runs on the expander thread every Netgroup_Expand_Interval seconds.
+ * The directory service is only queried with ng_lock dropped, the
+ * write lock is held just long enough to swap in a finished set.
+ */
+static void ng_expand_run(struct fridgethr_context *ctx)
+{
+	struct ng_expanded *ng;
+	struct ng_hostset *set;
+	char **groups;
+	uint32_t ngroups = 0, i, hash;
+
+	SetNameFunction("ng_expand");
+
+	PTHREAD_RWLOCK_rdlock(&ng_lock);
+	for (i = 0; i < NG_EXPAND_BUCKETS; i++)
+		for (ng = ng_expand_table[i]; ng != NULL; ng = ng->next)
+			ngroups++;
+
+	if (ngroups == 0) {
+		PTHREAD_RWLOCK_unlock(&ng_lock);
+		return;
+	}
+
+	groups = gsh_calloc(ngroups, sizeof(char *));
+	ngroups = 0;
+	for (i = 0; i < NG_EXPAND_BUCKETS; i++)
+		for (ng = ng_expand_table[i]; ng != NULL; ng = ng->next)
+			groups[ngroups++] = gsh_strdup(ng->group);
+	PTHREAD_RWLOCK_unlock(&ng_lock);
+
+	for (i = 0; i < ngroups; i++) {
+		set = ng_expand_group(groups[i]);
+		if (set == NULL) {
+			LogInfo(COMPONENT_EXPORT,
+				"Netgroup %s expanded to no hosts, keeping the previous expansion",
+				groups[i]);
+			gsh_free(groups[i]);
+			continue;
+		}
+
+		LogDebug(COMPONENT_EXPORT,
+			 "Netgroup %s expanded to %"PRIu32" hosts%s",
+			 groups[i], set->count,
+			 set->any_host ? " (any host)" : "");
+
+		hash = ng_str_hash(groups[i], false);
+		PTHREAD_RWLOCK_wrlock(&ng_lock);
+		ng = ng_expanded_lookup(groups[i], hash);
+		if (ng != NULL) {
+			struct ng_hostset *old = ng->hosts;
+
+			ng->hosts = set;
+			set = old;
+		}
+		PTHREAD_RWLOCK_unlock(&ng_lock);
+
+		/* Either the replaced set or, if the netgroup went
+		 * away meanwhile, the new one.
+		 */
+		ng_hostset_free(set);
+		gsh_free(groups[i]);
+	}
+	gsh_free(groups);
+}
+
+/**
+ * @brief Note that a client list names a netgroup
+ *
+ * Netgroups registered here are expanded in the background when
+ * Netgroup_Expand_Interval is set.  Every call must be paired with
+ * ng_expand_unregister().
+ *
+ * @param[in] group Netgroup name
+ */
+void ng_expand_register(const char *group)
+{
+	struct ng_expanded *ng;
+	uint32_t hash = ng_str_hash(group, false);
+	bool added = false;
+
+	PTHREAD_RWLOCK_wrlock(&ng_lock);
+	ng = ng_expanded_lookup(group, hash);
+	if (ng == NULL) {
+		ng = gsh_calloc(1, sizeof(*ng));
+		ng->group = gsh_strdup(group);
+		ng->hash = hash;
+		ng->next = ng_expand_table[hash % NG_EXPAND_BUCKETS];
+		ng_expand_table[hash % NG_EXPAND_BUCKETS] = ng;
+		added = true;
+	}
+	ng->refcount++;
+	PTHREAD_RWLOCK_unlock(&ng_lock);
+
+	/* Expand a netgroup new to a reloaded config without waiting */
+	if (added && ng_expand_fridge != NULL)
+		fridgethr_wake(ng_expand_fridge);
+}
+
+/**
+ * @brief Drop a reference taken by ng_expand_register()
+ *
+ * @param[in] group Netgroup name
+ */
+void ng_expand_unregister(const char *group)
+{
+	struct ng_expanded *ng, **prev;
+	uint32_t hash = ng_str_hash(group, false);
+
+	PTHREAD_RWLOCK_wrlock(&ng_lock);
+	for (prev = &ng_expand_table[hash % NG_EXPAND_BUCKETS];
+	     (ng = *prev) != NULL; prev = &ng->next) {
+		if (ng->hash == hash && strcmp(ng->group, group) == 0)
+			break;
+	}
+	if (ng == NULL || --ng->refcount != 0) {
+		PTHREAD_RWLOCK_unlock(&ng_lock);
+		return;
+	}
+	*prev = ng->next;
+	PTHREAD_RWLOCK_unlock(&ng_lock);
+
+	ng_hostset_free(ng->hosts);
+	gsh_free(ng->group);
+	gsh_free(ng);
+}
+
+/**
+ * @brief Stop the netgroup expander thread
+ *
+ * @return 0 on success, otherwise an error from the fridge.
+ */
+int ng_cache_shutdown(void)
+{
+	int rc;
+
+	if (ng_expand_fridge == NULL)
+		return 0;
+
+	rc = fridgethr_sync_command(ng_expand_fridge, fridgethr_comm_stop,
+				    120);
+	if (rc == ETIMEDOUT) {
+		LogMajor(COMPONENT_EXPORT,
+			 "Shutdown timed out, cancelling threads.");
+		fridgethr_cancel(ng_expand_fridge);
+	} else if (rc != 0) {
+		LogMajor(COMPONENT_EXPORT,
+			 "Failed shutting down netgroup expander: %d", rc);
+	}
+	return rc;
+}
+
 /**
  * @brief Verify if the given host is in the given netgroup or not
  */
 bool ng_innetgr(const char *group, const char *host)
 {
+	struct ng_expanded *ng;
 	int rc;
 
-	/* Check positive lookup and then negative lookup.  If absent in
-	 * both, then do a real innetgr call and cache the results.
+	/* An expanded netgroup answers every host without calling out.
+	 * Otherwise check positive lookup and then negative lookup.  If
+	 * absent in both, then do a real innetgr call and cache the
+	 * results.
 	 */
 	PTHREAD_RWLOCK_rdlock(&ng_lock);
+	ng = ng_expanded_lookup(group, ng_str_hash(group, false));
+	if (ng != NULL && ng->hosts != NULL) {
+		rc = ng_hostset_member(ng->hosts, host);
+		PTHREAD_RWLOCK_unlock(&ng_lock);
+		return rc;
+	}
 	if (ng_lookup(group, host, false)) { /* positive lookup */
 		PTHREAD_RWLOCK_unlock(&ng_lock);
 		return true;
@@ -296,6 +668,9 @@ bool ng_innetgr(const char *group, const char *host)
 
 /**
  * @brief Wipe out the netgroup cache
+ *
+ * Expanded netgroups are kept, so lookups still never block, but are
+ * expanded again right away.
  */
 void ng_clear_cache(void)
 {
@@ -322,4 +697,7 @@ void ng_clear_cache(void)
 	assert(avltree_first(&neg_ng_tree) == NULL);
 
 	PTHREAD_RWLOCK_unlock(&ng_lock);
+
+	if (ng_expand_fridge != NULL)
+		fridgethr_wake(ng_expand_fridge);
 }
@@ -57,6 +57,7 @@
 #include "export_mgr.h"
 #include "uid2grp.h"
 #include "client_mgr.h"
+#include "city.h"
 
 /* Export permissions for root op context */
 uint32_t root_op_export_options = EXPORT_OPTION_ROOT |
@@ -538,6 +539,339 @@ void clean_credentials(void)
 	init_credentials();
 }
 
+/**
+ * @brief Per-connection cache of export access and credential results
+ *
+ * A TCP connection talks for a single client, and usually for a few
+ * users on a few exports.  The results of export_check_access and the
+ * uid2grp lookup of nfs_req_creds are cached for it, keyed by a hash of
+ * the AUTH_SYS credential, the export and the export's access
+ * generation.  Reloading the export or EXPORT_DEFAULTS changes the
+ * generation, and group data is dropped once uid2grp would expire it
+ * or the uid2grp cache is wiped.  A result that matched the client by
+ * netgroup or host name expires with the client list decision it came
+ * from.
+ */
+
+/** Number of entries in a per-connection cache */
+#define NFS_CRED_CACHE_SIZE 8
+
+/** Entries per set, a credential may be cached in any of its set */
+#define NFS_CRED_CACHE_WAYS 2
+
+/** Largest AUTH_SYS group list that is cached */
+#define NFS_CRED_CACHE_MAX_GIDS 16
+
+struct nfs_cred_cache_entry {
+	uint64_t hash;		/*< Credential hash, 0 if unused */
+	uint64_t generation;	/*< export_access_generation of export */
+	uint64_t used;		/*< Cache clock at the last hit or fill */
+	uint16_t export_id;
+	uint32_t prog;
+	uint32_t vers;
+	uid_t uid;
+	gid_t gid;
+	uint32_t glen;
+	gid_t gids[NFS_CRED_CACHE_MAX_GIDS];
+	struct export_perms perms;	/*< Result of export_check_access */
+	time_t expire;			/*< When perms expire, 0 never */
+	struct group_data *gdata;	/*< Managed groups, a ref is held */
+	uint64_t gdata_generation;	/*< uid2grp generation of gdata */
+};
+
+struct nfs_cred_cache {
+	pthread_mutex_t mtx;
+	uint64_t clock;		/*< Bumped on every hit or fill */
+	struct nfs_cred_cache_entry entries[NFS_CRED_CACHE_SIZE];
+};
+
+/**
+ * @brief Allocate a credential cache
+ *
+ * @return The new cache.
+ */
+struct nfs_cred_cache *nfs_cred_cache_alloc(void)
+{
+	struct nfs_cred_cache *cache = gsh_calloc(1, sizeof(*cache));
+
+	PTHREAD_MUTEX_init(&cache->mtx, NULL);
+
+	return cache;
+}
+
+/**
+ * @brief Free a credential cache and the group data it holds
+ *
+ * @param[in] cache The cache, may be NULL
+ */
+void nfs_cred_cache_free(struct nfs_cred_cache *cache)
+{
+	int i;
+
+	if (cache == NULL)
+		return;
+
+	for (i = 0; i < NFS_CRED_CACHE_SIZE; i++) {
+		if (cache->entries[i].gdata != NULL)
+			uid2grp_unref(cache->entries[i].gdata);
+	}
+
+	PTHREAD_MUTEX_destroy(&cache->mtx);
+	gsh_free(cache);
+}
+
+/**
+ * @brief Get the credential cache of a transport
+ *
+ * Only TCP connections get one, a UDP transport is shared by all the
+ * clients.  The cache is allocated on first use and freed with the
+ * transport's private data.
+ *
+ * @param[in] xprt The transport
+ *
+ * @return The cache or NULL.
+ */
+struct nfs_cred_cache *nfs_xprt_cred_cache(SVCXPRT *xprt)
+{
+	gsh_xprt_private_t *xu = (gsh_xprt_private_t *)xprt->xp_u1;
+	struct nfs_cred_cache *cache;
+
+	if (xu == NULL || svc_get_xprt_type(xprt) != XPRT_TCP)
+		return NULL;
+
+	cache = atomic_fetch_voidptr((void **)&xu->cred_cache);
+	if (cache != NULL)
+		return cache;
+
+	PTHREAD_MUTEX_lock(&xprt->xp_lock);
+
+	if (xu->cred_cache == NULL)
+		atomic_store_voidptr((void **)&xu->cred_cache,
+				     nfs_cred_cache_alloc());
+
+	cache = xu->cred_cache;
+
+	PTHREAD_MUTEX_unlock(&xprt->xp_lock);
+
+	return cache;
+}
+
+/**
+ * @brief Find the cache set for the request, if it can be cached
+ *
+ * The hash covers the export and the RPC program and version as well
+ * as the credential, so the same user on several exports or protocols
+ * does not keep landing in one set.
+ *
+ * @param[in]  cache      The cache
+ * @param[in]  req        The request
+ * @param[out] hash       Hash of the AUTH_SYS credential and export
+ * @param[out] generation Access generation of the op context's export
+ *
+ * @return The first of the NFS_CRED_CACHE_WAYS entries of the set, or
+ *         NULL if the request is not cacheable.
+ */
+static struct nfs_cred_cache_entry *nfs_cred_cache_slot(
+					struct nfs_cred_cache *cache,
+					struct svc_req *req,
+					uint64_t *hash,
+					uint64_t *generation)
+{
+	struct authunix_parms *aup;
+
+	if (cache == NULL || op_ctx->ctx_export == NULL ||
+	    req->rq_msg.cb_cred.oa_flavor != AUTH_SYS)
+		return NULL;
+
+	aup = (struct authunix_parms *)req->rq_msg.rq_cred_body;
+
+	if (aup->aup_len > NFS_CRED_CACHE_MAX_GIDS)
+		return NULL;
+
+	*generation = export_access_generation(op_ctx->ctx_export);
+
+	if (*generation == 0)
+		return NULL;
+
+	*hash = CityHash64WithSeeds((char *)aup->aup_gids,
+				    aup->aup_len * sizeof(gid_t),
+				    ((uint64_t) aup->aup_uid << 32) |
+				    aup->aup_gid,
+				    ((uint64_t) op_ctx->ctx_export->export_id
+				     << 48) ^
+				    ((uint64_t) req->rq_msg.cb_prog << 16) ^
+				    req->rq_msg.cb_vers);
+	if (*hash == 0)
+		*hash = 1;
+
+	return &cache->entries[(*hash % (NFS_CRED_CACHE_SIZE /
+					 NFS_CRED_CACHE_WAYS)) *
+			       NFS_CRED_CACHE_WAYS];
+}
+
+/**
+ * @brief Check whether a cache entry is for the request
+ *
+ * @param[in] entry The entry
+ * @param[in] req   The request
+ * @param[in] hash  Hash from nfs_cred_cache_slot
+ *
+ * @return true if the entry has the request's credential and export.
+ */
+static bool nfs_cred_cache_match(struct nfs_cred_cache_entry *entry,
+				 struct svc_req *req,
+				 uint64_t hash)
+{
+	struct authunix_parms *aup =
+		(struct authunix_parms *)req->rq_msg.rq_cred_body;
+
+	return entry->hash == hash &&
+	       entry->export_id == op_ctx->ctx_export->export_id &&
+	       entry->prog == req->rq_msg.cb_prog &&
+	       entry->vers == req->rq_msg.cb_vers &&
+	       entry->uid == aup->aup_uid &&
+	       entry->gid == aup->aup_gid &&
+	       entry->glen == aup->aup_len &&
+	       memcmp(entry->gids, aup->aup_gids,
+		      aup->aup_len * sizeof(gid_t)) == 0;
+}
+
+/**
+ * @brief Look up the request in the credential cache
+ *
+ * On a hit the op context gets the cached export permissions, and the
+ * cached group data if Manage_Gids applies, so the caller can skip
+ * export_check_access and the checks on its result and go straight to
+ * nfs_req_creds, which will not need to call uid2grp.
+ *
+ * @param[in] cache The cache, may be NULL
+ * @param[in] req   The request
+ *
+ * @return true on a hit.
+ */
+bool nfs_cred_cache_get(struct nfs_cred_cache *cache, struct svc_req *req)
+{
+	struct nfs_cred_cache_entry *set, *entry = NULL;
+	uint64_t hash = 0, generation = 0;
+	bool hit = false;
+	int i;
+
+	set = nfs_cred_cache_slot(cache, req, &hash, &generation);
+
+	if (set == NULL)
+		return false;
+
+	PTHREAD_MUTEX_lock(&cache->mtx);
+
+	for (i = 0; i < NFS_CRED_CACHE_WAYS; i++) {
+		if (nfs_cred_cache_match(&set[i], req, hash)) {
+			entry = &set[i];
+			break;
+		}
+	}
+
+	if (entry == NULL ||
+	    entry->generation != generation ||
+	    (entry->expire != 0 && entry->expire <= time(NULL)))
+		goto out;
+
+	if (entry->gdata != NULL &&
+	    (entry->gdata_generation != uid2grp_generation() ||
+	     time(NULL) - entry->gdata->epoch >
+			nfs_param.core_param.manage_gids_expiration)) {
+		/* Group data expired, uid2grp will fetch it again */
+		uid2grp_unref(entry->gdata);
+		entry->gdata = NULL;
+	}
+
+	*op_ctx->export_perms = entry->perms;
+
+	if (entry->gdata != NULL && op_ctx->caller_gdata == NULL) {
+		uid2grp_hold_group_data(entry->gdata);
+		op_ctx->caller_gdata = entry->gdata;
+	}
+
+	entry->used = ++cache->clock;
+	hit = true;
+
+out:
+	PTHREAD_MUTEX_unlock(&cache->mtx);
+
+	return hit;
+}
+
+/**
+ * @brief Remember the results for the request in the credential cache
+ *
+ * Call after export_check_access, the checks on its result and
+ * nfs_req_creds all succeeded.  An older entry for the same request is
+ * replaced, otherwise an unused or the least recently used entry of
+ * the set.
+ *
+ * @param[in] cache The cache, may be NULL
+ * @param[in] req   The request
+ */
+void nfs_cred_cache_put(struct nfs_cred_cache *cache, struct svc_req *req)
+{
+	struct nfs_cred_cache_entry *set, *entry;
+	struct authunix_parms *aup;
+	struct group_data *old_gdata;
+	uint64_t hash = 0, generation = 0;
+	time_t expire;
+	int i;
+
+	set = nfs_cred_cache_slot(cache, req, &hash, &generation);
+
+	/* Without the decision behind it, the result can't be expired */
+	if (set == NULL ||
+	    !export_access_expire(op_ctx->ctx_export, &expire))
+		return;
+
+	aup = (struct authunix_parms *)req->rq_msg.rq_cred_body;
+
+	PTHREAD_MUTEX_lock(&cache->mtx);
+
+	entry = &set[0];
+
+	for (i = 0; i < NFS_CRED_CACHE_WAYS; i++) {
+		if (nfs_cred_cache_match(&set[i], req, hash)) {
+			entry = &set[i];
+			break;
+		}
+		if (set[i].hash == 0 ||
+		    (entry->hash != 0 && set[i].used < entry->used))
+			entry = &set[i];
+	}
+
+	old_gdata = entry->gdata;
+
+	entry->hash = hash;
+	entry->generation = generation;
+	entry->used = ++cache->clock;
+	entry->export_id = op_ctx->ctx_export->export_id;
+	entry->prog = req->rq_msg.cb_prog;
+	entry->vers = req->rq_msg.cb_vers;
+	entry->uid = aup->aup_uid;
+	entry->gid = aup->aup_gid;
+	entry->glen = aup->aup_len;
+	memcpy(entry->gids, aup->aup_gids, aup->aup_len * sizeof(gid_t));
+	entry->perms = *op_ctx->export_perms;
+	entry->expire = expire;
+	entry->gdata = NULL;
+
+	if ((op_ctx->cred_flags & MANAGED_GIDS) != 0 &&
+	    op_ctx->caller_gdata != NULL) {
+		uid2grp_hold_group_data(op_ctx->caller_gdata);
+		entry->gdata = op_ctx->caller_gdata;
+		entry->gdata_generation = uid2grp_generation();
+	}
+
+	PTHREAD_MUTEX_unlock(&cache->mtx);
+
+	if (old_gdata != NULL)
+		uid2grp_unref(old_gdata);
+}
+
 /**
  * @brief Validate export permissions
  *
@@ -550,6 +884,14 @@ nfsstat4 nfs4_export_check_access(struct svc_req *req)
 {
 	xprt_type_t xprt_type = svc_get_xprt_type(req->rq_xprt);
 	int port = get_port(op_ctx->caller_addr);
+	struct nfs_cred_cache *cache = nfs_xprt_cred_cache(req->rq_xprt);
+	nfsstat4 status;
+
+	/* Same client, user and export configuration as a request that
+	 * already passed all the checks below on this connection.
+	 */
+	if (nfs_cred_cache_get(cache, req))
+		return nfs_req_creds(req);
 
 	LogMidDebugAlt(COMPONENT_NFS_V4, COMPONENT_EXPORT,
 		    "nfs4_export_check_access about to call export_check_access");
@@ -626,7 +968,12 @@ nfsstat4 nfs4_export_check_access(struct svc_req *req)
 	}
 
 	/* Get creds */
-	return nfs_req_creds(req);
+	status = nfs_req_creds(req);
+
+	if (status == NFS4_OK)
+		nfs_cred_cache_put(cache, req);
+
+	return status;
 }
 
 /**
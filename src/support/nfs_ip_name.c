@@ -36,7 +36,11 @@
 #include "nfs_exports.h"
 #include "nfs_ip_stats.h"
 #include "config_parsing.h"
+#include "fridgethr.h"
+#include "gsh_list.h"
+#include "common_utils.h"
 #include <stdlib.h>
+#include <errno.h>
 #include <string.h>
 #include <sys/socket.h>
 #include <netinet/in.h>
@@ -45,6 +49,33 @@
 /* Hashtable used to cache the hostname, accessed by their IP addess */
 hash_table_t *ht_ip_name;
 unsigned int expiration_time;
+static unsigned int negative_expiration_time;
+static uint32_t resolver_wait_timeout;
+
+/* getnameinfo, or a stub set by a test */
+static ip_name_resolver_t ip_name_resolver = getnameinfo;
+
+/**
+ * @brief An address being resolved by the resolver pool
+ *
+ * Workers that need the same address wait on ip_name_pending_cond
+ * for the one resolution instead of starting their own.
+ */
+struct ip_name_pending {
+	struct glist_head list;		/*< Link in ip_name_pending_table */
+	sockaddr_t addr;		/*< Address being resolved */
+	uint32_t refcount;		/*< Resolver plus waiters */
+	bool done;			/*< hostname and rc are set */
+	int rc;				/*< IP_NAME_SUCCESS or an error */
+	char hostname[MAXHOSTNAMELEN + 1];
+};
+
+#define IP_NAME_PENDING_BUCKETS 61
+
+static struct glist_head ip_name_pending_table[IP_NAME_PENDING_BUCKETS];
+static pthread_mutex_t ip_name_pending_mutex = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t ip_name_pending_cond = PTHREAD_COND_INITIALIZER;
+static struct fridgethr *ip_name_fridge;
 
 /**
  * @name Compute the hash value for the entry in IP/name cache
@@ -132,27 +163,27 @@ int display_ip_name_val(struct gsh_buffdesc *pbuff, char *str)
 }
 
 /**
+ * @brief Look up the name of an address and cache the result
  *
- * nfs_ip_name_add: adds an entry into IP/name cache.
- *
- * Adds an entry in the duplicate requests cache.
- *
- * @param ipaddr           [IN]    the ipaddr to be used as key
- * @param hostname         [OUT]    the hostname added (found by using getnameinfo)
+ * A failed lookup caches the address string as the name, as a negative
+ * entry that expires after Negative_Expiration_Time.
  *
- * @return IP_NAME_SUCCESS if successfull\n.
- * @return IP_NAME_INSERT_MALLOC_ERROR if an error occured during the insertion process \n
- * @return IP_NAME_NETDB_ERROR if an error occured during the netdb query (via gethostbyaddr).
+ * @param[in]  ipaddr   Address to resolve
+ * @param[out] hostname The name found, or the address string
+ * @param[in]  size     Size of hostname
  *
+ * @return IP_NAME_SUCCESS or IP_NAME_INSERT_MALLOC_ERROR.
  */
-
-int nfs_ip_name_add(sockaddr_t *ipaddr, char *hostname, size_t size)
+static int ip_name_resolve(sockaddr_t *ipaddr, char *hostname, size_t size)
 {
 	struct gsh_buffdesc buffkey;
 	struct gsh_buffdesc buffdata;
+	struct gsh_buffdesc old_key, old_value;
+	struct hash_latch latch;
 	nfs_ip_name_t *nfs_ip_name = NULL;
 	sockaddr_t *pipaddr = NULL;
 	struct timeval tv0, tv1, dur;
+	hash_error_t hrc;
 	int rc;
 	char ipstring[SOCK_NAME_MAX + 1];
 
@@ -169,9 +200,10 @@ int nfs_ip_name_add(sockaddr_t *ipaddr, char *hostname, size_t size)
 	buffkey.len = sizeof(sockaddr_t);
 
 	gettimeofday(&tv0, NULL);
-	rc = getnameinfo((struct sockaddr *)pipaddr, sizeof(sockaddr_t),
-			 nfs_ip_name->hostname, sizeof(nfs_ip_name->hostname),
-			 NULL, 0, 0);
+	rc = ip_name_resolver((struct sockaddr *)pipaddr, sizeof(sockaddr_t),
+			      nfs_ip_name->hostname,
+			      sizeof(nfs_ip_name->hostname),
+			      NULL, 0, NI_NAMEREQD);
 	gettimeofday(&tv1, NULL);
 	timersub(&tv1, &tv0, &dur);
 
@@ -186,6 +218,7 @@ int nfs_ip_name_add(sockaddr_t *ipaddr, char *hostname, size_t size)
 	}
 
 	/* Ask for the name to be cached */
+	nfs_ip_name->negative = rc != 0;
 	if (rc != 0) {
 		strmaxcpy(nfs_ip_name->hostname, ipstring,
 			sizeof(nfs_ip_name->hostname));
@@ -205,20 +238,169 @@ int nfs_ip_name_add(sockaddr_t *ipaddr, char *hostname, size_t size)
 	buffdata.addr = (caddr_t) nfs_ip_name;
 	buffdata.len = sizeof(nfs_ip_name_t);
 
-	if (HashTable_Set(ht_ip_name, &buffkey, &buffdata) != HASHTABLE_SUCCESS)
-		return IP_NAME_INSERT_MALLOC_ERROR;
-
 	/* Copy the value for the caller */
 	strmaxcpy(hostname, nfs_ip_name->hostname, size);
 
+	/* Replace an expired entry */
+	hrc = hashtable_getlatch(ht_ip_name, &buffkey, NULL, true, &latch);
+	if (hrc != HASHTABLE_SUCCESS && hrc != HASHTABLE_ERROR_NO_SUCH_KEY) {
+		gsh_free(nfs_ip_name);
+		gsh_free(pipaddr);
+		return IP_NAME_INSERT_MALLOC_ERROR;
+	}
+
+	hrc = hashtable_setlatched(ht_ip_name, &buffkey, &buffdata, &latch,
+				  true, &old_key, &old_value);
+	if (hrc == HASHTABLE_OVERWRITTEN) {
+		gsh_free(old_key.addr);
+		gsh_free(old_value.addr);
+	} else if (hrc != HASHTABLE_SUCCESS) {
+		gsh_free(nfs_ip_name);
+		gsh_free(pipaddr);
+		return IP_NAME_INSERT_MALLOC_ERROR;
+	}
+
 	return IP_NAME_SUCCESS;
+}
+
+static inline struct glist_head *ip_name_pending_bucket(sockaddr_t *ipaddr)
+{
+	return &ip_name_pending_table[hash_sockaddr(ipaddr, true) %
+				      IP_NAME_PENDING_BUCKETS];
+}
+
+/* The caller must hold ip_name_pending_mutex */
+static void ip_name_pending_put(struct ip_name_pending *pending)
+{
+	if (--pending->refcount == 0)
+		gsh_free(pending);
+}
+
+/**
+ * @brief Resolve one address for the resolver pool
+ *
+ * @param[in] ctx Thread context, ctx->arg is the ip_name_pending
+ */
+static void ip_name_resolve_run(struct fridgethr_context *ctx)
+{
+	struct ip_name_pending *pending = ctx->arg;
+	char hostname[MAXHOSTNAMELEN + 1];
+	int rc;
+
+	rc = ip_name_resolve(&pending->addr, hostname, sizeof(hostname));
+
+	PTHREAD_MUTEX_lock(&ip_name_pending_mutex);
+	strmaxcpy(pending->hostname, hostname, sizeof(pending->hostname));
+	pending->rc = rc;
+	pending->done = true;
+	glist_del(&pending->list);
+	pthread_cond_broadcast(&ip_name_pending_cond);
+	ip_name_pending_put(pending);
+	PTHREAD_MUTEX_unlock(&ip_name_pending_mutex);
+}
+
+/**
+ *
+ * nfs_ip_name_add: adds an entry into IP/name cache.
+ *
+ * Adds an entry in the duplicate requests cache.  With a resolver
+ * pool, the lookup runs there and the caller waits for it, sharing one
+ * lookup with every other caller asking for the same address.  The
+ * wait is not cut short: without the name a netgroup or hostname
+ * client entry can't be decided, and treating the client as unnamed
+ * would deny it access.  A wait longer than Resolver_Wait_Timeout
+ * milliseconds is logged.
+ *
+ * @param ipaddr           [IN]    the ipaddr to be used as key
+ * @param hostname         [OUT]    the hostname added (found by using getnameinfo)
+ *
+ * @return IP_NAME_SUCCESS if successfull\n.
+ * @return IP_NAME_INSERT_MALLOC_ERROR if an error occured during the insertion process \n
+ *
+ */
+
+int nfs_ip_name_add(sockaddr_t *ipaddr, char *hostname, size_t size)
+{
+	struct glist_head *bucket, *glist;
+	struct ip_name_pending *pending = NULL;
+	uint32_t timeout = resolver_wait_timeout;
+	struct timespec deadline;
+	bool logged = timeout == 0;
+	int rc;
+
+	if (ip_name_fridge == NULL)
+		return ip_name_resolve(ipaddr, hostname, size);
+
+	bucket = ip_name_pending_bucket(ipaddr);
+
+	PTHREAD_MUTEX_lock(&ip_name_pending_mutex);
+
+	glist_for_each(glist, bucket) {
+		struct ip_name_pending *p;
+
+		p = glist_entry(glist, struct ip_name_pending, list);
+		if (cmp_sockaddr(&p->addr, ipaddr, true)) {
+			pending = p;
+			break;
+		}
+	}
+
+	if (pending == NULL) {
+		pending = gsh_calloc(1, sizeof(*pending));
+		memcpy(&pending->addr, ipaddr, sizeof(sockaddr_t));
+		pending->refcount = 1;
+		glist_add_tail(bucket, &pending->list);
+
+		rc = fridgethr_submit(ip_name_fridge, ip_name_resolve_run,
+				      pending);
+		if (rc != 0) {
+			/* Resolve it here, then */
+			glist_del(&pending->list);
+			gsh_free(pending);
+			PTHREAD_MUTEX_unlock(&ip_name_pending_mutex);
+			return ip_name_resolve(ipaddr, hostname, size);
+		}
+	}
+
+	pending->refcount++;
+
+	clock_gettime(CLOCK_REALTIME, &deadline);
+	timespec_add_nsecs((uint64_t) timeout * NS_PER_MSEC, &deadline);
+
+	while (!pending->done) {
+		if (logged) {
+			pthread_cond_wait(&ip_name_pending_cond,
+					  &ip_name_pending_mutex);
+		} else if (pthread_cond_timedwait(&ip_name_pending_cond,
+						  &ip_name_pending_mutex,
+						  &deadline) == ETIMEDOUT) {
+			char ipstring[SOCK_NAME_MAX + 1];
+
+			sprint_sockip(ipaddr, ipstring, sizeof(ipstring));
+			LogInfo(COMPONENT_DISPATCH,
+				"Still waiting after %"PRIu32" ms for the name of %s",
+				timeout, ipstring);
+			logged = true;
+		}
+	}
+
+	rc = pending->rc;
+	strmaxcpy(hostname, pending->hostname, size);
+
+	ip_name_pending_put(pending);
+	PTHREAD_MUTEX_unlock(&ip_name_pending_mutex);
+
+	return rc;
 }				/* nfs_ip_name_add */
 
 /**
  *
  * nfs_ip_name_get: Tries to get an entry for ip_name cache.
  *
- * Tries to get an entry for ip_name cache.
+ * Tries to get an entry for ip_name cache.  Entries older than
+ * Expiration_Time, or Negative_Expiration_Time for addresses that did
+ * not resolve, are reported as missing so the caller looks them up
+ * again.
  *
  * @param ipaddr   [IN]  the ip address requested
  * @param hostname [OUT] the hostname
@@ -230,26 +412,44 @@ int nfs_ip_name_get(sockaddr_t *ipaddr, char *hostname, size_t size)
 {
 	struct gsh_buffdesc buffkey;
 	struct gsh_buffdesc buffval;
+	struct hash_latch latch;
 	nfs_ip_name_t *nfs_ip_name;
 	char ipstring[SOCK_NAME_MAX + 1];
+	hash_error_t hrc;
+	time_t ttl;
+	bool fresh;
 
 	sprint_sockip(ipaddr, ipstring, sizeof(ipstring));
 
 	buffkey.addr = (caddr_t) ipaddr;
 	buffkey.len = sizeof(sockaddr_t);
 
-	if (HashTable_Get(ht_ip_name,
-			  &buffkey,
-			  &buffval) == HASHTABLE_SUCCESS) {
+	hrc = hashtable_getlatch(ht_ip_name, &buffkey, &buffval, false,
+				 &latch);
+	if (hrc == HASHTABLE_SUCCESS) {
 		nfs_ip_name = buffval.addr;
-		strmaxcpy(hostname, nfs_ip_name->hostname, size);
-
-		LogFullDebug(COMPONENT_DISPATCH, "Cache get hit for %s->%s",
-			     ipstring, nfs_ip_name->hostname);
-
-		return IP_NAME_SUCCESS;
+		ttl = nfs_ip_name->negative ? negative_expiration_time
+					    : expiration_time;
+		fresh = time(NULL) - nfs_ip_name->timestamp < ttl;
+		if (fresh)
+			strmaxcpy(hostname, nfs_ip_name->hostname, size);
+		hashtable_releaselatched(ht_ip_name, &latch);
+
+		if (fresh) {
+			LogFullDebug(COMPONENT_DISPATCH,
+				     "Cache get hit for %s->%s",
+				     ipstring, hostname);
+			return IP_NAME_SUCCESS;
+		}
+
+		LogFullDebug(COMPONENT_DISPATCH, "Cache get expired for %s",
+			     ipstring);
+		return IP_NAME_NOT_FOUND;
 	}
 
+	if (hrc == HASHTABLE_ERROR_NO_SUCH_KEY)
+		hashtable_releaselatched(ht_ip_name, &latch);
+
 	LogFullDebug(COMPONENT_DISPATCH, "Cache get miss for %s", ipstring);
 
 	return IP_NAME_NOT_FOUND;
@@ -268,7 +468,7 @@ int nfs_ip_name_get(sockaddr_t *ipaddr, char *hostname, size_t size)
  */
 int nfs_ip_name_remove(sockaddr_t *ipaddr)
 {
-	struct gsh_buffdesc buffkey, old_value;
+	struct gsh_buffdesc buffkey, old_key, old_value;
 	nfs_ip_name_t *nfs_ip_name = NULL;
 	char ipstring[SOCK_NAME_MAX + 1];
 
@@ -277,13 +477,14 @@ int nfs_ip_name_remove(sockaddr_t *ipaddr)
 	buffkey.addr = (caddr_t) ipaddr;
 	buffkey.len = sizeof(sockaddr_t);
 
-	if (HashTable_Del(ht_ip_name, &buffkey, NULL, &old_value) ==
+	if (HashTable_Del(ht_ip_name, &buffkey, &old_key, &old_value) ==
 	    HASHTABLE_SUCCESS) {
 		nfs_ip_name = (nfs_ip_name_t *) old_value.addr;
 
 		LogFullDebug(COMPONENT_DISPATCH, "Cache remove hit for %s->%s",
 			     ipstring, nfs_ip_name->hostname);
 
+		gsh_free(old_key.addr);
 		gsh_free(nfs_ip_name);
 		return IP_NAME_SUCCESS;
 	}
@@ -309,6 +510,22 @@ int nfs_ip_name_remove(sockaddr_t *ipaddr)
  */
 #define IP_NAME_EXPIRATION 3600
 
+/**
+ * @brief Default value for ip_name_param.negative_expiration_time
+ */
+#define IP_NAME_NEGATIVE_EXPIRATION 60
+
+/**
+ * @brief Default number of resolver threads
+ */
+#define IP_NAME_RESOLVER_THREADS 4
+
+/**
+ * @brief Default wait, in milliseconds, before a pending resolution
+ *        is logged
+ */
+#define IP_NAME_RESOLVER_WAIT 2000
+
 
 /** @} */
 
@@ -324,6 +541,19 @@ struct ip_name_cache {
 	/** Expiration time for ip-name mappings.  Defautls to
 	    IP_NAME_Expiration, and settable with Expiration_Time. */
 	uint32_t expiration_time;
+	/** Expiration time for addresses that did not resolve.
+	    Defaults to IP_NAME_NEGATIVE_EXPIRATION, and settable with
+	    Negative_Expiration_Time. */
+	uint32_t negative_expiration_time;
+	/** Threads resolving names in the background, 0 to resolve on
+	    the calling worker.  Defaults to IP_NAME_RESOLVER_THREADS,
+	    and settable with Resolver_Threads. */
+	uint32_t resolver_threads;
+	/** Milliseconds a worker waits for a background resolution
+	    before that is logged, 0 not to log.  Defaults to
+	    IP_NAME_RESOLVER_WAIT, and settable with
+	    Resolver_Wait_Timeout. */
+	uint32_t resolver_wait_timeout;
 };
 
 static struct ip_name_cache ip_name_cache = {
@@ -344,6 +574,14 @@ static struct config_item ip_name_params[] = {
 		       ip_name_cache, hash_param.index_size),
 	CONF_ITEM_UI32("Expiration_Time", 1, 60*60*24, IP_NAME_EXPIRATION,
 		       ip_name_cache, expiration_time),
+	CONF_ITEM_UI32("Negative_Expiration_Time", 1, 60*60*24,
+		       IP_NAME_NEGATIVE_EXPIRATION,
+		       ip_name_cache, negative_expiration_time),
+	CONF_ITEM_UI32("Resolver_Threads", 0, 64, IP_NAME_RESOLVER_THREADS,
+		       ip_name_cache, resolver_threads),
+	CONF_ITEM_UI32("Resolver_Wait_Timeout", 0, 60*1000,
+		       IP_NAME_RESOLVER_WAIT,
+		       ip_name_cache, resolver_wait_timeout),
 	CONFIG_EOL
 };
 
@@ -398,6 +636,66 @@ int nfs_Init_ip_name(void)
 
 	/* Set the expiration time */
 	expiration_time = ip_name_cache.expiration_time;
+	negative_expiration_time = ip_name_cache.negative_expiration_time;
+	resolver_wait_timeout = ip_name_cache.resolver_wait_timeout;
+
+	if (ip_name_cache.resolver_threads != 0) {
+		struct fridgethr_params frp;
+		int i, rc;
+
+		for (i = 0; i < IP_NAME_PENDING_BUCKETS; i++)
+			glist_init(&ip_name_pending_table[i]);
+
+		memset(&frp, 0, sizeof(struct fridgethr_params));
+		frp.thr_max = ip_name_cache.resolver_threads;
+		frp.thr_min = 0;
+		frp.flavor = fridgethr_flavor_worker;
+		frp.deferment = fridgethr_defer_queue;
+
+		rc = fridgethr_init(&ip_name_fridge, "IP_Name_Resolve", &frp);
+		if (rc != 0) {
+			LogMajor(COMPONENT_INIT,
+				 "Unable to start IP/name resolver threads, resolving on workers: %d",
+				 rc);
+			ip_name_fridge = NULL;
+		}
+	}
 
 	return IP_NAME_SUCCESS;
 }				/* nfs_Init_ip_name */
+
+/**
+ * @brief Replace the resolver, for tests
+ *
+ * @param[in] resolver Called instead of getnameinfo, NULL to restore it
+ */
+void nfs_ip_name_set_resolver(ip_name_resolver_t resolver)
+{
+	ip_name_resolver = resolver != NULL ? resolver : getnameinfo;
+}
+
+/**
+ * @brief Stop the IP/name resolver threads
+ *
+ * @return 0 on success, otherwise an error from the fridge.
+ */
+int nfs_ip_name_shutdown(void)
+{
+	int rc;
+
+	if (ip_name_fridge == NULL)
+		return 0;
+
+	rc = fridgethr_sync_command(ip_name_fridge, fridgethr_comm_stop,
+				    120);
+	if (rc == ETIMEDOUT) {
+		LogMajor(COMPONENT_DISPATCH,
+			 "Shutdown timed out, cancelling threads.");
+		fridgethr_cancel(ip_name_fridge);
+	} else if (rc != 0) {
+		LogMajor(COMPONENT_DISPATCH,
+			 "Failed shutting down IP/name resolver threads: %d",
+			 rc);
+	}
+	return rc;
+}
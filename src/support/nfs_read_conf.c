@@ -180,6 +180,11 @@ static struct config_item core_params[] = {
 		       nfs_core_param, short_file_handle),
 	CONF_ITEM_I64("Manage_Gids_Expiration", 0, 7*24*60*60, 30*60,
 			nfs_core_param, manage_gids_expiration),
+	CONF_ITEM_UI64("Manage_Gids_Cache_Memory", 0, UINT64_MAX,
+		       MANAGE_GIDS_CACHE_MEMORY_DEFAULT,
+		       nfs_core_param, manage_gids_cache_memory),
+	CONF_ITEM_UI32("Netgroup_Expand_Interval", 0, 86400, 0,
+		       nfs_core_param, netgroup_expand_interval),
 	CONF_ITEM_PATH("Plugins_Dir", 1, MAXPATHLEN, FSAL_MODULE_LOC,
 		       nfs_core_param, ganesha_modules_loc),
 	CONF_ITEM_UI32("heartbeat_freq", 0, 5000, 1000,
@@ -239,6 +244,12 @@ struct config_block krb5_param = {
  * @brief NFSv4 specific parameters
  */
 
+static struct config_item_list deleg_policies[] = {
+	CONFIG_LIST_TOK("default", DELEG_POLICY_DEFAULT),
+	CONFIG_LIST_TOK("adaptive", DELEG_POLICY_ADAPTIVE),
+	CONFIG_LIST_EOL
+};
+
 static struct config_item version4_params[] = {
 	CONF_ITEM_BOOL("Graceless", false,
 		       nfs_version4_parameter, graceless),
@@ -246,6 +257,20 @@ static struct config_item version4_params[] = {
 		       nfs_version4_parameter, lease_lifetime),
 	CONF_ITEM_UI32("Grace_Period", 0, 180, GRACE_PERIOD_DEFAULT,
 		       nfs_version4_parameter, grace_period),
+	CONF_ITEM_BOOL("Lift_Grace", true,
+		       nfs_version4_parameter, lift_grace),
+	CONF_ITEM_BOOL("Lift_Grace_With_NLM", false,
+		       nfs_version4_parameter, lift_grace_with_nlm),
+	CONF_ITEM_UI32("Expected_Clients", 0, 1000000, EXPECTED_CLIENTS_DEFAULT,
+		       nfs_version4_parameter, expected_clients),
+	CONF_ITEM_UI32("Max_Slots", 1, 1024, MAX_SLOTS_DEFAULT,
+		       nfs_version4_parameter, max_slots),
+	CONF_ITEM_UI32("Max_Cached_Reply_Size", 512, 1048576,
+		       MAX_CACHED_REPLY_SIZE_DEFAULT,
+		       nfs_version4_parameter, max_cached_reply_size),
+	CONF_ITEM_UI64("Session_Cache_Memory", 0, UINT64_MAX,
+		       SESSION_CACHE_MEMORY_DEFAULT,
+		       nfs_version4_parameter, session_cache_memory),
 	CONF_ITEM_STR("DomainName", 1, MAXPATHLEN, DOMAINNAME_DEFAULT,
 		      nfs_version4_parameter, domainname),
 	CONF_ITEM_PATH("IdmapConf", 1, MAXPATHLEN, IDMAPCONF_DEFAULT,
@@ -256,11 +281,32 @@ static struct config_item version4_params[] = {
 		       nfs_version4_parameter, allow_numeric_owners),
 	CONF_ITEM_BOOL("Only_Numeric_Owners", false,
 		       nfs_version4_parameter, only_numeric_owners),
+	CONF_ITEM_UI32("Idmap_Cache_Timeout", 0, 86400,
+		       IDMAP_CACHE_TIMEOUT_DEFAULT,
+		       nfs_version4_parameter, idmap_cache_timeout),
+	CONF_ITEM_UI32("Idmap_Negative_Cache_Timeout", 0, 86400,
+		       IDMAP_NEGATIVE_CACHE_TIMEOUT_DEFAULT,
+		       nfs_version4_parameter, idmap_negative_cache_timeout),
+	CONF_ITEM_UI32("Idmap_Cache_Size", 1024, 16777216,
+		       IDMAP_CACHE_SIZE_DEFAULT,
+		       nfs_version4_parameter, idmap_cache_size),
+	CONF_ITEM_PATH("Idmap_Prefetch_File", 1, MAXPATHLEN, NULL,
+		       nfs_version4_parameter, idmap_prefetch_file),
 	CONF_ITEM_BOOL("Delegations", false,
 		       nfs_version4_parameter, allow_delegations),
 	CONF_ITEM_UI32("Deleg_Recall_Retry_Delay", 0, 10,
 			DELEG_RECALL_RETRY_DELAY_DEFAULT,
 			nfs_version4_parameter, deleg_recall_retry_delay),
+	CONF_ITEM_TOKEN("Delegation_Policy", DELEG_POLICY_DEFAULT,
+			deleg_policies,
+			nfs_version4_parameter, deleg_policy),
+	CONF_ITEM_UI32("Deleg_Backoff_Max", 1, 3600, DELEG_BACKOFF_MAX_DEFAULT,
+		       nfs_version4_parameter, deleg_backoff_max),
+	CONF_ITEM_UI32("Callback_Timeout", 1, 120, CB_TIMEOUT_DEFAULT,
+		       nfs_version4_parameter, cb_timeout),
+	CONF_ITEM_UI32("Async_Copy_Threads", 0, 64,
+		       ASYNC_COPY_THREADS_DEFAULT,
+		       nfs_version4_parameter, async_copy_threads),
 	CONF_ITEM_BOOL("PNFS_MDS", true,
 		       nfs_version4_parameter, pnfs_mds),
 	CONF_ITEM_BOOL("PNFS_DS", true,
@@ -409,6 +409,18 @@ struct _9p_stats {
 };
 #endif
 
+/**
+ * @brief ALLOCATE and DEALLOCATE counts
+ */
+
+struct space_stats {
+	uint64_t allocates;	/*< ALLOCATEs that succeeded */
+	uint64_t allocated;	/*< Bytes they reserved */
+	uint64_t deallocates;	/*< DEALLOCATEs that succeeded */
+	uint64_t punched;	/*< Bytes they freed */
+	uint64_t errors;	/*< Either that the FSAL failed */
+};
+
 struct global_stats {
 	struct nfsv3_stats nfsv3;
 	struct mnt_stats mnt;
@@ -422,6 +434,7 @@ struct global_stats {
 	struct nlm_ops lm;
 	struct mnt_ops mn;
 	struct qta_ops qt;
+	struct space_stats space;
 };
 
 struct deleg_stats {
@@ -1360,6 +1373,32 @@ void server_stats_io_done(size_t requested,
 	}
 }
 
+/**
+ * @brief Record an ALLOCATE or DEALLOCATE
+ *
+ * Called once the FSAL has been asked, so that errors counts its
+ * failures and not stateid, open mode or grace errors.
+ *
+ * @param[in] length   Bytes in the range
+ * @param[in] allocate ALLOCATE rather than DEALLOCATE
+ * @param[in] success  Whether the FSAL succeeded
+ */
+
+void server_stats_space_done(uint64_t length, bool allocate, bool success)
+{
+	struct space_stats *sp = &global_st.space;
+
+	if (!success) {
+		(void)atomic_inc_uint64_t(&sp->errors);
+	} else if (allocate) {
+		(void)atomic_inc_uint64_t(&sp->allocates);
+		(void)atomic_add_uint64_t(&sp->allocated, length);
+	} else {
+		(void)atomic_inc_uint64_t(&sp->deallocates);
+		(void)atomic_add_uint64_t(&sp->punched, length);
+	}
+}
+
 /**
  * @brief record Delegation stats
  *
@@ -1911,6 +1950,11 @@ void reset_global_stats(void)
 	reset_mnt_stats(&global_st.mnt);
 	reset_rquota_stats(&global_st.rquota);
 	reset_nlmv4_stats(&global_st.nlm4);
+	(void)atomic_store_uint64_t(&global_st.space.allocates, 0);
+	(void)atomic_store_uint64_t(&global_st.space.allocated, 0);
+	(void)atomic_store_uint64_t(&global_st.space.deallocates, 0);
+	(void)atomic_store_uint64_t(&global_st.space.punched, 0);
+	(void)atomic_store_uint64_t(&global_st.space.errors, 0);
 }
 
 void global_dbus_reset_stats(DBusMessageIter *iter)
@@ -1948,6 +1992,26 @@ void global_dbus_total_ops(DBusMessageIter *iter)
 	global_dbus_total(iter);
 }
 
+void server_dbus_space_stats(DBusMessageIter *iter)
+{
+	DBusMessageIter struct_iter;
+	uint64_t val;
+
+	dbus_message_iter_open_container(iter, DBUS_TYPE_STRUCT, NULL,
+					 &struct_iter);
+	val = atomic_fetch_uint64_t(&global_st.space.allocates);
+	dbus_message_iter_append_basic(&struct_iter, DBUS_TYPE_UINT64, &val);
+	val = atomic_fetch_uint64_t(&global_st.space.allocated);
+	dbus_message_iter_append_basic(&struct_iter, DBUS_TYPE_UINT64, &val);
+	val = atomic_fetch_uint64_t(&global_st.space.deallocates);
+	dbus_message_iter_append_basic(&struct_iter, DBUS_TYPE_UINT64, &val);
+	val = atomic_fetch_uint64_t(&global_st.space.punched);
+	dbus_message_iter_append_basic(&struct_iter, DBUS_TYPE_UINT64, &val);
+	val = atomic_fetch_uint64_t(&global_st.space.errors);
+	dbus_message_iter_append_basic(&struct_iter, DBUS_TYPE_UINT64, &val);
+	dbus_message_iter_close_container(iter, &struct_iter);
+}
+
 void server_reset_stats(DBusMessageIter *iter)
 {
 	struct timespec timestamp;
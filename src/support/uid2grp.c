@@ -76,7 +76,7 @@ void uid2grp_release_group_data(struct group_data *gdata)
 	PTHREAD_MUTEX_unlock(&gdata->lock);
 
 	if (refcount == 0) {
-		gsh_free(gdata->groups);
+		uid2grp_glist_put(gdata->glist);
 		gsh_free(gdata);
 	} else if (refcount == (unsigned int)-1) {
 		LogAlways(COMPONENT_IDMAPPER, "negative refcount on gdata: %p",
@@ -142,8 +142,11 @@ static bool my_getgrouplist_alloc(char *user,
 		}
 	}
 
-	gdata->groups = groups;
+	/* Users in the same groups share one copy of the list */
+	gdata->glist = uid2grp_glist_get(groups, ngroups);
+	gdata->groups = uid2grp_glist_groups(gdata->glist);
 	gdata->nbgroups = ngroups;
+	gsh_free(groups);
 
 	return true;
 }
@@ -199,11 +202,12 @@ static struct group_data *uid2grp_allocate_by_name(
 	PTHREAD_MUTEX_init(&gdata->lock, NULL);
 	gdata->epoch = time(NULL);
 	gdata->refcount = 0;
+	gdata->refreshing = 0;
 	return gdata;
 }
 
 /* Allocate and fill in group_data structure */
-static struct group_data *uid2grp_allocate_by_uid(uid_t uid)
+struct group_data *uid2grp_allocate_by_uid(uid_t uid)
 {
 	struct passwd p;
 	struct passwd *pp;
@@ -246,6 +250,7 @@ static struct group_data *uid2grp_allocate_by_uid(uid_t uid)
 	PTHREAD_MUTEX_init(&gdata->lock, NULL);
 	gdata->epoch = time(NULL);
 	gdata->refcount = 0;
+	gdata->refreshing = 0;
 	return gdata;
 }
 
@@ -263,6 +268,7 @@ bool name2grp(const struct gsh_buffdesc *name, struct group_data **gdata)
 {
 	bool success = false;
 	uid_t uid = -1;
+	struct timespec start;
 
 	PTHREAD_RWLOCK_rdlock(&uid2grp_user_lock);
 	success = uid2grp_lookup_by_uname(name, &uid, gdata);
@@ -271,6 +277,7 @@ bool name2grp(const struct gsh_buffdesc *name, struct group_data **gdata)
 	if (success && !uid2grp_expired(*gdata)) {
 		uid2grp_hold_group_data(*gdata);
 		PTHREAD_RWLOCK_unlock(&uid2grp_user_lock);
+		uid2grp_cache_hit(*gdata);
 		return success;
 	}
 	PTHREAD_RWLOCK_unlock(&uid2grp_user_lock);
@@ -282,7 +289,9 @@ bool name2grp(const struct gsh_buffdesc *name, struct group_data **gdata)
 		PTHREAD_RWLOCK_unlock(&uid2grp_user_lock);
 	}
 
+	now(&start);
 	*gdata = uid2grp_allocate_by_name(name);
+	uid2grp_cache_miss(&start);
 	PTHREAD_RWLOCK_wrlock(&uid2grp_user_lock);
 	if (*gdata)
 		uid2grp_add_user(*gdata);
@@ -305,6 +314,7 @@ bool name2grp(const struct gsh_buffdesc *name, struct group_data **gdata)
 bool uid2grp(uid_t uid, struct group_data **gdata)
 {
 	bool success = false;
+	struct timespec start;
 
 	PTHREAD_RWLOCK_rdlock(&uid2grp_user_lock);
 	success = uid2grp_lookup_by_uid(uid, gdata);
@@ -313,6 +323,7 @@ bool uid2grp(uid_t uid, struct group_data **gdata)
 	if (success && !uid2grp_expired(*gdata)) {
 		uid2grp_hold_group_data(*gdata);
 		PTHREAD_RWLOCK_unlock(&uid2grp_user_lock);
+		uid2grp_cache_hit(*gdata);
 		return success;
 	}
 	PTHREAD_RWLOCK_unlock(&uid2grp_user_lock);
@@ -324,7 +335,9 @@ bool uid2grp(uid_t uid, struct group_data **gdata)
 		PTHREAD_RWLOCK_unlock(&uid2grp_user_lock);
 	}
 
+	now(&start);
 	*gdata = uid2grp_allocate_by_uid(uid);
+	uid2grp_cache_miss(&start);
 	PTHREAD_RWLOCK_wrlock(&uid2grp_user_lock);
 	if (*gdata)
 		uid2grp_add_user(*gdata);
@@ -35,6 +35,7 @@
 #include "log.h"
 #include "config_parsing.h"
 #include <string.h>
+#include <errno.h>
 #include <pwd.h>
 #include <grp.h>
 #include <unistd.h>
@@ -42,8 +43,12 @@
 #include "gsh_types.h"
 #include "common_utils.h"
 #include "avltree.h"
+#include "gsh_list.h"
 #include "uid2grp.h"
 #include "abstract_atomic.h"
+#include "nfs_core.h"
+#include "fridgethr.h"
+#include "city.h"
 
 /**
  * @brief User entry in the IDMapper cache
@@ -55,6 +60,21 @@ struct cache_info {
 	struct group_data *gdata;
 	struct avltree_node uname_node;	/*< Node in the name tree */
 	struct avltree_node uid_node;	/*< Node in the UID tree */
+	struct glist_head lru;	/*< Entry in uid2grp_lru */
+	uint32_t referenced;	/*< Looked up since the clock hand passed */
+	size_t bytes;		/*< Memory charged for this user */
+};
+
+/**
+ * @brief A group list shared by every user in the same groups
+ */
+
+struct uid2grp_glist {
+	struct avltree_node node;	/*< Node in glist_tree */
+	uint64_t hash;		/*< Hash of the groups */
+	unsigned int refcount;	/*< group_data using it, under glist_lock */
+	int nbgroups;		/*< Number of groups */
+	gid_t groups[];		/*< The groups */
 };
 
 /**
@@ -90,6 +110,78 @@ static struct avltree uname_tree;
 
 static struct avltree uid_tree;
 
+/**
+ * @brief Bumped whenever the whole cache is wiped
+ */
+
+static uint64_t uid2grp_cache_generation;
+
+/**
+ * @brief Cached users, least recently inserted first
+ *
+ * Eviction is a clock over this list: a user looked up since it was
+ * last passed gets moved to the tail instead of evicted, so the list
+ * head approximates the least recently used user without writing
+ * the list on every lookup.  Protected by uid2grp_user_lock.
+ */
+
+static struct glist_head uid2grp_lru;
+
+/**
+ * @brief Memory charged to cached users, under uid2grp_user_lock
+ */
+
+static uint64_t uid2grp_user_bytes;
+
+/**
+ * @brief Number of cached users, under uid2grp_user_lock
+ */
+
+static uint64_t uid2grp_users;
+
+/**
+ * @brief Shared group lists, by content
+ */
+
+static struct avltree glist_tree;
+
+/**
+ * @brief Lock protecting glist_tree and group list refcounts
+ */
+
+static pthread_mutex_t glist_lock = PTHREAD_MUTEX_INITIALIZER;
+
+/**
+ * @brief Memory used by group lists, under glist_lock
+ */
+
+static uint64_t glist_bytes;
+
+/**
+ * @brief Number of group lists, under glist_lock
+ */
+
+static uint64_t glist_count;
+
+/**
+ * @brief Statistics, hits are counted atomically, the rest under
+ *        uid2grp_stats_lock
+ */
+
+static struct uid2grp_stats uid2grp_stats;
+
+/**
+ * @brief Lock protecting uid2grp_stats latencies
+ */
+
+static pthread_mutex_t uid2grp_stats_lock = PTHREAD_MUTEX_INITIALIZER;
+
+/**
+ * @brief Fridge refreshing users before they expire
+ */
+
+static struct fridgethr *uid2grp_fridge;
+
 /**
  * @brief Compare two buffers
  *
@@ -174,16 +266,176 @@ static int uid_comparator(const struct avltree_node *node1,
 		return 0;
 }
 
+/**
+ * @brief Comparison for group lists
+ *
+ * @param[in] node1 A node
+ * @param[in] nodea Another node
+ *
+ * @retval -1 if node1 is less than nodea
+ * @retval 0 if node1 and nodea are equal
+ * @retval 1 if node1 is greater than nodea
+ */
+
+static int glist_comparator(const struct avltree_node *node1,
+			    const struct avltree_node *nodea)
+{
+	struct uid2grp_glist *glist1 =
+	    avltree_container_of(node1, struct uid2grp_glist, node);
+	struct uid2grp_glist *glista =
+	    avltree_container_of(nodea, struct uid2grp_glist, node);
+	int mr;
+
+	if (glist1->hash != glista->hash)
+		return glist1->hash < glista->hash ? -1 : 1;
+
+	if (glist1->nbgroups != glista->nbgroups)
+		return glist1->nbgroups < glista->nbgroups ? -1 : 1;
+
+	mr = memcmp(glist1->groups, glista->groups,
+		    glist1->nbgroups * sizeof(gid_t));
+
+	return mr < 0 ? -1 : (mr > 0 ? 1 : 0);
+}
+
 /**
  * @brief Initialize the IDMapper cache
  */
 
 void uid2grp_cache_init(void)
 {
+	struct fridgethr_params frp;
+	int rc;
+
 	avltree_init(&uname_tree, uname_comparator, 0);
 	avltree_init(&uid_tree, uid_comparator, 0);
 	memset(uid_grplist_cache, 0,
 	       id_cache_size * sizeof(struct avltree_node *));
+	glist_init(&uid2grp_lru);
+	avltree_init(&glist_tree, glist_comparator, 0);
+
+	memset(&frp, 0, sizeof(struct fridgethr_params));
+	frp.thr_max = 2;
+	frp.thr_min = 0;
+	frp.flavor = fridgethr_flavor_worker;
+	frp.deferment = fridgethr_defer_queue;
+
+	/* Without it users simply expire and are looked up inline */
+	rc = fridgethr_init(&uid2grp_fridge, "Uid2grp_Refresh", &frp);
+	if (rc != 0) {
+		LogMajor(COMPONENT_IDMAPPER,
+			 "Unable to initialize uid2grp refresh fridge, error code %d.",
+			 rc);
+		uid2grp_fridge = NULL;
+	}
+}
+
+/**
+ * @brief Stop the background refresh threads
+ *
+ * @return 0 on success, error code otherwise.
+ */
+
+int uid2grp_cache_shutdown(void)
+{
+	int rc;
+
+	if (uid2grp_fridge == NULL)
+		return 0;
+
+	rc = fridgethr_sync_command(uid2grp_fridge, fridgethr_comm_stop, 120);
+	if (rc == ETIMEDOUT) {
+		LogMajor(COMPONENT_IDMAPPER,
+			 "Shutdown timed out, cancelling threads.");
+		fridgethr_cancel(uid2grp_fridge);
+	} else if (rc != 0) {
+		LogMajor(COMPONENT_IDMAPPER,
+			 "Failed shutting down uid2grp refresh fridge: %d",
+			 rc);
+	}
+
+	return rc;
+}
+
+/**
+ * @brief Find or create the shared copy of a group list
+ *
+ * @param[in] groups   The groups
+ * @param[in] nbgroups Number of groups
+ *
+ * @return The shared list, with a reference held.
+ */
+
+struct uid2grp_glist *uid2grp_glist_get(const gid_t *groups, int nbgroups)
+{
+	size_t size = nbgroups * sizeof(gid_t);
+	struct uid2grp_glist *glist;
+	struct avltree_node *node;
+
+	glist = gsh_malloc(sizeof(struct uid2grp_glist) + size);
+	glist->hash = CityHash64((const char *)groups, size);
+	glist->nbgroups = nbgroups;
+	glist->refcount = 1;
+	if (size != 0)
+		memcpy(glist->groups, groups, size);
+
+	PTHREAD_MUTEX_lock(&glist_lock);
+
+	node = avltree_insert(&glist->node, &glist_tree);
+	if (node != NULL) {
+		gsh_free(glist);
+		glist = avltree_container_of(node, struct uid2grp_glist,
+					     node);
+		glist->refcount++;
+	} else {
+		glist_bytes += sizeof(struct uid2grp_glist) + size;
+		glist_count++;
+	}
+
+	PTHREAD_MUTEX_unlock(&glist_lock);
+
+	return glist;
+}
+
+/**
+ * @brief Release a shared group list
+ *
+ * @param[in] glist The list, may be NULL
+ */
+
+void uid2grp_glist_put(struct uid2grp_glist *glist)
+{
+	if (glist == NULL)
+		return;
+
+	PTHREAD_MUTEX_lock(&glist_lock);
+
+	if (--glist->refcount != 0) {
+		PTHREAD_MUTEX_unlock(&glist_lock);
+		return;
+	}
+
+	avltree_remove(&glist->node, &glist_tree);
+	glist_bytes -= sizeof(struct uid2grp_glist) +
+		       glist->nbgroups * sizeof(gid_t);
+	glist_count--;
+
+	PTHREAD_MUTEX_unlock(&glist_lock);
+
+	gsh_free(glist);
+}
+
+/**
+ * @brief Get the groups of a shared group list
+ *
+ * @param[in] glist The list
+ *
+ * @return The groups.
+ */
+
+gid_t *uid2grp_glist_groups(struct uid2grp_glist *glist)
+{
+	return glist->groups;
 }
 
 /* Remove given user/cache_info from the AVL trees
@@ -195,6 +447,9 @@ static void uid2grp_remove_user(struct cache_info *info)
 	uid_grplist_cache[info->uid % id_cache_size] = NULL;
 	avltree_remove(&info->uid_node, &uid_tree);
 	avltree_remove(&info->uname_node, &uname_tree);
+	glist_del(&info->lru);
+	uid2grp_user_bytes -= info->bytes;
+	uid2grp_users--;
 	/* We decrement hold on group data when it is
 	 * removed from cache trees.
 	 */
@@ -202,6 +457,43 @@ static void uid2grp_remove_user(struct cache_info *info)
 	gsh_free(info);
 }
 
+/**
+ * @brief Evict users until the cache fits its memory limit
+ *
+ * @note The caller must hold uid2grp_user_lock for write.
+ */
+static void uid2grp_evict(void)
+{
+	uint64_t limit = nfs_param.core_param.manage_gids_cache_memory;
+	struct cache_info *info;
+	uint64_t bytes;
+
+	if (limit == 0)
+		return;
+
+	for (;;) {
+		PTHREAD_MUTEX_lock(&glist_lock);
+		bytes = uid2grp_user_bytes + glist_bytes;
+		PTHREAD_MUTEX_unlock(&glist_lock);
+
+		/* Always keep the user just added */
+		if (bytes <= limit || uid2grp_users <= 1)
+			return;
+
+		info = glist_first_entry(&uid2grp_lru, struct cache_info, lru);
+
+		/* Second chance for users looked up since last time */
+		if (atomic_postclear_uint32_t_bits(&info->referenced, 1)) {
+			glist_del(&info->lru);
+			glist_add_tail(&uid2grp_lru, &info->lru);
+			continue;
+		}
+
+		uid2grp_remove_user(info);
+		(void) atomic_inc_uint64_t(&uid2grp_stats.evictions);
+	}
+}
+
 /**
  * @brief Add a user entry to the cache
  *
@@ -227,6 +519,10 @@ void uid2grp_add_user(struct group_data *gdata)
 	info->uname.addr = gdata->uname.addr;
 	info->uname.len = gdata->uname.len;
 	info->gdata = gdata;
+	/* Referenced, so eviction below passes over it */
+	info->referenced = 1;
+	info->bytes = sizeof(struct cache_info) + sizeof(struct group_data) +
+		      gdata->uname.len;
 
 	/* The refcount on group_data should be 1 when we put it in
 	 * AVL trees.
@@ -259,6 +555,11 @@ void uid2grp_add_user(struct group_data *gdata)
 	}
 	uid_grplist_cache[info->uid % id_cache_size] = &info->uid_node;
 
+	glist_add_tail(&uid2grp_lru, &info->lru);
+	uid2grp_user_bytes += info->bytes;
+	uid2grp_users++;
+	uid2grp_evict();
+
 	if (name_node && id_node)
 		LogWarn(COMPONENT_IDMAPPER, "shouldn't happen, internal error");
 	if ((name_node && name_node2) || (id_node && id_node2))
@@ -283,6 +584,8 @@ static bool lookup_by_uname(const struct gsh_buffdesc *name,
 	found_info = avltree_container_of(found_node,
 					  struct cache_info,
 					  uname_node);
+	if (!atomic_fetch_uint32_t(&found_info->referenced))
+		atomic_store_uint32_t(&found_info->referenced, 1);
 
 	/* I assume that if someone likes this user enough to look it
 	   up by name, they'll like it enough to look it up by ID
@@ -330,6 +633,9 @@ static bool lookup_by_uid(const uid_t uid, struct cache_info **info)
 					 uid_node);
 	}
 
+	if (!atomic_fetch_uint32_t(&found_info->referenced))
+		atomic_store_uint32_t(&found_info->referenced, 1);
+
 	*info = found_info;
 
 	return true;
@@ -430,7 +736,151 @@ void uid2grp_clear_cache(void)
 
 	assert(avltree_first(&uid_tree) == NULL);
 
+	(void) atomic_inc_uint64_t(&uid2grp_cache_generation);
+
 	PTHREAD_RWLOCK_unlock(&uid2grp_user_lock);
 }
 
+/**
+ * @brief Get the generation of the uid2grp cache
+ *
+ * Lets holders of group data notice the cache was wiped.
+ *
+ * @return The current generation.
+ */
+
+uint64_t uid2grp_generation(void)
+{
+	return atomic_fetch_uint64_t(&uid2grp_cache_generation);
+}
+
+/**
+ * @brief Account a lookup latency
+ *
+ * @param[in]     start   When the lookup started
+ * @param[in,out] count   Number of lookups
+ * @param[in,out] latency Total lookup time
+ * @param[in,out] max     Longest lookup
+ */
+
+static void uid2grp_account(const struct timespec *start, uint64_t *count,
+			    uint64_t *latency, uint64_t *max)
+{
+	struct timespec end;
+	nsecs_elapsed_t elapsed;
+
+	now(&end);
+	elapsed = timespec_diff(start, &end);
+
+	PTHREAD_MUTEX_lock(&uid2grp_stats_lock);
+	(*count)++;
+	*latency += elapsed;
+	if (elapsed > *max)
+		*max = elapsed;
+	PTHREAD_MUTEX_unlock(&uid2grp_stats_lock);
+}
+
+/**
+ * @brief Refetch a user's groups and replace the cached entry
+ *
+ * If the lookup fails the entry is left to expire, and the next
+ * lookup after that goes to getgrouplist inline.
+ *
+ * @param[in] ctx Thread context, arg is the old group_data, held
+ */
+
+static void uid2grp_refresh(struct fridgethr_context *ctx)
+{
+	struct group_data *old = ctx->arg;
+	struct group_data *gdata;
+	struct timespec start;
+
+	now(&start);
+	gdata = uid2grp_allocate_by_uid(old->uid);
+
+	if (gdata != NULL) {
+		PTHREAD_RWLOCK_wrlock(&uid2grp_user_lock);
+		uid2grp_add_user(gdata);
+		PTHREAD_RWLOCK_unlock(&uid2grp_user_lock);
+		uid2grp_account(&start, &uid2grp_stats.refreshes,
+				&uid2grp_stats.refresh_latency,
+				&uid2grp_stats.refresh_max);
+	} else {
+		PTHREAD_MUTEX_lock(&uid2grp_stats_lock);
+		uid2grp_stats.refresh_failures++;
+		PTHREAD_MUTEX_unlock(&uid2grp_stats_lock);
+	}
+
+	uid2grp_release_group_data(old);
+}
+
+/**
+ * @brief Note a lookup served from the cache
+ *
+ * A user found in the last quarter of Manage_Gids_Expiration is
+ * refreshed in the background, so that users who keep coming back
+ * never wait for getgrouplist.
+ *
+ * @param[in] gdata The group data found, held by the caller
+ */
+
+void uid2grp_cache_hit(struct group_data *gdata)
+{
+	time_t expiration = nfs_param.core_param.manage_gids_expiration;
+	int rc;
+
+	(void) atomic_inc_uint64_t(&uid2grp_stats.hits);
+
+	if (uid2grp_fridge == NULL ||
+	    time(NULL) - gdata->epoch <= expiration - expiration / 4 ||
+	    atomic_postset_uint32_t_bits(&gdata->refreshing, 1) != 0)
+		return;
+
+	uid2grp_hold_group_data(gdata);
+	rc = fridgethr_submit(uid2grp_fridge, uid2grp_refresh, gdata);
+	if (rc != 0) {
+		LogDebug(COMPONENT_IDMAPPER,
+			 "Unable to queue uid2grp refresh: %d", rc);
+		uid2grp_release_group_data(gdata);
+	}
+}
+
+/**
+ * @brief Note a lookup that had to go to getgrouplist
+ *
+ * @param[in] start When the lookup started
+ */
+
+void uid2grp_cache_miss(const struct timespec *start)
+{
+	uid2grp_account(start, &uid2grp_stats.misses,
+			&uid2grp_stats.miss_latency, &uid2grp_stats.miss_max);
+}
+
+/**
+ * @brief Get managed gids cache statistics
+ *
+ * @param[out] stats The statistics
+ */
+
+void uid2grp_get_stats(struct uid2grp_stats *stats)
+{
+	PTHREAD_MUTEX_lock(&uid2grp_stats_lock);
+	*stats = uid2grp_stats;
+	PTHREAD_MUTEX_unlock(&uid2grp_stats_lock);
+
+	stats->hits = atomic_fetch_uint64_t(&uid2grp_stats.hits);
+	stats->evictions = atomic_fetch_uint64_t(&uid2grp_stats.evictions);
+
+	PTHREAD_RWLOCK_rdlock(&uid2grp_user_lock);
+	stats->users = uid2grp_users;
+	stats->bytes = uid2grp_user_bytes;
+	PTHREAD_RWLOCK_unlock(&uid2grp_user_lock);
+
+	PTHREAD_MUTEX_lock(&glist_lock);
+	stats->lists = glist_count;
+	stats->bytes += glist_bytes;
+	PTHREAD_MUTEX_unlock(&glist_lock);
+}
+
 /** @} */